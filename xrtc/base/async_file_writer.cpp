@@ -0,0 +1,348 @@
+﻿#include "xrtc/base/async_file_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(WEBRTC_WIN)
+#include <io.h>
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+namespace xrtc {
+
+namespace {
+
+// O_DIRECT要求缓冲地址、长度和文件偏移都按逻辑块对齐，4K覆盖常见的磁盘和文件系统
+const size_t kIoAlignment = 4096;
+
+size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint8_t* AlignedAlloc(size_t size) {
+#if defined(WEBRTC_WIN)
+    return (uint8_t*)_aligned_malloc(size, kIoAlignment);
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, kIoAlignment, size) == 0 ? (uint8_t*)p : nullptr;
+#endif
+}
+
+void AlignedFree(uint8_t* p) {
+#if defined(WEBRTC_WIN)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+// 写满size字节，被信号打断时重试
+bool WriteFully(int fd, const uint8_t* data, size_t size, int64_t offset) {
+    while (size > 0) {
+#if defined(WEBRTC_WIN)
+        if (_lseeki64(fd, offset, SEEK_SET) < 0) {
+            return false;
+        }
+        int n = _write(fd, data, (unsigned int)std::min<size_t>(size, 1 << 30));
+#else
+        ssize_t n = pwrite(fd, data, size, (off_t)offset);
+#endif
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= (size_t)n;
+        offset += n;
+    }
+    return true;
+}
+
+} // namespace
+
+AsyncFileWriter::AsyncFileWriter() {
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    Close();
+}
+
+bool AsyncFileWriter::Open(const std::string& path, const Options& options) {
+    if (fd_ >= 0) {
+        RTC_LOG(LS_WARNING) << "AsyncFileWriter already open";
+        return false;
+    }
+
+    options_ = options;
+    options_.buffer_size = AlignUp(std::max<size_t>(options.buffer_size, kIoAlignment),
+        kIoAlignment);
+    direct_io_ = false;
+
+#if defined(WEBRTC_WIN)
+    fd_ = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+        _S_IREAD | _S_IWRITE);
+#else
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#if defined(WEBRTC_LINUX)
+    if (options.direct_io) {
+        fd_ = open(path.c_str(), flags | O_DIRECT, 0644);
+        if (fd_ >= 0) {
+            direct_io_ = true;
+        }
+        else {
+            // tmpfs等文件系统不支持O_DIRECT
+            RTC_LOG(LS_WARNING) << "AsyncFileWriter O_DIRECT not supported: "
+                << strerror(errno) << ", fallback to buffered write";
+        }
+    }
+#endif
+    if (fd_ < 0) {
+        fd_ = open(path.c_str(), flags, 0644);
+    }
+#endif
+
+    if (fd_ < 0) {
+        RTC_LOG(LS_WARNING) << "AsyncFileWriter open " << path << " failed: " << strerror(errno);
+        return false;
+    }
+
+    current_ = Block();
+    position_ = 0;
+    patches_.clear();
+    failed_ = false;
+    quit_ = false;
+    file_offset_ = 0;
+    allocated_end_ = 0;
+    io_failed_ = false;
+    io_thread_ = std::thread([this]() {
+        Run();
+    });
+
+    RTC_LOG(LS_INFO) << "AsyncFileWriter open " << path << ", buffer: "
+        << options_.buffer_size / 1024 << "KB, direct_io: " << direct_io_
+        << ", preallocate: " << options_.preallocate_bytes;
+    return true;
+}
+
+bool AsyncFileWriter::CanWrite(size_t size) const {
+    return !io_failed_ && !failed_ &&
+        (size_t)queue_bytes_.load() + current_.size + size <= options_.max_queue_bytes;
+}
+
+bool AsyncFileWriter::Write(const void* data, size_t size) {
+    if (fd_ < 0 || failed_ || io_failed_) {
+        return false;
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        if (!current_.data) {
+            current_.data = AllocBlock();
+            current_.size = 0;
+            if (!current_.data) {
+                failed_ = true;
+                return false;
+            }
+        }
+
+        size_t n = std::min(size, options_.buffer_size - current_.size);
+        memcpy(current_.data + current_.size, src, n);
+        current_.size += n;
+        src += n;
+        size -= n;
+        position_ += n;
+
+        if (current_.size == options_.buffer_size) {
+            SubmitCurrent();
+        }
+    }
+    return true;
+}
+
+void AsyncFileWriter::WriteAt(int64_t offset, const void* data, size_t size) {
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    patches_.push_back({ offset, std::vector<uint8_t>(src, src + size) });
+}
+
+uint8_t* AsyncFileWriter::AllocBlock() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_blocks_.empty()) {
+            uint8_t* data = free_blocks_.back();
+            free_blocks_.pop_back();
+            return data;
+        }
+    }
+    return AlignedAlloc(options_.buffer_size);
+}
+
+void AsyncFileWriter::FreeBlock(uint8_t* data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_blocks_.push_back(data);
+}
+
+void AsyncFileWriter::SubmitCurrent() {
+    if (!current_.data) {
+        return;
+    }
+
+    int depth;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(current_);
+        depth = ++queue_depth_;
+        queue_bytes_ += (int64_t)current_.size;
+    }
+    cv_.notify_one();
+
+    if (depth > max_queue_depth_) {
+        max_queue_depth_ = depth;
+    }
+    current_ = Block();
+}
+
+void AsyncFileWriter::Run() {
+    while (true) {
+        Block block;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return quit_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            block = queue_.front();
+            queue_.pop_front();
+        }
+
+        // 出错之后的数据直接丢弃，保证Close能很快返回
+        if (!io_failed_ && !WriteBlock(block)) {
+            io_failed_ = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_blocks_.push_back(block.data);
+            --queue_depth_;
+            queue_bytes_ -= (int64_t)block.size;
+        }
+    }
+}
+
+// O_DIRECT时最后一块不足对齐长度，补零写入，关闭时再截断到实际长度
+bool AsyncFileWriter::WriteBlock(const Block& block) {
+    size_t size = block.size;
+    if (direct_io_ && size % kIoAlignment != 0) {
+        size_t aligned = AlignUp(size, kIoAlignment);
+        memset(block.data + size, 0, aligned - size);
+        size = aligned;
+    }
+
+    Preallocate(file_offset_ + (int64_t)size);
+
+    int64_t start_us = rtc::TimeMicros();
+    if (!WriteFully(fd_, block.data, size, file_offset_)) {
+        RTC_LOG(LS_WARNING) << "AsyncFileWriter write failed: " << strerror(errno);
+        errors_.Add();
+        return false;
+    }
+    write_time_us_.Add(rtc::TimeMicros() - start_us);
+
+    file_offset_ += (int64_t)block.size;
+    bytes_written_.Add((int64_t)block.size);
+    return true;
+}
+
+// 按大块预分配，文件在磁盘上更连续，写入时也不需要频繁分配块
+void AsyncFileWriter::Preallocate(int64_t end) {
+#if defined(WEBRTC_LINUX)
+    if (options_.preallocate_bytes <= 0 || end <= allocated_end_) {
+        return;
+    }
+
+    int64_t len = std::max(options_.preallocate_bytes, end - allocated_end_);
+    if (fallocate(fd_, FALLOC_FL_KEEP_SIZE, (off_t)allocated_end_, (off_t)len) != 0) {
+        RTC_LOG(LS_WARNING) << "AsyncFileWriter fallocate failed: " << strerror(errno)
+            << ", disable preallocation";
+        options_.preallocate_bytes = 0;
+        return;
+    }
+    allocated_end_ += len;
+#else
+    (void)end;
+#endif
+}
+
+void AsyncFileWriter::Close() {
+    if (fd_ < 0) {
+        return;
+    }
+
+    SubmitCurrent();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    cv_.notify_one();
+    if (io_thread_.joinable()) {
+        io_thread_.join();
+    }
+
+    Finish();
+
+    for (uint8_t* data : free_blocks_) {
+        AlignedFree(data);
+    }
+    free_blocks_.clear();
+}
+
+// 截掉O_DIRECT补齐的部分和预分配的空间，再写入关闭时的修改
+void AsyncFileWriter::Finish() {
+#if defined(WEBRTC_WIN)
+    _chsize_s(fd_, file_offset_);
+#else
+    if (direct_io_ || allocated_end_ > file_offset_) {
+        if (ftruncate(fd_, (off_t)file_offset_) != 0) {
+            RTC_LOG(LS_WARNING) << "AsyncFileWriter ftruncate failed: " << strerror(errno);
+        }
+    }
+#if defined(WEBRTC_LINUX)
+    if (direct_io_ && !patches_.empty()) {
+        fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+    }
+#endif
+#endif
+
+    for (const Patch& patch : patches_) {
+        if (patch.offset + (int64_t)patch.data.size() > file_offset_) {
+            continue;
+        }
+        if (!WriteFully(fd_, patch.data.data(), patch.data.size(), patch.offset)) {
+            RTC_LOG(LS_WARNING) << "AsyncFileWriter patch failed at " << patch.offset;
+            errors_.Add();
+        }
+    }
+    patches_.clear();
+
+    RTC_LOG(LS_INFO) << "AsyncFileWriter close, " << file_offset_ << " bytes, errors: "
+        << errors_.count();
+#if defined(WEBRTC_WIN)
+    _close(fd_);
+#else
+    close(fd_);
+#endif
+    fd_ = -1;
+}
+
+} // namespace xrtc
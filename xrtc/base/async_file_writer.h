@@ -0,0 +1,111 @@
+﻿#ifndef XRTCSDK_XRTC_BASE_ASYNC_FILE_WRITER_H_
+#define XRTCSDK_XRTC_BASE_ASYNC_FILE_WRITER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "xrtc/base/xrtc_stats.h"
+
+namespace xrtc {
+
+// 异步文件写入：调用线程只把数据拷贝到大块的合并缓冲中，写满一块交给专门的IO线程写盘
+// 磁盘变慢时调用线程不会阻塞，积压超过上限后CanWrite返回false，由调用者决定丢弃哪些数据
+// Linux上可以使用O_DIRECT绕过页缓存(缓冲按4K对齐)，以及fallocate按块预分配空间减少碎片
+class AsyncFileWriter {
+public:
+    struct Options {
+        size_t buffer_size = 4 * 1024 * 1024;//合并缓冲的大小，按4K取整
+        size_t max_queue_bytes = 64 * 1024 * 1024;//IO线程积压的上限
+        bool direct_io = false;//只在Linux上生效，文件系统不支持时退回到普通写
+        int64_t preallocate_bytes = 0;//每次预分配的大小，0表示不预分配，只在Linux上生效
+    };
+
+    AsyncFileWriter();
+    ~AsyncFileWriter();
+
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    bool Open(const std::string& path, const Options& options);
+    // 等待所有数据写完，应用WriteAt的修改后关闭文件，可以重复调用
+    void Close();
+    bool is_open() const { return fd_ >= 0; }
+
+    // 积压加上size之后是否还在上限内，一条记录(例如一帧)写之前检查一次，保证记录完整
+    bool CanWrite(size_t size) const;
+    // 拷贝到合并缓冲，写满时交给IO线程，不检查积压上限；出错后返回false
+    bool Write(const void* data, size_t size);
+    // 关闭时在offset处覆盖写(例如文件头中的帧数)，offset必须在已经写入的范围内
+    void WriteAt(int64_t offset, const void* data, size_t size);
+    // 已经交给Write的字节数，即下一次Write的文件偏移
+    int64_t position() const { return position_; }
+
+    // 统计，可以在任意线程读取
+    int64_t bytes_written() const { return bytes_written_.count(); }
+    double write_rate(int64_t now_ms) { return bytes_written_.Rate(now_ms); }//字节/秒
+    int queue_depth() const { return queue_depth_.load(); }//等待写盘的缓冲块数
+    int64_t queue_bytes() const { return queue_bytes_.load(); }
+    int max_queue_depth() { return max_queue_depth_.exchange(0); }//两次读取之间的最大值
+    int64_t write_us() { return write_time_us_.Average(); }//每块的写盘耗时
+    int64_t errors() const { return errors_.count(); }
+    bool direct_io() const { return direct_io_; }
+
+private:
+    struct Block {
+        uint8_t* data = nullptr;
+        size_t size = 0;
+    };
+    struct Patch {
+        int64_t offset;
+        std::vector<uint8_t> data;
+    };
+
+    uint8_t* AllocBlock();
+    void FreeBlock(uint8_t* data);
+    void SubmitCurrent();
+    void Run();
+    bool WriteBlock(const Block& block);
+    void Preallocate(int64_t end);
+    void Finish();
+
+private:
+    Options options_;
+    int fd_ = -1;
+    bool direct_io_ = false;
+    std::thread io_thread_;
+
+    // 以下只在写入线程上访问
+    Block current_;
+    int64_t position_ = 0;
+    std::vector<Patch> patches_;
+    bool failed_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Block> queue_;
+    std::vector<uint8_t*> free_blocks_;//复用写完的缓冲
+    bool quit_ = false;
+
+    // 以下只在IO线程上访问
+    int64_t file_offset_ = 0;
+    int64_t allocated_end_ = 0;//fallocate预分配到的位置
+
+    std::atomic<int> queue_depth_{ 0 };
+    std::atomic<int64_t> queue_bytes_{ 0 };
+    std::atomic<int> max_queue_depth_{ 0 };
+    std::atomic<bool> io_failed_{ false };
+    StatsCounter bytes_written_;
+    AverageCounter write_time_us_;
+    StatsCounter errors_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_BASE_ASYNC_FILE_WRITER_H_
@@ -0,0 +1,379 @@
+﻿#include "xrtc/base/http_manager.h"
+
+#include <algorithm>
+
+#include <curl/curl.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/time_utils.h>
+
+namespace xrtc {
+
+namespace {
+
+// 没有请求时IO线程等待的最长时间，新请求和取消通过curl_multi_wakeup立即唤醒
+const int kMaxPollMs = 1000;
+// 重试按100ms、200ms、400ms退避，最长2s
+const int kRetryBaseMs = 100;
+const int kMaxRetryDelayMs = 2000;
+const size_t kMaxIdleEasyHandles = 8;
+// 保持的空闲连接数，信令通常只访问一两个域名
+const long kMaxConnects = 8;
+const long kDnsCacheTimeoutS = 300;
+
+std::once_flag g_curl_init;
+
+// 连接阶段的错误和服务端5xx可以重试，4xx和其他错误重试也不会成功
+bool IsRetryable(int curl_code, long status) {
+    switch (curl_code) {
+    case CURLE_OK:
+        return status >= 500;
+    case CURLE_COULDNT_RESOLVE_HOST:
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_SSL_CONNECT_ERROR:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_GOT_NOTHING:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// curl的时间都是从请求开始累计的微秒数
+int64_t GetTimeUs(CURL* easy, CURLINFO info) {
+    curl_off_t value = 0;
+    curl_easy_getinfo(easy, info, &value);
+    return (int64_t)value;
+}
+
+} // namespace
+
+HttpManager::HttpManager(rtc::Thread* callback_thread) :
+    callback_thread_(callback_thread)
+{
+    std::call_once(g_curl_init, []() {
+        curl_global_init(CURL_GLOBAL_ALL);
+    });
+
+    // 连接池在multi句柄上，所有请求共用；DNS和TLS会话放到share句柄里，easy句柄重置后也不丢失
+    multi_ = curl_multi_init();
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, kMaxConnects);
+
+    // share句柄只在IO线程上使用，不需要加锁回调
+    share_ = curl_share_init();
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    io_thread_ = std::thread([this]() {
+        Run();
+    });
+}
+
+HttpManager::~HttpManager() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    curl_multi_wakeup(multi_);
+    io_thread_.join();
+
+    curl_multi_cleanup(multi_);
+    curl_share_cleanup(share_);
+}
+
+int64_t HttpManager::Send(const HttpRequest& request, HttpCallback callback) {
+    auto transfer = std::make_unique<Transfer>();
+    transfer->request = request;
+    transfer->start_ms = rtc::TimeMillis();
+
+    int64_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = next_id_++;
+        transfer->id = id;
+        callbacks_[id] = std::move(callback);
+        pending_.push_back(std::move(transfer));
+    }
+
+    requests_.Add();
+    curl_multi_wakeup(multi_);
+    return id;
+}
+
+void HttpManager::Cancel(int64_t id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (callbacks_.erase(id) == 0) {
+            return;
+        }
+        cancelled_.push_back(id);
+    }
+    curl_multi_wakeup(multi_);
+}
+
+void HttpManager::GetStats(JsonObject& stats) {
+    size_t pending = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending = callbacks_.size();
+    }
+
+    stats["requests"] = requests_.count();
+    stats["pending"] = pending;
+    stats["failures"] = failures_.count();
+    stats["retries"] = retries_.count();
+    stats["new_connections"] = new_connections_.count();
+    stats["reused_connections"] = reused_connections_.count();
+    stats["latency_ms"] = latency_ms_.Average();
+}
+
+void HttpManager::Run() {
+    while (true) {
+        std::vector<std::unique_ptr<Transfer>> pending;
+        std::vector<int64_t> cancelled;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (quit_) {
+                break;
+            }
+            pending.swap(pending_);
+            cancelled.swap(cancelled_);
+        }
+
+        for (auto& transfer : pending) {
+            Transfer* t = transfer.get();
+            transfers_[t->id] = std::move(transfer);
+            StartAttempt(t);
+        }
+
+        for (int64_t id : cancelled) {
+            RemoveTransfer(id);
+        }
+
+        int running = 0;
+        curl_multi_perform(multi_, &running);
+
+        int left = 0;
+        CURLMsg* msg = nullptr;
+        while ((msg = curl_multi_info_read(multi_, &left)) != nullptr) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            Transfer* t = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&t);
+            if (t) {
+                OnAttemptDone(t, msg->data.result);
+            }
+        }
+
+        // 到期的重试重新加入multi句柄，poll的等待时间不超过下一个重试的时间
+        int64_t now = rtc::TimeMillis();
+        int64_t wait_ms = kMaxPollMs;
+        std::vector<Transfer*> due;
+        for (auto& it : transfers_) {
+            Transfer* t = it.second.get();
+            if (t->retry_at_ms == 0) {
+                continue;
+            }
+
+            if (t->retry_at_ms <= now) {
+                due.push_back(t);
+            }
+            else {
+                wait_ms = std::min(wait_ms, t->retry_at_ms - now);
+            }
+        }
+
+        for (Transfer* t : due) {
+            t->retry_at_ms = 0;
+            StartAttempt(t);
+            wait_ms = 0;
+        }
+
+        // 内部的超时(连接、重传)比wait_ms短时poll会提前返回
+        curl_multi_poll(multi_, nullptr, 0, (int)wait_ms, nullptr);
+    }
+
+    while (!transfers_.empty()) {
+        RemoveTransfer(transfers_.begin()->first);
+    }
+
+    for (CURL* easy : idle_easy_) {
+        curl_easy_cleanup(easy);
+    }
+    idle_easy_.clear();
+}
+
+void HttpManager::StartAttempt(Transfer* t) {
+    if (!t->easy) {
+        const HttpRequest& request = t->request;
+        t->easy = AcquireEasy();
+        for (const std::string& header : request.headers) {
+            t->headers = curl_slist_append(t->headers, header.c_str());
+        }
+
+        CURL* easy = t->easy;
+        curl_easy_setopt(easy, CURLOPT_URL, request.url.c_str());
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, t);
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &HttpManager::OnWrite);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, t);
+        curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, t->error);
+        curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(easy, CURLOPT_SHARE, share_);
+        curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, (long)request.timeout_ms);
+        curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, (long)request.connect_timeout_ms);
+        curl_easy_setopt(easy, CURLOPT_DNS_CACHE_TIMEOUT, kDnsCacheTimeoutS);
+        curl_easy_setopt(easy, CURLOPT_TCP_NODELAY, 1L);
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+        // HTTPS上协商HTTP/2，连接正在建立时等待复用而不是再开一个新连接
+        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+        if (t->headers) {
+            curl_easy_setopt(easy, CURLOPT_HTTPHEADER, t->headers);
+        }
+        if (!request.body.empty()) {
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)request.body.size());
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDS, request.body.c_str());
+        }
+    }
+
+    ++t->attempts;
+    t->body.clear();
+    t->error[0] = '\0';
+    CURLMcode code = curl_multi_add_handle(multi_, t->easy);
+    if (code != CURLM_OK) {
+        HttpResponse response;
+        response.curl_code = CURLE_FAILED_INIT;
+        response.error = curl_multi_strerror(code);
+        Finish(t, response);
+    }
+}
+
+void HttpManager::OnAttemptDone(Transfer* t, int curl_code) {
+    CURL* easy = t->easy;
+    curl_multi_remove_handle(multi_, easy);
+
+    long status = 0;
+    long connects = 0;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+    if (connects > 0) {
+        new_connections_.Add(connects);
+    }
+    else if (curl_code == CURLE_OK) {
+        reused_connections_.Add();
+    }
+
+    if (IsRetryable(curl_code, status) && t->attempts <= t->request.max_retries) {
+        int delay_ms = std::min(kMaxRetryDelayMs, kRetryBaseMs << (t->attempts - 1));
+        t->retry_at_ms = rtc::TimeMillis() + delay_ms;
+        retries_.Add();
+        RTC_LOG(LS_INFO) << "HttpManager retry in " << delay_ms << "ms, url: " << t->request.url
+            << ", attempt: " << t->attempts << ", status: " << status
+            << ", error: " << curl_easy_strerror((CURLcode)curl_code);
+        return;
+    }
+
+    int64_t dns_us = GetTimeUs(easy, CURLINFO_NAMELOOKUP_TIME_T);
+    int64_t connect_us = GetTimeUs(easy, CURLINFO_CONNECT_TIME_T);
+    int64_t tls_us = GetTimeUs(easy, CURLINFO_APPCONNECT_TIME_T);
+
+    HttpResponse response;
+    response.curl_code = curl_code;
+    response.status = (int)status;
+    response.body.swap(t->body);
+    if (curl_code != CURLE_OK) {
+        response.error = t->error[0] ? t->error : curl_easy_strerror((CURLcode)curl_code);
+    }
+    response.reused_connection = curl_code == CURLE_OK && connects == 0;
+    response.dns_us = dns_us;
+    response.connect_us = std::max<int64_t>(0, connect_us - dns_us);
+    response.tls_us = tls_us > 0 ? std::max<int64_t>(0, tls_us - connect_us) : 0;
+    response.first_byte_us = GetTimeUs(easy, CURLINFO_STARTTRANSFER_TIME_T);
+    response.total_us = GetTimeUs(easy, CURLINFO_TOTAL_TIME_T);
+    Finish(t, response);
+}
+
+// 结果投递到callback_thread，执行时再检查一次是否已经取消
+void HttpManager::Finish(Transfer* t, const HttpResponse& result) {
+    HttpResponse response = result;
+    response.attempts = t->attempts;
+    response.elapsed_ms = rtc::TimeMillis() - t->start_ms;
+    latency_ms_.Add(response.elapsed_ms);
+    if (!response.ok()) {
+        failures_.Add();
+        RTC_LOG(LS_WARNING) << "HttpManager request failed, url: " << t->request.url
+            << ", status: " << response.status << ", error: " << response.error
+            << ", attempts: " << response.attempts;
+    }
+
+    int64_t id = t->id;
+    RemoveTransfer(id);
+
+    callback_thread_->PostTask(webrtc::ToQueuedTask([this, id, response]() {
+        HttpCallback callback;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = callbacks_.find(id);
+            if (it == callbacks_.end()) {
+                return;
+            }
+            callback = std::move(it->second);
+            callbacks_.erase(it);
+        }
+
+        if (callback) {
+            callback(response);
+        }
+    }));
+}
+
+CURL* HttpManager::AcquireEasy() {
+    if (idle_easy_.empty()) {
+        return curl_easy_init();
+    }
+
+    CURL* easy = idle_easy_.back();
+    idle_easy_.pop_back();
+    return easy;
+}
+
+void HttpManager::ReleaseEasy(CURL* easy) {
+    if (idle_easy_.size() >= kMaxIdleEasyHandles) {
+        curl_easy_cleanup(easy);
+        return;
+    }
+
+    curl_easy_reset(easy);
+    idle_easy_.push_back(easy);
+}
+
+// 不在multi句柄中(等待重试或者已经完成)时curl_multi_remove_handle直接返回
+void HttpManager::RemoveTransfer(int64_t id) {
+    auto it = transfers_.find(id);
+    if (it == transfers_.end()) {
+        return;
+    }
+
+    Transfer* t = it->second.get();
+    if (t->easy) {
+        curl_multi_remove_handle(multi_, t->easy);
+        ReleaseEasy(t->easy);
+    }
+    if (t->headers) {
+        curl_slist_free_all(t->headers);
+    }
+    transfers_.erase(it);
+}
+
+size_t HttpManager::OnWrite(char* data, size_t size, size_t nmemb, void* user_data) {
+    Transfer* t = static_cast<Transfer*>(user_data);
+    t->body.append(data, size * nmemb);
+    return size * nmemb;
+}
+
+} // namespace xrtc
@@ -0,0 +1,125 @@
+﻿#ifndef XRTCSDK_XRTC_BASE_HTTP_MANAGER_H_
+#define XRTCSDK_XRTC_BASE_HTTP_MANAGER_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rtc_base/thread.h>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/base/xrtc_stats.h"
+
+typedef void CURLM;
+typedef void CURLSH;
+typedef void CURL;
+struct curl_slist;
+
+namespace xrtc {
+
+struct HttpRequest {
+    std::string url;
+    std::string body;//非空时用POST
+    std::vector<std::string> headers;//"Name: value"
+    int timeout_ms = 5000;//单次尝试的总超时，包含建立连接
+    int connect_timeout_ms = 3000;
+    int max_retries = 2;//连接失败、超时和5xx时重试的次数，按指数退避
+};
+
+struct HttpResponse {
+    int curl_code = 0;//CURLcode，0表示传输成功
+    int status = 0;//HTTP状态码
+    std::string body;
+    std::string error;
+    int attempts = 0;
+    int64_t elapsed_ms = 0;//从Send到得到结果，包含重试的等待
+    // 最后一次尝试的耗时分解(微秒)，复用连接时dns/connect/tls都接近0
+    bool reused_connection = false;
+    int64_t dns_us = 0;
+    int64_t connect_us = 0;
+    int64_t tls_us = 0;
+    int64_t first_byte_us = 0;
+    int64_t total_us = 0;
+
+    bool ok() const { return curl_code == 0 && status >= 200 && status < 300; }
+};
+
+using HttpCallback = std::function<void(const HttpResponse& response)>;
+
+// 基于curl_multi的异步HTTP客户端，请求可以在任意线程发起，回调在callback_thread(network_thread)上执行
+// 所有请求共用一个multi句柄和一个share句柄，DNS缓存、TLS会话和保持的连接在请求之间复用，
+// 信令的第二次往返不再有DNS/TCP/TLS握手；HTTPS上优先HTTP/2，并发的请求复用同一个连接
+// curl的socket等待(curl_multi_poll)在内部的IO线程上，network_thread的socket server不能等待curl的fd
+class HttpManager {
+public:
+    explicit HttpManager(rtc::Thread* callback_thread);
+    ~HttpManager();
+
+    HttpManager(const HttpManager&) = delete;
+    HttpManager& operator=(const HttpManager&) = delete;
+
+    // 返回请求id，callback可以为空(例如结束推流的通知)
+    int64_t Send(const HttpRequest& request, HttpCallback callback);
+    // 在callback_thread上调用时，返回之后回调一定不会再执行
+    void Cancel(int64_t id);
+
+    void GetStats(JsonObject& stats);
+
+private:
+    struct Transfer {
+        int64_t id = 0;
+        HttpRequest request;
+        CURL* easy = nullptr;
+        curl_slist* headers = nullptr;
+        std::string body;
+        char error[256];
+        int attempts = 0;
+        int64_t start_ms = 0;
+        int64_t retry_at_ms = 0;//等待重试时不在multi句柄中
+    };
+
+    void Run();
+    void StartAttempt(Transfer* transfer);
+    void OnAttemptDone(Transfer* transfer, int curl_code);
+    void Finish(Transfer* transfer, const HttpResponse& response);
+    CURL* AcquireEasy();
+    void ReleaseEasy(CURL* easy);
+    void RemoveTransfer(int64_t id);
+
+    static size_t OnWrite(char* data, size_t size, size_t nmemb, void* user_data);
+
+private:
+    rtc::Thread* callback_thread_;
+    CURLM* multi_ = nullptr;
+    CURLSH* share_ = nullptr;
+    std::thread io_thread_;
+
+    std::mutex mutex_;
+    int64_t next_id_ = 1;
+    std::vector<std::unique_ptr<Transfer>> pending_;//等待IO线程接收的新请求
+    std::vector<int64_t> cancelled_;
+    std::map<int64_t, HttpCallback> callbacks_;//还没有回调的请求，Cancel从这里删除
+    bool quit_ = false;
+
+    // 以下只在IO线程上访问
+    std::map<int64_t, std::unique_ptr<Transfer>> transfers_;
+    std::vector<CURL*> idle_easy_;//复用easy句柄，减少分配
+
+    StatsCounter requests_;
+    StatsCounter failures_;
+    StatsCounter retries_;
+    StatsCounter new_connections_;
+    StatsCounter reused_connections_;
+    AverageCounter latency_ms_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_BASE_HTTP_MANAGER_H_
@@ -0,0 +1,117 @@
+﻿#include "xrtc/base/rcu_list.h"
+
+#include <condition_variable>
+
+namespace xrtc {
+
+namespace {
+
+// 每个线程一个，0表示不在读，否则为进入时的epoch
+struct ReaderSlot {
+    std::atomic<uint64_t> epoch{ 0 };
+    int nesting = 0;
+};
+
+struct EpochState {
+    std::atomic<uint64_t> epoch{ 1 };
+    std::atomic<int> waiters{ 0 };
+    std::mutex mutex;//保护slots，Synchronize也在上面等待
+    std::condition_variable cond;
+    std::vector<ReaderSlot*> slots;
+};
+
+// 不析构，线程退出时可能还要注销
+EpochState& State() {
+    static EpochState* state = new EpochState();
+    return *state;
+}
+
+bool PassedLocked(EpochState& state, uint64_t epoch, const ReaderSlot* self) {
+    for (const ReaderSlot* slot : state.slots) {
+        if (slot == self) {
+            continue;
+        }
+        uint64_t reader_epoch = slot->epoch.load();
+        if (reader_epoch != 0 && reader_epoch <= epoch) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Notify(EpochState& state) {
+    // waiters在Synchronize加锁后增加，这里读到0时等待方检查条件一定能看到槽已清零
+    if (state.waiters.load() > 0) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.cond.notify_all();
+    }
+}
+
+class ThreadSlot {
+public:
+    ThreadSlot() {
+        EpochState& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.slots.push_back(&slot_);
+    }
+
+    ~ThreadSlot() {
+        EpochState& state = State();
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.slots.erase(std::find(state.slots.begin(), state.slots.end(), &slot_));
+        }
+        state.cond.notify_all();
+    }
+
+    ReaderSlot* slot() { return &slot_; }
+
+private:
+    ReaderSlot slot_;
+};
+
+ReaderSlot* LocalSlot() {
+    static thread_local ThreadSlot thread_slot;
+    return thread_slot.slot();
+}
+
+} // namespace
+
+void RcuEpoch::ReadLock() {
+    ReaderSlot* slot = LocalSlot();
+    if (slot->nesting++ == 0) {
+        // seq_cst：之后load列表指针一定不早于这次登记
+        slot->epoch.store(State().epoch.load());
+    }
+}
+
+void RcuEpoch::ReadUnlock() {
+    ReaderSlot* slot = LocalSlot();
+    if (--slot->nesting == 0) {
+        slot->epoch.store(0);
+        Notify(State());
+    }
+}
+
+uint64_t RcuEpoch::Advance() {
+    return State().epoch.fetch_add(1);
+}
+
+bool RcuEpoch::Passed(uint64_t epoch) {
+    EpochState& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return PassedLocked(state, epoch, nullptr);
+}
+
+void RcuEpoch::Synchronize(uint64_t epoch) {
+    EpochState& state = State();
+    const ReaderSlot* self = LocalSlot();
+    std::unique_lock<std::mutex> lock(state.mutex);
+    ++state.waiters;
+    state.cond.wait(lock, [&state, epoch, self] {
+        return PassedLocked(state, epoch, self);
+    });
+    --state.waiters;
+}
+
+} // namespace xrtc
@@ -0,0 +1,119 @@
+﻿#ifndef XRTCSDK_XRTC_BASE_RCU_LIST_H_
+#define XRTCSDK_XRTC_BASE_RCU_LIST_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace xrtc {
+
+// 基于epoch的读者登记，所有RcuList共用
+// 每个线程第一次读时登记一个槽，读者只写自己的槽，线程之间没有共享的计数
+class RcuEpoch {
+public:
+    // 读者进入/离开，可以嵌套
+    static void ReadLock();
+    static void ReadUnlock();
+
+    // 写者替换指针之后调用，返回的epoch之前进入的读者都离开后宽限期结束
+    static uint64_t Advance();
+    // 宽限期是否已经结束，不阻塞
+    static bool Passed(uint64_t epoch);
+    // 阻塞等待宽限期结束(读者离开时唤醒，不忙等)，不等待当前线程自己
+    static void Synchronize(uint64_t epoch);
+};
+
+// 读多写少的列表(copy-on-write)
+// 读：ForEach只写本线程的epoch槽和一次指针load，不加锁、不分配内存，可以在任意线程上调用
+// 写：Add/Remove拷贝一份新列表替换旧列表，加锁串行；旧列表在宽限期结束后的下一次写入或析构时释放
+// Remove返回后保证不会再有针对被移除元素的回调(阻塞等待正在遍历旧列表的其它线程结束)
+// 在ForEach的回调里Remove自身时无法等待，只保证之后的遍历不再包含该元素
+template <typename T>
+class RcuList {
+public:
+    using List = std::vector<T>;
+
+    RcuList() : list_(new List()) {}
+    ~RcuList() {
+        delete list_.load();
+        for (auto& retired : retired_) {
+            delete retired.second;
+        }
+    }
+
+    RcuList(const RcuList&) = delete;
+    RcuList& operator=(const RcuList&) = delete;
+
+    bool Add(const T& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const List* old_list = list_.load();
+        if (std::find(old_list->begin(), old_list->end(), item) != old_list->end()) {
+            return false;
+        }
+
+        List* new_list = new List(*old_list);
+        new_list->push_back(item);
+        Publish(new_list);
+        return true;
+    }
+
+    bool Remove(const T& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const List* old_list = list_.load();
+        auto iter = std::find(old_list->begin(), old_list->end(), item);
+        if (iter == old_list->end()) {
+            return false;
+        }
+
+        List* new_list = new List(old_list->begin(), iter);
+        new_list->insert(new_list->end(), iter + 1, old_list->end());
+        // 等待其它线程上遍历旧列表的读者结束，之后被移除的元素不会再被回调
+        RcuEpoch::Synchronize(Publish(new_list));
+        return true;
+    }
+
+    template <typename F>
+    void ForEach(F&& func) {
+        // 先登记epoch再load列表，写者在exchange之后看到的读者都可能持有旧列表
+        RcuEpoch::ReadLock();
+        const List* list = list_.load();
+        for (const T& item : *list) {
+            func(item);
+        }
+        RcuEpoch::ReadUnlock();
+    }
+
+    size_t size() const {
+        return list_.load()->size();
+    }
+
+private:
+    // 替换列表，旧列表挂到retired_，释放宽限期已经结束的旧列表，返回本次的epoch，需持有mutex_
+    uint64_t Publish(List* new_list) {
+        List* old_list = list_.exchange(new_list);
+        uint64_t epoch = RcuEpoch::Advance();
+        retired_.emplace_back(epoch, old_list);
+
+        auto iter = retired_.begin();
+        while (iter != retired_.end() && RcuEpoch::Passed(iter->first)) {
+            delete iter->second;
+            ++iter;
+        }
+        retired_.erase(retired_.begin(), iter);
+        return epoch;
+    }
+
+private:
+    std::mutex mutex_;//只在写入时使用
+    std::atomic<List*> list_;
+    std::vector<std::pair<uint64_t, List*>> retired_;//按epoch递增排列
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_BASE_RCU_LIST_H_
@@ -0,0 +1,269 @@
+﻿#include "xrtc/base/task_pool.h"
+
+#include <rtc_base/logging.h>
+#include <rtc_base/platform_thread_types.h>
+#include <rtc_base/time_utils.h>
+
+namespace xrtc {
+
+namespace {
+
+// 一次调度最多连续执行的任务数，超过后重新排队，避免一路流长期占住线程
+const int kMaxBatchTasks = 8;
+
+// 当前线程在哪个线程池中的序号，用于本地投递
+thread_local TaskPool* tls_pool = nullptr;
+thread_local int tls_worker_index = -1;
+
+} // namespace
+
+TaskPool::TaskPool(int num_threads, const std::string& name, const ThreadConfig& config) :
+    name_(name),
+    config_(config)
+{
+    if (num_threads <= 0) {
+        num_threads = (int)std::thread::hardware_concurrency();
+    }
+    if (num_threads <= 0) {
+        num_threads = 2;
+    }
+
+    for (int i = 0; i < num_threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+        workers_[i]->stats = std::make_unique<ThreadStats>(name_ + "_" + std::to_string(i));
+    }
+
+    for (int i = 0; i < num_threads; ++i) {
+        workers_[i]->thread = std::thread([this, i]() {
+            Run(i);
+        });
+    }
+
+    RTC_LOG(LS_INFO) << "TaskPool " << name_ << " started with " << num_threads << " threads";
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        quit_ = true;
+    }
+    wake_cv_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+void TaskPool::PostTask(std::function<void()> task) {
+    // 线程池内部投递的任务放到自己的队列，数据还在本核的缓存中
+    int index = (tls_pool == this) ? tls_worker_index :
+        (int)(next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size());
+
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+        workers_[index]->tasks.push_back(std::move(task));
+    }
+
+    pending_.fetch_add(1);
+    if (sleeping_.load() > 0) {
+        // 和等待者的检查串行，避免丢失唤醒
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_request_us_ = rtc::TimeMicros();
+        wake_cv_.notify_one();
+    }
+}
+
+std::vector<ThreadStats*> TaskPool::thread_stats() const {
+    std::vector<ThreadStats*> stats;
+    for (auto& worker : workers_) {
+        stats.push_back(worker->stats.get());
+    }
+    return stats;
+}
+
+std::unique_ptr<SerialTaskQueue> TaskPool::CreateSerialQueue() {
+    return std::make_unique<SerialTaskQueue>(this);
+}
+
+// 先取自己队列的头部，再从其他线程的队列尾部窃取
+// 窃取时先try_lock跳过正忙的队列；都没取到时阻塞在正忙的队列上再取一遍，
+// 否则pending_>0时Run的等待条件一直成立，线程会反复空转
+bool TaskPool::PopTask(int index, std::function<void()>& task) {
+    int count = (int)workers_.size();
+    bool skipped = false;
+    for (int i = 0; i < count; ++i) {
+        Worker* worker = workers_[(index + i) % count].get();
+        std::unique_lock<std::mutex> lock(worker->mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            if (i != 0) {
+                skipped = true;
+                continue;
+            }
+            lock.lock();
+        }
+        if (TakeTask(worker, i == 0, task)) {
+            return true;
+        }
+    }
+
+    for (int i = 1; skipped && i < count; ++i) {
+        Worker* worker = workers_[(index + i) % count].get();
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        if (TakeTask(worker, false, task)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// 需持有worker->mutex，自己的队列取头部，窃取取尾部
+bool TaskPool::TakeTask(Worker* worker, bool own, std::function<void()>& task) {
+    if (worker->tasks.empty()) {
+        return false;
+    }
+
+    if (own) {
+        task = std::move(worker->tasks.front());
+        worker->tasks.pop_front();
+    }
+    else {
+        task = std::move(worker->tasks.back());
+        worker->tasks.pop_back();
+    }
+    pending_.fetch_sub(1);
+    return true;
+}
+
+void TaskPool::Run(int index) {
+    ThreadStats* stats = workers_[index]->stats.get();
+    rtc::SetCurrentThreadName(stats->name().c_str());
+    ApplyCurrentThreadConfig(stats->name(), config_);
+    stats->BindCurrentThread();
+    tls_pool = this;
+    tls_worker_index = index;
+
+    std::function<void()> task;
+    while (true) {
+        if (PopTask(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        sleeping_.fetch_add(1);
+        wake_cv_.wait(lock, [this]() {
+            return quit_ || pending_.load() > 0;
+        });
+        sleeping_.fetch_sub(1);
+        if (quit_) {
+            break;
+        }
+
+        int64_t wake_request_us = wake_request_us_.exchange(0);
+        if (wake_request_us != 0) {
+            stats->AddWakeupLatency(rtc::TimeMicros() - wake_request_us);
+        }
+    }
+}
+
+SerialTaskQueue::SerialTaskQueue(TaskPool* pool) :
+    pool_(pool)
+{
+}
+
+SerialTaskQueue::~SerialTaskQueue() {
+    Stop();
+}
+
+void SerialTaskQueue::PostTask(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_) {
+            return;
+        }
+
+        tasks_.push_back(std::move(task));
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        if (scheduled_) {
+            return;
+        }
+        scheduled_ = true;
+    }
+
+    pool_->PostTask([this]() {
+        RunBatch();
+    });
+}
+
+void SerialTaskQueue::Invoke(std::function<void()> task) {
+    if (IsCurrent()) {
+        task();
+        return;
+    }
+
+    bool done = false;
+    PostTask([&]() {
+        task();
+        std::lock_guard<std::mutex> lock(mutex_);
+        done = true;
+        idle_cv_.notify_all();
+    });
+
+    // 队列被Stop时任务可能被丢弃，等正在执行的任务结束后返回
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_cv_.wait(lock, [&]() { return done || (stopped_ && !scheduled_); });
+}
+
+void SerialTaskQueue::Stop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopped_ = true;
+    pending_.fetch_sub((int)tasks_.size(), std::memory_order_relaxed);
+    tasks_.clear();
+    idle_cv_.notify_all();
+    idle_cv_.wait(lock, [this]() { return !scheduled_; });
+}
+
+bool SerialTaskQueue::IsCurrent() const {
+    return running_thread_.load() == std::this_thread::get_id();
+}
+
+void SerialTaskQueue::RunBatch() {
+    for (int i = 0; i < kMaxBatchTasks; ++i) {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (tasks_.empty()) {
+                scheduled_ = false;
+                idle_cv_.notify_all();
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        running_thread_ = std::this_thread::get_id();
+        task();
+        running_thread_ = std::thread::id();
+    }
+
+    // 还有任务，重新排队让其他流的任务先执行
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) {
+            scheduled_ = false;
+            idle_cv_.notify_all();
+            return;
+        }
+    }
+
+    pool_->PostTask([this]() {
+        RunBatch();
+    });
+}
+
+} // namespace xrtc
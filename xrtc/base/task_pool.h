@@ -0,0 +1,102 @@
+﻿#ifndef XRTCSDK_XRTC_BASE_TASK_POOL_H_
+#define XRTCSDK_XRTC_BASE_TASK_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "xrtc/base/thread_config.h"
+
+namespace xrtc {
+
+class SerialTaskQueue;
+
+// 工作窃取线程池：每个线程有自己的任务队列，空闲时从其他线程的队列尾部窃取任务
+// 任务之间没有顺序保证，需要按顺序执行的任务放到SerialTaskQueue中
+class TaskPool {
+public:
+    // num_threads为0时按CPU核数创建，config应用到每个线程
+    explicit TaskPool(int num_threads = 0, const std::string& name = "media_pool",
+        const ThreadConfig& config = ThreadConfig());
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    void PostTask(std::function<void()> task);
+    // 创建一个在本线程池上执行的串行队列，例如每路流一个
+    std::unique_ptr<SerialTaskQueue> CreateSerialQueue();
+
+    int num_threads() const { return (int)workers_.size(); }
+    // 每个线程的CPU时间和唤醒延时(从投递唤醒到线程开始取任务)
+    std::vector<ThreadStats*> thread_stats() const;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+        std::thread thread;
+        std::unique_ptr<ThreadStats> stats;
+    };
+
+    void Run(int index);
+    bool PopTask(int index, std::function<void()>& task);
+    bool TakeTask(Worker* worker, bool own, std::function<void()>& task);
+
+private:
+    std::string name_;
+    ThreadConfig config_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<uint32_t> next_worker_{ 0 };//外部线程投递时轮询选择
+    std::atomic<int> pending_{ 0 };//所有队列中还没有开始执行的任务数
+    std::atomic<int> sleeping_{ 0 };//等待任务的线程数，为0时投递不需要加锁唤醒
+    std::atomic<int64_t> wake_request_us_{ 0 };//最近一次唤醒请求的时间，用于统计唤醒延时
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    bool quit_ = false;
+};
+
+// 串行任务队列：任务按投递顺序依次执行，同一时刻最多一个线程在执行，但不固定在某个线程上
+class SerialTaskQueue {
+public:
+    explicit SerialTaskQueue(TaskPool* pool);
+    ~SerialTaskQueue();
+
+    SerialTaskQueue(const SerialTaskQueue&) = delete;
+    SerialTaskQueue& operator=(const SerialTaskQueue&) = delete;
+
+    void PostTask(std::function<void()> task);
+    // 同步执行，在本队列的任务中调用时直接执行
+    void Invoke(std::function<void()> task);
+    // 等待之前投递的任务执行完成
+    void Flush() { Invoke([]() {}); }
+    // 丢弃还没有执行的任务并等待正在执行的任务结束，之后的投递被忽略
+    // 不能在本队列的任务中调用
+    void Stop();
+
+    bool IsCurrent() const;
+    int pending() const { return pending_.load(std::memory_order_relaxed); }
+
+private:
+    void RunBatch();
+
+private:
+    TaskPool* pool_;
+    mutable std::mutex mutex_;
+    std::condition_variable idle_cv_;
+    std::deque<std::function<void()>> tasks_;
+    bool scheduled_ = false;//已经投递到线程池或者正在执行
+    bool stopped_ = false;
+    std::atomic<int> pending_{ 0 };
+    std::atomic<std::thread::id> running_thread_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_BASE_TASK_POOL_H_
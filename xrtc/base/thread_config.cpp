@@ -0,0 +1,367 @@
+﻿#include "xrtc/base/thread_config.h"
+
+#include <algorithm>
+
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+#if defined(WEBRTC_WIN)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fstream>
+#endif
+
+#include "xrtc/base/xrtc_json.h"
+
+namespace xrtc {
+
+namespace {
+
+const int kDefaultRtPriority = 50;
+
+ThreadPriority ParsePriority(const std::string& priority) {
+    if (priority == "high") {
+        return ThreadPriority::kHigh;
+    }
+    else if (priority == "highest") {
+        return ThreadPriority::kHighest;
+    }
+    else if (priority == "realtime") {
+        return ThreadPriority::kRealtime;
+    }
+    return ThreadPriority::kNormal;
+}
+
+SchedPolicy ParsePolicy(const std::string& policy) {
+    if (policy == "fifo") {
+        return SchedPolicy::kFifo;
+    }
+    else if (policy == "rr") {
+        return SchedPolicy::kRoundRobin;
+    }
+    return SchedPolicy::kDefault;
+}
+
+#if !defined(WEBRTC_WIN)
+
+// 解析/sys下的cpulist，例如"0-3,8-11"
+std::vector<int> NumaNodeCpus(int node) {
+    std::vector<int> cpus;
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!std::getline(file, list)) {
+        return cpus;
+    }
+
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+
+        std::string range = list.substr(pos, end - pos);
+        size_t dash = range.find('-');
+        int first = atoi(range.c_str());
+        int last = (dash == std::string::npos) ? first : atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+// 内存优先从指定节点分配，不依赖libnuma
+void PreferNumaNode(const std::string& name, int node) {
+#if defined(SYS_set_mempolicy)
+    const int kMpolPreferred = 1;
+    unsigned long mask = 1UL << node;
+    if (node >= (int)(sizeof(mask) * 8) ||
+        syscall(SYS_set_mempolicy, kMpolPreferred, &mask, sizeof(mask) * 8) != 0)
+    {
+        RTC_LOG(LS_WARNING) << name << " set_mempolicy node " << node
+            << " failed: " << strerror(errno);
+    }
+#endif
+}
+
+bool SetPriority(const std::string& name, const ThreadConfig& config) {
+    int policy = SCHED_OTHER;
+    if (config.policy == SchedPolicy::kFifo ||
+        (config.policy == SchedPolicy::kDefault && config.priority == ThreadPriority::kRealtime))
+    {
+        policy = SCHED_FIFO;
+    }
+    else if (config.policy == SchedPolicy::kRoundRobin) {
+        policy = SCHED_RR;
+    }
+
+    if (policy != SCHED_OTHER) {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = config.rt_priority > 0 ? config.rt_priority : kDefaultRtPriority;
+        int res = pthread_setschedparam(pthread_self(), policy, &param);
+        if (res == 0) {
+            return true;
+        }
+
+        // 没有CAP_SYS_NICE或者RLIMIT_RTPRIO不够时退回到nice值
+        RTC_LOG(LS_WARNING) << name << " set "
+            << (policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR")
+            << " failed: " << strerror(res) << ", fallback to nice";
+    }
+
+    int nice_value = 0;
+    switch (config.priority) {
+    case ThreadPriority::kHigh:
+        nice_value = -5;
+        break;
+    case ThreadPriority::kHighest:
+    case ThreadPriority::kRealtime:
+        nice_value = -10;
+        break;
+    default:
+        return true;
+    }
+
+    // Linux上nice值是按线程生效的
+    if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice_value) != 0) {
+        RTC_LOG(LS_WARNING) << name << " setpriority " << nice_value
+            << " failed: " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool SetAffinity(const std::string& name, const std::vector<int>& cpus) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpu_set);
+        }
+    }
+
+    int res = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (res != 0) {
+        RTC_LOG(LS_WARNING) << name << " set affinity failed: " << strerror(res);
+        return false;
+    }
+    return true;
+}
+
+#else
+
+std::vector<int> NumaNodeCpus(int node) {
+    std::vector<int> cpus;
+    ULONGLONG node_mask = 0;
+    if (!GetNumaNodeProcessorMask((UCHAR)node, &node_mask)) {
+        return cpus;
+    }
+
+    for (int cpu = 0; cpu < 64; ++cpu) {
+        if (node_mask & (1ULL << cpu)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+bool SetPriority(const std::string& name, const ThreadConfig& config) {
+    int priority = THREAD_PRIORITY_NORMAL;
+    switch (config.priority) {
+    case ThreadPriority::kHigh:
+        priority = THREAD_PRIORITY_ABOVE_NORMAL;
+        break;
+    case ThreadPriority::kHighest:
+        priority = THREAD_PRIORITY_HIGHEST;
+        break;
+    case ThreadPriority::kRealtime:
+        priority = THREAD_PRIORITY_TIME_CRITICAL;
+        break;
+    default:
+        return true;
+    }
+
+    if (!SetThreadPriority(GetCurrentThread(), priority)) {
+        RTC_LOG(LS_WARNING) << name << " SetThreadPriority failed: " << GetLastError();
+        return false;
+    }
+    return true;
+}
+
+bool SetAffinity(const std::string& name, const std::vector<int>& cpus) {
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < (int)(sizeof(mask) * 8)) {
+            mask |= (DWORD_PTR)1 << cpu;
+        }
+    }
+
+    if (!SetThreadAffinityMask(GetCurrentThread(), mask)) {
+        RTC_LOG(LS_WARNING) << name << " SetThreadAffinityMask failed: " << GetLastError();
+        return false;
+    }
+    return true;
+}
+
+#endif
+
+} // namespace
+
+ThreadConfig ThreadConfig::FromJson(const JsonObject& jobject) {
+    ThreadConfig config;
+    if (jobject.Has("priority")) {
+        config.priority = ParsePriority(jobject["priority"].ToString());
+    }
+    if (jobject.Has("policy")) {
+        config.policy = ParsePolicy(jobject["policy"].ToString());
+    }
+    config.rt_priority = (int)jobject["rt_priority"].ToInt(0);
+    if (jobject.Has("cpus")) {
+        JsonArray jcpus = jobject["cpus"].ToArray();
+        for (int i = 0; i < jcpus.Size(); ++i) {
+            config.cpus.push_back((int)jcpus[i].ToInt());
+        }
+    }
+    if (jobject.Has("numa_node")) {
+        config.numa_node = (int)jobject["numa_node"].ToInt();
+    }
+    return config;
+}
+
+bool ApplyCurrentThreadConfig(const std::string& name, const ThreadConfig& config) {
+    bool ok = SetPriority(name, config);
+
+    std::vector<int> cpus = config.cpus;
+    if (config.numa_node >= 0) {
+#if !defined(WEBRTC_WIN)
+        PreferNumaNode(name, config.numa_node);
+#endif
+        std::vector<int> node_cpus = NumaNodeCpus(config.numa_node);
+        if (cpus.empty()) {
+            cpus = node_cpus;
+        }
+        else {
+            std::vector<int> both;
+            for (int cpu : cpus) {
+                if (std::find(node_cpus.begin(), node_cpus.end(), cpu) != node_cpus.end()) {
+                    both.push_back(cpu);
+                }
+            }
+            cpus = both.empty() ? cpus : both;
+        }
+    }
+
+    if (!cpus.empty()) {
+        ok = SetAffinity(name, cpus) && ok;
+    }
+
+    RTC_LOG(LS_INFO) << name << " thread config applied, priority: " << (int)config.priority
+        << ", policy: " << (int)config.policy << ", cpus: " << cpus.size()
+        << ", numa_node: " << config.numa_node;
+    return ok;
+}
+
+ThreadStats::ThreadStats(const std::string& name) :
+    name_(name)
+{
+}
+
+ThreadStats::~ThreadStats() {
+#if defined(WEBRTC_WIN)
+    if (thread_handle_) {
+        CloseHandle(thread_handle_);
+    }
+#endif
+}
+
+void ThreadStats::BindCurrentThread() {
+#if defined(WEBRTC_WIN)
+    HANDLE handle = nullptr;
+    if (!DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(),
+        &handle, THREAD_QUERY_LIMITED_INFORMATION, FALSE, 0))
+    {
+        return;
+    }
+    thread_handle_ = handle;
+#else
+    clockid_t clock_id;
+    if (pthread_getcpuclockid(pthread_self(), &clock_id) != 0) {
+        return;
+    }
+    clock_id_ = (int)clock_id;
+#endif
+    bound_ = true;
+}
+
+void ThreadStats::AddWakeupLatency(int64_t latency_us) {
+    if (latency_us < 0) {
+        latency_us = 0;
+    }
+    wakeup_us_.Add(latency_us);
+
+    int64_t max_us = wakeup_max_us_.load(std::memory_order_relaxed);
+    while (latency_us > max_us &&
+        !wakeup_max_us_.compare_exchange_weak(max_us, latency_us, std::memory_order_relaxed))
+    {
+    }
+}
+
+int64_t ThreadStats::CpuTimeUs() {
+    if (!bound_) {
+        return 0;
+    }
+
+#if defined(WEBRTC_WIN)
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(thread_handle_, &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (int64_t)((k.QuadPart + u.QuadPart) / 10);//100ns
+#else
+    timespec ts;
+    if (clock_gettime((clockid_t)clock_id_, &ts) != 0) {
+        return 0;
+    }
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+void ThreadStats::GetStats(JsonObject& stats) {
+    int64_t cpu_us = CpuTimeUs();
+    int64_t now_us = rtc::TimeMicros();
+
+    double usage = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (last_ts_us_ != 0 && now_us > last_ts_us_) {
+            usage = 100.0 * (cpu_us - last_cpu_us_) / (now_us - last_ts_us_);
+        }
+        last_cpu_us_ = cpu_us;
+        last_ts_us_ = now_us;
+    }
+
+    stats["name"] = name_;
+    stats["cpu_ms"] = cpu_us / 1000;
+    stats["cpu_usage"] = usage;
+    stats["wakeup_us"] = wakeup_us_.Average();
+    stats["wakeup_max_us"] = wakeup_max_us_.exchange(0, std::memory_order_relaxed);//两次拉取之间的最大值
+}
+
+} // namespace xrtc
@@ -0,0 +1,85 @@
+﻿#ifndef XRTCSDK_XRTC_BASE_THREAD_CONFIG_H_
+#define XRTCSDK_XRTC_BASE_THREAD_CONFIG_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "xrtc/base/xrtc_stats.h"
+
+namespace xrtc {
+
+class JsonObject;
+
+enum class ThreadPriority {
+    kNormal,
+    kHigh,
+    kHighest,
+    kRealtime,//Linux上使用SCHED_FIFO，没有权限时退回到kHighest
+};
+
+// 调度策略，只在Linux上生效
+enum class SchedPolicy {
+    kDefault,
+    kFifo,
+    kRoundRobin,
+};
+
+// 线程配置，json格式：
+// {"priority":"realtime","policy":"fifo","rt_priority":50,"cpus":[2,3],"numa_node":0}
+// priority: normal/high/highest/realtime, policy: default/fifo/rr
+// cpus和numa_node同时设置时绑定到两者的交集
+struct ThreadConfig {
+    ThreadPriority priority = ThreadPriority::kNormal;
+    SchedPolicy policy = SchedPolicy::kDefault;
+    int rt_priority = 0;//SCHED_FIFO/RR的优先级，1-99，0表示使用默认值
+    std::vector<int> cpus;//绑定的核，空表示不绑定
+    int numa_node = -1;//-1表示不指定
+
+    static ThreadConfig FromJson(const JsonObject& jobject);
+};
+
+// 在目标线程上调用，应用失败的项只记录日志，不影响线程运行
+bool ApplyCurrentThreadConfig(const std::string& name, const ThreadConfig& config);
+
+// 线程运行统计：CPU时间和唤醒延时，用于验证线程配置的效果
+class ThreadStats {
+public:
+    explicit ThreadStats(const std::string& name);
+    ~ThreadStats();
+
+    const std::string& name() const { return name_; }
+
+    // 在被统计的线程上调用一次，记录读取CPU时间需要的句柄
+    void BindCurrentThread();
+    // 唤醒延时：线程应该开始执行到实际开始执行的时间
+    void AddWakeupLatency(int64_t latency_us);
+
+    // {"name","cpu_ms","cpu_usage","wakeup_us","wakeup_max_us"}，cpu_usage为两次拉取之间的百分比
+    void GetStats(JsonObject& stats);
+
+private:
+    int64_t CpuTimeUs();
+
+private:
+    std::string name_;
+    std::atomic<bool> bound_{ false };
+#if defined(WEBRTC_WIN)
+    void* thread_handle_ = nullptr;
+#else
+    int clock_id_ = 0;//clockid_t
+#endif
+    AverageCounter wakeup_us_;
+    std::atomic<int64_t> wakeup_max_us_{ 0 };
+
+    std::mutex mutex_;//只在拉取统计时使用
+    int64_t last_cpu_us_ = 0;
+    int64_t last_ts_us_ = 0;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_BASE_THREAD_CONFIG_H_
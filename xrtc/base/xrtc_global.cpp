@@ -1,35 +1,173 @@
 ﻿#include "xrtc/base/xrtc_global.h"
 
+#include <algorithm>
+
+#include <api/task_queue/default_task_queue_factory.h>
 #include <modules/video_capture/video_capture_factory.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/http_manager.h"
+#include "xrtc/base/xrtc_json.h"
 
 
 namespace xrtc {
 
+namespace {
+
+// 唤醒延时探测的间隔
+const int kWakeupProbeIntervalMs = 100;
+
+std::string& PendingThreadConfig() {
+    static std::string json_config;
+    return json_config;
+}
+
+bool g_instance_created = false;
+
+// 音频线程没有配置优先级时默认实时优先级，没有权限时退回到nice值
+ThreadConfig AudioThreadConfig(const JsonObject& jobject) {
+    ThreadConfig config = ThreadConfig::FromJson(jobject);
+    if (!jobject.Has("priority")) {
+        config.priority = ThreadPriority::kRealtime;
+    }
+    return config;
+}
+
+} // namespace
+
 // 单例
 XRTCGlobal* XRTCGlobal::Instance() {
     static XRTCGlobal* const instance = new XRTCGlobal();
     return instance;
 }
 
+bool XRTCGlobal::SetThreadConfig(const std::string& json_config) {
+    if (g_instance_created) {
+        RTC_LOG(LS_WARNING) << "XRTCGlobal already created, thread config ignored";
+        return false;
+    }
+
+    PendingThreadConfig() = json_config;
+    return true;
+}
+
 XRTCGlobal::XRTCGlobal() :
     api_thread_(rtc::Thread::Create()),
     worker_thread_(rtc::Thread::Create()),
     network_thread_(rtc::Thread::CreateWithSocketServer()),
-    video_device_info_(webrtc::VideoCaptureFactory::CreateDeviceInfo())
+    audio_thread_(rtc::Thread::Create()),
+    video_device_info_(webrtc::VideoCaptureFactory::CreateDeviceInfo()),
+    task_queue_factory_(webrtc::CreateDefaultTaskQueueFactory())
 {
-    api_thread_->SetName("api_thread", nullptr);
-    api_thread_->Start();
+    g_instance_created = true;
+
+    JsonObject jconfig;
+    JsonValue value;
+    if (!PendingThreadConfig().empty()) {
+        if (value.FromJson(PendingThreadConfig())) {
+            jconfig = value.ToObject();
+        }
+        else {
+            RTC_LOG(LS_WARNING) << "XRTCGlobal invalid thread config: " << PendingThreadConfig();
+        }
+    }
 
-    worker_thread_->SetName("worker_thread", nullptr);
-    worker_thread_->Start();
+    StartThread(api_thread_.get(), "api_thread",
+        ThreadConfig::FromJson(jconfig["api_thread"].ToObject(JsonObject())));
+    StartThread(worker_thread_.get(), "worker_thread",
+        ThreadConfig::FromJson(jconfig["worker_thread"].ToObject(JsonObject())));
+    StartThread(network_thread_.get(), "network_thread",
+        ThreadConfig::FromJson(jconfig["network_thread"].ToObject(JsonObject())));
+    http_manager_ = std::make_unique<HttpManager>(network_thread_.get());
 
-    network_thread_->SetName("network_thread", nullptr);
-    network_thread_->Start();
+    JsonObject jpool = jconfig["media_pool"].ToObject(JsonObject());
+    media_pool_ = std::make_unique<TaskPool>((int)jpool["threads"].ToInt(0), "media_pool",
+        ThreadConfig::FromJson(jpool));
 
+    // 音频每10ms一帧，计算量小，默认一个线程就够
+    StartThread(audio_thread_.get(), "audio_thread",
+        AudioThreadConfig(jconfig["audio_thread"].ToObject(JsonObject())));
+    JsonObject jaudio_pool = jconfig["audio_pool"].ToObject(JsonObject());
+    audio_pool_ = std::make_unique<TaskPool>((int)jaudio_pool["threads"].ToInt(1), "audio_pool",
+        AudioThreadConfig(jaudio_pool));
 }
 
 XRTCGlobal::~XRTCGlobal() {
 
 }
 
+// 启动线程后在线程内部应用配置，并开始周期性地探测唤醒延时
+void XRTCGlobal::StartThread(rtc::Thread* thread, const std::string& name,
+    const ThreadConfig& config)
+{
+    thread->SetName(name, nullptr);
+    thread->Start();
+
+    thread_stats_.push_back(std::make_unique<ThreadStats>(name));
+    ThreadStats* stats = thread_stats_.back().get();
+    thread->Invoke<void>(RTC_FROM_HERE, [&]() {
+        ApplyCurrentThreadConfig(name, config);
+        stats->BindCurrentThread();
+    });
+
+    ProbeWakeup(thread, stats);
+}
+
+// 延时任务实际执行的时间和预期时间的差，包含定时器1ms的精度
+void XRTCGlobal::ProbeWakeup(rtc::Thread* thread, ThreadStats* stats) {
+    int64_t expected_us = rtc::TimeMicros() + kWakeupProbeIntervalMs * 1000;
+    thread->PostDelayedTask(webrtc::ToQueuedTask([=]() {
+        stats->AddWakeupLatency(rtc::TimeMicros() - expected_us);
+        ProbeWakeup(thread, stats);
+    }), kWakeupProbeIntervalMs);
+}
+
+std::vector<ThreadStats*> XRTCGlobal::thread_stats() {
+    std::vector<ThreadStats*> stats;
+    for (auto& thread_stats : thread_stats_) {
+        stats.push_back(thread_stats.get());
+    }
+
+    std::vector<ThreadStats*> pool_stats = media_pool_->thread_stats();
+    stats.insert(stats.end(), pool_stats.begin(), pool_stats.end());
+    std::vector<ThreadStats*> audio_pool_stats = audio_pool_->thread_stats();
+    stats.insert(stats.end(), audio_pool_stats.begin(), audio_pool_stats.end());
+    return stats;
+}
+
+webrtc::AudioDeviceModule* XRTCGlobal::audio_device() {
+    if (audio_device_ || audio_device_failed_) {
+        return audio_device_.get();
+    }
+
+    audio_device_ = webrtc::AudioDeviceModule::Create(
+        webrtc::AudioDeviceModule::kPlatformDefaultAudio, task_queue_factory_.get());
+    if (!audio_device_ || audio_device_->Init() != 0) {
+        RTC_LOG(LS_WARNING) << "XRTCGlobal audio device init failed";
+        audio_device_ = nullptr;
+        audio_device_failed_ = true;
+    }
+    return audio_device_.get();
+}
+
+void XRTCGlobal::AddVideoSource(IVideoSource* video_source) {
+    video_sources_.push_back(video_source);
+}
+
+void XRTCGlobal::RemoveVideoSource(IVideoSource* video_source) {
+    video_sources_.erase(std::remove(video_sources_.begin(), video_sources_.end(),
+        video_source), video_sources_.end());
+}
+
+void XRTCGlobal::AddAudioSource(IAudioSource* audio_source) {
+    audio_sources_.push_back(audio_source);
+}
+
+void XRTCGlobal::RemoveAudioSource(IAudioSource* audio_source) {
+    audio_sources_.erase(std::remove(audio_sources_.begin(), audio_sources_.end(),
+        audio_source), audio_sources_.end());
+}
+
 } // namespace xrtc
\ No newline at end of file
@@ -1,19 +1,30 @@
 ﻿#ifndef XRTCSDK_XRTC_BASE_XRTC_GLOBAL_H_
 #define XRTCSDK_XRTC_BASE_XRTC_GLOBAL_H_
 
+#include <vector>
+
+#include <api/task_queue/task_queue_factory.h>
 #include <rtc_base/thread.h>
+#include <modules/audio_device/include/audio_device.h>
 #include <modules/video_capture/video_capture.h>
 #include <ice/port_allocator.h>
 
+#include "xrtc/base/task_pool.h"
+#include "xrtc/base/thread_config.h"
+
 namespace xrtc {
 
 class XRTCEngineObserver;
 class HttpManager;
+class IVideoSource;
+class IAudioSource;
 
 // 单例模式
 class XRTCGlobal {
 public:
     static XRTCGlobal* Instance();
+    // 线程配置(json)，在第一次调用Instance之前设置才会生效，格式见XRTCEngine::SetThreadConfig
+    static bool SetThreadConfig(const std::string& json_config);
 
     XRTCEngineObserver* engine_observer() { return engine_observer_; }
     void RegisterEngineObserver(XRTCEngineObserver* observer) {
@@ -25,21 +36,54 @@ public:
     rtc::Thread* api_thread() { return api_thread_.get(); }
     rtc::Thread* worker_thread() { return worker_thread_.get(); }
     rtc::Thread* network_thread() { return network_thread_.get(); }
+    // 信令等HTTP请求，回调在network_thread上执行
+    HttpManager* http_manager() { return http_manager_.get(); }
+    // 媒体处理线程池，按CPU核数创建，渲染/编码等节点在上面各自的串行队列中执行
+    TaskPool* media_pool() { return media_pool_.get(); }
+    // 音频专用的线程和线程池，默认实时优先级，和视频的线程池分开，视频负载不会让音频排队
+    // audio_thread负责音频设备的操作和文件/测试音源的10ms节拍，audio_pool执行音频节点
+    rtc::Thread* audio_thread() { return audio_thread_.get(); }
+    TaskPool* audio_pool() { return audio_pool_.get(); }
+    // 所有SDK线程的CPU时间和唤醒延时统计，创建后不再变化，可以在任意线程读取
+    std::vector<ThreadStats*> thread_stats();
     
     webrtc::VideoCaptureModule::DeviceInfo* video_device_info() {
         return video_device_info_.get();
     }
+    // 音频设备模块，第一次调用时创建并初始化，失败返回nullptr，只在audio_thread上调用
+    webrtc::AudioDeviceModule* audio_device();
+
+    // 当前存在的视频源，用于XRTCEngine::GetStats，只在api_thread上访问
+    void AddVideoSource(IVideoSource* video_source);
+    void RemoveVideoSource(IVideoSource* video_source);
+    const std::vector<IVideoSource*>& video_sources() { return video_sources_; }
+    void AddAudioSource(IAudioSource* audio_source);
+    void RemoveAudioSource(IAudioSource* audio_source);
+    const std::vector<IAudioSource*>& audio_sources() { return audio_sources_; }
 
 private:
     XRTCGlobal();
     ~XRTCGlobal();
 
+    void StartThread(rtc::Thread* thread, const std::string& name, const ThreadConfig& config);
+    void ProbeWakeup(rtc::Thread* thread, ThreadStats* stats);
+
 private:
     std::unique_ptr<rtc::Thread> api_thread_;
     std::unique_ptr<rtc::Thread> worker_thread_;
     std::unique_ptr<rtc::Thread> network_thread_;
+    std::unique_ptr<HttpManager> http_manager_;
+    std::unique_ptr<TaskPool> media_pool_;
+    std::unique_ptr<rtc::Thread> audio_thread_;
+    std::unique_ptr<TaskPool> audio_pool_;
+    std::vector<std::unique_ptr<ThreadStats>> thread_stats_;//api/worker/network/audio线程
     std::unique_ptr<webrtc::VideoCaptureModule::DeviceInfo> video_device_info_;
+    std::unique_ptr<webrtc::TaskQueueFactory> task_queue_factory_;
+    rtc::scoped_refptr<webrtc::AudioDeviceModule> audio_device_;
+    bool audio_device_failed_ = false;//初始化失败后不再重试
     XRTCEngineObserver* engine_observer_ = nullptr;
+    std::vector<IVideoSource*> video_sources_;
+    std::vector<IAudioSource*> audio_sources_;
 };
 
 } // namespace xrtc
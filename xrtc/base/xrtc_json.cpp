@@ -149,6 +149,9 @@ double JsonValue::ToDouble(double default_value) const {
     if (IsDouble()) {
         return double_value_;
     }
+    if (IsInt()) {
+        return (double)(long long)ull_value_;
+    }
     return default_value;
 }
 
@@ -320,6 +323,22 @@ bool JsonValue::FromJson(const std::string& json) {
                 }
                 *array_value_ = arr;
             }
+            // 数组的元素逐个按json解析，标量也要支持，否则数字和字符串数组的元素都是Null
+            else if (t == Json::ValueType::intValue) {
+                *this = JsonValue((long long)value.asInt64());
+            }
+            else if (t == Json::ValueType::uintValue) {
+                *this = JsonValue((unsigned long long)value.asUInt64());
+            }
+            else if (t == Json::ValueType::realValue) {
+                *this = JsonValue(value.asDouble());
+            }
+            else if (t == Json::ValueType::stringValue) {
+                *this = JsonValue(value.asString());
+            }
+            else if (t == Json::ValueType::booleanValue) {
+                *this = JsonValue(value.asBool());
+            }
         }
     }
     catch (...) {
@@ -376,6 +395,14 @@ JsonValue JsonObject::operator[](std::string& key) const {
     return itor->second;
 }
 
+JsonValue JsonObject::operator[](const char* key) const {
+    auto itor = values_.find(key);
+    if (itor == values_.end()) {
+        return JsonValue();
+    }
+    return itor->second;
+}
+
 JsonValue& JsonObject::operator[](std::string& key) {
     if (values_.find(key) == values_.end()) {
         values_[key] = JsonValue();
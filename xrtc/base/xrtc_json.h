@@ -57,7 +57,7 @@ public:
 
     bool ToBool(bool defaultValue = false) const;
     unsigned long long ToInt(unsigned long long defaultValue = 0) const;
-    double ToDouble(double defaultValue = 0) const;
+    double ToDouble(double defaultValue = 0) const;//整数也转换，json中的440不会被当作double
     std::string ToString() const;
     std::string ToString(const std::string& default_value) const;
     JsonArray ToArray() const;
@@ -0,0 +1,43 @@
+﻿#include "xrtc/base/xrtc_stats.h"
+
+namespace xrtc {
+
+namespace {
+
+const int64_t kMinRateWindowMs = 200;
+
+} // namespace
+
+double StatsCounter::Rate(int64_t now_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t count = count_.load(std::memory_order_relaxed);
+    if (last_ts_ms_ == 0) {
+        last_ts_ms_ = now_ms;
+        last_count_ = count;
+        return last_rate_;
+    }
+
+    int64_t elapsed = now_ms - last_ts_ms_;
+    if (elapsed < kMinRateWindowMs) {
+        return last_rate_;
+    }
+
+    last_rate_ = (count - last_count_) * 1000.0 / elapsed;
+    last_count_ = count;
+    last_ts_ms_ = now_ms;
+    return last_rate_;
+}
+
+int64_t AverageCounter::Average() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t sum = sum_.load(std::memory_order_relaxed);
+    int64_t count = count_.load(std::memory_order_relaxed);
+    if (count > last_count_) {
+        last_average_ = (sum - last_sum_) / (count - last_count_);
+        last_sum_ = sum;
+        last_count_ = count;
+    }
+    return last_average_;
+}
+
+} // namespace xrtc
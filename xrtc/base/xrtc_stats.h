@@ -0,0 +1,58 @@
+﻿#ifndef XRTCSDK_XRTC_BASE_XRTC_STATS_H_
+#define XRTCSDK_XRTC_BASE_XRTC_STATS_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+
+namespace xrtc {
+
+// 单调递增的计数，热路径上只有一次原子加
+// 速率在拉取统计时按两次拉取之间的差值计算
+class StatsCounter {
+public:
+    void Add(int64_t value = 1) {
+        count_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    int64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    // 距离上一次调用的每秒速率，两次调用间隔太短时返回上一次的结果
+    double Rate(int64_t now_ms);
+
+private:
+    std::atomic<int64_t> count_{ 0 };
+
+    std::mutex mutex_;//只在拉取统计时使用
+    int64_t last_count_ = 0;
+    int64_t last_ts_ms_ = 0;
+    double last_rate_ = 0.0;
+};
+
+// 平均值统计(例如处理耗时)，同样只在拉取时计算
+class AverageCounter {
+public:
+    void Add(int64_t value) {
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    // 距离上一次调用的平均值，没有新的样本时返回上一次的结果
+    int64_t Average();
+
+private:
+    std::atomic<int64_t> sum_{ 0 };
+    std::atomic<int64_t> count_{ 0 };
+
+    std::mutex mutex_;
+    int64_t last_sum_ = 0;
+    int64_t last_count_ = 0;
+    int64_t last_average_ = 0;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_BASE_XRTC_STATS_H_
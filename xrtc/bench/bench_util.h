@@ -0,0 +1,43 @@
+﻿#ifndef XRTCSDK_XRTC_BENCH_BENCH_UTIL_H_
+#define XRTCSDK_XRTC_BENCH_BENCH_UTIL_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace xrtc {
+
+// 合成的I420图像，不依赖摄像头，stride可以比宽度大来模拟采集端的行对齐
+struct SyntheticI420 {
+    SyntheticI420(int w, int h, int stride_pad = 0) :
+        width(w),
+        height(h),
+        stride_y(w + stride_pad),
+        stride_uv((w + 1) / 2 + stride_pad / 2),
+        y(stride_y * h),
+        u(stride_uv * ((h + 1) / 2)),
+        v(stride_uv * ((h + 1) / 2))
+    {
+        for (size_t i = 0; i < y.size(); ++i) {
+            y[i] = (uint8_t)(i * 7);
+        }
+        for (size_t i = 0; i < u.size(); ++i) {
+            u[i] = (uint8_t)(128 + i % 16);
+            v[i] = (uint8_t)(128 - i % 16);
+        }
+    }
+
+    int frame_size() const { return width * height * 3 / 2; }
+
+    int width;
+    int height;
+    int stride_y;
+    int stride_uv;
+    std::vector<uint8_t> y;
+    std::vector<uint8_t> u;
+    std::vector<uint8_t> v;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_BENCH_BENCH_UTIL_H_
@@ -0,0 +1,257 @@
+﻿#include <benchmark/benchmark.h>
+#include <stdio.h>
+#include <string.h>
+
+// 录制的写盘能力：AsyncFileWriter单独的写入吞吐和IO线程的积压峰值，
+// 以及推流链路上编码输出经tee_filter分叉到file_record_sink(另一支是空的发送节点)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xrtc/base/async_file_writer.h"
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/in_pin.h"
+#include "xrtc/media/base/media_chain.h"
+#include "xrtc/media/base/out_pin.h"
+#include "xrtc/media/filter/tee_filter.h"
+#include "xrtc/media/sink/file_record_sink.h"
+
+namespace xrtc {
+namespace {
+
+const int kFramesPerIteration = 300;
+const int kKeyFrameInterval = 60;
+const int kWidth = 1280;
+const int kHeight = 720;
+
+std::string BenchFilePath(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+double ElapsedSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// range(0): 每帧的字节数(KB)，16约为4Mbps 30fps的H264，3000约为1080p的I420(Y4M)
+// range(1): 1为O_DIRECT(文件系统不支持时退回普通写)
+// 不限速地连续写，write_MBps是交给IO线程的数据全部落盘(含Close)的速度，
+// peak_queue_depth是IO线程积压的缓冲块数峰值，积压超过max_queue_bytes的帧计入dropped_frames
+void BM_AsyncFileWriter(benchmark::State& state) {
+    size_t frame_size = (size_t)state.range(0) * 1024;
+    AsyncFileWriter::Options options;
+    options.direct_io = state.range(1) != 0;
+    std::vector<uint8_t> frame(frame_size, 0x5a);
+    std::string path = BenchFilePath("xrtc_async_file_writer_bench.bin");
+
+    int64_t bytes = 0;
+    int64_t dropped = 0;
+    int peak_depth = 0;
+    double seconds = 0;
+    bool direct_io = false;
+    for (auto _ : state) {
+        AsyncFileWriter writer;
+        if (!writer.Open(path, options)) {
+            state.SkipWithError("open failed");
+            break;
+        }
+        direct_io = writer.direct_io();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kFramesPerIteration; ++i) {
+            if (!writer.CanWrite(frame.size())) {
+                ++dropped;
+                continue;
+            }
+            writer.Write(frame.data(), frame.size());
+        }
+        writer.Close();
+        seconds += ElapsedSeconds(start);
+        bytes += writer.bytes_written();
+        peak_depth = std::max(peak_depth, writer.max_queue_depth());
+    }
+    remove(path.c_str());
+
+    state.SetBytesProcessed(bytes);
+    state.counters["write_MBps"] = seconds > 0 ? bytes / seconds / (1024 * 1024) : 0.0;
+    state.counters["peak_queue_depth"] = peak_depth;
+    state.counters["dropped_frames"] = (double)dropped;
+    state.SetLabel(direct_io ? "direct_io" : "buffered");
+}
+
+BENCHMARK(BM_AsyncFileWriter)->Args({ 16, 0 })->Args({ 16, 1 })
+    ->Args({ 3000, 0 })->Args({ 3000, 1 })->Unit(benchmark::kMillisecond)->UseRealTime();
+
+MediaFormat H264Format() {
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeVideo;
+    fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeH264;
+    fmt.sub_fmt.video_fmt.width = 0;
+    fmt.sub_fmt.video_fmt.height = 0;
+    fmt.sub_fmt.video_fmt.idr = false;
+    return fmt;
+}
+
+// 合成的Annex-B帧：关键帧带SPS/PPS，负载不含起始码
+std::shared_ptr<MediaFrame> SyntheticH264(size_t payload_size, bool idr, uint32_t ts) {
+    static const uint8_t kSps[] = { 0, 0, 0, 1, 0x67, 0x42, 0xc0, 0x1f, 0x8c, 0x8d, 0x40 };
+    static const uint8_t kPps[] = { 0, 0, 0, 1, 0x68, 0xce, 0x3c, 0x80 };
+    std::vector<uint8_t> data;
+    if (idr) {
+        data.insert(data.end(), kSps, kSps + sizeof(kSps));
+        data.insert(data.end(), kPps, kPps + sizeof(kPps));
+    }
+    const uint8_t slice[] = { 0, 0, 0, 1, (uint8_t)(idr ? 0x65 : 0x41) };
+    data.insert(data.end(), slice, slice + sizeof(slice));
+    for (size_t i = 0; i < payload_size; ++i) {
+        data.push_back((uint8_t)(i * 13) | 0x80);
+    }
+
+    auto frame = std::make_shared<MediaFrame>((int)data.size());
+    memcpy(frame->data[0], data.data(), data.size());
+    frame->data_len[0] = (int)data.size();
+    frame->fmt = H264Format();
+    frame->fmt.sub_fmt.video_fmt.width = kWidth;
+    frame->fmt.sub_fmt.video_fmt.height = kHeight;
+    frame->fmt.sub_fmt.video_fmt.idr = idr;
+    frame->ts = ts;
+    return frame;
+}
+
+class H264Source : public MediaObject {
+public:
+    H264Source() : out_pin_(std::make_unique<OutPin>(this)) {
+        out_pin_->set_format(H264Format());
+    }
+
+    bool Start() override { return true; }
+    void Stop() override {}
+    std::vector<InPin*> GetAllInPins() override { return std::vector<InPin*>(); }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>({ out_pin_.get() });
+    }
+    const char* name() const override { return "h264_source"; }
+
+    OutPin* out_pin() { return out_pin_.get(); }
+
+private:
+    std::unique_ptr<OutPin> out_pin_;
+};
+
+// 代替发送节点，只计数
+class CountingSink : public MediaObject {
+public:
+    CountingSink() : in_pin_(std::make_unique<InPin>(this)) {
+        in_pin_->set_format(H264Format());
+    }
+
+    bool Start() override { return true; }
+    void Stop() override {}
+    void OnNewMediaFrame(std::shared_ptr<MediaFrame> /*frame*/) override { ++frames; }
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>({ in_pin_.get() });
+    }
+    std::vector<OutPin*> GetAllOutPins() override { return std::vector<OutPin*>(); }
+    const char* name() const override { return "counting_sink"; }
+
+    std::atomic<int64_t> frames{ 0 };
+
+private:
+    std::unique_ptr<InPin> in_pin_;
+};
+
+// 和XRTCPusher录制时的连接方式相同
+class RecordChain : public MediaChain {
+public:
+    explicit RecordChain(const std::string& path) :
+        tee_(H264Format(), 2),
+        record_sink_(path)
+    {
+    }
+
+    void Start() override {
+        AddMediaObject(&source_);
+        AddMediaObject(&tee_);
+        AddMediaObject(&send_sink_);
+        AddMediaObject(&record_sink_);
+        ConnectMediaObject(&source_, &tee_);
+        ConnectMediaPin(tee_.out_pin(0), &send_sink_);
+        ConnectMediaPin(tee_.out_pin(1), &record_sink_);
+        StartChain();
+    }
+
+    void Stop() override { StopChain(); }
+    void Destroy() override {}
+
+    void Push(std::shared_ptr<MediaFrame> frame) { source_.out_pin()->PushMediaFrame(frame); }
+    void Drain() { record_sink_.Drain(); }
+
+    CountingSink* send_sink() { return &send_sink_; }
+    FileRecordSink* record_sink() { return &record_sink_; }
+
+private:
+    H264Source source_;
+    TeeFilter tee_;
+    CountingSink send_sink_;
+    FileRecordSink record_sink_;
+};
+
+// range(0): 每帧的字节数(KB)，关键帧是它的4倍；每次迭代录kFramesPerIteration帧分片MP4
+// 帧不限速地推入，write_MBps为录制的文件全部落盘(含Stop)的速度，
+// send_frames和record_frames确认两个分支都收到了每一帧
+void BM_RecordTee(benchmark::State& state) {
+    size_t frame_size = (size_t)state.range(0) * 1024;
+    std::vector<std::shared_ptr<MediaFrame>> frames;
+    for (int i = 0; i < kFramesPerIteration; ++i) {
+        bool idr = i % kKeyFrameInterval == 0;
+        frames.push_back(SyntheticH264(idr ? frame_size * 4 : frame_size, idr,
+            (uint32_t)(i * 33)));
+    }
+    std::string path = BenchFilePath("xrtc_record_tee_bench.mp4");
+
+    int64_t bytes = 0;
+    int64_t send_frames = 0;
+    int64_t record_frames = 0;
+    int64_t dropped = 0;
+    int64_t peak_depth = 0;
+    double seconds = 0;
+    for (auto _ : state) {
+        RecordChain chain(path);
+        chain.Start();
+        auto start = std::chrono::steady_clock::now();
+        for (auto& frame : frames) {
+            chain.Push(frame);
+        }
+        chain.Drain();
+
+        // Stop之前取积压峰值，之后取写盘的字节数
+        JsonObject jstats;
+        chain.record_sink()->GetStats(jstats);
+        peak_depth = std::max(peak_depth, (int64_t)jstats["max_queue_depth"].ToInt(0));
+        chain.Stop();
+        seconds += ElapsedSeconds(start);
+
+        JsonObject jfinal;
+        chain.record_sink()->GetStats(jfinal);
+        bytes += (int64_t)jfinal["bytes_written"].ToInt(0);
+        record_frames += (int64_t)jfinal["frames_written"].ToInt(0);
+        dropped += (int64_t)jfinal["frames_dropped"].ToInt(0);
+        send_frames += chain.send_sink()->frames.load();
+    }
+    remove(path.c_str());
+
+    state.SetBytesProcessed(bytes);
+    state.counters["write_MBps"] = seconds > 0 ? bytes / seconds / (1024 * 1024) : 0.0;
+    state.counters["peak_queue_depth"] = (double)peak_depth;
+    state.counters["send_frames"] = (double)send_frames / state.iterations();
+    state.counters["record_frames"] = (double)record_frames / state.iterations();
+    state.counters["dropped_frames"] = (double)dropped / state.iterations();
+}
+
+BENCHMARK(BM_RecordTee)->Arg(16)->Arg(256)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
+} // namespace xrtc
@@ -0,0 +1,140 @@
+﻿#include <benchmark/benchmark.h>
+#include <libyuv.h>
+#include <stdint.h>
+
+extern "C" {
+#include <x264.h>
+}
+
+#include <memory>
+#include <vector>
+
+#include "xrtc/bench/bench_util.h"
+#include "xrtc/media/base/media_frame.h"
+
+namespace xrtc {
+namespace {
+
+// range(2): 0为紧密排列(alignment=1，stride等于宽度)，1为64字节对齐
+// 1366x768的行宽不是SIMD宽度的整数倍，最能体现差别
+std::shared_ptr<MediaFrame> CreateTestFrame(const benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+    int alignment = state.range(2) ? MediaFrame::kDefaultAlignment : 1;
+    SyntheticI420 src(width, height);
+    return MediaFrame::CreateI420(src.y.data(), src.stride_y,
+        src.u.data(), src.stride_uv,
+        src.v.data(), src.stride_uv,
+        width, height, alignment);
+}
+
+void SetLabel(benchmark::State& state) {
+    state.SetLabel(state.range(2) ? "aligned64" : "unaligned");
+}
+
+void BM_AlignedI420ToARGB(benchmark::State& state) {
+    std::shared_ptr<MediaFrame> frame = CreateTestFrame(state);
+    int width = frame->fmt.sub_fmt.video_fmt.width;
+    int height = frame->fmt.sub_fmt.video_fmt.height;
+    std::vector<uint8_t> argb(width * height * 4);
+    for (auto _ : state) {
+        libyuv::I420ToARGB((const uint8_t*)frame->data[0], frame->stride[0],
+            (const uint8_t*)frame->data[1], frame->stride[1],
+            (const uint8_t*)frame->data[2], frame->stride[2],
+            argb.data(), width * 4,
+            width, height);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+    SetLabel(state);
+}
+
+void BM_AlignedI420Scale(benchmark::State& state) {
+    std::shared_ptr<MediaFrame> frame = CreateTestFrame(state);
+    int width = frame->fmt.sub_fmt.video_fmt.width;
+    int height = frame->fmt.sub_fmt.video_fmt.height;
+    std::shared_ptr<MediaFrame> dst = MediaFrame::CreateVideo(SubMediaType::kSubTypeI420,
+        width / 2, height / 2, frame->alignment);
+    for (auto _ : state) {
+        libyuv::I420Scale((const uint8_t*)frame->data[0], frame->stride[0],
+            (const uint8_t*)frame->data[1], frame->stride[1],
+            (const uint8_t*)frame->data[2], frame->stride[2],
+            width, height,
+            (uint8_t*)dst->data[0], dst->stride[0],
+            (uint8_t*)dst->data[1], dst->stride[1],
+            (uint8_t*)dst->data[2], dst->stride[2],
+            width / 2, height / 2,
+            libyuv::kFilterBilinear);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+    SetLabel(state);
+}
+
+// x264编码(ultrafast/zerolatency，单线程)，输入平面直接指向MediaFrame
+void BM_AlignedX264Encode(benchmark::State& state) {
+    std::shared_ptr<MediaFrame> frame = CreateTestFrame(state);
+    int width = frame->fmt.sub_fmt.video_fmt.width;
+    int height = frame->fmt.sub_fmt.video_fmt.height;
+
+    x264_param_t param;
+    x264_param_default_preset(&param, "ultrafast", "zerolatency");
+    param.i_width = width;
+    param.i_height = height;
+    param.i_csp = X264_CSP_I420;
+    param.i_fps_num = 30;
+    param.i_fps_den = 1;
+    param.i_threads = 1;
+    param.i_log_level = -1;
+    param.rc.i_rc_method = X264_RC_CRF;
+    param.rc.f_rf_constant = 23;
+    x264_param_apply_profile(&param, "baseline");
+    x264_t* encoder = x264_encoder_open(&param);
+    if (!encoder) {
+        state.SkipWithError("x264_encoder_open failed");
+        return;
+    }
+
+    x264_picture_t pic_in;
+    x264_picture_t pic_out;
+    x264_picture_init(&pic_in);
+    pic_in.img.i_csp = X264_CSP_I420;
+    pic_in.img.i_plane = 3;
+    for (int i = 0; i < 3; ++i) {
+        pic_in.img.plane[i] = (uint8_t*)frame->data[i];
+        pic_in.img.i_stride[i] = frame->stride[i];
+    }
+
+    int64_t pts = 0;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        x264_nal_t* nals = nullptr;
+        int num_nals = 0;
+        pic_in.i_pts = pts++;
+        int size = x264_encoder_encode(encoder, &nals, &num_nals, &pic_in, &pic_out);
+        if (size > 0) {
+            bytes += size;
+        }
+    }
+
+    x264_encoder_close(encoder);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["kbytes_per_frame"] = state.iterations() ?
+        (double)bytes / 1024 / state.iterations() : 0.0;
+    SetLabel(state);
+}
+
+void AlignmentArgs(benchmark::internal::Benchmark* b) {
+    for (int aligned = 0; aligned <= 1; ++aligned) {
+        b->Args({ 1280, 720, aligned });
+        b->Args({ 1366, 768, aligned });
+        b->Args({ 1920, 1080, aligned });
+    }
+}
+
+BENCHMARK(BM_AlignedI420ToARGB)->Apply(AlignmentArgs);
+BENCHMARK(BM_AlignedI420Scale)->Apply(AlignmentArgs);
+BENCHMARK(BM_AlignedX264Encode)->Apply(AlignmentArgs);
+
+} // namespace
+} // namespace xrtc
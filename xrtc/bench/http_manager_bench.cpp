@@ -0,0 +1,92 @@
+﻿#include <benchmark/benchmark.h>
+
+// 信令往返：本机的信令替身模拟新连接的握手延时，对比第一次请求(新建连接)和之后复用连接的请求
+#if defined(WEBRTC_LINUX)
+
+#include <algorithm>
+#include <future>
+#include <string>
+
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/http_manager.h"
+#include "xrtc/base/xrtc_global.h"
+#include "xrtc/bench/local_signaling_server.h"
+
+namespace xrtc {
+namespace {
+
+const int kRequests = 20;
+
+// 返回从发起到回调的耗时(us)，失败返回-1
+int64_t SendAndWait(HttpManager* manager, const HttpRequest& request, HttpResponse* response) {
+    std::promise<HttpResponse> promise;
+    std::future<HttpResponse> future = promise.get_future();
+    int64_t start_us = rtc::TimeMicros();
+    manager->Send(request, [&promise](const HttpResponse& result) {
+        promise.set_value(result);
+    });
+    *response = future.get();
+    return response->ok() ? rtc::TimeMicros() - start_us : -1;
+}
+
+// range(0): 新连接第一个回复的额外延时(ms)，range(1): 先返回503的请求数(触发重试)
+// 每次迭代新建HttpManager，第一个请求一定是冷启动
+void BM_HttpSignalingRoundTrip(benchmark::State& state) {
+    LocalSignalingServer server;
+    server.set_handshake_delay_ms((int)state.range(0));
+    if (!server.Start()) {
+        state.SkipWithError("server start failed");
+        return;
+    }
+
+    HttpRequest request;
+    request.url = "http://127.0.0.1:" + std::to_string(server.port()) + "/signaling/push";
+    request.body = "uid=bench&streamName=bench&audio=0&video=1&isDtls=0";
+    request.headers.push_back("Content-Type: application/x-www-form-urlencoded");
+
+    int64_t cold_us = 0;
+    int64_t warm_us = 0;
+    int attempts = 0;
+    int reused = 0;
+    for (auto _ : state) {
+        HttpManager manager(XRTCGlobal::Instance()->network_thread());
+        server.FailNextRequests((int)state.range(1));
+        for (int i = 0; i < kRequests; ++i) {
+            HttpResponse response;
+            int64_t elapsed_us = SendAndWait(&manager, request, &response);
+            if (elapsed_us < 0) {
+                state.SkipWithError(("request failed: " + response.error).c_str());
+                return;
+            }
+
+            if (i == 0) {
+                cold_us += elapsed_us;
+                attempts += response.attempts;
+            }
+            else {
+                warm_us += elapsed_us;
+                reused += response.reused_connection ? 1 : 0;
+            }
+        }
+    }
+
+    int64_t iterations = std::max<int64_t>(1, state.iterations());
+    state.counters["cold_ms"] = cold_us / 1000.0 / iterations;
+    state.counters["warm_ms"] = warm_us / 1000.0 / iterations / (kRequests - 1);
+    state.counters["cold_attempts"] = (double)attempts / iterations;
+    state.counters["warm_reused"] = (double)reused / iterations / (kRequests - 1);
+    state.counters["connections"] = (double)server.connections() / iterations;
+}
+BENCHMARK(BM_HttpSignalingRoundTrip)
+    ->Args({ 0, 0 })
+    ->Args({ 50, 0 })
+    ->Args({ 50, 1 })
+    ->Iterations(3)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
+} // namespace xrtc
+
+#endif // defined(WEBRTC_LINUX)
@@ -0,0 +1,93 @@
+﻿#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "xrtc/base/xrtc_json.h"
+
+namespace xrtc {
+namespace {
+
+// 和XRTCPreview传给链路的配置一样大小
+const char kChainConfig[] =
+    "{\"d3d9_render_sink\":{\"hwnd\":1311768},"
+    "\"cam\":{\"width\":1280,\"height\":720,\"fps\":30}}";
+
+// 和MediaChain::GetStats类似的统计
+JsonObject BuildStats(int nodes) {
+    JsonArray jnodes;
+    for (int i = 0; i < nodes; ++i) {
+        JsonObject jnode;
+        jnode["name"] = "media_object";
+        jnode["frames"] = 123456;
+        jnode["fps"] = 29.97;
+        jnode["process_us"] = 350;
+        jnode["queue_depth"] = 1;
+        jnodes.Append(jnode);
+    }
+
+    JsonObject jstats;
+    jstats["timestamp_ms"] = 1700000000000LL;
+    jstats["nodes"] = jnodes;
+    return jstats;
+}
+
+void BM_JsonParseConfig(benchmark::State& state) {
+    std::string json = kChainConfig;
+    for (auto _ : state) {
+        JsonValue value;
+        value.FromJson(json);
+        JsonObject jd3d9 = value.ToObject()["d3d9_render_sink"].ToObject();
+        benchmark::DoNotOptimize(jd3d9["hwnd"].ToInt());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_JsonSerializeStats(benchmark::State& state) {
+    JsonValue value(BuildStats((int)state.range(0)));
+    for (auto _ : state) {
+        std::string json = value.ToJson();
+        benchmark::DoNotOptimize(json.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_JsonParseStats(benchmark::State& state) {
+    std::string json = JsonValue(BuildStats((int)state.range(0))).ToJson();
+    for (auto _ : state) {
+        JsonValue value;
+        value.FromJson(json);
+        benchmark::DoNotOptimize(value.type());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * (int64_t)json.size());
+}
+
+// 标量数组要能原样往返，cpus、stun_servers、srtp_profiles都是这种数组
+void BM_JsonRoundTripScalarArray(benchmark::State& state) {
+    const std::string json = "[1,\"a\",2.5,true]";
+    for (auto _ : state) {
+        JsonValue value;
+        value.FromJson(json);
+        JsonArray arr = value.ToArray();
+        if (arr.Size() != 4 || arr[0].ToInt() != 1 || arr[1].ToString() != "a" ||
+            arr[2].ToDouble() != 2.5 || !arr[3].ToBool())
+        {
+            state.SkipWithError("scalar array elements lost");
+            break;
+        }
+        // FastWriter末尾带换行
+        if (value.ToJson() != json + "\n") {
+            state.SkipWithError("scalar array does not round-trip");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_JsonParseConfig);
+BENCHMARK(BM_JsonSerializeStats)->Arg(2)->Arg(16);
+BENCHMARK(BM_JsonParseStats)->Arg(2)->Arg(16);
+BENCHMARK(BM_JsonRoundTripScalarArray);
+
+} // namespace
+} // namespace xrtc
@@ -0,0 +1,327 @@
+﻿#include "xrtc/bench/local_signaling_server.h"
+
+#if defined(WEBRTC_LINUX)
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <sstream>
+
+#include "xrtc/base/xrtc_json.h"
+
+namespace xrtc {
+
+namespace {
+
+const size_t kMaxRequestSize = 64 * 1024;
+
+std::string FormValue(const std::string& body, const std::string& key) {
+    size_t start = 0;
+    while (start < body.size()) {
+        size_t end = body.find('&', start);
+        if (end == std::string::npos) {
+            end = body.size();
+        }
+        size_t eq = body.find('=', start);
+        if (eq < end && body.compare(start, eq - start, key) == 0) {
+            std::string value;
+            for (size_t i = eq + 1; i < end; ++i) {
+                if (body[i] == '%' && i + 2 < end) {
+                    value += (char)strtol(body.substr(i + 1, 2).c_str(), nullptr, 16);
+                    i += 2;
+                }
+                else {
+                    value += body[i] == '+' ? ' ' : body[i];
+                }
+            }
+            return value;
+        }
+        start = end + 1;
+    }
+    return "";
+}
+
+bool SendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += (size_t)n;
+    }
+    return true;
+}
+
+} // namespace
+
+LocalSignalingServer::LocalSignalingServer() {
+}
+
+LocalSignalingServer::~LocalSignalingServer() {
+    Stop();
+}
+
+bool LocalSignalingServer::Start() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(listen_fd_, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd_, 16) != 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(listen_fd_, (sockaddr*)&addr, &len);
+    port_ = ntohs(addr.sin_port);
+    running_ = true;
+    accept_thread_ = std::thread([this]() { AcceptLoop(); });
+    return true;
+}
+
+void LocalSignalingServer::Stop() {
+    if (!running_) {
+        return;
+    }
+
+    running_ = false;
+    accept_thread_.join();
+    close(listen_fd_);
+    listen_fd_ = -1;
+
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int fd : client_fds_) {
+            shutdown(fd, SHUT_RDWR);
+        }
+        threads.swap(client_threads_);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void LocalSignalingServer::set_media_address(const std::string& ip, int port, int backup_port) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    media_ip_ = ip;
+    media_port_ = port;
+    backup_port_ = backup_port;
+}
+
+void LocalSignalingServer::set_ice_parameters(const std::string& ufrag, const std::string& pwd) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ice_ufrag_ = ufrag;
+    ice_pwd_ = pwd;
+}
+
+std::string LocalSignalingServer::last_answer() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_answer_;
+}
+
+void LocalSignalingServer::AcceptLoop() {
+    pollfd pfd = { listen_fd_, POLLIN, 0 };
+    while (running_) {
+        if (poll(&pfd, 1, 50) <= 0) {
+            continue;
+        }
+
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        ++connections_;
+        std::lock_guard<std::mutex> lock(mutex_);
+        client_fds_.push_back(fd);
+        client_threads_.emplace_back([this, fd]() { ServeConnection(fd); });
+    }
+}
+
+// 一个连接上顺序处理请求，直到对端关闭
+void LocalSignalingServer::ServeConnection(int fd) {
+    std::string buffer;
+    bool first = true;
+    char chunk[4096];
+    while (running_) {
+        size_t header_end = buffer.find("\r\n\r\n");
+        if (header_end == std::string::npos) {
+            if (buffer.size() > kMaxRequestSize) {
+                break;
+            }
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                break;
+            }
+            buffer.append(chunk, (size_t)n);
+            continue;
+        }
+
+        std::string header = buffer.substr(0, header_end);
+        size_t content_length = 0;
+        size_t pos = header.find("Content-Length:");
+        if (pos == std::string::npos) {
+            pos = header.find("content-length:");
+        }
+        if (pos != std::string::npos) {
+            content_length = (size_t)strtoul(header.c_str() + pos + 15, nullptr, 10);
+        }
+
+        size_t request_size = header_end + 4 + content_length;
+        if (request_size > kMaxRequestSize) {
+            break;
+        }
+        if (buffer.size() < request_size) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                break;
+            }
+            buffer.append(chunk, (size_t)n);
+            continue;
+        }
+
+        // POST /signaling/push HTTP/1.1
+        std::string request_line = header.substr(0, header.find("\r\n"));
+        size_t path_start = request_line.find(' ') + 1;
+        std::string path = request_line.substr(path_start,
+            request_line.find(' ', path_start) - path_start);
+        std::string body = buffer.substr(header_end + 4, content_length);
+        buffer.erase(0, request_size);
+        ++requests_;
+
+        int delay_ms = response_delay_ms_ + (first ? handshake_delay_ms_.load() : 0);
+        first = false;
+        if (delay_ms > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+        }
+
+        int status = 200;
+        std::string content = HandleRequest(path, body, &status);
+        std::ostringstream response;
+        response << "HTTP/1.1 " << status << (status == 200 ? " OK" : " Error") << "\r\n"
+            << "Content-Type: application/json\r\n"
+            << "Content-Length: " << content.size() << "\r\n"
+            << "Connection: keep-alive\r\n\r\n" << content;
+        if (!SendAll(fd, response.str())) {
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = client_fds_.begin(); it != client_fds_.end(); ++it) {
+        if (*it == fd) {
+            client_fds_.erase(it);
+            break;
+        }
+    }
+    close(fd);
+}
+
+std::string LocalSignalingServer::HandleRequest(const std::string& path,
+    const std::string& body, int* status)
+{
+    if (fail_requests_ > 0) {
+        --fail_requests_;
+        *status = 503;
+        return "{\"errNo\":-1,\"errMsg\":\"unavailable\"}";
+    }
+
+    JsonObject jresponse;
+    jresponse["errNo"] = 0;
+    jresponse["errMsg"] = "success";
+    if (path == "/signaling/push") {
+        JsonObject jdata;
+        jdata["type"] = "offer";
+        jdata["sdp"] = CreateOffer();
+        jresponse["data"] = jdata;
+    }
+    else if (path == "/signaling/sendanswer") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        last_answer_ = FormValue(body, "answer");
+    }
+    else if (path == "/signaling/icerestart") {
+        ++ice_restarts_;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            last_answer_ = FormValue(body, "answer");
+        }
+        JsonObject jdata;
+        jdata["type"] = "offer";
+        jdata["sdp"] = CreateOffer();
+        jresponse["data"] = jdata;
+    }
+    else if (path == "/signaling/sendcandidate") {
+        ++candidates_;
+    }
+    else if (path != "/signaling/stoppush") {
+        *status = 404;
+        jresponse["errNo"] = -1;
+        jresponse["errMsg"] = "not found";
+    }
+    return JsonValue(jresponse).ToJson();
+}
+
+std::string LocalSignalingServer::CreateOffer() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string ice;
+    if (!ice_ufrag_.empty()) {
+        ice = "a=ice-ufrag:" + ice_ufrag_ + "\r\n" +
+            "a=ice-pwd:" + ice_pwd_ + "\r\n" +
+            "a=candidate:1 1 udp 2130706431 " + media_ip_ + " " + std::to_string(media_port_) +
+            " typ host\r\n";
+        if (backup_port_ > 0) {
+            ice += "a=candidate:2 1 udp 2130706175 " + media_ip_ + " " +
+                std::to_string(backup_port_) + " typ host\r\n";
+        }
+    }
+
+    std::ostringstream ss;
+    ss << "v=0\r\n"
+        << "o=- 1 2 IN IP4 127.0.0.1\r\n"
+        << "s=-\r\n"
+        << "t=0 0\r\n"
+        << (ice.empty() ? "" : "a=ice-lite\r\n")
+        << "a=group:BUNDLE 0 1\r\n"
+        << "m=audio " << media_port_ << " UDP/RTP/AVPF " << kAudioPayloadType << "\r\n"
+        << "c=IN IP4 " << media_ip_ << "\r\n"
+        << "a=mid:0\r\n"
+        << ice
+        << "a=recvonly\r\n"
+        << "a=rtcp-mux\r\n"
+        << "a=rtpmap:" << kAudioPayloadType << " opus/48000/2\r\n"
+        << "m=video " << media_port_ << " UDP/RTP/AVPF " << kVideoPayloadType << "\r\n"
+        << "c=IN IP4 " << media_ip_ << "\r\n"
+        << "a=mid:1\r\n"
+        << ice
+        << "a=recvonly\r\n"
+        << "a=rtcp-mux\r\n"
+        << "a=rtpmap:" << kVideoPayloadType << " H264/90000\r\n"
+        << "a=fmtp:" << kVideoPayloadType
+        << " level-asymmetry-allowed=1;packetization-mode=1;profile-level-id=42e01f\r\n";
+    if (frame_marking_id_ > 0) {
+        ss << "a=extmap:" << frame_marking_id_ << " urn:ietf:params:rtp-hdrext:framemarking\r\n";
+    }
+    if (transport_cc_id_ > 0) {
+        ss << "a=extmap:" << transport_cc_id_
+            << " http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01\r\n";
+    }
+    return ss.str();
+}
+
+} // namespace xrtc
+
+#endif // defined(WEBRTC_LINUX)
@@ -0,0 +1,83 @@
+﻿#ifndef XRTCSDK_XRTC_BENCH_LOCAL_SIGNALING_SERVER_H_
+#define XRTCSDK_XRTC_BENCH_LOCAL_SIGNALING_SERVER_H_
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xrtc {
+
+// 本机的信令服务替身(HTTP/1.1，保持连接)，只在Linux上实现
+// /signaling/push返回offer，媒体地址指向本机的接收端；/signaling/sendanswer、/signaling/sendcandidate
+// 和/signaling/stoppush直接成功。设置了ICE参数时offer是ice-lite，带接收端地址的host候选
+// backup_port非0时offer再带一个优先级低的host候选，用于验证切换到备用候选对；
+// /signaling/icerestart记下answer，按当前的媒体地址和ICE参数返回新的offer
+// 每个新连接的第一个回复延迟handshake_delay_ms，模拟公网上TCP+TLS握手的往返，复用的连接没有这部分延迟
+class LocalSignalingServer {
+public:
+    static const int kVideoPayloadType = 96;
+    static const int kAudioPayloadType = 111;
+
+    LocalSignalingServer();
+    ~LocalSignalingServer();
+
+    bool Start();
+    void Stop();
+    int port() const { return port_; }
+
+    void set_media_address(const std::string& ip, int port, int backup_port = 0);
+    // ufrag为空时offer不带ICE，推流端直接向媒体地址发送
+    void set_ice_parameters(const std::string& ufrag, const std::string& pwd);
+    void set_handshake_delay_ms(int delay_ms) { handshake_delay_ms_ = delay_ms; }
+    void set_response_delay_ms(int delay_ms) { response_delay_ms_ = delay_ms; }
+    // 非0时offer的视频带frame marking头扩展
+    void set_frame_marking_id(int id) { frame_marking_id_ = id; }
+    // 非0时offer的视频带transport-wide cc头扩展
+    void set_transport_cc_id(int id) { transport_cc_id_ = id; }
+    // 接下来的count个请求返回503，用于验证重试
+    void FailNextRequests(int count) { fail_requests_ = count; }
+
+    int connections() const { return connections_.load(); }
+    int requests() const { return requests_.load(); }
+    int candidates() const { return candidates_.load(); }//trickle收到的候选数
+    int ice_restarts() const { return ice_restarts_.load(); }
+    std::string last_answer();
+
+private:
+    void AcceptLoop();
+    void ServeConnection(int fd);
+    std::string HandleRequest(const std::string& path, const std::string& body, int* status);
+    std::string CreateOffer();
+
+private:
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::atomic<bool> running_{ false };
+    std::thread accept_thread_;
+
+    std::mutex mutex_;
+    std::vector<int> client_fds_;
+    std::vector<std::thread> client_threads_;
+    std::string media_ip_ = "127.0.0.1";
+    int media_port_ = 0;
+    int backup_port_ = 0;
+    std::string ice_ufrag_;
+    std::string ice_pwd_;
+    std::string last_answer_;
+
+    std::atomic<int> handshake_delay_ms_{ 0 };
+    std::atomic<int> response_delay_ms_{ 0 };
+    std::atomic<int> frame_marking_id_{ 0 };
+    std::atomic<int> transport_cc_id_{ 0 };
+    std::atomic<int> fail_requests_{ 0 };
+    std::atomic<int> connections_{ 0 };
+    std::atomic<int> requests_{ 0 };
+    std::atomic<int> candidates_{ 0 };
+    std::atomic<int> ice_restarts_{ 0 };
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_BENCH_LOCAL_SIGNALING_SERVER_H_
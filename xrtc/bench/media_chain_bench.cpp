@@ -0,0 +1,290 @@
+﻿#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/media/base/in_pin.h"
+#include "xrtc/media/base/media_chain.h"
+#include "xrtc/media/base/out_pin.h"
+
+namespace xrtc {
+namespace {
+
+MediaFormat I420Format() {
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeVideo;
+    fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeI420;
+    fmt.sub_fmt.video_fmt.width = 0;
+    fmt.sub_fmt.video_fmt.height = 0;
+    fmt.sub_fmt.video_fmt.idr = false;
+    return fmt;
+}
+
+// 直接转发的节点，用来测量pin之间的传递开销
+class PassThroughNode : public MediaObject {
+public:
+    PassThroughNode() :
+        in_pin_(std::make_unique<InPin>(this)),
+        out_pin_(std::make_unique<OutPin>(this))
+    {
+        in_pin_->set_format(I420Format());
+        out_pin_->set_format(I420Format());
+    }
+
+    bool Start() override { return true; }
+    void Stop() override {}
+    void OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) override {
+        out_pin_->PushMediaFrame(frame);
+    }
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>({ in_pin_.get() });
+    }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>({ out_pin_.get() });
+    }
+    const char* name() const override { return "pass_through"; }
+
+private:
+    std::unique_ptr<InPin> in_pin_;
+    std::unique_ptr<OutPin> out_pin_;
+};
+
+class NullSink : public MediaObject {
+public:
+    NullSink() : in_pin_(std::make_unique<InPin>(this)) {
+        in_pin_->set_format(I420Format());
+    }
+
+    bool Start() override { return true; }
+    void Stop() override {}
+    void OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) override {
+        benchmark::DoNotOptimize(frame.get());
+    }
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>({ in_pin_.get() });
+    }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>();
+    }
+    const char* name() const override { return "null_sink"; }
+
+private:
+    std::unique_ptr<InPin> in_pin_;
+};
+
+// N个PassThroughNode -> NullSink，帧从第一个节点的in_pin推入
+class BenchChain : public MediaChain {
+public:
+    explicit BenchChain(int nodes) {
+        for (int i = 0; i < nodes; ++i) {
+            nodes_.push_back(std::make_unique<PassThroughNode>());
+        }
+    }
+
+    void Start() override {
+        MediaObject* prev = nullptr;
+        for (auto& node : nodes_) {
+            AddMediaObject(node.get());
+            if (prev) {
+                ConnectMediaObject(prev, node.get());
+            }
+            prev = node.get();
+        }
+
+        AddMediaObject(&sink_);
+        ConnectMediaObject(prev, &sink_);
+        StartChain();
+    }
+
+    void Stop() override { StopChain(); }
+    void Destroy() override {}
+
+    void Push(std::shared_ptr<MediaFrame> frame) {
+        nodes_.front()->GetAllInPins()[0]->PushMediaFrame(frame);
+    }
+
+private:
+    std::vector<std::unique_ptr<PassThroughNode>> nodes_;
+    NullSink sink_;
+};
+
+void BM_ChainPush(benchmark::State& state) {
+    BenchChain chain((int)state.range(0));
+    chain.Start();
+
+    std::shared_ptr<MediaFrame> frame = std::make_shared<MediaFrame>(16);
+    frame->fmt = I420Format();
+    for (auto _ : state) {
+        chain.Push(frame);
+    }
+    state.SetItemsProcessed(state.iterations());
+    chain.Stop();
+}
+
+BENCHMARK(BM_ChainPush)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16);
+
+// 只有out_pin的源节点，由推帧线程驱动
+class PushSource : public MediaObject {
+public:
+    PushSource() : out_pin_(std::make_unique<OutPin>(this)) {
+        out_pin_->set_format(I420Format());
+    }
+
+    bool Start() override { return true; }
+    void Stop() override {}
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>();
+    }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>({ out_pin_.get() });
+    }
+    const char* name() const override { return "push_source"; }
+
+    void Push(std::shared_ptr<MediaFrame> frame) {
+        out_pin_->PushMediaFrame(frame);
+    }
+
+private:
+    std::unique_ptr<OutPin> out_pin_;
+};
+
+// 转发节点，另外带一个不连接的预览输出，和实际的滤镜节点一样
+class PreviewTapNode : public PassThroughNode {
+public:
+    PreviewTapNode() : preview_pin_(std::make_unique<OutPin>(this)) {
+        preview_pin_->set_format(I420Format());
+    }
+
+    std::vector<OutPin*> GetAllOutPins() override {
+        std::vector<OutPin*> out_pins = PassThroughNode::GetAllOutPins();
+        out_pins.push_back(preview_pin_.get());
+        return out_pins;
+    }
+    const char* name() const override { return "preview_tap"; }
+
+private:
+    std::unique_ptr<OutPin> preview_pin_;
+};
+
+// 记录相邻两帧到达的最大间隔
+class GapSink : public NullSink {
+public:
+    void OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) override {
+        int64_t now = rtc::TimeMicros();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (last_us_ > 0 && now - last_us_ > max_gap_us_) {
+            max_gap_us_ = now - last_us_;
+        }
+        last_us_ = now;
+    }
+
+    int64_t TakeMaxGap() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t gap = max_gap_us_;
+        max_gap_us_ = 0;
+        return gap;
+    }
+
+private:
+    std::mutex mutex_;
+    int64_t last_us_ = 0;
+    int64_t max_gap_us_ = 0;
+};
+
+// source -> tap(a或b) -> sink，两个tap节点来回热替换
+class SwapChain : public MediaChain {
+public:
+    void Start() override {
+        AddMediaObject(&source_);
+        AddMediaObject(&tap_a_);
+        AddMediaObject(&sink_);
+        ConnectMediaObject(&source_, &tap_a_);
+        ConnectMediaObject(&tap_a_, &sink_);
+        StartChain();
+    }
+
+    void Stop() override { StopChain(); }
+    void Destroy() override {}
+
+    bool Swap() {
+        bool result = using_a_ ? ReplaceMediaObject(&tap_a_, &tap_b_) :
+            ReplaceMediaObject(&tap_b_, &tap_a_);
+        if (result) {
+            using_a_ = !using_a_;
+        }
+        return result;
+    }
+
+    PushSource& source() { return source_; }
+    GapSink& sink() { return sink_; }
+
+private:
+    PushSource source_;
+    PreviewTapNode tap_a_;
+    PreviewTapNode tap_b_;
+    GapSink sink_;
+    bool using_a_ = true;
+};
+
+// 推帧线程每100us推一帧，替换中间节点，比较替换前后同样长的窗口里帧间隔的最大值
+void BM_ChainSwapGap(benchmark::State& state) {
+    const auto kWindow = std::chrono::milliseconds(2);
+    SwapChain chain;
+    chain.Start();
+
+    std::atomic<bool> running{ true };
+    std::thread pusher([&chain, &running]() {
+        std::shared_ptr<MediaFrame> frame = std::make_shared<MediaFrame>(16);
+        frame->fmt = I420Format();
+        while (running.load()) {
+            chain.source().Push(frame);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+
+    int64_t steady_gap_us = 0;
+    int64_t swap_gap_us = 0;
+    int64_t max_swap_gap_us = 0;
+    int64_t swap_us = 0;
+    int failures = 0;
+    std::this_thread::sleep_for(kWindow);
+    for (auto _ : state) {
+        chain.sink().TakeMaxGap();
+        std::this_thread::sleep_for(kWindow);
+        steady_gap_us += chain.sink().TakeMaxGap();
+
+        int64_t start = rtc::TimeMicros();
+        if (!chain.Swap()) {
+            ++failures;
+        }
+        swap_us += rtc::TimeMicros() - start;
+        std::this_thread::sleep_for(kWindow);
+        int64_t gap = chain.sink().TakeMaxGap();
+        swap_gap_us += gap;
+        if (gap > max_swap_gap_us) {
+            max_swap_gap_us = gap;
+        }
+    }
+
+    running.store(false);
+    pusher.join();
+    chain.Stop();
+
+    double n = (double)state.iterations();
+    state.counters["steady_gap_us"] = steady_gap_us / n;
+    state.counters["swap_gap_us"] = swap_gap_us / n;
+    state.counters["max_swap_gap_us"] = (double)max_swap_gap_us;
+    state.counters["swap_us"] = swap_us / n;
+    state.counters["failures"] = failures;
+}
+
+BENCHMARK(BM_ChainSwapGap)->Iterations(200)->UseRealTime();
+
+} // namespace
+} // namespace xrtc
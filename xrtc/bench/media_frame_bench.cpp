@@ -0,0 +1,40 @@
+﻿#include <benchmark/benchmark.h>
+
+#include "xrtc/bench/bench_util.h"
+#include "xrtc/media/base/media_frame.h"
+
+namespace xrtc {
+namespace {
+
+// 只分配一帧的内存
+void BM_MediaFrameAlloc(benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+    int size = width * height * 3 / 2;
+    for (auto _ : state) {
+        std::shared_ptr<MediaFrame> frame = std::make_shared<MediaFrame>(size);
+        benchmark::DoNotOptimize(frame->data[0]);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// 和CamImpl::OnFrame相同的分配+三个平面的拷贝
+void BM_CamFrameCopy(benchmark::State& state) {
+    SyntheticI420 src((int)state.range(0), (int)state.range(1), 64);
+    for (auto _ : state) {
+        std::shared_ptr<MediaFrame> frame = MediaFrame::CreateI420(
+            src.y.data(), src.stride_y,
+            src.u.data(), src.stride_uv,
+            src.v.data(), src.stride_uv,
+            src.width, src.height);
+        benchmark::DoNotOptimize(frame->data[0]);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * (int64_t)(src.y.size() + src.u.size() + src.v.size()));
+}
+
+BENCHMARK(BM_MediaFrameAlloc)->Args({ 640, 480 })->Args({ 1280, 720 })->Args({ 1920, 1080 });
+BENCHMARK(BM_CamFrameCopy)->Args({ 640, 480 })->Args({ 1280, 720 })->Args({ 1920, 1080 });
+
+} // namespace
+} // namespace xrtc
@@ -0,0 +1,90 @@
+﻿#include <benchmark/benchmark.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <opus/opus.h>
+
+#include <string>
+#include <vector>
+
+namespace xrtc {
+namespace {
+
+const int kSampleRate = 48000;
+const int kBitrate = 32000;
+
+// 类似语音的合成信号：基频和几个谐波，按4Hz调幅模拟音节，加少量噪声
+std::vector<int16_t> SyntheticSpeech(int samples) {
+    std::vector<int16_t> pcm(samples);
+    uint32_t seed = 1;
+    for (int i = 0; i < samples; ++i) {
+        double t = (double)i / kSampleRate;
+        double envelope = 0.5 + 0.5 * sin(2 * M_PI * 4 * t);
+        double v = 0;
+        for (int h = 1; h <= 5; ++h) {
+            v += sin(2 * M_PI * 150 * h * t) / h;
+        }
+        seed = seed * 1103515245 + 12345;
+        double noise = ((seed >> 16) & 0x7fff) / 32768.0 - 0.5;
+        pcm[i] = (int16_t)(6000 * envelope * v + 500 * noise);
+    }
+    return pcm;
+}
+
+// range(0): 帧长ms，range(1): complexity，range(2): 是否打开FEC(按10%丢包率提示)
+// 每次迭代编码一帧，耗时即每帧的编码开销，实时要求是远小于帧长
+void BM_OpusEncode(benchmark::State& state) {
+    int frame_ms = (int)state.range(0);
+    int complexity = (int)state.range(1);
+    bool fec = state.range(2) != 0;
+    int frame_samples = kSampleRate / 1000 * frame_ms;
+
+    int err = OPUS_OK;
+    OpusEncoder* encoder = opus_encoder_create(kSampleRate, 1, OPUS_APPLICATION_VOIP, &err);
+    if (!encoder || err != OPUS_OK) {
+        state.SkipWithError("opus_encoder_create failed");
+        return;
+    }
+    opus_encoder_ctl(encoder, OPUS_SET_BITRATE(kBitrate));
+    opus_encoder_ctl(encoder, OPUS_SET_COMPLEXITY(complexity));
+    opus_encoder_ctl(encoder, OPUS_SET_INBAND_FEC(fec ? 1 : 0));
+    opus_encoder_ctl(encoder, OPUS_SET_PACKET_LOSS_PERC(fec ? 10 : 0));
+
+    // 1秒的信号循环使用，避免每次编码完全相同的输入
+    std::vector<int16_t> pcm = SyntheticSpeech(kSampleRate);
+    unsigned char packet[1500];
+    int offset = 0;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        opus_int32 len = opus_encode(encoder, pcm.data() + offset, frame_samples,
+            packet, sizeof(packet));
+        if (len > 0) {
+            bytes += len;
+        }
+        offset += frame_samples;
+        if (offset + frame_samples > (int)pcm.size()) {
+            offset = 0;
+        }
+    }
+
+    opus_encoder_destroy(encoder);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["bytes_per_frame"] = state.iterations() ?
+        (double)bytes / state.iterations() : 0.0;
+    // 结果和libopus的版本(以及编译时是否开启了SIMD)有关，一起输出
+    state.SetLabel(std::string(fec ? "fec " : "no_fec ") + opus_get_version_string());
+}
+
+void OpusArgs(benchmark::internal::Benchmark* b) {
+    for (int frame_ms : { 10, 20 }) {
+        for (int complexity : { 0, 5, 9, 10 }) {
+            b->Args({ frame_ms, complexity, 0 });
+        }
+        b->Args({ frame_ms, 9, 1 });
+    }
+}
+
+BENCHMARK(BM_OpusEncode)->Apply(OpusArgs)->Unit(benchmark::kMicrosecond);
+
+} // namespace
+} // namespace xrtc
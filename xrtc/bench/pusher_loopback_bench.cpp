@@ -0,0 +1,1521 @@
+﻿#include <benchmark/benchmark.h>
+
+// 本机回环的端到端推流：合成视频源 -> XRTCPusher -> udp://127.0.0.1 -> 接收端
+// 以及经过本机信令替身(xrtc://)推流时，从StartPush到第一个媒体包的耗时，
+// 接收端作为ice-lite时在模拟的丢包和延时下ICE连通的耗时，以及路径中断后切换/重启的媒体中断时长，
+// 丢包时接收端逐个回复PLI，关键帧请求合并和帧内刷新对关键帧数量和码率尖峰的影响，
+// 以及限速链路的带宽突然下降时，时域分层在发送端丢帧对恢复时间和帧率连续性的影响，
+// 低起始码率推流时带宽探测把码率提到链路容量的耗时
+// 接收端只在Linux上实现(POSIX socket + 独立线程)
+#if defined(WEBRTC_LINUX)
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/xrtc.h"
+#include "xrtc/base/rcu_list.h"
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/bench/bench_util.h"
+#include "xrtc/bench/local_signaling_server.h"
+#include "xrtc/media/base/media_frame.h"
+#include "xrtc/media/chain/xrtc_pusher.h"
+#include "xrtc/rtc/rtcp_packet.h"
+#include "xrtc/rtc/stun_message.h"
+
+namespace xrtc {
+namespace {
+
+const int kPushSeconds = 5;
+
+// 按固定帧率输出合成画面的视频源，画面逐帧平移，编码器每帧都有残差要编码
+// 合成图像的高度是输出的两倍，每帧从不同的行开始截取
+class SyntheticVideoSource : public IVideoSource {
+public:
+    SyntheticVideoSource(int width, int height, int fps) :
+        image_(width, height * 2), height_(height), fps_(fps) {}
+    ~SyntheticVideoSource() override { Stop(); }
+
+    void Start() override {
+        running_ = true;
+        start_ms_ = rtc::TimeMillis();
+        thread_ = std::thread([this]() { Run(); });
+    }
+    void Setup(const std::string& /*json_config*/) override {}
+    void Stop() override {
+        running_ = false;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+    void Destroy() override {}
+    void AddConsumer(IXRTCConsumer* consumer) override { consumers_.Add(consumer); }
+    void RemoveConsumer(IXRTCConsumer* consumer) override { consumers_.Remove(consumer); }
+
+    int64_t start_ms() const { return start_ms_; }
+
+private:
+    void Run() {
+        int64_t interval_us = 1000000 / fps_;
+        int64_t next_us = rtc::TimeMicros();
+        int offset = 0;
+        while (running_) {
+            int64_t now_us = rtc::TimeMicros();
+            if (now_us < next_us) {
+                std::this_thread::sleep_for(std::chrono::microseconds(next_us - now_us));
+                continue;
+            }
+            next_us += interval_us;
+
+            offset = (offset + 2) % height_;
+            size_t offset_uv = (size_t)(offset / 2) * image_.stride_uv;
+            std::shared_ptr<MediaFrame> frame = MediaFrame::CreateI420(
+                image_.y.data() + (size_t)offset * image_.stride_y, image_.stride_y,
+                image_.u.data() + offset_uv, image_.stride_uv,
+                image_.v.data() + offset_uv, image_.stride_uv,
+                image_.width, height_);
+            frame->capture_time_ms = rtc::TimeMillis();
+            frame->ts = (uint32_t)(frame->capture_time_ms - start_ms_);
+            consumers_.ForEach([&](IXRTCConsumer* consumer) {
+                consumer->OnFrame(frame);
+            });
+        }
+    }
+
+    SyntheticI420 image_;
+    int height_;
+    int fps_;
+    int64_t start_ms_ = 0;
+    std::atomic<bool> running_{ false };
+    std::thread thread_;
+    RcuList<IXRTCConsumer*> consumers_;
+};
+
+// 回环接收端：在独立线程上收RTP，统计吞吐、序号丢失，以及每帧最后一个包(marker)
+// 到达时相对采集时间的延时。视频RTP时间戳为(采集时间-起始时间)*90
+// EnableIce之后同时作为ice-lite的服务端：回复校验通过的连通性检查，不主动发检查
+class LoopbackReceiver {
+public:
+    LoopbackReceiver() {
+        fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+        int buffer_size = 4 * 1024 * 1024;
+        setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(fd_, (sockaddr*)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(fd_, (sockaddr*)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+    }
+    ~LoopbackReceiver() {
+        Stop();
+        close(fd_);
+    }
+
+    void EnableIce(const std::string& ufrag, const std::string& pwd) {
+        ice_ufrag_ = ufrag;
+        ice_pwd_ = pwd;
+    }
+
+    // 模拟弱网：两个方向各按loss_percent随机丢包，STUN回复延迟一个RTT发出，
+    // 媒体包的到达时间加上半个RTT
+    void SetNetwork(int loss_percent, int rtt_ms, uint32_t seed) {
+        loss_percent_ = loss_percent;
+        rtt_ms_ = rtt_ms;
+        random_.seed(seed);
+    }
+
+    // 模拟路径中断(网卡消失、NAT映射失效)：收到的包全部丢弃，也不再回复
+    void SetBlackhole(bool blackhole) { blackhole_ = blackhole; }
+
+    // 每检测到一次丢包就向发送端回复一个PLI(不限频的接收端)，和STUN回复一样延迟一个RTT并且按比例丢弃
+    void EnablePli(bool enable) { pli_on_loss_ = enable; }
+
+    // 模拟瓶颈链路：媒体包按kbps排队发出，排队超过max_queue_ms的包丢弃(尾丢弃)，
+    // 到达时间为排队结束的时间，推流过程中可以修改，kbps为0表示不限速
+    void SetLinkCapacity(int kbps, int max_queue_ms) {
+        link_kbps_ = kbps;
+        max_queue_ms_ = max_queue_ms;
+    }
+
+    // 每interval_ms向发送端回复一个RR，丢包率按这段时间的序号缺口计算
+    void EnableReceiverReports(int interval_ms) { rr_interval_ms_ = interval_ms; }
+
+    // 按frame marking头扩展组帧，统计可解码的帧：帧完整，依赖的基础层帧没有丢失(TL0PICIDX连续)，
+    // 基础层丢帧之后等到关键帧才恢复。开启PLI时只在基础层不能解码时请求关键帧，高层丢帧不影响
+    void EnableFrameMarking(int extension_id) { frame_marking_id_ = extension_id; }
+
+    // 按transport-wide cc头扩展记录每个包的到达时间，每interval_ms回复一个反馈
+    void EnableTransportFeedback(int extension_id, int interval_ms) {
+        transport_cc_id_ = extension_id;
+        feedback_interval_ms_ = interval_ms;
+    }
+
+    void Start(int64_t start_ms, uint8_t video_pt) {
+        start_ms_ = start_ms;
+        video_pt_ = video_pt;
+        running_ = true;
+        thread_ = std::thread([this]() { Run(); });
+    }
+
+    void Stop() {
+        running_ = false;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    int port() const { return port_; }
+
+    int64_t packets = 0;
+    int64_t bytes = 0;
+    int64_t lost = 0;
+    int64_t frames = 0;
+    int64_t latency_sum_ms = 0;
+    int64_t max_latency_ms = 0;
+    std::atomic<int64_t> first_packet_ms{ 0 };//推流过程中也可以读取
+    int64_t last_packet_ms = 0;
+    int64_t stun_requests = 0;
+    int64_t plis_sent = 0;
+    int64_t keyframes = 0;//收到的IDR(FU-A的第一片或者单个NAL)
+    int64_t max_window_bytes = 0;//100ms窗口内最多的字节数，反映关键帧造成的尖峰
+    int64_t padding_bytes = 0;//只有填充的包(带宽探测)
+    // 从起始时间开始每100ms收到的媒体字节数，不含填充包
+    std::vector<int64_t> media_bytes_100ms;
+    // 可解码帧的到达时间和层号，开启frame marking时记录
+    struct DecodedFrame {
+        int64_t time_ms;
+        int temporal_id;
+    };
+    std::vector<DecodedFrame> decoded_frames;
+    // 每个RR周期的开始时间和丢包率(%)
+    struct LossInterval {
+        int64_t start_ms;
+        double loss_percent;
+    };
+    std::vector<LossInterval> loss_intervals;
+
+private:
+    struct PendingPacket {
+        int64_t send_ms;
+        std::vector<uint8_t> data;
+        sockaddr_in to;
+    };
+
+    struct ArrivingPacket {
+        int64_t arrival_us;
+        std::vector<uint8_t> data;
+        sockaddr_in from;
+    };
+
+    bool Lost() {
+        return loss_percent_ > 0 && (int)(random_() % 100) < loss_percent_;
+    }
+
+    void OnStun(const uint8_t* data, size_t size, const sockaddr_in& from) {
+        std::unique_ptr<StunMessage> request = StunMessage::Parse(data, size);
+        std::string username;
+        if (!request || request->type() != kStunBindingRequest ||
+            !request->GetUsername(&username) ||
+            username.compare(0, ice_ufrag_.size() + 1, ice_ufrag_ + ":") != 0 ||
+            !StunMessage::ValidateMessageIntegrity(data, size, ice_pwd_))
+        {
+            return;
+        }
+
+        ++stun_requests;
+        StunMessage response(kStunBindingResponse);
+        response.set_transaction_id(request->transaction_id());
+        response.AddXorMappedAddress(rtc::SocketAddress(rtc::IPAddress(from.sin_addr),
+            ntohs(from.sin_port)));
+        PendingPacket packet;
+        packet.send_ms = rtc::TimeMillis() + rtt_ms_;
+        packet.to = from;
+        response.Write(ice_pwd_, &packet.data);
+        if (!Lost()) {
+            pending_.push_back(std::move(packet));
+        }
+    }
+
+    void SendPli(uint32_t media_ssrc, const sockaddr_in& to) {
+        static const uint32_t kReceiverSsrc = 0x5EC0DE01;
+        PendingPacket packet;
+        packet.send_ms = rtc::TimeMillis() + rtt_ms_;
+        packet.to = to;
+        packet.data = { 0x80 | kRtcpPsfbPli, kRtcpPsfb, 0, 2 };
+        for (uint32_t ssrc : { kReceiverSsrc, media_ssrc }) {
+            for (int shift = 24; shift >= 0; shift -= 8) {
+                packet.data.push_back((uint8_t)(ssrc >> shift));
+            }
+        }
+        ++plis_sent;
+        if (!Lost()) {
+            pending_.push_back(std::move(packet));
+        }
+    }
+
+    void SendReceiverReport(int64_t now) {
+        static const uint32_t kReceiverSsrc = 0x5EC0DE01;
+        int64_t expected = rr_received_ + rr_lost_;
+        uint8_t fraction = expected > 0 ? (uint8_t)std::min<int64_t>(255,
+            rr_lost_ * 256 / expected) : 0;
+        loss_intervals.push_back({ rr_start_ms_, expected > 0 ? 100.0 * rr_lost_ / expected : 0 });
+        rr_start_ms_ = now;
+        rr_received_ = 0;
+        rr_lost_ = 0;
+        if (!has_seq_ || !has_from_) {
+            return;
+        }
+
+        PendingPacket packet;
+        packet.send_ms = rtc::TimeMillis() + rtt_ms_;
+        packet.to = last_from_;
+        packet.data = { 0x81, kRtcpRr, 0, 7 };
+        uint32_t extended_seq = ((uint32_t)seq_cycles_ << 16) | last_seq_;
+        uint32_t cumulative = (uint32_t)std::min<int64_t>(lost, 0x7FFFFF);
+        for (uint32_t value : { kReceiverSsrc, media_ssrc_,
+            ((uint32_t)fraction << 24) | cumulative, extended_seq, 0u, 0u, 0u })
+        {
+            for (int shift = 24; shift >= 0; shift -= 8) {
+                packet.data.push_back((uint8_t)(value >> shift));
+            }
+        }
+        if (!Lost()) {
+            pending_.push_back(std::move(packet));
+        }
+    }
+
+    // 返回one-byte头扩展中id对应的数据，长度不是len时返回nullptr
+    static const uint8_t* FindExtension(const uint8_t* data, size_t size, int id, size_t len) {
+        size_t header = 12 + (data[0] & 0x0F) * 4;
+        if (!(data[0] & 0x10) || size < header + 4 || data[header] != 0xBE ||
+            data[header + 1] != 0xDE)
+        {
+            return nullptr;
+        }
+
+        size_t end = header + 4 + (size_t)((data[header + 2] << 8) | data[header + 3]) * 4;
+        size_t offset = header + 4;
+        while (offset < end && end <= size) {
+            if (data[offset] == 0) {
+                ++offset;
+                continue;
+            }
+            int element_id = data[offset] >> 4;
+            size_t element_len = (data[offset] & 0x0F) + 1;
+            if (element_id == id && element_len == len && offset + 1 + len <= end) {
+                return data + offset + 1;
+            }
+            offset += 1 + element_len;
+        }
+        return nullptr;
+    }
+
+    // 返回frame marking的第一个字节，没有时返回-1
+    int ParseFrameMarking(const uint8_t* data, size_t size, uint8_t* tl0_pic_idx) const {
+        const uint8_t* marking = FindExtension(data, size, frame_marking_id_, 3);
+        if (!marking) {
+            return -1;
+        }
+        *tl0_pic_idx = marking[2];
+        return marking[0];
+    }
+
+    // 上一个反馈之后收到的传输层序号从小到大，中间缺的标为未收到；
+    // 状态都用2位的状态向量块，到达时间差都用2字节，单位250us，参考时间单位64ms
+    void SendTransportFeedback(int64_t now) {
+        static const uint32_t kReceiverSsrc = 0x5EC0DE01;
+        feedback_start_ms_ = now;
+        if (feedback_arrivals_.empty() || !has_from_) {
+            return;
+        }
+
+        int64_t base = feedback_arrivals_.begin()->first;
+        int64_t count = feedback_arrivals_.rbegin()->first - base + 1;
+        int64_t reference = feedback_arrivals_.begin()->second / 64000;
+        std::vector<uint8_t> chunks;
+        std::vector<uint8_t> deltas;
+        int64_t last_ticks = reference * 256;
+        for (int64_t i = 0; i < count; i += 7) {
+            uint16_t chunk = 0xC000;
+            for (int64_t k = 0; k < 7; ++k) {
+                auto it = feedback_arrivals_.find(base + i + k);
+                if (i + k >= count || it == feedback_arrivals_.end()) {
+                    continue;
+                }
+                chunk |= (uint16_t)(2 << (12 - 2 * k));
+                int64_t ticks = it->second / 250;
+                int16_t delta = (int16_t)std::max<int64_t>(-32768,
+                    std::min<int64_t>(32767, ticks - last_ticks));
+                last_ticks = ticks;
+                deltas.push_back((uint8_t)((uint16_t)delta >> 8));
+                deltas.push_back((uint8_t)delta);
+            }
+            chunks.push_back((uint8_t)(chunk >> 8));
+            chunks.push_back((uint8_t)chunk);
+        }
+        feedback_arrivals_.clear();
+
+        PendingPacket packet;
+        packet.send_ms = rtc::TimeMillis() + rtt_ms_;
+        packet.to = last_from_;
+        packet.data = { 0x80 | kRtcpRtpfbTransportCc, kRtcpRtpfb, 0, 0 };
+        for (uint32_t ssrc : { kReceiverSsrc, media_ssrc_ }) {
+            for (int shift = 24; shift >= 0; shift -= 8) {
+                packet.data.push_back((uint8_t)(ssrc >> shift));
+            }
+        }
+        packet.data.push_back((uint8_t)(base >> 8));
+        packet.data.push_back((uint8_t)base);
+        packet.data.push_back((uint8_t)(count >> 8));
+        packet.data.push_back((uint8_t)count);
+        packet.data.push_back((uint8_t)(reference >> 16));
+        packet.data.push_back((uint8_t)(reference >> 8));
+        packet.data.push_back((uint8_t)reference);
+        packet.data.push_back(feedback_count_++);
+        packet.data.insert(packet.data.end(), chunks.begin(), chunks.end());
+        packet.data.insert(packet.data.end(), deltas.begin(), deltas.end());
+        packet.data.resize((packet.data.size() + 3) / 4 * 4, 0);
+        size_t words = packet.data.size() / 4 - 1;
+        packet.data[2] = (uint8_t)(words >> 8);
+        packet.data[3] = (uint8_t)words;
+        if (!Lost()) {
+            pending_.push_back(std::move(packet));
+        }
+    }
+
+    void FinishFrame() {
+        if (!frame_open_) {
+            return;
+        }
+
+        frame_open_ = false;
+        bool complete = frame_start_ && frame_end_ && !frame_gap_;
+        bool decodable = false;
+        if (frame_tid_ == 0) {
+            if (complete && frame_key_) {
+                base_broken_ = false;
+            }
+            else if (!complete || (has_tl0_ && frame_tl0_ != (uint8_t)(last_tl0_ + 1))) {
+                base_broken_ = true;
+            }
+            has_tl0_ = true;
+            last_tl0_ = frame_tl0_;
+            upper_broken_ = false;
+            decodable = complete && !base_broken_;
+            if (base_broken_ && pli_on_loss_ && has_from_) {
+                SendPli(media_ssrc_, last_from_);
+            }
+        }
+        else {
+            decodable = complete && !base_broken_ && has_tl0_ && frame_tl0_ == last_tl0_ &&
+                !(frame_tid_ > 1 && upper_broken_);
+            if (frame_tid_ == 1) {
+                upper_broken_ = !complete;
+            }
+        }
+
+        if (decodable) {
+            decoded_frames.push_back({ frame_arrival_ms_, frame_tid_ });
+        }
+    }
+
+    void OnFramePacket(uint32_t ts, uint16_t seq, int marking, uint8_t tl0_pic_idx, int64_t now) {
+        if (!frame_open_ || ts != frame_ts_) {
+            FinishFrame();
+            frame_open_ = true;
+            frame_ts_ = ts;
+            frame_start_ = (marking & 0x80) != 0;
+            frame_end_ = false;
+            frame_gap_ = false;
+            frame_key_ = (marking & 0x20) != 0;
+            frame_tid_ = marking & 0x07;
+            frame_tl0_ = tl0_pic_idx;
+        }
+        else if (seq != (uint16_t)(frame_seq_ + 1)) {
+            frame_gap_ = true;
+        }
+        frame_seq_ = seq;
+        frame_arrival_ms_ = now;
+        if (marking & 0x40) {
+            frame_end_ = true;
+            FinishFrame();
+        }
+    }
+
+    static bool IsIdrStart(const uint8_t* payload, size_t size) {
+        uint8_t type = size > 0 ? payload[0] & 0x1F : 0;
+        return type == 5 || (type == 28 && size > 1 && (payload[1] & 0x80) &&
+            (payload[1] & 0x1F) == 5);
+    }
+
+    // 延时固定，按到期顺序发出
+    int SendPending() {
+        if (blackhole_) {
+            pending_.clear();
+        }
+        int64_t now = rtc::TimeMillis();
+        while (!pending_.empty() && pending_.front().send_ms <= now) {
+            const PendingPacket& packet = pending_.front();
+            sendto(fd_, packet.data.data(), packet.data.size(), 0, (const sockaddr*)&packet.to,
+                sizeof(packet.to));
+            pending_.pop_front();
+        }
+        return pending_.empty() ? 50 : (int)(pending_.front().send_ms - now);
+    }
+
+    // 排队结束的包按到达时间处理，返回距离下一个到达的毫秒数
+    int ProcessArrivals() {
+        int64_t now_us = rtc::TimeMicros();
+        while (!arrivals_.empty() && arrivals_.front().arrival_us <= now_us) {
+            ArrivingPacket& packet = arrivals_.front();
+            OnRtp(packet.data.data(), packet.data.size(), packet.from,
+                packet.arrival_us / 1000 + rtt_ms_ / 2, packet.arrival_us);
+            arrivals_.pop_front();
+        }
+        return arrivals_.empty() ? 50 :
+            (int)((arrivals_.front().arrival_us - now_us + 999) / 1000);
+    }
+
+    // 进入瓶颈链路的队列，排队超过上限时丢弃
+    void EnqueueOnLink(const uint8_t* data, size_t size, const sockaddr_in& from) {
+        int64_t now_us = rtc::TimeMicros();
+        int64_t depart_us = std::max(link_free_us_, now_us) +
+            (int64_t)size * 8 * 1000 / link_kbps_.load();
+        if (depart_us - now_us > (int64_t)max_queue_ms_.load() * 1000) {
+            return;
+        }
+        link_free_us_ = depart_us;
+        arrivals_.push_back({ depart_us, std::vector<uint8_t>(data, data + size), from });
+    }
+
+    void OnRtp(const uint8_t* buffer, size_t len, const sockaddr_in& from, int64_t now,
+        int64_t arrival_us)
+    {
+        if (packets == 0) {
+            first_packet_ms = now;
+        }
+        last_packet_ms = now;
+        last_from_ = from;
+        has_from_ = true;
+        ++packets;
+        ++rr_received_;
+        bytes += len;
+        if (now / 100 != window_) {
+            window_ = now / 100;
+            window_bytes_ = 0;
+        }
+        window_bytes_ += len;
+        max_window_bytes = std::max(max_window_bytes, window_bytes_);
+        size_t header = 12 + (buffer[0] & 0x0F) * 4;
+        if (buffer[0] & 0x10) {
+            header += 4 + (size_t)((buffer[header + 2] << 8) | buffer[header + 3]) * 4;
+        }
+        // 去掉末尾的填充，只有填充的包不是媒体
+        size_t payload_end = (buffer[0] & 0x20) ?
+            len - std::min<size_t>(len, buffer[len - 1]) : len;
+        if (header >= payload_end) {
+            padding_bytes += len;
+        }
+        else {
+            size_t bin = (size_t)std::max<int64_t>(0, (now - start_ms_) / 100);
+            if (bin >= media_bytes_100ms.size()) {
+                media_bytes_100ms.resize(bin + 1, 0);
+            }
+            media_bytes_100ms[bin] += len;
+        }
+        if (header < payload_end && IsIdrStart(buffer + header, payload_end - header)) {
+            ++keyframes;
+        }
+
+        if (transport_cc_id_ > 0) {
+            const uint8_t* sequence = FindExtension(buffer, len, transport_cc_id_, 2);
+            if (sequence) {
+                uint16_t transport_sequence = (uint16_t)((sequence[0] << 8) | sequence[1]);
+                int64_t unwrapped = transport_sequence;
+                if (has_transport_sequence_) {
+                    unwrapped = last_transport_sequence_ +
+                        (int16_t)(transport_sequence - (uint16_t)last_transport_sequence_);
+                }
+                last_transport_sequence_ = std::max(last_transport_sequence_, unwrapped);
+                has_transport_sequence_ = true;
+                feedback_arrivals_[unwrapped] = arrival_us;
+            }
+        }
+
+        uint32_t ssrc = ((uint32_t)buffer[8] << 24) | ((uint32_t)buffer[9] << 16) |
+            ((uint32_t)buffer[10] << 8) | buffer[11];
+        media_ssrc_ = ssrc;
+        uint16_t seq = (uint16_t)((buffer[2] << 8) | buffer[3]);
+        if (has_seq_) {
+            uint16_t gap = (uint16_t)(seq - last_seq_);
+            if (gap > 1 && gap < 0x8000) {
+                lost += gap - 1;
+                rr_lost_ += gap - 1;
+                if (pli_on_loss_ && frame_marking_id_ == 0) {
+                    SendPli(ssrc, from);
+                }
+            }
+            if (gap < 0x8000 && seq < last_seq_) {
+                ++seq_cycles_;
+            }
+        }
+        if (!has_seq_ || (uint16_t)(seq - last_seq_) < 0x8000) {
+            last_seq_ = seq;
+        }
+        has_seq_ = true;
+
+        uint32_t ts = ((uint32_t)buffer[4] << 24) | ((uint32_t)buffer[5] << 16) |
+            ((uint32_t)buffer[6] << 8) | buffer[7];
+        if (frame_marking_id_ > 0) {
+            uint8_t tl0_pic_idx = 0;
+            int marking = ParseFrameMarking(buffer, len, &tl0_pic_idx);
+            if (marking >= 0) {
+                OnFramePacket(ts, seq, marking, tl0_pic_idx, now);
+            }
+        }
+
+        if (buffer[1] & 0x80) {
+            int64_t latency = now - (start_ms_ + ts / 90);
+            latency_sum_ms += latency;
+            max_latency_ms = std::max(max_latency_ms, latency);
+            ++frames;
+        }
+    }
+
+    void Run() {
+        uint8_t buffer[2048];
+        pollfd pfd = { fd_, POLLIN, 0 };
+        rr_start_ms_ = rtc::TimeMillis();
+        while (running_) {
+            int timeout = std::min(SendPending(), ProcessArrivals());
+            if (rr_interval_ms_ > 0) {
+                int64_t now = rtc::TimeMillis();
+                if (now - rr_start_ms_ >= rr_interval_ms_) {
+                    SendReceiverReport(now);
+                }
+                timeout = std::min<int>(timeout, (int)(rr_start_ms_ + rr_interval_ms_ - now));
+            }
+            if (feedback_interval_ms_ > 0) {
+                int64_t now = rtc::TimeMillis();
+                if (now - feedback_start_ms_ >= feedback_interval_ms_) {
+                    SendTransportFeedback(now);
+                }
+                timeout = std::min<int>(timeout,
+                    (int)(feedback_start_ms_ + feedback_interval_ms_ - now));
+            }
+            if (poll(&pfd, 1, std::max(0, timeout)) <= 0) {
+                continue;
+            }
+
+            sockaddr_in from = {};
+            socklen_t from_len = sizeof(from);
+            ssize_t len = recvfrom(fd_, buffer, sizeof(buffer), 0, (sockaddr*)&from, &from_len);
+            if (len <= 0 || blackhole_ || Lost()) {
+                continue;
+            }
+            if (!ice_ufrag_.empty() && StunMessage::IsStunPacket(buffer, len)) {
+                OnStun(buffer, len, from);
+                continue;
+            }
+            if (len < 12 || (buffer[1] & 0x7F) != video_pt_) {
+                continue;
+            }
+
+            if (link_kbps_ > 0) {
+                EnqueueOnLink(buffer, len, from);
+                continue;
+            }
+            OnRtp(buffer, len, from, rtc::TimeMillis() + rtt_ms_ / 2, rtc::TimeMicros());
+        }
+    }
+
+    int fd_ = -1;
+    int port_ = 0;
+    int64_t start_ms_ = 0;
+    uint8_t video_pt_ = 0;
+    std::string ice_ufrag_;
+    std::string ice_pwd_;
+    int loss_percent_ = 0;
+    int rtt_ms_ = 0;
+    std::atomic<bool> blackhole_{ false };
+    bool pli_on_loss_ = false;
+    std::atomic<int> link_kbps_{ 0 };
+    std::atomic<int> max_queue_ms_{ 0 };
+    int64_t link_free_us_ = 0;
+    std::deque<ArrivingPacket> arrivals_;
+    int rr_interval_ms_ = 0;
+    int64_t rr_start_ms_ = 0;
+    int64_t rr_received_ = 0;
+    int64_t rr_lost_ = 0;
+    bool has_seq_ = false;
+    uint16_t last_seq_ = 0;
+    uint16_t seq_cycles_ = 0;
+    uint32_t media_ssrc_ = 0;
+    sockaddr_in last_from_ = {};
+    bool has_from_ = false;
+    int frame_marking_id_ = 0;
+    int transport_cc_id_ = 0;
+    int feedback_interval_ms_ = 0;
+    int64_t feedback_start_ms_ = 0;
+    uint8_t feedback_count_ = 0;
+    bool has_transport_sequence_ = false;
+    int64_t last_transport_sequence_ = 0;
+    std::map<int64_t, int64_t> feedback_arrivals_;//展开的传输层序号 -> 到达时间(us)
+    bool frame_open_ = false;
+    uint32_t frame_ts_ = 0;
+    uint16_t frame_seq_ = 0;
+    bool frame_start_ = false;
+    bool frame_end_ = false;
+    bool frame_gap_ = false;
+    bool frame_key_ = false;
+    int frame_tid_ = 0;
+    uint8_t frame_tl0_ = 0;
+    int64_t frame_arrival_ms_ = 0;
+    bool has_tl0_ = false;
+    uint8_t last_tl0_ = 0;
+    bool base_broken_ = true;//第一个关键帧之前不能解码
+    bool upper_broken_ = false;//TL1丢帧，依赖它的TL2不能解码
+    int64_t window_ = 0;
+    int64_t window_bytes_ = 0;
+    std::mt19937 random_;
+    std::deque<PendingPacket> pending_;
+    std::atomic<bool> running_{ false };
+    std::thread thread_;
+};
+
+class PushObserver : public XRTCEngineObserver {
+public:
+    void OnPushSuccess(XRTCPusher*) override { Notify(1); }
+    void OnPushFailed(XRTCPusher*, XRTCError) override { Notify(-1); }
+
+    // 等待推流的结果，1成功，-1失败，0超时
+    int Wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_for(lock, std::chrono::seconds(5), [this]() { return result_ != 0; });
+        int result = result_;
+        result_ = 0;
+        return result;
+    }
+
+    void Reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        result_ = 0;
+    }
+
+private:
+    void Notify(int result) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        result_ = result;
+        cv_.notify_all();
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    int result_ = 0;
+};
+
+double PushStat(const std::string& stats, const char* key) {
+    JsonValue value;
+    if (!value.FromJson(stats)) {
+        return 0;
+    }
+
+    JsonValue v = value.ToObject()["push"].ToObject(JsonObject())[key];
+    return v.ToDouble();
+}
+
+double PushIceStat(const std::string& stats, const char* key) {
+    JsonValue value;
+    if (!value.FromJson(stats)) {
+        return 0;
+    }
+
+    JsonObject jpush = value.ToObject()["push"].ToObject(JsonObject());
+    JsonValue v = jpush["ice"].ToObject(JsonObject())[key];
+    return v.ToDouble();
+}
+
+double PushBweStat(const std::string& stats, const char* key) {
+    JsonValue value;
+    if (!value.FromJson(stats)) {
+        return 0;
+    }
+
+    JsonObject jpush = value.ToObject()["push"].ToObject(JsonObject());
+    JsonValue v = jpush["bwe"].ToObject(JsonObject())[key];
+    return v.ToDouble();
+}
+
+// group非空时取节点统计中的子对象
+double NodeStat(const std::string& stats, const char* node, const char* key,
+    const char* group = nullptr)
+{
+    JsonValue value;
+    if (!value.FromJson(stats)) {
+        return 0;
+    }
+
+    JsonArray jnodes = value.ToObject()["nodes"].ToArray();
+    for (int i = 0; i < jnodes.Size(); ++i) {
+        JsonObject jnode = jnodes[i].ToObject();
+        if (jnode["name"].ToString("") != node) {
+            continue;
+        }
+        JsonValue v = group ? jnode[group].ToObject(JsonObject())[key] : jnode[key];
+        return v.ToDouble();
+    }
+    return 0;
+}
+
+double SinkStat(const std::string& stats, const char* key) {
+    return NodeStat(stats, "xrtc_media_sink", key);
+}
+
+// range(0)/range(1): 分辨率，range(2): 码率kbps，30fps，每次推流kPushSeconds秒
+// glass_to_network: 采集到最后一个包交给socket(us)，glass_to_receive: 采集到接收端收到最后一个包(ms)
+void BM_PusherLoopback(benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+    int bitrate_kbps = (int)state.range(2);
+
+    static PushObserver observer;
+    XRTCEngine::Init(&observer);
+
+    for (auto _ : state) {
+        SyntheticVideoSource source(width, height, 30);
+        LoopbackReceiver receiver;
+        XRTCPusher* pusher = XRTCEngine::CreatePusher(nullptr, &source);
+        pusher->Setup("{\"x264_encoder\":{\"bitrate\":" + std::to_string(bitrate_kbps) +
+            ",\"max_bitrate\":" + std::to_string(bitrate_kbps) + ",\"fps\":30}}");
+        pusher->StartPush("udp://127.0.0.1:" + std::to_string(receiver.port()));
+        if (observer.Wait() != 1) {
+            state.SkipWithError("push start failed");
+            pusher->Destroy();
+            break;
+        }
+
+        source.Start();
+        receiver.Start(source.start_ms(), XRTCMediaSink::kDefaultVideoPayloadType);
+        std::this_thread::sleep_for(std::chrono::seconds(kPushSeconds));
+        std::string stats = pusher->GetStats();
+        source.Stop();
+        pusher->StopPush();
+        // 等待网络线程上排队的包发完
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        receiver.Stop();
+        pusher->Destroy();
+
+        int64_t duration_ms = std::max<int64_t>(1,
+            receiver.last_packet_ms - receiver.first_packet_ms);
+        state.counters["recv_kbps"] = receiver.bytes * 8.0 / duration_ms;
+        state.counters["recv_fps"] = receiver.frames * 1000.0 / duration_ms;
+        state.counters["packets"] = (double)receiver.packets;
+        state.counters["lost"] = (double)receiver.lost;
+        state.counters["glass_to_network_us"] = SinkStat(stats, "glass_to_network_us");
+        state.counters["glass_to_receive_ms"] = receiver.frames ?
+            (double)receiver.latency_sum_ms / receiver.frames : 0;
+        state.counters["max_glass_to_receive_ms"] = (double)receiver.max_latency_ms;
+    }
+}
+BENCHMARK(BM_PusherLoopback)
+    ->Args({ 640, 360, 800 })
+    ->Args({ 1280, 720, 2500 })
+    ->Args({ 1920, 1080, 6000 })
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// range(0): 信令替身上新连接的握手延时(ms)。同一个pusher反复推流，第一次新建HTTP连接(cold)，
+// 之后复用保持的连接(warm)；源一直在输出，首帧耗时 = 信令往返 + 第一帧编码打包
+void BM_PushTimeToFirstMedia(benchmark::State& state) {
+    static PushObserver observer;
+    XRTCEngine::Init(&observer);
+
+    LocalSignalingServer server;
+    server.set_handshake_delay_ms((int)state.range(0));
+    if (!server.Start()) {
+        state.SkipWithError("signaling server start failed");
+        return;
+    }
+
+    SyntheticVideoSource source(640, 360, 30);
+    source.Start();
+    XRTCPusher* pusher = XRTCEngine::CreatePusher(nullptr, &source);
+    pusher->Setup("{\"x264_encoder\":{\"bitrate\":800,\"fps\":30}}");
+    std::string url = "xrtc://127.0.0.1:" + std::to_string(server.port()) +
+        "/push?uid=bench&streamName=bench&secure=0";
+
+    double cold_ms = 0;
+    double warm_ms = 0;
+    double offer_ms = 0;
+    int pushes = 0;
+    for (auto _ : state) {
+        LoopbackReceiver receiver;
+        server.set_media_address("127.0.0.1", receiver.port());
+        receiver.Start(source.start_ms(), LocalSignalingServer::kVideoPayloadType);
+        int64_t start_ms = rtc::TimeMillis();
+        pusher->StartPush(url);
+        if (observer.Wait() != 1) {
+            state.SkipWithError("push start failed");
+            break;
+        }
+
+        while (receiver.first_packet_ms == 0 && rtc::TimeMillis() - start_ms < 2000) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::string stats = pusher->GetStats();
+        pusher->StopPush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        receiver.Stop();
+        if (receiver.first_packet_ms == 0) {
+            state.SkipWithError("no media received");
+            break;
+        }
+
+        // 接收端看到的首帧耗时，包含网络线程发送和回环
+        double first_media_ms = (double)(receiver.first_packet_ms - start_ms);
+        (pushes == 0 ? cold_ms : warm_ms) += first_media_ms;
+        offer_ms += PushStat(stats, "offer_ms");
+        ++pushes;
+    }
+
+    source.Stop();
+    pusher->Destroy();
+
+    state.counters["cold_first_media_ms"] = cold_ms;
+    state.counters["warm_first_media_ms"] = pushes > 1 ? warm_ms / (pushes - 1) : 0;
+    state.counters["offer_ms"] = pushes ? offer_ms / pushes : 0;
+    state.counters["connections"] = (double)server.connections();
+}
+BENCHMARK(BM_PushTimeToFirstMedia)
+    ->Arg(0)
+    ->Arg(50)
+    ->Iterations(5)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// range(0): 丢包率(%)，range(1): RTT(ms)，range(2): 1为aggressive nomination，0为常规提名
+// 接收端是ice-lite，每次推流都重新收集和检查；信令在本机没有延时，耗时主要是ICE的检查和重传
+// connect: StartPush到ICE连通，first_media: StartPush到接收端收到第一个媒体包，5秒内没有收到媒体计为failures
+void BM_IceConnect(benchmark::State& state) {
+    static PushObserver observer;
+    XRTCEngine::Init(&observer);
+
+    const std::string ufrag = "benchufrag";
+    const std::string pwd = "benchpasswordbenchpassword";
+    LocalSignalingServer server;
+    server.set_ice_parameters(ufrag, pwd);
+    if (!server.Start()) {
+        state.SkipWithError("signaling server start failed");
+        return;
+    }
+
+    SyntheticVideoSource source(640, 360, 30);
+    source.Start();
+    XRTCPusher* pusher = XRTCEngine::CreatePusher(nullptr, &source);
+    pusher->Setup("{\"x264_encoder\":{\"bitrate\":800,\"fps\":30},"
+        "\"ice\":{\"include_loopback\":true,\"aggressive_nomination\":" +
+        std::string(state.range(2) ? "true" : "false") + "}}");
+    std::string url = "xrtc://127.0.0.1:" + std::to_string(server.port()) +
+        "/push?uid=bench&streamName=bench&secure=0";
+
+    std::vector<double> connect_ms;
+    std::vector<double> first_media_ms;
+    double checks = 0;
+    double retransmits = 0;
+    int failures = 0;
+    uint32_t seed = 1;
+    for (auto _ : state) {
+        LoopbackReceiver receiver;
+        receiver.EnableIce(ufrag, pwd);
+        receiver.SetNetwork((int)state.range(0), (int)state.range(1), seed++);
+        server.set_media_address("127.0.0.1", receiver.port());
+        receiver.Start(source.start_ms(), LocalSignalingServer::kVideoPayloadType);
+        int64_t start_ms = rtc::TimeMillis();
+        pusher->StartPush(url);
+        bool ok = observer.Wait() == 1;
+        while (ok && receiver.first_packet_ms == 0 && rtc::TimeMillis() - start_ms < 5000) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        std::string stats = pusher->GetStats();
+        pusher->StopPush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        receiver.Stop();
+        observer.Reset();
+        if (!ok || receiver.first_packet_ms == 0) {
+            ++failures;
+            continue;
+        }
+
+        connect_ms.push_back(PushStat(stats, "ice_connected_ms"));
+        first_media_ms.push_back((double)(receiver.first_packet_ms - start_ms));
+        checks += PushIceStat(stats, "checks_sent");
+        retransmits += PushIceStat(stats, "retransmits");
+    }
+
+    source.Stop();
+    pusher->Destroy();
+
+    auto percentile = [](std::vector<double> values, double p) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+    };
+    size_t pushes = std::max<size_t>(1, connect_ms.size());
+    state.counters["connect_p50_ms"] = percentile(connect_ms, 0.5);
+    state.counters["connect_p90_ms"] = percentile(connect_ms, 0.9);
+    state.counters["first_media_p50_ms"] = percentile(first_media_ms, 0.5);
+    state.counters["first_media_p90_ms"] = percentile(first_media_ms, 0.9);
+    state.counters["checks"] = checks / pushes;
+    state.counters["retransmits"] = retransmits / pushes;
+    state.counters["failures"] = failures;
+}
+BENCHMARK(BM_IceConnect)
+    ->Args({ 0, 0, 1 })
+    ->Args({ 0, 0, 0 })
+    ->Args({ 10, 100, 1 })
+    ->Args({ 10, 100, 0 })
+    ->Args({ 30, 200, 1 })
+    ->Args({ 30, 200, 0 })
+    ->Iterations(20)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// range(0): 0为切到备用候选对(offer带两个端口)，1为ICE重启(offer只有一个端口，中断后信令返回新的端口和ICE参数)
+// range(1): receive_timeout_ms，保活间隔取它的1/3。推流1秒后主路径中断，编码和打包一直在运行
+// recv_gap: 主路径收到的最后一个媒体包到新路径收到第一个媒体包；ice_gap: ICE统计的切换间隔
+// keyframes: 切换时请求的关键帧，5秒内新路径没有收到媒体计为failures
+void BM_IceHandover(benchmark::State& state) {
+    static PushObserver observer;
+    XRTCEngine::Init(&observer);
+
+    bool restart = state.range(0) == 1;
+    int receive_timeout_ms = (int)state.range(1);
+    const std::string ufrag = "benchufrag";
+    const std::string pwd = "benchpasswordbenchpassword";
+    const std::string restart_ufrag = "restartufrag";
+    const std::string restart_pwd = "restartpasswordrestartpassword";
+    LocalSignalingServer server;
+    if (!server.Start()) {
+        state.SkipWithError("signaling server start failed");
+        return;
+    }
+
+    SyntheticVideoSource source(640, 360, 30);
+    source.Start();
+    XRTCPusher* pusher = XRTCEngine::CreatePusher(nullptr, &source);
+    pusher->Setup("{\"x264_encoder\":{\"bitrate\":800,\"fps\":30},"
+        "\"ice\":{\"include_loopback\":true,\"receive_timeout_ms\":" +
+        std::to_string(receive_timeout_ms) + ",\"keepalive_interval_ms\":" +
+        std::to_string(receive_timeout_ms / 3) + "}}");
+    std::string url = "xrtc://127.0.0.1:" + std::to_string(server.port()) +
+        "/push?uid=bench&streamName=bench&secure=0";
+
+    std::vector<double> recv_gap_ms;
+    double ice_gap_ms = 0;
+    double handovers = 0;
+    double restarts = 0;
+    double keyframes = 0;
+    int failures = 0;
+    for (auto _ : state) {
+        LoopbackReceiver primary;
+        LoopbackReceiver backup;
+        primary.EnableIce(ufrag, pwd);
+        backup.EnableIce(restart ? restart_ufrag : ufrag, restart ? restart_pwd : pwd);
+        server.set_ice_parameters(ufrag, pwd);
+        server.set_media_address("127.0.0.1", primary.port(), restart ? 0 : backup.port());
+        primary.Start(source.start_ms(), LocalSignalingServer::kVideoPayloadType);
+        backup.Start(source.start_ms(), LocalSignalingServer::kVideoPayloadType);
+
+        pusher->StartPush(url);
+        bool ok = observer.Wait() == 1;
+        if (ok) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            if (restart) {
+                server.set_ice_parameters(restart_ufrag, restart_pwd);
+                server.set_media_address("127.0.0.1", backup.port());
+            }
+            primary.SetBlackhole(true);
+            int64_t cut_ms = rtc::TimeMillis();
+            while (backup.first_packet_ms == 0 && rtc::TimeMillis() - cut_ms < 5000) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        std::string stats = pusher->GetStats();
+        pusher->StopPush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        primary.Stop();
+        backup.Stop();
+        observer.Reset();
+        if (!ok || backup.first_packet_ms == 0) {
+            ++failures;
+            continue;
+        }
+
+        recv_gap_ms.push_back((double)(backup.first_packet_ms - primary.last_packet_ms));
+        ice_gap_ms += PushIceStat(stats, "max_handover_gap_ms");
+        handovers += PushIceStat(stats, "handovers");
+        restarts += PushStat(stats, "ice_restarts");
+        keyframes += PushIceStat(stats, "handover_keyframes");
+    }
+
+    source.Stop();
+    pusher->Destroy();
+
+    std::sort(recv_gap_ms.begin(), recv_gap_ms.end());
+    size_t runs = std::max<size_t>(1, recv_gap_ms.size());
+    state.counters["recv_gap_p50_ms"] = recv_gap_ms.empty() ? 0 : recv_gap_ms[recv_gap_ms.size() / 2];
+    state.counters["recv_gap_max_ms"] = recv_gap_ms.empty() ? 0 : recv_gap_ms.back();
+    state.counters["ice_gap_ms"] = ice_gap_ms / runs;
+    state.counters["handovers"] = handovers / runs;
+    state.counters["restarts"] = restarts / runs;
+    state.counters["keyframes"] = keyframes / runs;
+    state.counters["failures"] = failures;
+}
+BENCHMARK(BM_IceHandover)
+    ->Args({ 0, 1500 })
+    ->Args({ 0, 300 })
+    ->Args({ 1, 1500 })
+    ->Args({ 1, 300 })
+    ->Iterations(5)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// range(0): 0为每个PLI都生成IDR(keyframe_min_interval_ms为0)，1为按RTT合并后生成IDR，2为合并后帧内刷新
+// range(1): 丢包率，range(2): RTT(ms)。接收端每个丢包回复一个PLI，推流kPushSeconds秒
+// keyframes: 接收端收到的IDR(包括第一帧)，peak_kbps: 100ms窗口的最大码率，和send_kbps对比看尖峰
+void BM_KeyFrameRequests(benchmark::State& state) {
+    static PushObserver observer;
+    XRTCEngine::Init(&observer);
+
+    int mode = (int)state.range(0);
+    int loss_percent = (int)state.range(1);
+    int rtt_ms = (int)state.range(2);
+    const std::string ufrag = "benchufrag";
+    const std::string pwd = "benchpasswordbenchpassword";
+    LocalSignalingServer server;
+    if (!server.Start()) {
+        state.SkipWithError("signaling server start failed");
+        return;
+    }
+    server.set_ice_parameters(ufrag, pwd);
+
+    SyntheticVideoSource source(640, 360, 30);
+    source.Start();
+    XRTCPusher* pusher = XRTCEngine::CreatePusher(nullptr, &source);
+    pusher->Setup(std::string("{\"x264_encoder\":{\"bitrate\":800,\"fps\":30,") +
+        "\"keyframe_mode\":\"" + (mode == 2 ? "intra_refresh" : "idr") + "\"," +
+        "\"keyframe_min_interval_ms\":" + (mode == 0 ? "0" : "300") + "}," +
+        "\"ice\":{\"include_loopback\":true}}");
+    std::string url = "xrtc://127.0.0.1:" + std::to_string(server.port()) +
+        "/push?uid=bench&streamName=bench&secure=0";
+
+    double plis = 0;
+    double keyframes = 0;
+    double intra_refreshes = 0;
+    double forwarded = 0;
+    double dropped = 0;
+    double send_kbps = 0;
+    double peak_kbps = 0;
+    double lost_percent = 0;
+    int failures = 0;
+    // 编码节点的计数在重复推流之间累积，每次取差值
+    auto encoder_counts = [&](const std::string& stats) {
+        return std::vector<double>({
+            NodeStat(stats, "x264_encoder", "intra_refreshes"),
+            NodeStat(stats, "x264_encoder", "forwarded", "remote_keyframe_requests"),
+            NodeStat(stats, "x264_encoder", "stale", "remote_keyframe_requests") +
+                NodeStat(stats, "x264_encoder", "coalesced", "remote_keyframe_requests") });
+    };
+    for (auto _ : state) {
+        std::vector<double> before = encoder_counts(pusher->GetStats());
+        LoopbackReceiver receiver;
+        receiver.EnableIce(ufrag, pwd);
+        receiver.SetNetwork(loss_percent, rtt_ms, 47);
+        receiver.EnablePli(true);
+        server.set_media_address("127.0.0.1", receiver.port());
+        receiver.Start(source.start_ms(), LocalSignalingServer::kVideoPayloadType);
+
+        pusher->StartPush(url);
+        bool ok = observer.Wait() == 1;
+        if (ok) {
+            std::this_thread::sleep_for(std::chrono::seconds(kPushSeconds));
+        }
+        std::string stats = pusher->GetStats();
+        pusher->StopPush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        receiver.Stop();
+        observer.Reset();
+        if (!ok || receiver.packets == 0) {
+            ++failures;
+            continue;
+        }
+
+        plis += (double)receiver.plis_sent;
+        keyframes += (double)receiver.keyframes;
+        std::vector<double> after = encoder_counts(stats);
+        intra_refreshes += after[0] - before[0];
+        forwarded += after[1] - before[1];
+        dropped += after[2] - before[2];
+        send_kbps += (double)receiver.bytes * 8 / kPushSeconds / 1000;
+        peak_kbps += (double)receiver.max_window_bytes * 8 / 100;
+        lost_percent += 100.0 * receiver.lost / (receiver.packets + receiver.lost);
+    }
+
+    source.Stop();
+    pusher->Destroy();
+
+    double runs = std::max<int64_t>(1, state.iterations() - failures);
+    state.counters["plis"] = plis / runs;
+    state.counters["keyframes"] = keyframes / runs;
+    state.counters["intra_refreshes"] = intra_refreshes / runs;
+    state.counters["forwarded"] = forwarded / runs;
+    state.counters["dropped"] = dropped / runs;
+    state.counters["send_kbps"] = send_kbps / runs;
+    state.counters["peak_kbps"] = peak_kbps / runs;
+    state.counters["lost_percent"] = lost_percent / runs;
+    state.counters["failures"] = failures;
+}
+BENCHMARK(BM_KeyFrameRequests)
+    ->Args({ 0, 5, 100 })
+    ->Args({ 1, 5, 100 })
+    ->Args({ 2, 5, 100 })
+    ->Args({ 0, 5, 20 })
+    ->Args({ 1, 5, 20 })
+    ->Iterations(3)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// range(0): 时域层数(1/2/3)，range(1): 限速链路下降后的带宽kbps
+// 以1500kbps推流，链路带宽kBeforeDropKbps，kBeforeDropMs之后突然降到range(1)，持续kAfterDropMs。
+// 接收端每200ms回复RR，带宽估计按丢包率降码率，统计下降之后的kAfterDropMs内：
+// recovery_ms: 从下降到丢包率持续1秒不超过2%的时间
+// fps/min_fps: 可解码帧率和500ms窗口内最低的可解码帧率，max_gap_ms: 两个可解码帧的最大间隔
+// lost_percent: 链路上的丢包率，dropped_frames: 发送端按层丢掉的帧
+void BM_TemporalLayers(benchmark::State& state) {
+    static PushObserver observer;
+    XRTCEngine::Init(&observer);
+
+    const int kBeforeDropKbps = 3000;
+    const int64_t kBeforeDropMs = 2000;
+    const int64_t kAfterDropMs = 4000;
+    const int64_t kWindowMs = 500;
+    const int kMaxQueueMs = 400;
+    const int kFrameMarkingId = 3;
+    int temporal_layers = (int)state.range(0);
+    int capacity_kbps = (int)state.range(1);
+    const std::string ufrag = "benchufrag";
+    const std::string pwd = "benchpasswordbenchpassword";
+    LocalSignalingServer server;
+    if (!server.Start()) {
+        state.SkipWithError("signaling server start failed");
+        return;
+    }
+    server.set_ice_parameters(ufrag, pwd);
+    server.set_frame_marking_id(kFrameMarkingId);
+
+    SyntheticVideoSource source(640, 360, 30);
+    source.Start();
+    XRTCPusher* pusher = XRTCEngine::CreatePusher(nullptr, &source);
+    pusher->Setup("{\"x264_encoder\":{\"bitrate\":1500,\"max_bitrate\":1500,\"fps\":30,"
+        "\"temporal_layers\":" + std::to_string(temporal_layers) + "},"
+        "\"ice\":{\"include_loopback\":true},\"dtls\":{\"enabled\":false}}");
+    std::string url = "xrtc://127.0.0.1:" + std::to_string(server.port()) +
+        "/push?uid=bench&streamName=bench&secure=0";
+
+    double recovery_ms = 0;
+    double fps = 0;
+    double min_fps = 0;
+    double max_gap_ms = 0;
+    double lost_percent = 0;
+    double keyframes = 0;
+    double dropped_frames = 0;
+    int failures = 0;
+    auto layer_drops = [](const std::string& stats) {
+        JsonValue value;
+        double total = 0;
+        if (!value.FromJson(stats)) {
+            return total;
+        }
+        JsonArray jnodes = value.ToObject()["nodes"].ToArray();
+        for (int i = 0; i < jnodes.Size(); ++i) {
+            JsonObject jnode = jnodes[i].ToObject();
+            if (jnode["name"].ToString("") != "xrtc_media_sink") {
+                continue;
+            }
+            JsonArray jdropped = jnode["temporal_layers"].ToObject(JsonObject())[
+                "layer_frames_dropped"].ToArray();
+            for (int k = 0; k < jdropped.Size(); ++k) {
+                total += (double)(long long)jdropped[k].ToInt();
+            }
+        }
+        return total;
+    };
+    for (auto _ : state) {
+        double drops_before = layer_drops(pusher->GetStats());
+        LoopbackReceiver receiver;
+        receiver.EnableIce(ufrag, pwd);
+        receiver.SetNetwork(0, 20, 47);
+        receiver.EnablePli(true);
+        receiver.SetLinkCapacity(kBeforeDropKbps, kMaxQueueMs);
+        receiver.EnableReceiverReports(200);
+        receiver.EnableFrameMarking(kFrameMarkingId);
+        server.set_media_address("127.0.0.1", receiver.port());
+        receiver.Start(source.start_ms(), LocalSignalingServer::kVideoPayloadType);
+
+        pusher->StartPush(url);
+        bool ok = observer.Wait() == 1;
+        int64_t drop_ms = 0;
+        if (ok) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(kBeforeDropMs));
+            drop_ms = rtc::TimeMillis();
+            receiver.SetLinkCapacity(capacity_kbps, kMaxQueueMs);
+            std::this_thread::sleep_for(std::chrono::milliseconds(kAfterDropMs));
+        }
+        std::string stats = pusher->GetStats();
+        pusher->StopPush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        receiver.Stop();
+        observer.Reset();
+        if (!ok || receiver.packets == 0) {
+            ++failures;
+            continue;
+        }
+
+        // 到达时间包含半个RTT
+        int64_t begin = drop_ms + 10;
+        int64_t end = begin + kAfterDropMs;
+        std::vector<int64_t> windows((size_t)(kAfterDropMs / kWindowMs), 0);
+        int64_t frames = 0;
+        int64_t last = begin;
+        int64_t gap = 0;
+        for (const LoopbackReceiver::DecodedFrame& frame : receiver.decoded_frames) {
+            if (frame.time_ms < begin || frame.time_ms >= end) {
+                continue;
+            }
+            ++frames;
+            ++windows[(size_t)((frame.time_ms - begin) / kWindowMs)];
+            gap = std::max(gap, frame.time_ms - last);
+            last = frame.time_ms;
+        }
+        gap = std::max(gap, end - last);
+        fps += frames * 1000.0 / kAfterDropMs;
+        min_fps += *std::min_element(windows.begin(), windows.end()) * 1000.0 / kWindowMs;
+        max_gap_ms += (double)gap;
+
+        // 丢包率持续1秒(5个RR周期)不超过2%
+        double recovery = (double)kAfterDropMs;
+        const std::vector<LoopbackReceiver::LossInterval>& intervals = receiver.loss_intervals;
+        for (size_t i = 0; i < intervals.size(); ++i) {
+            if (intervals[i].start_ms + 200 < drop_ms) {
+                continue;
+            }
+            size_t n = 0;
+            while (i + n < intervals.size() && n < 5 && intervals[i + n].loss_percent <= 2) {
+                ++n;
+            }
+            if (n == 5) {
+                recovery = (double)std::max<int64_t>(0, intervals[i].start_ms - drop_ms);
+                break;
+            }
+        }
+        recovery_ms += recovery;
+        lost_percent += 100.0 * receiver.lost / (receiver.packets + receiver.lost);
+        keyframes += (double)receiver.keyframes;
+        dropped_frames += layer_drops(stats) - drops_before;
+    }
+
+    source.Stop();
+    pusher->Destroy();
+
+    double runs = std::max<int64_t>(1, state.iterations() - failures);
+    state.counters["recovery_ms"] = recovery_ms / runs;
+    state.counters["fps"] = fps / runs;
+    state.counters["min_fps"] = min_fps / runs;
+    state.counters["max_gap_ms"] = max_gap_ms / runs;
+    state.counters["lost_percent"] = lost_percent / runs;
+    state.counters["keyframes"] = keyframes / runs;
+    state.counters["dropped_frames"] = dropped_frames / runs;
+    state.counters["failures"] = failures;
+}
+BENCHMARK(BM_TemporalLayers)
+    ->Args({ 1, 800 })
+    ->Args({ 2, 800 })
+    ->Args({ 3, 800 })
+    ->Iterations(2)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// range(0): 是否带宽探测，range(1): 限速链路的带宽kbps
+// 起始码率kStartKbps，最大码率kMaxKbps，链路从一开始就限速；接收端每200ms回复RR，
+// 每50ms回复transport-wide cc反馈。从接收端收到第一个包开始计时，最多kRampMs：
+// bwe_ramp_ms: 目标码率达到链路带宽90%的时间(每20ms取一次统计)，达不到时为kRampMs
+// media_ramp_ms: 接收端500ms窗口内的媒体码率(不含填充)达到链路带宽90%的时间，包括编码器码率控制的滞后
+// probe_clusters: 探测簇数，padding_percent: 填充占发送字节的比例，lost_percent: 链路上的丢包率
+// recovery_probes/skipped_recovery_probes: 拥塞恢复时做了/因为持续丢包没做的恢复探测
+void BM_ProbeRampUp(benchmark::State& state) {
+    static PushObserver observer;
+    XRTCEngine::Init(&observer);
+
+    const int kStartKbps = 300;
+    const int kMaxKbps = 4000;
+    const int64_t kRampMs = 8000;
+    const int64_t kPollMs = 20;
+    const int64_t kWindowMs = 500;
+    const int kMaxQueueMs = 400;
+    const int kTransportCcId = 5;
+    bool probing = state.range(0) != 0;
+    int capacity_kbps = (int)state.range(1);
+    const std::string ufrag = "benchufrag";
+    const std::string pwd = "benchpasswordbenchpassword";
+    LocalSignalingServer server;
+    if (!server.Start()) {
+        state.SkipWithError("signaling server start failed");
+        return;
+    }
+    server.set_ice_parameters(ufrag, pwd);
+    server.set_transport_cc_id(kTransportCcId);
+
+    SyntheticVideoSource source(1280, 720, 30);
+    source.Start();
+    XRTCPusher* pusher = XRTCEngine::CreatePusher(nullptr, &source);
+    pusher->Setup("{\"x264_encoder\":{\"bitrate\":" + std::to_string(kMaxKbps) +
+        ",\"max_bitrate\":" + std::to_string(kMaxKbps) + ",\"fps\":30},"
+        "\"bwe\":{\"start_bitrate\":" + std::to_string(kStartKbps) + ",\"probing\":" +
+        (probing ? "true" : "false") + "},"
+        "\"ice\":{\"include_loopback\":true},\"dtls\":{\"enabled\":false}}");
+    std::string url = "xrtc://127.0.0.1:" + std::to_string(server.port()) +
+        "/push?uid=bench&streamName=bench&secure=0";
+
+    double bwe_ramp_ms = 0;
+    double media_ramp_ms = 0;
+    double probe_clusters = 0;
+    double recovery_probes = 0;
+    double skipped_recovery_probes = 0;
+    double padding_percent = 0;
+    double lost_percent = 0;
+    double final_kbps = 0;
+    int failures = 0;
+    double threshold_kbps = capacity_kbps * 0.9;
+    for (auto _ : state) {
+        std::string stats_before = pusher->GetStats();
+        double clusters_before = PushBweStat(stats_before, "probe_clusters");
+        double recovery_before = PushBweStat(stats_before, "recovery_probes");
+        double skipped_before = PushBweStat(stats_before, "skipped_recovery_probes");
+        LoopbackReceiver receiver;
+        receiver.EnableIce(ufrag, pwd);
+        receiver.SetNetwork(0, 20, 53);
+        receiver.SetLinkCapacity(capacity_kbps, kMaxQueueMs);
+        receiver.EnableReceiverReports(200);
+        receiver.EnableTransportFeedback(kTransportCcId, 50);
+        server.set_media_address("127.0.0.1", receiver.port());
+        receiver.Start(source.start_ms(), LocalSignalingServer::kVideoPayloadType);
+
+        pusher->StartPush(url);
+        bool ok = observer.Wait() == 1;
+        int64_t first_ms = 0;
+        int64_t bwe_ramp = kRampMs;
+        std::string stats;
+        if (ok) {
+            int64_t deadline = rtc::TimeMillis() + 2000;
+            while (receiver.first_packet_ms == 0 && rtc::TimeMillis() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            first_ms = receiver.first_packet_ms;
+            ok = first_ms != 0;
+        }
+        while (ok && rtc::TimeMillis() < first_ms + kRampMs) {
+            stats = pusher->GetStats();
+            if (bwe_ramp == kRampMs && PushBweStat(stats, "target_kbps") >= threshold_kbps) {
+                bwe_ramp = std::max<int64_t>(0, rtc::TimeMillis() - first_ms);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(kPollMs));
+        }
+        pusher->StopPush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        receiver.Stop();
+        observer.Reset();
+        if (!ok) {
+            ++failures;
+            continue;
+        }
+
+        // 第一个达到阈值的500ms窗口的结束时间
+        const std::vector<int64_t>& bins = receiver.media_bytes_100ms;
+        size_t first_bin = (size_t)std::max<int64_t>(0, (first_ms - source.start_ms()) / 100);
+        size_t window_bins = (size_t)(kWindowMs / 100);
+        int64_t media_ramp = kRampMs;
+        for (size_t i = first_bin; i + window_bins <= bins.size(); ++i) {
+            int64_t bytes = 0;
+            for (size_t k = i; k < i + window_bins; ++k) {
+                bytes += bins[k];
+            }
+            if (bytes * 8 / kWindowMs >= threshold_kbps) {
+                media_ramp = std::min<int64_t>(kRampMs, std::max<int64_t>(0,
+                    (int64_t)(i + window_bins) * 100 + source.start_ms() - first_ms));
+                break;
+            }
+        }
+
+        bwe_ramp_ms += (double)bwe_ramp;
+        media_ramp_ms += (double)media_ramp;
+        probe_clusters += PushBweStat(stats, "probe_clusters") - clusters_before;
+        recovery_probes += PushBweStat(stats, "recovery_probes") - recovery_before;
+        skipped_recovery_probes += PushBweStat(stats, "skipped_recovery_probes") - skipped_before;
+        padding_percent += receiver.bytes > 0 ?
+            100.0 * receiver.padding_bytes / receiver.bytes : 0;
+        lost_percent += 100.0 * receiver.lost /
+            std::max<int64_t>(1, receiver.packets + receiver.lost);
+        final_kbps += PushBweStat(stats, "target_kbps");
+    }
+
+    source.Stop();
+    pusher->Destroy();
+
+    double runs = std::max<int64_t>(1, state.iterations() - failures);
+    state.counters["bwe_ramp_ms"] = bwe_ramp_ms / runs;
+    state.counters["media_ramp_ms"] = media_ramp_ms / runs;
+    state.counters["probe_clusters"] = probe_clusters / runs;
+    state.counters["recovery_probes"] = recovery_probes / runs;
+    state.counters["skipped_recovery_probes"] = skipped_recovery_probes / runs;
+    state.counters["padding_percent"] = padding_percent / runs;
+    state.counters["lost_percent"] = lost_percent / runs;
+    state.counters["final_kbps"] = final_kbps / runs;
+    state.counters["failures"] = failures;
+}
+BENCHMARK(BM_ProbeRampUp)
+    ->Args({ 0, 2500 })
+    ->Args({ 1, 2500 })
+    ->Args({ 0, 1200 })
+    ->Args({ 1, 1200 })
+    ->Iterations(2)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
+} // namespace xrtc
+
+#endif // defined(WEBRTC_LINUX)
@@ -0,0 +1,237 @@
+﻿#include <benchmark/benchmark.h>
+#include <libyuv.h>
+
+// 联播的CPU开销：缩小(每层从原图缩放 vs 逐级2:1的金字塔)，以及完整的联播编码节点
+// 每输入一帧在媒体线程池上花的CPU时间(缩小+各层编码)，对比单层、三层和暂停一层
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xrtc/base/task_pool.h"
+#include "xrtc/base/thread_config.h"
+#include "xrtc/base/xrtc_global.h"
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/bench/bench_util.h"
+#include "xrtc/media/base/in_pin.h"
+#include "xrtc/media/base/media_chain.h"
+#include "xrtc/media/base/out_pin.h"
+#include "xrtc/media/filter/simulcast_encoder_filter.h"
+
+namespace xrtc {
+namespace {
+
+const int kWidth = 1280;
+const int kHeight = 720;
+const int kFps = 30;
+const int kFramesPerIteration = 30;
+
+// range(0): 0为每层都从原图双线性缩放，1为金字塔(每层从上一层2:1缩小)
+// range(1): 层数(含原图)，只计缩小，不含编码
+void BM_SimulcastDownscale(benchmark::State& state) {
+    bool pyramid = state.range(0) == 1;
+    int layers = (int)state.range(1);
+    SyntheticI420 src(kWidth, kHeight);
+    std::shared_ptr<MediaFrame> frame = MediaFrame::CreateI420(src.y.data(), src.stride_y,
+        src.u.data(), src.stride_uv, src.v.data(), src.stride_uv, kWidth, kHeight);
+    std::vector<std::shared_ptr<MediaFrame>> scaled;
+    for (int i = 1; i < layers; ++i) {
+        scaled.push_back(MediaFrame::CreateVideo(SubMediaType::kSubTypeI420,
+            kWidth >> i, kHeight >> i));
+    }
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < scaled.size(); ++i) {
+            if (pyramid) {
+                SimulcastEncoderFilter::Downscale(i == 0 ? *frame : *scaled[i - 1],
+                    scaled[i].get());
+            }
+            else {
+                MediaFrame* dst = scaled[i].get();
+                libyuv::I420Scale((const uint8_t*)frame->data[0], frame->stride[0],
+                    (const uint8_t*)frame->data[1], frame->stride[1],
+                    (const uint8_t*)frame->data[2], frame->stride[2],
+                    kWidth, kHeight,
+                    (uint8_t*)dst->data[0], dst->stride[0],
+                    (uint8_t*)dst->data[1], dst->stride[1],
+                    (uint8_t*)dst->data[2], dst->stride[2],
+                    dst->fmt.sub_fmt.video_fmt.width, dst->fmt.sub_fmt.video_fmt.height,
+                    libyuv::kFilterBilinear);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_SimulcastDownscale)->Args({ 0, 2 })->Args({ 1, 2 })->Args({ 0, 3 })->Args({ 1, 3 });
+
+MediaFormat VideoFormatOf(SubMediaType type) {
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeVideo;
+    fmt.sub_fmt.video_fmt.type = type;
+    fmt.sub_fmt.video_fmt.width = 0;
+    fmt.sub_fmt.video_fmt.height = 0;
+    fmt.sub_fmt.video_fmt.idr = false;
+    return fmt;
+}
+
+// 推I420帧的源节点，帧由Push直接送出
+class FrameSource : public MediaObject {
+public:
+    FrameSource() : out_pin_(std::make_unique<OutPin>(this)) {
+        out_pin_->set_format(VideoFormatOf(SubMediaType::kSubTypeI420));
+    }
+
+    bool Start() override { return true; }
+    void Stop() override {}
+    std::vector<InPin*> GetAllInPins() override { return std::vector<InPin*>(); }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>({ out_pin_.get() });
+    }
+    const char* name() const override { return "frame_source"; }
+
+    OutPin* out_pin() { return out_pin_.get(); }
+
+private:
+    std::unique_ptr<OutPin> out_pin_;
+};
+
+// 每层一个输入，统计每层收到的编码帧
+class LayerSink : public MediaObject {
+public:
+    explicit LayerSink(int layers) {
+        for (int i = 0; i < layers; ++i) {
+            in_pins_.push_back(std::make_unique<InPin>(this));
+            in_pins_.back()->set_format(VideoFormatOf(SubMediaType::kSubTypeH264));
+        }
+    }
+
+    bool Start() override { return true; }
+    void Stop() override {}
+    void OnNewPinFrame(InPin* in_pin, std::shared_ptr<MediaFrame> /*frame*/) override {
+        for (size_t i = 0; i < in_pins_.size(); ++i) {
+            if (in_pins_[i].get() == in_pin) {
+                frames[i]++;
+            }
+        }
+    }
+    std::vector<InPin*> GetAllInPins() override {
+        std::vector<InPin*> pins;
+        for (auto& pin : in_pins_) {
+            pins.push_back(pin.get());
+        }
+        return pins;
+    }
+    std::vector<OutPin*> GetAllOutPins() override { return std::vector<OutPin*>(); }
+    const char* name() const override { return "layer_sink"; }
+
+    std::atomic<int64_t> frames[SimulcastEncoderFilter::kMaxLayers] = {};
+
+private:
+    std::vector<std::unique_ptr<InPin>> in_pins_;
+};
+
+class SimulcastChain : public MediaChain {
+public:
+    explicit SimulcastChain(int layers) : encoder_(layers), sink_(layers) {}
+
+    void Start() override {
+        AddMediaObject(&source_);
+        AddMediaObject(&encoder_);
+        AddMediaObject(&sink_);
+        ConnectMediaObject(&source_, &encoder_);
+        ConnectMediaObject(&encoder_, &sink_);
+        // 所有层都用单线程的x264，编码的CPU时间都算在媒体线程池上
+        SetupChain("{\"x264_encoder\":{\"fps\":30,\"threads\":1,\"preset\":\"ultrafast\"},"
+            "\"simulcast_encoder\":{\"bitrates\":[1500,500,150]}}");
+        StartChain();
+
+        VideoStreamFormat format;
+        format.type = SubMediaType::kSubTypeI420;
+        format.width = kWidth;
+        format.height = kHeight;
+        format.fps = kFps;
+        source_.out_pin()->Renegotiate(format);
+    }
+
+    void Stop() override { StopChain(); }
+    void Destroy() override {}
+
+    void Push(std::shared_ptr<MediaFrame> frame) { source_.out_pin()->PushMediaFrame(frame); }
+    void Drain() { encoder_.Drain(); }
+
+    SimulcastEncoderFilter* encoder() { return &encoder_; }
+    LayerSink* sink() { return &sink_; }
+
+private:
+    FrameSource source_;
+    SimulcastEncoderFilter encoder_;
+    LayerSink sink_;
+};
+
+// 媒体线程池所有线程的CPU时间总和(ms)
+int64_t MediaPoolCpuMs() {
+    int64_t cpu_ms = 0;
+    for (ThreadStats* stats : XRTCGlobal::Instance()->media_pool()->thread_stats()) {
+        JsonObject jstats;
+        stats->GetStats(jstats);
+        cpu_ms += jstats["cpu_ms"].ToInt(0);
+    }
+    return cpu_ms;
+}
+
+// range(0): 层数，range(1): 暂停的层数(从最高分辨率的层开始暂停)
+// 每次迭代推kFramesPerIteration帧720p，每帧等各层编码完再推下一帧(实时采集时编码跟得上)，
+// cpu_ms_per_frame为每输入一帧的CPU时间，real_time/kFramesPerIteration为各层并行编码的延时
+void BM_SimulcastEncode(benchmark::State& state) {
+    int layers = (int)state.range(0);
+    int paused = (int)state.range(1);
+    SimulcastChain chain(layers);
+    chain.Start();
+    for (int i = 0; i < paused; ++i) {
+        chain.encoder()->SetLayerActive(i, false);
+    }
+
+    SyntheticI420 src(kWidth, kHeight);
+    std::vector<std::shared_ptr<MediaFrame>> frames;
+    for (int i = 0; i < 4; ++i) {
+        frames.push_back(MediaFrame::CreateI420(src.y.data(), src.stride_y,
+            src.u.data(), src.stride_uv, src.v.data(), src.stride_uv, kWidth, kHeight));
+    }
+
+    uint32_t ts = 0;
+    int64_t cpu_ms = 0;
+    for (auto _ : state) {
+        int64_t start_cpu_ms = MediaPoolCpuMs();
+        for (int i = 0; i < kFramesPerIteration; ++i) {
+            std::shared_ptr<MediaFrame> frame = frames[i % frames.size()];
+            ts += 1000 / kFps;
+            frame->ts = ts;
+            chain.Push(frame);
+            chain.Drain();
+        }
+        cpu_ms += MediaPoolCpuMs() - start_cpu_ms;
+    }
+
+    int64_t frames_in = state.iterations() * kFramesPerIteration;
+    state.counters["cpu_ms_per_frame"] = (double)cpu_ms / frames_in;
+    for (int i = 0; i < layers; ++i) {
+        state.counters["layer" + std::to_string(i) + "_frames"] =
+            (double)chain.sink()->frames[i].load() / state.iterations();
+    }
+
+    JsonObject jstats;
+    chain.encoder()->GetStats(jstats);
+    state.counters["pyramid_reused"] = (double)jstats["pyramid_reused"].ToInt(0);
+    state.counters["pyramid_allocated"] = (double)jstats["pyramid_allocated"].ToInt(0);
+    state.SetItemsProcessed(frames_in);
+    chain.Stop();
+}
+
+BENCHMARK(BM_SimulcastEncode)->Args({ 1, 0 })->Args({ 2, 0 })->Args({ 3, 0 })->Args({ 3, 1 })
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
+} // namespace xrtc
@@ -0,0 +1,261 @@
+﻿#include <benchmark/benchmark.h>
+
+// SRTP原地加密的吞吐(每核每秒的包数)，对比AES-CM+HMAC-SHA1和AES-GCM，一批是一帧打出来的所有包
+// 以及本机回环上两个ICE+DTLS-SRTP传输之间的握手耗时和加密发送、解密接收的完整路径
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/xrtc_global.h"
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/rtc/dtls_srtp_transport.h"
+#include "xrtc/rtc/ice_transport.h"
+#include "xrtc/rtc/rtp_packetizer.h"
+#include "xrtc/rtc/srtp_session.h"
+
+namespace xrtc {
+namespace {
+
+const uint8_t kPayloadType = 96;
+const uint32_t kSsrc = 0x12345678;
+
+// 一个IDR片NAL，大小正好打成packets个FU-A包
+std::vector<uint8_t> MakeFrame(int packets) {
+    size_t payload = RtpPacketizer::kDefaultMaxPacketSize - RtpPacketizer::kRtpHeaderSize - 2;
+    std::vector<uint8_t> frame(4 + 1 + payload * packets - 1);
+    frame[3] = 1;
+    frame[4] = 0x65;
+    for (size_t i = 5; i < frame.size(); ++i) {
+        frame[i] = (uint8_t)(i * 13 + 7);
+    }
+    return frame;
+}
+
+bool HasAesNi() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul");
+#else
+    return false;
+#endif
+}
+
+// range(0): SrtpProfile，range(1): 每批的包数(1为逐包)
+// 每次迭代恢复包长后在同一块缓冲上再加密一次，密文作为下一次的明文，不计拷贝
+void BM_SrtpProtect(benchmark::State& state) {
+    SrtpProfile profile = (SrtpProfile)state.range(0);
+    int packets = (int)state.range(1);
+    std::vector<uint8_t> key(SrtpSession::KeyLength(profile), 0x11);
+    std::vector<uint8_t> salt(SrtpSession::SaltLength(profile), 0x22);
+    SrtpSession session;
+    if (!session.Init(profile, key.data(), salt.data())) {
+        state.SkipWithError("srtp init failed");
+        return;
+    }
+
+    RtpPacketizer packetizer(kPayloadType, kSsrc);
+    RtpPacketBatch batch;
+    std::vector<uint8_t> frame = MakeFrame(packets);
+    packetizer.PacketizeH264(frame.data(), frame.size(), 90000, RtpFrameLayer(), &batch);
+    std::vector<size_t> sizes;
+    for (size_t i = 0; i < batch.packet_count(); ++i) {
+        sizes.push_back(batch.packet_size(i));
+    }
+
+    size_t bytes = batch.bytes();
+    for (auto _ : state) {
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            batch.packets[i].size = sizes[i];
+        }
+        if (!session.ProtectRtp(&batch)) {
+            state.SkipWithError("protect failed");
+            return;
+        }
+        benchmark::DoNotOptimize(batch.buffer.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * batch.packet_count());
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetLabel(std::string(SrtpSession::ProfileName(profile)) +
+        (HasAesNi() ? " aes-ni" : " no-aes-ni"));
+}
+BENCHMARK(BM_SrtpProtect)
+    ->ArgsProduct({ { (int64_t)SrtpProfile::kAes128CmSha1_80, (int64_t)SrtpProfile::kAeadAes128Gcm },
+        { 1, 8, 64 } });
+
+// 接收端解密：加密一次保存密文，每次迭代拷回原位再解密
+void BM_SrtpUnprotect(benchmark::State& state) {
+    SrtpProfile profile = (SrtpProfile)state.range(0);
+    std::vector<uint8_t> key(SrtpSession::KeyLength(profile), 0x11);
+    std::vector<uint8_t> salt(SrtpSession::SaltLength(profile), 0x22);
+    SrtpSession sender;
+    SrtpSession receiver;
+    if (!sender.Init(profile, key.data(), salt.data()) ||
+        !receiver.Init(profile, key.data(), salt.data()))
+    {
+        state.SkipWithError("srtp init failed");
+        return;
+    }
+
+    RtpPacketizer packetizer(kPayloadType, kSsrc);
+    RtpPacketBatch batch;
+    std::vector<uint8_t> frame = MakeFrame(1);
+    packetizer.PacketizeH264(frame.data(), frame.size(), 90000, RtpFrameLayer(), &batch);
+    sender.ProtectRtp(&batch);
+    std::vector<uint8_t> packet(batch.packet_data(0), batch.packet_data(0) + batch.packet_size(0));
+    std::vector<uint8_t> buffer(packet.size());
+
+    for (auto _ : state) {
+        memcpy(buffer.data(), packet.data(), packet.size());
+        size_t size = packet.size();
+        if (!receiver.UnprotectRtp(buffer.data(), &size)) {
+            state.SkipWithError("unprotect failed");
+            return;
+        }
+        benchmark::DoNotOptimize(buffer.data());
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * packet.size());
+    state.SetLabel(SrtpSession::ProfileName(profile));
+}
+BENCHMARK(BM_SrtpUnprotect)
+    ->Arg((int64_t)SrtpProfile::kAes128CmSha1_80)
+    ->Arg((int64_t)SrtpProfile::kAeadAes128Gcm);
+
+// 回环上的一端：ICE连通后客户端发起握手，服务端收到ClientHello时自动开始
+class LoopbackPeer : public IceTransportObserver, public DtlsSrtpObserver {
+public:
+    LoopbackPeer(rtc::Thread* network_thread, DtlsRole role, SrtpProfile profile) {
+        IceConfig ice_config;
+        ice_config.include_loopback = true;
+        DtlsConfig dtls_config;
+        dtls_config.srtp_profiles = { profile };
+        ice = std::make_unique<IceTransport>(network_thread, ice_config, this);
+        certificate = DtlsCertificate::Generate();
+        dtls = std::make_unique<DtlsSrtpTransport>(network_thread, ice.get(), certificate, role,
+            dtls_config, this);
+    }
+    ~LoopbackPeer() override {
+        dtls.reset();
+        ice.reset();
+    }
+
+    void OnIceCandidate(const IceCandidate& /*candidate*/) override {}
+    void OnIceStateChanged(IceTransportState state) override {
+        if (state == IceTransportState::kConnected) {
+            dtls->Start();
+        }
+    }
+    void OnIceRouteChanged(const IceRouteChange& /*change*/) override {}
+    void OnDtlsStateChanged(DtlsState state) override {
+        if (state == DtlsState::kConnected) {
+            connected_ms = rtc::TimeMillis();
+        }
+        else if (state == DtlsState::kFailed) {
+            failed = true;
+        }
+    }
+    void OnRtpPacket(uint8_t* /*data*/, size_t /*size*/) override { ++rtp_received; }
+
+    std::unique_ptr<IceTransport> ice;
+    std::shared_ptr<DtlsCertificate> certificate;
+    std::unique_ptr<DtlsSrtpTransport> dtls;
+    std::atomic<int64_t> connected_ms{ 0 };
+    std::atomic<bool> failed{ false };
+    std::atomic<int> rtp_received{ 0 };
+};
+
+// range(0): SrtpProfile。每次迭代新建两端，从开始ICE到双方DTLS连通计为handshake_ms，
+// 之后客户端按30fps发送kFrames帧(每帧8个包)，统计服务端解密成功的比例
+void BM_DtlsSrtpLoopback(benchmark::State& state) {
+    const int kFrames = 60;
+    const int kPacketsPerFrame = 8;
+    SrtpProfile profile = (SrtpProfile)state.range(0);
+    rtc::Thread* network_thread = XRTCGlobal::Instance()->network_thread();
+    std::vector<uint8_t> frame = MakeFrame(kPacketsPerFrame);
+
+    double handshake_ms = 0;
+    double delivered = 0;
+    int failures = 0;
+    int negotiated = 0;
+    for (auto _ : state) {
+        std::unique_ptr<LoopbackPeer> client;
+        std::unique_ptr<LoopbackPeer> server;
+        int64_t start_ms = rtc::TimeMillis();
+        bool started = network_thread->Invoke<bool>(RTC_FROM_HERE, [&]() {
+            client = std::make_unique<LoopbackPeer>(network_thread, DtlsRole::kClient, profile);
+            server = std::make_unique<LoopbackPeer>(network_thread, DtlsRole::kServer, profile);
+            client->dtls->SetRemoteFingerprint("sha-256", server->certificate->fingerprint());
+            server->dtls->SetRemoteFingerprint("sha-256", client->certificate->fingerprint());
+            // 服务端没有远端候选，从客户端的检查学到prflx候选
+            if (!server->ice->Start(client->ice->local_parameters(), {})) {
+                return false;
+            }
+            return client->ice->Start(server->ice->local_parameters(),
+                server->ice->local_candidates());
+        });
+
+        while (started && (client->connected_ms == 0 || server->connected_ms == 0) &&
+            !client->failed && !server->failed && rtc::TimeMillis() - start_ms < 5000)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        int sent = 0;
+        bool ok = started && client->connected_ms > 0 && server->connected_ms > 0;
+        if (ok) {
+            handshake_ms += (double)(std::max<int64_t>(client->connected_ms, server->connected_ms) -
+                start_ms);
+            negotiated += network_thread->Invoke<bool>(RTC_FROM_HERE, [&]() {
+                return client->dtls->srtp_profile() == profile &&
+                    server->dtls->srtp_profile() == profile;
+            });
+
+            RtpPacketizer packetizer(kPayloadType, kSsrc);
+            for (int i = 0; i < kFrames; ++i) {
+                RtpPacketBatch batch;
+                packetizer.PacketizeH264(frame.data(), frame.size(), i * 3000, RtpFrameLayer(),
+                    &batch);
+                sent += (int)batch.packet_count();
+                network_thread->Invoke<void>(RTC_FROM_HERE, [&]() {
+                    client->dtls->SendBatch(batch);
+                });
+                std::this_thread::sleep_for(std::chrono::milliseconds(33));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        int received = started ? server->rtp_received.load() : 0;
+        network_thread->Invoke<void>(RTC_FROM_HERE, [&]() {
+            client.reset();
+            server.reset();
+        });
+        if (!ok) {
+            ++failures;
+            continue;
+        }
+        delivered += sent > 0 ? (double)received / sent : 0;
+    }
+
+    size_t runs = std::max<int64_t>(1, state.iterations() - failures);
+    state.counters["handshake_ms"] = handshake_ms / runs;
+    state.counters["delivered"] = delivered / runs;
+    state.counters["negotiated"] = (double)negotiated / runs;
+    state.counters["failures"] = failures;
+    state.SetLabel(SrtpSession::ProfileName(profile));
+}
+BENCHMARK(BM_DtlsSrtpLoopback)
+    ->Arg((int64_t)SrtpProfile::kAes128CmSha1_80)
+    ->Arg((int64_t)SrtpProfile::kAeadAes128Gcm)
+    ->Iterations(3)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
+} // namespace xrtc
@@ -0,0 +1,74 @@
+﻿#include <benchmark/benchmark.h>
+#include <libyuv.h>
+
+#include <memory>
+#include <vector>
+
+#include "xrtc/base/task_pool.h"
+#include "xrtc/bench/bench_util.h"
+
+namespace xrtc {
+namespace {
+
+const int kFramesPerStream = 30;
+
+// 多路预览渲染：每路一个串行队列，每帧做一次640x360的I420转ARGB
+// 线程数为1时相当于所有预览都投递到同一个worker_thread
+void BM_PreviewStreams(benchmark::State& state) {
+    int streams = (int)state.range(0);
+    int threads = (int)state.range(1);
+    TaskPool pool(threads, "bench_pool");
+    SyntheticI420 src(640, 360);
+
+    std::vector<std::unique_ptr<SerialTaskQueue>> queues;
+    std::vector<std::vector<uint8_t>> argbs;
+    for (int i = 0; i < streams; ++i) {
+        queues.push_back(pool.CreateSerialQueue());
+        argbs.emplace_back(src.width * src.height * 4);
+    }
+
+    for (auto _ : state) {
+        for (int f = 0; f < kFramesPerStream; ++f) {
+            for (int i = 0; i < streams; ++i) {
+                uint8_t* argb = argbs[i].data();
+                queues[i]->PostTask([&src, argb]() {
+                    libyuv::I420ToARGB(src.y.data(), src.stride_y,
+                        src.u.data(), src.stride_uv,
+                        src.v.data(), src.stride_uv,
+                        argb, src.width * 4,
+                        src.width, src.height);
+                });
+            }
+        }
+
+        for (auto& queue : queues) {
+            queue->Flush();
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * streams * kFramesPerStream);
+    state.counters["threads"] = pool.num_threads();
+}
+
+BENCHMARK(BM_PreviewStreams)
+    ->Args({ 1, 1 })->Args({ 9, 1 })->Args({ 16, 1 })
+    ->Args({ 1, 0 })->Args({ 9, 0 })->Args({ 16, 0 })
+    ->UseRealTime();
+
+// 空任务的投递和调度开销
+void BM_SerialQueuePost(benchmark::State& state) {
+    TaskPool pool((int)state.range(0), "bench_pool");
+    std::unique_ptr<SerialTaskQueue> queue = pool.CreateSerialQueue();
+    for (auto _ : state) {
+        for (int i = 0; i < 100; ++i) {
+            queue->PostTask([]() {});
+        }
+        queue->Flush();
+    }
+    state.SetItemsProcessed(state.iterations() * 100);
+}
+
+BENCHMARK(BM_SerialQueuePost)->Arg(1)->Arg(0)->UseRealTime();
+
+} // namespace
+} // namespace xrtc
@@ -0,0 +1,329 @@
+﻿#include <benchmark/benchmark.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// 时域分层的码流在发送端丢掉高层之后能否正常解码：X264EncoderFilter编码，TemporalLayerDropper
+// 按低于编码码率的目标丢帧，剩下的帧(1) 按H.264 7.4.3检查frame_num：SPS不允许间隔时，
+// frame_num只能比上一个参考帧大1，否则是非法的跳变(硬件解码器和严格的接收端当作丢包，
+// libavcodec不检查，所以单独统计)；(2) 用libavcodec解码，和完整码流解码出的同一帧逐字节比较
+#include <math.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <common_video/h264/h264_common.h>
+
+#include "xrtc/media/base/h264_bitstream.h"
+#include "xrtc/media/base/in_pin.h"
+#include "xrtc/media/base/media_chain.h"
+#include "xrtc/media/base/out_pin.h"
+#include "xrtc/media/filter/x264_encoder_filter.h"
+#include "xrtc/rtc/temporal_layer_dropper.h"
+
+namespace xrtc {
+namespace {
+
+const int kWidth = 640;
+const int kHeight = 360;
+const int kFps = 30;
+const int kBitrateKbps = 800;
+const int kFrames = 150;//5秒，包含按gop插入的关键帧
+
+MediaFormat VideoFormatOf(SubMediaType type) {
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeVideo;
+    fmt.sub_fmt.video_fmt.type = type;
+    fmt.sub_fmt.video_fmt.width = 0;
+    fmt.sub_fmt.video_fmt.height = 0;
+    fmt.sub_fmt.video_fmt.idr = false;
+    return fmt;
+}
+
+class FrameSource : public MediaObject {
+public:
+    FrameSource() : out_pin_(std::make_unique<OutPin>(this)) {
+        out_pin_->set_format(VideoFormatOf(SubMediaType::kSubTypeI420));
+    }
+
+    bool Start() override { return true; }
+    void Stop() override {}
+    std::vector<InPin*> GetAllInPins() override { return std::vector<InPin*>(); }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>({ out_pin_.get() });
+    }
+    const char* name() const override { return "frame_source"; }
+
+    OutPin* out_pin() { return out_pin_.get(); }
+
+private:
+    std::unique_ptr<OutPin> out_pin_;
+};
+
+struct EncodedFrame {
+    RtpFrameLayer layer;
+    std::vector<uint8_t> data;
+};
+
+class EncodedSink : public MediaObject {
+public:
+    EncodedSink() : in_pin_(std::make_unique<InPin>(this)) {
+        in_pin_->set_format(VideoFormatOf(SubMediaType::kSubTypeH264));
+    }
+
+    bool Start() override { return true; }
+    void Stop() override {}
+    void OnNewPinFrame(InPin* /*in_pin*/, std::shared_ptr<MediaFrame> frame) override {
+        EncodedFrame encoded;
+        encoded.layer.keyframe = frame->fmt.sub_fmt.video_fmt.idr;
+        encoded.layer.temporal_id = (uint8_t)frame->fmt.sub_fmt.video_fmt.temporal_id;
+        encoded.layer.discardable = frame->fmt.sub_fmt.video_fmt.discardable;
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(frame->data[0]);
+        encoded.data.assign(data, data + frame->data_len[0]);
+        frames.push_back(std::move(encoded));
+    }
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>({ in_pin_.get() });
+    }
+    std::vector<OutPin*> GetAllOutPins() override { return std::vector<OutPin*>(); }
+    const char* name() const override { return "encoded_sink"; }
+
+    std::vector<EncodedFrame> frames;
+
+private:
+    std::unique_ptr<InPin> in_pin_;
+};
+
+class EncodeChain : public MediaChain {
+public:
+    void Start() override {
+        AddMediaObject(&source_);
+        AddMediaObject(&encoder_);
+        AddMediaObject(&sink_);
+        ConnectMediaObject(&source_, &encoder_);
+        ConnectMediaObject(&encoder_, &sink_);
+        SetupChain(config_);
+        StartChain();
+
+        VideoStreamFormat format;
+        format.type = SubMediaType::kSubTypeI420;
+        format.width = kWidth;
+        format.height = kHeight;
+        format.fps = kFps;
+        source_.out_pin()->Renegotiate(format);
+    }
+
+    void Stop() override { StopChain(); }
+    void Destroy() override {}
+
+    void set_config(const std::string& config) { config_ = config; }
+    void Push(std::shared_ptr<MediaFrame> frame) { source_.out_pin()->PushMediaFrame(frame); }
+    void Drain() { encoder_.Drain(); }
+    std::vector<EncodedFrame>& frames() { return sink_.frames; }
+
+private:
+    std::string config_;
+    FrameSource source_;
+    X264EncoderFilter encoder_;
+    EncodedSink sink_;
+};
+
+// 移动的条纹加少量噪声，帧间预测有实际的运动
+std::shared_ptr<MediaFrame> MovingFrame(int index) {
+    std::shared_ptr<MediaFrame> frame = MediaFrame::CreateVideo(SubMediaType::kSubTypeI420,
+        kWidth, kHeight);
+    uint32_t seed = (uint32_t)index + 1;
+    for (int y = 0; y < kHeight; ++y) {
+        uint8_t* row = reinterpret_cast<uint8_t*>(frame->data[0]) + y * frame->stride[0];
+        for (int x = 0; x < kWidth; ++x) {
+            seed = seed * 1103515245 + 12345;
+            row[x] = (uint8_t)(128 + 60 * sin((x + 3 * index) * 0.05) * cos((y + index) * 0.07) +
+                ((seed >> 16) & 7));
+        }
+    }
+    for (int plane = 1; plane < 3; ++plane) {
+        for (int y = 0; y < kHeight / 2; ++y) {
+            memset(reinterpret_cast<uint8_t*>(frame->data[plane]) + y * frame->stride[plane],
+                128 + plane * 10 + index % 7, kWidth / 2);
+        }
+    }
+    frame->ts = (uint32_t)(index * 1000 / kFps);
+    return frame;
+}
+
+// 按H.264 7.4.3检查一串帧的frame_num，返回非法跳变的次数；码流中所有的帧都是参考帧
+int CountIllegalFrameNumGaps(const std::vector<const EncodedFrame*>& frames, bool* gaps_allowed) {
+    H264Bitstream::Sps sps;
+    bool has_sps = false;
+    int prev_ref_frame_num = -1;
+    int illegal = 0;
+    for (const EncodedFrame* frame : frames) {
+        const uint8_t* data = frame->data.data();
+        for (const auto& index : webrtc::H264::FindNaluIndices(data, frame->data.size())) {
+            const uint8_t* nalu = data + index.payload_start_offset;
+            webrtc::H264::NaluType type = webrtc::H264::ParseNaluType(nalu[0]);
+            if (type == webrtc::H264::kSps) {
+                has_sps = H264Bitstream::ParseSps(nalu, index.payload_size, &sps);
+                *gaps_allowed = has_sps && sps.gaps_in_frame_num_allowed;
+                continue;
+            }
+            int frame_num = 0;
+            if (!has_sps || !H264Bitstream::ParseFrameNum(nalu, index.payload_size, sps, &frame_num)) {
+                continue;
+            }
+            int max_frame_num = 1 << sps.log2_max_frame_num;
+            if (type != webrtc::H264::kIdr && prev_ref_frame_num >= 0 &&
+                frame_num != prev_ref_frame_num &&
+                frame_num != (prev_ref_frame_num + 1) % max_frame_num &&
+                !sps.gaps_in_frame_num_allowed)
+            {
+                ++illegal;
+            }
+            if ((nalu[0] & 0x60) != 0) {
+                prev_ref_frame_num = frame_num;
+            }
+            break;//一帧只看第一个slice
+        }
+    }
+    return illegal;
+}
+
+// 解码一串帧，返回每个输出帧的哈希，errors为libavcodec报告的错误数(err_detect=explode)
+std::vector<uint64_t> DecodeFrames(const std::vector<const EncodedFrame*>& frames, int* errors) {
+    std::vector<uint64_t> hashes;
+    const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+    AVCodecContext* ctx = codec ? avcodec_alloc_context3(codec) : nullptr;
+    AVDictionary* opts = nullptr;
+    av_dict_set(&opts, "err_detect", "explode", 0);
+    av_dict_set(&opts, "threads", "1", 0);
+    if (!ctx || avcodec_open2(ctx, codec, &opts) < 0) {
+        av_dict_free(&opts);
+        avcodec_free_context(&ctx);
+        ++*errors;
+        return hashes;
+    }
+    av_dict_free(&opts);
+
+    AVPacket* packet = av_packet_alloc();
+    AVFrame* picture = av_frame_alloc();
+    auto receive = [&]() {
+        int ret;
+        while ((ret = avcodec_receive_frame(ctx, picture)) == 0) {
+            uint64_t hash = 1469598103934665603ull;
+            for (int plane = 0; plane < 3; ++plane) {
+                int w = plane ? picture->width / 2 : picture->width;
+                int h = plane ? picture->height / 2 : picture->height;
+                for (int y = 0; y < h; ++y) {
+                    const uint8_t* row = picture->data[plane] + y * picture->linesize[plane];
+                    for (int x = 0; x < w; ++x) {
+                        hash = (hash ^ row[x]) * 1099511628211ull;
+                    }
+                }
+            }
+            hashes.push_back(hash);
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+            ++*errors;
+        }
+    };
+    for (const EncodedFrame* frame : frames) {
+        packet->data = const_cast<uint8_t*>(frame->data.data());
+        packet->size = (int)frame->data.size();
+        if (avcodec_send_packet(ctx, packet) < 0) {
+            ++*errors;
+        }
+        receive();
+    }
+    avcodec_send_packet(ctx, nullptr);
+    receive();
+
+    av_frame_free(&picture);
+    av_packet_free(&packet);
+    avcodec_free_context(&ctx);
+    return hashes;
+}
+
+// range(0): 时域层数，range(1): 丢帧的目标码率占编码码率kBitrateKbps的百分比
+// 每次迭代编码kFrames帧，按目标码率丢帧后检查和解码剩下的帧：
+// illegal_gaps: frame_num非法跳变的次数，sps_gaps_allowed: SPS是否允许frame_num间隔，
+// decode_errors: 解码错误，mismatched_frames: 和完整码流解码结果不同的帧(包括没有解码出来的)
+void BM_TemporalLayerDecode(benchmark::State& state) {
+    int temporal_layers = (int)state.range(0);
+    int target_percent = (int)state.range(1);
+    std::vector<std::shared_ptr<MediaFrame>> inputs;
+    for (int i = 0; i < kFrames; ++i) {
+        inputs.push_back(MovingFrame(i));
+    }
+
+    double dropped = 0;
+    double illegal_gaps = 0;
+    double decode_errors = 0;
+    double mismatched = 0;
+    bool gaps_allowed = false;
+    for (auto _ : state) {
+        EncodeChain chain;
+        chain.set_config("{\"x264_encoder\":{\"fps\":30,\"threads\":1,\"preset\":\"ultrafast\","
+            "\"bitrate\":" + std::to_string(kBitrateKbps) + ",\"temporal_layers\":" +
+            std::to_string(temporal_layers) + "}}");
+        chain.Start();
+        for (auto& frame : inputs) {
+            chain.Push(frame);
+            chain.Drain();
+        }
+        chain.Stop();
+
+        std::vector<EncodedFrame>& frames = chain.frames();
+        TemporalLayerDropper dropper;
+        dropper.SetTargetBitrate(kBitrateKbps * 1000 / 100 * target_percent);
+        std::vector<const EncodedFrame*> all;
+        std::vector<const EncodedFrame*> kept;
+        std::vector<size_t> kept_index;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            all.push_back(&frames[i]);
+            if (dropper.OnFrame(frames[i].layer, frames[i].data.size(),
+                (int64_t)i * 1000 / kFps))
+            {
+                kept.push_back(&frames[i]);
+                kept_index.push_back(i);
+            }
+        }
+
+        int errors = 0;
+        std::vector<uint64_t> reference = DecodeFrames(all, &errors);
+        std::vector<uint64_t> decoded = DecodeFrames(kept, &errors);
+        int different = 0;
+        for (size_t i = 0; i < kept.size(); ++i) {
+            if (i >= decoded.size() || kept_index[i] >= reference.size() ||
+                decoded[i] != reference[kept_index[i]])
+            {
+                ++different;
+            }
+        }
+
+        dropped += (double)(frames.size() - kept.size());
+        illegal_gaps += CountIllegalFrameNumGaps(kept, &gaps_allowed);
+        decode_errors += errors;
+        mismatched += different;
+    }
+
+    double runs = (double)state.iterations();
+    state.counters["dropped_frames"] = dropped / runs;
+    state.counters["illegal_gaps"] = illegal_gaps / runs;
+    state.counters["sps_gaps_allowed"] = gaps_allowed ? 1 : 0;
+    state.counters["decode_errors"] = decode_errors / runs;
+    state.counters["mismatched_frames"] = mismatched / runs;
+    state.SetItemsProcessed(state.iterations() * kFrames);
+}
+
+BENCHMARK(BM_TemporalLayerDecode)
+    ->Args({ 2, 60 })
+    ->Args({ 3, 60 })
+    ->Args({ 3, 30 })
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
+} // namespace xrtc
@@ -0,0 +1,78 @@
+﻿#include <benchmark/benchmark.h>
+#include <libyuv.h>
+
+#include <vector>
+
+#include "xrtc/bench/bench_util.h"
+#include "xrtc/media/filter/video_compositor.h"
+
+namespace xrtc {
+namespace {
+
+const int kCanvasWidth = 1280;
+const int kCanvasHeight = 720;
+
+// 每路单独渲染：每路一次640x360的I420转ARGB(相当于每路一个渲染设备)
+void BM_SeparateRenders(benchmark::State& state) {
+    int streams = (int)state.range(0);
+    SyntheticI420 src(640, 360);
+    std::vector<uint8_t> argb(src.width * src.height * 4);
+
+    for (auto _ : state) {
+        for (int i = 0; i < streams; ++i) {
+            libyuv::I420ToARGB(src.y.data(), src.stride_y,
+                src.u.data(), src.stride_uv,
+                src.v.data(), src.stride_uv,
+                argb.data(), src.width * 4,
+                src.width, src.height);
+        }
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * streams);
+}
+
+BENCHMARK(BM_SeparateRenders)->Arg(4)->Arg(9)->Arg(16);
+
+// 合成后渲染：每路缩放到网格中的一格，整张画布只转换一次ARGB
+void BM_CompositeRender(benchmark::State& state) {
+    int streams = (int)state.range(0);
+    SyntheticI420 src(640, 360);
+    std::vector<VideoCompositor::Tile> tiles =
+        VideoCompositor::GridLayout(streams, kCanvasWidth, kCanvasHeight);
+
+    int stride_uv = kCanvasWidth / 2;
+    std::vector<uint8_t> canvas(kCanvasWidth * kCanvasHeight * 3 / 2);
+    uint8_t* canvas_y = canvas.data();
+    uint8_t* canvas_u = canvas_y + kCanvasWidth * kCanvasHeight;
+    uint8_t* canvas_v = canvas_u + stride_uv * (kCanvasHeight / 2);
+    std::vector<uint8_t> argb(kCanvasWidth * kCanvasHeight * 4);
+
+    for (auto _ : state) {
+        for (auto& tile : tiles) {
+            libyuv::I420Scale(src.y.data(), src.stride_y,
+                src.u.data(), src.stride_uv,
+                src.v.data(), src.stride_uv,
+                src.width, src.height,
+                canvas_y + tile.y * kCanvasWidth + tile.x, kCanvasWidth,
+                canvas_u + (tile.y / 2) * stride_uv + tile.x / 2, stride_uv,
+                canvas_v + (tile.y / 2) * stride_uv + tile.x / 2, stride_uv,
+                tile.width, tile.height,
+                libyuv::kFilterBilinear);
+        }
+
+        libyuv::I420ToARGB(canvas_y, kCanvasWidth,
+            canvas_u, stride_uv,
+            canvas_v, stride_uv,
+            argb.data(), kCanvasWidth * 4,
+            kCanvasWidth, kCanvasHeight);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * streams);
+}
+
+BENCHMARK(BM_CompositeRender)->Arg(4)->Arg(9)->Arg(16);
+
+} // namespace
+} // namespace xrtc
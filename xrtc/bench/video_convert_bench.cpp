@@ -0,0 +1,75 @@
+﻿#include <benchmark/benchmark.h>
+#include <libyuv.h>
+
+#include <vector>
+
+#include "xrtc/bench/bench_util.h"
+#include "xrtc/media/base/media_frame.h"
+#include "xrtc/media/base/video_convert.h"
+
+namespace xrtc {
+namespace {
+
+// D3D9RenderSink::DoRender中的I420转ARGB
+void BM_I420ToARGB(benchmark::State& state) {
+    SyntheticI420 src((int)state.range(0), (int)state.range(1));
+    std::vector<uint8_t> argb(src.width * src.height * 4);
+    for (auto _ : state) {
+        libyuv::I420ToARGB(src.y.data(), src.stride_y,
+            src.u.data(), src.stride_uv,
+            src.v.data(), src.stride_uv,
+            argb.data(), src.width * 4,
+            src.width, src.height);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * (int64_t)src.frame_size());
+}
+
+BENCHMARK(BM_I420ToARGB)->Args({ 640, 480 })->Args({ 1280, 720 })->Args({ 1920, 1080 });
+
+std::shared_ptr<MediaFrame> CreateNV12(int width, int height) {
+    SyntheticI420 src(width, height);
+    std::shared_ptr<MediaFrame> i420 = MediaFrame::CreateI420(src.y.data(), src.stride_y,
+        src.u.data(), src.stride_uv, src.v.data(), src.stride_uv, width, height);
+    std::shared_ptr<MediaFrame> nv12 = MediaFrame::CreateVideo(SubMediaType::kSubTypeNV12,
+        width, height);
+    ConvertVideoFrame(*i420, nv12.get());
+    return nv12;
+}
+
+// NV12源渲染：渲染节点直接接受NV12，一次转换
+void BM_NV12ToARGBDirect(benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+    std::shared_ptr<MediaFrame> nv12 = CreateNV12(width, height);
+    std::vector<uint8_t> argb(width * height * 4);
+    for (auto _ : state) {
+        ConvertToARGB(*nv12, argb.data(), width * 4);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_NV12ToARGBDirect)->Args({ 1280, 720 })->Args({ 1920, 1080 });
+
+// NV12源渲染：只接受I420时先转成I420(分配新帧)再转ARGB
+void BM_NV12ToARGBViaI420(benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+    std::shared_ptr<MediaFrame> nv12 = CreateNV12(width, height);
+    std::vector<uint8_t> argb(width * height * 4);
+    for (auto _ : state) {
+        std::shared_ptr<MediaFrame> i420 = MediaFrame::CreateVideo(SubMediaType::kSubTypeI420,
+            width, height);
+        ConvertVideoFrame(*nv12, i420.get());
+        ConvertToARGB(*i420, argb.data(), width * 4);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_NV12ToARGBViaI420)->Args({ 1280, 720 })->Args({ 1920, 1080 });
+
+} // namespace
+} // namespace xrtc
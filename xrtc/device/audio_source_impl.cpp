@@ -0,0 +1,279 @@
+﻿#include "xrtc/device/audio_source_impl.h"
+
+#include <algorithm>
+
+#include <rtc_base/logging.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/xrtc_global.h"
+#include "xrtc/base/xrtc_json.h"
+
+namespace xrtc {
+
+namespace {
+
+// 超过3帧没有数据，下游的抖动缓冲很可能已经欠载
+const int kGlitchIntervalMs = 30;
+// 节拍最多补发的帧数，更久的阻塞按丢失处理
+const int kMaxCatchUpFrames = 20;
+
+} // namespace
+
+AudioSourceImpl::AudioSourceImpl(const char* type, const std::string& id) :
+    type_(type),
+    id_(id),
+    current_thread_(rtc::Thread::Current()),
+    frame_pool_(kMaxSampleRate / 1000 * kFrameMs * kMaxChannels * (int)sizeof(int16_t))
+{
+    XRTCGlobal::Instance()->AddAudioSource(this);
+}
+
+AudioSourceImpl::~AudioSourceImpl() {
+    XRTCGlobal::Instance()->RemoveAudioSource(this);
+}
+
+void AudioSourceImpl::Start() {
+    RTC_LOG(LS_INFO) << "AudioSourceImpl Start call, type: " << type_;
+    current_thread_->PostTask(webrtc::ToQueuedTask([=] {
+        XRTCError err = XRTCError::kNoErr;
+        if (has_start_) {
+            RTC_LOG(LS_WARNING) << "AudioSourceImpl already start, ignore";
+        }
+        else {
+            err = XRTCGlobal::Instance()->audio_thread()->Invoke<XRTCError>(RTC_FROM_HERE, [=]() {
+                return StartAudio();
+            });
+            has_start_ = (err == XRTCError::kNoErr);
+        }
+
+        XRTCEngineObserver* observer = XRTCGlobal::Instance()->engine_observer();
+        if (!observer) {
+            return;
+        }
+
+        if (err != XRTCError::kNoErr) {
+            observer->OnAudioSourceFailed(this, err);
+        }
+        else {
+            observer->OnAudioSourceSuccess(this);
+        }
+    }));
+}
+
+// 设置参数：{"sample_rate":48000,"channels":1,...}，启动前调用，各个源支持的参数见子类
+void AudioSourceImpl::Setup(const std::string& json_config) {
+    current_thread_->PostTask(webrtc::ToQueuedTask([=] {
+        RTC_LOG(LS_INFO) << "AudioSourceImpl Setup PostTask, config: " << json_config;
+
+        JsonValue value;
+        if (!value.FromJson(json_config)) {
+            RTC_LOG(LS_WARNING) << "AudioSourceImpl Setup failed to parse JSON";
+            return;
+        }
+
+        JsonObject jobject = value.ToObject();
+        XRTCGlobal::Instance()->audio_thread()->Invoke<void>(RTC_FROM_HERE, [&]() {
+            ParseConfig(jobject);
+        });
+    }));
+}
+
+void AudioSourceImpl::Stop() {
+    RTC_LOG(LS_INFO) << "AudioSourceImpl Stop call, type: " << type_;
+    current_thread_->PostTask(webrtc::ToQueuedTask([=] {
+        if (!has_start_) {
+            return;
+        }
+
+        XRTCGlobal::Instance()->audio_thread()->Invoke<void>(RTC_FROM_HERE, [=]() {
+            StopAudio();
+        });
+        has_start_ = false;
+    }));
+}
+
+void AudioSourceImpl::Destroy() {
+    RTC_LOG(LS_INFO) << "AudioSourceImpl Destroy call, type: " << type_;
+    current_thread_->PostTask(webrtc::ToQueuedTask([=] {
+        if (has_start_) {
+            XRTCGlobal::Instance()->audio_thread()->Invoke<void>(RTC_FROM_HERE, [=]() {
+                StopAudio();
+            });
+            has_start_ = false;
+        }
+        delete this;
+    }));
+}
+
+void AudioSourceImpl::AddConsumer(IXRTCConsumer* consumer) {
+    RTC_LOG(LS_INFO) << "AudioSourceImpl add consumer: " << consumer;
+    consumer_list_.Add(consumer);
+}
+
+// 等待采集线程上正在进行的分发结束后返回
+void AudioSourceImpl::RemoveConsumer(IXRTCConsumer* consumer) {
+    RTC_LOG(LS_INFO) << "AudioSourceImpl remove consumer: " << consumer;
+    consumer_list_.Remove(consumer);
+}
+
+std::string AudioSourceImpl::GetStats() {
+    JsonObject jstats;
+    jstats["type"] = type_;
+    jstats["id"] = id_;
+    jstats["started"] = has_start_;
+    jstats["sample_rate"] = out_sample_rate_.load();
+    jstats["channels"] = out_channels_.load();
+    jstats["fps"] = frames_.Rate(rtc::TimeMillis());
+    jstats["frames"] = frames_.count();
+    jstats["frames_dropped"] = frames_dropped_.count();
+    jstats["glitches"] = glitches_.count();
+    jstats["interval_max_ms"] = interval_max_ms_.exchange(0);
+    jstats["pool_allocated"] = frame_pool_.allocated();
+    jstats["pool_reused"] = frame_pool_.reused();
+    jstats["consumers"] = consumer_list_.size();
+    GetSourceStats(jstats);
+    return JsonValue(jstats).ToJson();
+}
+
+std::shared_ptr<MediaFrame> AudioSourceImpl::AcquireFrame(int sample_rate, int channels) {
+    int samples_per_channel = sample_rate * kFrameMs / 1000;
+    int size = samples_per_channel * channels * (int)sizeof(int16_t);
+    if (size <= 0 || size > frame_pool_.frame_size()) {
+        frames_dropped_.Add();
+        return nullptr;
+    }
+
+    std::shared_ptr<MediaFrame> frame = frame_pool_.Acquire();
+    frame->fmt.media_type = MainMediaType::kMainTypeAudio;
+    frame->fmt.sub_fmt.audio_fmt.type = SubMediaType::kSubTypePcm;
+    frame->fmt.sub_fmt.audio_fmt.sample_rate = sample_rate;
+    frame->fmt.sub_fmt.audio_fmt.channels = channels;
+    frame->fmt.sub_fmt.audio_fmt.samples_per_channel = samples_per_channel;
+    frame->data_len[0] = size;
+    return frame;
+}
+
+void AudioSourceImpl::DeliverFrame(std::shared_ptr<MediaFrame> frame) {
+    int64_t now = rtc::TimeMillis();
+    int64_t last = last_frame_ms_.exchange(now);
+    if (last != 0) {
+        int64_t interval = now - last;
+        if (interval > kGlitchIntervalMs) {
+            glitches_.Add();
+        }
+        if (interval > interval_max_ms_) {
+            interval_max_ms_ = interval;
+        }
+    }
+
+    out_sample_rate_ = frame->fmt.sub_fmt.audio_fmt.sample_rate;
+    out_channels_ = frame->fmt.sub_fmt.audio_fmt.channels;
+    frame->ts = next_ts_.fetch_add(kFrameMs);
+    frame->capture_time_ms = now;
+    frames_.Add();
+
+    consumer_list_.ForEach([&](IXRTCConsumer* consumer) {
+        consumer->OnFrame(frame);
+    });
+}
+
+PacedAudioSource::PacedAudioSource(const char* type, const std::string& id) :
+    AudioSourceImpl(type, id)
+{
+}
+
+PacedAudioSource::~PacedAudioSource() {
+}
+
+XRTCError PacedAudioSource::StartAudio() {
+    XRTCError err = OpenAudio();
+    if (err != XRTCError::kNoErr) {
+        return err;
+    }
+
+    RTC_LOG(LS_INFO) << "PacedAudioSource start, sample_rate: " << sample_rate_
+        << ", channels: " << channels_;
+    next_frame_ms_ = rtc::TimeMillis();
+    alive_ = std::make_shared<std::atomic<bool>>(true);
+    ScheduleTick(alive_);
+    return XRTCError::kNoErr;
+}
+
+void PacedAudioSource::StopAudio() {
+    if (alive_) {
+        *alive_ = false;
+        alive_ = nullptr;
+    }
+    CloseAudio();
+}
+
+// 采样率需要是100的整数倍，保证每10ms的采样数是整数
+void PacedAudioSource::ParseConfig(const JsonObject& jobject) {
+    int sample_rate = (int)jobject["sample_rate"].ToInt(sample_rate_);
+    int channels = (int)jobject["channels"].ToInt(channels_);
+    if (sample_rate <= 0 || sample_rate > kMaxSampleRate || sample_rate % 100 != 0 ||
+        channels <= 0 || channels > kMaxChannels)
+    {
+        RTC_LOG(LS_WARNING) << "PacedAudioSource unsupported format: " << sample_rate
+            << "Hz, " << channels << " channels";
+        return;
+    }
+
+    sample_rate_ = sample_rate;
+    channels_ = channels;
+}
+
+void PacedAudioSource::GetSourceStats(JsonObject& stats) {
+    stats["frames_late"] = frames_late_.count();
+    stats["frames_skipped"] = frames_skipped_.count();
+}
+
+// 按绝对时间排下一次节拍，延时任务的误差不会累积
+void PacedAudioSource::ScheduleTick(std::shared_ptr<std::atomic<bool>> alive) {
+    int delay_ms = (int)std::max<int64_t>(0, next_frame_ms_ - rtc::TimeMillis());
+    XRTCGlobal::Instance()->audio_thread()->PostDelayedTask(webrtc::ToQueuedTask([this, alive]() {
+        if (!*alive) {
+            return;
+        }
+
+        if (Tick()) {
+            ScheduleTick(alive);
+        }
+    }), delay_ms);
+}
+
+// 输出所有已经到期的帧，返回false表示数据结束
+bool PacedAudioSource::Tick() {
+    int64_t now = rtc::TimeMillis();
+    int64_t behind = (now - next_frame_ms_) / kFrameMs;
+    if (behind > kMaxCatchUpFrames) {
+        RTC_LOG(LS_WARNING) << "PacedAudioSource fell behind " << behind * kFrameMs
+            << "ms, skip";
+        frames_skipped_.Add(behind);
+        next_frame_ms_ += behind * kFrameMs;
+    }
+    else if (behind > 0) {
+        frames_late_.Add(behind);
+    }
+
+    while (next_frame_ms_ <= now) {
+        std::shared_ptr<MediaFrame> frame = AcquireFrame(sample_rate_, channels_);
+        if (!frame) {
+            return false;
+        }
+
+        if (!ReadAudio(reinterpret_cast<int16_t*>(frame->data[0]),
+            frame->fmt.sub_fmt.audio_fmt.samples_per_channel))
+        {
+            RTC_LOG(LS_INFO) << "PacedAudioSource end of data";
+            return false;
+        }
+
+        DeliverFrame(frame);
+        next_frame_ms_ += kFrameMs;
+    }
+    return true;
+}
+
+} // namespace xrtc
@@ -0,0 +1,108 @@
+﻿#ifndef XRTCSDK_XRTC_DEVICE_AUDIO_SOURCE_IMPL_H_
+#define XRTCSDK_XRTC_DEVICE_AUDIO_SOURCE_IMPL_H_
+
+#include <atomic>
+#include <memory>
+
+#include <rtc_base/thread.h>
+
+#include "xrtc/xrtc.h"
+#include "xrtc/base/rcu_list.h"
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/media/base/media_frame_pool.h"
+
+namespace xrtc {
+
+class JsonObject;
+
+// 音频源的公共部分：启动/停止流程、消费者列表、帧缓冲池和统计
+// 接口在创建它的api_thread上执行，设备和节拍相关的操作同步切到audio_thread上
+class AudioSourceImpl : public IAudioSource {
+public:
+    // 帧缓冲池按最大的10ms帧分配：48kHz双声道16bit
+    static const int kMaxSampleRate = 48000;
+    static const int kMaxChannels = 2;
+    static const int kFrameMs = 10;
+
+    void Start() override;
+    void Setup(const std::string& json_config) override;
+    void Stop() override;
+    void Destroy() override;
+    void AddConsumer(IXRTCConsumer* consumer) override;
+    void RemoveConsumer(IXRTCConsumer* consumer) override;
+    std::string GetStats() override;
+
+protected:
+    AudioSourceImpl(const char* type, const std::string& id);
+    ~AudioSourceImpl() override;
+
+    // 以下在audio_thread上调用
+    virtual XRTCError StartAudio() = 0;
+    virtual void StopAudio() = 0;
+    virtual void ParseConfig(const JsonObject& /*jobject*/) {}
+    // 子类自己的统计，可以在任意线程调用
+    virtual void GetSourceStats(JsonObject& /*stats*/) {}
+
+    // 从池中取一帧并填好格式，超出池的帧大小时返回nullptr
+    std::shared_ptr<MediaFrame> AcquireFrame(int sample_rate, int channels);
+    // 在采集线程上分发给所有消费者
+    void DeliverFrame(std::shared_ptr<MediaFrame> frame);
+
+    friend class XRTCEngine;
+
+private:
+    const char* type_;
+    std::string id_;
+    rtc::Thread* current_thread_;
+    bool has_start_ = false;
+    MediaFramePool frame_pool_;
+    RcuList<IXRTCConsumer*> consumer_list_;
+
+    // 以下在采集线程上写，统计时读取
+    std::atomic<int> out_sample_rate_{ 0 };
+    std::atomic<int> out_channels_{ 0 };
+    std::atomic<uint32_t> next_ts_{ 0 };//按输出的帧数计算的时间戳，不受采集线程调度抖动影响
+    std::atomic<int64_t> last_frame_ms_{ 0 };
+    std::atomic<int64_t> interval_max_ms_{ 0 };//两次拉取统计之间最大的帧间隔
+    StatsCounter frames_;
+    StatsCounter frames_dropped_;//格式超出帧缓冲池
+    StatsCounter glitches_;//帧间隔超过30ms(3帧)，下游的抖动缓冲可能欠载，可能被听到的卡顿
+};
+
+// 没有采集设备的音频源：在audio_thread上按10ms的绝对节拍读取数据
+// 线程被短暂阻塞后补发落后的帧，像声卡缓冲一样不丢数据；落后太多时丢弃并重新对齐
+class PacedAudioSource : public AudioSourceImpl {
+protected:
+    PacedAudioSource(const char* type, const std::string& id);
+    ~PacedAudioSource() override;
+
+    // 打开数据源，可以根据文件头修改sample_rate_/channels_
+    virtual XRTCError OpenAudio() = 0;
+    virtual void CloseAudio() {}
+    // 读取一帧交错的PCM，返回false表示数据结束
+    virtual bool ReadAudio(int16_t* samples, int samples_per_channel) = 0;
+
+    // AudioSourceImpl
+    XRTCError StartAudio() override;
+    void StopAudio() override;
+    void ParseConfig(const JsonObject& jobject) override;
+    void GetSourceStats(JsonObject& stats) override;
+
+protected:
+    int sample_rate_ = 48000;
+    int channels_ = 1;
+
+private:
+    void ScheduleTick(std::shared_ptr<std::atomic<bool>> alive);
+    bool Tick();
+
+private:
+    std::shared_ptr<std::atomic<bool>> alive_;
+    int64_t next_frame_ms_ = 0;
+    StatsCounter frames_late_;//线程被阻塞后补发的帧
+    StatsCounter frames_skipped_;//落后太多直接跳过的帧
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_DEVICE_AUDIO_SOURCE_IMPL_H_
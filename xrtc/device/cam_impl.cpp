@@ -6,6 +6,7 @@
 #include <modules/video_capture/video_capture_factory.h>
 
 #include "xrtc/base/xrtc_global.h"
+#include "xrtc/base/xrtc_json.h"
 #include "xrtc/media/base/media_frame.h"
 
 namespace xrtc {
@@ -15,11 +16,11 @@ CamImpl::CamImpl(const std::string& cam_id) :
     current_thread_(rtc::Thread::Current()),
     device_info_(XRTCGlobal::Instance()->video_device_info())
 {
-
+    XRTCGlobal::Instance()->AddVideoSource(this);
 }
 
 CamImpl::~CamImpl() {
-
+    XRTCGlobal::Instance()->RemoveVideoSource(this);
 }
 
 void CamImpl::Start() {
@@ -50,26 +51,11 @@ void CamImpl::Start() {
                 break;
             }
 
-            // 获取一个最佳匹配的摄像头能力(参数可使用cam_impl中的Setup方法)
-            webrtc::VideoCaptureCapability request_cap;
-            request_cap.width = 640;
-            request_cap.height = 480;
-            request_cap.maxFPS = 20;
-            webrtc::VideoCaptureCapability best_cap;
-
-            if (device_info_->GetBestMatchedCapability(cam_id_.c_str(),
-                request_cap, best_cap) < 0)
-            {
-                err = XRTCError::kVideoNoBestCapabilitiesErr;
-                RTC_LOG(LS_WARNING) << "CamImpl no best capabilities";
-                break;
-            }
-
             //需要方法：接收最终采集的速度
             video_capture_->RegisterCaptureDataCallback(this);
 
             // 启动摄像头采集
-            if (video_capture_->StartCapture(best_cap) < 0) {
+            if (!StartCapture()) {
                 err = XRTCError::kVideoStartCaptureErr;
                 RTC_LOG(LS_WARNING) << "CamImpl video StartCapture error";
                 break;
@@ -122,32 +108,96 @@ void CamImpl::Destroy() {
     }));
 }
 
+// 按当前的采集参数获取一个最佳匹配的摄像头能力并启动采集
+bool CamImpl::StartCapture() {
+    webrtc::VideoCaptureCapability request_cap;
+    request_cap.width = width_;
+    request_cap.height = height_;
+    request_cap.maxFPS = fps_max_;
+    webrtc::VideoCaptureCapability best_cap;
+
+    if (device_info_->GetBestMatchedCapability(cam_id_.c_str(),
+        request_cap, best_cap) < 0)
+    {
+        RTC_LOG(LS_WARNING) << "CamImpl no best capabilities";
+        return false;
+    }
+
+    return video_capture_->StartCapture(best_cap) >= 0;
+}
+
+// 设置采集参数：{"width":1280,"height":720,"fps":30}
+// 采集中调用时只重启采集设备，consumer和下游的链路保持不变
 void CamImpl::Setup(const std::string& json_config)
 {
+    current_thread_->PostTask(webrtc::ToQueuedTask([=] {
+        RTC_LOG(LS_INFO) << "CamImpl Setup PostTask, config: " << json_config;
+
+        JsonValue value;
+        if (!value.FromJson(json_config)) {
+            RTC_LOG(LS_WARNING) << "CamImpl Setup failed to parse JSON";
+            return;
+        }
+
+        JsonObject jobject = value.ToObject();
+        int width = (int)jobject["width"].ToInt(width_);
+        int height = (int)jobject["height"].ToInt(height_);
+        int fps = (int)jobject["fps"].ToInt(fps_max_);
+        if (width == width_ && height == height_ && fps == fps_max_) {
+            return;
+        }
+
+        width_ = width;
+        height_ = height;
+        fps_max_ = fps;
 
+        if (!has_start_ || !video_capture_) {
+            return;
+        }
+
+        switch_start_ts_ = rtc::TimeMillis();
+        video_capture_->StopCapture();
+        if (!StartCapture()) {
+            RTC_LOG(LS_WARNING) << "CamImpl restart capture failed";
+            if (XRTCGlobal::Instance()->engine_observer()) {
+                XRTCGlobal::Instance()->engine_observer()->OnVideoSourceFailed(this,
+                    XRTCError::kVideoStartCaptureErr);
+            }
+            return;
+        }
+
+        RTC_LOG(LS_INFO) << "CamImpl restart capture with " << width_ << "x"
+            << height_ << "@" << fps_max_ << " cost: "
+            << rtc::TimeMillis() - switch_start_ts_ << "ms";
+    }));
 }
 
 void CamImpl::AddConsumer(IXRTCConsumer* consumer) {
-    current_thread_->PostTask(webrtc::ToQueuedTask([=] {
-        RTC_LOG(LS_INFO) << "CamImpl add consumer: " << consumer;
-        consumer_list_.push_back(consumer);
-    }));
+    RTC_LOG(LS_INFO) << "CamImpl add consumer: " << consumer;
+    consumer_list_.Add(consumer);
 }
 
+// 等待采集线程上正在进行的分发结束后返回
 void CamImpl::RemoveConsumer(IXRTCConsumer* consumer) {
-    current_thread_->PostTask(webrtc::ToQueuedTask([=] {
-        RTC_LOG(LS_INFO) << "CamImpl Remove consumer: " << consumer;
-        auto iter = consumer_list_.begin();
-        for (; iter != consumer_list_.end(); ++iter) {
-            if (*iter == consumer) {
-                consumer_list_.erase(iter);
-                break;
-            }
-        }
-    }));
+    RTC_LOG(LS_INFO) << "CamImpl Remove consumer: " << consumer;
+    consumer_list_.Remove(consumer);
 }
 
-//对视频帧进行处理，包括帧率计算、数据拷贝、时间戳处理等操作，并将处理后的帧数据通过异步任务分发给消费者（consumer）
+std::string CamImpl::GetStats() {
+    JsonObject jstats;
+    jstats["type"] = "camera";
+    jstats["id"] = cam_id_;
+    jstats["started"] = has_start_;
+    jstats["width"] = last_width_.load();
+    jstats["height"] = last_height_.load();
+    jstats["fps"] = frames_captured_.Rate(rtc::TimeMillis());
+    jstats["frames_captured"] = frames_captured_.count();
+    jstats["frames_dropped"] = frames_dropped_.count();
+    jstats["consumers"] = consumer_list_.size();
+    return JsonValue(jstats).ToJson();
+}
+
+//对视频帧进行处理，包括帧率计算、数据拷贝、时间戳处理等操作，并将处理后的帧数据分发给消费者（consumer）
 void CamImpl::OnFrame(const webrtc::VideoFrame& frame)
 {
 
@@ -167,29 +217,36 @@ void CamImpl::OnFrame(const webrtc::VideoFrame& frame)
 
     int src_width = frame.width();
     int src_height = frame.height();
-    int stridey = frame.video_frame_buffer()->GetI420()->StrideY();
-    int strideu = frame.video_frame_buffer()->GetI420()->StrideU();
-    int stridev = frame.video_frame_buffer()->GetI420()->StrideV();
-
-    // Y + U + V
-    int size = stridey * src_height + (strideu + stridev) * ((src_height + 1) / 2);
-    std::shared_ptr<MediaFrame> video_frame = std::make_shared<MediaFrame>(size);
-    video_frame->fmt.media_type = MainMediaType::kMainTypeVideo;
-    video_frame->fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeI420;
-    video_frame->fmt.sub_fmt.video_fmt.width = src_width;
-    video_frame->fmt.sub_fmt.video_fmt.height = src_height;
-    video_frame->stride[0] = stridey;
-    video_frame->stride[1] = strideu;
-    video_frame->stride[2] = stridev;
-    video_frame->data_len[0] = stridey * src_height;
-    video_frame->data_len[1] = strideu * ((src_height + 1) / 2);
-    video_frame->data_len[2] = stridev * ((src_height + 1) / 2);
-    video_frame->data[1] = video_frame->data[0] + video_frame->data_len[0];
-    video_frame->data[2] = video_frame->data[1] + video_frame->data_len[1];
-
-    memcpy(video_frame->data[0], frame.video_frame_buffer()->GetI420()->DataY(), video_frame->data_len[0]);
-    memcpy(video_frame->data[1], frame.video_frame_buffer()->GetI420()->DataU(), video_frame->data_len[1]);
-    memcpy(video_frame->data[2], frame.video_frame_buffer()->GetI420()->DataV(), video_frame->data_len[2]);
+
+    // 分辨率切换时，统计旧分辨率最后一帧到新分辨率第一帧之间的画面停顿
+    if (src_width != last_width_ || src_height != last_height_) {
+        if (last_capture_ts_ != 0) {
+            RTC_LOG(LS_INFO) << "CamImpl resolution switch " << last_width_ << "x"
+                << last_height_ << " -> " << src_width << "x" << src_height
+                << ", glitch: " << now - last_capture_ts_ << "ms"
+                << ", since setup: "
+                << (switch_start_ts_ != 0 ? now - switch_start_ts_ : 0) << "ms";
+        }
+        last_width_ = src_width;
+        last_height_ = src_height;
+        switch_start_ts_ = 0;
+    }
+    else if (last_capture_ts_ != 0 && fps_max_ > 0) {
+        int64_t expected = 1000 / fps_max_;
+        int64_t interval = now - last_capture_ts_;
+        if (expected > 0 && interval > expected * 3 / 2) {
+            frames_dropped_.Add(interval / expected - 1);
+        }
+    }
+    last_capture_ts_ = now;
+    frames_captured_.Add();
+
+    const webrtc::I420BufferInterface* i420 = frame.video_frame_buffer()->GetI420();
+    std::shared_ptr<MediaFrame> video_frame = MediaFrame::CreateI420(
+        i420->DataY(), i420->StrideY(),
+        i420->DataU(), i420->StrideU(),
+        i420->DataV(), i420->StrideV(),
+        src_width, src_height);
 
     if (0 == start_time_) {
         start_time_ = frame.render_time_ms();
@@ -199,12 +256,10 @@ void CamImpl::OnFrame(const webrtc::VideoFrame& frame)
     video_frame->ts = static_cast<uint32_t>(frame.render_time_ms() - start_time_);
     video_frame->capture_time_ms = frame.render_time_ms();
 
-    //将处理后的视频帧通过异步任务分发给所有注册的消费者。
-    current_thread_->PostTask(webrtc::ToQueuedTask([=] {
-        for (auto consumer : consumer_list_) {
-            consumer->OnFrame(video_frame);
-        }
-        }));
+    //在采集线程上直接分发给所有注册的消费者
+    consumer_list_.ForEach([&](IXRTCConsumer* consumer) {
+        consumer->OnFrame(video_frame);
+    });
 }
 
 } // namespace xrtc
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include <modules/video_capture/video_capture.h>
 
 #include "xrtc/xrtc.h"
+#include "xrtc/base/rcu_list.h"
+#include "xrtc/base/xrtc_stats.h"
 
 namespace xrtc {
 
@@ -20,8 +22,10 @@ public:
     void Destroy() override;
     void Setup(const std::string& json_config);
     //添加/移除消费者  （处理已经获取到的视频数据）
+    //同步生效，RemoveConsumer返回后该consumer不会再收到回调
     void AddConsumer(IXRTCConsumer* consumer) override;
     void RemoveConsumer(IXRTCConsumer* consumer) override;
+    std::string GetStats() override;
 
     //VideoSinkInterface  函数库的纯虚函数重写
     void OnFrame(const webrtc::VideoFrame& frame) override;
@@ -31,6 +35,8 @@ private:
     CamImpl(const std::string& cam_id);
     ~CamImpl();
 
+    bool StartCapture();
+
     friend class XRTCEngine;//定义友元访问私有
 
 private:
@@ -42,7 +48,19 @@ private:
     std::atomic<int> fps_{0};
     std::atomic<int64_t> last_frame_ts_{0};
     std::atomic<int64_t> start_time_{ 0 };
-    std::vector<IXRTCConsumer*> consumer_list_;//可能不只有一个consumer
+    // 采集参数，可通过Setup在运行中修改
+    int width_ = 640;
+    int height_ = 480;
+    std::atomic<int> fps_max_{ 20 };//采集线程统计丢帧时也会读取
+    // 分辨率切换耗时统计：最后一帧的时间和尺寸，以及切换发起的时间
+    std::atomic<int64_t> last_capture_ts_{ 0 };
+    std::atomic<int> last_width_{ 0 };
+    std::atomic<int> last_height_{ 0 };
+    std::atomic<int64_t> switch_start_ts_{ 0 };
+    // 统计
+    StatsCounter frames_captured_;
+    StatsCounter frames_dropped_;//按请求帧率估算，采集间隔超过1.5倍时计入
+    RcuList<IXRTCConsumer*> consumer_list_;//可能不只有一个consumer，采集线程上无锁遍历
 };
 
 } // namespace xrtc
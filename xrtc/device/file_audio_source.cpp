@@ -0,0 +1,176 @@
+﻿#include "xrtc/device/file_audio_source.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <rtc_base/logging.h>
+
+#include "xrtc/base/xrtc_json.h"
+
+namespace xrtc {
+
+namespace {
+
+const uint16_t kWavFormatPcm = 1;
+const uint16_t kWavFormatExtensible = 0xFFFE;
+
+uint16_t ReadLE16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+        ((uint32_t)p[3] << 24);
+}
+
+} // namespace
+
+FileAudioSource::FileAudioSource(const std::string& path) :
+    PacedAudioSource("file", path),
+    path_(path)
+{
+}
+
+FileAudioSource::~FileAudioSource() {
+    CloseAudio();
+}
+
+// 文件以RIFF开头时按WAV解析，否则按Setup指定的格式当作裸PCM
+XRTCError FileAudioSource::OpenAudio() {
+    file_ = fopen(path_.c_str(), "rb");
+    if (!file_) {
+        RTC_LOG(LS_WARNING) << "FileAudioSource open failed: " << path_;
+        return XRTCError::kAudioNotFoundErr;
+    }
+
+    char magic[4] = { 0 };
+    bool is_wav = fread(magic, 1, sizeof(magic), file_) == sizeof(magic) &&
+        memcmp(magic, "RIFF", 4) == 0;
+    fseek(file_, 0, SEEK_SET);
+
+    data_offset_ = 0;
+    data_size_ = -1;
+    if (is_wav && !ParseWavHeader()) {
+        CloseAudio();
+        return XRTCError::kAudioInitRecordingErr;
+    }
+
+    fseek(file_, data_offset_, SEEK_SET);
+    data_read_ = 0;
+    eof_ = false;
+    RTC_LOG(LS_INFO) << "FileAudioSource open " << path_ << (is_wav ? " (wav)" : " (pcm)")
+        << ", sample_rate: " << sample_rate_ << ", channels: " << channels_;
+    return XRTCError::kNoErr;
+}
+
+void FileAudioSource::CloseAudio() {
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+// 只支持16bit PCM，采样率需要是100的整数倍
+bool FileAudioSource::ParseWavHeader() {
+    uint8_t header[12];
+    if (fread(header, 1, sizeof(header), file_) != sizeof(header) ||
+        memcmp(header + 8, "WAVE", 4) != 0)
+    {
+        RTC_LOG(LS_WARNING) << "FileAudioSource invalid wav header: " << path_;
+        return false;
+    }
+
+    bool has_fmt = false;
+    uint8_t chunk[8];
+    while (fread(chunk, 1, sizeof(chunk), file_) == sizeof(chunk)) {
+        uint32_t chunk_size = ReadLE32(chunk + 4);
+        uint32_t skip = chunk_size + (chunk_size & 1);//块按偶数字节对齐
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[40] = { 0 };
+            size_t len = std::min<size_t>(chunk_size, sizeof(fmt));
+            if (chunk_size < 16 || fread(fmt, 1, len, file_) != len) {
+                break;
+            }
+
+            uint16_t format = ReadLE16(fmt);
+            if (format == kWavFormatExtensible && chunk_size >= 40) {
+                format = ReadLE16(fmt + 24);//SubFormat GUID的前两个字节
+            }
+            int channels = ReadLE16(fmt + 2);
+            int sample_rate = (int)ReadLE32(fmt + 4);
+            int bits = ReadLE16(fmt + 14);
+            if (format != kWavFormatPcm || bits != 16 || channels <= 0 ||
+                channels > kMaxChannels || sample_rate <= 0 ||
+                sample_rate > kMaxSampleRate || sample_rate % 100 != 0)
+            {
+                RTC_LOG(LS_WARNING) << "FileAudioSource unsupported wav: format " << format
+                    << ", " << bits << "bit, " << sample_rate << "Hz, " << channels
+                    << " channels";
+                return false;
+            }
+
+            sample_rate_ = sample_rate;
+            channels_ = channels;
+            has_fmt = true;
+            skip -= (uint32_t)len;
+        }
+        else if (memcmp(chunk, "data", 4) == 0) {
+            if (!has_fmt) {
+                break;
+            }
+            data_offset_ = ftell(file_);
+            data_size_ = chunk_size;
+            return true;
+        }
+
+        if (fseek(file_, (long)skip, SEEK_CUR) != 0) {
+            break;
+        }
+    }
+
+    RTC_LOG(LS_WARNING) << "FileAudioSource wav without fmt/data chunk: " << path_;
+    return false;
+}
+
+// 不循环时最后不足一帧的部分补静音，下一次返回结束
+bool FileAudioSource::ReadAudio(int16_t* samples, int samples_per_channel) {
+    if (eof_ || !file_) {
+        return false;
+    }
+
+    size_t size = samples_per_channel * channels_ * sizeof(int16_t);
+    uint8_t* dst = reinterpret_cast<uint8_t*>(samples);
+    size_t filled = 0;
+    while (filled < size) {
+        size_t want = size - filled;
+        if (data_size_ >= 0) {
+            want = (size_t)std::min<int64_t>(want, data_size_ - data_read_);
+        }
+
+        size_t read = want > 0 ? fread(dst + filled, 1, want, file_) : 0;
+        filled += read;
+        data_read_ += read;
+        if (read == want && want > 0) {
+            continue;
+        }
+
+        // 到达数据结尾
+        if (!loop_ || data_read_ == 0) {
+            memset(dst + filled, 0, size - filled);
+            eof_ = true;
+            return filled > 0;
+        }
+
+        fseek(file_, data_offset_, SEEK_SET);
+        data_read_ = 0;
+    }
+    return true;
+}
+
+void FileAudioSource::ParseConfig(const JsonObject& jobject) {
+    PacedAudioSource::ParseConfig(jobject);
+    loop_ = jobject["loop"].ToBool(loop_);
+}
+
+} // namespace xrtc
@@ -0,0 +1,39 @@
+﻿#ifndef XRTCSDK_XRTC_DEVICE_FILE_AUDIO_SOURCE_H_
+#define XRTCSDK_XRTC_DEVICE_FILE_AUDIO_SOURCE_H_
+
+#include <stdio.h>
+
+#include "xrtc/device/audio_source_impl.h"
+
+namespace xrtc {
+
+// 文件音频源：16bit PCM的WAV，或者裸PCM(采样率和声道数通过Setup指定)
+// Setup: {"sample_rate":48000,"channels":1,"loop":true}，WAV按文件头的格式输出
+class FileAudioSource : public PacedAudioSource {
+private:
+    FileAudioSource(const std::string& path);
+    ~FileAudioSource() override;
+
+    // PacedAudioSource
+    XRTCError OpenAudio() override;
+    void CloseAudio() override;
+    bool ReadAudio(int16_t* samples, int samples_per_channel) override;
+    void ParseConfig(const JsonObject& jobject) override;
+
+    bool ParseWavHeader();
+
+    friend class XRTCEngine;
+
+private:
+    std::string path_;
+    FILE* file_ = nullptr;
+    bool loop_ = true;//读到结尾后从头开始
+    long data_offset_ = 0;//PCM数据在文件中的起始位置
+    int64_t data_size_ = -1;//WAV的data块大小，-1表示读到文件结尾
+    int64_t data_read_ = 0;
+    bool eof_ = false;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_DEVICE_FILE_AUDIO_SOURCE_H_
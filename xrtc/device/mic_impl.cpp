@@ -0,0 +1,216 @@
+﻿#include "xrtc/device/mic_impl.h"
+
+#include <rtc_base/logging.h>
+
+#include "xrtc/base/rcu_list.h"
+#include "xrtc/base/xrtc_global.h"
+#include "xrtc/base/xrtc_json.h"
+
+namespace xrtc {
+
+namespace {
+
+// 注册到设备模块的唯一回调，在设备线程上分发给正在采集的MicImpl
+// mics和device_id只在audio_thread上修改
+class MicDispatcher : public webrtc::AudioTransport {
+public:
+    static MicDispatcher* Instance() {
+        static MicDispatcher* dispatcher = new MicDispatcher();
+        return dispatcher;
+    }
+
+    int32_t RecordedDataIsAvailable(const void* audio_samples,
+        const size_t samples_per_channel,
+        const size_t bytes_per_sample,
+        const size_t channels,
+        const uint32_t sample_rate,
+        const uint32_t total_delay_ms,
+        const int32_t clock_drift,
+        const uint32_t current_mic_level,
+        const bool key_pressed,
+        uint32_t& new_mic_level) override
+    {
+        new_mic_level = 0;
+        mics.ForEach([&](MicImpl* mic) {
+            uint32_t mic_level = 0;
+            mic->RecordedDataIsAvailable(audio_samples, samples_per_channel,
+                bytes_per_sample, channels, sample_rate, total_delay_ms,
+                clock_drift, current_mic_level, key_pressed, mic_level);
+        });
+        return 0;
+    }
+
+    int32_t NeedMorePlayData(const size_t /*samples_per_channel*/,
+        const size_t /*bytes_per_sample*/,
+        const size_t /*channels*/,
+        const uint32_t /*sample_rate*/,
+        void* /*audio_samples*/,
+        size_t& samples_out,
+        int64_t* /*elapsed_time_ms*/,
+        int64_t* /*ntp_time_ms*/) override
+    {
+        samples_out = 0;
+        return 0;
+    }
+
+    void PullRenderData(int /*bits_per_sample*/,
+        int /*sample_rate*/,
+        size_t /*channels*/,
+        size_t /*frames*/,
+        void* /*audio_data*/,
+        int64_t* /*elapsed_time_ms*/,
+        int64_t* /*ntp_time_ms*/) override {}
+
+    RcuList<MicImpl*> mics;//Remove返回后不会再回调被移除的MicImpl
+    std::string device_id;//正在采集的设备guid
+};
+
+} // namespace
+
+MicImpl::MicImpl(const std::string& mic_id) :
+    AudioSourceImpl("mic", mic_id),
+    mic_id_(mic_id)
+{
+}
+
+MicImpl::~MicImpl() {
+}
+
+// 在audio_thread上按guid找到设备并启动采集
+XRTCError MicImpl::StartAudio() {
+    webrtc::AudioDeviceModule* audio_device = XRTCGlobal::Instance()->audio_device();
+    if (!audio_device) {
+        return XRTCError::kNoAudioDeviceErr;
+    }
+
+    // 设备已经在采集：同一设备直接加入分发，其它设备不能同时采集
+    MicDispatcher* dispatcher = MicDispatcher::Instance();
+    if (dispatcher->mics.size() > 0) {
+        if (dispatcher->device_id != mic_id_) {
+            RTC_LOG(LS_WARNING) << "MicImpl another device is recording: "
+                << dispatcher->device_id << ", can not start: " << mic_id_;
+            return XRTCError::kAudioSetRecordingDeviceErr;
+        }
+
+        dispatcher->mics.Add(this);
+        RTC_LOG(LS_INFO) << "MicImpl share recording: " << mic_id_
+            << ", mics: " << dispatcher->mics.size();
+        return XRTCError::kNoErr;
+    }
+
+    int16_t total = audio_device->RecordingDevices();
+    if (total <= 0) {
+        RTC_LOG(LS_WARNING) << "MicImpl no audio device";
+        return XRTCError::kNoAudioDeviceErr;
+    }
+
+    int index = -1;
+    for (int16_t i = 0; i < total; ++i) {
+        char name[webrtc::kAdmMaxDeviceNameSize] = { 0 };
+        char guid[webrtc::kAdmMaxGuidSize] = { 0 };
+        if (audio_device->RecordingDeviceName(i, name, guid) == 0 && mic_id_ == guid) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index < 0) {
+        RTC_LOG(LS_WARNING) << "MicImpl audio device not found: " << mic_id_;
+        return XRTCError::kAudioNotFoundErr;
+    }
+
+    if (audio_device->SetRecordingDevice(index) != 0) {
+        RTC_LOG(LS_WARNING) << "MicImpl set recording device failed: " << index;
+        return XRTCError::kAudioSetRecordingDeviceErr;
+    }
+
+    audio_device->RegisterAudioCallback(dispatcher);
+    dispatcher->mics.Add(this);
+    dispatcher->device_id = mic_id_;
+
+    if (audio_device->InitRecording() != 0) {
+        RTC_LOG(LS_WARNING) << "MicImpl init recording failed";
+        dispatcher->mics.Remove(this);
+        audio_device->RegisterAudioCallback(nullptr);
+        return XRTCError::kAudioInitRecordingErr;
+    }
+
+    if (audio_device->StartRecording() != 0) {
+        RTC_LOG(LS_WARNING) << "MicImpl start recording failed";
+        dispatcher->mics.Remove(this);
+        audio_device->RegisterAudioCallback(nullptr);
+        return XRTCError::kAudioStartRecordingErr;
+    }
+
+    RTC_LOG(LS_INFO) << "MicImpl start recording: " << mic_id_;
+    return XRTCError::kNoErr;
+}
+
+// 从分发中移除后设备线程不会再回调本对象；最后一个停止时才停止设备
+void MicImpl::StopAudio() {
+    webrtc::AudioDeviceModule* audio_device = XRTCGlobal::Instance()->audio_device();
+    if (!audio_device) {
+        return;
+    }
+
+    MicDispatcher* dispatcher = MicDispatcher::Instance();
+    if (!dispatcher->mics.Remove(this) || dispatcher->mics.size() > 0) {
+        return;
+    }
+
+    if (audio_device->Recording()) {
+        audio_device->StopRecording();
+    }
+    audio_device->RegisterAudioCallback(nullptr);
+}
+
+void MicImpl::GetSourceStats(JsonObject& stats) {
+    stats["delay_ms"] = (int)delay_ms_.load();
+}
+
+// 设备线程上每10ms回调一次，拷贝到池中的帧后直接分发
+int32_t MicImpl::RecordedDataIsAvailable(const void* audio_samples,
+    const size_t samples_per_channel,
+    const size_t bytes_per_sample,
+    const size_t channels,
+    const uint32_t sample_rate,
+    const uint32_t total_delay_ms,
+    const int32_t /*clock_drift*/,
+    const uint32_t /*current_mic_level*/,
+    const bool /*key_pressed*/,
+    uint32_t& new_mic_level)
+{
+    new_mic_level = 0;
+    delay_ms_ = total_delay_ms;
+
+    std::shared_ptr<MediaFrame> frame = AcquireFrame((int)sample_rate, (int)channels);
+    if (!frame) {
+        return 0;
+    }
+
+    size_t size = samples_per_channel * bytes_per_sample;
+    if (bytes_per_sample != channels * sizeof(int16_t) || (int)size != frame->data_len[0]) {
+        RTC_LOG(LS_WARNING) << "MicImpl unexpected frame: " << samples_per_channel
+            << " samples, " << bytes_per_sample << " bytes per sample";
+        return 0;
+    }
+
+    memcpy(frame->data[0], audio_samples, size);
+    DeliverFrame(frame);
+    return 0;
+}
+
+int32_t MicImpl::NeedMorePlayData(const size_t /*samples_per_channel*/,
+    const size_t /*bytes_per_sample*/,
+    const size_t /*channels*/,
+    const uint32_t /*sample_rate*/,
+    void* /*audio_samples*/,
+    size_t& samples_out,
+    int64_t* /*elapsed_time_ms*/,
+    int64_t* /*ntp_time_ms*/)
+{
+    samples_out = 0;
+    return 0;
+}
+
+} // namespace xrtc
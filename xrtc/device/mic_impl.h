@@ -0,0 +1,63 @@
+﻿#ifndef XRTCSDK_XRTC_DEVICE_MIC_IMPL_H_
+#define XRTCSDK_XRTC_DEVICE_MIC_IMPL_H_
+
+#include <modules/audio_device/include/audio_device.h>
+
+#include "xrtc/device/audio_source_impl.h"
+
+namespace xrtc {
+
+// 麦克风：通过音频设备模块采集，设备模块在自己的实时优先级线程上每10ms回调一次
+// 设备模块只有一个回调、同时只能从一个设备采集：同一设备的多个MicImpl共享采集，
+// 回调由MicDispatcher分发给每一个；另一个设备正在采集时启动失败
+class MicImpl : public AudioSourceImpl,
+    public webrtc::AudioTransport
+{
+public:
+    // AudioTransport
+    int32_t RecordedDataIsAvailable(const void* audio_samples,
+        const size_t samples_per_channel,
+        const size_t bytes_per_sample,
+        const size_t channels,
+        const uint32_t sample_rate,
+        const uint32_t total_delay_ms,
+        const int32_t clock_drift,
+        const uint32_t current_mic_level,
+        const bool key_pressed,
+        uint32_t& new_mic_level) override;
+    //只采集，不播放
+    int32_t NeedMorePlayData(const size_t samples_per_channel,
+        const size_t bytes_per_sample,
+        const size_t channels,
+        const uint32_t sample_rate,
+        void* audio_samples,
+        size_t& samples_out,
+        int64_t* elapsed_time_ms,
+        int64_t* ntp_time_ms) override;
+    void PullRenderData(int bits_per_sample,
+        int sample_rate,
+        size_t channels,
+        size_t frames,
+        void* audio_data,
+        int64_t* elapsed_time_ms,
+        int64_t* ntp_time_ms) override {}
+
+private:
+    MicImpl(const std::string& mic_id);
+    ~MicImpl() override;
+
+    // AudioSourceImpl
+    XRTCError StartAudio() override;
+    void StopAudio() override;
+    void GetSourceStats(JsonObject& stats) override;
+
+    friend class XRTCEngine;
+
+private:
+    std::string mic_id_;
+    std::atomic<uint32_t> delay_ms_{ 0 };//设备上报的采集+播放延时
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_DEVICE_MIC_IMPL_H_
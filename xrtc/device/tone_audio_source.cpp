@@ -0,0 +1,53 @@
+﻿#include "xrtc/device/tone_audio_source.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "xrtc/base/xrtc_json.h"
+
+namespace xrtc {
+
+namespace {
+
+const double kTwoPi = 6.283185307179586;
+
+} // namespace
+
+ToneAudioSource::ToneAudioSource() :
+    PacedAudioSource("tone", "tone")
+{
+}
+
+ToneAudioSource::~ToneAudioSource() {
+}
+
+XRTCError ToneAudioSource::OpenAudio() {
+    phase_ = 0.0;
+    return XRTCError::kNoErr;
+}
+
+bool ToneAudioSource::ReadAudio(int16_t* samples, int samples_per_channel) {
+    double step = kTwoPi * frequency_ / sample_rate_;
+    double amplitude = volume_ * 32767.0;
+    for (int i = 0; i < samples_per_channel; ++i) {
+        int16_t value = (int16_t)(amplitude * sin(phase_));
+        for (int c = 0; c < channels_; ++c) {
+            *samples++ = value;
+        }
+
+        phase_ += step;
+        if (phase_ >= kTwoPi) {
+            phase_ -= kTwoPi;
+        }
+    }
+    return true;
+}
+
+void ToneAudioSource::ParseConfig(const JsonObject& jobject) {
+    PacedAudioSource::ParseConfig(jobject);
+    frequency_ = jobject["frequency"].ToDouble(frequency_);
+    volume_ = std::min(1.0, std::max(0.0, jobject["volume"].ToDouble(volume_)));
+}
+
+} // namespace xrtc
@@ -0,0 +1,30 @@
+﻿#ifndef XRTCSDK_XRTC_DEVICE_TONE_AUDIO_SOURCE_H_
+#define XRTCSDK_XRTC_DEVICE_TONE_AUDIO_SOURCE_H_
+
+#include "xrtc/device/audio_source_impl.h"
+
+namespace xrtc {
+
+// 正弦波测试音，所有声道相同
+// Setup: {"sample_rate":48000,"channels":1,"frequency":440,"volume":0.5}
+class ToneAudioSource : public PacedAudioSource {
+private:
+    ToneAudioSource();
+    ~ToneAudioSource() override;
+
+    // PacedAudioSource
+    XRTCError OpenAudio() override;
+    bool ReadAudio(int16_t* samples, int samples_per_channel) override;
+    void ParseConfig(const JsonObject& jobject) override;
+
+    friend class XRTCEngine;
+
+private:
+    double frequency_ = 440.0;
+    double volume_ = 0.5;//0-1
+    double phase_ = 0.0;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_DEVICE_TONE_AUDIO_SOURCE_H_
@@ -2,7 +2,11 @@
 #define XRTCSDK_XRTC_MEDIA_BASE_BASE_PIN_H_
 
 #include <memory>
+#include <mutex>
+#include <vector>
+
 #include "xrtc/media/base/media_frame.h"
+#include "xrtc/media/base/video_caps.h"
 
 namespace xrtc {
 
@@ -16,6 +20,29 @@ public:
     MediaObject* GetMediaObject() { return obj_; }
     void set_format(const MediaFormat& fmt) { fmt_ = fmt; }
     MediaFormat format() { return fmt_; }//区分视频或音频，相匹配的才能连接在一起
+    //视频能力(格式/分辨率范围/最大帧率/对齐)，连接时和对端求交集协商出具体格式
+    void set_video_caps(const VideoCaps& caps) { video_caps_ = caps; }
+    //可以接受(in_pin)/输出(out_pin)的多种视频子类型，按优先顺序排列
+    void set_video_types(const std::vector<SubMediaType>& types) { video_caps_.types = types; }
+    //没有设置子类型时只有format()中的子类型
+    VideoCaps video_caps() const {
+        VideoCaps caps = video_caps_;
+        if (caps.types.empty()) {
+            caps.types.push_back(fmt_.sub_fmt.video_fmt.type);
+        }
+        return caps;
+    }
+    std::vector<SubMediaType> video_types() const { return video_caps().types; }
+
+    //最近一次协商的结果，连接或者重新协商时更新
+    VideoStreamFormat negotiated_format() const {
+        std::lock_guard<std::mutex> lock(format_mutex_);
+        return negotiated_format_;
+    }
+    void set_negotiated_format(const VideoStreamFormat& format) {
+        std::lock_guard<std::mutex> lock(format_mutex_);
+        negotiated_format_ = format;
+    }
  
     //传递数据，，流动
     virtual void PushMediaFrame(std::shared_ptr<MediaFrame> frame) = 0;
@@ -23,6 +50,10 @@ public:
 protected:  
     MediaObject* obj_;
     MediaFormat fmt_;
+    VideoCaps video_caps_;
+
+    mutable std::mutex format_mutex_;//源线程重新协商，统计在链路线程读取
+    VideoStreamFormat negotiated_format_;
 };
 
 } // namespace xrtc
@@ -0,0 +1,246 @@
+﻿#include "xrtc/media/base/frame_tracer.h"
+
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/xrtc_json.h"
+
+namespace xrtc {
+
+LatencyHistogram::LatencyHistogram() {
+    for (int i = 0; i < kNumBuckets; ++i) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+// 前两个bit作为桶内的细分：[2^n, 2^(n+1)) 分成4个桶
+int LatencyHistogram::BucketIndex(int64_t value) {
+    if (value < kSubBuckets) {
+        return value < 0 ? 0 : (int)value;
+    }
+
+    int msb = 0;
+    while ((value >> (msb + 1)) != 0) {
+        ++msb;
+    }
+
+    int sub = (int)((value >> (msb - 2)) & (kSubBuckets - 1));
+    int index = (msb - 1) * kSubBuckets + sub;
+    return index < kNumBuckets ? index : kNumBuckets - 1;
+}
+
+int64_t LatencyHistogram::BucketUpperBound(int index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+
+    int msb = index / kSubBuckets + 1;
+    int sub = index % kSubBuckets;
+    return ((int64_t)(kSubBuckets + sub + 1) << (msb - 2)) - 1;
+}
+
+void LatencyHistogram::Add(int64_t value_us) {
+    buckets_[BucketIndex(value_us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value_us, std::memory_order_relaxed);
+
+    int64_t old_max = max_.load(std::memory_order_relaxed);
+    while (value_us > old_max &&
+        !max_.compare_exchange_weak(old_max, value_us, std::memory_order_relaxed))
+    {
+    }
+}
+
+int64_t LatencyHistogram::Average() const {
+    int64_t n = count();
+    return n > 0 ? sum_.load(std::memory_order_relaxed) / n : 0;
+}
+
+int64_t LatencyHistogram::Percentile(double percent) const {
+    int64_t n = count();
+    if (n <= 0) {
+        return 0;
+    }
+
+    int64_t target = (int64_t)(n * percent / 100.0);
+    int64_t acc = 0;
+    for (int i = 0; i < kNumBuckets; ++i) {
+        acc += buckets_[i].load(std::memory_order_relaxed);
+        if (acc > target) {
+            int64_t bound = BucketUpperBound(i);
+            return bound < max() ? bound : max();
+        }
+    }
+    return max();
+}
+
+void LatencyHistogram::ToJson(JsonObject& jobject) const {
+    jobject["count"] = count();
+    jobject["avg_us"] = Average();
+    jobject["p50_us"] = Percentile(50);
+    jobject["p90_us"] = Percentile(90);
+    jobject["p99_us"] = Percentile(99);
+    jobject["max_us"] = max();
+}
+
+FrameTracer::FrameTracer() {
+}
+
+FrameTracer::~FrameTracer() {
+}
+
+void FrameTracer::Begin(MediaFrame* frame, const char* source_name) {
+    if (!frame) {
+        return;
+    }
+
+    int64_t now = rtc::TimeMicros();
+    FrameTrace* trace = new FrameTrace();
+    trace->tracer = this;
+    trace->frame_ts = frame->ts;
+    trace->begin_us = frame->capture_time_ms > 0 ?
+        frame->capture_time_ms * rtc::kNumMicrosecsPerMillisec : now;
+    // 采集回调到进入链路之间的耗时
+    trace->AddSpan("capture", trace->begin_us, now);
+    trace->Enter(source_name, now);
+
+    FrameTrace* expected = nullptr;
+    if (!frame->trace.compare_exchange_strong(expected, trace,
+        std::memory_order_acq_rel))
+    {
+        // 已经被其他链路跟踪
+        delete trace;
+    }
+}
+
+void FrameTracer::End(MediaFrame* frame, const char* sink_name) {
+    FrameTrace* trace = frame ? frame->TraceFor(this) : nullptr;
+    if (!trace) {
+        return;
+    }
+
+    int64_t now = rtc::TimeMicros();
+    trace->Exit(sink_name, now);
+    if (!trace->Release()) {
+        return;
+    }
+
+    FrameRecord record;
+    record.frame_ts = trace->frame_ts;
+    record.begin_us = trace->begin_us;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < trace->size(); ++i) {
+        const FrameTrace::Span& span = trace->spans[i];
+        int64_t exit_us = span.exit_us.load(std::memory_order_relaxed);
+        if (!span.ready.load(std::memory_order_acquire) || exit_us == 0) {
+            continue;
+        }
+
+        GetHistogram(span.name)->Add(exit_us - span.enter_us);
+        record.spans[record.span_count++] = { span.name, span.enter_us, exit_us };
+    }
+
+    end_to_end_latency_.Add(now - trace->begin_us);
+
+    recent_frames_.push_back(record);
+    if (recent_frames_.size() > kMaxRecentFrames) {
+        recent_frames_.pop_front();
+    }
+}
+
+LatencyHistogram* FrameTracer::GetHistogram(const std::string& name) {
+    auto& histogram = node_latency_[name];
+    if (!histogram) {
+        histogram = std::make_unique<LatencyHistogram>();
+    }
+    return histogram.get();
+}
+
+// {"end_to_end":{...},"nodes":{"xrtc_video_source":{...},...}}
+std::string FrameTracer::GetLatencyStats() {
+    JsonObject jstats;
+    JsonObject jend_to_end;
+    end_to_end_latency_.ToJson(jend_to_end);
+    jstats["end_to_end"] = jend_to_end;
+
+    JsonObject jnodes;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& item : node_latency_) {
+            JsonObject jnode;
+            item.second->ToJson(jnode);
+            jnodes[item.first.c_str()] = jnode;
+        }
+    }
+    jstats["nodes"] = jnodes;
+
+    return JsonValue(jstats).ToJson();
+}
+
+// chrome://tracing 的Trace Event格式，每个节点/阶段一行(tid)，每一帧一行
+std::string FrameTracer::GetChromeTrace() {
+    JsonArray jevents;
+    std::map<std::string, int> tids;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& trace : recent_frames_) {
+        int64_t end_us = trace.begin_us;
+        for (int i = 0; i < trace.span_count; ++i) {
+            const FrameRecord::Span& span = trace.spans[i];
+
+            auto iter = tids.find(span.name);
+            if (iter == tids.end()) {
+                iter = tids.emplace(span.name, (int)tids.size() + 1).first;
+            }
+
+            JsonObject jargs;
+            jargs["frame_ts"] = trace.frame_ts;
+
+            JsonObject jevent;
+            jevent["name"] = span.name;
+            jevent["cat"] = "xrtc";
+            jevent["ph"] = "X";
+            jevent["ts"] = span.enter_us;
+            jevent["dur"] = span.exit_us - span.enter_us;
+            jevent["pid"] = 1;
+            jevent["tid"] = iter->second;
+            jevent["args"] = jargs;
+            jevents.Append(jevent);
+
+            if (span.exit_us > end_us) {
+                end_us = span.exit_us;
+            }
+        }
+
+        JsonObject jframe;
+        jframe["name"] = "frame";
+        jframe["cat"] = "xrtc";
+        jframe["ph"] = "X";
+        jframe["ts"] = trace.begin_us;
+        jframe["dur"] = end_us - trace.begin_us;
+        jframe["pid"] = 1;
+        jframe["tid"] = 0;
+        jevents.Append(jframe);
+    }
+
+    tids.emplace("frame", 0);
+    for (const auto& item : tids) {
+        JsonObject jargs;
+        jargs["name"] = item.first;
+
+        JsonObject jmeta;
+        jmeta["name"] = "thread_name";
+        jmeta["ph"] = "M";
+        jmeta["pid"] = 1;
+        jmeta["tid"] = item.second;
+        jmeta["args"] = jargs;
+        jevents.Append(jmeta);
+    }
+
+    JsonObject jtrace;
+    jtrace["traceEvents"] = jevents;
+    jtrace["displayTimeUnit"] = "ms";
+    return JsonValue(jtrace).ToJson();
+}
+
+} // namespace xrtc
@@ -0,0 +1,87 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_BASE_FRAME_TRACER_H_
+#define XRTCSDK_XRTC_MEDIA_BASE_FRAME_TRACER_H_
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "xrtc/media/base/media_frame.h"
+
+namespace xrtc {
+
+class JsonObject;
+
+//延时直方图，每个2倍区间再分4个桶，计数都是原子操作，可以在任意线程Add
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void Add(int64_t value_us);
+    int64_t count() const { return count_.load(std::memory_order_relaxed); }
+    int64_t max() const { return max_.load(std::memory_order_relaxed); }
+    int64_t Average() const;
+    int64_t Percentile(double percent) const;//返回所在桶的上界
+
+    void ToJson(JsonObject& jobject) const;
+
+private:
+    static const int kSubBuckets = 4;
+    static const int kOctaves = 28;//最大约2^28us
+    static const int kNumBuckets = kSubBuckets * kOctaves;
+
+    static int BucketIndex(int64_t value);
+    static int64_t BucketUpperBound(int index);
+
+private:
+    std::atomic<int64_t> buckets_[kNumBuckets];
+    std::atomic<int64_t> count_{ 0 };
+    std::atomic<int64_t> sum_{ 0 };
+    std::atomic<int64_t> max_{ 0 };
+};
+
+//已发布的一帧，FrameTrace可能被多个线程写，保留最近的帧时拷贝成普通结构
+struct FrameRecord {
+    struct Span {
+        const char* name;
+        int64_t enter_us;
+        int64_t exit_us;
+    };
+
+    uint32_t frame_ts = 0;
+    int64_t begin_us = 0;
+    Span spans[FrameTrace::kMaxSpans];
+    int span_count = 0;
+};
+
+//链路的帧跟踪：统计每个节点和端到端的延时，并保留最近的帧用于导出chrome://tracing
+class FrameTracer {
+public:
+    FrameTracer();
+    ~FrameTracer();
+
+    //源节点调用，开始跟踪一帧（采集时间作为起点）
+    void Begin(MediaFrame* frame, const char* source_name);
+    //末端节点调用，帧离开链路；分叉的帧在最后一个分支结束时汇总统计
+    void End(MediaFrame* frame, const char* sink_name);
+
+    std::string GetLatencyStats();
+    std::string GetChromeTrace();
+
+private:
+    LatencyHistogram* GetHistogram(const std::string& name);
+
+private:
+    static const size_t kMaxRecentFrames = 300;
+
+    std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> node_latency_;
+    LatencyHistogram end_to_end_latency_;
+    std::deque<FrameRecord> recent_frames_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_BASE_FRAME_TRACER_H_
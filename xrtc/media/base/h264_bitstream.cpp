@@ -0,0 +1,263 @@
+﻿#include "xrtc/media/base/h264_bitstream.h"
+
+namespace xrtc {
+
+namespace {
+
+const uint8_t kNaluTypeMask = 0x1F;
+const uint8_t kNaluSlice = 1;
+const uint8_t kNaluIdr = 5;
+const uint8_t kNaluSps = 7;
+
+// RBSP的位读取，越界后所有读取都失败
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    bool Bit(uint32_t* v) {
+        if (pos_ >= size_ * 8) {
+            return false;
+        }
+        *v = (data_[pos_ >> 3] >> (7 - (pos_ & 7))) & 1;
+        ++pos_;
+        return true;
+    }
+
+    bool Bits(int n, uint32_t* v) {
+        uint32_t value = 0;
+        for (int i = 0; i < n; ++i) {
+            uint32_t bit;
+            if (!Bit(&bit)) {
+                return false;
+            }
+            value = (value << 1) | bit;
+        }
+        *v = value;
+        return true;
+    }
+
+    // ue(v)，Exp-Golomb
+    bool Ue(uint32_t* v) {
+        int zeros = 0;
+        uint32_t bit = 0;
+        while (Bit(&bit) && bit == 0) {
+            if (++zeros > 31) {
+                return false;
+            }
+        }
+        if (bit != 1) {
+            return false;
+        }
+        uint32_t suffix = 0;
+        if (!Bits(zeros, &suffix)) {
+            return false;
+        }
+        *v = (uint32_t)((1ull << zeros) - 1 + suffix);
+        return true;
+    }
+
+    bool Se(int32_t* v) {
+        uint32_t code;
+        if (!Ue(&code)) {
+            return false;
+        }
+        *v = (code & 1) ? (int32_t)((code + 1) / 2) : -(int32_t)(code / 2);
+        return true;
+    }
+
+    size_t position() const { return pos_; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+bool SkipScalingList(BitReader* reader, int size) {
+    int last_scale = 8;
+    int next_scale = 8;
+    for (int i = 0; i < size; ++i) {
+        if (next_scale != 0) {
+            int32_t delta;
+            if (!reader->Se(&delta)) {
+                return false;
+            }
+            next_scale = (last_scale + delta + 256) % 256;
+        }
+        last_scale = next_scale == 0 ? last_scale : next_scale;
+    }
+    return true;
+}
+
+// 解析到gaps_in_frame_num_value_allowed_flag为止，gaps_bit为这个标志在RBSP(含NAL头)中的位置
+bool ParseSpsRbsp(const std::vector<uint8_t>& rbsp, H264Bitstream::Sps* sps, size_t* gaps_bit) {
+    if (rbsp.empty() || (rbsp[0] & kNaluTypeMask) != kNaluSps) {
+        return false;
+    }
+
+    BitReader reader(rbsp.data(), rbsp.size());
+    uint32_t v;
+    uint32_t profile_idc;
+    if (!reader.Bits(8, &v) || !reader.Bits(8, &profile_idc) || !reader.Bits(16, &v) ||
+        !reader.Ue(&v))
+    {
+        return false;
+    }
+    sps->sps_id = (int)v;
+
+    sps->separate_colour_plane = false;
+    switch (profile_idc) {
+    case 100: case 110: case 122: case 244: case 44:
+    case 83: case 86: case 118: case 128: case 138: case 139: case 134: case 135: {
+        uint32_t chroma_format_idc;
+        if (!reader.Ue(&chroma_format_idc)) {
+            return false;
+        }
+        if (chroma_format_idc == 3) {
+            if (!reader.Bit(&v)) {
+                return false;
+            }
+            sps->separate_colour_plane = v != 0;
+        }
+        uint32_t scaling_matrix_present;
+        if (!reader.Ue(&v) || !reader.Ue(&v) || !reader.Bit(&v) ||
+            !reader.Bit(&scaling_matrix_present))
+        {
+            return false;
+        }
+        if (scaling_matrix_present) {
+            int lists = chroma_format_idc == 3 ? 12 : 8;
+            for (int i = 0; i < lists; ++i) {
+                if (!reader.Bit(&v)) {
+                    return false;
+                }
+                if (v && !SkipScalingList(&reader, i < 6 ? 16 : 64)) {
+                    return false;
+                }
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    if (!reader.Ue(&v) || v > 12) {
+        return false;
+    }
+    sps->log2_max_frame_num = (int)v + 4;
+    if (!reader.Ue(&v)) {
+        return false;
+    }
+    sps->pic_order_cnt_type = (int)v;
+    if (sps->pic_order_cnt_type == 0) {
+        if (!reader.Ue(&v)) {
+            return false;
+        }
+    }
+    else if (sps->pic_order_cnt_type == 1) {
+        int32_t offset;
+        uint32_t cycle;
+        if (!reader.Bit(&v) || !reader.Se(&offset) || !reader.Se(&offset) ||
+            !reader.Ue(&cycle) || cycle > 255)
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < cycle; ++i) {
+            if (!reader.Se(&offset)) {
+                return false;
+            }
+        }
+    }
+
+    if (!reader.Ue(&v)) {
+        return false;
+    }
+    sps->max_num_ref_frames = (int)v;
+    *gaps_bit = reader.position();
+    if (!reader.Bit(&v)) {
+        return false;
+    }
+    sps->gaps_in_frame_num_allowed = v != 0;
+    return true;
+}
+
+} // namespace
+
+std::vector<uint8_t> H264Bitstream::ToRbsp(const uint8_t* data, size_t size) {
+    std::vector<uint8_t> rbsp;
+    rbsp.reserve(size);
+    int zeros = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (zeros >= 2 && data[i] == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        rbsp.push_back(data[i]);
+        zeros = data[i] == 0 ? zeros + 1 : 0;
+    }
+    return rbsp;
+}
+
+void H264Bitstream::AppendEscaped(const uint8_t* rbsp, size_t size, std::vector<uint8_t>* out) {
+    int zeros = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (zeros >= 2 && rbsp[i] <= 0x03) {
+            out->push_back(0x03);
+            zeros = 0;
+        }
+        out->push_back(rbsp[i]);
+        zeros = rbsp[i] == 0 ? zeros + 1 : 0;
+    }
+}
+
+bool H264Bitstream::ParseSps(const uint8_t* nalu, size_t size, Sps* sps) {
+    size_t gaps_bit = 0;
+    return ParseSpsRbsp(ToRbsp(nalu, size), sps, &gaps_bit);
+}
+
+bool H264Bitstream::AllowFrameNumGaps(const uint8_t* nalu, size_t size,
+    std::vector<uint8_t>* out)
+{
+    std::vector<uint8_t> rbsp = ToRbsp(nalu, size);
+    Sps sps;
+    size_t gaps_bit = 0;
+    if (!ParseSpsRbsp(rbsp, &sps, &gaps_bit)) {
+        return false;
+    }
+
+    rbsp[gaps_bit >> 3] |= (uint8_t)(0x80 >> (gaps_bit & 7));
+    out->clear();
+    AppendEscaped(rbsp.data(), rbsp.size(), out);
+    return true;
+}
+
+bool H264Bitstream::ParseFrameNum(const uint8_t* nalu, size_t size, const Sps& sps,
+    int* frame_num)
+{
+    if (size == 0) {
+        return false;
+    }
+    uint8_t type = nalu[0] & kNaluTypeMask;
+    if (type != kNaluSlice && type != kNaluIdr) {
+        return false;
+    }
+
+    // slice头很短，只转换开头的一段
+    std::vector<uint8_t> rbsp = ToRbsp(nalu, size < 32 ? size : 32);
+    BitReader reader(rbsp.data() + 1, rbsp.size() - 1);
+    uint32_t v;
+    if (!reader.Ue(&v) || !reader.Ue(&v) || !reader.Ue(&v)) {
+        return false;
+    }
+    if (sps.separate_colour_plane && !reader.Bits(2, &v)) {
+        return false;
+    }
+    if (!reader.Bits(sps.log2_max_frame_num, &v)) {
+        return false;
+    }
+    *frame_num = (int)v;
+    return true;
+}
+
+} // namespace xrtc
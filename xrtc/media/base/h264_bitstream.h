@@ -0,0 +1,37 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_BASE_H264_BITSTREAM_H_
+#define XRTCSDK_XRTC_MEDIA_BASE_H264_BITSTREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace xrtc {
+
+// H264码流中用到的少量语法(ITU-T H.264 7.3)：SPS中和帧号有关的字段、slice头的frame_num，
+// 以及打开SPS的gaps_in_frame_num_value_allowed_flag。nalu都不含起始码，第一个字节是NAL头
+class H264Bitstream {
+public:
+    struct Sps {
+        int sps_id = 0;
+        bool separate_colour_plane = false;
+        int log2_max_frame_num = 4;
+        int pic_order_cnt_type = 0;
+        int max_num_ref_frames = 0;
+        bool gaps_in_frame_num_allowed = false;
+    };
+
+    static bool ParseSps(const uint8_t* nalu, size_t size, Sps* sps);
+    // 改写后的SPS写入out，解析失败时返回false
+    static bool AllowFrameNumGaps(const uint8_t* nalu, size_t size, std::vector<uint8_t>* out);
+    // slice(类型1和5)的frame_num
+    static bool ParseFrameNum(const uint8_t* nalu, size_t size, const Sps& sps, int* frame_num);
+
+    // 去掉/加上防竞争字节(0x000003)
+    static std::vector<uint8_t> ToRbsp(const uint8_t* data, size_t size);
+    static void AppendEscaped(const uint8_t* rbsp, size_t size, std::vector<uint8_t>* out);
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_BASE_H264_BITSTREAM_H_
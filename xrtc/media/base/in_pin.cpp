@@ -1,5 +1,8 @@
 ﻿#include "xrtc/media/base/in_pin.h"
 
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
 #include "xrtc/media/base/media_chain.h"
 #include "xrtc/media/base/out_pin.h"
 
@@ -41,14 +44,27 @@ bool InPin::Accept(OutPin* out_pin) {
         }
     case MainMediaType::kMainTypeVideo:
         {
-            if (out_fmt.sub_fmt.video_fmt.type == SubMediaType::kSubTypeCommon || fmt_.sub_fmt.video_fmt.type == SubMediaType::kSubTypeCommon) {
-                out_pin_ = out_pin;
-                return true;
-            }
-            else if (out_fmt.sub_fmt.video_fmt.type != fmt_.sub_fmt.video_fmt.type) {
+            VideoStreamFormat format;
+            if (!NegotiateVideoFormat(out_pin->video_caps(), video_caps(),
+                out_pin->negotiated_format(), &format))
+            {
                 return false;
             }
-            break;
+
+            // out_pin可以输出多种格式时，把协商结果写回out_pin，节点按format()输出
+            if (out_pin->video_types().size() > 1 && format.type != SubMediaType::kSubTypeCommon) {
+                out_fmt.sub_fmt.video_fmt.type = format.type;
+                out_pin->set_format(out_fmt);
+            }
+
+            out_pin->set_negotiated_format(format);
+            set_negotiated_format(format);
+            out_pin_ = out_pin;
+            // 源的格式已经确定时(例如热替换的新节点)，在第一帧之前通知节点分配缓冲
+            if (format.width > 0 && format.height > 0) {
+                PostFormatChanged(format);
+            }
+            return true;
         }
     default:
         return false;
@@ -58,10 +74,141 @@ bool InPin::Accept(OutPin* out_pin) {
     return true;
 }
 
+// 源的格式变化时由out_pin调用，重新协商后通知节点，和帧走同一个队列，保证顺序
+bool InPin::Renegotiate(OutPin* out_pin, const VideoStreamFormat& preferred) {
+    VideoStreamFormat format;
+    if (!NegotiateVideoFormat(out_pin->video_caps(), video_caps(), preferred, &format)) {
+        RTC_LOG(LS_WARNING) << (obj_ ? obj_->name() : "in_pin") << " renegotiate failed: "
+            << VideoStreamFormatString(preferred);
+        return false;
+    }
+
+    out_pin->set_negotiated_format(format);
+    if (format == negotiated_format()) {
+        return true;
+    }
+
+    RTC_LOG(LS_INFO) << (obj_ ? obj_->name() : "in_pin") << " renegotiate: "
+        << VideoStreamFormatString(negotiated_format()) << " -> "
+        << VideoStreamFormatString(format);
+    set_negotiated_format(format);
+    renegotiations_.Add();
+    PostFormatChanged(format);
+    return true;
+}
+
+void InPin::PostFormatChanged(const VideoStreamFormat& format) {
+    if (!obj_) {
+        return;
+    }
+
+    SerialTaskQueue* task_queue = obj_->task_queue();
+    if (!task_queue) {
+        obj_->OnFormatChanged(this, format);
+        return;
+    }
+
+    if (obj_->executor() == NodeExecutor::kMediaPoolLatest) {
+        // 信箱中旧格式的帧已经没有意义，丢弃；格式事件本身不会被覆盖
+        bool need_post;
+        std::shared_ptr<MediaFrame> old_frame;
+        {
+            std::lock_guard<std::mutex> lock(mailbox_mutex_);
+            need_post = !mailbox_ && !has_pending_format_;
+            old_frame = std::move(mailbox_);
+            pending_format_ = format;
+            has_pending_format_ = true;
+        }
+
+        if (old_frame) {
+            dropped_.Add();
+        }
+        if (need_post) {
+            PostMailboxTask(task_queue);
+        }
+        return;
+    }
+
+    task_queue->PostTask([this, format]() {
+        obj_->OnFormatChanged(this, format);
+    });
+}
+
+// kMediaPool/kMediaPoolLatest节点投递到节点的串行队列，帧在跟踪中的停留时间包含排队时间
 void InPin::PushMediaFrame(std::shared_ptr<MediaFrame> frame) {
-    if (obj_) {
-        obj_->OnNewMediaFrame(frame);
+    if (!obj_) {
+        return;
+    }
+
+    FrameTrace* trace = frame->TraceFor(obj_->tracer());
+    if (trace) {
+        trace->Enter(obj_->name(), rtc::TimeMicros());
+    }
+
+    SerialTaskQueue* task_queue = obj_->task_queue();
+    if (!task_queue) {
+        ProcessMediaFrame(frame);
+        return;
+    }
+
+    if (obj_->executor() == NodeExecutor::kMediaPoolLatest) {
+        PostLatestFrame(task_queue, frame);
+        return;
+    }
+
+    task_queue->PostTask([this, frame]() {
+        ProcessMediaFrame(frame);
+    });
+}
+
+// 信箱为空时才投递任务，任务执行时取走信箱中最新的帧，所以积压最多一帧
+void InPin::PostLatestFrame(SerialTaskQueue* task_queue, std::shared_ptr<MediaFrame> frame) {
+    bool need_post;
+    std::shared_ptr<MediaFrame> old_frame;
+    {
+        std::lock_guard<std::mutex> lock(mailbox_mutex_);
+        need_post = !mailbox_ && !has_pending_format_;
+        old_frame = std::move(mailbox_);
+        mailbox_ = std::move(frame);
     }
+
+    if (old_frame) {
+        dropped_.Add();
+    }
+    if (need_post) {
+        PostMailboxTask(task_queue);
+    }
+}
+
+// 先处理等待中的格式事件，再处理最新的帧
+void InPin::PostMailboxTask(SerialTaskQueue* task_queue) {
+    task_queue->PostTask([this]() {
+        std::shared_ptr<MediaFrame> latest_frame;
+        bool has_format;
+        VideoStreamFormat format;
+        {
+            std::lock_guard<std::mutex> lock(mailbox_mutex_);
+            latest_frame = std::move(mailbox_);
+            has_format = has_pending_format_;
+            format = pending_format_;
+            has_pending_format_ = false;
+        }
+
+        if (has_format) {
+            obj_->OnFormatChanged(this, format);
+        }
+        if (latest_frame) {
+            ProcessMediaFrame(latest_frame);
+        }
+    });
+}
+
+void InPin::ProcessMediaFrame(std::shared_ptr<MediaFrame> frame) {
+    int64_t start_us = rtc::TimeMicros();
+    obj_->OnNewPinFrame(this, frame);
+
+    frames_.Add();
+    process_time_us_.Add(rtc::TimeMicros() - start_us);
 }
 
 } // namespace xrtc
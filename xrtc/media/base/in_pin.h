@@ -1,11 +1,15 @@
 ﻿#ifndef XRTCSDK_XRTC_MEDIA_BASE_IN_PIN_H_
 #define XRTCSDK_XRTC_MEDIA_BASE_IN_PIN_H_
 
+#include <mutex>
+
+#include "xrtc/base/xrtc_stats.h"
 #include "xrtc/media/base/base_pin.h"
 
 namespace xrtc {
 
 class OutPin;
+class SerialTaskQueue;
 
 class InPin : public BasePin {
 public:
@@ -14,11 +18,38 @@ public:
     ~InPin() override;
 
     bool Accept(OutPin* out_pin);
+    void Disconnect() { out_pin_ = nullptr; }
+    OutPin* out_pin() { return out_pin_; }
+    // 上游格式变化时重新协商，成功后节点在处理帧的线程上收到OnFormatChanged
+    bool Renegotiate(OutPin* out_pin, const VideoStreamFormat& preferred);
+
+    // 统计：进入节点的帧数、帧率以及节点处理的平均耗时(不含排队)
+    int64_t frames() const { return frames_.count(); }
+    double fps(int64_t now_ms) { return frames_.Rate(now_ms); }
+    int64_t process_time_us() { return process_time_us_.Average(); }
+    // kMediaPoolLatest节点被新帧覆盖、没有处理的帧数
+    int64_t dropped() const { return dropped_.count(); }
+    int64_t renegotiations() const { return renegotiations_.count(); }
 
     // BasePin
     void PushMediaFrame(std::shared_ptr<MediaFrame> frame) override;
+private:
+    void ProcessMediaFrame(std::shared_ptr<MediaFrame> frame);
+    void PostLatestFrame(SerialTaskQueue* task_queue, std::shared_ptr<MediaFrame> frame);
+    void PostFormatChanged(const VideoStreamFormat& format);
+    void PostMailboxTask(SerialTaskQueue* task_queue);
+
 private:
     OutPin* out_pin_ = nullptr;
+    StatsCounter frames_;
+    AverageCounter process_time_us_;
+    // 最新帧信箱：最多一帧在等待处理，新帧到来时替换旧帧
+    std::mutex mailbox_mutex_;
+    std::shared_ptr<MediaFrame> mailbox_;
+    bool has_pending_format_ = false;//格式事件不会被新帧覆盖
+    VideoStreamFormat pending_format_;
+    StatsCounter dropped_;
+    StatsCounter renegotiations_;
 };
 
 } // namespace xrtc
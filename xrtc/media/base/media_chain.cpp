@@ -1,11 +1,46 @@
 ﻿#include "xrtc/media/base/media_chain.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/xrtc_global.h"
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/frame_tracer.h"
 #include "xrtc/media/base/in_pin.h"
 #include "xrtc/media/base/out_pin.h"
+#include "xrtc/media/filter/video_convert_filter.h"
 
 
 namespace xrtc {
 
+MediaObject::MediaObject(NodeExecutor executor) :
+    executor_(executor)
+{
+    if (executor_ == NodeExecutor::kAudioPool) {
+        task_queue_ = XRTCGlobal::Instance()->audio_pool()->CreateSerialQueue();
+    }
+    else if (executor_ != NodeExecutor::kInline) {
+        task_queue_ = XRTCGlobal::Instance()->media_pool()->CreateSerialQueue();
+    }
+}
+
+void MediaObject::Drain() {
+    if (task_queue_) {
+        task_queue_->Flush();
+    }
+}
+
+MediaChain::MediaChain() {
+}
+
+MediaChain::~MediaChain() {
+}
+
 void MediaChain::AddMediaObject(MediaObject* obj) {
+    obj->set_tracer(frame_trace_enabled_ ? frame_tracer_.get() : nullptr);
     media_objects_.push_back(obj);
 }
 
@@ -14,23 +49,87 @@ bool MediaChain::ConnectMediaObject(MediaObject* from, MediaObject* to) {
         return false;
     }
 
-    std::vector<OutPin*> out_pins = from->GetAllOutPins();
+    for (auto out_pin : from->GetAllOutPins()) {
+        if (!ConnectMediaPin(out_pin, to)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MediaChain::ConnectMediaPin(OutPin* out_pin, MediaObject* to) {
+    if (!out_pin || !to) {
+        return false;
+    }
+
     std::vector<InPin*> in_pins = to->GetAllInPins();
-    for (auto out_pin : out_pins) {
-        bool has_connected = false;
-        for (auto in_pin : in_pins) {
-            if (out_pin->ConnectTo(in_pin)) {
-                has_connected = true;
+    for (auto in_pin : in_pins) {
+        //已经连到其他out_pin的in_pin跳过，多输入节点按连接的顺序依次使用in_pin
+        if (in_pin->out_pin() && in_pin->out_pin() != out_pin) {
+            continue;
+        }
+
+        if (out_pin->ConnectTo(in_pin)) {
+            return true;
+        }
+    }
+
+    return ConnectWithConverter(out_pin, to, in_pins);
+}
+
+// 上下游没有共同的视频格式时，在中间插入格式转换节点，转换成下游最优先的格式
+// 只在两端都是未压缩视频时插入，能直接连接的不会经过转换
+bool MediaChain::ConnectWithConverter(OutPin* out_pin, MediaObject* to,
+    const std::vector<InPin*>& in_pins)
+{
+    MediaFormat out_fmt = out_pin->format();
+    if (out_fmt.media_type != MainMediaType::kMainTypeVideo ||
+        !IsRawVideoType(out_fmt.sub_fmt.video_fmt.type))
+    {
+        return false;
+    }
+
+    for (auto in_pin : in_pins) {
+        if (in_pin->out_pin()) {
+            continue;
+        }
+
+        SubMediaType dst_type = SubMediaType::kSubTypeCommon;
+        for (auto type : in_pin->video_types()) {
+            if (IsRawVideoType(type)) {
+                dst_type = type;
                 break;
             }
         }
 
-        if (!has_connected) {
-            return false;
+        if (dst_type == SubMediaType::kSubTypeCommon) {
+            continue;
+        }
+
+        auto converter = std::make_unique<VideoConvertFilter>(dst_type);
+        if (!ConnectPins(converter->GetAllOutPins(), { in_pin })) {
+            continue;
+        }
+
+        if (!out_pin->ConnectTo(converter->GetAllInPins()[0])) {
+            in_pin->Disconnect();
+            continue;
         }
+
+        RTC_LOG(LS_INFO) << "MediaChain insert " << converter->name() << ": "
+            << SubMediaTypeName(out_pin->format().sub_fmt.video_fmt.type)
+            << " -> " << SubMediaTypeName(dst_type) << " for " << to->name();
+
+        // 放在下游节点之前，启动/停止的顺序和数据流向一致
+        converter->set_tracer(frame_trace_enabled_ ? frame_tracer_.get() : nullptr);
+        auto iter = std::find(media_objects_.begin(), media_objects_.end(), to);
+        media_objects_.insert(iter, converter.get());
+        converters_.push_back(std::move(converter));
+        return true;
     }
 
-    return true;
+    return false;
 }
 
 void MediaChain::SetupChain(const std::string& json_config)
@@ -57,5 +156,281 @@ void MediaChain::StopChain()
     }
 }
 
+void MediaChain::UpdateChain(const std::string& json_config) {
+    for (auto obj : media_objects_) {
+        obj->Update(json_config);
+    }
+}
+
+// 用new_obj替换old_obj：先接好下游，再把上游切到新节点，最后排空旧节点
+bool MediaChain::ReplaceMediaObject(MediaObject* old_obj, MediaObject* new_obj) {
+    if (!old_obj || !new_obj) {
+        return false;
+    }
+
+    auto iter = std::find(media_objects_.begin(), media_objects_.end(), old_obj);
+    if (iter == media_objects_.end()) {
+        return false;
+    }
+
+    std::vector<InPin*> downstream;
+    for (auto out_pin : old_obj->GetAllOutPins()) {
+        if (out_pin->in_pin()) {
+            downstream.push_back(out_pin->in_pin());
+        }
+    }
+
+    std::vector<OutPin*> upstream;
+    for (auto in_pin : old_obj->GetAllInPins()) {
+        if (in_pin->out_pin()) {
+            upstream.push_back(in_pin->out_pin());
+        }
+    }
+
+    new_obj->set_tracer(old_obj->tracer());
+    if (!new_obj->Start()) {
+        RTC_LOG(LS_WARNING) << "ReplaceMediaObject failed: new object start error";
+        return false;
+    }
+
+    if (!ConnectInPins(new_obj->GetAllOutPins(), downstream) ||
+        !ConnectPins(upstream, new_obj->GetAllInPins()))
+    {
+        RTC_LOG(LS_WARNING) << "ReplaceMediaObject failed: new object connect error";
+        // 恢复原有连接，帧继续流向旧节点
+        ConnectInPins(old_obj->GetAllOutPins(), downstream);
+        ConnectPins(upstream, old_obj->GetAllInPins());
+        new_obj->Stop();
+        return false;
+    }
+
+    *iter = new_obj;
+    DrainMediaObject(old_obj, upstream);
+    return true;
+}
+
+// 在from之后插入obj，from原来的下游改为接在obj之后
+bool MediaChain::InsertMediaObject(MediaObject* from, MediaObject* obj) {
+    if (!from || !obj) {
+        return false;
+    }
+
+    auto iter = std::find(media_objects_.begin(), media_objects_.end(), from);
+    if (iter == media_objects_.end()) {
+        return false;
+    }
+
+    std::vector<OutPin*> from_out_pins = from->GetAllOutPins();
+    std::vector<InPin*> downstream;
+    for (auto out_pin : from_out_pins) {
+        if (out_pin->in_pin()) {
+            downstream.push_back(out_pin->in_pin());
+        }
+    }
+
+    obj->set_tracer(from->tracer());
+    if (!obj->Start()) {
+        RTC_LOG(LS_WARNING) << "InsertMediaObject failed: object start error";
+        return false;
+    }
+
+    if (!ConnectInPins(obj->GetAllOutPins(), downstream) ||
+        !ConnectPins(from_out_pins, obj->GetAllInPins()))
+    {
+        RTC_LOG(LS_WARNING) << "InsertMediaObject failed: object connect error";
+        ConnectInPins(from_out_pins, downstream);
+        obj->Stop();
+        return false;
+    }
+
+    media_objects_.insert(iter + 1, obj);
+    return true;
+}
+
+// 移除obj，obj的上游直接连到它的下游
+bool MediaChain::RemoveMediaObject(MediaObject* obj) {
+    if (!obj) {
+        return false;
+    }
+
+    auto iter = std::find(media_objects_.begin(), media_objects_.end(), obj);
+    if (iter == media_objects_.end()) {
+        return false;
+    }
+
+    std::vector<OutPin*> upstream;
+    for (auto in_pin : obj->GetAllInPins()) {
+        if (in_pin->out_pin()) {
+            upstream.push_back(in_pin->out_pin());
+        }
+    }
+
+    std::vector<InPin*> downstream;
+    for (auto out_pin : obj->GetAllOutPins()) {
+        if (out_pin->in_pin()) {
+            downstream.push_back(out_pin->in_pin());
+        }
+    }
+
+    if (!ConnectPins(upstream, downstream)) {
+        RTC_LOG(LS_WARNING) << "RemoveMediaObject failed: upstream can not connect downstream";
+        ConnectPins(upstream, obj->GetAllInPins());
+        return false;
+    }
+
+    media_objects_.erase(iter);
+    DrainMediaObject(obj, upstream);
+    return true;
+}
+
+// 和ConnectMediaObject一样，每个out_pin都要连上，in_pin不重复使用
+bool MediaChain::ConnectPins(const std::vector<OutPin*>& out_pins,
+    const std::vector<InPin*>& in_pins)
+{
+    std::vector<InPin*> free_pins = in_pins;
+    for (auto out_pin : out_pins) {
+        bool has_connected = false;
+        for (auto iter = free_pins.begin(); iter != free_pins.end(); ++iter) {
+            if (out_pin->ConnectTo(*iter)) {
+                free_pins.erase(iter);
+                has_connected = true;
+                break;
+            }
+        }
+
+        if (!has_connected) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// 接管旧节点的下游：每个in_pin都要连上，没有下游的out_pin(例如未使用的预览输出)保持不连接
+bool MediaChain::ConnectInPins(const std::vector<OutPin*>& out_pins,
+    const std::vector<InPin*>& in_pins)
+{
+    std::vector<OutPin*> free_pins = out_pins;
+    for (auto in_pin : in_pins) {
+        bool has_connected = false;
+        for (auto iter = free_pins.begin(); iter != free_pins.end(); ++iter) {
+            if ((*iter)->ConnectTo(in_pin)) {
+                free_pins.erase(iter);
+                has_connected = true;
+                break;
+            }
+        }
+
+        if (!has_connected) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MediaChain::DrainMediaObject(MediaObject* obj,
+    const std::vector<OutPin*>& upstream)
+{
+    // 1. 上游已经切走，等待正在进入旧节点的帧返回
+    for (auto out_pin : upstream) {
+        out_pin->WaitIdle();
+    }
+
+    for (auto in_pin : obj->GetAllInPins()) {
+        in_pin->Disconnect();
+    }
+
+    // 2. 等待节点内部排队的帧处理完成，期间产生的帧仍可以流向下游
+    obj->Drain();
+    obj->Stop();
+
+    for (auto out_pin : obj->GetAllOutPins()) {
+        out_pin->Disconnect();
+    }
+}
+
+// {"nodes":[{"name":..,"frames":..,"fps":..,"process_us":..,"dropped":..,...}],"latency":{...}}
+std::string MediaChain::GetStats() {
+    int64_t now = rtc::TimeMillis();
+    JsonArray jnodes;
+    for (auto obj : media_objects_) {
+        JsonObject jnode;
+        jnode["name"] = obj->name();
+
+        std::vector<InPin*> in_pins = obj->GetAllInPins();
+        if (!in_pins.empty()) {
+            int64_t frames = 0;
+            double fps = 0.0;
+            int64_t process_us = 0;
+            int64_t dropped = 0;
+            for (auto in_pin : in_pins) {
+                frames += in_pin->frames();
+                dropped += in_pin->dropped();
+                fps += in_pin->fps(now);
+                process_us = std::max(process_us, in_pin->process_time_us());
+            }
+
+            jnode["frames"] = frames;
+            jnode["fps"] = fps;
+            jnode["process_us"] = process_us;
+            jnode["dropped"] = dropped;
+
+            VideoStreamFormat format = in_pins[0]->negotiated_format();
+            if (format.type != SubMediaType::kSubTypeCommon) {
+                jnode["format"] = VideoStreamFormatString(format);
+                jnode["renegotiations"] = in_pins[0]->renegotiations();
+            }
+        }
+
+        obj->GetStats(jnode);
+        jnodes.Append(jnode);
+    }
+
+    JsonObject jstats;
+    jstats["nodes"] = jnodes;
+    if (frame_tracer_ && frame_trace_enabled_) {
+        JsonValue jlatency;
+        if (jlatency.FromJson(frame_tracer_->GetLatencyStats())) {
+            jstats["latency"] = jlatency;
+        }
+    }
+
+    return JsonValue(jstats).ToJson();
+}
+
+// 节点读取tracer的时机不确定，开启后tracer不再释放，关闭只是把节点上的指针置空
+void MediaChain::EnableFrameTrace(bool enable) {
+    if (enable && !frame_tracer_) {
+        frame_tracer_ = std::make_unique<FrameTracer>();
+    }
+
+    frame_trace_enabled_ = enable;
+    for (auto obj : media_objects_) {
+        obj->set_tracer(enable ? frame_tracer_.get() : nullptr);
+    }
+}
+
+std::string MediaChain::GetLatencyStats() {
+    if (!frame_tracer_) {
+        return "";
+    }
+    return frame_tracer_->GetLatencyStats();
+}
+
+bool MediaChain::DumpChromeTrace(const std::string& path) {
+    if (!frame_tracer_) {
+        return false;
+    }
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        RTC_LOG(LS_WARNING) << "DumpChromeTrace open file failed: " << path;
+        return false;
+    }
+
+    file << frame_tracer_->GetChromeTrace();
+    return file.good();
+}
 
-} // namespace xrtc
\ No newline at end of file
+} // namespace xrtc
@@ -1,47 +1,119 @@
 ﻿#ifndef XRTCSDK_XRTC_MEDIA_BASE_MEDIA_CHAIN_H_
 #define XRTCSDK_XRTC_MEDIA_BASE_MEDIA_CHAIN_H_
 
+#include <atomic>
 #include <vector>
 #include <string>
+#include <memory>
 
 #include "xrtc/xrtc.h"
+#include "xrtc/base/task_pool.h"
+#include "xrtc/media/base/video_caps.h"
 
 namespace xrtc {
 
  class InPin;
  class OutPin;
+ class FrameTracer;
+ class JsonObject;
+
+// 节点在哪里处理帧，InPin按此分发
+enum class NodeExecutor {
+    kInline,//在上游推帧的线程上同步处理
+    kMediaPool,//在媒体线程池上处理，每个节点一个串行队列，帧的顺序不变
+    kMediaPoolLatest,//同kMediaPool，但每个输入只保留最新的一帧，处理不过来时丢弃旧帧(渲染)
+    kAudioPool,//在音频线程池上处理，每个节点一个串行队列，不和视频节点抢线程
+};
 
 class MediaObject {//节点对象
 public:
+    MediaObject() = default;
+    explicit MediaObject(NodeExecutor executor);
     virtual ~MediaObject() {}
 
     virtual bool Start() = 0;
     virtual void Setup(const std::string& /*json_config*/) {}//参数设置
+    virtual void Update(const std::string& /*json_config*/) {}//运行中更新参数，不重建节点
     virtual void Stop() = 0;
+    virtual void Drain();//等待已经投递出去的帧处理完成（热替换节点前调用），默认等待task_queue
     virtual void OnNewMediaFrame(std::shared_ptr<MediaFrame>) {}//接收传递的数据帧
+    //多输入节点(例如合成)通过in_pin区分帧来自哪个输入，默认转给OnNewMediaFrame
+    virtual void OnNewPinFrame(InPin* /*in_pin*/, std::shared_ptr<MediaFrame> frame) {
+        OnNewMediaFrame(frame);
+    }
+    //连接或者重新协商出新的视频格式时调用，和帧在同一个线程上按顺序到达，节点在这里分配缓冲
+    virtual void OnFormatChanged(InPin* /*in_pin*/, const VideoStreamFormat& /*format*/) {}
     //获取所有的out/in pin 才能将两个连接起来
     virtual std::vector<InPin*> GetAllInPins() = 0;
     virtual std::vector<OutPin*> GetAllOutPins() = 0;
+    //节点名，用于帧跟踪和统计，必须是常量字符串
+    virtual const char* name() const { return "media_object"; }
+    //节点自己的统计，例如渲染帧率、队列深度，由MediaChain::GetStats汇总
+    virtual void GetStats(JsonObject& /*stats*/) {}
+
+    void set_tracer(FrameTracer* tracer) { tracer_ = tracer; }
+    FrameTracer* tracer() const { return tracer_.load(); }
+
+    NodeExecutor executor() const { return executor_; }
+    // kMediaPool/kAudioPool节点的串行队列，kInline节点为nullptr
+    // 节点析构时需要先Stop队列，保证不会再有任务访问已经析构的成员
+    SerialTaskQueue* task_queue() { return task_queue_.get(); }
+
+private:
+    std::atomic<FrameTracer*> tracer_{ nullptr };//链路开启帧跟踪时设置
+    NodeExecutor executor_ = NodeExecutor::kInline;
+    std::unique_ptr<SerialTaskQueue> task_queue_;
 };
 
 class XRTC_API MediaChain {
 public:
-    MediaChain() = default;
-    virtual ~MediaChain() = default;
+    MediaChain();
+    virtual ~MediaChain();
 
     virtual void Start() = 0;
     virtual void Stop() = 0;
     virtual void Destroy() = 0;
 
+    // 链路统计(json)：每个节点的帧率、处理耗时以及节点自己的统计，可以每秒拉取
+    virtual std::string GetStats();
+
+    // 帧跟踪：记录每一帧进入/离开每个节点的时间
+    void EnableFrameTrace(bool enable);
+    // 每个节点以及端到端的延时分布(json)
+    std::string GetLatencyStats();
+    // 导出最近的帧，可以直接在chrome://tracing中打开
+    bool DumpChromeTrace(const std::string& path);
+
 protected:
     void AddMediaObject(MediaObject* obj);
     bool ConnectMediaObject(MediaObject* from, MediaObject* to);
+    // 只连接一个out_pin，分叉节点(TeeFilter)的各个out_pin分别连到不同的下游
+    bool ConnectMediaPin(OutPin* out_pin, MediaObject* to);
     void SetupChain(const std::string& json_config);
     bool StartChain();
     void StopChain();
 
+    // 运行时重配置：帧继续流动，被替换/移除的节点先排空再停止
+    // 新节点由调用者先Setup好，节点的内存仍由子类管理，调用返回后才能释放旧节点
+    void UpdateChain(const std::string& json_config);
+    bool ReplaceMediaObject(MediaObject* old_obj, MediaObject* new_obj);
+    bool InsertMediaObject(MediaObject* from, MediaObject* obj);
+    bool RemoveMediaObject(MediaObject* obj);
+
+private:
+    bool ConnectWithConverter(OutPin* out_pin, MediaObject* to,
+        const std::vector<InPin*>& in_pins);
+    bool ConnectPins(const std::vector<OutPin*>& out_pins,
+        const std::vector<InPin*>& in_pins);
+    bool ConnectInPins(const std::vector<OutPin*>& out_pins,
+        const std::vector<InPin*>& in_pins);
+    void DrainMediaObject(MediaObject* obj, const std::vector<OutPin*>& upstream);
+
 private:
     std::vector<MediaObject*> media_objects_;//存储节点 
+    std::vector<std::unique_ptr<MediaObject>> converters_;//连接时自动插入的格式转换节点，由链路持有
+    std::unique_ptr<FrameTracer> frame_tracer_;//开启过跟踪之后一直保留，帧上会引用它
+    std::atomic<bool> frame_trace_enabled_{ false };
 };
 
 } // namespace xrtc
@@ -0,0 +1,183 @@
+﻿#include "xrtc/media/base/media_frame.h"
+
+#include <algorithm>
+
+#include <libyuv.h>
+
+namespace xrtc {
+
+const char* SubMediaTypeName(SubMediaType type) {
+    switch (type) {
+    case SubMediaType::kSubTypeI420:
+        return "I420";
+    case SubMediaType::kSubTypeH264:
+        return "H264";
+    case SubMediaType::kSubTypeNV12:
+        return "NV12";
+    case SubMediaType::kSubTypeI420A:
+        return "I420A";
+    case SubMediaType::kSubTypeYUY2:
+        return "YUY2";
+    case SubMediaType::kSubTypeARGB:
+        return "ARGB";
+    case SubMediaType::kSubTypePcm:
+        return "PCM";
+    case SubMediaType::kSubTypeOpus:
+        return "OPUS";
+    default:
+        return "common";
+    }
+}
+
+namespace {
+
+int AlignUp(int value, int alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// 一帧未压缩视频在缓冲中的布局，CreateVideo和从缓冲池取出的帧共用
+struct VideoLayout {
+    int num_planes = 0;
+    int stride[4] = { 0 };
+    int rows[4] = { 0 };
+    int pad_bytes[4] = { 0 };
+    int pad_rows[4] = { 0 };
+    int size = 0;
+};
+
+bool ComputeVideoLayout(SubMediaType type, int width, int height,
+    int alignment, int padding, VideoLayout* layout)
+{
+    alignment = std::max(1, alignment);
+    padding = std::max(0, padding);
+
+    // 每个平面一行的字节数、行数、每个像素的字节数以及相对亮度的下采样
+    struct PlaneDesc {
+        int row_bytes;
+        int rows;
+        int bytes_per_pixel;
+        int subsample;
+    };
+
+    int chroma_width = (width + 1) / 2;
+    int chroma_height = (height + 1) / 2;
+    PlaneDesc planes[4] = {};
+    int num_planes = 0;
+    switch (type) {
+    case SubMediaType::kSubTypeI420:
+    case SubMediaType::kSubTypeI420A:
+        planes[num_planes++] = { width, height, 1, 1 };
+        planes[num_planes++] = { chroma_width, chroma_height, 1, 2 };
+        planes[num_planes++] = { chroma_width, chroma_height, 1, 2 };
+        if (type == SubMediaType::kSubTypeI420A) {
+            planes[num_planes++] = { width, height, 1, 1 };
+        }
+        break;
+    case SubMediaType::kSubTypeNV12:
+        planes[num_planes++] = { width, height, 1, 1 };
+        planes[num_planes++] = { chroma_width * 2, chroma_height, 2, 2 };
+        break;
+    case SubMediaType::kSubTypeYUY2:
+        planes[num_planes++] = { chroma_width * 4, height, 2, 1 };
+        break;
+    case SubMediaType::kSubTypeARGB:
+        planes[num_planes++] = { width * 4, height, 4, 1 };
+        break;
+    default:
+        return false;
+    }
+
+    // stride是alignment的整数倍，平面大小也是，所以每个平面的起始地址都对齐；
+    // 左右的padding按alignment取整，可见区域的起始地址同样对齐
+    *layout = VideoLayout();
+    layout->num_planes = num_planes;
+    for (int i = 0; i < num_planes; ++i) {
+        int pad_pixels = (padding + planes[i].subsample - 1) / planes[i].subsample;
+        layout->pad_bytes[i] = pad_pixels > 0 ?
+            AlignUp(pad_pixels * planes[i].bytes_per_pixel, alignment) : 0;
+        layout->pad_rows[i] = pad_pixels;
+        layout->stride[i] = AlignUp(planes[i].row_bytes + layout->pad_bytes[i] * 2, alignment);
+        layout->rows[i] = planes[i].rows;
+        layout->size += layout->stride[i] * (planes[i].rows + pad_pixels * 2);
+    }
+    return true;
+}
+
+} // namespace
+
+std::shared_ptr<MediaFrame> MediaFrame::CreateI420(const uint8_t* data_y, int stride_y,
+    const uint8_t* data_u, int stride_u,
+    const uint8_t* data_v, int stride_v,
+    int width, int height, int alignment)
+{
+    std::shared_ptr<MediaFrame> video_frame = CreateVideo(SubMediaType::kSubTypeI420,
+        width, height, alignment);
+    libyuv::I420Copy(data_y, stride_y, data_u, stride_u, data_v, stride_v,
+        (uint8_t*)video_frame->data[0], video_frame->stride[0],
+        (uint8_t*)video_frame->data[1], video_frame->stride[1],
+        (uint8_t*)video_frame->data[2], video_frame->stride[2],
+        width, height);
+    return video_frame;
+}
+
+std::shared_ptr<MediaFrame> MediaFrame::CreateVideo(SubMediaType type,
+    int width, int height, int alignment, int padding)
+{
+    alignment = std::max(1, alignment);
+    VideoLayout layout;
+    if (!ComputeVideoLayout(type, width, height, alignment, padding, &layout)) {
+        return nullptr;
+    }
+
+    std::shared_ptr<MediaFrame> video_frame = std::make_shared<MediaFrame>(layout.size, alignment);
+    video_frame->SetVideoLayout(type, width, height, alignment, padding);
+    return video_frame;
+}
+
+int MediaFrame::VideoBufferSize(SubMediaType type,
+    int width, int height, int alignment, int padding)
+{
+    VideoLayout layout;
+    if (!ComputeVideoLayout(type, width, height, alignment, padding, &layout)) {
+        return 0;
+    }
+    return layout.size;
+}
+
+bool MediaFrame::SetVideoLayout(SubMediaType type,
+    int width, int height, int alignment, int padding)
+{
+    alignment = std::max(1, alignment);
+    padding = std::max(0, padding);
+    VideoLayout layout;
+    if (!ComputeVideoLayout(type, width, height, alignment, padding, &layout) ||
+        layout.size > max_size || reinterpret_cast<uintptr_t>(base_) % alignment != 0)
+    {
+        return false;
+    }
+
+    fmt.media_type = MainMediaType::kMainTypeVideo;
+    fmt.sub_fmt.video_fmt.type = type;
+    fmt.sub_fmt.video_fmt.width = width;
+    fmt.sub_fmt.video_fmt.height = height;
+    fmt.sub_fmt.video_fmt.idr = false;
+    fmt.sub_fmt.video_fmt.temporal_id = 0;
+    fmt.sub_fmt.video_fmt.discardable = false;
+    this->alignment = alignment;
+    this->padding = padding;
+
+    memset(data, 0, sizeof(data));
+    memset(data_len, 0, sizeof(data_len));
+    memset(stride, 0, sizeof(stride));
+    char* plane = base_;
+    for (int i = 0; i < layout.num_planes; ++i) {
+        data[i] = plane + layout.pad_rows[i] * layout.stride[i] + layout.pad_bytes[i];
+        stride[i] = layout.stride[i];
+        data_len[i] = layout.stride[i] * layout.rows[i];
+        plane += layout.stride[i] * (layout.rows[i] + layout.pad_rows[i] * 2);
+    }
+
+    return true;
+}
+
+} // namespace xrtc
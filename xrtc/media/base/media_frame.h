@@ -1,8 +1,16 @@
 ﻿#ifndef XRTCSDK_XRTC_MEDIA_BASE_MEDIA_FRAME_H_
 #define XRTCSDK_XRTC_MEDIA_BASE_MEDIA_FRAME_H_
 
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+
 namespace xrtc {
 
+class FrameTracer;
+
     //定义媒体的主要类型
 enum class MainMediaType {
     kMainTypeCommon,
@@ -16,11 +24,31 @@ enum class SubMediaType {
     kSubTypeCommon,
     kSubTypeI420,
     kSubTypeH264,
+    kSubTypeNV12,//Y平面 + UV交错平面，硬件采集/编码常用
+    kSubTypeI420A,//I420 + 全分辨率的alpha平面(data[3])
+    kSubTypeYUY2,//打包格式，单平面
+    kSubTypeARGB,//libyuv的ARGB，内存中为B/G/R/A
+    kSubTypePcm,//16bit有符号交错PCM
+    kSubTypeOpus,
 };
 
+//未压缩的视频格式，格式之间可以用libyuv互相转换
+inline bool IsRawVideoType(SubMediaType type) {
+    return type == SubMediaType::kSubTypeI420 ||
+        type == SubMediaType::kSubTypeNV12 ||
+        type == SubMediaType::kSubTypeI420A ||
+        type == SubMediaType::kSubTypeYUY2 ||
+        type == SubMediaType::kSubTypeARGB;
+}
+
+const char* SubMediaTypeName(SubMediaType type);
+
 //描述音频格式的具体信息。
 struct AudioFormat {
     SubMediaType type;
+    int sample_rate;
+    int channels;
+    int samples_per_channel;//每个声道的采样数，一帧为10ms
 };
 
 //描述视频格式的具体信息。
@@ -29,6 +57,8 @@ struct VideoFormat {
     int width;
     int height;
     bool idr;//是否是关键帧
+    int temporal_id;//时域分层的层号，0为基础层，不分层时都是0
+    bool discardable;//不被其它帧参考，丢掉不影响之后的解码
 };
 
 //统一描述媒体格式，支持音频和视频两种类型
@@ -41,21 +71,140 @@ public:
     } sub_fmt;
 };
 
+//帧在链路上的时间记录，只在链路开启跟踪时分配，单位us
+//帧分叉到多个分支后各分支的线程会同时写：span用fetch_add占位，最后一个结束的分支负责发布
+struct FrameTrace {
+    static const int kMaxSpans = 16;
+
+    struct Span {
+        const char* name = nullptr;//节点名，或者"节点名.阶段"，必须是常量字符串
+        int64_t enter_us = 0;
+        std::atomic<int64_t> exit_us{ 0 };
+        std::atomic<bool> ready{ false };//name和enter_us写完后置位，其它线程看到之后才读取
+    };
+
+    void Enter(const char* name, int64_t now_us) {
+        AddSpan(name, now_us, 0);
+    }
+
+    //从后往前找到还没有结束的同名节点
+    void Exit(const char* name, int64_t now_us) {
+        for (int i = size() - 1; i >= 0; --i) {
+            Span& span = spans[i];
+            if (!span.ready.load(std::memory_order_acquire) || strcmp(span.name, name) != 0) {
+                continue;
+            }
+            int64_t expected = 0;
+            if (span.exit_us.compare_exchange_strong(expected, now_us)) {
+                return;
+            }
+        }
+    }
+
+    void AddSpan(const char* name, int64_t enter_us, int64_t exit_us) {
+        int i = span_count.fetch_add(1, std::memory_order_relaxed);
+        if (i < kMaxSpans) {
+            spans[i].name = name;
+            spans[i].enter_us = enter_us;
+            spans[i].exit_us.store(exit_us, std::memory_order_relaxed);
+            spans[i].ready.store(true, std::memory_order_release);
+        }
+    }
+
+    //已占用的span数，超过kMaxSpans的不再记录
+    int size() const {
+        int count = span_count.load(std::memory_order_acquire);
+        return count < kMaxSpans ? count : kMaxSpans;
+    }
+
+    //拷贝一份给新生成的帧(例如格式转换)，原来的帧可能还在其它分支上，不能转交
+    FrameTrace* Clone() const {
+        FrameTrace* copy = new FrameTrace();
+        copy->tracer = tracer;
+        copy->frame_ts = frame_ts;
+        copy->begin_us = begin_us;
+        for (int i = 0; i < size(); ++i) {
+            const Span& span = spans[i];
+            if (span.ready.load(std::memory_order_acquire)) {
+                copy->AddSpan(span.name, span.enter_us,
+                    span.exit_us.load(std::memory_order_relaxed));
+            }
+        }
+        return copy;
+    }
+
+    //把同一帧推给多个分支的节点在推送前调用，每个分支的末端都会调用FrameTracer::End
+    void Fork(int branches) {
+        if (branches > 1) {
+            holders.fetch_add(branches - 1, std::memory_order_relaxed);
+        }
+    }
+
+    //末端结束一个分支，返回true表示是最后一个，之前各分支的写入都已可见
+    bool Release() {
+        return holders.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    FrameTracer* tracer = nullptr;//哪个链路在跟踪这一帧
+    uint32_t frame_ts = 0;
+    int64_t begin_us = 0;//采集时间
+    Span spans[kMaxSpans];
+    std::atomic<int> span_count{ 0 };
+    std::atomic<int> holders{ 1 };//还没有结束的分支数
+};
+
 class MediaFrame {
 public:
-    MediaFrame(int size) : max_size(size) {
+    // 视频平面默认按64字节对齐(AVX-512的宽度，也满足SSE/AVX2/NEON)，libyuv/x264走对齐的快速路径
+    static const int kDefaultAlignment = 64;
+
+    // alignment为data[0]起始地址的对齐字节数
+    explicit MediaFrame(int size, int alignment = 1) : max_size(size) {
         memset(data, 0, sizeof(data));
         memset(data_len, 0, sizeof(data_len));
         memset(stride, 0, sizeof(stride));
-        data[0] = new char[size];
+        buffer_ = new char[size + alignment - 1];
+        uintptr_t addr = reinterpret_cast<uintptr_t>(buffer_);
+        base_ = buffer_ + ((alignment - addr % alignment) % alignment);
+        data[0] = base_;
         data_len[0] = size;
     }
 
+    // 拷贝一帧I420数据，平面和stride按alignment对齐
+    static std::shared_ptr<MediaFrame> CreateI420(const uint8_t* data_y, int stride_y,
+        const uint8_t* data_u, int stride_u,
+        const uint8_t* data_v, int stride_v,
+        int width, int height, int alignment = kDefaultAlignment);
+
+    // 按格式分配一帧未压缩的视频，内容未初始化
+    // 每个平面的起始地址和stride按alignment对齐(1表示紧密排列)；
+    // padding为平面四周额外留出的像素(色度平面减半)，供运动搜索越界读取，data[i]指向可见区域
+    static std::shared_ptr<MediaFrame> CreateVideo(SubMediaType type,
+        int width, int height, int alignment = kDefaultAlignment, int padding = 0);
+
+    // CreateVideo需要的缓冲大小，不支持的格式返回0
+    static int VideoBufferSize(SubMediaType type,
+        int width, int height, int alignment = kDefaultAlignment, int padding = 0);
+
+    // 在已有的缓冲上按CreateVideo的布局重新布置平面，例如从MediaFramePool取出的帧
+    // 缓冲不够大或者起始地址不满足alignment时返回false
+    bool SetVideoLayout(SubMediaType type,
+        int width, int height, int alignment = kDefaultAlignment, int padding = 0);
+
     ~MediaFrame() {
-        if (data[0]) {
-            delete[] data[0];
-            data[0] = nullptr;
+        delete[] buffer_;
+        buffer_ = nullptr;
+
+        delete trace.load();
+    }
+
+    //返回由tracer跟踪的记录，没有开启跟踪或者属于其他链路时返回nullptr
+    FrameTrace* TraceFor(const FrameTracer* tracer) {
+        if (!tracer) {
+            return nullptr;
         }
+        FrameTrace* t = trace.load(std::memory_order_acquire);
+        return (t && t->tracer == tracer) ? t : nullptr;
     }
     
 public:
@@ -64,8 +213,16 @@ public:
     char* data[4];//4个平面
     int data_len[4];//指定每个平面字节数
     int stride[4];//存放每一行的一个大小
+    int alignment = 1;//平面起始地址和stride的对齐字节数
+    int padding = 0;//平面四周额外分配的像素
     uint32_t ts = 0;//帧的时间戳
     int64_t capture_time_ms = 0;
+    //同一帧可能分发给多个链路，只有第一个开启跟踪的链路会记录
+    std::atomic<FrameTrace*> trace{ nullptr };
+
+private:
+    char* buffer_ = nullptr;//实际分配的内存
+    char* base_ = nullptr;//buffer_中对齐后的起始地址，有padding时data[0]在它之后
 };
 
 } // namespace xrtc
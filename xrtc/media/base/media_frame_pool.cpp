@@ -0,0 +1,64 @@
+﻿#include "xrtc/media/base/media_frame_pool.h"
+
+namespace xrtc {
+
+MediaFramePool::Storage::~Storage() {
+    for (MediaFrame* frame : frames) {
+        delete frame;
+    }
+}
+
+MediaFramePool::MediaFramePool(int frame_size, int max_free) :
+    frame_size_(frame_size),
+    storage_(std::make_shared<Storage>())
+{
+    storage_->max_free = max_free;
+    storage_->frames.reserve(max_free);
+}
+
+MediaFramePool::~MediaFramePool() {
+}
+
+std::shared_ptr<MediaFrame> MediaFramePool::Acquire() {
+    MediaFrame* frame = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(storage_->mutex);
+        if (!storage_->frames.empty()) {
+            frame = storage_->frames.back();
+            storage_->frames.pop_back();
+        }
+    }
+
+    if (frame) {
+        storage_->reused.Add();
+    }
+    else {
+        frame = new MediaFrame(frame_size_, MediaFrame::kDefaultAlignment);
+        storage_->allocated.Add();
+    }
+
+    std::shared_ptr<Storage> storage = storage_;
+    return std::shared_ptr<MediaFrame>(frame, [storage](MediaFrame* frame) {
+        Release(storage, frame);
+    });
+}
+
+// 清掉上一次使用留下的跟踪记录和时间戳再放回池中
+void MediaFramePool::Release(const std::shared_ptr<Storage>& storage, MediaFrame* frame) {
+    delete frame->trace.exchange(nullptr);
+    frame->ts = 0;
+    frame->capture_time_ms = 0;
+    frame->data_len[0] = frame->max_size;
+
+    {
+        std::lock_guard<std::mutex> lock(storage->mutex);
+        if ((int)storage->frames.size() < storage->max_free) {
+            storage->frames.push_back(frame);
+            return;
+        }
+    }
+
+    delete frame;
+}
+
+} // namespace xrtc
@@ -0,0 +1,52 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_BASE_MEDIA_FRAME_POOL_H_
+#define XRTCSDK_XRTC_MEDIA_BASE_MEDIA_FRAME_POOL_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/media/base/media_frame.h"
+
+namespace xrtc {
+
+// 固定大小的帧缓冲池：帧的最后一个引用释放时回到池中，下次Acquire直接复用
+// 用于音频这类小而频繁的帧，采集线程上不再每10ms分配一次缓冲
+// 池可以先于帧析构，之后释放的帧直接删除
+class MediaFramePool {
+public:
+    // frame_size为每帧data[0]的字节数，池中最多缓存max_free个空闲帧
+    MediaFramePool(int frame_size, int max_free = 16);
+    ~MediaFramePool();
+
+    MediaFramePool(const MediaFramePool&) = delete;
+    MediaFramePool& operator=(const MediaFramePool&) = delete;
+
+    // 返回的帧data[0]/data_len[0]为整个缓冲，格式和时间戳由调用者填写
+    std::shared_ptr<MediaFrame> Acquire();
+
+    int frame_size() const { return frame_size_; }
+    int64_t allocated() const { return storage_->allocated.count(); }//新分配的帧数
+    int64_t reused() const { return storage_->reused.count(); }//从池中复用的帧数
+
+private:
+    struct Storage {
+        ~Storage();
+
+        std::mutex mutex;
+        std::vector<MediaFrame*> frames;
+        int max_free = 0;
+        StatsCounter allocated;
+        StatsCounter reused;
+    };
+
+    static void Release(const std::shared_ptr<Storage>& storage, MediaFrame* frame);
+
+private:
+    int frame_size_;
+    std::shared_ptr<Storage> storage_;//帧的删除器也持有，保证池析构后帧仍可以安全释放
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_BASE_MEDIA_FRAME_POOL_H_
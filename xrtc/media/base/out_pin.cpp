@@ -1,5 +1,7 @@
 ﻿#include "xrtc/media/base/out_pin.h"
 
+#include <rtc_base/time_utils.h>
+
 #include "xrtc/media/base/media_chain.h"
 #include "xrtc/media/base/in_pin.h"
 
@@ -16,15 +18,65 @@ bool OutPin::ConnectTo(InPin* in_pin) {
         return false;
     }
 
-    in_pin_ = in_pin;//保存in_pin
+    in_pin_.store(in_pin);//保存in_pin，之后推出的帧直接流向新的in_pin
 
     return true;
 }
 
+void OutPin::Disconnect() {
+    in_pin_.store(nullptr);
+}
+
+void OutPin::WaitIdle() {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    // 之后开始的推送计入另一组，读到的一定是新的in_pin
+    int slot = epoch_.fetch_add(1) & 1;
+    ++waiters_;
+    idle_cond_.wait(lock, [this, slot] { return pushing_[slot].load() == 0; });
+    --waiters_;
+}
+
+int OutPin::BeginPush() {
+    // 先计数再读取in_pin，WaitIdle返回后不会再有帧流向切换前的in_pin
+    int slot = epoch_.load() & 1;
+    ++pushing_[slot];
+    return slot;
+}
+
+void OutPin::EndPush(int slot) {
+    // waiters_在WaitIdle加锁后增加，这里读到0时WaitIdle检查条件一定能看到计数归零
+    if (--pushing_[slot] == 0 && waiters_.load() > 0) {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        idle_cond_.notify_all();
+    }
+}
+
+bool OutPin::Renegotiate(const VideoStreamFormat& format) {
+    int slot = BeginPush();
+    bool result = true;
+    InPin* in_pin = in_pin_.load();
+    if (in_pin) {
+        result = in_pin->Renegotiate(this, format);
+    }
+    else {
+        set_negotiated_format(format);
+    }
+    EndPush(slot);
+    return result;
+}
+
 void OutPin::PushMediaFrame(std::shared_ptr<MediaFrame> frame) {
-    if (in_pin_) {
-        in_pin_->PushMediaFrame(frame);
+    int slot = BeginPush();
+    FrameTrace* trace = obj_ ? frame->TraceFor(obj_->tracer()) : nullptr;
+    if (trace) {
+        trace->Exit(obj_->name(), rtc::TimeMicros());
+    }
+
+    InPin* in_pin = in_pin_.load();
+    if (in_pin) {
+        in_pin->PushMediaFrame(frame);
     }
+    EndPush(slot);
 }
 
 } // namespace xrtc
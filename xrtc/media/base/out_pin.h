@@ -1,6 +1,10 @@
 ﻿#ifndef XRTCSDK_XRTC_MEDIA_BASE_OUT_PIN_H_
 #define XRTCSDK_XRTC_MEDIA_BASE_OUT_PIN_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
 #include "xrtc/media/base/base_pin.h"
 
 namespace xrtc {
@@ -14,12 +18,29 @@ public:
     ~OutPin() override;
 
     bool ConnectTo(InPin* in_pin);
+    void Disconnect();
+    InPin* in_pin() { return in_pin_.load(); }
+    // 等待切换in_pin之前开始的推送返回，切换in_pin之后调用，保证旧的in_pin不会再收到帧
+    // 只等待旧的推送，上游一直在推帧也不会饿死；由链路所在的线程调用，不能并发
+    void WaitIdle();
+    // 源的实际格式变化(例如分辨率切换)时调用，下游重新协商，在推下一帧之前调用
+    bool Renegotiate(const VideoStreamFormat& format);
 
     // BasePin
     void PushMediaFrame(std::shared_ptr<MediaFrame> frame) override;
 
 private:
-    InPin* in_pin_ = nullptr;
+    int BeginPush();
+    void EndPush(int slot);
+
+private:
+    std::atomic<InPin*> in_pin_{ nullptr };//运行中可能被替换，读写都走原子操作
+    // 正在执行PushMediaFrame的调用数，按epoch_的奇偶分两组，WaitIdle翻转epoch_后只等旧的一组
+    std::atomic<int> epoch_{ 0 };
+    std::atomic<int> pushing_[2] = { {0}, {0} };
+    std::atomic<int> waiters_{ 0 };//WaitIdle等待中，推送结束时才需要加锁通知
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cond_;
 };
 
 } // namespace xrtc
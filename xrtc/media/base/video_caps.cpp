@@ -0,0 +1,108 @@
+﻿#include "xrtc/media/base/video_caps.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace xrtc {
+
+namespace {
+
+bool HasVideoType(const std::vector<SubMediaType>& types, SubMediaType type) {
+    return std::find(types.begin(), types.end(), type) != types.end();
+}
+
+bool NegotiateVideoType(const std::vector<SubMediaType>& out_types,
+    const std::vector<SubMediaType>& in_types, SubMediaType* type)
+{
+    for (auto in_type : in_types) {
+        if (in_type == SubMediaType::kSubTypeCommon) {
+            *type = out_types.empty() ? SubMediaType::kSubTypeCommon : out_types.front();
+            return true;
+        }
+
+        if (HasVideoType(out_types, in_type) ||
+            HasVideoType(out_types, SubMediaType::kSubTypeCommon))
+        {
+            *type = in_type;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 两个上限取较小的，0表示不限制
+int MinLimit(int a, int b) {
+    if (a == 0) {
+        return b;
+    }
+    if (b == 0) {
+        return a;
+    }
+    return std::min(a, b);
+}
+
+bool InRange(int value, int min_value, int max_value) {
+    return value >= min_value && (max_value == 0 || value <= max_value);
+}
+
+int Lcm(int a, int b) {
+    int x = a;
+    int y = b;
+    while (y != 0) {
+        int t = x % y;
+        x = y;
+        y = t;
+    }
+    return a / x * b;
+}
+
+} // namespace
+
+bool NegotiateVideoFormat(const VideoCaps& out_caps, const VideoCaps& in_caps,
+    const VideoStreamFormat& preferred, VideoStreamFormat* result)
+{
+    VideoStreamFormat format;
+    if (!NegotiateVideoType(out_caps.types, in_caps.types, &format.type)) {
+        return false;
+    }
+
+    int min_width = std::max(out_caps.min_width, in_caps.min_width);
+    int max_width = MinLimit(out_caps.max_width, in_caps.max_width);
+    int min_height = std::max(out_caps.min_height, in_caps.min_height);
+    int max_height = MinLimit(out_caps.max_height, in_caps.max_height);
+    if ((max_width != 0 && min_width > max_width) ||
+        (max_height != 0 && min_height > max_height))
+    {
+        return false;
+    }
+
+    // 宽高由源决定，节点之间不做缩放，超出范围时协商失败
+    if (preferred.width > 0 && preferred.height > 0) {
+        if (!InRange(preferred.width, min_width, max_width) ||
+            !InRange(preferred.height, min_height, max_height))
+        {
+            return false;
+        }
+        format.width = preferred.width;
+        format.height = preferred.height;
+    }
+
+    format.fps = MinLimit(preferred.fps, MinLimit(out_caps.max_fps, in_caps.max_fps));
+    format.alignment = Lcm(std::max(1, preferred.alignment),
+        Lcm(std::max(1, out_caps.alignment), std::max(1, in_caps.alignment)));
+    format.padding = std::max(preferred.padding, std::max(out_caps.padding, in_caps.padding));
+
+    *result = format;
+    return true;
+}
+
+std::string VideoStreamFormatString(const VideoStreamFormat& format) {
+    std::stringstream ss;
+    ss << SubMediaTypeName(format.type) << " " << format.width << "x" << format.height;
+    if (format.fps > 0) {
+        ss << "@" << format.fps;
+    }
+    return ss.str();
+}
+
+} // namespace xrtc
@@ -0,0 +1,51 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_BASE_VIDEO_CAPS_H_
+#define XRTCSDK_XRTC_MEDIA_BASE_VIDEO_CAPS_H_
+
+#include <string>
+#include <vector>
+
+#include "xrtc/media/base/media_frame.h"
+
+namespace xrtc {
+
+// pin的视频能力：可以接受(in_pin)/输出(out_pin)的格式、分辨率范围、最大帧率和平面对齐
+// 数值为0表示不限制
+struct VideoCaps {
+    std::vector<SubMediaType> types;//按优先顺序排列，kSubTypeCommon表示任意类型
+    int min_width = 0;
+    int max_width = 0;
+    int min_height = 0;
+    int max_height = 0;
+    int max_fps = 0;
+    int alignment = 1;//平面stride的字节对齐
+    int padding = 0;//平面四周需要预留的像素(编码器运动搜索)
+};
+
+// 连接时协商出的具体格式，节点据此一次性分配缓冲
+// 宽高为0表示还不知道(例如摄像头还没有出帧)，源的格式确定之后会重新协商
+struct VideoStreamFormat {
+    SubMediaType type = SubMediaType::kSubTypeCommon;
+    int width = 0;
+    int height = 0;
+    int fps = 0;//0表示不限制
+    int alignment = 1;
+    int padding = 0;
+
+    bool operator==(const VideoStreamFormat& other) const {
+        return type == other.type && width == other.width && height == other.height &&
+            fps == other.fps && alignment == other.alignment && padding == other.padding;
+    }
+    bool operator!=(const VideoStreamFormat& other) const { return !(*this == other); }
+};
+
+// 求out_caps和in_caps的交集：子类型按in_caps的优先顺序选，宽高取preferred(源的实际格式)，
+// 帧率取最小的限制，对齐取两者的最小公倍数，padding取最大；不相交时返回false
+bool NegotiateVideoFormat(const VideoCaps& out_caps, const VideoCaps& in_caps,
+    const VideoStreamFormat& preferred, VideoStreamFormat* result);
+
+// "NV12 1280x720@30"，用于日志和统计
+std::string VideoStreamFormatString(const VideoStreamFormat& format);
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_BASE_VIDEO_CAPS_H_
@@ -0,0 +1,188 @@
+﻿#include "xrtc/media/base/video_convert.h"
+
+#include <libyuv.h>
+
+namespace xrtc {
+
+namespace {
+
+const uint8_t* Plane(const MediaFrame& frame, int index) {
+    return (const uint8_t*)frame.data[index];
+}
+
+uint8_t* Plane(MediaFrame* frame, int index) {
+    return (uint8_t*)frame->data[index];
+}
+
+// src转换成I420，写入dst的前三个平面(dst可以是I420或者I420A)
+bool ToI420(const MediaFrame& src, MediaFrame* dst, int width, int height) {
+    switch (src.fmt.sub_fmt.video_fmt.type) {
+    case SubMediaType::kSubTypeI420:
+    case SubMediaType::kSubTypeI420A:
+        return libyuv::I420Copy(Plane(src, 0), src.stride[0],
+            Plane(src, 1), src.stride[1],
+            Plane(src, 2), src.stride[2],
+            Plane(dst, 0), dst->stride[0],
+            Plane(dst, 1), dst->stride[1],
+            Plane(dst, 2), dst->stride[2],
+            width, height) == 0;
+    case SubMediaType::kSubTypeNV12:
+        return libyuv::NV12ToI420(Plane(src, 0), src.stride[0],
+            Plane(src, 1), src.stride[1],
+            Plane(dst, 0), dst->stride[0],
+            Plane(dst, 1), dst->stride[1],
+            Plane(dst, 2), dst->stride[2],
+            width, height) == 0;
+    case SubMediaType::kSubTypeYUY2:
+        return libyuv::YUY2ToI420(Plane(src, 0), src.stride[0],
+            Plane(dst, 0), dst->stride[0],
+            Plane(dst, 1), dst->stride[1],
+            Plane(dst, 2), dst->stride[2],
+            width, height) == 0;
+    case SubMediaType::kSubTypeARGB:
+        return libyuv::ARGBToI420(Plane(src, 0), src.stride[0],
+            Plane(dst, 0), dst->stride[0],
+            Plane(dst, 1), dst->stride[1],
+            Plane(dst, 2), dst->stride[2],
+            width, height) == 0;
+    default:
+        return false;
+    }
+}
+
+// I420/I420A转换成dst的格式
+bool FromI420(const MediaFrame& src, MediaFrame* dst, int width, int height) {
+    switch (dst->fmt.sub_fmt.video_fmt.type) {
+    case SubMediaType::kSubTypeI420:
+        return ToI420(src, dst, width, height);
+    case SubMediaType::kSubTypeI420A:
+        if (!ToI420(src, dst, width, height)) {
+            return false;
+        }
+        // 没有alpha的源按不透明处理
+        if (src.fmt.sub_fmt.video_fmt.type == SubMediaType::kSubTypeI420A) {
+            libyuv::CopyPlane(Plane(src, 3), src.stride[3],
+                Plane(dst, 3), dst->stride[3], width, height);
+        }
+        else {
+            libyuv::SetPlane(Plane(dst, 3), dst->stride[3], width, height, 255);
+        }
+        return true;
+    case SubMediaType::kSubTypeNV12:
+        return libyuv::I420ToNV12(Plane(src, 0), src.stride[0],
+            Plane(src, 1), src.stride[1],
+            Plane(src, 2), src.stride[2],
+            Plane(dst, 0), dst->stride[0],
+            Plane(dst, 1), dst->stride[1],
+            width, height) == 0;
+    case SubMediaType::kSubTypeYUY2:
+        return libyuv::I420ToYUY2(Plane(src, 0), src.stride[0],
+            Plane(src, 1), src.stride[1],
+            Plane(src, 2), src.stride[2],
+            Plane(dst, 0), dst->stride[0],
+            width, height) == 0;
+    case SubMediaType::kSubTypeARGB:
+        return ConvertToARGB(src, Plane(dst, 0), dst->stride[0]);
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+bool ConvertVideoFrame(const MediaFrame& src, MediaFrame* dst) {
+    int width = src.fmt.sub_fmt.video_fmt.width;
+    int height = src.fmt.sub_fmt.video_fmt.height;
+    SubMediaType src_type = src.fmt.sub_fmt.video_fmt.type;
+    SubMediaType dst_type = dst->fmt.sub_fmt.video_fmt.type;
+    if (!IsRawVideoType(src_type) || !IsRawVideoType(dst_type) ||
+        width != dst->fmt.sub_fmt.video_fmt.width ||
+        height != dst->fmt.sub_fmt.video_fmt.height)
+    {
+        return false;
+    }
+
+    if (dst_type == SubMediaType::kSubTypeARGB) {
+        return ConvertToARGB(src, Plane(dst, 0), dst->stride[0]);
+    }
+
+    if (src_type == SubMediaType::kSubTypeI420 || src_type == SubMediaType::kSubTypeI420A) {
+        return FromI420(src, dst, width, height);
+    }
+
+    if (dst_type == SubMediaType::kSubTypeI420) {
+        return ToI420(src, dst, width, height);
+    }
+
+    if (dst_type == SubMediaType::kSubTypeI420A) {
+        if (!ToI420(src, dst, width, height)) {
+            return false;
+        }
+        if (src_type == SubMediaType::kSubTypeARGB) {
+            libyuv::ARGBExtractAlpha(Plane(src, 0), src.stride[0],
+                Plane(dst, 3), dst->stride[3], width, height);
+        }
+        else {
+            libyuv::SetPlane(Plane(dst, 3), dst->stride[3], width, height, 255);
+        }
+        return true;
+    }
+
+    // 打包格式和NV12之间的直接转换
+    if (dst_type == SubMediaType::kSubTypeNV12) {
+        if (src_type == SubMediaType::kSubTypeYUY2) {
+            return libyuv::YUY2ToNV12(Plane(src, 0), src.stride[0],
+                Plane(dst, 0), dst->stride[0],
+                Plane(dst, 1), dst->stride[1],
+                width, height) == 0;
+        }
+        if (src_type == SubMediaType::kSubTypeARGB) {
+            return libyuv::ARGBToNV12(Plane(src, 0), src.stride[0],
+                Plane(dst, 0), dst->stride[0],
+                Plane(dst, 1), dst->stride[1],
+                width, height) == 0;
+        }
+    }
+
+    std::shared_ptr<MediaFrame> i420 = MediaFrame::CreateVideo(SubMediaType::kSubTypeI420,
+        width, height);
+    return ToI420(src, i420.get(), width, height) &&
+        FromI420(*i420, dst, width, height);
+}
+
+bool ConvertToARGB(const MediaFrame& src, uint8_t* dst_argb, int dst_stride) {
+    int width = src.fmt.sub_fmt.video_fmt.width;
+    int height = src.fmt.sub_fmt.video_fmt.height;
+    switch (src.fmt.sub_fmt.video_fmt.type) {
+    case SubMediaType::kSubTypeI420:
+        return libyuv::I420ToARGB(Plane(src, 0), src.stride[0],
+            Plane(src, 1), src.stride[1],
+            Plane(src, 2), src.stride[2],
+            dst_argb, dst_stride,
+            width, height) == 0;
+    case SubMediaType::kSubTypeI420A:
+        return libyuv::I420AlphaToARGB(Plane(src, 0), src.stride[0],
+            Plane(src, 1), src.stride[1],
+            Plane(src, 2), src.stride[2],
+            Plane(src, 3), src.stride[3],
+            dst_argb, dst_stride,
+            width, height, 0) == 0;
+    case SubMediaType::kSubTypeNV12:
+        return libyuv::NV12ToARGB(Plane(src, 0), src.stride[0],
+            Plane(src, 1), src.stride[1],
+            dst_argb, dst_stride,
+            width, height) == 0;
+    case SubMediaType::kSubTypeYUY2:
+        return libyuv::YUY2ToARGB(Plane(src, 0), src.stride[0],
+            dst_argb, dst_stride,
+            width, height) == 0;
+    case SubMediaType::kSubTypeARGB:
+        return libyuv::ARGBCopy(Plane(src, 0), src.stride[0],
+            dst_argb, dst_stride,
+            width, height) == 0;
+    default:
+        return false;
+    }
+}
+
+} // namespace xrtc
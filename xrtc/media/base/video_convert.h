@@ -0,0 +1,17 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_BASE_VIDEO_CONVERT_H_
+#define XRTCSDK_XRTC_MEDIA_BASE_VIDEO_CONVERT_H_
+
+#include "xrtc/media/base/media_frame.h"
+
+namespace xrtc {
+
+// 未压缩视频格式之间的转换，尽量使用libyuv的直接转换，没有直接转换时经过一次I420中转
+// dst由调用者按目标格式分配(MediaFrame::CreateVideo)，宽高和src相同
+bool ConvertVideoFrame(const MediaFrame& src, MediaFrame* dst);
+
+// 转换成ARGB(渲染)，每种格式都是一次直接转换
+bool ConvertToARGB(const MediaFrame& src, uint8_t* dst_argb, int dst_stride);
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_BASE_VIDEO_CONVERT_H_
@@ -0,0 +1,149 @@
+﻿#include "xrtc/media/chain/xrtc_gallery.h"
+
+#include <rtc_base/logging.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+
+#include "xrtc/base/xrtc_global.h"
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/sink/render_sink_factory.h"
+
+namespace xrtc {
+
+XRTCGallery::XRTCGallery(const std::vector<IVideoSource*>& video_sources,
+    XRTCRender* render) :
+    current_thread_(rtc::Thread::Current()),
+    video_sources_(video_sources),
+    render_(render),
+    video_compositor_(std::make_unique<VideoCompositor>((int)video_sources.size())),
+    render_sink_(CreateVideoRenderSink())
+{
+    for (size_t i = 0; i < video_sources_.size(); ++i) {
+        xrtc_video_sources_.push_back(std::make_unique<XRTCVideoSource>());
+    }
+}
+
+XRTCGallery::~XRTCGallery() {
+}
+
+void XRTCGallery::Start() {
+    RTC_LOG(LS_INFO) << "XRTCGallery Start call";
+    current_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        RTC_LOG(LS_INFO) << "XRTCGallery Start PostTask";
+
+        XRTCError err = XRTCError::kNoErr;
+
+        do {
+            if (has_start_) {
+                RTC_LOG(LS_WARNING) << "XRTCGallery already start, ignore";
+                break;
+            }
+
+            if (video_sources_.empty()) {
+                err = XRTCError::kPreviewNoVideoSourceErr;
+                RTC_LOG(LS_WARNING) << "XRTCGallery failed: no video source";
+                break;
+            }
+
+            for (auto& xrtc_video_source : xrtc_video_sources_) {
+                AddMediaObject(xrtc_video_source.get());
+            }
+            AddMediaObject(video_compositor_.get());
+            AddMediaObject(render_sink_.get());
+
+            // 每个视频源依次占用合成节点的一个输入
+            for (auto& xrtc_video_source : xrtc_video_sources_) {
+                if (!ConnectMediaObject(xrtc_video_source.get(), video_compositor_.get())) {
+                    err = XRTCError::kChainConnectErr;
+                    break;
+                }
+            }
+
+            if (err != XRTCError::kNoErr) {
+                RTC_LOG(LS_WARNING) << "XRTCGallery failed: xrtc_video_source connect "
+                    << video_compositor_->name() << " error";
+                break;
+            }
+
+            if (!ConnectMediaObject(video_compositor_.get(), render_sink_.get())) {
+                err = XRTCError::kChainConnectErr;
+                RTC_LOG(LS_WARNING) << "XRTCGallery failed: " << video_compositor_->name()
+                    << " connect " << render_sink_->name() << " error";
+                break;
+            }
+
+            SetupChain(ChainConfig());
+
+            if (!StartChain()) {
+                err = XRTCError::kChainStartErr;
+                RTC_LOG(LS_WARNING) << "XRTCGallery failed: start chain error";
+                break;
+            }
+
+            // 链路启动之后再接入视频源
+            for (size_t i = 0; i < video_sources_.size(); ++i) {
+                video_sources_[i]->AddConsumer(xrtc_video_sources_[i].get());
+            }
+
+            has_start_ = true;
+
+        } while (false);
+
+        if (XRTCGlobal::Instance()->engine_observer()) {
+            if (err == XRTCError::kNoErr) {
+                XRTCGlobal::Instance()->engine_observer()->OnGallerySuccess(this);
+            }
+            else {
+                XRTCGlobal::Instance()->engine_observer()->OnGalleryFailed(this, err);
+            }
+        }
+    }));
+}
+
+void XRTCGallery::Stop() {
+    RTC_LOG(LS_INFO) << "XRTCGallery Stop call";
+    current_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        RTC_LOG(LS_INFO) << "XRTCGallery Stop PostTask";
+        if (!has_start_) {
+            return;
+        }
+
+        for (size_t i = 0; i < video_sources_.size(); ++i) {
+            video_sources_[i]->RemoveConsumer(xrtc_video_sources_[i].get());
+        }
+        StopChain();
+        has_start_ = false;
+    }));
+}
+
+void XRTCGallery::Update(const std::string& json_config) {
+    RTC_LOG(LS_INFO) << "XRTCGallery Update call";
+    current_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        RTC_LOG(LS_INFO) << "XRTCGallery Update PostTask";
+        if (!has_start_) {
+            return;
+        }
+
+        UpdateChain(json_config);
+    }));
+}
+
+std::string XRTCGallery::GetStats() {
+    return current_thread_->Invoke<std::string>(RTC_FROM_HERE, [=]() {
+        return MediaChain::GetStats();
+    });
+}
+
+// 合成节点使用默认的网格布局，渲染节点的配置以节点名为key
+std::string XRTCGallery::ChainConfig() {
+    JsonObject json_config;
+    JsonObject j_render_sink;
+    j_render_sink["hwnd"] = (long long)render_->canvas();
+    json_config[render_sink_->name()] = j_render_sink;
+    return JsonValue(json_config).ToJson();
+}
+
+void XRTCGallery::Destroy() {
+    RTC_LOG(LS_INFO) << "XRTCGallery Destroy call";
+}
+
+} // namespace xrtc
@@ -0,0 +1,54 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_CHAIN_XRTC_GALLERY_H_
+#define XRTCSDK_XRTC_MEDIA_CHAIN_XRTC_GALLERY_H_
+
+#include <vector>
+
+#include <rtc_base/thread.h>
+
+#include "xrtc/xrtc.h"
+#include "xrtc/device/xrtc_render.h"
+#include "xrtc/media/base/media_chain.h"
+#include "xrtc/media/filter/video_compositor.h"
+#include "xrtc/media/source/xrtc_video_source.h"
+
+namespace xrtc {
+
+// 多路画面预览：多个视频源合成到一个画面，只用一个渲染节点
+// video_source_0 ─┐
+// video_source_1 ─┼─> video_compositor ─> render_sink
+// video_source_n ─┘
+class XRTC_API XRTCGallery : public MediaChain {
+public:
+    ~XRTCGallery();
+
+    void Start() override;
+    void Stop() override;
+    void Destroy() override;
+
+    // 运行中修改布局/输出分辨率/帧率，格式同VideoCompositor的配置
+    void Update(const std::string& json_config);
+
+    // MediaChain
+    std::string GetStats() override;
+
+private:
+    //只允许通过Engine来进行调用
+    XRTCGallery(const std::vector<IVideoSource*>& video_sources, XRTCRender* render);
+
+    std::string ChainConfig();
+
+    friend class XRTCEngine;
+
+private:
+    rtc::Thread* current_thread_;
+    std::vector<IVideoSource*> video_sources_;
+    XRTCRender* render_;
+    std::vector<std::unique_ptr<XRTCVideoSource>> xrtc_video_sources_;
+    std::unique_ptr<VideoCompositor> video_compositor_;
+    std::unique_ptr<MediaObject> render_sink_;
+    bool has_start_ = false;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_CHAIN_XRTC_GALLERY_H_
@@ -5,6 +5,7 @@
 
 #include "xrtc/base/xrtc_global.h"
 #include <xrtc/base/xrtc_json.h>
+#include "xrtc/media/sink/render_sink_factory.h"
 
 namespace xrtc {
     
@@ -13,7 +14,7 @@ XRTCPreview::XRTCPreview(IVideoSource* video_source,XRTCRender* render) :
     video_source_(video_source),
     render_(render),
     xrtc_video_source_(std::make_unique<XRTCVideoSource>()),
-    d3d9_render_sink_(std::make_unique<D3D9RenderSink>())
+    render_sink_(CreateVideoRenderSink())
 {            
 }
 
@@ -42,23 +43,19 @@ void XRTCPreview::Start() {
             video_source_->AddConsumer(xrtc_video_source_.get());
             //将节点加入std::vector<MediaObject*> media_objects_;//存储节点
             AddMediaObject(xrtc_video_source_.get());
-            AddMediaObject(d3d9_render_sink_.get());
+            AddMediaObject(render_sink_.get());
 
-            //将xrtc_video_source_    d3d9_render_sink_链接到一起
-            if (!ConnectMediaObject(xrtc_video_source_.get(), d3d9_render_sink_.get())) {
+            //将xrtc_video_source_    render_sink_链接到一起
+            if (!ConnectMediaObject(xrtc_video_source_.get(), render_sink_.get())) {
                 err = XRTCError::kChainConnectErr;
-                RTC_LOG(LS_WARNING) << "XRTCPreview failed: xrtc_video_source connect d3d9_render_sink error";
+                RTC_LOG(LS_WARNING) << "XRTCPreview failed: xrtc_video_source connect "
+                    << render_sink_->name() << " error";
                 break;
             }
 
-            RTC_LOG(LS_WARNING) << "xrtc_video_source connect d3d9_render_sink success";
+            RTC_LOG(LS_WARNING) << "xrtc_video_source connect " << render_sink_->name() << " success";
 
-            JsonObject json_config;
-            JsonObject j_d3d9_render_sink;
-            j_d3d9_render_sink["hwnd"] = (long long)render_->canvas();
-            json_config["d3d9_render_sink"] = j_d3d9_render_sink;
-
-            SetupChain(JsonValue(json_config).ToJson());
+            SetupChain(RenderConfig(render_sink_.get(), render_));
 
 
             if (!StartChain()) {
@@ -91,13 +88,68 @@ void XRTCPreview::Stop() {
             return;
         }
 
-        // 如果先停止了设备，再停止预览，此处会crash
+        // RemoveConsumer返回后不会再有帧进入链路，之后可以安全停止节点
         video_source_->RemoveConsumer(xrtc_video_source_.get());
         StopChain();
         has_start_ = false;
     }));
 }
 
+void XRTCPreview::Update(const std::string& json_config) {
+    RTC_LOG(LS_INFO) << "XRTCPreview Update call";
+    current_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        RTC_LOG(LS_INFO) << "XRTCPreview Update PostTask";
+        if (!has_start_) {
+            return;
+        }
+
+        UpdateChain(json_config);
+    }));
+}
+
+// 热替换渲染节点：新的sink准备好之后再切换，旧的sink排空后释放
+void XRTCPreview::SetRender(XRTCRender* render) {
+    RTC_LOG(LS_INFO) << "XRTCPreview SetRender call";
+    current_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        RTC_LOG(LS_INFO) << "XRTCPreview SetRender PostTask";
+        if (!render || render == render_) {
+            return;
+        }
+
+        if (!has_start_) {
+            render_ = render;
+            return;
+        }
+
+        std::unique_ptr<MediaObject> render_sink = CreateVideoRenderSink();
+        render_sink->Setup(RenderConfig(render_sink.get(), render));
+        if (!ReplaceMediaObject(render_sink_.get(), render_sink.get())) {
+            RTC_LOG(LS_WARNING) << "XRTCPreview SetRender failed: replace "
+                << render_sink_->name() << " error";
+            return;
+        }
+
+        render_sink_ = std::move(render_sink);
+        render_ = render;
+    }));
+}
+
+// 节点列表只在current_thread_上修改，统计也切到这个线程上汇总
+std::string XRTCPreview::GetStats() {
+    return current_thread_->Invoke<std::string>(RTC_FROM_HERE, [=]() {
+        return MediaChain::GetStats();
+    });
+}
+
+// 渲染节点的配置以节点名为key，窗口句柄沿用hwnd字段
+std::string XRTCPreview::RenderConfig(MediaObject* render_sink, XRTCRender* render) {
+    JsonObject json_config;
+    JsonObject j_render_sink;
+    j_render_sink["hwnd"] = (long long)render->canvas();
+    json_config[render_sink->name()] = j_render_sink;
+    return JsonValue(json_config).ToJson();
+}
+
 void XRTCPreview::Destroy()
 {
     RTC_LOG(LS_INFO) << "XRTCPreview Stop call";
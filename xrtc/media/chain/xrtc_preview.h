@@ -7,7 +7,6 @@
 #include "xrtc/device/xrtc_render.h"
 #include "xrtc/media/base/media_chain.h"
 #include "xrtc/media/source/xrtc_video_source.h"
-#include "xrtc/media/sink/d3d9_render_sink.h"
 
 
 namespace xrtc {
@@ -20,10 +19,19 @@ public:
     void Stop() override;
     void Destroy() override;
 
+    // 预览过程中更新参数/更换渲染窗口，链路不拆除，帧持续流动
+    void Update(const std::string& json_config);
+    void SetRender(XRTCRender* render);
+
+    // MediaChain
+    std::string GetStats() override;
+
 private:
     //只允许通过Engine来进行调用
     XRTCPreview(IVideoSource* video_source,XRTCRender* render);//为了实现渲染，后续实现d3d9获取句柄时创建XRTCRender* render
 
+    std::string RenderConfig(MediaObject* render_sink, XRTCRender* render);
+
     friend class XRTCEngine;
 
 private:
@@ -32,7 +40,7 @@ private:
     XRTCRender* render_;
     //两个节点
     std::unique_ptr<XRTCVideoSource> xrtc_video_source_;
-    std::unique_ptr<D3D9RenderSink> d3d9_render_sink_;
+    std::unique_ptr<MediaObject> render_sink_;//平台相关，由CreateVideoRenderSink创建
     bool has_start_ = false;
 };
 
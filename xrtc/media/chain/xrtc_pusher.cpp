@@ -0,0 +1,1152 @@
+﻿#include "xrtc/media/chain/xrtc_pusher.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <rtc_base/helpers.h>
+#include <rtc_base/ip_address.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/xrtc_global.h"
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/out_pin.h"
+#include "xrtc/rtc/ice_transport.h"
+#include "xrtc/rtc/rtcp_packet.h"
+#include "xrtc/rtc/session_description.h"
+#include "xrtc/rtc/udp_transport.h"
+
+namespace xrtc {
+
+namespace {
+
+const char kUdpScheme[] = "udp://";
+const char kXRTCScheme[] = "xrtc://";
+const char kVideoCodec[] = "H264";
+const char kAudioCodec[] = "opus";
+const char kFrameMarkingUri[] = "urn:ietf:params:rtp-hdrext:framemarking";
+const char kTransportCcUri[] =
+    "http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01";
+
+// 信令的超时比普通请求短，失败时尽快重试，总时长控制在几秒内
+const int kSignalingTimeoutMs = 3000;
+const int kSignalingConnectTimeoutMs = 2000;
+const int kSignalingMaxRetries = 2;
+
+void NotifyPushResult(XRTCPusher* pusher, XRTCError err) {
+    XRTCEngineObserver* observer = XRTCGlobal::Instance()->engine_observer();
+    if (!observer) {
+        return;
+    }
+
+    if (err == XRTCError::kNoErr) {
+        observer->OnPushSuccess(pusher);
+    }
+    else {
+        observer->OnPushFailed(pusher, err);
+    }
+}
+
+std::string UrlEncode(const std::string& str) {
+    static const char kHex[] = "0123456789ABCDEF";
+    std::string result;
+    result.reserve(str.size() * 3);
+    for (unsigned char c : str) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            result += (char)c;
+        }
+        else {
+            result += '%';
+            result += kHex[c >> 4];
+            result += kHex[c & 0xF];
+        }
+    }
+    return result;
+}
+
+std::string UrlDecode(const std::string& str) {
+    std::string result;
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (str[i] == '%' && i + 2 < str.size()) {
+            result += (char)strtol(str.substr(i + 1, 2).c_str(), nullptr, 16);
+            i += 2;
+        }
+        else {
+            result += str[i] == '+' ? ' ' : str[i];
+        }
+    }
+    return result;
+}
+
+// 信令服务器的回复：{"errNo":0,"errMsg":"success","data":{...}}
+bool ParseSignalingResponse(const HttpResponse& response, JsonObject* data) {
+    if (!response.ok()) {
+        return false;
+    }
+
+    JsonValue value;
+    if (!value.FromJson(response.body)) {
+        RTC_LOG(LS_WARNING) << "XRTCPusher invalid signaling response: " << response.body;
+        return false;
+    }
+
+    JsonObject jobject = value.ToObject();
+    if (jobject["errNo"].ToInt(1) != 0) {
+        RTC_LOG(LS_WARNING) << "XRTCPusher signaling error: " << jobject["errMsg"].ToString();
+        return false;
+    }
+
+    *data = jobject["data"].ToObject(JsonObject());
+    return true;
+}
+
+// 把offer中协商的payload type和头扩展写进打包节点的配置，其他配置保持不变
+std::string MergeSinkConfig(const std::string& json_config, int video_pt, int audio_pt,
+    int frame_marking_id, int transport_cc_id)
+{
+    JsonValue value;
+    JsonObject jconfig;
+    if (!json_config.empty() && value.FromJson(json_config)) {
+        jconfig = value.ToObject(JsonObject());
+    }
+
+    JsonObject jsink = jconfig["xrtc_media_sink"].ToObject(JsonObject());
+    jsink["video_pt"] = video_pt;
+    if (audio_pt >= 0) {
+        jsink["audio_pt"] = audio_pt;
+    }
+    jsink["frame_marking_id"] = frame_marking_id;
+    jsink["transport_cc_id"] = transport_cc_id;
+    jconfig["xrtc_media_sink"] = jsink;
+    return JsonValue(jconfig).ToJson();
+}
+
+std::string CandidateToString(const IceCandidate& candidate) {
+    return "a=" + candidate.ToString();
+}
+
+} // namespace
+
+XRTCPusher::XRTCPusher(IAudioSource* audio_source, IVideoSource* video_source) :
+    current_thread_(rtc::Thread::Current()),
+    network_thread_(XRTCGlobal::Instance()->network_thread()),
+    http_manager_(XRTCGlobal::Instance()->http_manager()),
+    audio_source_(audio_source),
+    video_source_(video_source),
+    xrtc_video_source_(std::make_unique<XRTCVideoSource>()),
+    x264_encoder_(std::make_unique<X264EncoderFilter>()),
+    media_sink_(std::make_unique<XRTCMediaSink>(network_thread_)),
+    alive_(std::make_shared<bool>(true))
+{
+    if (audio_source_) {
+        xrtc_audio_source_ = std::make_unique<XRTCAudioSource>();
+        opus_encoder_ = std::make_unique<OpusEncoderFilter>();
+    }
+}
+
+XRTCPusher::~XRTCPusher() {
+    if (transport_) {
+        network_thread_->Invoke<void>(RTC_FROM_HERE, [=]() {
+            ResetTransport();
+        });
+    }
+}
+
+// udp://ip:port，IPv6写成udp://[::1]:port，路径和参数忽略
+bool XRTCPusher::ParseUrl(const std::string& url, rtc::SocketAddress* address) {
+    size_t scheme_len = sizeof(kUdpScheme) - 1;
+    if (url.compare(0, scheme_len, kUdpScheme) != 0) {
+        return false;
+    }
+
+    std::string host_port = url.substr(scheme_len, url.find_first_of("/?", scheme_len) - scheme_len);
+    std::string host;
+    std::string port;
+    if (!host_port.empty() && host_port[0] == '[') {
+        size_t end = host_port.find("]:");
+        if (end == std::string::npos) {
+            return false;
+        }
+        host = host_port.substr(1, end - 1);
+        port = host_port.substr(end + 2);
+    }
+    else {
+        size_t colon = host_port.rfind(':');
+        if (colon == std::string::npos) {
+            return false;
+        }
+        host = host_port.substr(0, colon);
+        port = host_port.substr(colon + 1);
+    }
+
+    char* end = nullptr;
+    long port_num = strtol(port.c_str(), &end, 10);
+    if (port.empty() || *end != '\0' || port_num <= 0 || port_num > 65535) {
+        return false;
+    }
+
+    if (host == "localhost") {
+        host = "127.0.0.1";
+    }
+
+    rtc::IPAddress ip;
+    if (!rtc::IPFromString(host, &ip)) {
+        return false;
+    }
+
+    *address = rtc::SocketAddress(ip, (int)port_num);
+    return true;
+}
+
+// xrtc://host[:port]/push?uid=xxx&streamName=xxx[&secure=0]
+bool XRTCPusher::ParseSignalingUrl(const std::string& url, SignalingUrl* signaling) {
+    size_t scheme_len = sizeof(kXRTCScheme) - 1;
+    if (url.compare(0, scheme_len, kXRTCScheme) != 0) {
+        return false;
+    }
+
+    size_t path = url.find_first_of("/?", scheme_len);
+    std::string host_port = url.substr(scheme_len, path - scheme_len);
+    if (host_port.empty()) {
+        return false;
+    }
+
+    bool secure = true;
+    SignalingUrl result;
+    size_t query = url.find('?');
+    while (query != std::string::npos) {
+        size_t start = query + 1;
+        query = url.find('&', start);
+        std::string param = url.substr(start, query == std::string::npos ? std::string::npos :
+            query - start);
+        size_t eq = param.find('=');
+        std::string key = param.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : UrlDecode(param.substr(eq + 1));
+        if (key == "uid") {
+            result.uid = value;
+        }
+        else if (key == "streamName") {
+            result.stream_name = value;
+        }
+        else if (key == "secure") {
+            secure = value != "0";
+        }
+    }
+
+    if (result.uid.empty() || result.stream_name.empty()) {
+        return false;
+    }
+
+    result.server = (secure ? "https://" : "http://") + host_port;
+    *signaling = result;
+    return true;
+}
+
+void XRTCPusher::StartPush(const std::string& url) {
+    RTC_LOG(LS_INFO) << "XRTCPusher StartPush call, url: " << url;
+    current_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        DoStartPush(url);
+    }));
+}
+
+void XRTCPusher::StopPush() {
+    RTC_LOG(LS_INFO) << "XRTCPusher StopPush call";
+    current_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        DoStopPush();
+    }));
+}
+
+void XRTCPusher::Start() {
+    current_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        // 还没有StartPush过时没有url可用
+        if (url_.empty()) {
+            RTC_LOG(LS_WARNING) << "XRTCPusher Start ignored: no url, call StartPush first";
+            return;
+        }
+        DoStartPush(url_);
+    }));
+}
+
+void XRTCPusher::Stop() {
+    StopPush();
+}
+
+void XRTCPusher::Setup(const std::string& json_config) {
+    current_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        config_ = json_config;
+    }));
+}
+
+void XRTCPusher::Update(const std::string& json_config) {
+    RTC_LOG(LS_INFO) << "XRTCPusher Update call";
+    current_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        if (state_ != PushState::kSendAnswer && state_ != PushState::kPushing) {
+            return;
+        }
+
+        UpdateChain(json_config);
+    }));
+}
+
+XRTCError XRTCPusher::BuildChain() {
+    std::string record_path = ParseRecordPath();
+    FileRecordSink::Format record_format = FileRecordSink::Format::kAnnexB;
+    if (!record_path.empty() && !record_sink_) {
+        if (FileRecordSink::ParseFormat(record_path, &record_format) &&
+            record_format == FileRecordSink::Format::kY4m)
+        {
+            // 编码之后的流没法写成Y4M，不录制，推流照常
+            RTC_LOG(LS_WARNING) << "XRTCPusher record needs .h264/.ivf/.mp4: " << record_path;
+        }
+        else {
+            video_tee_ = std::make_unique<TeeFilter>(
+                x264_encoder_->GetAllOutPins()[0]->format(), 2);
+            record_sink_ = std::make_unique<FileRecordSink>(record_path);
+        }
+    }
+
+    AddMediaObject(xrtc_video_source_.get());
+    AddMediaObject(x264_encoder_.get());
+    if (video_tee_) {
+        AddMediaObject(video_tee_.get());
+    }
+    if (audio_source_) {
+        AddMediaObject(xrtc_audio_source_.get());
+        AddMediaObject(opus_encoder_.get());
+    }
+    AddMediaObject(media_sink_.get());
+    if (record_sink_) {
+        AddMediaObject(record_sink_.get());
+    }
+
+    bool video_connected = ConnectMediaObject(xrtc_video_source_.get(), x264_encoder_.get());
+    if (video_tee_) {
+        video_connected = video_connected &&
+            ConnectMediaObject(x264_encoder_.get(), video_tee_.get()) &&
+            ConnectMediaPin(video_tee_->out_pin(0), media_sink_.get()) &&
+            ConnectMediaPin(video_tee_->out_pin(1), record_sink_.get());
+    }
+    else {
+        video_connected = video_connected &&
+            ConnectMediaObject(x264_encoder_.get(), media_sink_.get());
+    }
+    if (!video_connected) {
+        RTC_LOG(LS_WARNING) << "XRTCPusher failed: video chain connect error";
+        return XRTCError::kChainConnectErr;
+    }
+
+    if (audio_source_ &&
+        (!ConnectMediaObject(xrtc_audio_source_.get(), opus_encoder_.get()) ||
+        !ConnectMediaObject(opus_encoder_.get(), media_sink_.get())))
+    {
+        RTC_LOG(LS_WARNING) << "XRTCPusher failed: audio chain connect error";
+        return XRTCError::kChainConnectErr;
+    }
+
+    chain_built_ = true;
+    return XRTCError::kNoErr;
+}
+
+// 打开传输、启动节点，然后接入源，返回之后第一帧就开始走向网络
+// ICE的检查和链路启动、编码器初始化同时进行，连通之后打包节点才接上传输
+XRTCError XRTCPusher::StartMedia(const rtc::SocketAddress& address,
+    const MediaContent* ice_content, const std::string& json_config)
+{
+    if (!chain_built_) {
+        XRTCError err = BuildChain();
+        if (err != XRTCError::kNoErr) {
+            return err;
+        }
+    }
+
+    IceConfig ice_config = ParseIceConfig();
+    bool dtls_enabled = false;
+    DtlsConfig dtls_config = ParseDtlsConfig(&dtls_enabled);
+    bool bwe_enabled = false;
+    bool probing_enabled = false;
+    BweConfig bwe_config = ParseBweConfig(&bwe_enabled, &probing_enabled);
+    int bwe_start_bps = 0;
+    use_dtls_ = ice_content && dtls_enabled && !ice_content->fingerprint.empty();
+    if (use_dtls_ && !certificate_) {
+        certificate_ = DtlsCertificate::Generate();
+    }
+
+    bool connected = network_thread_->Invoke<bool>(RTC_FROM_HERE, [&]() {
+        ++ice_seq_;
+        handover_keyframes_ = 0;
+        // 只有ICE时才收得到RR
+        use_bwe_ = bwe_enabled && ice_content != nullptr;
+        // 探测要靠接收端的transport-wide cc反馈
+        use_probing_ = use_bwe_ && probing_enabled &&
+            ice_content->FindExtension(kTransportCcUri) > 0;
+        bwe_.SetConfig(bwe_config);
+        probe_controller_.Reset(bwe_config.max_bitrate_bps);
+        bwe_bytes_sent_ = media_sink_->bytes_sent();
+        bwe_report_ms_ = rtc::TimeMillis();
+        bwe_start_bps = use_bwe_ ? bwe_.target_bitrate_bps() : 0;
+        media_sink_->SetTargetBitrate(bwe_start_bps);
+        if (ice_content) {
+            auto ice = std::make_unique<IceTransport>(network_thread_, ice_config, this);
+            ice_transport_ = ice.get();
+            transport_ = std::move(ice);
+            if (use_dtls_) {
+                // 先接上ICE的收包，服务端的ClientHello回复不会丢
+                dtls_transport_ = std::make_unique<DtlsSrtpTransport>(network_thread_,
+                    ice_transport_, certificate_, DtlsRole::kClient, dtls_config, this);
+                if (!certificate_ || !dtls_transport_->SetRemoteFingerprint(
+                    ice_content->fingerprint_algorithm, ice_content->fingerprint))
+                {
+                    ResetTransport();
+                    return false;
+                }
+            }
+
+            else {
+                ice_transport_->SignalReadPacket.connect(this, &XRTCPusher::OnIcePacket);
+            }
+
+            IceParameters remote_parameters;
+            remote_parameters.ufrag = ice_content->ice_ufrag;
+            remote_parameters.pwd = ice_content->ice_pwd;
+            if (!ice_transport_->Start(remote_parameters, ice_content->candidates)) {
+                ResetTransport();
+                return false;
+            }
+            local_ice_parameters_ = ice_transport_->local_parameters();
+            local_candidates_ = ice_transport_->local_candidates();
+            local_address_ = local_candidates_[0].address;
+            return true;
+        }
+
+        // 没有ICE，socket创建成功即认为连通
+        auto udp = std::make_unique<UdpTransport>(network_thread_);
+        if (!udp->Open(address)) {
+            return false;
+        }
+        local_address_ = udp->local_address();
+        transport_ = std::move(udp);
+        media_sink_->SetTransport(transport_.get());
+        return true;
+    });
+    if (!connected) {
+        RTC_LOG(LS_WARNING) << "XRTCPusher failed: open transport error";
+        return XRTCError::kPushIceConnectionErr;
+    }
+
+    SetupChain(json_config);
+    // 起始码率可以低于配置的bitrate，由探测和丢包估计往上调
+    if (bwe_start_bps > 0) {
+        x264_encoder_->SetTargetBitrate(bwe_start_bps);
+    }
+    if (!StartChain()) {
+        RTC_LOG(LS_WARNING) << "XRTCPusher failed: start chain error";
+        StopChain();
+        network_thread_->Invoke<void>(RTC_FROM_HERE, [=]() {
+            ++ice_seq_;
+            ResetTransport();
+        });
+        return XRTCError::kChainStartErr;
+    }
+
+    // 节点都启动之后再接入源，第一帧就能完整地走到网络
+    video_source_->AddConsumer(xrtc_video_source_.get());
+    if (audio_source_) {
+        audio_source_->AddConsumer(xrtc_audio_source_.get());
+    }
+    return XRTCError::kNoErr;
+}
+
+void XRTCPusher::StopMedia() {
+    // RemoveConsumer返回后不会再有帧进入链路
+    video_source_->RemoveConsumer(xrtc_video_source_.get());
+    if (audio_source_) {
+        audio_source_->RemoveConsumer(xrtc_audio_source_.get());
+    }
+    StopChain();
+
+    // 已经投递到网络线程的批次在transport释放之前发完或者丢弃
+    network_thread_->Invoke<void>(RTC_FROM_HERE, [=]() {
+        ++ice_seq_;
+        ResetTransport();
+    });
+}
+
+void XRTCPusher::ResetTransport() {
+    media_sink_->SetTransport(nullptr);
+    dtls_transport_.reset();
+    ice_transport_ = nullptr;
+    transport_.reset();
+}
+
+// "ice": {"stun_servers": ["ip:port"], "aggressive_nomination": true, "include_loopback": false,
+//         "connect_timeout_ms": 10000, "keepalive_interval_ms": 500, "receive_timeout_ms": 1500,
+//         "backup_ping_interval_ms": 2500}
+IceConfig XRTCPusher::ParseIceConfig() const {
+    IceConfig config;
+    JsonValue value;
+    if (config_.empty() || !value.FromJson(config_)) {
+        return config;
+    }
+
+    JsonObject jice = value.ToObject(JsonObject())["ice"].ToObject(JsonObject());
+    JsonArray jservers = jice["stun_servers"].ToArray();
+    for (int i = 0; i < jservers.Size(); ++i) {
+        std::string host_port = jservers[i].ToString("");
+        rtc::SocketAddress server;
+        if (ParseUrl(kUdpScheme + host_port, &server)) {
+            config.stun_servers.push_back(server);
+        }
+        else {
+            RTC_LOG(LS_WARNING) << "XRTCPusher invalid stun server: " << host_port;
+        }
+    }
+    config.aggressive_nomination = jice["aggressive_nomination"].ToBool(
+        config.aggressive_nomination);
+    config.include_loopback = jice["include_loopback"].ToBool(config.include_loopback);
+    config.connect_timeout_ms = jice["connect_timeout_ms"].ToInt(config.connect_timeout_ms);
+    config.keepalive_interval_ms = jice["keepalive_interval_ms"].ToInt(
+        config.keepalive_interval_ms);
+    config.receive_timeout_ms = jice["receive_timeout_ms"].ToInt(config.receive_timeout_ms);
+    config.backup_ping_interval_ms = jice["backup_ping_interval_ms"].ToInt(
+        config.backup_ping_interval_ms);
+    return config;
+}
+
+// "dtls": {"enabled": true, "srtp_profiles": ["SRTP_AEAD_AES_128_GCM", "SRTP_AES128_CM_SHA1_80"],
+//          "handshake_timeout_ms": 10000}
+DtlsConfig XRTCPusher::ParseDtlsConfig(bool* enabled) const {
+    DtlsConfig config;
+    *enabled = true;
+    JsonValue value;
+    if (config_.empty() || !value.FromJson(config_)) {
+        return config;
+    }
+
+    JsonObject jdtls = value.ToObject(JsonObject())["dtls"].ToObject(JsonObject());
+    *enabled = jdtls["enabled"].ToBool(true);
+    JsonArray jprofiles = jdtls["srtp_profiles"].ToArray();
+    std::vector<SrtpProfile> profiles;
+    for (int i = 0; i < jprofiles.Size(); ++i) {
+        SrtpProfile profile = SrtpSession::ProfileFromName(jprofiles[i].ToString(""));
+        if (profile != SrtpProfile::kNone) {
+            profiles.push_back(profile);
+        }
+        else {
+            RTC_LOG(LS_WARNING) << "XRTCPusher invalid srtp profile: " << jprofiles[i].ToString("");
+        }
+    }
+    if (!profiles.empty()) {
+        config.srtp_profiles = profiles;
+    }
+    config.handshake_timeout_ms = jdtls["handshake_timeout_ms"].ToInt(config.handshake_timeout_ms);
+    return config;
+}
+
+// "record": {"path": "xxx.mp4"}，没有配置时不录制
+std::string XRTCPusher::ParseRecordPath() const {
+    JsonValue value;
+    if (config_.empty() || !value.FromJson(config_)) {
+        return "";
+    }
+
+    JsonObject jrecord = value.ToObject(JsonObject())["record"].ToObject(JsonObject());
+    return jrecord["path"].ToString("");
+}
+
+// "bwe": {"enabled": true, "min_bitrate": 100, "start_bitrate": 300, "probing": true}，单位kbps
+BweConfig XRTCPusher::ParseBweConfig(bool* enabled, bool* probing) const {
+    BweConfig config;
+    *enabled = true;
+    *probing = true;
+    JsonValue value;
+    if (config_.empty() || !value.FromJson(config_)) {
+        return config;
+    }
+
+    JsonObject jconfig = value.ToObject(JsonObject());
+    JsonObject jbwe = jconfig["bwe"].ToObject(JsonObject());
+    JsonObject jx264 = jconfig["x264_encoder"].ToObject(JsonObject());
+    *enabled = jbwe["enabled"].ToBool(true);
+    *probing = jbwe["probing"].ToBool(true);
+    config.min_bitrate_bps = (int)jbwe["min_bitrate"].ToInt(config.min_bitrate_bps / 1000) * 1000;
+    config.start_bitrate_bps = (int)jx264["bitrate"].ToInt(config.start_bitrate_bps / 1000) * 1000;
+    config.start_bitrate_bps = (int)jbwe["start_bitrate"].ToInt(config.start_bitrate_bps / 1000) *
+        1000;
+    config.max_bitrate_bps = (int)jx264["max_bitrate"].ToInt(config.max_bitrate_bps / 1000) * 1000;
+    return config;
+}
+
+void XRTCPusher::DoStartPush(const std::string& url) {
+    RTC_LOG(LS_INFO) << "XRTCPusher StartPush PostTask";
+    XRTCError err = XRTCError::kNoErr;
+    rtc::SocketAddress address;
+
+    do {
+        if (state_ != PushState::kIdle) {
+            RTC_LOG(LS_WARNING) << "XRTCPusher already start, ignore";
+            break;
+        }
+
+        if (!video_source_) {
+            err = XRTCError::kPushNoVideoSourceErr;
+            RTC_LOG(LS_WARNING) << "XRTCPusher failed: no video source";
+            break;
+        }
+
+        push_start_ms_ = rtc::TimeMillis();
+        offer_ms_ = 0;
+        answer_ms_ = 0;
+        ice_connected_ms_ = 0;
+        answer_acked_ = false;
+        ice_connected_ = false;
+        dtls_connected_ = false;
+        ice_restarting_ = false;
+        ice_restarts_ = 0;
+        offer_.reset();
+        offer_response_ = HttpResponse();
+
+        // 信令的结果在回复中通知
+        use_signaling_ = ParseSignalingUrl(url, &signaling_);
+        if (use_signaling_) {
+            url_ = url;
+            state_ = PushState::kRequestOffer;
+            bool dtls_enabled = false;
+            ParseDtlsConfig(&dtls_enabled);
+            std::string body = "uid=" + UrlEncode(signaling_.uid) +
+                "&streamName=" + UrlEncode(signaling_.stream_name) +
+                "&audio=" + (audio_source_ ? "1" : "0") + "&video=1&isDtls=" +
+                (dtls_enabled ? "1" : "0");
+            SendSignaling("/signaling/push", body, &XRTCPusher::OnOfferResponse);
+            return;
+        }
+
+        if (!ParseUrl(url, &address)) {
+            err = XRTCError::kPushInvalidUrlErr;
+            RTC_LOG(LS_WARNING) << "XRTCPusher failed: invalid url: " << url;
+            break;
+        }
+
+        err = StartMedia(address, nullptr, config_);
+        if (err != XRTCError::kNoErr) {
+            break;
+        }
+
+        url_ = url;
+        state_ = PushState::kPushing;
+    } while (false);
+
+    NotifyPushResult(this, err);
+}
+
+void XRTCPusher::DoStopPush() {
+    RTC_LOG(LS_INFO) << "XRTCPusher StopPush PostTask";
+    if (state_ == PushState::kIdle) {
+        return;
+    }
+
+    CancelSignaling();
+    if (state_ != PushState::kRequestOffer) {
+        StopMedia();
+        if (use_signaling_) {
+            // 通知服务端释放资源，不等待结果
+            SendSignaling("/signaling/stoppush", "uid=" + UrlEncode(signaling_.uid) +
+                "&streamName=" + UrlEncode(signaling_.stream_name), nullptr);
+        }
+    }
+    state_ = PushState::kIdle;
+
+    if (XRTCGlobal::Instance()->engine_observer()) {
+        XRTCGlobal::Instance()->engine_observer()->OnPushStopped(this);
+    }
+}
+
+void XRTCPusher::FailPush(XRTCError err) {
+    CancelSignaling();
+    if (state_ != PushState::kRequestOffer) {
+        StopMedia();
+    }
+    state_ = PushState::kIdle;
+    NotifyPushResult(this, err);
+}
+
+void XRTCPusher::SendSignaling(const std::string& path, const std::string& body,
+    void (XRTCPusher::*handler)(const HttpResponse&))
+{
+    HttpRequest request;
+    request.url = signaling_.server + path;
+    request.body = body;
+    request.headers.push_back("Content-Type: application/x-www-form-urlencoded");
+    request.timeout_ms = kSignalingTimeoutMs;
+    request.connect_timeout_ms = kSignalingConnectTimeoutMs;
+    request.max_retries = kSignalingMaxRetries;
+    if (!handler) {
+        http_manager_->Send(request, nullptr);
+        return;
+    }
+
+    int seq = ++signaling_seq_;
+    std::weak_ptr<bool> alive = alive_;
+    rtc::Thread* thread = current_thread_;
+    signaling_request_id_ = http_manager_->Send(request, [=](const HttpResponse& response) {
+        thread->PostTask(webrtc::ToQueuedTask([=]() {
+            if (alive.expired() || seq != signaling_seq_) {
+                return;
+            }
+            signaling_request_id_ = 0;
+            (this->*handler)(response);
+        }));
+    });
+}
+
+// 在network_thread上取消，返回之后network_thread上不会再有这个请求的回调
+void XRTCPusher::CancelSignaling() {
+    ++signaling_seq_;
+    if (signaling_request_id_ == 0) {
+        return;
+    }
+
+    int64_t id = signaling_request_id_;
+    signaling_request_id_ = 0;
+    network_thread_->Invoke<void>(RTC_FROM_HERE, [=]() {
+        http_manager_->Cancel(id);
+    });
+}
+
+void XRTCPusher::OnOfferResponse(const HttpResponse& response) {
+    offer_ms_ = rtc::TimeMillis() - push_start_ms_;
+    offer_response_ = response;
+    offer_response_.body.clear();
+    RTC_LOG(LS_INFO) << "XRTCPusher offer response, status: " << response.status
+        << ", elapsed: " << response.elapsed_ms << "ms, attempts: " << response.attempts
+        << ", reused connection: " << response.reused_connection;
+
+    JsonObject jdata;
+    if (!ParseSignalingResponse(response, &jdata)) {
+        FailPush(XRTCError::kPushRequestOfferErr);
+        return;
+    }
+
+    std::string error;
+    std::unique_ptr<SessionDescription> offer = SessionDescription::Parse("offer",
+        jdata["sdp"].ToString(""), &error);
+    if (!offer) {
+        RTC_LOG(LS_WARNING) << "XRTCPusher failed: invalid offer, " << error;
+        FailPush(XRTCError::kPushRequestOfferErr);
+        return;
+    }
+
+    // 音视频bundle在同一个传输上，地址和ICE参数取视频的m=段
+    const MediaContent* video = offer->FindContent("video");
+    const MediaContent* audio = offer->FindContent("audio");
+    int video_pt = video ? video->FindPayloadType(kVideoCodec) : -1;
+    int audio_pt = audio && audio_source_ ? audio->FindPayloadType(kAudioCodec) : -1;
+    bool use_ice = video && !video->ice_ufrag.empty();
+    rtc::IPAddress ip;
+    if (video_pt < 0 ||
+        (!use_ice && (video->port <= 0 || !rtc::IPFromString(video->connection_ip, &ip))))
+    {
+        RTC_LOG(LS_WARNING) << "XRTCPusher failed: offer has no usable H264 video";
+        FailPush(XRTCError::kPushRequestOfferErr);
+        return;
+    }
+
+    XRTCError err = StartMedia(rtc::SocketAddress(ip, video->port), use_ice ? video : nullptr,
+        MergeSinkConfig(config_, video_pt, audio_pt, video->FindExtension(kFrameMarkingUri),
+        video->FindExtension(kTransportCcUri)));
+    if (err != XRTCError::kNoErr) {
+        state_ = PushState::kIdle;
+        NotifyPushResult(this, err);
+        return;
+    }
+
+    // 没有ICE时socket打开即可发送
+    ice_connected_ = !use_ice;
+    dtls_connected_ = !use_dtls_;
+    state_ = PushState::kSendAnswer;
+    std::unique_ptr<SessionDescription> answer = CreateAnswer(*offer, video_pt, audio_pt);
+    SendSignaling("/signaling/sendanswer", "uid=" + UrlEncode(signaling_.uid) +
+        "&streamName=" + UrlEncode(signaling_.stream_name) +
+        "&answer=" + UrlEncode(answer->ToString()) + "&type=push",
+        &XRTCPusher::OnAnswerResponse);
+    offer_ = std::move(offer);
+    video_pt_ = video_pt;
+    audio_pt_ = audio_pt;
+}
+
+void XRTCPusher::OnAnswerResponse(const HttpResponse& response) {
+    answer_ms_ = rtc::TimeMillis() - push_start_ms_;
+    JsonObject jdata;
+    if (!ParseSignalingResponse(response, &jdata)) {
+        FailPush(XRTCError::kPushRequestOfferErr);
+        return;
+    }
+
+    answer_acked_ = true;
+    MaybePushSuccess();
+}
+
+void XRTCPusher::MaybePushSuccess() {
+    if (state_ != PushState::kSendAnswer || !answer_acked_ || !ice_connected_ ||
+        !dtls_connected_)
+    {
+        return;
+    }
+
+    state_ = PushState::kPushing;
+    NotifyPushResult(this, XRTCError::kNoErr);
+}
+
+// 新的本地ufrag/pwd随answer发给服务端，服务端回复新的offer后重新检查；socket和链路都保留，
+// 检查期间的帧在打包节点丢弃
+void XRTCPusher::StartIceRestart() {
+    ice_restarting_ = true;
+    ++ice_restarts_;
+    RTC_LOG(LS_INFO) << "XRTCPusher ice restart, count: " << ice_restarts_;
+
+    network_thread_->Invoke<void>(RTC_FROM_HERE, [=]() {
+        local_ice_parameters_ = ice_transport_->PrepareRestart();
+        local_candidates_ = ice_transport_->local_candidates();
+    });
+    std::unique_ptr<SessionDescription> answer = CreateAnswer(*offer_, video_pt_, audio_pt_);
+    SendSignaling("/signaling/icerestart", "uid=" + UrlEncode(signaling_.uid) +
+        "&streamName=" + UrlEncode(signaling_.stream_name) +
+        "&answer=" + UrlEncode(answer->ToString()) + "&type=push",
+        &XRTCPusher::OnIceRestartResponse);
+}
+
+void XRTCPusher::OnIceRestartResponse(const HttpResponse& response) {
+    ice_restarting_ = false;
+    JsonObject jdata;
+    std::string error;
+    std::unique_ptr<SessionDescription> offer;
+    if (ParseSignalingResponse(response, &jdata)) {
+        offer = SessionDescription::Parse("offer", jdata["sdp"].ToString(""), &error);
+    }
+    const MediaContent* video = offer ? offer->FindContent("video") : nullptr;
+    if (!video || video->ice_ufrag.empty()) {
+        RTC_LOG(LS_WARNING) << "XRTCPusher failed: invalid ice restart offer, " << error;
+        FailPush(XRTCError::kPushIceConnectionErr);
+        return;
+    }
+
+    IceParameters remote_parameters;
+    remote_parameters.ufrag = video->ice_ufrag;
+    remote_parameters.pwd = video->ice_pwd;
+    network_thread_->Invoke<void>(RTC_FROM_HERE, [&]() {
+        if (ice_transport_) {
+            ice_transport_->Restart(remote_parameters, video->candidates);
+        }
+    });
+    offer_ = std::move(offer);
+}
+
+void XRTCPusher::OnIceCandidate(const IceCandidate& candidate) {
+    PostIceTask([=]() {
+        if (state_ != PushState::kSendAnswer && state_ != PushState::kPushing) {
+            return;
+        }
+
+        // trickle，不等待结果
+        SendSignaling("/signaling/sendcandidate", "uid=" + UrlEncode(signaling_.uid) +
+            "&streamName=" + UrlEncode(signaling_.stream_name) +
+            "&candidate=" + UrlEncode(CandidateToString(candidate)) + "&type=push", nullptr);
+    });
+}
+
+void XRTCPusher::OnIceStateChanged(IceTransportState state) {
+    if (state == IceTransportState::kConnected) {
+        // 直接在network_thread上接入打包节点，关键帧由OnIceRouteChanged决定；
+        // 有DTLS时等握手完成再接入，之后ICE的断开和恢复不影响SRTP
+        if (!dtls_transport_) {
+            media_sink_->SetTransport(ice_transport_);
+        }
+        else {
+            dtls_transport_->Start();
+        }
+    }
+
+    PostIceTask([=]() {
+        if (state == IceTransportState::kConnected && !ice_connected_) {
+            ice_connected_ = true;
+            ice_connected_ms_ = rtc::TimeMillis() - push_start_ms_;
+            MaybePushSuccess();
+        }
+        else if (state == IceTransportState::kDisconnected && state_ == PushState::kPushing &&
+            !ice_restarting_)
+        {
+            StartIceRestart();
+        }
+        else if (state == IceTransportState::kFailed &&
+            (state_ == PushState::kSendAnswer || state_ == PushState::kPushing))
+        {
+            RTC_LOG(LS_WARNING) << "XRTCPusher failed: ice connection error";
+            FailPush(XRTCError::kPushIceConnectionErr);
+        }
+    });
+}
+
+// 第一次连通之前的帧都被丢弃了；切换路径时只有旧路径已经中断才需要关键帧，
+// 切到更好的路径时对端连续收包，不浪费码率。新路径的带宽未知，和开始推流一样重新探测
+void XRTCPusher::OnIceRouteChanged(const IceRouteChange& change) {
+    if (change.initial) {
+        if (!dtls_transport_) {
+            x264_encoder_->RequestKeyFrame();
+        }
+        if (use_probing_) {
+            SendProbes(probe_controller_.OnStart(bwe_.target_bitrate_bps()));
+        }
+        return;
+    }
+
+    RTC_LOG(LS_INFO) << "XRTCPusher ice route changed, media lost: " << change.media_lost
+        << ", gap: " << change.gap_ms << " ms";
+    if (use_probing_) {
+        SendProbes(probe_controller_.OnRouteChanged(bwe_.target_bitrate_bps()));
+    }
+    if (change.media_lost) {
+        ++handover_keyframes_;
+        x264_encoder_->RequestKeyFrame();
+    }
+}
+
+// 握手完成之前的帧在打包节点丢弃，接入之后从关键帧开始
+void XRTCPusher::OnDtlsStateChanged(DtlsState state) {
+    if (state == DtlsState::kConnected) {
+        media_sink_->SetTransport(dtls_transport_.get());
+        x264_encoder_->RequestKeyFrame();
+    }
+
+    PostIceTask([=]() {
+        if (state == DtlsState::kConnected && !dtls_connected_) {
+            dtls_connected_ = true;
+            MaybePushSuccess();
+        }
+        else if ((state == DtlsState::kFailed || state == DtlsState::kClosed) &&
+            (state_ == PushState::kSendAnswer || state_ == PushState::kPushing))
+        {
+            RTC_LOG(LS_WARNING) << "XRTCPusher failed: dtls error";
+            FailPush(XRTCError::kPushDtlsErr);
+        }
+    });
+}
+
+void XRTCPusher::OnRtcpPacket(uint8_t* data, size_t size) {
+    OnRtcp(data, size);
+}
+
+void XRTCPusher::OnIcePacket(const uint8_t* data, size_t size) {
+    if (IsRtcpPacket(data, size)) {
+        OnRtcp(data, size);
+    }
+}
+
+// 只处理视频流的关键帧请求和接收报告，以及transport-wide cc反馈
+void XRTCPusher::OnRtcp(const uint8_t* data, size_t size) {
+    RtcpFeedback feedback;
+    ParseRtcp(data, size, &feedback);
+    uint32_t video_ssrc = media_sink_->video_ssrc();
+    int64_t rtt_ms = ice_transport_ ? ice_transport_->rtt_ms() : -1;
+    for (const RtcpKeyFrameRequest& request : feedback.keyframe_requests) {
+        if (request.media_ssrc == video_ssrc) {
+            x264_encoder_->OnKeyFrameRequest(request, rtt_ms);
+        }
+    }
+
+    for (const RtcpReportBlock& block : feedback.report_blocks) {
+        if (!use_bwe_ || block.media_ssrc != video_ssrc) {
+            continue;
+        }
+
+        int64_t now = rtc::TimeMillis();
+        int64_t bytes_sent = media_sink_->bytes_sent();
+        int send_bitrate_bps = now > bwe_report_ms_ ?
+            (int)((bytes_sent - bwe_bytes_sent_) * 8 * 1000 / (now - bwe_report_ms_)) : 0;
+        bwe_bytes_sent_ = bytes_sent;
+        bwe_report_ms_ = now;
+        bool changed = bwe_.OnReportBlock(block.fraction_lost, rtt_ms, send_bitrate_bps, now);
+        if (use_probing_) {
+            SendProbes(probe_controller_.OnEstimate(bwe_.target_bitrate_bps(), bwe_.congested(),
+                bwe_.sustained_loss(), now));
+        }
+        if (changed) {
+            SetBweTargetBitrate(bwe_.target_bitrate_bps());
+        }
+    }
+
+    for (const RtcpTransportFeedback& transport_feedback : feedback.transport_feedbacks) {
+        ProbeResult result;
+        if (!use_probing_ || !media_sink_->OnTransportFeedback(transport_feedback, &result)) {
+            continue;
+        }
+
+        RTC_LOG(LS_INFO) << "XRTCPusher probe cluster " << result.cluster_id << " result: "
+            << result.bitrate_bps << " bps";
+        SendProbes(probe_controller_.OnProbeResult(result.cluster_id, result.bitrate_bps));
+        if (bwe_.OnProbeResult(result.bitrate_bps, rtc::TimeMillis())) {
+            SetBweTargetBitrate(bwe_.target_bitrate_bps());
+        }
+    }
+}
+
+// 打包节点立即按新的码率丢帧，编码器下一帧开始调整
+void XRTCPusher::SetBweTargetBitrate(int bitrate_bps) {
+    media_sink_->SetTargetBitrate(bitrate_bps);
+    x264_encoder_->SetTargetBitrate(bitrate_bps);
+}
+
+void XRTCPusher::SendProbes(const std::vector<ProbeCluster>& clusters) {
+    for (const ProbeCluster& cluster : clusters) {
+        RTC_LOG(LS_INFO) << "XRTCPusher probe cluster " << cluster.id << " at "
+            << cluster.bitrate_bps << " bps";
+        media_sink_->SendProbe(cluster);
+    }
+}
+
+// 在network_thread上取序号，传输重建之后旧的回调丢弃
+void XRTCPusher::PostIceTask(std::function<void()> task) {
+    int seq = ice_seq_;
+    std::weak_ptr<bool> alive = alive_;
+    current_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        if (alive.expired() || seq != ice_seq_) {
+            return;
+        }
+        task();
+    }));
+}
+
+// 按offer的m=段顺序回复，没有音频源时拒绝音频(端口为0)
+std::unique_ptr<SessionDescription> XRTCPusher::CreateAnswer(const SessionDescription& offer,
+    int video_pt, int audio_pt)
+{
+    auto answer = std::make_unique<SessionDescription>();
+    answer->type = "answer";
+    answer->bundle = offer.bundle;
+    std::string cname = rtc::CreateRandomString(16);
+
+    for (const MediaContent& offer_content : offer.contents) {
+        MediaContent content;
+        content.media = offer_content.media;
+        content.protocol = offer_content.protocol;
+        content.mid = offer_content.mid;
+        content.rtcp_mux = offer_content.rtcp_mux;
+        content.connection_ip = local_address_.ipaddr().ToString();
+        content.cname = cname;
+        if (ice_transport_) {
+            content.ice_ufrag = local_ice_parameters_.ufrag;
+            content.ice_pwd = local_ice_parameters_.pwd;
+            content.ice_options.push_back("trickle");
+            content.candidates = local_candidates_;
+        }
+        if (use_dtls_) {
+            content.fingerprint_algorithm = "sha-256";
+            content.fingerprint = certificate_->fingerprint();
+            content.setup = "active";
+        }
+
+        bool is_video = offer_content.media == "video";
+        int pt = is_video ? video_pt : (offer_content.media == "audio" ? audio_pt : -1);
+        if (pt < 0) {
+            content.port = 0;
+            content.direction = "inactive";
+            content.payload_types = offer_content.payload_types;
+        }
+        else {
+            content.port = local_address_.port();
+            content.direction = "sendonly";
+            content.payload_types.push_back(pt);
+            content.rtpmap[pt] = offer_content.rtpmap.at(pt);
+            auto fmtp = offer_content.fmtp.find(pt);
+            if (fmtp != offer_content.fmtp.end()) {
+                content.fmtp[pt] = fmtp->second;
+            }
+            content.ssrcs.push_back(is_video ? media_sink_->video_ssrc() :
+                media_sink_->audio_ssrc());
+            int frame_marking_id = offer_content.FindExtension(kFrameMarkingUri);
+            if (is_video && frame_marking_id > 0) {
+                content.extmap[frame_marking_id] = kFrameMarkingUri;
+            }
+            int transport_cc_id = offer_content.FindExtension(kTransportCcUri);
+            if (is_video && transport_cc_id > 0) {
+                content.extmap[transport_cc_id] = kTransportCcUri;
+            }
+        }
+        answer->contents.push_back(content);
+    }
+    return answer;
+}
+
+// 节点列表只在current_thread_上修改，统计也切到这个线程上汇总
+std::string XRTCPusher::GetStats() {
+    return current_thread_->Invoke<std::string>(RTC_FROM_HERE, [=]() {
+        std::string stats = MediaChain::GetStats();
+        JsonValue value;
+        if (!value.FromJson(stats)) {
+            return stats;
+        }
+
+        static const char* const kStateNames[] = {
+            "idle", "request_offer", "send_answer", "pushing"
+        };
+        int64_t first_send_ms = media_sink_->first_send_time_ms();
+        JsonObject jpush;
+        jpush["state"] = kStateNames[(int)state_];
+        jpush["signaling"] = use_signaling_;
+        jpush["offer_ms"] = offer_ms_;
+        jpush["offer_attempts"] = offer_response_.attempts;
+        jpush["offer_reused_connection"] = offer_response_.reused_connection;
+        jpush["offer_dns_us"] = offer_response_.dns_us;
+        jpush["offer_connect_us"] = offer_response_.connect_us;
+        jpush["offer_tls_us"] = offer_response_.tls_us;
+        jpush["answer_ms"] = answer_ms_;
+        jpush["ice_connected_ms"] = ice_connected_ms_;
+        jpush["ice_restarts"] = ice_restarts_;
+        jpush["time_to_first_media_ms"] = first_send_ms >= push_start_ms_ && push_start_ms_ > 0 ?
+            first_send_ms - push_start_ms_ : 0;
+
+        if (ice_transport_) {
+            JsonObject jice;
+            network_thread_->Invoke<void>(RTC_FROM_HERE, [&]() {
+                if (ice_transport_) {
+                    ice_transport_->GetStats(jice);
+                    jice["handover_keyframes"] = handover_keyframes_;
+                }
+            });
+            jpush["ice"] = jice;
+        }
+
+        if (use_dtls_) {
+            JsonObject jdtls;
+            network_thread_->Invoke<void>(RTC_FROM_HERE, [&]() {
+                if (dtls_transport_) {
+                    dtls_transport_->GetStats(jdtls);
+                }
+            });
+            jpush["dtls"] = jdtls;
+        }
+
+        JsonObject jbwe;
+        network_thread_->Invoke<void>(RTC_FROM_HERE, [&]() {
+            jbwe["enabled"] = use_bwe_;
+            jbwe["probing"] = use_probing_;
+            bwe_.GetStats(jbwe);
+            probe_controller_.GetStats(jbwe);
+            media_sink_->GetProbeStats(jbwe);
+        });
+        jpush["bwe"] = jbwe;
+
+        JsonObject jstats = value.ToObject();
+        jstats["push"] = jpush;
+        return JsonValue(jstats).ToJson();
+    });
+}
+
+void XRTCPusher::Destroy() {
+    RTC_LOG(LS_INFO) << "XRTCPusher Destroy call";
+    current_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        DoStopPush();
+        delete this;
+    }));
+}
+
+} // namespace xrtc
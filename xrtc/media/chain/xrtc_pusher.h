@@ -0,0 +1,200 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_CHAIN_XRTC_PUSHER_H_
+#define XRTCSDK_XRTC_MEDIA_CHAIN_XRTC_PUSHER_H_
+
+#include <functional>
+#include <vector>
+
+#include <rtc_base/socket_address.h>
+#include <rtc_base/third_party/sigslot/sigslot.h>
+#include <rtc_base/thread.h>
+
+#include "xrtc/xrtc.h"
+#include "xrtc/base/http_manager.h"
+#include "xrtc/media/base/media_chain.h"
+#include "xrtc/media/filter/opus_encoder_filter.h"
+#include "xrtc/media/filter/tee_filter.h"
+#include "xrtc/media/filter/x264_encoder_filter.h"
+#include "xrtc/media/sink/file_record_sink.h"
+#include "xrtc/media/sink/xrtc_media_sink.h"
+#include "xrtc/media/source/xrtc_audio_source.h"
+#include "xrtc/media/source/xrtc_video_source.h"
+#include "xrtc/rtc/dtls_srtp_transport.h"
+#include "xrtc/rtc/ice_transport.h"
+#include "xrtc/rtc/loss_based_bwe.h"
+#include "xrtc/rtc/probe_controller.h"
+
+namespace xrtc {
+
+struct MediaContent;
+struct SessionDescription;
+
+// 推流：采集、编码、RTP打包后在network_thread上发送，音频可选
+// video_source ─> x264_encoder ─┐
+//                               ├─> xrtc_media_sink ─> transport(network_thread)
+// audio_source ─> opus_encoder ─┘
+// 配置了"record"时视频编码输出经tee_filter分叉，同一帧同时交给file_record_sink写盘：
+// x264_encoder ─> tee_filter ─┬─> xrtc_media_sink
+//                             └─> file_record_sink
+//   "record": {"path": "xxx.mp4"}，格式按扩展名(.h264/.264/.ivf/.mp4)，只录视频，
+//   写盘参数见FileRecordSink的"file_record"配置；第一次推流建链时生效，之后的推流复用同一个文件
+// url:
+// udp://ip:port，RTP直接发到该地址(本机回环/内网)，不经过信令
+// xrtc://host[:port]/push?uid=xxx&streamName=xxx，通过信令服务器(HTTPS)向服务端请求offer，
+//   回复answer后开始发送，secure=0时使用HTTP(本地测试)
+//   offer带ice-ufrag时走ICE：收到offer立即开始收集和检查，answer带上host候选马上发出，
+//   srflx候选收集到后再通过/signaling/sendcandidate补发；链路和编码同时启动，ICE连通之前的帧丢弃，
+//   连通时请求关键帧。answer确认并且ICE连通之后才通知推流成功
+//   推流中路径中断时ICE先切到备用候选对，没有备用时通过/signaling/icerestart重启ICE，编码和打包不停，
+//   只有中断期间的媒体丢失时才请求关键帧
+//   offer带a=fingerprint时在ICE之上做DTLS-SRTP(推流端为active)，握手完成之后才接入打包节点并请求关键帧，
+//   推流成功还要等DTLS连通
+//   接收端的PLI/FIR(ICE收到的RTCP，DTLS时为解密后的SRTCP)交给编码节点，按RTT合并和限频
+//   RR中视频流的丢包率输入带宽估计(LossBasedBwe)，目标码率同时交给编码节点和打包节点：
+//   编码器的码率控制跟上之前，打包节点按时域层丢帧(x264_encoder的temporal_layers)
+//   offer带frame marking的a=extmap时answer回复同样的id，视频包带上分层信息
+//   offer带transport-wide cc的a=extmap时视频包带传输层序号，按接收端的反馈做带宽探测(ProbeController)：
+//   ICE连通后第一个视频批次发出时，以及路径切换、拥塞恢复之后，打包节点按探测码率发送填充包，
+//   探测结果直接抬高目标码率，起始码率较低时也能在一两秒内用满链路
+//   "bwe": {"enabled": true, "min_bitrate": 100, "start_bitrate": 300, "probing": true}，单位kbps，
+//   起始码率默认取x264_encoder的bitrate，最大码率取x264_encoder的max_bitrate
+class XRTC_API XRTCPusher : public MediaChain, public IceTransportObserver,
+    public DtlsSrtpObserver, public sigslot::has_slots<>
+{
+public:
+    ~XRTCPusher();
+
+    // 结果通过XRTCEngineObserver::OnPushSuccess/OnPushFailed通知
+    void StartPush(const std::string& url);
+    void StopPush();
+
+    // 编码/打包参数，格式同各节点的配置，StartPush之前调用
+    void Setup(const std::string& json_config);
+    // 推流过程中更新参数(例如码率)，链路不拆除
+    void Update(const std::string& json_config);
+
+    // MediaChain
+    void Start() override;//使用上一次StartPush的url，没有调用过StartPush时忽略
+    void Stop() override;//同StopPush
+    void Destroy() override;
+    std::string GetStats() override;
+
+private:
+    //只允许通过Engine来进行调用
+    XRTCPusher(IAudioSource* audio_source, IVideoSource* video_source);
+
+    enum class PushState {
+        kIdle,
+        kRequestOffer,//等待信令服务器返回offer
+        kSendAnswer,//媒体链路已经启动，等待answer的确认和ICE连通
+        kPushing,
+    };
+
+    struct SignalingUrl {
+        std::string server;//https://host:port
+        std::string uid;
+        std::string stream_name;
+    };
+
+    static bool ParseUrl(const std::string& url, rtc::SocketAddress* address);
+    static bool ParseSignalingUrl(const std::string& url, SignalingUrl* signaling);
+    XRTCError BuildChain();
+    // ice_content非空时通过ICE连接，address不使用
+    XRTCError StartMedia(const rtc::SocketAddress& address, const MediaContent* ice_content,
+        const std::string& json_config);
+    IceConfig ParseIceConfig() const;
+    DtlsConfig ParseDtlsConfig(bool* enabled) const;
+    BweConfig ParseBweConfig(bool* enabled, bool* probing) const;
+    std::string ParseRecordPath() const;
+    void StopMedia();
+    void ResetTransport();//在network_thread上调用
+    void DoStartPush(const std::string& url);
+    void DoStopPush();
+    void FailPush(XRTCError err);
+
+    // 信令请求，回复切回current_thread_处理，推流停止或者对象销毁之后的回复直接丢弃
+    void SendSignaling(const std::string& path, const std::string& body,
+        void (XRTCPusher::*handler)(const HttpResponse&));
+    void CancelSignaling();
+    void OnOfferResponse(const HttpResponse& response);
+    void OnAnswerResponse(const HttpResponse& response);
+    void MaybePushSuccess();
+    void StartIceRestart();
+    void OnIceRestartResponse(const HttpResponse& response);
+
+    // IceTransportObserver，在network_thread上回调，切回current_thread_处理
+    void OnIceCandidate(const IceCandidate& candidate) override;
+    void OnIceStateChanged(IceTransportState state) override;
+    void OnIceRouteChanged(const IceRouteChange& change) override;
+    // DtlsSrtpObserver，在network_thread上回调
+    void OnDtlsStateChanged(DtlsState state) override;
+    void OnRtcpPacket(uint8_t* data, size_t size) override;
+    // 没有DTLS时ICE收到的非STUN包，在network_thread上回调
+    void OnIcePacket(const uint8_t* data, size_t size);
+    void OnRtcp(const uint8_t* data, size_t size);
+    // 在network_thread上调用
+    void SetBweTargetBitrate(int bitrate_bps);
+    void SendProbes(const std::vector<ProbeCluster>& clusters);
+    void PostIceTask(std::function<void()> task);
+    std::unique_ptr<SessionDescription> CreateAnswer(const SessionDescription& offer,
+        int video_pt, int audio_pt);
+
+    friend class XRTCEngine;
+
+private:
+    rtc::Thread* current_thread_;
+    rtc::Thread* network_thread_;
+    HttpManager* http_manager_;
+    IAudioSource* audio_source_;
+    IVideoSource* video_source_;
+    std::string url_;
+    std::string config_;
+    std::unique_ptr<XRTCVideoSource> xrtc_video_source_;
+    std::unique_ptr<X264EncoderFilter> x264_encoder_;
+    std::unique_ptr<XRTCAudioSource> xrtc_audio_source_;
+    std::unique_ptr<OpusEncoderFilter> opus_encoder_;
+    std::unique_ptr<XRTCMediaSink> media_sink_;
+    std::unique_ptr<TeeFilter> video_tee_;//录制时才创建
+    std::unique_ptr<FileRecordSink> record_sink_;
+    std::unique_ptr<RtpTransport> transport_;//只在network_thread上创建和释放
+    IceTransport* ice_transport_ = nullptr;//transport_是ICE时指向它
+    std::unique_ptr<DtlsSrtpTransport> dtls_transport_;//在transport_之上，先于它释放
+    std::shared_ptr<DtlsCertificate> certificate_;//第一次使用DTLS时生成，之后复用
+    int ice_seq_ = 0;//只在network_thread上修改(current_thread_阻塞在Invoke中)，过期的ICE回调按序号丢弃
+    rtc::SocketAddress local_address_;
+    IceParameters local_ice_parameters_;
+    std::vector<IceCandidate> local_candidates_;//answer中的host候选
+    bool answer_acked_ = false;
+    bool ice_connected_ = false;
+    bool use_dtls_ = false;
+    bool dtls_connected_ = false;
+    bool ice_restarting_ = false;
+    int ice_restarts_ = 0;
+    int handover_keyframes_ = 0;//只在network_thread上访问
+    LossBasedBwe bwe_;//只在network_thread上访问
+    bool use_bwe_ = false;//StartMedia时在network_thread上设置
+    int64_t bwe_bytes_sent_ = 0;//上一个RR时打包节点发出的字节数，只在network_thread上访问
+    int64_t bwe_report_ms_ = 0;
+    ProbeController probe_controller_;//只在network_thread上访问
+    bool use_probing_ = false;//StartMedia时在network_thread上设置
+    std::unique_ptr<SessionDescription> offer_;//重启ICE时按它重新生成answer
+    int video_pt_ = -1;
+    int audio_pt_ = -1;
+    bool chain_built_ = false;//节点只连接一次，重新推流时复用
+    PushState state_ = PushState::kIdle;
+    bool use_signaling_ = false;
+    SignalingUrl signaling_;
+    int64_t signaling_request_id_ = 0;
+    int signaling_seq_ = 0;//每次发起或者取消请求加一，过期的回复按序号丢弃
+    std::shared_ptr<bool> alive_;//回复的任务持有弱引用，对象销毁之后不再访问
+
+    // 首帧耗时的分解：请求offer、确认answer、第一个RTP包交给socket，都从StartPush开始计算
+    int64_t push_start_ms_ = 0;
+    int64_t offer_ms_ = 0;
+    int64_t answer_ms_ = 0;
+    int64_t ice_connected_ms_ = 0;
+    HttpResponse offer_response_;//offer请求的连接耗时，用于判断是否复用了连接
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_CHAIN_XRTC_PUSHER_H_
@@ -0,0 +1,379 @@
+﻿#include "xrtc/media/filter/opus_encoder_filter.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include <opus/opus.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/in_pin.h"
+#include "xrtc/media/base/out_pin.h"
+
+namespace xrtc {
+
+namespace {
+
+// 一个Opus包的上限是1275字节，按MTU留余量
+const int kMaxPacketBytes = 1500;
+// 只有TOC的包(<=2字节)是DTX静音帧，不需要发送
+const int kDtxPacketBytes = 2;
+// 丢包率的平滑系数，和RTCP的反馈间隔(约1s)相当
+const float kLossSmoothing = 0.2f;
+// FEC开关的滞回区间，避免在阈值附近来回切换
+const float kFecEnableLoss = 0.02f;
+const float kFecDisableLoss = 0.01f;
+// 码率太低时LBRR挤占主编码的码率，得不偿失
+const int kMinFecBitrate = 12000;
+const int kMaxLossPerc = 50;
+
+bool IsOpusSampleRate(int sample_rate) {
+    return sample_rate == 8000 || sample_rate == 12000 || sample_rate == 16000 ||
+        sample_rate == 24000 || sample_rate == 48000;
+}
+
+} // namespace
+
+OpusEncoderFilter::OpusEncoderFilter() :
+    MediaObject(NodeExecutor::kAudioPool),
+    in_pin_(std::make_unique<InPin>(this)),
+    out_pin_(std::make_unique<OutPin>(this)),
+    packet_pool_(kMaxPacketBytes)
+{
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeAudio;
+    fmt.sub_fmt.audio_fmt.type = SubMediaType::kSubTypePcm;
+    in_pin_->set_format(fmt);
+
+    fmt.sub_fmt.audio_fmt.type = SubMediaType::kSubTypeOpus;
+    out_pin_->set_format(fmt);
+}
+
+OpusEncoderFilter::~OpusEncoderFilter() {
+    task_queue()->Stop();
+    DestroyEncoder();
+}
+
+bool OpusEncoderFilter::Start() {
+    return true;
+}
+
+void OpusEncoderFilter::Setup(const std::string& json_config) {
+    ParseConfig(json_config);
+}
+
+void OpusEncoderFilter::Update(const std::string& json_config) {
+    if (ParseConfig(json_config)) {
+        RTC_LOG(LS_INFO) << "OpusEncoderFilter Update: " << json_config;
+    }
+}
+
+void OpusEncoderFilter::Stop() {
+    RTC_LOG(LS_INFO) << "OpusEncoderFilter Stop";
+}
+
+void OpusEncoderFilter::GetStats(JsonObject& stats) {
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        stats["complexity"] = complexity_;
+        stats["frame_ms"] = frame_ms_;
+        stats["dtx"] = dtx_;
+    }
+    int64_t now = rtc::TimeMillis();
+    stats["target_bitrate"] = target_bitrate_.load();
+    stats["kbps"] = bytes_.Rate(now) * 8 / 1000;
+    stats["loss_percent"] = loss_fraction_.load() * 100;
+    stats["fec"] = fec_enabled_.load();
+    stats["fec_switches"] = fec_switches_.count();
+    stats["packets"] = packets_.count();
+    stats["packet_bytes"] = packet_bytes_.load();
+    stats["frames_dtx"] = frames_dtx_.count();
+    stats["frames_rejected"] = frames_rejected_.count();
+    stats["encode_us"] = encode_time_us_.Average();
+}
+
+bool OpusEncoderFilter::ParseConfig(const std::string& json_config) {
+    JsonValue value;
+    if (!value.FromJson(json_config)) {
+        return false;
+    }
+
+    JsonObject jobject = value.ToObject();
+    if (!jobject.Has("opus_encoder")) {
+        return false;
+    }
+
+    JsonObject jopus = jobject["opus_encoder"].ToObject();
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    min_bitrate_ = std::max(6000, (int)jopus["min_bitrate"].ToInt(min_bitrate_));
+    max_bitrate_ = std::min(510000, std::max(min_bitrate_,
+        (int)jopus["max_bitrate"].ToInt(max_bitrate_)));
+    if (jopus.Has("bitrate")) {
+        bitrate_ = std::min(max_bitrate_, std::max(min_bitrate_,
+            (int)jopus["bitrate"].ToInt(bitrate_)));
+        target_bitrate_ = bitrate_;
+    }
+    complexity_ = std::min(10, std::max(0, (int)jopus["complexity"].ToInt(complexity_)));
+    int frame_ms = (int)jopus["frame_ms"].ToInt(frame_ms_);
+    if (frame_ms == 10 || frame_ms == 20 || frame_ms == 40 || frame_ms == 60) {
+        frame_ms_ = frame_ms;
+    }
+    dtx_ = jopus["dtx"].ToBool(dtx_);
+    if (jopus.Has("fec")) {
+        JsonValue jfec = jopus["fec"];
+        fec_mode_ = jfec.ToString("") == "auto" ? -1 : (jfec.ToBool(false) ? 1 : 0);
+    }
+    if (jopus.Has("application")) {
+        voip_ = jopus["application"].ToString("voip") != "audio";
+    }
+    config_changed_ = true;
+    return true;
+}
+
+void OpusEncoderFilter::OnPacketLoss(float loss_fraction) {
+    loss_fraction = std::min(1.0f, std::max(0.0f, loss_fraction));
+    float old_loss = loss_fraction_.load();
+    float new_loss;
+    do {
+        new_loss = old_loss + (loss_fraction - old_loss) * kLossSmoothing;
+    } while (!loss_fraction_.compare_exchange_weak(old_loss, new_loss));
+}
+
+int OpusEncoderFilter::AllocateBitrate(int available_bps) {
+    int bitrate;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        bitrate = std::max(min_bitrate_, std::min(bitrate_, available_bps));
+    }
+    target_bitrate_ = bitrate;
+    return bitrate;
+}
+
+void OpusEncoderFilter::SetTargetBitrate(int bitrate_bps) {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    target_bitrate_ = std::max(min_bitrate_, std::min(max_bitrate_, bitrate_bps));
+}
+
+bool OpusEncoderFilter::CreateEncoder(int sample_rate, int channels) {
+    DestroyEncoder();
+
+    bool voip;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        voip = voip_;
+        config_changed_ = true;
+    }
+
+    int err = OPUS_OK;
+    encoder_ = opus_encoder_create(sample_rate, channels,
+        voip ? OPUS_APPLICATION_VOIP : OPUS_APPLICATION_AUDIO, &err);
+    if (!encoder_ || err != OPUS_OK) {
+        RTC_LOG(LS_WARNING) << "OpusEncoderFilter create encoder failed: "
+            << opus_strerror(err);
+        encoder_ = nullptr;
+        return false;
+    }
+
+    sample_rate_ = sample_rate;
+    channels_ = channels;
+    applied_bitrate_ = 0;
+    applied_loss_perc_ = -1;
+    fec_on_ = false;
+    pcm_samples_ = 0;
+    RTC_LOG(LS_INFO) << "OpusEncoderFilter create encoder: " << sample_rate << "Hz, "
+        << channels << " channels, " << (voip ? "voip" : "audio");
+    return true;
+}
+
+void OpusEncoderFilter::DestroyEncoder() {
+    if (encoder_) {
+        opus_encoder_destroy(encoder_);
+        encoder_ = nullptr;
+    }
+    delete packet_trace_;
+    packet_trace_ = nullptr;
+}
+
+// 应用Setup/Update的配置，application变化时需要重建编码器
+void OpusEncoderFilter::ApplyConfig() {
+    int complexity;
+    int frame_ms;
+    bool dtx;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        if (!config_changed_) {
+            return;
+        }
+        complexity = complexity_;
+        frame_ms = frame_ms_;
+        dtx = dtx_;
+        config_changed_ = false;
+    }
+
+    opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(complexity));
+    opus_encoder_ctl(encoder_, OPUS_SET_DTX(dtx ? 1 : 0));
+
+    size_t frame_samples = (size_t)(sample_rate_ / 1000 * frame_ms * channels_);
+    if (pcm_.size() != frame_samples) {
+        // 帧长变化时丢掉没有攒满的一段
+        pcm_.assign(frame_samples, 0);
+        pcm_samples_ = 0;
+        delete packet_trace_;
+        packet_trace_ = nullptr;
+    }
+    applied_loss_perc_ = -1;
+}
+
+// 码率和丢包率每一包都检查，只有变化时才调用ctl
+void OpusEncoderFilter::UpdateLossControl() {
+    int bitrate = target_bitrate_.load();
+    if (bitrate != applied_bitrate_) {
+        opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(bitrate));
+        applied_bitrate_ = bitrate;
+    }
+
+    int fec_mode;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        fec_mode = fec_mode_;
+    }
+
+    float loss = loss_fraction_.load();
+    bool fec_on = fec_on_;
+    if (fec_mode >= 0) {
+        fec_on = fec_mode == 1;
+    }
+    else if (bitrate < kMinFecBitrate) {
+        fec_on = false;
+    }
+    else if (loss >= kFecEnableLoss) {
+        fec_on = true;
+    }
+    else if (loss < kFecDisableLoss) {
+        fec_on = false;
+    }
+
+    if (fec_on != fec_on_) {
+        RTC_LOG(LS_INFO) << "OpusEncoderFilter fec " << (fec_on ? "on" : "off")
+            << ", loss: " << loss * 100 << "%, bitrate: " << bitrate;
+        opus_encoder_ctl(encoder_, OPUS_SET_INBAND_FEC(fec_on ? 1 : 0));
+        fec_on_ = fec_on;
+        fec_enabled_ = fec_on;
+        fec_switches_.Add();
+        applied_loss_perc_ = -1;
+    }
+
+    // 丢包率提示让编码器减少帧间预测，没有FEC时也有用；FEC打开时至少按触发阈值提示
+    int loss_perc = std::min(kMaxLossPerc, (int)ceilf(loss * 100));
+    if (fec_on_) {
+        loss_perc = std::max(loss_perc, (int)(kFecEnableLoss * 100));
+    }
+    if (loss_perc != applied_loss_perc_) {
+        opus_encoder_ctl(encoder_, OPUS_SET_PACKET_LOSS_PERC(loss_perc));
+        applied_loss_perc_ = loss_perc;
+    }
+}
+
+void OpusEncoderFilter::OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) {
+    const AudioFormat& fmt = frame->fmt.sub_fmt.audio_fmt;
+    if (frame->fmt.media_type != MainMediaType::kMainTypeAudio ||
+        fmt.type != SubMediaType::kSubTypePcm || fmt.channels < 1 || fmt.channels > 2 ||
+        fmt.sample_rate <= 0)
+    {
+        frames_rejected_.Add();
+        return;
+    }
+
+    if (!encoder_ || fmt.sample_rate != input_rate_ || fmt.channels != channels_) {
+        int sample_rate = IsOpusSampleRate(fmt.sample_rate) ? fmt.sample_rate : 48000;
+        if (!CreateEncoder(sample_rate, fmt.channels)) {
+            frames_rejected_.Add();
+            return;
+        }
+        input_rate_ = fmt.sample_rate;
+        if (input_rate_ != sample_rate_) {
+            resampler_.InitializeIfNeeded(input_rate_, sample_rate_, channels_);
+            resampled_.resize(sample_rate_ / 100 * channels_);
+        }
+    }
+
+    ApplyConfig();
+    UpdateLossControl();
+
+    const int16_t* samples = reinterpret_cast<const int16_t*>(frame->data[0]);
+    size_t count = (size_t)fmt.samples_per_channel * channels_;
+    if (input_rate_ != sample_rate_) {
+        int out = resampler_.Resample(samples, count, resampled_.data(), resampled_.size());
+        if (out < 0) {
+            frames_rejected_.Add();
+            return;
+        }
+        samples = resampled_.data();
+        count = (size_t)out;
+    }
+
+    if (pcm_samples_ == 0) {
+        packet_ts_ = frame->ts;
+        packet_capture_ms_ = frame->capture_time_ms;
+        FrameTrace* trace = frame->TraceFor(tracer());
+        if (trace && frame->trace.compare_exchange_strong(trace, nullptr)) {
+            packet_trace_ = trace;
+        }
+    }
+
+    size_t offset = (size_t)pcm_samples_ * channels_;
+    count = std::min(count, pcm_.size() - offset);
+    memcpy(pcm_.data() + offset, samples, count * sizeof(int16_t));
+    pcm_samples_ += (int)(count / channels_);
+
+    if ((size_t)pcm_samples_ * channels_ >= pcm_.size()) {
+        EncodeFrame();
+    }
+}
+
+void OpusEncoderFilter::EncodeFrame() {
+    int frame_samples = pcm_samples_;
+    pcm_samples_ = 0;
+    FrameTrace* trace = packet_trace_;
+    packet_trace_ = nullptr;
+
+    std::shared_ptr<MediaFrame> packet = packet_pool_.Acquire();
+    int64_t start_us = rtc::TimeMicros();
+    opus_int32 len = opus_encode(encoder_, pcm_.data(), frame_samples,
+        reinterpret_cast<unsigned char*>(packet->data[0]), packet->max_size);
+    encode_time_us_.Add(rtc::TimeMicros() - start_us);
+
+    if (len < 0) {
+        RTC_LOG(LS_WARNING) << "OpusEncoderFilter encode failed: " << opus_strerror(len);
+        delete trace;
+        return;
+    }
+
+    if (len <= kDtxPacketBytes) {
+        frames_dtx_.Add();
+        delete trace;
+        return;
+    }
+
+    packet->fmt.media_type = MainMediaType::kMainTypeAudio;
+    packet->fmt.sub_fmt.audio_fmt.type = SubMediaType::kSubTypeOpus;
+    packet->fmt.sub_fmt.audio_fmt.sample_rate = sample_rate_;
+    packet->fmt.sub_fmt.audio_fmt.channels = channels_;
+    packet->fmt.sub_fmt.audio_fmt.samples_per_channel = frame_samples;
+    packet->data_len[0] = len;
+    packet->ts = packet_ts_;
+    packet->capture_time_ms = packet_capture_ms_;
+    if (trace) {
+        packet->trace.store(trace, std::memory_order_release);
+    }
+
+    packets_.Add();
+    bytes_.Add(len);
+    packet_bytes_ = len;
+
+    out_pin_->PushMediaFrame(packet);
+}
+
+} // namespace xrtc
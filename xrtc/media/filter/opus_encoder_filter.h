@@ -0,0 +1,110 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_FILTER_OPUS_ENCODER_FILTER_H_
+#define XRTCSDK_XRTC_MEDIA_FILTER_OPUS_ENCODER_FILTER_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <common_audio/resampler/include/push_resampler.h>
+
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/media/base/media_chain.h"
+#include "xrtc/media/base/media_frame_pool.h"
+
+struct OpusEncoder;
+
+namespace xrtc {
+
+// Opus编码节点：输入10ms的PCM，按frame_ms攒够一帧后编码，输出一个Opus包
+// 在音频线程池上执行，编码耗时不受视频负载影响
+// 配置：{"opus_encoder":{"bitrate":32000,"min_bitrate":6000,"max_bitrate":64000,
+//        "complexity":9,"frame_ms":20,"dtx":true,"fec":"auto","application":"voip"}}
+// fec: "auto"按测得的丢包率开关，true/false强制开关
+// 采样率不是Opus支持的8k/12k/16k/24k/48k时先重采样到48k
+class OpusEncoderFilter : public MediaObject {
+public:
+    OpusEncoderFilter();
+    ~OpusEncoderFilter() override;
+
+    // MediaObject
+    bool Start() override;
+    void Setup(const std::string& json_config) override;
+    void Update(const std::string& json_config) override;
+    void Stop() override;
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>({ in_pin_.get() });
+    }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>({ out_pin_.get() });
+    }
+    const char* name() const override { return "opus_encoder"; }
+    void GetStats(JsonObject& stats) override;
+    void OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) override;
+
+    // 以下可以在任意线程调用(例如网络线程收到RTCP时)，下一次编码前生效
+    // 接收端反馈的丢包率(0-1)，平滑后用于FEC开关和丢包率提示
+    void OnPacketLoss(float loss_fraction);
+    // 带宽下降时音频最后降级：先满足音频的码率(不超过max_bitrate，不低于min_bitrate)，
+    // 剩下的留给视频，返回分给音频的码率
+    int AllocateBitrate(int available_bps);
+    void SetTargetBitrate(int bitrate_bps);
+
+private:
+    bool ParseConfig(const std::string& json_config);
+    bool CreateEncoder(int sample_rate, int channels);
+    void DestroyEncoder();
+    void ApplyConfig();
+    void UpdateLossControl();
+    void EncodeFrame();
+
+private:
+    std::unique_ptr<InPin> in_pin_;
+    std::unique_ptr<OutPin> out_pin_;
+    MediaFramePool packet_pool_;
+
+    // 配置，Setup/Update写，编码线程读
+    std::mutex config_mutex_;
+    int bitrate_ = 32000;//带宽充足时的码率
+    int min_bitrate_ = 6000;
+    int max_bitrate_ = 64000;
+    int complexity_ = 9;
+    int frame_ms_ = 20;
+    bool dtx_ = true;
+    int fec_mode_ = -1;//-1按丢包率自动开关，0关闭，1打开
+    bool voip_ = true;//voip偏向语音，audio偏向音乐
+    bool config_changed_ = true;
+
+    // 网络反馈，任意线程写
+    std::atomic<int> target_bitrate_{ 32000 };
+    std::atomic<float> loss_fraction_{ 0.0f };//指数平滑后的丢包率
+
+    // 以下只在编码线程上访问
+    OpusEncoder* encoder_ = nullptr;
+    int sample_rate_ = 0;//编码器的采样率
+    int channels_ = 0;
+    int input_rate_ = 0;//输入的采样率，和sample_rate_不同时需要重采样
+    webrtc::PushResampler<int16_t> resampler_;
+    std::vector<int16_t> resampled_;
+    std::vector<int16_t> pcm_;//攒帧的缓冲
+    int pcm_samples_ = 0;//缓冲中每个声道的采样数
+    uint32_t packet_ts_ = 0;//当前包第一段10ms的时间戳
+    int64_t packet_capture_ms_ = 0;
+    int applied_bitrate_ = 0;
+    int applied_loss_perc_ = -1;
+    bool fec_on_ = false;
+    FrameTrace* packet_trace_ = nullptr;//当前包第一段输入的跟踪记录，转交给输出的包
+
+    // 统计
+    StatsCounter packets_;
+    StatsCounter bytes_;
+    StatsCounter frames_dtx_;//DTX静音帧，不输出
+    StatsCounter frames_rejected_;//声道数/采样率不支持
+    StatsCounter fec_switches_;
+    AverageCounter encode_time_us_;
+    std::atomic<int> packet_bytes_{ 0 };
+    std::atomic<bool> fec_enabled_{ false };
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_FILTER_OPUS_ENCODER_FILTER_H_
@@ -0,0 +1,333 @@
+﻿#include "xrtc/media/filter/simulcast_encoder_filter.h"
+
+#include <algorithm>
+
+#include <libyuv.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/in_pin.h"
+#include "xrtc/media/base/out_pin.h"
+
+namespace xrtc {
+
+namespace {
+
+const int kDefaultBitratesKbps[SimulcastEncoderFilter::kMaxLayers] = { 1500, 500, 150 };
+// 每层缓存的缩小帧数，覆盖编码队列中排队的帧
+const int kPoolFrames = 4;
+
+} // namespace
+
+SimulcastEncoderFilter::SimulcastEncoderFilter(int num_layers) :
+    MediaObject(NodeExecutor::kMediaPool),
+    num_layers_(std::min(kMaxLayers, std::max(1, num_layers))),
+    in_pin_(std::make_unique<InPin>(this))
+{
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeVideo;
+    fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeI420;
+    in_pin_->set_format(fmt);
+
+    // 第0层直接送给编码器，按编码器的要求对齐
+    VideoCaps caps;
+    caps.types = { SubMediaType::kSubTypeI420 };
+    caps.alignment = MediaFrame::kDefaultAlignment;
+    in_pin_->set_video_caps(caps);
+
+    for (int i = 0; i < kMaxLayers; ++i) {
+        bitrates_kbps_[i] = kDefaultBitratesKbps[i];
+    }
+
+    for (int i = 0; i < num_layers_; ++i) {
+        layers_[i] = std::make_unique<Layer>();
+        layers_[i]->encoder = std::make_unique<X264EncoderFilter>();
+        layers_[i]->out_pin = std::make_unique<OutPin>(this);
+        layers_[i]->out_pin->set_format(fmt);
+        layers_[i]->out_pin->ConnectTo(layers_[i]->encoder->GetAllInPins()[0]);
+    }
+}
+
+// 先停本节点的队列，不再有帧送给编码器，之后各层的编码器析构时停自己的队列
+SimulcastEncoderFilter::~SimulcastEncoderFilter() {
+    task_queue()->Stop();
+}
+
+bool SimulcastEncoderFilter::Start() {
+    for (int i = 0; i < num_layers_; ++i) {
+        if (!layers_[i]->encoder->Start()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SimulcastEncoderFilter::Setup(const std::string& json_config) {
+    for (int i = 0; i < num_layers_; ++i) {
+        layers_[i]->encoder->Setup(LayerConfig(json_config, i));
+    }
+}
+
+void SimulcastEncoderFilter::Update(const std::string& json_config) {
+    for (int i = 0; i < num_layers_; ++i) {
+        layers_[i]->encoder->Update(LayerConfig(json_config, i));
+    }
+}
+
+void SimulcastEncoderFilter::Stop() {
+    for (int i = 0; i < num_layers_; ++i) {
+        layers_[i]->encoder->Stop();
+    }
+    RTC_LOG(LS_INFO) << "SimulcastEncoderFilter Stop";
+}
+
+// 先排空本节点，缩小出来的帧都送到编码器之后再排空各层
+void SimulcastEncoderFilter::Drain() {
+    MediaObject::Drain();
+    for (int i = 0; i < num_layers_; ++i) {
+        layers_[i]->encoder->Drain();
+    }
+}
+
+std::vector<OutPin*> SimulcastEncoderFilter::GetAllOutPins() {
+    std::vector<OutPin*> out_pins;
+    for (int i = 0; i < num_layers_; ++i) {
+        out_pins.push_back(layers_[i]->encoder->GetAllOutPins()[0]);
+    }
+    return out_pins;
+}
+
+void SimulcastEncoderFilter::GetStats(JsonObject& stats) {
+    JsonArray jlayers;
+    for (int i = 0; i < num_layers_; ++i) {
+        Layer& layer = *layers_[i];
+        JsonObject jlayer;
+        jlayer["width"] = layer.width_stats.load();
+        jlayer["height"] = layer.height_stats.load();
+        jlayer["active"] = layer.active.load();
+        jlayer["frames"] = layer.frames.count();
+        jlayer["paused_frames"] = layer.paused_frames.count();
+        jlayer["scale_us"] = layer.scale_time_us.Average();
+        JsonObject jencoder;
+        layer.encoder->GetStats(jencoder);
+        jlayer["encoder"] = jencoder;
+        jlayers.Append(jlayer);
+    }
+    stats["layers"] = jlayers;
+    stats["pyramid_allocated"] = pyramid_allocated_.count();
+    stats["pyramid_reused"] = pyramid_reused_.count();
+    stats["frames_rejected"] = frames_rejected_.count();
+}
+
+void SimulcastEncoderFilter::SetLayerActive(int layer, bool active) {
+    if (layer < 0 || layer >= num_layers_) {
+        return;
+    }
+
+    Layer& l = *layers_[layer];
+    if (l.active.exchange(active) != active) {
+        l.resumed = active;
+        RTC_LOG(LS_INFO) << "SimulcastEncoderFilter layer " << layer
+            << (active ? " resumed" : " paused");
+    }
+}
+
+void SimulcastEncoderFilter::RequestKeyFrame(int layer) {
+    if (layer >= 0 && layer < num_layers_) {
+        layers_[layer]->encoder->RequestKeyFrame();
+    }
+}
+
+void SimulcastEncoderFilter::OnKeyFrameRequest(int layer, const RtcpKeyFrameRequest& request,
+    int64_t rtt_ms)
+{
+    if (layer >= 0 && layer < num_layers_) {
+        layers_[layer]->encoder->OnKeyFrameRequest(request, rtt_ms);
+    }
+}
+
+void SimulcastEncoderFilter::SetTargetBitrate(int layer, int bitrate_bps) {
+    if (layer >= 0 && layer < num_layers_) {
+        layers_[layer]->encoder->SetTargetBitrate(bitrate_bps);
+    }
+}
+
+bool SimulcastEncoderFilter::Downscale(const MediaFrame& src, MediaFrame* dst) {
+    const VideoFormat& src_fmt = src.fmt.sub_fmt.video_fmt;
+    const VideoFormat& dst_fmt = dst->fmt.sub_fmt.video_fmt;
+    return libyuv::I420Scale((const uint8_t*)src.data[0], src.stride[0],
+        (const uint8_t*)src.data[1], src.stride[1],
+        (const uint8_t*)src.data[2], src.stride[2],
+        src_fmt.width, src_fmt.height,
+        (uint8_t*)dst->data[0], dst->stride[0],
+        (uint8_t*)dst->data[1], dst->stride[1],
+        (uint8_t*)dst->data[2], dst->stride[2],
+        dst_fmt.width, dst_fmt.height,
+        libyuv::kFilterBox) == 0;
+}
+
+// 每层编码器的配置：x264_encoder的参数加上本层的码率，没有编码相关的配置时原样转发
+std::string SimulcastEncoderFilter::LayerConfig(const std::string& json_config, int layer) {
+    JsonValue value;
+    if (!value.FromJson(json_config)) {
+        return json_config;
+    }
+
+    JsonObject jobject = value.ToObject();
+    bool has_x264 = jobject.Has("x264_encoder");
+    bool has_simulcast = jobject.Has("simulcast_encoder");
+    if (!has_x264 && !has_simulcast) {
+        return json_config;
+    }
+
+    int bitrate_kbps;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        if (has_simulcast) {
+            JsonArray jbitrates = jobject["simulcast_encoder"].ToObject()["bitrates"].ToArray();
+            if (layer < (int)jbitrates.Size()) {
+                bitrates_kbps_[layer] = (int)jbitrates[layer].ToInt(bitrates_kbps_[layer]);
+            }
+        }
+        bitrate_kbps = bitrates_kbps_[layer];
+    }
+
+    JsonObject jx264 = has_x264 ? jobject["x264_encoder"].ToObject() : JsonObject();
+    jx264["bitrate"] = bitrate_kbps;
+    jx264["max_bitrate"] = bitrate_kbps;
+    // 层之间已经并行，低分辨率的层一个线程就够
+    if (layer > 0 && jx264["threads"].ToInt(0) == 0) {
+        jx264["threads"] = 1;
+    }
+    jobject["x264_encoder"] = jx264;
+    return JsonValue(jobject).ToJson();
+}
+
+// 按输入的分辨率算出每层的分辨率，重新协商各层编码器的输入并准备缩小用的缓冲池
+void SimulcastEncoderFilter::ConfigureLayers(int width, int height, int fps) {
+    width_ = width;
+    height_ = height;
+    fps_ = fps;
+
+    int layer_width = width;
+    int layer_height = height;
+    for (int i = 0; i < num_layers_; ++i) {
+        Layer& layer = *layers_[i];
+        if (i > 0) {
+            // 保持偶数，色度平面正好减半
+            layer_width = layer_width / 2 & ~1;
+            layer_height = layer_height / 2 & ~1;
+        }
+
+        bool enabled = i == 0 || (layer_width >= kMinLayerSize && layer_height >= kMinLayerSize);
+        layer.width = enabled ? layer_width : 0;
+        layer.height = enabled ? layer_height : 0;
+        layer.width_stats = layer.width;
+        layer.height_stats = layer.height;
+        layer.pool.reset();
+        if (!enabled) {
+            continue;
+        }
+
+        VideoStreamFormat format;
+        format.type = SubMediaType::kSubTypeI420;
+        format.width = layer.width;
+        format.height = layer.height;
+        format.fps = fps;
+        format.alignment = MediaFrame::kDefaultAlignment;
+        layer.out_pin->Renegotiate(format);
+
+        if (i > 0) {
+            VideoStreamFormat negotiated = layer.out_pin->negotiated_format();
+            layer.alignment = std::max<int>(MediaFrame::kDefaultAlignment, negotiated.alignment);
+            layer.padding = negotiated.padding;
+            layer.pool = std::make_unique<MediaFramePool>(
+                MediaFrame::VideoBufferSize(SubMediaType::kSubTypeI420,
+                    layer.width, layer.height, layer.alignment, layer.padding),
+                kPoolFrames);
+        }
+    }
+
+    RTC_LOG(LS_INFO) << "SimulcastEncoderFilter configure " << width << "x" << height
+        << "@" << fps << ", layers: " << num_layers_;
+}
+
+void SimulcastEncoderFilter::OnFormatChanged(InPin* /*in_pin*/, const VideoStreamFormat& format) {
+    if (format.width > 0 && format.height > 0) {
+        ConfigureLayers(format.width, format.height, format.fps);
+    }
+    else {
+        fps_ = format.fps;
+    }
+}
+
+void SimulcastEncoderFilter::OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) {
+    const VideoFormat& fmt = frame->fmt.sub_fmt.video_fmt;
+    if (frame->fmt.media_type != MainMediaType::kMainTypeVideo ||
+        fmt.type != SubMediaType::kSubTypeI420 || fmt.width <= 0 || fmt.height <= 0)
+    {
+        frames_rejected_.Add();
+        return;
+    }
+
+    if (fmt.width != width_ || fmt.height != height_) {
+        ConfigureLayers(fmt.width, fmt.height, fps_);
+    }
+
+    // 最低的需要编码的层，它之上的层暂停了也要缩小
+    int lowest = -1;
+    for (int i = 0; i < num_layers_; ++i) {
+        Layer& layer = *layers_[i];
+        layer.encoder->set_tracer(tracer());
+        if (layer.width > 0 && layer.active) {
+            lowest = i;
+        }
+        else if (layer.width > 0) {
+            layer.paused_frames.Add();
+        }
+    }
+
+    std::shared_ptr<MediaFrame> level = frame;
+    for (int i = 0; i <= lowest; ++i) {
+        Layer& layer = *layers_[i];
+        if (i > 0) {
+            int64_t start_us = rtc::TimeMicros();
+            int64_t allocated = layer.pool->allocated();
+            std::shared_ptr<MediaFrame> scaled = layer.pool->Acquire();
+            if (layer.pool->allocated() > allocated) {
+                pyramid_allocated_.Add();
+            }
+            else {
+                pyramid_reused_.Add();
+            }
+
+            if (!scaled->SetVideoLayout(SubMediaType::kSubTypeI420, layer.width, layer.height,
+                layer.alignment, layer.padding) || !Downscale(*level, scaled.get()))
+            {
+                RTC_LOG(LS_WARNING) << "SimulcastEncoderFilter downscale failed: "
+                    << layer.width << "x" << layer.height;
+                frames_rejected_.Add();
+                return;
+            }
+
+            scaled->ts = frame->ts;
+            scaled->capture_time_ms = frame->capture_time_ms;
+            layer.scale_time_us.Add(rtc::TimeMicros() - start_us);
+            level = scaled;
+        }
+
+        if (!layer.active) {
+            continue;
+        }
+
+        // 接收端切到恢复的层时需要从关键帧开始解码
+        if (layer.resumed.exchange(false)) {
+            layer.encoder->RequestKeyFrame();
+        }
+        layer.frames.Add();
+        layer.out_pin->PushMediaFrame(level);
+    }
+}
+
+} // namespace xrtc
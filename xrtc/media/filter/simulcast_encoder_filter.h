@@ -0,0 +1,110 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_FILTER_SIMULCAST_ENCODER_FILTER_H_
+#define XRTCSDK_XRTC_MEDIA_FILTER_SIMULCAST_ENCODER_FILTER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/media/base/media_chain.h"
+#include "xrtc/media/base/media_frame_pool.h"
+#include "xrtc/media/filter/x264_encoder_filter.h"
+
+namespace xrtc {
+
+// 联播编码节点：一路采集编出2~3个分辨率的H264流，带宽不同的接收端各取一层
+// 输入I420，第i层是第i-1层的一半(1280x720 -> 640x360 -> 320x180)：
+// - 第0层直接使用输入帧，不拷贝
+// - 下面的层逐级从上一层做2:1的box滤波(libyuv的SIMD快速路径)，不是每层都从原图缩放，
+//   缩小的总像素量不到原图的1/3；缩小后的帧来自每层自己的缓冲池，编码完释放后复用
+// - 每层一个X264EncoderFilter，各自在媒体线程池的串行队列上执行，层之间并行编码；
+//   第0层先投递，原图编码和下面各层的缩小同时进行
+// - 暂停的层不编码，更低的层还在编码时只做缩小；恢复时先出关键帧
+// 层数在构造时确定，每层一个out_pin，按层号排列，宽或高小于kMinLayerSize的层不编码
+// 配置：{"simulcast_encoder":{"bitrates":[1500,500,150]}}，单位kbps，
+// 其它编码参数沿用"x264_encoder"；threads为0时只有第0层由x264按核数决定，其它层单线程
+class SimulcastEncoderFilter : public MediaObject {
+public:
+    static const int kMaxLayers = 3;
+    static const int kMinLayerSize = 64;
+
+    explicit SimulcastEncoderFilter(int num_layers = kMaxLayers);
+    ~SimulcastEncoderFilter() override;
+
+    // MediaObject
+    bool Start() override;
+    void Setup(const std::string& json_config) override;
+    void Update(const std::string& json_config) override;
+    void Stop() override;
+    void Drain() override;
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>({ in_pin_.get() });
+    }
+    std::vector<OutPin*> GetAllOutPins() override;
+    const char* name() const override { return "simulcast_encoder"; }
+    void GetStats(JsonObject& stats) override;
+    void OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) override;
+    void OnFormatChanged(InPin* in_pin, const VideoStreamFormat& format) override;
+
+    // 以下可以在任意线程调用，layer超出范围时忽略
+    // 没有接收端需要某一层时暂停它，下一帧生效
+    void SetLayerActive(int layer, bool active);
+    void RequestKeyFrame(int layer);
+    void OnKeyFrameRequest(int layer, const RtcpKeyFrameRequest& request, int64_t rtt_ms);
+    void SetTargetBitrate(int layer, int bitrate_bps);
+
+    int num_layers() const { return num_layers_; }
+
+    // 把一帧I420缩小到dst的宽高，宽高正好减半时走libyuv的2:1快速路径
+    static bool Downscale(const MediaFrame& src, MediaFrame* dst);
+
+private:
+    struct Layer {
+        std::unique_ptr<X264EncoderFilter> encoder;
+        std::unique_ptr<OutPin> out_pin;//节点内部连到encoder的in_pin
+        std::atomic<bool> active{ true };
+        std::atomic<bool> resumed{ false };//恢复之后还没有编码过
+
+        // 以下只在本节点的队列上访问
+        std::unique_ptr<MediaFramePool> pool;
+        int width = 0;//0表示分辨率太小，不编码
+        int height = 0;
+        int alignment = MediaFrame::kDefaultAlignment;
+        int padding = 0;
+
+        // 统计
+        std::atomic<int> width_stats{ 0 };
+        std::atomic<int> height_stats{ 0 };
+        StatsCounter frames;//送去编码的帧数
+        StatsCounter paused_frames;
+        AverageCounter scale_time_us;
+    };
+
+    std::string LayerConfig(const std::string& json_config, int layer);
+    void ConfigureLayers(int width, int height, int fps);
+
+private:
+    const int num_layers_;
+    std::mutex config_mutex_;
+    int bitrates_kbps_[kMaxLayers];//Setup/Update写
+    std::unique_ptr<InPin> in_pin_;
+    std::unique_ptr<Layer> layers_[kMaxLayers];
+
+    // 以下只在本节点的队列上访问
+    int width_ = 0;
+    int height_ = 0;
+    int fps_ = 0;
+
+    // 统计
+    StatsCounter frames_rejected_;
+    StatsCounter pyramid_allocated_;//缩小用的帧新分配的次数
+    StatsCounter pyramid_reused_;//从缓冲池复用的次数
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_FILTER_SIMULCAST_ENCODER_FILTER_H_
@@ -0,0 +1,80 @@
+﻿#include "xrtc/media/filter/tee_filter.h"
+
+#include <rtc_base/logging.h>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/in_pin.h"
+#include "xrtc/media/base/out_pin.h"
+
+namespace xrtc {
+
+TeeFilter::TeeFilter(const MediaFormat& fmt, int branches) :
+    in_pin_(std::make_unique<InPin>(this))
+{
+    in_pin_->set_format(fmt);
+    for (int i = 0; i < branches; ++i) {
+        out_pins_.push_back(std::make_unique<OutPin>(this));
+        out_pins_.back()->set_format(fmt);
+    }
+}
+
+TeeFilter::~TeeFilter() {
+}
+
+bool TeeFilter::Start() {
+    return true;
+}
+
+void TeeFilter::Stop() {
+    RTC_LOG(LS_INFO) << "TeeFilter Stop";
+}
+
+std::vector<OutPin*> TeeFilter::GetAllOutPins() {
+    std::vector<OutPin*> out_pins;
+    for (auto& out_pin : out_pins_) {
+        out_pins.push_back(out_pin.get());
+    }
+    return out_pins;
+}
+
+void TeeFilter::GetStats(JsonObject& stats) {
+    int connected = 0;
+    for (auto& out_pin : out_pins_) {
+        if (out_pin->in_pin()) {
+            ++connected;
+        }
+    }
+    stats["branches"] = connected;
+    stats["frames"] = frames_.count();
+}
+
+// 每个分支按同一个格式重新协商，分支之间不需要一致
+void TeeFilter::OnFormatChanged(InPin* /*in_pin*/, const VideoStreamFormat& format) {
+    for (auto& out_pin : out_pins_) {
+        out_pin->Renegotiate(format);
+    }
+}
+
+void TeeFilter::OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) {
+    frames_.Add();
+
+    // 每个分支的末端都会结束一次跟踪，推送之前登记分支数
+    FrameTrace* trace = frame->TraceFor(tracer());
+    if (trace) {
+        int connected = 0;
+        for (auto& out_pin : out_pins_) {
+            if (out_pin->in_pin()) {
+                ++connected;
+            }
+        }
+        trace->Fork(connected);
+    }
+
+    for (auto& out_pin : out_pins_) {
+        if (out_pin->in_pin()) {
+            out_pin->PushMediaFrame(frame);
+        }
+    }
+}
+
+} // namespace xrtc
@@ -0,0 +1,43 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_FILTER_TEE_FILTER_H_
+#define XRTCSDK_XRTC_MEDIA_FILTER_TEE_FILTER_H_
+
+#include <vector>
+
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/media/base/media_chain.h"
+#include "xrtc/media/base/media_frame.h"
+
+namespace xrtc {
+
+// 分叉节点：同一帧不拷贝，原样推给每个已连接的out_pin(例如编码输出同时发送和录制)
+// 在上游的线程上同步转发(kInline)，各分支的节点自己决定在哪里处理
+// out_pin分别用MediaChain::ConnectMediaPin连到不同的下游，没有连接的out_pin跳过
+class TeeFilter : public MediaObject {
+public:
+    // fmt为上游输出的格式，branches为out_pin的个数
+    TeeFilter(const MediaFormat& fmt, int branches);
+    ~TeeFilter() override;
+
+    // MediaObject
+    bool Start() override;
+    void Stop() override;
+    void OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) override;
+    void OnFormatChanged(InPin* in_pin, const VideoStreamFormat& format) override;
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>({ in_pin_.get() });
+    }
+    std::vector<OutPin*> GetAllOutPins() override;
+    const char* name() const override { return "tee_filter"; }
+    void GetStats(JsonObject& stats) override;
+
+    OutPin* out_pin(int index) { return out_pins_[index].get(); }
+
+private:
+    std::unique_ptr<InPin> in_pin_;
+    std::vector<std::unique_ptr<OutPin>> out_pins_;
+    StatsCounter frames_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_FILTER_TEE_FILTER_H_
@@ -0,0 +1,381 @@
+﻿#include "xrtc/media/filter/video_compositor.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include <rtc_base/logging.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/time_utils.h>
+#include <libyuv.h>
+
+#include "xrtc/base/xrtc_global.h"
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/frame_tracer.h"
+#include "xrtc/media/base/in_pin.h"
+#include "xrtc/media/base/out_pin.h"
+
+namespace xrtc {
+
+namespace {
+
+// 背景色：黑色(BT.601 limited range)
+const int kBackgroundY = 16;
+const int kBackgroundUV = 128;
+
+int AlignDown2(int value) {
+    return value & ~1;
+}
+
+} // namespace
+
+VideoCompositor::VideoCompositor(int inputs) :
+    out_pin_(std::make_unique<OutPin>(this)),
+    compose_queue_(XRTCGlobal::Instance()->media_pool()->CreateSerialQueue())
+{
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeVideo;
+    fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeI420;
+    // 高于合成帧率的输入帧不会被用到，协商时让源按合成帧率抽帧
+    VideoCaps in_caps;
+    in_caps.max_fps = fps_;
+    for (int i = 0; i < inputs; ++i) {
+        in_pins_.push_back(std::make_unique<InPin>(this));
+        in_pins_.back()->set_format(fmt);
+        in_pins_.back()->set_video_caps(in_caps);
+    }
+    out_pin_->set_format(fmt);
+
+    latest_frames_.resize(inputs);
+    tiles_ = GridLayout(inputs, width_, height_);
+}
+
+VideoCompositor::~VideoCompositor() {
+    compose_queue_->Stop();
+}
+
+std::vector<InPin*> VideoCompositor::GetAllInPins() {
+    std::vector<InPin*> in_pins;
+    for (auto& in_pin : in_pins_) {
+        in_pins.push_back(in_pin.get());
+    }
+    return in_pins;
+}
+
+bool VideoCompositor::Start() {
+    RTC_LOG(LS_INFO) << "VideoCompositor Start, inputs: " << in_pins_.size();
+    start_ms_ = rtc::TimeMillis();
+    next_compose_ms_ = start_ms_;
+    clock_alive_ = std::make_shared<std::atomic<bool>>(true);
+    ScheduleCompose(clock_alive_);
+    return true;
+}
+
+void VideoCompositor::Setup(const std::string& json_config) {
+    ParseConfig(json_config);
+}
+
+void VideoCompositor::Update(const std::string& json_config) {
+    if (ParseConfig(json_config)) {
+        RTC_LOG(LS_INFO) << "VideoCompositor Update: " << width_ << "x" << height_
+            << "@" << fps_ << ", tiles: " << tiles_.size();
+    }
+}
+
+void VideoCompositor::Stop() {
+    RTC_LOG(LS_INFO) << "VideoCompositor Stop";
+    if (clock_alive_) {
+        *clock_alive_ = false;
+    }
+    compose_queue_->Flush();
+}
+
+void VideoCompositor::Drain() {
+    compose_queue_->Flush();
+}
+
+void VideoCompositor::GetStats(JsonObject& stats) {
+    int active = 0;
+    {
+        std::lock_guard<std::mutex> lock(inputs_mutex_);
+        for (auto& frame : latest_frames_) {
+            if (frame) {
+                ++active;
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        stats["width"] = width_;
+        stats["height"] = height_;
+    }
+    stats["inputs"] = (int)in_pins_.size();
+    stats["active_inputs"] = active;
+    stats["compose_fps"] = frames_composed_.Rate(rtc::TimeMillis());
+    stats["frames_composed"] = frames_composed_.count();
+    stats["frames_skipped"] = frames_skipped_.count();
+    stats["tiles_scaled"] = tiles_scaled_.count();
+    stats["compose_us"] = compose_time_us_.Average();
+}
+
+// 只保存每个输入最新的一帧，合成时再取
+void VideoCompositor::OnNewPinFrame(InPin* in_pin, std::shared_ptr<MediaFrame> frame) {
+    if (frame->fmt.sub_fmt.video_fmt.type != SubMediaType::kSubTypeI420) {
+        return;
+    }
+
+    for (size_t i = 0; i < in_pins_.size(); ++i) {
+        if (in_pins_[i].get() == in_pin) {
+            std::lock_guard<std::mutex> lock(inputs_mutex_);
+            latest_frames_[i] = frame;
+            return;
+        }
+    }
+}
+
+std::vector<VideoCompositor::Tile> VideoCompositor::GridLayout(int inputs,
+    int width, int height)
+{
+    std::vector<Tile> tiles;
+    if (inputs <= 0) {
+        return tiles;
+    }
+
+    int cols = (int)ceil(sqrt((double)inputs));
+    int rows = (inputs + cols - 1) / cols;
+    int tile_width = AlignDown2(width / cols);
+    int tile_height = AlignDown2(height / rows);
+    for (int i = 0; i < inputs; ++i) {
+        Tile tile;
+        tile.x = (i % cols) * tile_width;
+        tile.y = (i / cols) * tile_height;
+        tile.width = tile_width;
+        tile.height = tile_height;
+        tiles.push_back(tile);
+    }
+    return tiles;
+}
+
+bool VideoCompositor::ParseConfig(const std::string& json_config) {
+    JsonValue value;
+    if (!value.FromJson(json_config)) {
+        return false;
+    }
+
+    JsonObject jobject = value.ToObject();
+    if (!jobject.Has("video_compositor")) {
+        return false;
+    }
+
+    JsonObject jcompositor = jobject["video_compositor"].ToObject();
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    width_ = std::max(2, AlignDown2((int)jcompositor["width"].ToInt(width_)));
+    height_ = std::max(2, AlignDown2((int)jcompositor["height"].ToInt(height_)));
+    fps_ = std::max(1, (int)jcompositor["fps"].ToInt(fps_));
+
+    std::vector<Tile> tiles;
+    if (jcompositor.Has("tiles")) {
+        JsonArray jtiles = jcompositor["tiles"].ToArray();
+        for (int i = 0; i < jtiles.Size(); ++i) {
+            JsonObject jtile = jtiles[i].ToObject();
+            // 和画布求交集，负数的原点会让libyuv写到画布之前
+            int x = AlignDown2((int)jtile["x"].ToInt());
+            int y = AlignDown2((int)jtile["y"].ToInt());
+            int right = x + std::max(0, AlignDown2((int)jtile["width"].ToInt()));
+            int bottom = y + std::max(0, AlignDown2((int)jtile["height"].ToInt()));
+            Tile tile;
+            tile.x = std::max(0, std::min(x, width_));
+            tile.y = std::max(0, std::min(y, height_));
+            tile.width = std::max(0, std::min(right, width_) - tile.x);
+            tile.height = std::max(0, std::min(bottom, height_) - tile.y);
+            if (tile.width == 0 || tile.height == 0) {
+                // tile按下标对应输入，保留位置，这一路输入不显示
+                RTC_LOG(LS_WARNING) << "VideoCompositor tile " << i
+                    << " is empty after clipping to the canvas, dropped";
+                tile = Tile{ 0, 0, 0, 0 };
+            }
+            tiles.push_back(tile);
+        }
+    }
+    else {
+        tiles = GridLayout((int)in_pins_.size(), width_, height_);
+    }
+
+    tiles_ = tiles;
+    layout_changed_ = true;
+    return true;
+}
+
+// 按绝对时间排下一次合成，避免定时误差累积；落后超过一帧时从当前时间重新开始
+void VideoCompositor::ScheduleCompose(std::shared_ptr<std::atomic<bool>> alive) {
+    int fps;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        fps = fps_;
+    }
+
+    int interval_ms = 1000 / fps;
+    int64_t now = rtc::TimeMillis();
+    next_compose_ms_ += interval_ms;
+    if (next_compose_ms_ < now - interval_ms) {
+        next_compose_ms_ = now;
+    }
+    int delay_ms = (int)std::max<int64_t>(0, next_compose_ms_ - now);
+
+    XRTCGlobal::Instance()->worker_thread()->PostDelayedTask(webrtc::ToQueuedTask([this, alive]() {
+        if (!*alive) {
+            return;
+        }
+
+        if (compose_pending_.exchange(true)) {
+            frames_skipped_.Add();
+        }
+        else {
+            compose_queue_->PostTask([this, alive]() {
+                if (*alive) {
+                    Compose();
+                }
+                compose_pending_ = false;
+            });
+        }
+
+        ScheduleCompose(alive);
+    }), delay_ms);
+}
+
+void VideoCompositor::Compose() {
+    int64_t start_us = rtc::TimeMicros();
+
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        if (layout_changed_) {
+            canvas_width_ = width_;
+            canvas_height_ = height_;
+            canvas_tiles_ = tiles_;
+            canvas_fps_ = fps_;
+            layout_changed_ = false;
+            canvas_.clear();
+        }
+    }
+
+    if (canvas_.empty()) {
+        int chroma_size = (canvas_width_ / 2) * (canvas_height_ / 2);
+        canvas_.resize(canvas_width_ * canvas_height_ + chroma_size * 2);
+        ClearCanvas();
+        drawn_frames_.assign(in_pins_.size(), nullptr);
+
+        // 画布大小变化，下游在下一帧之前重新分配
+        VideoStreamFormat format;
+        format.type = SubMediaType::kSubTypeI420;
+        format.width = canvas_width_;
+        format.height = canvas_height_;
+        format.fps = canvas_fps_;
+        out_pin_->Renegotiate(format);
+    }
+
+    std::vector<std::shared_ptr<MediaFrame>> frames;
+    {
+        std::lock_guard<std::mutex> lock(inputs_mutex_);
+        frames = latest_frames_;
+    }
+
+    // 只重画有新帧的输入
+    size_t count = std::min(frames.size(), canvas_tiles_.size());
+    for (size_t i = 0; i < count; ++i) {
+        if (!frames[i] || frames[i] == drawn_frames_[i]) {
+            continue;
+        }
+
+        const Tile& tile = canvas_tiles_[i];
+        if (tile.width > 0 && tile.height > 0) {
+            DrawTile(*frames[i], tile);
+            tiles_scaled_.Add();
+        }
+        drawn_frames_[i] = frames[i];
+
+        // 输入帧的跟踪在合成处结束，合成帧重新开始
+        FrameTrace* trace = frames[i]->TraceFor(tracer());
+        if (trace) {
+            trace->tracer->End(frames[i].get(), name());
+        }
+    }
+
+    uint8_t* canvas_y = canvas_.data();
+    uint8_t* canvas_u = canvas_y + canvas_width_ * canvas_height_;
+    uint8_t* canvas_v = canvas_u + (canvas_width_ / 2) * (canvas_height_ / 2);
+    std::shared_ptr<MediaFrame> frame = MediaFrame::CreateI420(
+        canvas_y, canvas_width_,
+        canvas_u, canvas_width_ / 2,
+        canvas_v, canvas_width_ / 2,
+        canvas_width_, canvas_height_);
+
+    int64_t now = rtc::TimeMillis();
+    frame->ts = static_cast<uint32_t>(now - start_ms_);
+    frame->capture_time_ms = now;
+
+    frames_composed_.Add();
+    compose_time_us_.Add(rtc::TimeMicros() - start_us);
+
+    FrameTracer* frame_tracer = tracer();
+    if (frame_tracer) {
+        frame_tracer->Begin(frame.get(), name());
+    }
+
+    out_pin_->PushMediaFrame(frame);
+}
+
+// 等比缩放到tile中居中，两边/上下留黑边
+void VideoCompositor::DrawTile(const MediaFrame& frame, const Tile& tile) {
+    int src_width = frame.fmt.sub_fmt.video_fmt.width;
+    int src_height = frame.fmt.sub_fmt.video_fmt.height;
+    if (src_width <= 0 || src_height <= 0 || tile.width < 2 || tile.height < 2) {
+        return;
+    }
+
+    int dst_width = tile.width;
+    int dst_height = tile.height;
+    if ((int64_t)src_width * tile.height > (int64_t)src_height * tile.width) {
+        dst_height = AlignDown2((int)((int64_t)src_height * tile.width / src_width));
+    }
+    else {
+        dst_width = AlignDown2((int)((int64_t)src_width * tile.height / src_height));
+    }
+    dst_width = std::max(2, dst_width);
+    dst_height = std::max(2, dst_height);
+    int dst_x = tile.x + AlignDown2((tile.width - dst_width) / 2);
+    int dst_y = tile.y + AlignDown2((tile.height - dst_height) / 2);
+
+    int stride_y = canvas_width_;
+    int stride_uv = canvas_width_ / 2;
+    uint8_t* canvas_y = canvas_.data();
+    uint8_t* canvas_u = canvas_y + canvas_width_ * canvas_height_;
+    uint8_t* canvas_v = canvas_u + stride_uv * (canvas_height_ / 2);
+
+    // 输入分辨率变化时黑边的位置也会变，先清掉整个tile
+    libyuv::I420Rect(canvas_y, stride_y, canvas_u, stride_uv, canvas_v, stride_uv,
+        tile.x, tile.y, tile.width, tile.height,
+        kBackgroundY, kBackgroundUV, kBackgroundUV);
+
+    libyuv::I420Scale((const uint8_t*)frame.data[0], frame.stride[0],
+        (const uint8_t*)frame.data[1], frame.stride[1],
+        (const uint8_t*)frame.data[2], frame.stride[2],
+        src_width, src_height,
+        canvas_y + dst_y * stride_y + dst_x, stride_y,
+        canvas_u + (dst_y / 2) * stride_uv + dst_x / 2, stride_uv,
+        canvas_v + (dst_y / 2) * stride_uv + dst_x / 2, stride_uv,
+        dst_width, dst_height,
+        libyuv::kFilterBilinear);
+}
+
+void VideoCompositor::ClearCanvas() {
+    int stride_uv = canvas_width_ / 2;
+    uint8_t* canvas_y = canvas_.data();
+    uint8_t* canvas_u = canvas_y + canvas_width_ * canvas_height_;
+    uint8_t* canvas_v = canvas_u + stride_uv * (canvas_height_ / 2);
+    libyuv::I420Rect(canvas_y, canvas_width_, canvas_u, stride_uv, canvas_v, stride_uv,
+        0, 0, canvas_width_, canvas_height_,
+        kBackgroundY, kBackgroundUV, kBackgroundUV);
+}
+
+} // namespace xrtc
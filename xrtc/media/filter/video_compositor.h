@@ -0,0 +1,95 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_FILTER_VIDEO_COMPOSITOR_H_
+#define XRTCSDK_XRTC_MEDIA_FILTER_VIDEO_COMPOSITOR_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "xrtc/base/task_pool.h"
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/media/base/media_chain.h"
+
+namespace xrtc {
+
+// 多路合成节点：每个输入缩放后画到同一张画布上，按固定帧率输出合成后的I420帧
+// 一路画面只需要一次合成和一次渲染，代替每路一个渲染设备
+// 配置：{"video_compositor":{"width":1280,"height":720,"fps":30,
+//        "tiles":[{"x":0,"y":0,"width":640,"height":360},...]}}
+// 没有tiles时按输入个数自动排成网格，每个画面等比缩放居中
+class VideoCompositor : public MediaObject {
+public:
+    struct Tile {
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+
+    explicit VideoCompositor(int inputs);
+    ~VideoCompositor() override;
+
+    // MediaObject
+    bool Start() override;
+    void Setup(const std::string& json_config) override;
+    void Update(const std::string& json_config) override;
+    void Stop() override;
+    void Drain() override;
+    std::vector<InPin*> GetAllInPins() override;
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>({ out_pin_.get() });
+    }
+    const char* name() const override { return "video_compositor"; }
+    void GetStats(JsonObject& stats) override;
+
+    void OnNewPinFrame(InPin* in_pin, std::shared_ptr<MediaFrame> frame) override;
+
+    // 网格布局：列数为ceil(sqrt(n))，坐标和宽高按2对齐
+    static std::vector<Tile> GridLayout(int inputs, int width, int height);
+
+private:
+    bool ParseConfig(const std::string& json_config);
+    void ScheduleCompose(std::shared_ptr<std::atomic<bool>> alive);
+    void Compose();
+    void DrawTile(const MediaFrame& frame, const Tile& tile);
+    void ClearCanvas();
+
+private:
+    std::vector<std::unique_ptr<InPin>> in_pins_;
+    std::unique_ptr<OutPin> out_pin_;
+    std::unique_ptr<SerialTaskQueue> compose_queue_;//合成在媒体线程池上执行
+    std::shared_ptr<std::atomic<bool>> clock_alive_;//Stop之后定时任务不再访问this
+
+    // 每个输入最新的一帧，输入线程写，合成线程读
+    std::mutex inputs_mutex_;
+    std::vector<std::shared_ptr<MediaFrame>> latest_frames_;
+
+    // 配置，Setup/Update写，合成线程读
+    std::mutex config_mutex_;
+    int width_ = 1280;
+    int height_ = 720;
+    int fps_ = 30;
+    std::vector<Tile> tiles_;
+    bool layout_changed_ = true;
+
+    // 以下只在合成队列上访问
+    int canvas_width_ = 0;
+    int canvas_height_ = 0;
+    int canvas_fps_ = 0;
+    std::vector<uint8_t> canvas_;//I420，Y/U/V连续存放，stride等于宽度
+    std::vector<Tile> canvas_tiles_;
+    std::vector<std::shared_ptr<MediaFrame>> drawn_frames_;//已经画到画布上的帧，没有变化的输入不再缩放
+    int64_t start_ms_ = 0;
+
+    int64_t next_compose_ms_ = 0;//只在worker_thread的定时任务中访问
+    std::atomic<bool> compose_pending_{ false };//合成跟不上帧率时跳过，不在队列中堆积
+
+    // 统计
+    StatsCounter frames_composed_;
+    StatsCounter tiles_scaled_;
+    StatsCounter frames_skipped_;
+    AverageCounter compose_time_us_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_FILTER_VIDEO_COMPOSITOR_H_
@@ -0,0 +1,104 @@
+﻿#include "xrtc/media/filter/video_convert_filter.h"
+
+#include <algorithm>
+
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/in_pin.h"
+#include "xrtc/media/base/out_pin.h"
+#include "xrtc/media/base/video_convert.h"
+
+namespace xrtc {
+
+// 转换放到媒体线程池上，不占用采集线程，帧的顺序不变
+VideoConvertFilter::VideoConvertFilter(SubMediaType dst_type) :
+    MediaObject(NodeExecutor::kMediaPool),
+    dst_type_(dst_type),
+    in_pin_(std::make_unique<InPin>(this)),
+    out_pin_(std::make_unique<OutPin>(this))
+{
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeVideo;
+    fmt.sub_fmt.video_fmt.type = dst_type;
+    out_pin_->set_format(fmt);
+
+    // 目标格式排在最前，上游可以直接输出目标格式时不需要转换
+    std::vector<SubMediaType> types({ dst_type });
+    for (auto type : { SubMediaType::kSubTypeI420, SubMediaType::kSubTypeNV12,
+        SubMediaType::kSubTypeI420A, SubMediaType::kSubTypeYUY2, SubMediaType::kSubTypeARGB })
+    {
+        if (type != dst_type) {
+            types.push_back(type);
+        }
+    }
+    in_pin_->set_format(fmt);
+    in_pin_->set_video_types(types);
+}
+
+VideoConvertFilter::~VideoConvertFilter() {
+    task_queue()->Stop();
+}
+
+bool VideoConvertFilter::Start() {
+    return true;
+}
+
+void VideoConvertFilter::Stop() {
+    RTC_LOG(LS_INFO) << "VideoConvertFilter Stop";
+}
+
+void VideoConvertFilter::GetStats(JsonObject& stats) {
+    stats["src_format"] = SubMediaTypeName(src_type_.load());
+    stats["dst_format"] = SubMediaTypeName(dst_type_);
+    stats["frames_converted"] = frames_converted_.count();
+    stats["frames_passed"] = frames_passed_.count();
+    stats["convert_us"] = convert_time_us_.Average();
+}
+
+// 输出只改变子类型，宽高和帧率沿用上游
+void VideoConvertFilter::OnFormatChanged(InPin* /*in_pin*/, const VideoStreamFormat& format) {
+    VideoStreamFormat out_format = format;
+    out_format.type = dst_type_;
+    out_pin_->Renegotiate(out_format);
+
+    VideoStreamFormat negotiated = out_pin_->negotiated_format();
+    out_alignment_ = std::max<int>(MediaFrame::kDefaultAlignment, negotiated.alignment);
+    out_padding_ = negotiated.padding;
+}
+
+void VideoConvertFilter::OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) {
+    SubMediaType src_type = frame->fmt.sub_fmt.video_fmt.type;
+    src_type_ = src_type;
+    if (src_type == dst_type_) {
+        frames_passed_.Add();
+        out_pin_->PushMediaFrame(frame);
+        return;
+    }
+
+    int64_t start_us = rtc::TimeMicros();
+    std::shared_ptr<MediaFrame> dst_frame = MediaFrame::CreateVideo(dst_type_,
+        frame->fmt.sub_fmt.video_fmt.width, frame->fmt.sub_fmt.video_fmt.height,
+        out_alignment_, out_padding_);
+    if (!dst_frame || !ConvertVideoFrame(*frame, dst_frame.get())) {
+        RTC_LOG(LS_WARNING) << "VideoConvertFilter convert failed: "
+            << SubMediaTypeName(src_type) << " -> " << SubMediaTypeName(dst_type_);
+        return;
+    }
+
+    dst_frame->ts = frame->ts;
+    dst_frame->capture_time_ms = frame->capture_time_ms;
+    // 本链路的跟踪记录拷贝给新的帧，延时统计不中断；源帧可能还被其它节点使用，保留它的记录
+    FrameTrace* trace = frame->TraceFor(tracer());
+    if (trace) {
+        dst_frame->trace.store(trace->Clone(), std::memory_order_release);
+    }
+
+    frames_converted_.Add();
+    convert_time_us_.Add(rtc::TimeMicros() - start_us);
+
+    out_pin_->PushMediaFrame(dst_frame);
+}
+
+} // namespace xrtc
@@ -0,0 +1,46 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_FILTER_VIDEO_CONVERT_FILTER_H_
+#define XRTCSDK_XRTC_MEDIA_FILTER_VIDEO_CONVERT_FILTER_H_
+
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/media/base/media_chain.h"
+#include "xrtc/media/base/media_frame.h"
+
+namespace xrtc {
+
+// 视频格式转换节点：接受任意未压缩格式，输出dst_type
+// 上下游没有共同格式时由MediaChain::ConnectMediaObject自动插入，格式相同的帧直接透传
+class VideoConvertFilter : public MediaObject {
+public:
+    explicit VideoConvertFilter(SubMediaType dst_type);
+    ~VideoConvertFilter() override;
+
+    // MediaObject
+    bool Start() override;
+    void Stop() override;
+    void OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) override;
+    void OnFormatChanged(InPin* in_pin, const VideoStreamFormat& format) override;
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>({ in_pin_.get() });
+    }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>({ out_pin_.get() });
+    }
+    const char* name() const override { return "video_convert_filter"; }
+    void GetStats(JsonObject& stats) override;
+
+private:
+    SubMediaType dst_type_;
+    std::unique_ptr<InPin> in_pin_;
+    std::unique_ptr<OutPin> out_pin_;
+    // 输出帧的分配方式，来自和下游协商的结果，只在节点的队列上访问
+    int out_alignment_ = MediaFrame::kDefaultAlignment;
+    int out_padding_ = 0;
+    std::atomic<SubMediaType> src_type_{ SubMediaType::kSubTypeCommon };//最近一帧的格式，用于统计
+    StatsCounter frames_converted_;
+    StatsCounter frames_passed_;
+    AverageCounter convert_time_us_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_FILTER_VIDEO_CONVERT_FILTER_H_
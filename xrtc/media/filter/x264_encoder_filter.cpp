@@ -0,0 +1,511 @@
+﻿#include "xrtc/media/filter/x264_encoder_filter.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <common_video/h264/h264_common.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/h264_bitstream.h"
+#include "xrtc/media/base/in_pin.h"
+#include "xrtc/media/base/out_pin.h"
+
+namespace xrtc {
+
+namespace {
+
+const int kMinBitrateKbps = 50;
+const int kMaxBitrateKbps = 50000;
+// VBV缓冲按0.5秒的码率，码率波动小，关键帧不会一次把网络打满
+const int kVbvBufferMs = 500;
+const int kMinIntraRefreshFrames = 2;
+
+// 关键帧之后第index帧的层号，结构见x264_encoder_filter.h
+int TemporalLayerOf(int temporal_layers, int index) {
+    static const int kL1T3Pattern[4] = { 0, 2, 1, 2 };
+    if (temporal_layers == 2) {
+        return index % 2;
+    }
+    if (temporal_layers == 3) {
+        return kL1T3Pattern[index % 4];
+    }
+    return 0;
+}
+
+// 分层时高层的帧在码流中仍是参考帧，frame_num逐帧递增，发送端丢掉之后接收端看到frame_num跳变，
+// 按SPS允许frame_num间隔处理(H.264 8.2.5.2)：丢掉的帧成为"不存在"的帧占住DPB的位置，
+// 剩下的帧只参考没有丢掉的帧，解码结果不变；否则跳变按丢包处理，接收端要错误隐藏或者请求关键帧
+bool AllowFrameNumGaps(const uint8_t* data, size_t size, std::vector<uint8_t>* out) {
+    bool rewritten = false;
+    std::vector<uint8_t> sps;
+    out->clear();
+    out->reserve(size + 8);
+    for (const auto& index : webrtc::H264::FindNaluIndices(data, size)) {
+        const uint8_t* nalu = data + index.payload_start_offset;
+        out->insert(out->end(), data + index.start_offset, nalu);
+        if (index.payload_size > 0 &&
+            webrtc::H264::ParseNaluType(nalu[0]) == webrtc::H264::kSps &&
+            H264Bitstream::AllowFrameNumGaps(nalu, index.payload_size, &sps))
+        {
+            out->insert(out->end(), sps.begin(), sps.end());
+            rewritten = true;
+        }
+        else {
+            out->insert(out->end(), nalu, nalu + index.payload_size);
+        }
+    }
+    return rewritten;
+}
+
+} // namespace
+
+X264EncoderFilter::X264EncoderFilter() :
+    MediaObject(NodeExecutor::kMediaPool),
+    in_pin_(std::make_unique<InPin>(this)),
+    out_pin_(std::make_unique<OutPin>(this))
+{
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeVideo;
+    fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeI420;
+    in_pin_->set_format(fmt);
+
+    // 对齐的平面x264走SIMD的快速路径
+    VideoCaps caps;
+    caps.types = { SubMediaType::kSubTypeI420 };
+    caps.alignment = MediaFrame::kDefaultAlignment;
+    in_pin_->set_video_caps(caps);
+
+    fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeH264;
+    out_pin_->set_format(fmt);
+
+    memset(&param_, 0, sizeof(param_));
+}
+
+X264EncoderFilter::~X264EncoderFilter() {
+    task_queue()->Stop();
+    CloseEncoder();
+}
+
+bool X264EncoderFilter::Start() {
+    return true;
+}
+
+void X264EncoderFilter::Setup(const std::string& json_config) {
+    ParseConfig(json_config);
+}
+
+void X264EncoderFilter::Update(const std::string& json_config) {
+    if (ParseConfig(json_config)) {
+        RTC_LOG(LS_INFO) << "X264EncoderFilter Update: " << json_config;
+    }
+}
+
+void X264EncoderFilter::Stop() {
+    RTC_LOG(LS_INFO) << "X264EncoderFilter Stop";
+}
+
+void X264EncoderFilter::GetStats(JsonObject& stats) {
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        stats["preset"] = preset_;
+        stats["profile"] = profile_;
+        stats["gop"] = gop_seconds_;
+        stats["keyframe_mode"] = intra_refresh_ ? "intra_refresh" : "idr";
+        stats["temporal_layers"] = temporal_layers_;
+    }
+    int64_t now = rtc::TimeMillis();
+    stats["width"] = width_stats_.load();
+    stats["height"] = height_stats_.load();
+    stats["target_kbps"] = target_bitrate_kbps_.load();
+    stats["kbps"] = bytes_.Rate(now) * 8 / 1000;
+    stats["encode_fps"] = frames_.Rate(now);
+    stats["frames"] = frames_.count();
+    JsonArray jlayers;
+    for (int i = 0; i < kMaxTemporalLayers; ++i) {
+        jlayers.Append(layer_frames_[i].count());
+    }
+    stats["layer_frames"] = jlayers;
+    stats["keyframes"] = keyframes_.count();
+    stats["keyframe_requests"] = keyframe_requests_.count();
+    stats["intra_refreshes"] = intra_refreshes_.count();
+    stats["keyframe_bytes"] = keyframe_bytes_.Average();
+    stats["max_keyframe_bytes"] = max_keyframe_bytes_.exchange(0);
+    stats["keyframe_interval_ms"] = keyframe_interval_ms_.Average();
+    int64_t bytes = bytes_.count();
+    stats["keyframe_bytes_percent"] = bytes > 0 ? keyframe_share_bytes_.load() * 100 / bytes : 0;
+    JsonObject jrequests;
+    keyframe_coalescer_.GetStats(jrequests);
+    stats["remote_keyframe_requests"] = jrequests;
+    stats["frames_rejected"] = frames_rejected_.count();
+    stats["encode_us"] = encode_time_us_.Average();
+}
+
+void X264EncoderFilter::RequestKeyFrame() {
+    keyframe_requests_.Add();
+    keyframe_requested_ = true;
+}
+
+void X264EncoderFilter::OnKeyFrameRequest(const RtcpKeyFrameRequest& request, int64_t rtt_ms) {
+    keyframe_coalescer_.OnRequest(request, rtt_ms, rtc::TimeMillis());
+}
+
+void X264EncoderFilter::SetTargetBitrate(int bitrate_bps) {
+    int max_kbps;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        max_kbps = max_bitrate_kbps_;
+    }
+    target_bitrate_kbps_ = std::min(max_kbps, std::max(kMinBitrateKbps, bitrate_bps / 1000));
+}
+
+bool X264EncoderFilter::ParseConfig(const std::string& json_config) {
+    JsonValue value;
+    if (!value.FromJson(json_config)) {
+        return false;
+    }
+
+    JsonObject jobject = value.ToObject();
+    if (!jobject.Has("x264_encoder")) {
+        return false;
+    }
+
+    JsonObject jx264 = jobject["x264_encoder"].ToObject();
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    max_bitrate_kbps_ = std::min(kMaxBitrateKbps, std::max(kMinBitrateKbps,
+        (int)jx264["max_bitrate"].ToInt(max_bitrate_kbps_)));
+    if (jx264.Has("bitrate")) {
+        bitrate_kbps_ = std::min(max_bitrate_kbps_, std::max(kMinBitrateKbps,
+            (int)jx264["bitrate"].ToInt(bitrate_kbps_)));
+        target_bitrate_kbps_ = bitrate_kbps_;
+    }
+    else if (target_bitrate_kbps_ > max_bitrate_kbps_) {
+        target_bitrate_kbps_ = max_bitrate_kbps_;
+    }
+
+    int fps = (int)jx264["fps"].ToInt(fps_);
+    int gop = (int)jx264["gop"].ToInt(gop_seconds_);
+    int threads = (int)jx264["threads"].ToInt(threads_);
+    std::string preset = jx264["preset"].ToString(preset_);
+    std::string profile = jx264["profile"].ToString(profile_);
+    std::string keyframe_mode = jx264["keyframe_mode"].ToString(
+        intra_refresh_ ? "intra_refresh" : "idr");
+    bool intra_refresh = keyframe_mode == "intra_refresh";
+    int intra_refresh_frames = std::max(kMinIntraRefreshFrames,
+        (int)jx264["intra_refresh_frames"].ToInt(intra_refresh_frames_));
+    int temporal_layers = std::min(kMaxTemporalLayers, std::max(1,
+        (int)jx264["temporal_layers"].ToInt(temporal_layers_)));
+    if ((fps > 0 && fps != fps_) || (gop > 0 && gop != gop_seconds_) ||
+        (threads >= 0 && threads != threads_) || preset != preset_ || profile != profile_ ||
+        intra_refresh != intra_refresh_ || intra_refresh_frames != intra_refresh_frames_ ||
+        temporal_layers != temporal_layers_)
+    {
+        fps_ = fps > 0 ? fps : fps_;
+        gop_seconds_ = gop > 0 ? gop : gop_seconds_;
+        threads_ = threads >= 0 ? threads : threads_;
+        preset_ = preset;
+        profile_ = profile;
+        intra_refresh_ = intra_refresh;
+        intra_refresh_frames_ = intra_refresh_frames;
+        temporal_layers_ = temporal_layers;
+        need_reopen_ = true;
+    }
+
+    KeyFrameRequestConfig keyframe_config;
+    keyframe_config.min_interval_ms = std::max(0,
+        (int)jx264["keyframe_min_interval_ms"].ToInt(keyframe_config.min_interval_ms));
+    keyframe_config.max_interval_ms = std::max(keyframe_config.min_interval_ms,
+        (int)jx264["keyframe_max_interval_ms"].ToInt(keyframe_config.max_interval_ms));
+    keyframe_coalescer_.SetConfig(keyframe_config);
+    return true;
+}
+
+bool X264EncoderFilter::OpenEncoder(int width, int height) {
+    CloseEncoder();
+
+    std::string preset;
+    std::string profile;
+    int fps;
+    int threads;
+    int keyint;
+    bool intra_refresh;
+    int temporal_layers;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        preset = preset_;
+        profile = profile_;
+        fps = input_fps_ > 0 ? std::min(input_fps_, fps_) : fps_;
+        threads = threads_;
+        intra_refresh = intra_refresh_;
+        keyint = intra_refresh ? intra_refresh_frames_ : fps * gop_seconds_;
+        temporal_layers = intra_refresh ? 1 : temporal_layers_;
+        need_reopen_ = false;
+    }
+
+    if (x264_param_default_preset(&param_, preset.c_str(), "zerolatency") < 0) {
+        RTC_LOG(LS_WARNING) << "X264EncoderFilter unknown preset: " << preset;
+        x264_param_default_preset(&param_, "ultrafast", "zerolatency");
+    }
+
+    param_.i_width = width;
+    param_.i_height = height;
+    param_.i_csp = X264_CSP_I420;
+    param_.i_fps_num = fps;
+    param_.i_fps_den = 1;
+    // 按固定帧率编码，码率控制和VBV按fps算每帧的时长，pts(毫秒)只原样带到输出帧上；
+    // 可变帧率时x264要等下一帧的时间戳才知道这一帧的时长，每帧晚一帧输出，
+    // 时域分层在编码前用x264_encoder_invalidate_reference选的参考帧也会错开一帧
+    param_.b_vfr_input = 0;
+    param_.i_threads = threads;
+    // 帧内刷新时keyint是一轮刷新的帧数
+    param_.i_keyint_max = keyint;
+    param_.b_intra_refresh = intra_refresh ? 1 : 0;
+    param_.i_log_level = X264_LOG_WARNING;
+    param_.b_annexb = 1;
+    param_.b_repeat_headers = 1;//每个关键帧前都带SPS/PPS，接收端中途加入也能解码
+    if (temporal_layers > 1) {
+        // 只有P帧，每帧只用一个参考帧，参考哪一帧由编码前的x264_encoder_invalidate_reference决定；
+        // DPB保留一个分层周期的帧，TL0隔一个周期仍然在DPB中，接收端丢掉高层之后也一样
+        param_.i_bframe = 0;
+        param_.i_frame_reference = 1;
+        param_.i_dpb_size = temporal_layers == 2 ? 2 : 4;
+    }
+
+    applied_bitrate_kbps_ = target_bitrate_kbps_.load();
+    param_.rc.i_rc_method = X264_RC_ABR;
+    param_.rc.i_bitrate = applied_bitrate_kbps_;
+    param_.rc.i_vbv_max_bitrate = applied_bitrate_kbps_;
+    param_.rc.i_vbv_buffer_size = applied_bitrate_kbps_ * kVbvBufferMs / 1000;
+
+    if (x264_param_apply_profile(&param_, profile.c_str()) < 0) {
+        RTC_LOG(LS_WARNING) << "X264EncoderFilter unknown profile: " << profile;
+    }
+
+    encoder_ = x264_encoder_open(&param_);
+    if (!encoder_) {
+        RTC_LOG(LS_WARNING) << "X264EncoderFilter open encoder failed, " << width << "x" << height;
+        return false;
+    }
+
+    width_ = width;
+    height_ = height;
+    applied_intra_refresh_ = intra_refresh;
+    applied_temporal_layers_ = temporal_layers;
+    temporal_index_ = 0;
+    width_stats_ = width;
+    height_stats_ = height;
+    RTC_LOG(LS_INFO) << "X264EncoderFilter open encoder " << width << "x" << height << "@" << fps
+        << ", preset: " << preset << ", profile: " << profile
+        << ", bitrate: " << applied_bitrate_kbps_ << "kbps, keyint: " << keyint
+        << ", intra refresh: " << intra_refresh << ", temporal layers: " << temporal_layers;
+    return true;
+}
+
+// 按分层结构给这一帧选参考帧，返回层号：TL0参考上一个TL0，TLk参考最近一个层号小于k的帧，
+// 比它新的帧都标记为不可参考(x264从参考列表中跳过)；标记只影响编码器，码流中仍是普通的P帧
+int X264EncoderFilter::SelectReference(int64_t pts) {
+    if (applied_temporal_layers_ <= 1) {
+        return 0;
+    }
+    if (temporal_index_ == 0) {
+        RestartTemporalPattern(pts);
+        return 0;
+    }
+
+    int temporal_id = TemporalLayerOf(applied_temporal_layers_, temporal_index_);
+    int64_t ref_pts = layer_pts_[0];
+    for (int i = 1; i < temporal_id; ++i) {
+        ref_pts = std::max(ref_pts, layer_pts_[i]);
+    }
+    if (last_pts_ > ref_pts && x264_encoder_invalidate_reference(encoder_, ref_pts + 1) < 0) {
+        RTC_LOG(LS_WARNING) << "X264EncoderFilter invalidate reference failed, pts: " << ref_pts + 1;
+    }
+
+    layer_pts_[temporal_id] = pts;
+    last_pts_ = pts;
+    ++temporal_index_;
+    return temporal_id;
+}
+
+void X264EncoderFilter::RestartTemporalPattern(int64_t idr_pts) {
+    for (int i = 0; i < kMaxTemporalLayers; ++i) {
+        layer_pts_[i] = -1;
+    }
+    layer_pts_[0] = idr_pts;
+    last_pts_ = idr_pts;
+    temporal_index_ = 1;
+}
+
+void X264EncoderFilter::CloseEncoder() {
+    if (encoder_) {
+        x264_encoder_close(encoder_);
+        encoder_ = nullptr;
+    }
+    pending_frames_.clear();
+}
+
+// 码率的变化通过x264_encoder_reconfig生效，不产生关键帧
+void X264EncoderFilter::ApplyConfig() {
+    int bitrate_kbps = target_bitrate_kbps_.load();
+    if (bitrate_kbps == applied_bitrate_kbps_) {
+        return;
+    }
+
+    param_.rc.i_bitrate = bitrate_kbps;
+    param_.rc.i_vbv_max_bitrate = bitrate_kbps;
+    param_.rc.i_vbv_buffer_size = bitrate_kbps * kVbvBufferMs / 1000;
+    if (x264_encoder_reconfig(encoder_, &param_) < 0) {
+        RTC_LOG(LS_WARNING) << "X264EncoderFilter reconfig bitrate failed: " << bitrate_kbps;
+    }
+    applied_bitrate_kbps_ = bitrate_kbps;
+}
+
+void X264EncoderFilter::OnFormatChanged(InPin* /*in_pin*/, const VideoStreamFormat& format) {
+    input_fps_ = format.fps;
+}
+
+void X264EncoderFilter::OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) {
+    const VideoFormat& fmt = frame->fmt.sub_fmt.video_fmt;
+    if (frame->fmt.media_type != MainMediaType::kMainTypeVideo ||
+        fmt.type != SubMediaType::kSubTypeI420 || fmt.width <= 0 || fmt.height <= 0)
+    {
+        frames_rejected_.Add();
+        return;
+    }
+
+    bool need_reopen;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        need_reopen = need_reopen_;
+    }
+
+    // 分辨率变化时重建编码器，第一帧是关键帧
+    if (!encoder_ || need_reopen || fmt.width != width_ || fmt.height != height_) {
+        if (!OpenEncoder(fmt.width, fmt.height)) {
+            frames_rejected_.Add();
+            return;
+        }
+        keyframe_requested_ = false;
+    }
+
+    ApplyConfig();
+
+    x264_picture_t pic_in;
+    x264_picture_t pic_out;
+    x264_picture_init(&pic_in);
+    pic_in.img.i_csp = X264_CSP_I420;
+    pic_in.img.i_plane = 3;
+    for (int i = 0; i < 3; ++i) {
+        pic_in.img.plane[i] = reinterpret_cast<uint8_t*>(frame->data[i]);
+        pic_in.img.i_stride[i] = frame->stride[i];
+    }
+    pic_in.i_pts = frame->ts;
+    pic_in.i_type = X264_TYPE_AUTO;
+    int64_t now = rtc::TimeMillis();
+    bool keyframe = keyframe_requested_.exchange(false);
+    keyframe = keyframe_coalescer_.Poll(now) || keyframe;
+    if (keyframe) {
+        // 帧内刷新：正在刷新时x264在这一轮结束后马上开始新的一轮
+        if (applied_intra_refresh_) {
+            x264_encoder_intra_refresh(encoder_);
+            intra_refreshes_.Add();
+            keyframe_coalescer_.OnKeyFrame(now);
+        }
+        else {
+            pic_in.i_type = X264_TYPE_IDR;
+        }
+    }
+
+    if (pic_in.i_type == X264_TYPE_IDR) {
+        temporal_index_ = 0;
+    }
+    int temporal_id = SelectReference(pic_in.i_pts);
+
+    x264_nal_t* nals = nullptr;
+    int num_nals = 0;
+    int64_t start_us = rtc::TimeMicros();
+    PendingFrame pending;
+    pending.pts = pic_in.i_pts;
+    pending.temporal_id = temporal_id;
+    pending.capture_time_ms = frame->capture_time_ms;
+    FrameTrace* trace = frame->TraceFor(tracer());
+    if (trace && frame->trace.compare_exchange_strong(trace, nullptr)) {
+        pending.trace.reset(trace);
+    }
+    pending_frames_.push_back(std::move(pending));
+
+    int size = x264_encoder_encode(encoder_, &nals, &num_nals, &pic_in, &pic_out);
+    encode_time_us_.Add(rtc::TimeMicros() - start_us);
+
+    if (size < 0) {
+        RTC_LOG(LS_WARNING) << "X264EncoderFilter encode failed";
+        pending_frames_.pop_back();
+        frames_rejected_.Add();
+        return;
+    }
+
+    if (size == 0 || num_nals <= 0) {
+        return;
+    }
+
+    // 一帧的所有NAL在x264的输出缓冲中是连续的；分层时关键帧带的SPS改为允许frame_num间隔
+    bool idr = pic_out.i_type == X264_TYPE_IDR;
+    const uint8_t* payload = nals[0].p_payload;
+    std::vector<uint8_t> rewritten;
+    if (idr && applied_temporal_layers_ > 1 && AllowFrameNumGaps(payload, size, &rewritten)) {
+        payload = rewritten.data();
+        size = (int)rewritten.size();
+    }
+    std::shared_ptr<MediaFrame> encoded = std::make_shared<MediaFrame>(size);
+    memcpy(encoded->data[0], payload, size);
+    encoded->data_len[0] = size;
+    encoded->fmt.media_type = MainMediaType::kMainTypeVideo;
+    encoded->fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeH264;
+    encoded->fmt.sub_fmt.video_fmt.width = width_;
+    encoded->fmt.sub_fmt.video_fmt.height = height_;
+    encoded->fmt.sub_fmt.video_fmt.idr = idr;
+    encoded->ts = (uint32_t)pic_out.i_pts;
+    encoded->capture_time_ms = frame->capture_time_ms;
+
+    int out_temporal_id = 0;
+    auto it = std::find_if(pending_frames_.begin(), pending_frames_.end(),
+        [&pic_out](const PendingFrame& f) { return f.pts == pic_out.i_pts; });
+    if (it != pending_frames_.end()) {
+        out_temporal_id = it->temporal_id;
+        encoded->capture_time_ms = it->capture_time_ms;
+        encoded->trace.store(it->trace.release(), std::memory_order_release);
+        pending_frames_.erase(it);
+    }
+    // x264按keyint自己插入的关键帧也从TL0重新开始
+    if (idr && out_temporal_id != 0) {
+        RestartTemporalPattern(pic_out.i_pts);
+        out_temporal_id = 0;
+    }
+    encoded->fmt.sub_fmt.video_fmt.temporal_id = out_temporal_id;
+    encoded->fmt.sub_fmt.video_fmt.discardable = applied_temporal_layers_ > 1 &&
+        out_temporal_id == applied_temporal_layers_ - 1;
+
+    frames_.Add();
+    layer_frames_[out_temporal_id].Add();
+    bytes_.Add(size);
+    if (idr) {
+        keyframes_.Add();
+        keyframe_bytes_.Add(size);
+        keyframe_share_bytes_ += size;
+        if (last_keyframe_ms_ > 0) {
+            keyframe_interval_ms_.Add(now - last_keyframe_ms_);
+        }
+        last_keyframe_ms_ = now;
+        keyframe_coalescer_.OnKeyFrame(now);
+        if (size > max_keyframe_bytes_.load()) {
+            max_keyframe_bytes_ = size;
+        }
+    }
+
+    out_pin_->PushMediaFrame(encoded);
+}
+
+} // namespace xrtc
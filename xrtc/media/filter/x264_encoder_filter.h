@@ -0,0 +1,141 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_FILTER_X264_ENCODER_FILTER_H_
+#define XRTCSDK_XRTC_MEDIA_FILTER_X264_ENCODER_FILTER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+
+extern "C" {
+#include <x264.h>
+}
+
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/media/base/media_chain.h"
+#include "xrtc/rtc/keyframe_request_coalescer.h"
+
+namespace xrtc {
+
+// H264编码节点(x264)：输入I420，每帧输出一个Annex-B的访问单元，关键帧前带SPS/PPS
+// 在媒体线程池上执行，低延时配置(zerolatency：没有B帧和lookahead，一帧进一帧出)
+// 配置：{"x264_encoder":{"bitrate":1500,"max_bitrate":2500,"fps":30,"gop":2,
+//        "preset":"ultrafast","profile":"baseline","threads":0,"temporal_layers":1,
+//        "keyframe_mode":"idr","intra_refresh_frames":30,
+//        "keyframe_min_interval_ms":300,"keyframe_max_interval_ms":2000}}
+// bitrate/max_bitrate单位kbps，gop单位秒，threads为0时由x264按核数决定
+// keyframe_mode为intra_refresh时用周期帧内刷新代替IDR(只有第一帧是IDR)：每intra_refresh_frames帧
+// 刷新一遍画面，码率没有关键帧的尖峰，gop不再使用；关键帧请求开始新一轮刷新
+// 输出帧的VideoFormat::idr只标记真正的IDR，帧内刷新的恢复点不算
+// temporal_layers为2/3时做时域分层(L1T2/L1T3)，输出帧带temporal_id和discardable，发送端拥塞时
+// 先丢高层的帧。分层是只有P帧的hierarchical P，没有B帧，不增加延时，baseline也可以用：
+//   L1T2: TL0 TL1 TL0 TL1 ...       TL1参考前一个TL0，不被参考
+//   L1T3: TL0 TL2 TL1 TL2 TL0 ...   TL1参考前一个TL0，TL2参考前一个TL0/TL1，TL2不被参考
+// x264没有逐帧指定参考帧的接口，每帧只用一个参考(ref=1)，编码前用x264_encoder_invalidate_reference
+// 把比应该参考的帧更新的帧去掉；关键帧之后重新从TL0开始。高层的帧在码流中仍是参考帧，SPS改为
+// 允许frame_num间隔，发送端或者中间节点丢掉高层之后码流仍然合法。和帧内刷新不能同时使用，同时配置时不分层
+class X264EncoderFilter : public MediaObject {
+public:
+    X264EncoderFilter();
+    ~X264EncoderFilter() override;
+
+    // MediaObject
+    bool Start() override;
+    void Setup(const std::string& json_config) override;
+    void Update(const std::string& json_config) override;
+    void Stop() override;
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>({ in_pin_.get() });
+    }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>({ out_pin_.get() });
+    }
+    const char* name() const override { return "x264_encoder"; }
+    void GetStats(JsonObject& stats) override;
+    void OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) override;
+    void OnFormatChanged(InPin* in_pin, const VideoStreamFormat& format) override;
+
+    // 以下可以在任意线程调用(例如网络线程收到RTCP时)，下一帧编码前生效
+    // 本地的请求(刚连通、路径切换)，不经过合并，下一帧立即生成
+    void RequestKeyFrame();
+    // 接收端的PLI/FIR，按RTT合并和限频，见KeyFrameRequestCoalescer
+    void OnKeyFrameRequest(const RtcpKeyFrameRequest& request, int64_t rtt_ms);
+    // 拥塞控制给出的码率，不超过配置的max_bitrate
+    void SetTargetBitrate(int bitrate_bps);
+
+    static const int kMaxTemporalLayers = 3;
+
+private:
+    bool ParseConfig(const std::string& json_config);
+    bool OpenEncoder(int width, int height);
+    void CloseEncoder();
+    int SelectReference(int64_t pts);
+    void RestartTemporalPattern(int64_t idr_pts);
+    void ApplyConfig();
+
+private:
+    std::unique_ptr<InPin> in_pin_;
+    std::unique_ptr<OutPin> out_pin_;
+
+    // 配置，Setup/Update写，编码线程读
+    std::mutex config_mutex_;
+    int bitrate_kbps_ = 1500;
+    int max_bitrate_kbps_ = 2500;
+    int fps_ = 30;
+    int gop_seconds_ = 2;
+    std::string preset_ = "ultrafast";
+    std::string profile_ = "baseline";
+    int threads_ = 0;
+    bool intra_refresh_ = false;
+    int intra_refresh_frames_ = 30;
+    int temporal_layers_ = 1;
+    bool need_reopen_ = false;//preset/profile/threads/gop/keyframe_mode只能重建编码器生效
+
+    // 网络反馈，任意线程写
+    std::atomic<int> target_bitrate_kbps_{ 1500 };
+    std::atomic<bool> keyframe_requested_{ false };
+    KeyFrameRequestCoalescer keyframe_coalescer_;
+
+    // 以下只在编码线程上访问
+    x264_t* encoder_ = nullptr;
+    x264_param_t param_;
+    int width_ = 0;
+    int height_ = 0;
+    int input_fps_ = 0;//协商出的输入帧率
+    int applied_bitrate_kbps_ = 0;
+    bool applied_intra_refresh_ = false;
+    int applied_temporal_layers_ = 1;
+    int temporal_index_ = 0;//关键帧之后的帧序号，决定层号
+    int64_t layer_pts_[kMaxTemporalLayers];//每层最近一帧的pts，-1表示关键帧之后还没有
+    int64_t last_pts_ = -1;
+    int64_t last_keyframe_ms_ = 0;
+    // 按pts找回输入帧的采集时间、层号和延时跟踪记录
+    struct PendingFrame {
+        int64_t pts;
+        int64_t capture_time_ms;
+        int temporal_id;
+        std::unique_ptr<FrameTrace> trace;
+    };
+    std::deque<PendingFrame> pending_frames_;
+
+    // 统计
+    StatsCounter frames_;
+    StatsCounter keyframes_;
+    StatsCounter keyframe_requests_;
+    StatsCounter intra_refreshes_;
+    StatsCounter layer_frames_[kMaxTemporalLayers];
+    AverageCounter keyframe_bytes_;
+    AverageCounter keyframe_interval_ms_;
+    std::atomic<int64_t> max_keyframe_bytes_{ 0 };
+    std::atomic<int64_t> keyframe_share_bytes_{ 0 };//关键帧的总字节数，和bytes_一起算占比
+    StatsCounter bytes_;
+    StatsCounter frames_rejected_;
+    AverageCounter encode_time_us_;
+    std::atomic<int> width_stats_{ 0 };
+    std::atomic<int> height_stats_{ 0 };
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_FILTER_X264_ENCODER_FILTER_H_
@@ -1,30 +1,45 @@
 ﻿#include "xrtc/media/sink/d3d9_render_sink.h"
 
-#include <rtc_base/task_utils/to_queued_task.h>
 #include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
 #include <d3d9.h>
 #include <libyuv.h>
 
-#include "xrtc/base/xrtc_global.h"
+#include "xrtc/media/base/frame_tracer.h"
 #include "xrtc/media/base/in_pin.h"
+#include "xrtc/media/base/video_convert.h"
 #include <xrtc/base/xrtc_json.h>
 
 namespace xrtc {
 
+namespace {
+
+// 渲染队列不固定线程，去掉D3DCREATE_MULTITHREADED之前需要把节点改成kInline或者专用线程
+const DWORD kDeviceFlags = D3DCREATE_MIXED_VERTEXPROCESSING | D3DCREATE_MULTITHREADED;
+
+} // namespace
+
+// 每个渲染节点在媒体线程池上有自己的串行队列，多路预览可以并行渲染
+// 渲染跟不上时只渲染最新的一帧，预览延时不会超过一帧
 D3D9RenderSink::D3D9RenderSink() :
+    MediaObject(NodeExecutor::kMediaPoolLatest),
     in_pin_(std::make_unique<InPin>(this))
 {
     MediaFormat fmt;
     fmt.media_type = MainMediaType::kMainTypeVideo;
     fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeI420;
     in_pin_->set_format(fmt);
-   
+    // 每种格式到ARGB都有直接转换，上游不需要先转成I420
+    in_pin_->set_video_types({ SubMediaType::kSubTypeI420, SubMediaType::kSubTypeNV12,
+        SubMediaType::kSubTypeYUY2, SubMediaType::kSubTypeARGB, SubMediaType::kSubTypeI420A });
 }
 
 D3D9RenderSink::~D3D9RenderSink() {
+    task_queue()->Stop();
 }
 
 bool D3D9RenderSink::Start() {
+    running_ = true;
     return true;
 }
 //渲染窗口句柄成功传递到d3d9
@@ -48,8 +63,7 @@ void D3D9RenderSink::Setup(const std::string& json_config)
         JsonObject jobject = value.ToObject();
         JsonObject jd3d9 = jobject["d3d9_render_sink"].ToObject();
 
-        int hwnd_int = jd3d9["hwnd"].ToInt();
-        hwnd_ = (HWND)(intptr_t)hwnd_int;
+        hwnd_ = (HWND)(intptr_t)jd3d9["hwnd"].ToInt();
 
         RTC_LOG(LS_INFO) << "D3D9RenderSink::Setup hwnd set to: " << hwnd_;
 
@@ -78,8 +92,63 @@ void D3D9RenderSink::Setup(const std::string& json_config)
 }
 
 
+// 运行中更换渲染窗口，D3D9对象在渲染队列上释放，下一帧到来时TryInit重新创建
+void D3D9RenderSink::Update(const std::string& json_config) {
+    JsonValue value;
+    if (!value.FromJson(json_config)) {
+        return;
+    }
+
+    JsonObject jobject = value.ToObject();
+    if (!jobject.Has("d3d9_render_sink")) {
+        return;
+    }
+
+    JsonObject jd3d9 = jobject["d3d9_render_sink"].ToObject();
+    if (!jd3d9.Has("hwnd")) {
+        return;
+    }
+
+    HWND hwnd = (HWND)(intptr_t)jd3d9["hwnd"].ToInt();
+    task_queue()->PostTask([=]() {
+        if (hwnd == hwnd_) {
+            return;
+        }
+
+        RTC_LOG(LS_INFO) << "D3D9RenderSink::Update hwnd: " << hwnd_ << " -> " << hwnd;
+        hwnd_ = hwnd;
+        ReleaseD3D9();
+    });
+}
+
 void D3D9RenderSink::Stop() {
     RTC_LOG(LS_INFO) << "D3D9RenderSink Stop";
+    running_ = false;
+
+    // 在渲染队列上释放，保证不会和正在进行的渲染冲突
+    task_queue()->Invoke([=]() {
+        ReleaseD3D9();
+
+        if (rgb_buffer_) {
+            delete[] rgb_buffer_;
+            rgb_buffer_ = nullptr;
+            rgb_buffer_size_ = 0;
+        }
+    });
+}
+
+void D3D9RenderSink::GetStats(JsonObject& stats) {
+    stats["render_fps"] = frames_rendered_.Rate(rtc::TimeMillis());
+    stats["frames_rendered"] = frames_rendered_.count();
+    stats["render_us"] = render_time_us_.Average();
+    stats["queue_depth"] = task_queue()->pending();
+    stats["frames_dropped"] = in_pin_->dropped();
+    stats["frames_mismatched"] = frames_mismatched_.count();
+    stats["width"] = width_;
+    stats["height"] = height_;
+}
+
+void D3D9RenderSink::ReleaseD3D9() {
     if (d3d9_surface_) {
         d3d9_surface_->Release();
         d3d9_surface_ = nullptr;
@@ -94,66 +163,79 @@ void D3D9RenderSink::Stop() {
         d3d9_->Release();
         d3d9_ = nullptr;
     }
+}
+
+// 在渲染队列上执行，和帧的顺序一致：离屏表面按新的宽高重建，RGB缓冲预先分配
+void D3D9RenderSink::OnFormatChanged(InPin* /*in_pin*/, const VideoStreamFormat& format) {
+    if (format.width <= 0 || format.height <= 0 ||
+        (format.width == width_ && format.height == height_))
+    {
+        return;
+    }
 
+    RTC_LOG(LS_INFO) << "D3D9RenderSink::OnFormatChanged " << width_ << "x" << height_
+        << " -> " << VideoStreamFormatString(format);
+    resize_ts_ = last_present_ts_;
+    width_ = format.width;
+    height_ = format.height;
+    ResizeRgbBuffer(width_ * height_ * 4);
+
+    if (d3d9_surface_) {
+        d3d9_surface_->Release();
+        d3d9_surface_ = nullptr;
+    }
+}
+
+void D3D9RenderSink::ResizeRgbBuffer(int size) {
+    if (rgb_buffer_size_ == size) {
+        return;
+    }
+
+    RTC_LOG(LS_INFO) << "D3D9RenderSink allocating RGB buffer with size: " << size;
     if (rgb_buffer_) {
         delete[] rgb_buffer_;
-        rgb_buffer_ = nullptr;
-        rgb_buffer_size_ = 0;
     }
-    
+
+    rgb_buffer_ = new char[size];
+    rgb_buffer_size_ = size;
 }
 
+// 在渲染队列上执行，同一个sink的帧按顺序渲染
 void D3D9RenderSink::OnNewMediaFrame(std::shared_ptr<MediaFrame> frame)
 {
-    // worker_thread执行渲染工作
-   /* XRTCGlobal::Instance()->worker_thread()->PostTask(webrtc::ToQueuedTask([=]() {
-        if (!TryInit(frame)) {
-            return;
-        }
-
-        DoRender(frame);
-        }));*/
-
-    RTC_LOG(LS_INFO) << "D3D9RenderSink::OnNewMediaFrame received frame, width: "
-        << frame->fmt.sub_fmt.video_fmt.width
-        << ", height: " << frame->fmt.sub_fmt.video_fmt.height;
+    if (!running_) {
+        return;
+    }
 
-    // worker_thread执行渲染工作
-    XRTCGlobal::Instance()->worker_thread()->PostTask(webrtc::ToQueuedTask([=]() {
-        RTC_LOG(LS_INFO) << "D3D9RenderSink::OnNewMediaFrame worker thread task started";
+    // 宽高变化由OnFormatChanged提前通知，上游没有重新协商时按帧的宽高补一次
+    if (frame->fmt.sub_fmt.video_fmt.width != width_ ||
+        frame->fmt.sub_fmt.video_fmt.height != height_)
+    {
+        frames_mismatched_.Add();
+        VideoStreamFormat format;
+        format.type = frame->fmt.sub_fmt.video_fmt.type;
+        format.width = frame->fmt.sub_fmt.video_fmt.width;
+        format.height = frame->fmt.sub_fmt.video_fmt.height;
+        OnFormatChanged(in_pin_.get(), format);
+    }
 
-        if (!TryInit(frame)) {
-            RTC_LOG(LS_WARNING) << "D3D9RenderSink::TryInit failed";
-            return;
-        }
+    if (!TryInit()) {
+        RTC_LOG(LS_WARNING) << "D3D9RenderSink::TryInit failed";
+        return;
+    }
 
-        RTC_LOG(LS_INFO) << "D3D9RenderSink::TryInit succeeded, proceeding to DoRender";
-        DoRender(frame);
-        }));
+    RTC_LOG(LS_INFO) << "D3D9RenderSink::TryInit succeeded, proceeding to DoRender";
+    DoRender(frame);
 }
 
-bool D3D9RenderSink::TryInit(std::shared_ptr<MediaFrame> frame)
+// D3D9对象在窗口更换、格式变化后释放，这里按协商的宽高重新创建
+bool D3D9RenderSink::TryInit()
 {
-    RTC_LOG(LS_INFO) << "D3D9RenderSink::TryInit called with hwnd: " << hwnd_;
-
-    do {
-        if (!d3d9_ || !d3d9_device_ || !d3d9_surface_) {
-            RTC_LOG(LS_INFO) << "D3D9RenderSink::TryInit need to initialize D3D9 objects";
-            break;
-        }
-
-        if (width_ != frame->fmt.sub_fmt.video_fmt.width ||
-            height_ != frame->fmt.sub_fmt.video_fmt.height)
-        {
-            RTC_LOG(LS_INFO) << "D3D9RenderSink::TryInit frame size changed, need to reinitialize";
-            RTC_LOG(LS_INFO) << "Current size: " << width_ << "x" << height_
-                << ", new size: " << frame->fmt.sub_fmt.video_fmt.width
-                << "x" << frame->fmt.sub_fmt.video_fmt.height;
-            break;
-        }
-        RTC_LOG(LS_INFO) << "D3D9RenderSink::TryInit no need to reinitialize";
+    if (d3d9_ && d3d9_device_ && d3d9_surface_) {
         return true;
-    } while (false);
+    }
+
+    RTC_LOG(LS_INFO) << "D3D9RenderSink::TryInit need to initialize D3D9 objects, hwnd: " << hwnd_;
 
     if (!IsWindow(hwnd_)) {
         RTC_LOG(LS_WARNING) << "Invalid hwnd: " << hwnd_;
@@ -196,8 +278,8 @@ bool D3D9RenderSink::TryInit(std::shared_ptr<MediaFrame> frame)
             D3DADAPTER_DEFAULT, // 指定要表示的物理设备，默认主显示器
             D3DDEVTYPE_HAL, // 支持硬件加速
             hwnd_, // 渲染窗口句柄
-            // 定点处理方式，多线程处理
-            D3DCREATE_MIXED_VERTEXPROCESSING | D3DCREATE_MULTITHREADED,
+            // 定点处理方式；渲染队列在线程池的不同线程上执行，必须多线程模式
+            kDeviceFlags,
             &d3dpp,
             &d3d9_device_
         );
@@ -217,12 +299,11 @@ bool D3D9RenderSink::TryInit(std::shared_ptr<MediaFrame> frame)
     }
 
     RTC_LOG(LS_INFO) << "D3D9RenderSink::TryInit creating offscreen surface with size: "
-        << frame->fmt.sub_fmt.video_fmt.width << "x"
-        << frame->fmt.sub_fmt.video_fmt.height;
+        << width_ << "x" << height_;
 
     HRESULT res = d3d9_device_->CreateOffscreenPlainSurface(
-        frame->fmt.sub_fmt.video_fmt.width,
-        frame->fmt.sub_fmt.video_fmt.height,
+        width_,
+        height_,
         D3DFMT_X8R8G8B8,
         D3DPOOL_DEFAULT,
         &d3d9_surface_,
@@ -236,9 +317,6 @@ bool D3D9RenderSink::TryInit(std::shared_ptr<MediaFrame> frame)
 
     RTC_LOG(LS_INFO) << "D3D9RenderSink::TryInit offscreen surface created successfully";
 
-    width_ = frame->fmt.sub_fmt.video_fmt.width;
-    height_ = frame->fmt.sub_fmt.video_fmt.height;
-
     RTC_LOG(LS_INFO) << "D3D9RenderSink::TryInit initialization completed successfully";
     return true;
 
@@ -331,27 +409,18 @@ void D3D9RenderSink::DoRender(std::shared_ptr<MediaFrame> frame)
 {
     RTC_LOG(LS_INFO) << "D3D9RenderSink::DoRender called";
 
-    // 1. 创建RGB buffer，将YUV格式转换成RGB格式
-    if (SubMediaType::kSubTypeI420 == frame->fmt.sub_fmt.video_fmt.type) {
-        int size = frame->fmt.sub_fmt.video_fmt.width *
-            frame->fmt.sub_fmt.video_fmt.height * 4;
-        if (rgb_buffer_size_ != size) {//刚开始/视频过程中发生宽高变化
-            RTC_LOG(LS_INFO) << "D3D9RenderSink::DoRender allocating RGB buffer with size: " << size;
-            if (rgb_buffer_) {
-                delete[] rgb_buffer_;
-            }
+    FrameTrace* trace = frame->TraceFor(tracer());
+    int64_t convert_start_us = rtc::TimeMicros();
 
-            rgb_buffer_ = new char[size];
-            rgb_buffer_size_ = size;
-        }
+    // 1. 创建RGB buffer，将YUV格式转换成RGB格式
+    if (IsRawVideoType(frame->fmt.sub_fmt.video_fmt.type)) {
+        // 通常已经在OnFormatChanged中分配，Stop释放之后重新开始时在这里补上
+        ResizeRgbBuffer(width_ * height_ * 4);
 
         // YUV格式转换成RGB
-        RTC_LOG(LS_INFO) << "D3D9RenderSink::DoRender converting I420 to ARGB";
-        libyuv::I420ToARGB((const uint8_t*)frame->data[0], frame->stride[0],
-            (const uint8_t*)frame->data[1], frame->stride[1],
-            (const uint8_t*)frame->data[2], frame->stride[2],
-            (uint8_t*)rgb_buffer_, width_ * 4,
-            width_, height_);
+        RTC_LOG(LS_INFO) << "D3D9RenderSink::DoRender converting "
+            << SubMediaTypeName(frame->fmt.sub_fmt.video_fmt.type) << " to ARGB";
+        ConvertToARGB(*frame, (uint8_t*)rgb_buffer_, width_ * 4);
     }
     //// 1. 创建RGB buffer，将YUV格式转换成RGB格式
     //if (SubMediaType::kSubTypeI420 == frame->fmt.sub_fmt.video_fmt.type) {
@@ -374,6 +443,12 @@ void D3D9RenderSink::DoRender(std::shared_ptr<MediaFrame> frame)
     //        width_, height_);
     //}
 
+    int64_t present_start_us = 0;
+    if (trace) {
+        present_start_us = rtc::TimeMicros();
+        trace->AddSpan("d3d9_render_sink.convert", convert_start_us, present_start_us);
+    }
+
     // 2. 将RGB数据拷贝到离屏表面
     // 2.1 锁定区域
     HRESULT res;
@@ -394,7 +469,7 @@ void D3D9RenderSink::DoRender(std::shared_ptr<MediaFrame> frame)
     // 锁定区域每一行的数据大小
     int stride = d3d9_rect.Pitch;
 
-    if (SubMediaType::kSubTypeI420 == frame->fmt.sub_fmt.video_fmt.type) {
+    if (IsRawVideoType(frame->fmt.sub_fmt.video_fmt.type)) {
         int video_width = frame->fmt.sub_fmt.video_fmt.width;
         int video_height = frame->fmt.sub_fmt.video_fmt.height;
         int video_stride = video_width * 4;
@@ -471,6 +546,22 @@ void D3D9RenderSink::DoRender(std::shared_ptr<MediaFrame> frame)
 
     // 6. 释放后台缓冲
     pback_buffer->Release();
+
+    frames_rendered_.Add();
+    render_time_us_.Add(rtc::TimeMicros() - convert_start_us);
+
+    int64_t now = rtc::TimeMillis();
+    if (resize_ts_ != 0) {
+        RTC_LOG(LS_INFO) << "D3D9RenderSink resolution switch glitch: "
+            << now - resize_ts_ << "ms";
+        resize_ts_ = 0;
+    }
+    last_present_ts_ = now;
+
+    if (trace) {
+        trace->AddSpan("d3d9_render_sink.present", present_start_us, rtc::TimeMicros());
+        trace->tracer->End(frame.get(), name());
+    }
 }
 
 
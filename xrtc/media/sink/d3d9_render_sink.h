@@ -3,6 +3,9 @@
 
 #include <windows.h>
 
+#include <atomic>
+
+#include "xrtc/base/xrtc_stats.h"
 #include "xrtc/media/base/media_chain.h"
 
 struct IDirect3D9;
@@ -21,6 +24,7 @@ public:
     // MediaObject
     bool Start() override;
     void Setup(const std::string& json_config) override;
+    void Update(const std::string& json_config) override;
     void Stop() override;
     std::vector<InPin*> GetAllInPins() override {
         return std::vector<InPin*>({ in_pin_.get() });
@@ -28,16 +32,22 @@ public:
     std::vector<OutPin*> GetAllOutPins() override {
         return std::vector<OutPin*>();
     }
+    const char* name() const override { return "d3d9_render_sink"; }
+    void GetStats(JsonObject& stats) override;
 
     void OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) override;
+    void OnFormatChanged(InPin* in_pin, const VideoStreamFormat& format) override;
 
 private:
-    bool TryInit(std::shared_ptr<MediaFrame> frame) ;
+    bool TryInit();
+    void ResizeRgbBuffer(int size);
     void DoRender(std::shared_ptr<MediaFrame> frame) ;
+    void ReleaseD3D9();
 
 private:
     std::unique_ptr<InPin> in_pin_;//d3d9只有输入没有输出
     HWND hwnd_ = nullptr;
+    std::atomic<bool> running_{ false };
 
     IDirect3D9* d3d9_ = nullptr;
     IDirect3DDevice9* d3d9_device_ = nullptr;
@@ -49,6 +59,15 @@ private:
 
     char* rgb_buffer_ = nullptr;
     int rgb_buffer_size_ = 0;
+
+    // 分辨率切换时画面停顿的统计
+    int64_t last_present_ts_ = 0;
+    int64_t resize_ts_ = 0;
+
+    // 统计
+    StatsCounter frames_rendered_;
+    AverageCounter render_time_us_;//转换+上屏的耗时
+    StatsCounter frames_mismatched_;//上游没有重新协商就改变了宽高的次数
     
 };
 
@@ -0,0 +1,413 @@
+﻿#include "xrtc/media/sink/file_record_sink.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <common_video/h264/h264_common.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/task_pool.h"
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/frame_tracer.h"
+#include "xrtc/media/base/in_pin.h"
+#include "xrtc/media/sink/fmp4_muxer.h"
+
+namespace xrtc {
+
+namespace {
+
+const int kIvfHeaderSize = 32;
+const int kIvfFrameHeaderSize = 12;
+const int kIvfFrameCountOffset = 24;
+const int kDefaultFps = 30;
+// moof+mdat的头部大小上限，用于积压检查
+const int kMp4FragmentOverhead = 256;
+const char kY4mFrameHeader[] = "FRAME\n";
+
+void PutLE16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+void PutLE32(uint8_t* p, uint32_t v) {
+    PutLE16(p, (uint16_t)v);
+    PutLE16(p + 2, (uint16_t)(v >> 16));
+}
+
+const char* FormatName(FileRecordSink::Format format) {
+    switch (format) {
+    case FileRecordSink::Format::kAnnexB:
+        return "h264";
+    case FileRecordSink::Format::kIvf:
+        return "ivf";
+    case FileRecordSink::Format::kMp4:
+        return "mp4";
+    case FileRecordSink::Format::kY4m:
+        return "y4m";
+    }
+    return "unknown";
+}
+
+bool HasIdrNalu(const uint8_t* data, size_t size) {
+    for (const auto& index : webrtc::H264::FindNaluIndices(data, size)) {
+        if (index.payload_size > 0 &&
+            webrtc::H264::ParseNaluType(data[index.payload_start_offset]) == webrtc::H264::kIdr)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+FileRecordSink::FileRecordSink(const std::string& path) :
+    MediaObject(NodeExecutor::kMediaPool),
+    path_(path),
+    in_pin_(std::make_unique<InPin>(this))
+{
+    if (!ParseFormat(path_, &format_)) {
+        RTC_LOG(LS_WARNING) << "FileRecordSink unknown extension, record as h264: " << path_;
+    }
+
+    SubMediaType type = format_ == Format::kY4m ? SubMediaType::kSubTypeI420 :
+        SubMediaType::kSubTypeH264;
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeVideo;
+    fmt.sub_fmt.video_fmt.type = type;
+    in_pin_->set_format(fmt);
+    in_pin_->set_video_types({ type });
+}
+
+FileRecordSink::~FileRecordSink() {
+    task_queue()->Stop();
+    CloseFile();
+}
+
+bool FileRecordSink::ParseFormat(const std::string& path, Format* format) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+
+    std::string ext = path.substr(dot + 1);
+    for (char& c : ext) {
+        c = (char)tolower((unsigned char)c);
+    }
+
+    if (ext == "h264" || ext == "264") {
+        *format = Format::kAnnexB;
+    }
+    else if (ext == "ivf") {
+        *format = Format::kIvf;
+    }
+    else if (ext == "mp4") {
+        *format = Format::kMp4;
+    }
+    else if (ext == "y4m") {
+        *format = Format::kY4m;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// 只在Start之前生效，录制过程中不切换缓冲和IO方式
+void FileRecordSink::Setup(const std::string& json_config) {
+    JsonValue value;
+    if (!value.FromJson(json_config)) {
+        return;
+    }
+
+    JsonObject jobject = value.ToObject();
+    if (!jobject.Has("file_record")) {
+        return;
+    }
+
+    JsonObject jrecord = jobject["file_record"].ToObject();
+    int buffer_kb = (int)jrecord["buffer_kb"].ToInt((int)(options_.buffer_size / 1024));
+    if (buffer_kb >= 64) {
+        options_.buffer_size = (size_t)buffer_kb * 1024;
+    }
+    int max_queue_mb = (int)jrecord["max_queue_mb"].ToInt(
+        (int)(options_.max_queue_bytes / (1024 * 1024)));
+    if (max_queue_mb > 0) {
+        options_.max_queue_bytes = (size_t)max_queue_mb * 1024 * 1024;
+    }
+    options_.direct_io = jrecord["direct_io"].ToBool(options_.direct_io);
+    int preallocate_mb = (int)jrecord["preallocate_mb"].ToInt(0);
+    if (preallocate_mb >= 0) {
+        options_.preallocate_bytes = (int64_t)preallocate_mb * 1024 * 1024;
+    }
+}
+
+bool FileRecordSink::Start() {
+    RTC_LOG(LS_INFO) << "FileRecordSink Start, path: " << path_
+        << ", format: " << FormatName(format_);
+    task_queue()->Invoke([this]() {
+        OpenFile();
+    });
+    running_ = writer_.is_open();
+    return running_;
+}
+
+void FileRecordSink::Stop() {
+    RTC_LOG(LS_INFO) << "FileRecordSink Stop";
+    running_ = false;
+    task_queue()->Invoke([this]() {
+        CloseFile();
+    });
+}
+
+void FileRecordSink::GetStats(JsonObject& stats) {
+    int64_t now = rtc::TimeMillis();
+    stats["path"] = path_;
+    stats["format"] = FormatName(format_);
+    stats["frames_written"] = frames_written_.count();
+    stats["frames_dropped"] = frames_dropped_.count();
+    stats["bytes_written"] = writer_.bytes_written();
+    stats["write_mbps"] = writer_.write_rate(now) * 8 / 1000000;
+    stats["queue_depth"] = writer_.queue_depth();
+    stats["queue_bytes"] = writer_.queue_bytes();
+    stats["max_queue_depth"] = writer_.max_queue_depth();
+    stats["write_us"] = writer_.write_us();
+    stats["write_errors"] = writer_.errors();
+    stats["direct_io"] = writer_.direct_io();
+}
+
+void FileRecordSink::OnFormatChanged(InPin* /*in_pin*/, const VideoStreamFormat& format) {
+    if (format.fps > 0) {
+        fps_ = format.fps;
+    }
+}
+
+void FileRecordSink::OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) {
+    if (!running_ || !writer_.is_open()) {
+        return;
+    }
+
+    bool written = format_ == Format::kY4m ? WriteY4m(frame.get()) : WriteH264(frame.get());
+    if (written) {
+        frames_written_.Add();
+    }
+    else {
+        frames_dropped_.Add();
+    }
+
+    FrameTrace* trace = frame->TraceFor(tracer());
+    if (trace) {
+        trace->tracer->End(frame.get(), name());
+    }
+}
+
+void FileRecordSink::OpenFile() {
+    if (writer_.is_open()) {
+        return;
+    }
+
+    header_written_ = false;
+    wait_keyframe_ = true;
+    ivf_frames_ = 0;
+    mp4_sample_.clear();
+    mp4_dts_ = 0;
+    mp4_sequence_ = 0;
+    if (!writer_.Open(path_, options_)) {
+        RTC_LOG(LS_WARNING) << "FileRecordSink open file failed: " << path_;
+    }
+}
+
+void FileRecordSink::CloseFile() {
+    if (!writer_.is_open()) {
+        return;
+    }
+
+    if (format_ == Format::kMp4 && !mp4_sample_.empty()) {
+        FlushMp4Sample(Fmp4Muxer::kTimescale / (fps_ > 0 ? fps_ : kDefaultFps));
+    }
+    if (format_ == Format::kIvf && header_written_) {
+        uint8_t count[4];
+        PutLE32(count, ivf_frames_);
+        writer_.WriteAt(kIvfFrameCountOffset, count, sizeof(count));
+    }
+    writer_.Close();
+    RTC_LOG(LS_INFO) << "FileRecordSink closed " << path_ << ", bytes: "
+        << writer_.bytes_written() << ", frames: " << frames_written_.count()
+        << ", dropped: " << frames_dropped_.count();
+}
+
+bool FileRecordSink::WriteH264(const MediaFrame* frame) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(frame->data[0]);
+    size_t size = frame->data_len[0];
+    if (!data || size == 0) {
+        return false;
+    }
+
+    bool idr = frame->fmt.sub_fmt.video_fmt.idr || HasIdrNalu(data, size);
+    if (wait_keyframe_ && !idr) {
+        return false;
+    }
+
+    // 积压超过上限时丢掉这一帧，之后的P帧参考不到它，等下一个关键帧再继续写
+    if (!writer_.CanWrite(size + kIvfHeaderSize + kIvfFrameHeaderSize)) {
+        wait_keyframe_ = true;
+        return false;
+    }
+
+    if (format_ == Format::kMp4) {
+        if (!WriteMp4Sample(frame, idr)) {
+            wait_keyframe_ = true;
+            return false;
+        }
+    }
+    else {
+        if (format_ == Format::kIvf) {
+            if (!header_written_) {
+                uint8_t header[kIvfHeaderSize] = { 'D', 'K', 'I', 'F' };
+                PutLE16(header + 4, 0);//version
+                PutLE16(header + 6, kIvfHeaderSize);
+                memcpy(header + 8, "H264", 4);
+                PutLE16(header + 12, (uint16_t)frame->fmt.sub_fmt.video_fmt.width);
+                PutLE16(header + 14, (uint16_t)frame->fmt.sub_fmt.video_fmt.height);
+                PutLE32(header + 16, 1000);//时间戳单位为ms
+                PutLE32(header + 20, 1);
+                PutLE32(header + kIvfFrameCountOffset, 0);//关闭时回写
+                writer_.Write(header, sizeof(header));
+                header_written_ = true;
+            }
+
+            uint8_t frame_header[kIvfFrameHeaderSize];
+            PutLE32(frame_header, (uint32_t)size);
+            PutLE32(frame_header + 4, frame->ts);
+            PutLE32(frame_header + 8, 0);
+            writer_.Write(frame_header, sizeof(frame_header));
+            ++ivf_frames_;
+        }
+        writer_.Write(data, size);
+    }
+
+    wait_keyframe_ = false;
+    return true;
+}
+
+// 把Annex-B转换成AVCC作为一个样本，第一个关键帧带的SPS/PPS写入初始化段
+bool FileRecordSink::WriteMp4Sample(const MediaFrame* frame, bool idr) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(frame->data[0]);
+    size_t size = frame->data_len[0];
+
+    std::vector<uint8_t> sample;
+    sample.reserve(size + 16);
+    std::vector<uint8_t> sps;
+    std::vector<uint8_t> pps;
+    for (const auto& index : webrtc::H264::FindNaluIndices(data, size)) {
+        if (index.payload_size == 0) {
+            continue;
+        }
+
+        const uint8_t* nalu = data + index.payload_start_offset;
+        webrtc::H264::NaluType type = webrtc::H264::ParseNaluType(nalu[0]);
+        if (type == webrtc::H264::kAud) {
+            continue;
+        }
+        if (type == webrtc::H264::kSps) {
+            sps.assign(nalu, nalu + index.payload_size);
+        }
+        else if (type == webrtc::H264::kPps) {
+            pps.assign(nalu, nalu + index.payload_size);
+        }
+
+        uint32_t len = (uint32_t)index.payload_size;
+        uint8_t prefix[4] = { (uint8_t)(len >> 24), (uint8_t)(len >> 16),
+            (uint8_t)(len >> 8), (uint8_t)len };
+        sample.insert(sample.end(), prefix, prefix + 4);
+        sample.insert(sample.end(), nalu, nalu + index.payload_size);
+    }
+    if (sample.empty()) {
+        return false;
+    }
+
+    if (!header_written_) {
+        if (!idr || sps.empty() || pps.empty()) {
+            RTC_LOG(LS_WARNING) << "FileRecordSink mp4 waiting for a keyframe with SPS/PPS";
+            return false;
+        }
+        std::vector<uint8_t> init = Fmp4Muxer::InitSegment(frame->fmt.sub_fmt.video_fmt.width,
+            frame->fmt.sub_fmt.video_fmt.height, sps, pps);
+        writer_.Write(init.data(), init.size());
+        header_written_ = true;
+    }
+
+    if (!mp4_sample_.empty()) {
+        if (!writer_.CanWrite(mp4_sample_.size() + kMp4FragmentOverhead)) {
+            return false;
+        }
+        // 时间戳单位为ms，异常时按帧率估算
+        uint32_t delta_ms = frame->ts - mp4_sample_ts_;
+        uint32_t duration = delta_ms > 0 && delta_ms < 10000 ?
+            delta_ms * (Fmp4Muxer::kTimescale / 1000) :
+            Fmp4Muxer::kTimescale / (fps_ > 0 ? fps_ : kDefaultFps);
+        FlushMp4Sample(duration);
+    }
+
+    mp4_sample_.swap(sample);
+    mp4_sample_idr_ = idr;
+    mp4_sample_ts_ = frame->ts;
+    return true;
+}
+
+void FileRecordSink::FlushMp4Sample(uint32_t duration) {
+    mp4_buffer_.clear();
+    Fmp4Muxer::AppendFragment(++mp4_sequence_, mp4_dts_, duration, mp4_sample_idr_,
+        mp4_sample_, &mp4_buffer_);
+    writer_.Write(mp4_buffer_.data(), mp4_buffer_.size());
+    mp4_dts_ += duration;
+    mp4_sample_.clear();
+}
+
+bool FileRecordSink::WriteY4m(const MediaFrame* frame) {
+    int width = frame->fmt.sub_fmt.video_fmt.width;
+    int height = frame->fmt.sub_fmt.video_fmt.height;
+    if (frame->fmt.sub_fmt.video_fmt.type != SubMediaType::kSubTypeI420 || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    if (!header_written_) {
+        char header[128];
+        int len = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+            width, height, fps_ > 0 ? fps_ : kDefaultFps);
+        writer_.Write(header, len);
+        width_ = width;
+        height_ = height;
+        header_written_ = true;
+    }
+    else if (width != width_ || height != height_) {
+        // Y4M不支持中途改变分辨率
+        return false;
+    }
+
+    int chroma_width = (width + 1) / 2;
+    int chroma_height = (height + 1) / 2;
+    size_t frame_size = (size_t)width * height + (size_t)chroma_width * chroma_height * 2;
+    if (!writer_.CanWrite(frame_size + sizeof(kY4mFrameHeader) - 1)) {
+        return false;
+    }
+
+    writer_.Write(kY4mFrameHeader, sizeof(kY4mFrameHeader) - 1);
+    const int widths[3] = { width, chroma_width, chroma_width };
+    const int heights[3] = { height, chroma_height, chroma_height };
+    for (int i = 0; i < 3; ++i) {
+        const char* plane = frame->data[i];
+        if (frame->stride[i] == widths[i]) {
+            writer_.Write(plane, (size_t)widths[i] * heights[i]);
+            continue;
+        }
+        for (int row = 0; row < heights[i]; ++row) {
+            writer_.Write(plane + (size_t)row * frame->stride[i], widths[i]);
+        }
+    }
+    return true;
+}
+
+} // namespace xrtc
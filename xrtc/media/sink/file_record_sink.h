@@ -0,0 +1,86 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_SINK_FILE_RECORD_SINK_H_
+#define XRTCSDK_XRTC_MEDIA_SINK_FILE_RECORD_SINK_H_
+
+#include <string>
+#include <vector>
+
+#include "xrtc/base/async_file_writer.h"
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/media/base/media_chain.h"
+
+namespace xrtc {
+
+class InPin;
+
+// 录制节点：把H264写成Annex-B裸流(.h264/.264)、IVF(.ivf)或者分片MP4(.mp4)，把I420写成Y4M(.y4m)
+// 格式由文件扩展名决定。写盘在AsyncFileWriter的IO线程上完成，媒体线程只拷贝数据，
+// 磁盘跟不上时丢帧(H264丢到下一个关键帧)，不会反压编码器和发送
+// 配置：{"file_record":{"buffer_kb":4096,"max_queue_mb":64,"direct_io":false,"preallocate_mb":0}}
+class FileRecordSink : public MediaObject {
+public:
+    enum class Format {
+        kAnnexB,
+        kIvf,
+        kMp4,
+        kY4m,
+    };
+
+    explicit FileRecordSink(const std::string& path);
+    ~FileRecordSink() override;
+
+    // MediaObject
+    bool Start() override;
+    void Setup(const std::string& json_config) override;
+    void Stop() override;
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>({ in_pin_.get() });
+    }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>();
+    }
+    const char* name() const override { return "file_record_sink"; }
+    void GetStats(JsonObject& stats) override;
+
+    void OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) override;
+    void OnFormatChanged(InPin* in_pin, const VideoStreamFormat& format) override;
+
+    static bool ParseFormat(const std::string& path, Format* format);
+
+private:
+    void OpenFile();
+    void CloseFile();
+    bool WriteH264(const MediaFrame* frame);
+    bool WriteY4m(const MediaFrame* frame);
+    bool WriteMp4Sample(const MediaFrame* frame, bool idr);
+    void FlushMp4Sample(uint32_t duration);
+
+private:
+    std::string path_;
+    Format format_ = Format::kAnnexB;
+    std::unique_ptr<InPin> in_pin_;
+    AsyncFileWriter::Options options_;
+    std::atomic<bool> running_{ false };
+
+    // 以下只在task_queue上访问
+    AsyncFileWriter writer_;
+    bool header_written_ = false;
+    bool wait_keyframe_ = true;//H264从关键帧开始写，丢帧后等待下一个关键帧
+    int fps_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    uint32_t ivf_frames_ = 0;
+    // MP4延迟一帧写，用下一帧的时间戳计算时长
+    std::vector<uint8_t> mp4_sample_;
+    std::vector<uint8_t> mp4_buffer_;
+    bool mp4_sample_idr_ = false;
+    uint32_t mp4_sample_ts_ = 0;
+    uint64_t mp4_dts_ = 0;
+    uint32_t mp4_sequence_ = 0;
+
+    StatsCounter frames_written_;
+    StatsCounter frames_dropped_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_SINK_FILE_RECORD_SINK_H_
@@ -0,0 +1,266 @@
+﻿#include "xrtc/media/sink/fmp4_muxer.h"
+
+#include <string.h>
+
+namespace xrtc {
+
+namespace {
+
+const uint32_t kTrackId = 1;
+// trun的样本标志：关键帧不依赖其他帧，非关键帧依赖其他帧且不可随机访问
+const uint32_t kSyncSampleFlags = 0x02000000;
+const uint32_t kNonSyncSampleFlags = 0x01010000;
+
+// 按ISO/IEC 14496-12写box，Begin/End成对使用，End时回填box大小
+class BoxWriter {
+public:
+    explicit BoxWriter(std::vector<uint8_t>* out) : out_(out) {}
+
+    void Begin(const char* type) {
+        stack_.push_back(out_->size());
+        U32(0);
+        Bytes(type, 4);
+    }
+
+    void BeginFull(const char* type, uint8_t version, uint32_t flags) {
+        Begin(type);
+        U32(((uint32_t)version << 24) | (flags & 0xFFFFFF));
+    }
+
+    void End() {
+        size_t start = stack_.back();
+        stack_.pop_back();
+        uint32_t size = (uint32_t)(out_->size() - start);
+        (*out_)[start] = (uint8_t)(size >> 24);
+        (*out_)[start + 1] = (uint8_t)(size >> 16);
+        (*out_)[start + 2] = (uint8_t)(size >> 8);
+        (*out_)[start + 3] = (uint8_t)size;
+    }
+
+    void U8(uint8_t v) { out_->push_back(v); }
+    void U16(uint16_t v) { U8((uint8_t)(v >> 8)); U8((uint8_t)v); }
+    void U32(uint32_t v) { U16((uint16_t)(v >> 16)); U16((uint16_t)v); }
+    void U64(uint64_t v) { U32((uint32_t)(v >> 32)); U32((uint32_t)v); }
+    void Zeros(size_t n) { out_->insert(out_->end(), n, 0); }
+    void Bytes(const void* data, size_t n) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        out_->insert(out_->end(), p, p + n);
+    }
+
+    void Matrix() {
+        const uint32_t matrix[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+        for (uint32_t v : matrix) {
+            U32(v);
+        }
+    }
+
+    size_t size() const { return out_->size(); }
+
+private:
+    std::vector<uint8_t>* out_;
+    std::vector<size_t> stack_;
+};
+
+void WriteAvcC(BoxWriter& w, const std::vector<uint8_t>& sps, const std::vector<uint8_t>& pps) {
+    w.Begin("avcC");
+    w.U8(1);//configurationVersion
+    w.U8(sps.size() > 1 ? sps[1] : 66);//profile_idc
+    w.U8(sps.size() > 2 ? sps[2] : 0);//constraint flags
+    w.U8(sps.size() > 3 ? sps[3] : 31);//level_idc
+    w.U8(0xFF);//NAL长度字段4字节
+    w.U8(0xE1);//1个SPS
+    w.U16((uint16_t)sps.size());
+    w.Bytes(sps.data(), sps.size());
+    w.U8(1);//1个PPS
+    w.U16((uint16_t)pps.size());
+    w.Bytes(pps.data(), pps.size());
+    w.End();
+}
+
+} // namespace
+
+std::vector<uint8_t> Fmp4Muxer::InitSegment(int width, int height,
+    const std::vector<uint8_t>& sps, const std::vector<uint8_t>& pps)
+{
+    std::vector<uint8_t> out;
+    BoxWriter w(&out);
+
+    w.Begin("ftyp");
+    w.Bytes("isom", 4);
+    w.U32(0x200);
+    w.Bytes("isomiso6avc1mp41", 16);
+    w.End();
+
+    w.Begin("moov");
+    {
+        w.BeginFull("mvhd", 0, 0);
+        w.U32(0);//creation_time
+        w.U32(0);//modification_time
+        w.U32(1000);//timescale
+        w.U32(0);//duration，分片文件中为0
+        w.U32(0x00010000);//rate
+        w.U16(0x0100);//volume
+        w.Zeros(10);
+        w.Matrix();
+        w.Zeros(24);
+        w.U32(kTrackId + 1);//next_track_ID
+        w.End();
+
+        w.Begin("trak");
+        {
+            w.BeginFull("tkhd", 0, 0x3);//enabled | in_movie
+            w.U32(0);
+            w.U32(0);
+            w.U32(kTrackId);
+            w.U32(0);
+            w.U32(0);//duration
+            w.Zeros(8);
+            w.U16(0);//layer
+            w.U16(0);//alternate_group
+            w.U16(0);//volume
+            w.U16(0);
+            w.Matrix();
+            w.U32((uint32_t)width << 16);
+            w.U32((uint32_t)height << 16);
+            w.End();
+
+            w.Begin("mdia");
+            {
+                w.BeginFull("mdhd", 0, 0);
+                w.U32(0);
+                w.U32(0);
+                w.U32(kTimescale);
+                w.U32(0);
+                w.U16(0x55C4);//und
+                w.U16(0);
+                w.End();
+
+                w.BeginFull("hdlr", 0, 0);
+                w.U32(0);
+                w.Bytes("vide", 4);
+                w.Zeros(12);
+                w.Bytes("VideoHandler", 13);
+                w.End();
+
+                w.Begin("minf");
+                {
+                    w.BeginFull("vmhd", 0, 1);
+                    w.Zeros(8);
+                    w.End();
+
+                    w.Begin("dinf");
+                    w.BeginFull("dref", 0, 0);
+                    w.U32(1);
+                    w.BeginFull("url ", 0, 1);//数据在同一个文件中
+                    w.End();
+                    w.End();
+                    w.End();
+
+                    w.Begin("stbl");
+                    {
+                        w.BeginFull("stsd", 0, 0);
+                        w.U32(1);
+                        w.Begin("avc3");
+                        w.Zeros(6);
+                        w.U16(1);//data_reference_index
+                        w.Zeros(16);
+                        w.U16((uint16_t)width);
+                        w.U16((uint16_t)height);
+                        w.U32(0x00480000);//72dpi
+                        w.U32(0x00480000);
+                        w.U32(0);
+                        w.U16(1);//frame_count
+                        w.Zeros(32);//compressorname
+                        w.U16(0x0018);//depth
+                        w.U16(0xFFFF);
+                        WriteAvcC(w, sps, pps);
+                        w.End();
+                        w.End();
+
+                        // 样本表为空，样本都在分片中
+                        w.BeginFull("stts", 0, 0);
+                        w.U32(0);
+                        w.End();
+                        w.BeginFull("stsc", 0, 0);
+                        w.U32(0);
+                        w.End();
+                        w.BeginFull("stsz", 0, 0);
+                        w.U32(0);
+                        w.U32(0);
+                        w.End();
+                        w.BeginFull("stco", 0, 0);
+                        w.U32(0);
+                        w.End();
+                    }
+                    w.End();
+                }
+                w.End();
+            }
+            w.End();
+        }
+        w.End();
+
+        w.Begin("mvex");
+        w.BeginFull("trex", 0, 0);
+        w.U32(kTrackId);
+        w.U32(1);//default_sample_description_index
+        w.U32(0);
+        w.U32(0);
+        w.U32(0);
+        w.End();
+        w.End();
+    }
+    w.End();
+    return out;
+}
+
+void Fmp4Muxer::AppendFragment(uint32_t sequence, uint64_t decode_time, uint32_t duration,
+    bool keyframe, const std::vector<uint8_t>& sample, std::vector<uint8_t>* out)
+{
+    BoxWriter w(out);
+    size_t moof_start = w.size();
+    size_t data_offset_pos = 0;
+
+    w.Begin("moof");
+    {
+        w.BeginFull("mfhd", 0, 0);
+        w.U32(sequence);
+        w.End();
+
+        w.Begin("traf");
+        {
+            w.BeginFull("tfhd", 0, 0x020000);//default-base-is-moof
+            w.U32(kTrackId);
+            w.End();
+
+            w.BeginFull("tfdt", 1, 0);
+            w.U64(decode_time);
+            w.End();
+
+            // data-offset | sample-duration | sample-size | sample-flags
+            w.BeginFull("trun", 0, 0x000001 | 0x000100 | 0x000200 | 0x000400);
+            w.U32(1);
+            data_offset_pos = w.size();
+            w.U32(0);
+            w.U32(duration);
+            w.U32((uint32_t)sample.size());
+            w.U32(keyframe ? kSyncSampleFlags : kNonSyncSampleFlags);
+            w.End();
+        }
+        w.End();
+    }
+    w.End();
+
+    // 数据从mdat的负载开始，偏移相对于moof的起点
+    uint32_t data_offset = (uint32_t)(w.size() - moof_start + 8);
+    (*out)[data_offset_pos] = (uint8_t)(data_offset >> 24);
+    (*out)[data_offset_pos + 1] = (uint8_t)(data_offset >> 16);
+    (*out)[data_offset_pos + 2] = (uint8_t)(data_offset >> 8);
+    (*out)[data_offset_pos + 3] = (uint8_t)data_offset;
+
+    w.U32((uint32_t)(sample.size() + 8));
+    w.Bytes("mdat", 4);
+    w.Bytes(sample.data(), sample.size());
+}
+
+} // namespace xrtc
@@ -0,0 +1,28 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_SINK_FMP4_MUXER_H_
+#define XRTCSDK_XRTC_MEDIA_SINK_FMP4_MUXER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace xrtc {
+
+// 分片MP4(H264单轨)的封装：初始化段(ftyp+moov)之后每个样本一个moof+mdat
+// 录制中途退出时已经写完的分片仍然可以播放，不需要在结尾回写索引
+// 使用avc3样本描述，SPS/PPS留在码流中，分辨率变化时不需要新的初始化段
+class Fmp4Muxer {
+public:
+    static const uint32_t kTimescale = 90000;
+
+    // sps/pps不含起始码
+    static std::vector<uint8_t> InitSegment(int width, int height,
+        const std::vector<uint8_t>& sps, const std::vector<uint8_t>& pps);
+
+    // sample为AVCC格式(每个NAL前4字节长度)，追加moof+mdat到out
+    static void AppendFragment(uint32_t sequence, uint64_t decode_time, uint32_t duration,
+        bool keyframe, const std::vector<uint8_t>& sample, std::vector<uint8_t>* out);
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_SINK_FMP4_MUXER_H_
@@ -0,0 +1,63 @@
+﻿#include "xrtc/media/sink/null_render_sink.h"
+
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/frame_tracer.h"
+#include "xrtc/media/base/in_pin.h"
+
+namespace xrtc {
+
+NullRenderSink::NullRenderSink() :
+    in_pin_(std::make_unique<InPin>(this))
+{
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeVideo;
+    fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeI420;
+    in_pin_->set_format(fmt);
+    in_pin_->set_video_types({ SubMediaType::kSubTypeI420, SubMediaType::kSubTypeNV12,
+        SubMediaType::kSubTypeYUY2, SubMediaType::kSubTypeARGB, SubMediaType::kSubTypeI420A });
+}
+
+NullRenderSink::~NullRenderSink() {
+}
+
+bool NullRenderSink::Start() {
+    RTC_LOG(LS_INFO) << "NullRenderSink Start";
+    running_ = true;
+    return true;
+}
+
+void NullRenderSink::Stop() {
+    RTC_LOG(LS_INFO) << "NullRenderSink Stop";
+    running_ = false;
+}
+
+void NullRenderSink::GetStats(JsonObject& stats) {
+    stats["render_fps"] = frames_rendered_.Rate(rtc::TimeMillis());
+    stats["frames_rendered"] = frames_rendered_.count();
+    stats["width"] = width_.load();
+    stats["height"] = height_.load();
+}
+
+void NullRenderSink::OnFormatChanged(InPin* /*in_pin*/, const VideoStreamFormat& format) {
+    width_ = format.width;
+    height_ = format.height;
+}
+
+// 在推帧的线程上直接完成，没有排队
+void NullRenderSink::OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) {
+    if (!running_) {
+        return;
+    }
+
+    frames_rendered_.Add();
+
+    FrameTrace* trace = frame->TraceFor(tracer());
+    if (trace) {
+        trace->tracer->End(frame.get(), name());
+    }
+}
+
+} // namespace xrtc
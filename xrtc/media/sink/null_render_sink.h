@@ -0,0 +1,43 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_SINK_NULL_RENDER_SINK_H_
+#define XRTCSDK_XRTC_MEDIA_SINK_NULL_RENDER_SINK_H_
+
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/media/base/media_chain.h"
+
+namespace xrtc {
+
+class InPin;
+
+// 无窗口的渲染节点：只消费帧并统计，用于没有显示设备的平台(服务器、压测)
+class NullRenderSink : public MediaObject {
+public:
+    NullRenderSink();
+    ~NullRenderSink() override;
+
+    // MediaObject
+    bool Start() override;
+    void Setup(const std::string& json_config) override {}
+    void Stop() override;
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>({ in_pin_.get() });
+    }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>();
+    }
+    const char* name() const override { return "null_render_sink"; }
+    void GetStats(JsonObject& stats) override;
+
+    void OnNewMediaFrame(std::shared_ptr<MediaFrame> frame) override;
+    void OnFormatChanged(InPin* in_pin, const VideoStreamFormat& format) override;
+
+private:
+    std::unique_ptr<InPin> in_pin_;
+    std::atomic<bool> running_{ false };
+    std::atomic<int> width_{ 0 };
+    std::atomic<int> height_{ 0 };
+    StatsCounter frames_rendered_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_SINK_NULL_RENDER_SINK_H_
@@ -0,0 +1,19 @@
+﻿#include "xrtc/media/sink/render_sink_factory.h"
+
+#if defined(WEBRTC_WIN)
+#include "xrtc/media/sink/d3d9_render_sink.h"
+#else
+#include "xrtc/media/sink/null_render_sink.h"
+#endif
+
+namespace xrtc {
+
+std::unique_ptr<MediaObject> CreateVideoRenderSink() {
+#if defined(WEBRTC_WIN)
+    return std::make_unique<D3D9RenderSink>();
+#else
+    return std::make_unique<NullRenderSink>();
+#endif
+}
+
+} // namespace xrtc
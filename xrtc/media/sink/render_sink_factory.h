@@ -0,0 +1,16 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_SINK_RENDER_SINK_FACTORY_H_
+#define XRTCSDK_XRTC_MEDIA_SINK_RENDER_SINK_FACTORY_H_
+
+#include <memory>
+
+namespace xrtc {
+
+class MediaObject;
+
+// 创建当前平台的视频渲染节点：Windows上为D3D9RenderSink，其他平台为NullRenderSink
+// 配置项放在以节点name()为key的json对象中，例如 {"d3d9_render_sink":{"hwnd":...}}
+std::unique_ptr<MediaObject> CreateVideoRenderSink();
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_SINK_RENDER_SINK_FACTORY_H_
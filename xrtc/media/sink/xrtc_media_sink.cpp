@@ -0,0 +1,335 @@
+﻿#include "xrtc/media/sink/xrtc_media_sink.h"
+
+#include <algorithm>
+
+#include <rtc_base/helpers.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/frame_tracer.h"
+#include "xrtc/media/base/in_pin.h"
+#include "xrtc/rtc/rtp_transport.h"
+
+namespace xrtc {
+
+namespace {
+
+const int kMinPacketSize = 200;
+const int kMaxPacketSize = 1400;
+
+} // namespace
+
+XRTCMediaSink::XRTCMediaSink(rtc::Thread* network_thread) :
+    network_thread_(network_thread),
+    video_in_pin_(std::make_unique<InPin>(this)),
+    audio_in_pin_(std::make_unique<InPin>(this)),
+    send_state_(std::make_shared<SendState>()),
+    video_packetizer_(std::make_unique<RtpPacketizer>(kDefaultVideoPayloadType,
+        rtc::CreateRandomNonZeroId())),
+    audio_packetizer_(std::make_unique<RtpPacketizer>(kDefaultAudioPayloadType,
+        rtc::CreateRandomNonZeroId()))
+{
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeVideo;
+    fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeH264;
+    video_in_pin_->set_format(fmt);
+
+    fmt.media_type = MainMediaType::kMainTypeAudio;
+    fmt.sub_fmt.audio_fmt.type = SubMediaType::kSubTypeOpus;
+    audio_in_pin_->set_format(fmt);
+}
+
+XRTCMediaSink::~XRTCMediaSink() {
+}
+
+// 只在Start之前生效，ssrc保持不变
+void XRTCMediaSink::Setup(const std::string& json_config) {
+    JsonValue value;
+    if (!value.FromJson(json_config)) {
+        return;
+    }
+
+    JsonObject jobject = value.ToObject();
+    if (!jobject.Has("xrtc_media_sink")) {
+        return;
+    }
+
+    JsonObject jsink = jobject["xrtc_media_sink"].ToObject();
+    int max_packet_size = std::min(kMaxPacketSize, std::max(kMinPacketSize,
+        (int)jsink["max_packet_size"].ToInt(RtpPacketizer::kDefaultMaxPacketSize)));
+    int video_pt = (int)jsink["video_pt"].ToInt(video_packetizer_->payload_type()) & 0x7F;
+    int audio_pt = (int)jsink["audio_pt"].ToInt(audio_packetizer_->payload_type()) & 0x7F;
+    int frame_marking_id = (int)jsink["frame_marking_id"].ToInt(0);
+    int transport_cc_id = (int)jsink["transport_cc_id"].ToInt(0);
+    video_packetizer_ = std::make_unique<RtpPacketizer>((uint8_t)video_pt,
+        video_packetizer_->ssrc(), max_packet_size);
+    if (frame_marking_id > 0 && frame_marking_id < 15) {
+        video_packetizer_->EnableFrameMarking((uint8_t)frame_marking_id);
+    }
+    transport_cc_id_ = 0;
+    if (transport_cc_id > 0 && transport_cc_id < 15 && transport_cc_id != frame_marking_id) {
+        transport_cc_id_ = (uint8_t)transport_cc_id;
+        video_packetizer_->EnableTransportSequenceNumber(transport_cc_id_);
+    }
+    audio_packetizer_ = std::make_unique<RtpPacketizer>((uint8_t)audio_pt,
+        audio_packetizer_->ssrc(), max_packet_size);
+}
+
+bool XRTCMediaSink::Start() {
+    RTC_LOG(LS_INFO) << "XRTCMediaSink Start, video ssrc: " << video_packetizer_->ssrc()
+        << ", audio ssrc: " << audio_packetizer_->ssrc();
+    send_state_->first_send_time_ms = 0;
+    // 在第一个批次之前执行，Setup可能换了打包器，视频序号重新开始
+    std::shared_ptr<SendState> state = send_state_;
+    uint8_t payload_type = video_packetizer_->payload_type();
+    uint32_t ssrc = video_packetizer_->ssrc();
+    uint8_t transport_cc_id = transport_cc_id_;
+    network_thread_->PostTask(webrtc::ToQueuedTask([state, payload_type, ssrc, transport_cc_id]() {
+        state->video_payload_type = payload_type;
+        state->video_ssrc = ssrc;
+        state->transport_cc_id = transport_cc_id;
+        state->has_video_sequence = false;
+    }));
+    running_ = true;
+    return true;
+}
+
+void XRTCMediaSink::Stop() {
+    RTC_LOG(LS_INFO) << "XRTCMediaSink Stop";
+    running_ = false;
+}
+
+void XRTCMediaSink::SetTransport(RtpTransport* transport) {
+    send_state_->transport = transport;
+    if (!transport) {
+        send_state_->probe_clusters.clear();
+        send_state_->probe_start_us = -1;
+    }
+}
+
+void XRTCMediaSink::SetTargetBitrate(int bitrate_bps) {
+    send_state_->layer_dropper.SetTargetBitrate(bitrate_bps);
+}
+
+void XRTCMediaSink::SendProbe(const ProbeCluster& cluster) {
+    if (transport_cc_id_ == 0) {
+        return;
+    }
+    send_state_->probe_clusters.push_back(cluster);
+    ScheduleProbes(network_thread_, send_state_, 0);
+}
+
+bool XRTCMediaSink::OnTransportFeedback(const RtcpTransportFeedback& feedback,
+    ProbeResult* result)
+{
+    return send_state_->probe_estimator.OnTransportFeedback(feedback, rtc::TimeMicros(), result);
+}
+
+void XRTCMediaSink::GetProbeStats(JsonObject& stats) {
+    send_state_->probe_estimator.GetStats(stats);
+}
+
+void XRTCMediaSink::GetStats(JsonObject& stats) {
+    int64_t now = rtc::TimeMillis();
+    stats["video_ssrc"] = video_packetizer_->ssrc();
+    stats["audio_ssrc"] = audio_packetizer_->ssrc();
+    stats["video_packets"] = video_packets_.count();
+    stats["audio_packets"] = audio_packets_.count();
+    stats["frames_sent"] = send_state_->frames_sent.count();
+    stats["frames_dropped"] = send_state_->frames_dropped.count();
+    stats["send_kbps"] = send_state_->bytes_sent.Rate(now) * 8 / 1000;
+    stats["bytes_sent"] = send_state_->bytes_sent.count();
+    stats["pending_batches"] = send_state_->pending_batches.load();
+    stats["padding_bytes"] = send_state_->padding_bytes.count();
+    stats["probes_sent"] = send_state_->probes_sent.count();
+    stats["glass_to_network_us"] = send_state_->glass_to_network_us.Average();
+    stats["max_glass_to_network_us"] = send_state_->max_glass_to_network_us.exchange(0);
+    JsonObject jlayers;
+    send_state_->layer_dropper.GetStats(jlayers);
+    stats["temporal_layers"] = jlayers;
+}
+
+void XRTCMediaSink::OnNewPinFrame(InPin* in_pin, std::shared_ptr<MediaFrame> frame) {
+    if (!running_) {
+        return;
+    }
+
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(frame->data[0]);
+    size_t size = frame->data_len[0];
+    if (!data || size == 0) {
+        return;
+    }
+
+    auto batch = std::make_shared<RtpPacketBatch>();
+    batch->capture_time_ms = frame->capture_time_ms;
+    if (in_pin == video_in_pin_.get()) {
+        const VideoFormat& fmt = frame->fmt.sub_fmt.video_fmt;
+        RtpFrameLayer layer;
+        layer.keyframe = fmt.idr;
+        layer.temporal_id = (uint8_t)fmt.temporal_id;
+        layer.discardable = fmt.discardable;
+        video_packetizer_->PacketizeH264(data, size, frame->ts * (kVideoClockRate / 1000),
+            layer, batch.get());
+        video_packets_.Add(batch->packet_count());
+    }
+    else {
+        audio_packetizer_->PacketizeAudio(data, size, frame->ts * (kAudioClockRate / 1000),
+            batch.get());
+        audio_packets_.Add(batch->packet_count());
+    }
+
+    FrameTrace* trace = frame->TraceFor(tracer());
+    if (trace) {
+        trace->tracer->End(frame.get(), name());
+    }
+
+    SendBatch(std::move(batch));
+}
+
+void XRTCMediaSink::SendBatch(std::shared_ptr<RtpPacketBatch> batch) {
+    std::shared_ptr<SendState> state = send_state_;
+    rtc::Thread* thread = network_thread_;
+    ++state->pending_batches;
+    network_thread_->PostTask(webrtc::ToQueuedTask([thread, state, batch]() {
+        --state->pending_batches;
+        if (batch->video) {
+            if (!state->layer_dropper.OnFrame(batch->layer, batch->bytes(), rtc::TimeMillis())) {
+                state->sequence_offset += (uint16_t)batch->packet_count();
+                return;
+            }
+            if (state->sequence_offset != 0) {
+                for (size_t i = 0; i < batch->packet_count(); ++i) {
+                    uint8_t* p = batch->mutable_packet_data(i);
+                    uint16_t seq = (uint16_t)(((p[2] << 8) | p[3]) - state->sequence_offset);
+                    p[2] = (uint8_t)(seq >> 8);
+                    p[3] = (uint8_t)seq;
+                }
+            }
+            const uint8_t* last = batch->packet_data(batch->packet_count() - 1);
+            state->next_video_sequence = (uint16_t)(((last[2] << 8) | last[3]) + 1);
+            state->last_video_timestamp = batch->rtp_timestamp;
+            state->has_video_sequence = true;
+        }
+
+        // 按发送顺序编传输层序号，探测簇发送期间的视频包也算作探测
+        if (batch->transport_sequence_offset != 0) {
+            int64_t now_us = rtc::TimeMicros();
+            bool probing = state->probe_start_us >= 0;
+            for (size_t i = 0; i < batch->packet_count(); ++i) {
+                uint16_t transport_sequence = state->transport_sequence++;
+                uint8_t* p = batch->mutable_packet_data(i) + batch->transport_sequence_offset;
+                p[0] = (uint8_t)(transport_sequence >> 8);
+                p[1] = (uint8_t)transport_sequence;
+                if (probing) {
+                    state->probe_estimator.OnPacketSent(state->probe_clusters.front().id,
+                        transport_sequence, batch->packet_size(i), now_us);
+                    state->probe_bytes += batch->packet_size(i);
+                    ++state->probe_packets;
+                }
+            }
+        }
+
+        if (!state->transport || !state->transport->SendBatch(*batch)) {
+            state->frames_dropped.Add();
+            return;
+        }
+        if (batch->video && !state->probe_clusters.empty()) {
+            ScheduleProbes(thread, state, 0);
+        }
+
+        state->frames_sent.Add();
+        if (state->first_send_time_ms.load(std::memory_order_relaxed) == 0) {
+            state->first_send_time_ms = rtc::TimeMillis();
+        }
+        state->bytes_sent.Add(batch->bytes());
+        if (batch->capture_time_ms > 0) {
+            int64_t delay = rtc::TimeMicros() -
+                batch->capture_time_ms * rtc::kNumMicrosecsPerMillisec;
+            state->glass_to_network_us.Add(delay);
+            int64_t max_delay = state->max_glass_to_network_us.load();
+            while (delay > max_delay &&
+                !state->max_glass_to_network_us.compare_exchange_weak(max_delay, delay))
+            {
+            }
+        }
+    }));
+}
+
+void XRTCMediaSink::ScheduleProbes(rtc::Thread* thread, std::shared_ptr<SendState> state,
+    int delay_ms)
+{
+    if (state->probe_task_pending) {
+        return;
+    }
+
+    state->probe_task_pending = true;
+    auto task = webrtc::ToQueuedTask([thread, state]() {
+        ProcessProbes(thread, state);
+    });
+    if (delay_ms > 0) {
+        thread->PostDelayedTask(std::move(task), delay_ms);
+    }
+    else {
+        thread->PostTask(std::move(task));
+    }
+}
+
+// 按簇的码率算出到现在应该发出的字节数，视频包不够的部分用填充包补上；
+// 填充包接着最后一个视频包取序号，时间戳和它相同
+void XRTCMediaSink::ProcessProbes(rtc::Thread* thread, std::shared_ptr<SendState> state) {
+    state->probe_task_pending = false;
+    if (!state->transport || !state->has_video_sequence || state->probe_clusters.empty()) {
+        return;
+    }
+
+    const ProbeCluster& cluster = state->probe_clusters.front();
+    int64_t now_us = rtc::TimeMicros();
+    if (state->probe_start_us < 0) {
+        state->probe_start_us = now_us;
+        state->probe_bytes = 0;
+        state->probe_packets = 0;
+    }
+
+    // 第一个包立即发出
+    int64_t elapsed_us = now_us - state->probe_start_us;
+    int64_t due_bytes = (int64_t)cluster.bitrate_bps * elapsed_us / 8000000 + 1;
+    RtpPacketBatch batch;
+    while ((int64_t)state->probe_bytes < due_bytes) {
+        RtpPacketizer::BuildPaddingPacket(state->video_payload_type, state->video_ssrc,
+            state->next_video_sequence++, state->last_video_timestamp, state->transport_cc_id,
+            RtpPacketizer::kMaxPaddingSize, &batch);
+        --state->sequence_offset;
+        size_t index = batch.packet_count() - 1;
+        uint16_t transport_sequence = state->transport_sequence++;
+        uint8_t* p = batch.mutable_packet_data(index) + batch.transport_sequence_offset;
+        p[0] = (uint8_t)(transport_sequence >> 8);
+        p[1] = (uint8_t)transport_sequence;
+        state->probe_estimator.OnPacketSent(cluster.id, transport_sequence,
+            batch.packet_size(index), now_us);
+        state->probe_bytes += batch.packet_size(index);
+        ++state->probe_packets;
+    }
+    if (batch.packet_count() > 0 && state->transport->SendBatch(batch)) {
+        state->bytes_sent.Add(batch.bytes());
+        state->padding_bytes.Add(batch.bytes());
+    }
+
+    if (elapsed_us < (int64_t)cluster.duration_ms * 1000 ||
+        state->probe_packets < cluster.min_packets)
+    {
+        ScheduleProbes(thread, state, 1);
+        return;
+    }
+
+    state->probe_estimator.OnClusterSent(cluster.id);
+    state->probes_sent.Add();
+    state->probe_clusters.pop_front();
+    state->probe_start_us = -1;
+    if (!state->probe_clusters.empty()) {
+        ScheduleProbes(thread, state, 0);
+    }
+}
+
+} // namespace xrtc
@@ -0,0 +1,129 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_SINK_XRTC_MEDIA_SINK_H_
+#define XRTCSDK_XRTC_MEDIA_SINK_XRTC_MEDIA_SINK_H_
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <rtc_base/thread.h>
+
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/media/base/media_chain.h"
+#include "xrtc/rtc/probe_bitrate_estimator.h"
+#include "xrtc/rtc/probe_controller.h"
+#include "xrtc/rtc/rtp_packetizer.h"
+#include "xrtc/rtc/temporal_layer_dropper.h"
+
+namespace xrtc {
+
+class InPin;
+class RtpTransport;
+
+// 推流的发送节点：视频(H264)和音频(Opus)各一个输入，打包成RTP后交给network_thread发送
+// 打包在上游编码节点的线程上完成(kInline)，网络线程只做发送，一帧的包作为一个批次投递
+// 设置了目标码率时视频按时域层丢帧(TemporalLayerDropper)，丢掉的帧不占RTP序号，接收端看不到丢包
+// 带宽探测在网络线程上按探测码率发送只有填充的视频包，探测期间发出的视频包也算在探测簇中，
+// 填充包接着已发出的视频包取序号，之后的视频包序号顺延
+// 配置：{"xrtc_media_sink":{"max_packet_size":1200,"video_pt":107,"audio_pt":111,
+//        "frame_marking_id":0,"transport_cc_id":0}}
+// frame_marking_id/transport_cc_id为协商的frame marking和transport-wide cc头扩展id，0表示不带，
+// 没有transport-wide cc时不能探测
+class XRTCMediaSink : public MediaObject {
+public:
+    static const uint8_t kDefaultVideoPayloadType = 107;
+    static const uint8_t kDefaultAudioPayloadType = 111;
+    static const uint32_t kVideoClockRate = 90000;
+    static const uint32_t kAudioClockRate = 48000;//Opus的RTP时钟固定为48k(RFC 7587)
+
+    explicit XRTCMediaSink(rtc::Thread* network_thread);
+    ~XRTCMediaSink() override;
+
+    // MediaObject
+    bool Start() override;
+    void Setup(const std::string& json_config) override;
+    void Stop() override;
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>({ video_in_pin_.get(), audio_in_pin_.get() });
+    }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>();
+    }
+    const char* name() const override { return "xrtc_media_sink"; }
+    void GetStats(JsonObject& stats) override;
+    void OnNewPinFrame(InPin* in_pin, std::shared_ptr<MediaFrame> frame) override;
+
+    // 在network_thread上调用，nullptr表示断开，之后投递到网络线程的批次直接丢弃
+    void SetTransport(RtpTransport* transport);
+    // 带宽估计给出的视频目标码率，0表示不限制，可以在任意线程调用
+    void SetTargetBitrate(int bitrate_bps);
+    // 以下在network_thread上调用
+    // 探测簇排队发送，第一个视频批次发出之后才开始
+    void SendProbe(const ProbeCluster& cluster);
+    // 有探测簇得到结果时返回true
+    bool OnTransportFeedback(const RtcpTransportFeedback& feedback, ProbeResult* result);
+    void GetProbeStats(JsonObject& stats);
+
+    uint32_t video_ssrc() const { return video_packetizer_->ssrc(); }
+    uint32_t audio_ssrc() const { return audio_packetizer_->ssrc(); }
+    // 用于统计推流的首帧耗时，还没有发出过返回0，可以在任意线程读取
+    int64_t first_send_time_ms() const { return send_state_->first_send_time_ms.load(); }
+    // 交给传输的字节数，带宽估计按它计算发送码率，可以在任意线程读取
+    int64_t bytes_sent() const { return send_state_->bytes_sent.count(); }
+
+private:
+    // 网络线程上的发送状态，投递的任务持有它，节点析构后任务仍然可以安全执行
+    struct SendState {
+        RtpTransport* transport = nullptr;//只在network_thread上访问
+        std::atomic<int> pending_batches{ 0 };//已经投递、还没有发送的批次
+        StatsCounter frames_sent;
+        StatsCounter frames_dropped;//没有传输或者发送失败
+        TemporalLayerDropper layer_dropper;
+        uint16_t sequence_offset = 0;//按层丢掉的视频包数，之后的包序号减去它，只在network_thread上访问
+        StatsCounter bytes_sent;
+        AverageCounter glass_to_network_us;//采集到最后一个包交给socket的延时
+        std::atomic<int64_t> max_glass_to_network_us{ 0 };
+        std::atomic<int64_t> first_send_time_ms{ 0 };//Start之后第一个批次发出的时间
+
+        // 带宽探测，只在network_thread上访问
+        uint8_t video_payload_type = 0;
+        uint32_t video_ssrc = 0;
+        uint8_t transport_cc_id = 0;
+        uint16_t transport_sequence = 0;
+        bool has_video_sequence = false;//Start之后已经发出过视频包
+        uint16_t next_video_sequence = 0;//改写之后下一个视频包的序号
+        uint32_t last_video_timestamp = 0;
+        std::deque<ProbeCluster> probe_clusters;//第一个正在发送
+        int64_t probe_start_us = -1;//-1表示没有正在发送的簇
+        size_t probe_bytes = 0;
+        int probe_packets = 0;
+        bool probe_task_pending = false;
+        ProbeBitrateEstimator probe_estimator;
+        StatsCounter padding_bytes;
+        StatsCounter probes_sent;
+    };
+
+    void SendBatch(std::shared_ptr<RtpPacketBatch> batch);
+    // 发送到期的填充包，簇没有发完时1ms之后再来
+    static void ProcessProbes(rtc::Thread* thread, std::shared_ptr<SendState> state);
+    static void ScheduleProbes(rtc::Thread* thread, std::shared_ptr<SendState> state,
+        int delay_ms);
+
+private:
+    rtc::Thread* network_thread_;
+    std::unique_ptr<InPin> video_in_pin_;
+    std::unique_ptr<InPin> audio_in_pin_;
+    std::shared_ptr<SendState> send_state_;
+    std::atomic<bool> running_{ false };
+
+    // Setup时创建，之后视频只在视频编码线程上使用，音频只在音频编码线程上使用
+    std::unique_ptr<RtpPacketizer> video_packetizer_;
+    std::unique_ptr<RtpPacketizer> audio_packetizer_;
+    uint8_t transport_cc_id_ = 0;
+    StatsCounter video_packets_;
+    StatsCounter audio_packets_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_SINK_XRTC_MEDIA_SINK_H_
@@ -0,0 +1,59 @@
+﻿#include "xrtc/media/source/xrtc_audio_source.h"
+
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/frame_tracer.h"
+#include "xrtc/media/base/out_pin.h"
+
+namespace xrtc {
+
+XRTCAudioSource::XRTCAudioSource() :
+    out_pin_(std::make_unique<OutPin>(this))
+{
+    MediaFormat fmt;
+    fmt.media_type = MainMediaType::kMainTypeAudio;
+    fmt.sub_fmt.audio_fmt.type = SubMediaType::kSubTypePcm;
+    fmt.sub_fmt.audio_fmt.sample_rate = 0;
+    fmt.sub_fmt.audio_fmt.channels = 0;
+    fmt.sub_fmt.audio_fmt.samples_per_channel = 0;
+    out_pin_->set_format(fmt);
+}
+
+XRTCAudioSource::~XRTCAudioSource() {
+}
+
+bool XRTCAudioSource::Start() {
+    return true;
+}
+
+void XRTCAudioSource::Stop() {
+    RTC_LOG(LS_INFO) << "XRTCAudioSource Stop";
+}
+
+void XRTCAudioSource::GetStats(JsonObject& stats) {
+    stats["frames"] = frames_.count();
+    stats["fps"] = frames_.Rate(rtc::TimeMillis());
+    stats["sample_rate"] = sample_rate_.load();
+    stats["channels"] = channels_.load();
+}
+
+void XRTCAudioSource::OnFrame(std::shared_ptr<MediaFrame> frame) {
+    if (frame->fmt.media_type != MainMediaType::kMainTypeAudio) {
+        return;
+    }
+
+    sample_rate_ = frame->fmt.sub_fmt.audio_fmt.sample_rate;
+    channels_ = frame->fmt.sub_fmt.audio_fmt.channels;
+    frames_.Add();
+
+    FrameTracer* frame_tracer = tracer();
+    if (frame_tracer) {
+        frame_tracer->Begin(frame.get(), name());
+    }
+
+    out_pin_->PushMediaFrame(frame);
+}
+
+} // namespace xrtc
@@ -0,0 +1,45 @@
+﻿#ifndef XRTCSDK_XRTC_MEDIA_SOURCE_XRTC_AUDIO_SOURCE_H_
+#define XRTCSDK_XRTC_MEDIA_SOURCE_XRTC_AUDIO_SOURCE_H_
+
+#include "xrtc/xrtc.h"
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/media/base/media_chain.h"
+
+namespace xrtc {
+
+class OutPin;
+
+// 音频链路的起点：在音频采集线程上把10ms的PCM帧推给下游
+// 下游的音频节点使用NodeExecutor::kAudioPool，不经过视频的媒体线程池
+class XRTCAudioSource : public IXRTCConsumer,
+                        public MediaObject
+{
+public:
+    XRTCAudioSource();
+    ~XRTCAudioSource() override;
+
+    // MediaObject
+    bool Start() override;
+    void Stop() override;
+    std::vector<InPin*> GetAllInPins() override {
+        return std::vector<InPin*>();
+    }
+    std::vector<OutPin*> GetAllOutPins() override {
+        return std::vector<OutPin*>({ out_pin_.get() });
+    }
+    const char* name() const override { return "xrtc_audio_source"; }
+    void GetStats(JsonObject& stats) override;
+
+    // IXRTCConsumer
+    void OnFrame(std::shared_ptr<MediaFrame> frame) override;
+
+private:
+    std::unique_ptr<OutPin> out_pin_;
+    StatsCounter frames_;
+    std::atomic<int> sample_rate_{ 0 };
+    std::atomic<int> channels_{ 0 };
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_MEDIA_SOURCE_XRTC_AUDIO_SOURCE_H_
@@ -1,7 +1,10 @@
 ﻿#include "xrtc/media/source/xrtc_video_source.h"
 
 #include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
 
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/media/base/frame_tracer.h"
 #include "xrtc/media/base/out_pin.h"
 namespace xrtc{
 
@@ -27,8 +30,69 @@ void XRTCVideoSource::Stop() {
     RTC_LOG(LS_INFO) << "XRTCVideoSource Stop";
 }
 
+void XRTCVideoSource::GetStats(JsonObject& stats) {
+    stats["frames"] = frames_.count();
+    stats["fps"] = frames_.Rate(rtc::TimeMillis());
+    stats["frames_decimated"] = frames_decimated_.count();
+    stats["frames_rejected"] = frames_rejected_.count();
+}
+
+// 按协商的帧率均匀抽帧，允许1/4帧间隔的抖动；落后太多时从当前帧重新开始
+bool XRTCVideoSource::ShouldDropFrame(int64_t capture_time_ms, int fps) {
+    if (fps <= 0) {
+        return false;
+    }
+
+    int64_t interval_ms = 1000 / fps;
+    if (capture_time_ms < next_send_ms_ - interval_ms / 4) {
+        return true;
+    }
+
+    next_send_ms_ += interval_ms;
+    if (next_send_ms_ < capture_time_ms) {
+        next_send_ms_ = capture_time_ms + interval_ms;
+    }
+    return false;
+}
+
 //将数据抛出到链条上
 void XRTCVideoSource::OnFrame(std::shared_ptr<MediaFrame> frame) {
+    // 分辨率变化时在推帧之前重新协商，下游节点不需要逐帧检查
+    int width = frame->fmt.sub_fmt.video_fmt.width;
+    int height = frame->fmt.sub_fmt.video_fmt.height;
+    if (width != width_ || height != height_) {
+        VideoStreamFormat format;
+        format.type = frame->fmt.sub_fmt.video_fmt.type;
+        format.width = width;
+        format.height = height;
+        format_accepted_ = out_pin_->Renegotiate(format);
+        if (!format_accepted_) {
+            RTC_LOG(LS_WARNING) << "XRTCVideoSource renegotiate failed: "
+                << VideoStreamFormatString(format);
+        }
+        width_ = width;
+        height_ = height;
+        fps_ = out_pin_->negotiated_format().fps;
+    }
+
+    // 下游不支持的分辨率不往下推，等下一次分辨率变化
+    if (!format_accepted_) {
+        frames_rejected_.Add();
+        return;
+    }
+
+    if (ShouldDropFrame(frame->capture_time_ms, fps_)) {
+        frames_decimated_.Add();
+        return;
+    }
+
+    frames_.Add();
+
+    FrameTracer* frame_tracer = tracer();
+    if (frame_tracer) {
+        frame_tracer->Begin(frame.get(), name());
+    }
+
     if (out_pin_) {
         out_pin_->PushMediaFrame(frame);
     }
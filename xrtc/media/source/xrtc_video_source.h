@@ -2,6 +2,7 @@
 #define XRTCSDK_XRTC_MEDIA_SOURCE_XRTC_VIDEO_SOURCE_H_
 
 #include "xrtc/xrtc.h"
+#include "xrtc/base/xrtc_stats.h"
 #include "xrtc/media/base/media_chain.h"
 
 namespace xrtc {
@@ -26,13 +27,28 @@ public:
         return std::vector<OutPin*>({ out_pin_.get() });
         //return std::vector<OutPin*>();
     }
+    const char* name() const override { return "xrtc_video_source"; }
+    void GetStats(JsonObject& stats) override;
    
 
     // IXRTCConsumer
     void OnFrame(std::shared_ptr<MediaFrame> frame) override;
 
+private:
+    bool ShouldDropFrame(int64_t capture_time_ms, int fps);
+
 private:
     std::unique_ptr<OutPin> out_pin_;//video_source 只有输出，没有输入
+    StatsCounter frames_;
+    StatsCounter frames_decimated_;//下游协商的帧率低于采集帧率时丢弃的帧
+    StatsCounter frames_rejected_;//分辨率超出下游能力范围的帧
+
+    // 以下只在采集线程上访问
+    int width_ = 0;
+    int height_ = 0;
+    int fps_ = 0;
+    bool format_accepted_ = true;
+    int64_t next_send_ms_ = 0;
 };
 
 } // namespace xrtc
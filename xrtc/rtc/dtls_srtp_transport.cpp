@@ -0,0 +1,539 @@
+﻿#include "xrtc/rtc/dtls_srtp_transport.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <rtc_base/helpers.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/rtc/ice_transport.h"
+#include "xrtc/rtc/rtp_packetizer.h"
+
+namespace xrtc {
+
+namespace {
+
+const int kDtlsMtu = 1200;
+const unsigned int kDtlsInitialTimeoutUs = 100 * 1000;
+const unsigned int kDtlsMaxTimeoutUs = 3 * 1000 * 1000;
+const int kCertificateLifetimeDays = 30;
+const char kSrtpExporterLabel[] = "EXTRACTOR-dtls_srtp";
+const size_t kMaxDtlsPacketSize = 2048;
+
+// OpenSSL默认从1秒开始重传，实时场景太慢
+unsigned int DtlsTimerCallback(SSL* /*ssl*/, unsigned int timer_us) {
+    return timer_us == 0 ? kDtlsInitialTimeoutUs : std::min(timer_us * 2, kDtlsMaxTimeoutUs);
+}
+
+// 对端证书由SDP中的指纹校验，握手中接受任何证书
+int VerifyCallback(int /*ok*/, X509_STORE_CTX* /*store*/) {
+    return 1;
+}
+
+// "sha-256" -> EVP_sha256()
+const EVP_MD* DigestFromName(const std::string& algorithm) {
+    std::string name;
+    for (char c : algorithm) {
+        if (c != '-') {
+            name.push_back((char)toupper((unsigned char)c));
+        }
+    }
+    return EVP_get_digestbyname(name.c_str());
+}
+
+// 大写十六进制，冒号分隔
+std::string ComputeFingerprint(X509* x509, const EVP_MD* md) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int size = 0;
+    if (!md || X509_digest(x509, md, digest, &size) != 1) {
+        return "";
+    }
+
+    static const char kHex[] = "0123456789ABCDEF";
+    std::string fingerprint;
+    for (unsigned int i = 0; i < size; ++i) {
+        if (i > 0) {
+            fingerprint.push_back(':');
+        }
+        fingerprint.push_back(kHex[digest[i] >> 4]);
+        fingerprint.push_back(kHex[digest[i] & 0x0F]);
+    }
+    return fingerprint;
+}
+
+bool EqualsIgnoreCase(const std::string& a, const std::string& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (toupper((unsigned char)a[i]) != toupper((unsigned char)b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string SslErrorString() {
+    char buffer[256] = { 0 };
+    unsigned long err = ERR_get_error();
+    ERR_error_string_n(err, buffer, sizeof(buffer));
+    ERR_clear_error();
+    return err ? buffer : "none";
+}
+
+const char* DtlsStateToString(DtlsState state) {
+    switch (state) {
+    case DtlsState::kNew:
+        return "new";
+    case DtlsState::kConnecting:
+        return "connecting";
+    case DtlsState::kConnected:
+        return "connected";
+    case DtlsState::kFailed:
+        return "failed";
+    case DtlsState::kClosed:
+        return "closed";
+    }
+    return "unknown";
+}
+
+} // namespace
+
+DtlsCertificate::~DtlsCertificate() {
+    X509_free(x509_);
+    EVP_PKEY_free(key_);
+}
+
+std::shared_ptr<DtlsCertificate> DtlsCertificate::Generate() {
+    std::shared_ptr<DtlsCertificate> certificate(new DtlsCertificate());
+    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+    bool ok = pctx && EVP_PKEY_keygen_init(pctx) == 1 &&
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) == 1 &&
+        EVP_PKEY_keygen(pctx, &certificate->key_) == 1;
+    EVP_PKEY_CTX_free(pctx);
+
+    X509* x509 = ok ? X509_new() : nullptr;
+    certificate->x509_ = x509;
+    if (x509) {
+        X509_NAME* name = X509_get_subject_name(x509);
+        ok = X509_set_version(x509, 2) == 1 &&
+            ASN1_INTEGER_set(X509_get_serialNumber(x509), (long)(rtc::CreateRandomId() >> 1)) == 1 &&
+            X509_gmtime_adj(X509_getm_notBefore(x509), -24 * 3600) &&
+            X509_gmtime_adj(X509_getm_notAfter(x509), kCertificateLifetimeDays * 24 * 3600) &&
+            X509_set_pubkey(x509, certificate->key_) == 1 &&
+            X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"xrtc",
+                -1, -1, 0) == 1 &&
+            X509_set_issuer_name(x509, name) == 1 &&
+            X509_sign(x509, certificate->key_, EVP_sha256()) > 0;
+    }
+
+    if (ok) {
+        certificate->fingerprint_ = ComputeFingerprint(x509, EVP_sha256());
+    }
+    if (!ok || certificate->fingerprint_.empty()) {
+        RTC_LOG(LS_WARNING) << "DtlsCertificate generate failed: " << SslErrorString();
+        return nullptr;
+    }
+    return certificate;
+}
+
+DtlsSrtpTransport::DtlsSrtpTransport(rtc::Thread* network_thread, IceTransport* ice_transport,
+    std::shared_ptr<DtlsCertificate> certificate, DtlsRole role, const DtlsConfig& config,
+    DtlsSrtpObserver* observer) :
+    network_thread_(network_thread),
+    ice_transport_(ice_transport),
+    certificate_(std::move(certificate)),
+    role_(role),
+    config_(config),
+    observer_(observer),
+    alive_(std::make_shared<bool>(true))
+{
+    ice_transport_->SignalReadPacket.connect(this, &DtlsSrtpTransport::OnIcePacket);
+}
+
+DtlsSrtpTransport::~DtlsSrtpTransport() {
+    // 通知对端关闭，ICE在这之后才释放
+    if (state_ == DtlsState::kConnected) {
+        SSL_shutdown(ssl_);
+    }
+    SSL_free(ssl_);
+    SSL_CTX_free(ssl_ctx_);
+}
+
+bool DtlsSrtpTransport::SetRemoteFingerprint(const std::string& algorithm,
+    const std::string& fingerprint)
+{
+    if (!DigestFromName(algorithm) || fingerprint.empty()) {
+        RTC_LOG(LS_WARNING) << "DtlsSrtpTransport unsupported fingerprint: " << algorithm;
+        return false;
+    }
+
+    remote_fingerprint_algorithm_ = algorithm;
+    remote_fingerprint_ = fingerprint;
+    return true;
+}
+
+void DtlsSrtpTransport::Start() {
+    if (state_ == DtlsState::kConnecting) {
+        for (const std::vector<uint8_t>& packet : unsent_) {
+            ice_transport_->SendPacket(packet.data(), packet.size());
+        }
+        unsent_.clear();
+        return;
+    }
+    if (state_ != DtlsState::kNew) {
+        return;
+    }
+
+    start_ms_ = rtc::TimeMillis();
+    if (!CreateSsl()) {
+        RTC_LOG(LS_WARNING) << "DtlsSrtpTransport create ssl failed: " << SslErrorString();
+        SetState(DtlsState::kFailed);
+        return;
+    }
+
+    SetState(DtlsState::kConnecting);
+    if (role_ == DtlsRole::kClient) {
+        ContinueHandshake();
+    }
+    else {
+        ScheduleTimer();
+    }
+}
+
+bool DtlsSrtpTransport::CreateSsl() {
+    std::string profiles;
+    for (SrtpProfile profile : config_.srtp_profiles) {
+        profiles += (profiles.empty() ? "" : ":") + std::string(SrtpSession::ProfileName(profile));
+    }
+
+    ssl_ctx_ = SSL_CTX_new(DTLS_method());
+    if (!ssl_ctx_ || !certificate_ ||
+        SSL_CTX_set_min_proto_version(ssl_ctx_, DTLS1_2_VERSION) != 1 ||
+        SSL_CTX_use_certificate(ssl_ctx_, certificate_->x509()) != 1 ||
+        SSL_CTX_use_PrivateKey(ssl_ctx_, certificate_->key()) != 1 ||
+        SSL_CTX_set_tlsext_use_srtp(ssl_ctx_, profiles.c_str()) != 0)//成功返回0
+    {
+        return false;
+    }
+    SSL_CTX_set_verify(ssl_ctx_, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT,
+        VerifyCallback);
+
+    ssl_ = SSL_new(ssl_ctx_);
+    BIO* bio = ssl_ ? BIO_new(GetBioMethod()) : nullptr;
+    if (!bio) {
+        return false;
+    }
+    BIO_set_data(bio, this);
+    BIO_set_init(bio, 1);
+    SSL_set_bio(ssl_, bio, bio);
+
+    // MTU固定，不向BIO查询路径MTU
+    SSL_set_options(ssl_, SSL_OP_NO_QUERY_MTU);
+    SSL_set_mtu(ssl_, kDtlsMtu);
+    DTLS_set_timer_cb(ssl_, DtlsTimerCallback);
+    if (role_ == DtlsRole::kClient) {
+        SSL_set_connect_state(ssl_);
+    }
+    else {
+        SSL_set_accept_state(ssl_);
+    }
+    return true;
+}
+
+BIO_METHOD* DtlsSrtpTransport::GetBioMethod() {
+    static BIO_METHOD* method = []() {
+        BIO_METHOD* m = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "xrtc_dtls");
+        BIO_meth_set_write(m, &DtlsSrtpTransport::BioWrite);
+        BIO_meth_set_read(m, &DtlsSrtpTransport::BioRead);
+        BIO_meth_set_ctrl(m, &DtlsSrtpTransport::BioCtrl);
+        return m;
+    }();
+    return method;
+}
+
+// DTLS每次写一个完整的UDP包，直接在选中的候选对上发出，发送失败按丢包处理，由重传恢复
+int DtlsSrtpTransport::BioWrite(BIO* bio, const char* data, int size) {
+    DtlsSrtpTransport* transport = (DtlsSrtpTransport*)BIO_get_data(bio);
+    ++transport->dtls_packets_sent_;
+    if (transport->ice_transport_->SendPacket((const uint8_t*)data, size)) {
+        transport->unsent_.clear();
+    }
+    else if (transport->state_ == DtlsState::kConnecting) {
+        transport->unsent_.emplace_back((const uint8_t*)data, (const uint8_t*)data + size);
+    }
+    return size;
+}
+
+int DtlsSrtpTransport::BioRead(BIO* bio, char* out, int size) {
+    DtlsSrtpTransport* transport = (DtlsSrtpTransport*)BIO_get_data(bio);
+    BIO_clear_retry_flags(bio);
+    if (!transport->pending_data_) {
+        BIO_set_retry_read(bio);
+        return -1;
+    }
+
+    int read = std::min(size, (int)transport->pending_size_);
+    memcpy(out, transport->pending_data_, read);
+    transport->pending_data_ = nullptr;
+    transport->pending_size_ = 0;
+    return read;
+}
+
+long DtlsSrtpTransport::BioCtrl(BIO* /*bio*/, int cmd, long /*num*/, void* /*ptr*/) {
+    switch (cmd) {
+    case BIO_CTRL_FLUSH:
+        return 1;
+    case BIO_CTRL_DGRAM_QUERY_MTU:
+        return kDtlsMtu;
+    default:
+        return 0;
+    }
+}
+
+void DtlsSrtpTransport::OnIcePacket(const uint8_t* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    if (data[0] >= 20 && data[0] <= 63) {
+        OnDtlsPacket(data, size);
+    }
+    else if (data[0] >= 128 && data[0] <= 191) {
+        OnSrtpPacket(data, size);
+    }
+}
+
+void DtlsSrtpTransport::OnDtlsPacket(const uint8_t* data, size_t size) {
+    // 服务端可能在ICE通知连通之前就收到ClientHello
+    if (state_ == DtlsState::kNew && role_ == DtlsRole::kServer) {
+        Start();
+    }
+    if (state_ != DtlsState::kConnecting && state_ != DtlsState::kConnected) {
+        return;
+    }
+
+    ++dtls_packets_received_;
+    pending_data_ = data;
+    pending_size_ = size;
+    if (state_ == DtlsState::kConnecting) {
+        ContinueHandshake();
+    }
+    else {
+        // 握手之后只有对端重传的Finished和关闭通知，SSL_read内部处理
+        uint8_t buffer[kMaxDtlsPacketSize];
+        int read = SSL_read(ssl_, buffer, sizeof(buffer));
+        if (read <= 0 && SSL_get_error(ssl_, read) == SSL_ERROR_ZERO_RETURN) {
+            RTC_LOG(LS_INFO) << "DtlsSrtpTransport closed by remote";
+            SetState(DtlsState::kClosed);
+        }
+        ERR_clear_error();
+    }
+    pending_data_ = nullptr;
+    pending_size_ = 0;
+}
+
+void DtlsSrtpTransport::OnSrtpPacket(const uint8_t* data, size_t size) {
+    if (state_ != DtlsState::kConnected || size < 2) {
+        return;
+    }
+
+    recv_buffer_.assign(data, data + size);
+    // RFC 5761：payload type在192~223之间的是RTCP
+    bool rtcp = data[1] >= 192 && data[1] <= 223;
+    if (rtcp) {
+        if (recv_session_.UnprotectRtcp(recv_buffer_.data(), &size)) {
+            ++rtcp_received_;
+            if (observer_) {
+                observer_->OnRtcpPacket(recv_buffer_.data(), size);
+            }
+        }
+    }
+    else if (recv_session_.UnprotectRtp(recv_buffer_.data(), &size) && observer_) {
+        observer_->OnRtpPacket(recv_buffer_.data(), size);
+    }
+}
+
+void DtlsSrtpTransport::ContinueHandshake() {
+    int ret = SSL_do_handshake(ssl_);
+    if (ret == 1) {
+        if (!VerifyPeerCertificate() || !SetupSrtp()) {
+            SetState(DtlsState::kFailed);
+            return;
+        }
+
+        handshake_ms_ = rtc::TimeMillis() - start_ms_;
+        RTC_LOG(LS_INFO) << "DtlsSrtpTransport connected, profile: "
+            << SrtpSession::ProfileName(send_session_.profile()) << ", elapsed: "
+            << handshake_ms_ << " ms, retransmits: " << dtls_retransmits_;
+        unsent_.clear();
+        SetState(DtlsState::kConnected);
+        return;
+    }
+
+    int err = SSL_get_error(ssl_, ret);
+    if (err == SSL_ERROR_WANT_READ) {
+        ScheduleTimer();
+        return;
+    }
+
+    RTC_LOG(LS_WARNING) << "DtlsSrtpTransport handshake failed, error: " << err << ", "
+        << SslErrorString();
+    SetState(DtlsState::kFailed);
+}
+
+bool DtlsSrtpTransport::VerifyPeerCertificate() {
+    X509* peer = SSL_get_peer_certificate(ssl_);
+    if (!peer) {
+        RTC_LOG(LS_WARNING) << "DtlsSrtpTransport no peer certificate";
+        return false;
+    }
+
+    std::string fingerprint = ComputeFingerprint(peer, DigestFromName(remote_fingerprint_algorithm_));
+    X509_free(peer);
+    if (fingerprint.empty() || !EqualsIgnoreCase(fingerprint, remote_fingerprint_)) {
+        RTC_LOG(LS_WARNING) << "DtlsSrtpTransport fingerprint mismatch, expected: "
+            << remote_fingerprint_ << ", actual: " << fingerprint;
+        return false;
+    }
+    return true;
+}
+
+// RFC 5764 4.2：导出client_key | server_key | client_salt | server_salt
+bool DtlsSrtpTransport::SetupSrtp() {
+    const SRTP_PROTECTION_PROFILE* selected = SSL_get_selected_srtp_profile(ssl_);
+    SrtpProfile profile = selected ? SrtpSession::ProfileFromName(selected->name) :
+        SrtpProfile::kNone;
+    if (profile == SrtpProfile::kNone) {
+        RTC_LOG(LS_WARNING) << "DtlsSrtpTransport no srtp profile negotiated";
+        return false;
+    }
+
+    size_t key_length = SrtpSession::KeyLength(profile);
+    size_t salt_length = SrtpSession::SaltLength(profile);
+    std::vector<uint8_t> material(2 * (key_length + salt_length));
+    if (SSL_export_keying_material(ssl_, material.data(), material.size(), kSrtpExporterLabel,
+        sizeof(kSrtpExporterLabel) - 1, nullptr, 0, 0) != 1)
+    {
+        RTC_LOG(LS_WARNING) << "DtlsSrtpTransport export keying material failed: "
+            << SslErrorString();
+        return false;
+    }
+
+    const uint8_t* client_key = material.data();
+    const uint8_t* server_key = client_key + key_length;
+    const uint8_t* client_salt = server_key + key_length;
+    const uint8_t* server_salt = client_salt + salt_length;
+    bool client = role_ == DtlsRole::kClient;
+    bool ok = send_session_.Init(profile, client ? client_key : server_key,
+        client ? client_salt : server_salt) &&
+        recv_session_.Init(profile, client ? server_key : client_key,
+            client ? server_salt : client_salt);
+    OPENSSL_cleanse(material.data(), material.size());
+    return ok;
+}
+
+// 握手期间跟随DTLS的重传定时器，同时检查握手超时
+void DtlsSrtpTransport::ScheduleTimer() {
+    int64_t delay_ms = start_ms_ + config_.handshake_timeout_ms - rtc::TimeMillis();
+    timeval timeout = { 0, 0 };
+    if (DTLSv1_get_timeout(ssl_, &timeout) == 1) {
+        delay_ms = std::min<int64_t>(delay_ms,
+            (int64_t)timeout.tv_sec * 1000 + timeout.tv_usec / 1000);
+    }
+
+    uint64_t generation = ++timer_generation_;
+    std::weak_ptr<bool> alive = alive_;
+    network_thread_->PostDelayedTask(webrtc::ToQueuedTask([=]() {
+        if (alive.expired() || generation != timer_generation_) {
+            return;
+        }
+        OnTimer();
+    }), (uint32_t)std::max<int64_t>(1, delay_ms));
+}
+
+void DtlsSrtpTransport::OnTimer() {
+    if (state_ != DtlsState::kConnecting) {
+        return;
+    }
+
+    if (rtc::TimeMillis() - start_ms_ >= config_.handshake_timeout_ms) {
+        RTC_LOG(LS_WARNING) << "DtlsSrtpTransport handshake timeout, packets sent: "
+            << dtls_packets_sent_ << ", received: " << dtls_packets_received_;
+        SetState(DtlsState::kFailed);
+        return;
+    }
+
+    if (DTLSv1_handle_timeout(ssl_) > 0) {
+        ++dtls_retransmits_;
+    }
+    ScheduleTimer();
+}
+
+void DtlsSrtpTransport::SetState(DtlsState state) {
+    if (state_ == state) {
+        return;
+    }
+
+    RTC_LOG(LS_INFO) << "DtlsSrtpTransport state: " << DtlsStateToString(state_) << " -> "
+        << DtlsStateToString(state);
+    state_ = state;
+    if (observer_) {
+        observer_->OnDtlsStateChanged(state);
+    }
+}
+
+bool DtlsSrtpTransport::SendBatch(RtpPacketBatch& batch) {
+    if (state_ != DtlsState::kConnected) {
+        return false;
+    }
+
+    int64_t start_us = rtc::TimeMicros();
+    if (!send_session_.ProtectRtp(&batch)) {
+        ++protect_errors_;
+        return false;
+    }
+    protect_us_ += rtc::TimeMicros() - start_us;
+    packets_protected_ += batch.packet_count();
+    return ice_transport_->SendBatch(batch);
+}
+
+bool DtlsSrtpTransport::SendRtcp(uint8_t* data, size_t size, size_t capacity) {
+    if (state_ != DtlsState::kConnected) {
+        return false;
+    }
+
+    if (!send_session_.ProtectRtcp(data, &size, capacity)) {
+        ++protect_errors_;
+        return false;
+    }
+    return ice_transport_->SendPacket(data, size);
+}
+
+void DtlsSrtpTransport::GetStats(JsonObject& stats) {
+    stats["state"] = DtlsStateToString(state_);
+    stats["role"] = role_ == DtlsRole::kClient ? "client" : "server";
+    stats["srtp_profile"] = SrtpSession::ProfileName(send_session_.profile());
+    stats["handshake_ms"] = handshake_ms_;
+    stats["dtls_packets_sent"] = dtls_packets_sent_;
+    stats["dtls_packets_received"] = dtls_packets_received_;
+    stats["dtls_retransmits"] = dtls_retransmits_;
+    stats["packets_protected"] = packets_protected_;
+    stats["protect_ns_per_packet"] = packets_protected_ > 0 ?
+        protect_us_ * 1000 / packets_protected_ : 0;
+    stats["protect_errors"] = protect_errors_;
+    stats["rtcp_received"] = rtcp_received_;
+    stats["unprotect_failures"] = recv_session_.auth_failures();
+}
+
+} // namespace xrtc
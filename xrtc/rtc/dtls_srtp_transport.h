@@ -0,0 +1,162 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_DTLS_SRTP_TRANSPORT_H_
+#define XRTCSDK_XRTC_RTC_DTLS_SRTP_TRANSPORT_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <rtc_base/third_party/sigslot/sigslot.h>
+#include <rtc_base/thread.h>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/rtc/rtp_transport.h"
+#include "xrtc/rtc/srtp_session.h"
+
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct bio_st BIO;
+typedef struct bio_method_st BIO_METHOD;
+typedef struct x509_st X509;
+typedef struct evp_pkey_st EVP_PKEY;
+
+namespace xrtc {
+
+class IceTransport;
+
+// 自签名的ECDSA P-256证书，生成需要几毫秒，同一个推流对象重复推流时复用
+class DtlsCertificate {
+public:
+    ~DtlsCertificate();
+
+    static std::shared_ptr<DtlsCertificate> Generate();
+    // SDP的a=fingerprint，算法固定为sha-256
+    const std::string& fingerprint() const { return fingerprint_; }
+    X509* x509() const { return x509_; }
+    EVP_PKEY* key() const { return key_; }
+
+private:
+    DtlsCertificate() = default;
+
+private:
+    X509* x509_ = nullptr;
+    EVP_PKEY* key_ = nullptr;
+    std::string fingerprint_;
+};
+
+enum class DtlsState {
+    kNew,
+    kConnecting,
+    kConnected,
+    kFailed,
+    kClosed,
+};
+
+// a=setup:active为客户端，推流端回复服务端的actpass时总是active
+enum class DtlsRole {
+    kClient,
+    kServer,
+};
+
+struct DtlsConfig {
+    // 按优先级排列，默认优先AES-GCM：认证和加密一次完成，有AES-NI/PCLMULQDQ时比AES-CM+HMAC-SHA1快
+    std::vector<SrtpProfile> srtp_profiles = {
+        SrtpProfile::kAeadAes128Gcm, SrtpProfile::kAes128CmSha1_80 };
+    int handshake_timeout_ms = 10000;
+};
+
+// 以下都在network_thread上回调
+class DtlsSrtpObserver {
+public:
+    virtual ~DtlsSrtpObserver() {}
+    virtual void OnDtlsStateChanged(DtlsState state) = 0;
+    // 解密之后的包，data可以在回调中修改
+    virtual void OnRtpPacket(uint8_t* /*data*/, size_t /*size*/) {}
+    virtual void OnRtcpPacket(uint8_t* /*data*/, size_t /*size*/) {}
+};
+
+// ICE之上的DTLS-SRTP(RFC 5764)：DTLS握手协商SRTP profile并导出主密钥，之后媒体用SRTP发送，
+// DTLS只用于握手。包按RFC 7983的第一个字节解复用：20~63为DTLS，128~191为SRTP/SRTCP
+// 握手通过自定义的BIO直接收发，每个DTLS记录一个UDP包，不经过内存BIO的拷贝和拼接；重传定时器从100ms开始翻倍
+// SendBatch把一帧的所有包在打包的缓冲中原地加密，然后整批交给ICE发送
+// ICE重启和切换候选对不影响DTLS，不重新握手。创建、调用和析构都只在network_thread上
+class DtlsSrtpTransport : public RtpTransport, public sigslot::has_slots<> {
+public:
+    DtlsSrtpTransport(rtc::Thread* network_thread, IceTransport* ice_transport,
+        std::shared_ptr<DtlsCertificate> certificate, DtlsRole role, const DtlsConfig& config,
+        DtlsSrtpObserver* observer);
+    ~DtlsSrtpTransport() override;
+
+    // 对端SDP中的指纹，握手完成时校验对端证书
+    bool SetRemoteFingerprint(const std::string& algorithm, const std::string& fingerprint);
+    // ICE连通时调用，客户端发出ClientHello；服务端在自己的ICE连通之前回复的flight发不出去，
+    // 连通时立即补发，不等重传定时器
+    void Start();
+
+    // RtpTransport，握手完成之前返回false
+    bool SendBatch(RtpPacketBatch& batch) override;
+    // 原地加密一个RTCP包，data后面需要预留SrtpSession::kMaxTrailerSize字节
+    bool SendRtcp(uint8_t* data, size_t size, size_t capacity);
+
+    DtlsState state() const { return state_; }
+    SrtpProfile srtp_profile() const { return send_session_.profile(); }
+    void GetStats(JsonObject& stats);
+
+private:
+    // BIO的回调，数据指针是DtlsSrtpTransport
+    static BIO_METHOD* GetBioMethod();
+    static int BioWrite(BIO* bio, const char* data, int size);
+    static int BioRead(BIO* bio, char* out, int size);
+    static long BioCtrl(BIO* bio, int cmd, long num, void* ptr);
+
+    bool CreateSsl();
+    void OnIcePacket(const uint8_t* data, size_t size);
+    void OnDtlsPacket(const uint8_t* data, size_t size);
+    void OnSrtpPacket(const uint8_t* data, size_t size);
+    void ContinueHandshake();
+    bool VerifyPeerCertificate();
+    bool SetupSrtp();
+    void ScheduleTimer();
+    void OnTimer();
+    void SetState(DtlsState state);
+
+private:
+    rtc::Thread* network_thread_;
+    IceTransport* ice_transport_;
+    std::shared_ptr<DtlsCertificate> certificate_;
+    DtlsRole role_;
+    DtlsConfig config_;
+    DtlsSrtpObserver* observer_;
+    DtlsState state_ = DtlsState::kNew;
+    std::shared_ptr<bool> alive_;//定时任务持有弱引用，析构之后不再执行
+
+    SSL_CTX* ssl_ctx_ = nullptr;
+    SSL* ssl_ = nullptr;
+    // 收到的DTLS包只在SSL_do_handshake/SSL_read期间有效，由BioRead一次读完
+    const uint8_t* pending_data_ = nullptr;
+    size_t pending_size_ = 0;
+    std::vector<std::vector<uint8_t>> unsent_;//ICE没有选中的候选对时发送失败的DTLS包
+    std::string remote_fingerprint_algorithm_;
+    std::string remote_fingerprint_;
+    uint64_t timer_generation_ = 0;
+
+    SrtpSession send_session_;
+    SrtpSession recv_session_;
+    std::vector<uint8_t> recv_buffer_;//解密在拷贝上进行，ICE的接收缓冲是只读的
+
+    // 统计
+    int64_t start_ms_ = 0;
+    int64_t handshake_ms_ = -1;
+    int dtls_packets_sent_ = 0;
+    int dtls_packets_received_ = 0;
+    int dtls_retransmits_ = 0;
+    int64_t packets_protected_ = 0;
+    int64_t protect_us_ = 0;
+    int64_t protect_errors_ = 0;
+    int64_t rtcp_received_ = 0;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_DTLS_SRTP_TRANSPORT_H_
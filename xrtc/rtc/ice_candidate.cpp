@@ -0,0 +1,100 @@
+﻿#include "xrtc/rtc/ice_candidate.h"
+
+#include <stdlib.h>
+
+#include <sstream>
+#include <vector>
+
+namespace xrtc {
+
+const char kIceCandidateHost[] = "host";
+const char kIceCandidateServerReflexive[] = "srflx";
+const char kIceCandidatePeerReflexive[] = "prflx";
+const char kIceCandidateRelay[] = "relay";
+
+namespace {
+
+// RFC 8445推荐的类型优先级
+int TypePreference(const std::string& type) {
+    if (type == kIceCandidateHost) {
+        return 126;
+    }
+    if (type == kIceCandidatePeerReflexive) {
+        return 110;
+    }
+    if (type == kIceCandidateServerReflexive) {
+        return 100;
+    }
+    return 0;
+}
+
+} // namespace
+
+uint32_t IceCandidate::ComputePriority(const std::string& type, int local_preference,
+    int component)
+{
+    return ((uint32_t)TypePreference(type) << 24) | ((uint32_t)(local_preference & 0xFFFF) << 8) |
+        (uint32_t)(256 - component);
+}
+
+bool IceCandidate::Parse(const std::string& line, IceCandidate* candidate) {
+    std::string str = line;
+    if (str.compare(0, 2, "a=") == 0) {
+        str = str.substr(2);
+    }
+    if (str.compare(0, 10, "candidate:") != 0) {
+        return false;
+    }
+
+    std::istringstream ss(str.substr(10));
+    std::vector<std::string> fields;
+    std::string field;
+    while (ss >> field) {
+        fields.push_back(field);
+    }
+    // foundation component protocol priority ip port typ type [raddr ip rport port]
+    if (fields.size() < 8 || fields[6] != "typ") {
+        return false;
+    }
+
+    IceCandidate result;
+    result.foundation = fields[0];
+    result.component = atoi(fields[1].c_str());
+    result.protocol = fields[2];
+    result.priority = (uint32_t)strtoul(fields[3].c_str(), nullptr, 10);
+    int port = atoi(fields[5].c_str());
+    rtc::IPAddress ip;
+    if (!rtc::IPFromString(fields[4], &ip) || port <= 0 || port > 65535) {
+        return false;
+    }
+    result.address = rtc::SocketAddress(ip, port);
+    result.type = fields[7];
+
+    for (size_t i = 8; i + 1 < fields.size(); i += 2) {
+        if (fields[i] == "raddr") {
+            rtc::IPAddress related_ip;
+            if (rtc::IPFromString(fields[i + 1], &related_ip)) {
+                result.related_address.SetIP(related_ip);
+            }
+        }
+        else if (fields[i] == "rport") {
+            result.related_address.SetPort(atoi(fields[i + 1].c_str()));
+        }
+    }
+
+    *candidate = result;
+    return true;
+}
+
+std::string IceCandidate::ToString() const {
+    std::ostringstream ss;
+    ss << "candidate:" << foundation << " " << component << " " << protocol << " " << priority
+        << " " << address.ipaddr().ToString() << " " << address.port() << " typ " << type;
+    if (type != kIceCandidateHost && !related_address.IsNil()) {
+        ss << " raddr " << related_address.ipaddr().ToString()
+            << " rport " << related_address.port();
+    }
+    return ss.str();
+}
+
+} // namespace xrtc
@@ -0,0 +1,36 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_ICE_CANDIDATE_H_
+#define XRTCSDK_XRTC_RTC_ICE_CANDIDATE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include <rtc_base/socket_address.h>
+
+namespace xrtc {
+
+extern const char kIceCandidateHost[];
+extern const char kIceCandidateServerReflexive[];
+extern const char kIceCandidatePeerReflexive[];
+extern const char kIceCandidateRelay[];
+
+// ICE候选(RFC 8445)，只支持UDP
+struct IceCandidate {
+    std::string foundation;
+    int component = 1;//RTP和RTCP复用，只有component 1
+    std::string protocol = "udp";
+    uint32_t priority = 0;
+    rtc::SocketAddress address;
+    std::string type = kIceCandidateHost;
+    rtc::SocketAddress related_address;//srflx/prflx的基地址
+
+    // priority = 2^24 * type_preference + 2^8 * local_preference + (256 - component)
+    static uint32_t ComputePriority(const std::string& type, int local_preference, int component);
+    // "candidate:1 1 udp 2122260223 192.168.1.2 54321 typ host"，可以带"a="前缀
+    static bool Parse(const std::string& line, IceCandidate* candidate);
+    std::string ToString() const;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_ICE_CANDIDATE_H_
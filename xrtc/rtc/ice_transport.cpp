@@ -0,0 +1,955 @@
+﻿#include "xrtc/rtc/ice_transport.h"
+
+#if defined(WEBRTC_WIN)
+#include <winsock2.h>
+#include <ws2ipdef.h>
+#include <iphlpapi.h>
+#else
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#endif
+
+#include <algorithm>
+
+#include <rtc_base/async_udp_socket.h>
+#include <rtc_base/crc32.h>
+#include <rtc_base/helpers.h>
+#include <rtc_base/ip_address.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/time_utils.h>
+
+#include "xrtc/rtc/rtp_packetizer.h"
+#include "xrtc/rtc/stun_message.h"
+
+namespace xrtc {
+
+namespace {
+
+const size_t kIceUfragLength = 16;
+const size_t kIcePwdLength = 32;
+const int kSendBufferSize = 1024 * 1024;
+// 网卡的增减通过定时枚举发现，getifaddrs的开销很小
+const int kNetworkPollIntervalMs = 1000;
+
+void AddLocalAddress(const sockaddr* addr, bool include_loopback,
+    std::vector<rtc::IPAddress>* addresses)
+{
+    rtc::IPAddress ip;
+    if (addr->sa_family == AF_INET) {
+        ip = rtc::IPAddress(((const sockaddr_in*)addr)->sin_addr);
+    } else if (addr->sa_family == AF_INET6) {
+        const in6_addr& ip6 = ((const sockaddr_in6*)addr)->sin6_addr;
+        // 链路本地地址需要scope id才能使用，不作为候选
+        if (IN6_IS_ADDR_LINKLOCAL(&ip6)) {
+            return;
+        }
+        ip = rtc::IPAddress(ip6);
+    } else {
+        return;
+    }
+
+    if (rtc::IPIsLoopback(ip) && !include_loopback) {
+        return;
+    }
+    if (std::find(addresses->begin(), addresses->end(), ip) == addresses->end()) {
+        addresses->push_back(ip);
+    }
+}
+
+std::vector<rtc::IPAddress> GetLocalAddresses(bool include_loopback) {
+    std::vector<rtc::IPAddress> addresses;
+#if defined(WEBRTC_WIN)
+    ULONG flags = GAA_FLAG_SKIP_ANYCAST | GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER;
+    ULONG size = 16 * 1024;
+    std::vector<uint8_t> buffer(size);
+    ULONG ret = GetAdaptersAddresses(AF_UNSPEC, flags, nullptr,
+        (IP_ADAPTER_ADDRESSES*)buffer.data(), &size);
+    if (ret == ERROR_BUFFER_OVERFLOW) {
+        buffer.resize(size);
+        ret = GetAdaptersAddresses(AF_UNSPEC, flags, nullptr,
+            (IP_ADAPTER_ADDRESSES*)buffer.data(), &size);
+    }
+    if (ret != NO_ERROR) {
+        RTC_LOG(LS_WARNING) << "GetAdaptersAddresses failed, error: " << ret;
+        return addresses;
+    }
+
+    for (IP_ADAPTER_ADDRESSES* adapter = (IP_ADAPTER_ADDRESSES*)buffer.data(); adapter;
+        adapter = adapter->Next)
+    {
+        if (adapter->OperStatus != IfOperStatusUp) {
+            continue;
+        }
+        for (IP_ADAPTER_UNICAST_ADDRESS* unicast = adapter->FirstUnicastAddress; unicast;
+            unicast = unicast->Next)
+        {
+            AddLocalAddress(unicast->Address.lpSockaddr, include_loopback, &addresses);
+        }
+    }
+#else
+    ifaddrs* interfaces = nullptr;
+    if (getifaddrs(&interfaces) != 0) {
+        RTC_LOG(LS_WARNING) << "getifaddrs failed, error: " << errno;
+        return addresses;
+    }
+
+    for (ifaddrs* cur = interfaces; cur; cur = cur->ifa_next) {
+        if (!cur->ifa_addr || !(cur->ifa_flags & IFF_UP) || !(cur->ifa_flags & IFF_RUNNING)) {
+            continue;
+        }
+        AddLocalAddress(cur->ifa_addr, include_loopback, &addresses);
+    }
+    freeifaddrs(interfaces);
+#endif
+    return addresses;
+}
+
+std::string ComputeFoundation(const std::string& type, const rtc::IPAddress& base) {
+    std::string key = type + base.ToString();
+    return std::to_string(rtc::ComputeCrc32(key.data(), key.size()));
+}
+
+const char* IceStateToString(IceTransportState state) {
+    switch (state) {
+    case IceTransportState::kNew:
+        return "new";
+    case IceTransportState::kChecking:
+        return "checking";
+    case IceTransportState::kConnected:
+        return "connected";
+    case IceTransportState::kDisconnected:
+        return "disconnected";
+    case IceTransportState::kFailed:
+        return "failed";
+    case IceTransportState::kClosed:
+        return "closed";
+    }
+    return "unknown";
+}
+
+} // namespace
+
+IceTransport::IceTransport(rtc::Thread* network_thread, const IceConfig& config,
+    IceTransportObserver* observer) :
+    network_thread_(network_thread),
+    config_(config),
+    observer_(observer),
+    tie_breaker_(rtc::CreateRandomId64()),
+    alive_(std::make_shared<bool>(true))
+{
+    local_parameters_.ufrag = rtc::CreateRandomString(kIceUfragLength);
+    local_parameters_.pwd = rtc::CreateRandomString(kIcePwdLength);
+}
+
+IceTransport::~IceTransport() {
+    Stop();
+}
+
+bool IceTransport::Start(const IceParameters& remote_parameters,
+    const std::vector<IceCandidate>& remote_candidates)
+{
+    if (state_ != IceTransportState::kNew) {
+        return state_ != IceTransportState::kClosed && state_ != IceTransportState::kFailed;
+    }
+
+    start_ms_ = rtc::TimeMillis();
+    last_network_poll_ms_ = start_ms_;
+    connect_deadline_ms_ = start_ms_ + config_.connect_timeout_ms;
+    remote_parameters_ = remote_parameters;
+    remote_candidates_ = remote_candidates;
+
+    for (const rtc::IPAddress& ip : GetLocalAddresses(config_.include_loopback)) {
+        AddPort(ip);
+    }
+    if (ports_.empty()) {
+        RTC_LOG(LS_WARNING) << "IceTransport no usable network interface";
+        return false;
+    }
+
+    SetState(IceTransportState::kChecking);
+    for (auto& port : ports_) {
+        SendSrflxRequests(port.get());
+    }
+    MaybeGatheringComplete();
+
+    for (const IceCandidate& candidate : remote_candidates_) {
+        for (auto& port : ports_) {
+            AddPair(port.get(), candidate);
+        }
+    }
+
+    // 第一个检查不等Ta，和srflx请求同时发出
+    Tick();
+    return true;
+}
+
+void IceTransport::AddRemoteCandidate(const IceCandidate& candidate) {
+    if (state_ != IceTransportState::kChecking && state_ != IceTransportState::kConnected &&
+        state_ != IceTransportState::kDisconnected)
+    {
+        return;
+    }
+
+    remote_candidates_.push_back(candidate);
+    for (auto& port : ports_) {
+        AddPair(port.get(), candidate);
+    }
+    Tick();
+}
+
+IceParameters IceTransport::PrepareRestart() {
+    pending_local_parameters_.ufrag = rtc::CreateRandomString(kIceUfragLength);
+    pending_local_parameters_.pwd = rtc::CreateRandomString(kIcePwdLength);
+    return pending_local_parameters_;
+}
+
+void IceTransport::Restart(const IceParameters& remote_parameters,
+    const std::vector<IceCandidate>& remote_candidates)
+{
+    if (state_ == IceTransportState::kNew || state_ == IceTransportState::kClosed ||
+        state_ == IceTransportState::kFailed)
+    {
+        return;
+    }
+
+    RTC_LOG(LS_INFO) << "IceTransport restart, state: " << IceStateToString(state_)
+        << ", remote candidates: " << remote_candidates.size();
+    ++restarts_;
+    if (!pending_local_parameters_.ufrag.empty()) {
+        local_parameters_ = pending_local_parameters_;
+        pending_local_parameters_ = IceParameters();
+    }
+    remote_parameters_ = remote_parameters;
+    remote_candidates_ = remote_candidates;
+
+    // 只保留srflx请求，检查和候选对全部重来
+    for (auto it = requests_.begin(); it != requests_.end();) {
+        it = it->second->pair ? requests_.erase(it) : ++it;
+    }
+    if (selected_) {
+        last_selected_response_ms_ = selected_->last_response_ms;
+        selected_ = nullptr;
+    }
+    pairs_.clear();
+    for (const IceCandidate& candidate : remote_candidates_) {
+        for (auto& port : ports_) {
+            AddPair(port.get(), candidate);
+        }
+    }
+
+    connect_deadline_ms_ = rtc::TimeMillis() + config_.connect_timeout_ms;
+    SetState(IceTransportState::kChecking);
+    Tick();
+}
+
+void IceTransport::Stop() {
+    if (state_ == IceTransportState::kClosed) {
+        return;
+    }
+
+    if (state_ != IceTransportState::kNew) {
+        RTC_LOG(LS_INFO) << "IceTransport stop, state: " << IceStateToString(state_)
+            << ", checks: " << checks_sent_ << ", retransmits: " << retransmits_
+            << ", handovers: " << handovers_ << ", restarts: " << restarts_
+            << ", packets: " << packets_sent_.count() << ", bytes: " << bytes_sent_.count();
+    }
+
+    // Stop由上层主动调用，不再回调状态
+    state_ = IceTransportState::kClosed;
+    ++tick_generation_;
+    selected_ = nullptr;
+    requests_.clear();
+    pairs_.clear();
+    ports_.clear();
+}
+
+bool IceTransport::SendBatch(RtpPacketBatch& batch) {
+    if (!selected_) {
+        return false;
+    }
+
+    rtc::PacketOptions options;
+    bool ok = true;
+    for (size_t i = 0; i < batch.packet_count(); ++i) {
+        int sent = selected_->port->socket->SendTo(batch.packet_data(i), batch.packet_size(i),
+            selected_->remote.address, options);
+        if (sent < 0) {
+            send_errors_.Add();
+            ok = false;
+            continue;
+        }
+
+        packets_sent_.Add();
+        bytes_sent_.Add(sent);
+    }
+    return ok;
+}
+
+bool IceTransport::SendPacket(const uint8_t* data, size_t size) {
+    if (!selected_) {
+        return false;
+    }
+
+    rtc::PacketOptions options;
+    if (selected_->port->socket->SendTo(data, size, selected_->remote.address, options) < 0) {
+        send_errors_.Add();
+        return false;
+    }
+    return true;
+}
+
+IceTransport::Port* IceTransport::AddPort(const rtc::IPAddress& ip) {
+    std::unique_ptr<rtc::AsyncPacketSocket> socket(rtc::AsyncUDPSocket::Create(
+        network_thread_->socketserver(), rtc::SocketAddress(ip, 0)));
+    if (!socket) {
+        RTC_LOG(LS_WARNING) << "IceTransport create socket failed, ip: " << ip.ToString();
+        return nullptr;
+    }
+    socket->SetOption(rtc::Socket::OPT_SNDBUF, kSendBufferSize);
+    socket->SignalReadPacket.connect(this, &IceTransport::OnReadPacket);
+
+    auto port = std::make_unique<Port>();
+    port->host.address = socket->GetLocalAddress();
+    port->host.type = kIceCandidateHost;
+    port->host.foundation = ComputeFoundation(kIceCandidateHost, ip);
+    // 按网卡枚举的顺序递减，系统通常把默认路由的网卡排在前面
+    port->host.priority = IceCandidate::ComputePriority(kIceCandidateHost,
+        65535 - (int)ports_.size(), 1);
+    port->socket = std::move(socket);
+
+    RTC_LOG(LS_INFO) << "IceTransport gathered " << port->host.ToString();
+    local_candidates_.push_back(port->host);
+    ports_.push_back(std::move(port));
+    return ports_.back().get();
+}
+
+// 网卡消失：删除它上面的请求、候选对和本地候选，选中的候选对在上面时按路径中断处理
+void IceTransport::RemovePort(Port* port) {
+    RTC_LOG(LS_INFO) << "IceTransport network removed: " << port->host.address.ToString();
+    for (auto it = requests_.begin(); it != requests_.end();) {
+        if (it->second->port != port) {
+            ++it;
+            continue;
+        }
+        if (!it->second->pair) {
+            --pending_srflx_;
+        }
+        it = requests_.erase(it);
+    }
+
+    if (selected_ && selected_->port == port) {
+        last_selected_response_ms_ = selected_->last_response_ms;
+        selected_ = nullptr;
+    }
+    pairs_.erase(std::remove_if(pairs_.begin(), pairs_.end(),
+        [port](const std::unique_ptr<CandidatePair>& pair) { return pair->port == port; }),
+        pairs_.end());
+
+    const rtc::SocketAddress& base = port->host.address;
+    local_candidates_.erase(std::remove_if(local_candidates_.begin(), local_candidates_.end(),
+        [&base](const IceCandidate& candidate) {
+            return candidate.address == base || candidate.related_address == base;
+        }), local_candidates_.end());
+    ports_.erase(std::find_if(ports_.begin(), ports_.end(),
+        [port](const std::unique_ptr<Port>& p) { return p.get() == port; }));
+}
+
+void IceTransport::CheckNetworkChange() {
+    std::vector<rtc::IPAddress> addresses = GetLocalAddresses(config_.include_loopback);
+    bool changed = false;
+
+    std::vector<Port*> removed;
+    for (auto& port : ports_) {
+        if (std::find(addresses.begin(), addresses.end(), port->host.address.ipaddr()) ==
+            addresses.end())
+        {
+            removed.push_back(port.get());
+        }
+    }
+    for (Port* port : removed) {
+        RemovePort(port);
+        changed = true;
+    }
+
+    for (const rtc::IPAddress& ip : addresses) {
+        auto exists = std::find_if(ports_.begin(), ports_.end(),
+            [&ip](const std::unique_ptr<Port>& p) { return p->host.address.ipaddr() == ip; });
+        if (exists != ports_.end()) {
+            continue;
+        }
+
+        Port* port = AddPort(ip);
+        if (!port) {
+            continue;
+        }
+        changed = true;
+        if (observer_) {
+            observer_->OnIceCandidate(port->host);
+        }
+        SendSrflxRequests(port);
+        for (const IceCandidate& candidate : remote_candidates_) {
+            AddPair(port, candidate);
+        }
+    }
+
+    if (changed) {
+        ++network_changes_;
+    }
+}
+
+void IceTransport::SendSrflxRequests(Port* port) {
+    // 回环地址拿不到有意义的srflx
+    if (rtc::IPIsLoopback(port->host.address.ipaddr())) {
+        return;
+    }
+
+    for (const rtc::SocketAddress& server : config_.stun_servers) {
+        if (server.family() != port->host.address.family()) {
+            continue;
+        }
+
+        StunMessage message(kStunBindingRequest);
+        auto request = std::make_unique<StunRequest>();
+        request->port = port;
+        request->to = server;
+        request->rto_ms = config_.initial_rto_ms;
+        request->max_retransmits = config_.max_retransmits;
+        message.Write("", &request->packet);
+        ++pending_srflx_;
+        gathering_complete_ = false;
+        SendRequest(std::move(request), message.transaction_id());
+    }
+}
+
+void IceTransport::AddPair(Port* port, const IceCandidate& remote) {
+    const rtc::SocketAddress& local = port->host.address;
+    if (remote.address.family() != local.family() ||
+        rtc::IPIsLoopback(remote.address.ipaddr()) != rtc::IPIsLoopback(local.ipaddr()))
+    {
+        return;
+    }
+
+    for (auto& pair : pairs_) {
+        if (pair->port == port && pair->remote.address == remote.address) {
+            return;
+        }
+    }
+
+    // RFC 8445 6.1.2.3，本端是controlling
+    uint64_t g = port->host.priority;
+    uint64_t d = remote.priority;
+    auto pair = std::make_unique<CandidatePair>();
+    pair->port = port;
+    pair->remote = remote;
+    pair->priority = ((uint64_t)1 << 32) * std::min(g, d) + 2 * std::max(g, d) + (g > d ? 1 : 0);
+    pairs_.push_back(std::move(pair));
+}
+
+void IceTransport::SendCheck(CandidatePair* pair, bool use_candidate, bool keepalive) {
+    int64_t now = rtc::TimeMillis();
+    int local_preference = (pair->port->host.priority >> 8) & 0xFFFF;
+
+    StunMessage message(kStunBindingRequest);
+    message.AddUsername(remote_parameters_.ufrag + ":" + local_parameters_.ufrag);
+    message.AddPriority(IceCandidate::ComputePriority(kIceCandidatePeerReflexive,
+        local_preference, 1));
+    message.AddIceControlling(tie_breaker_);
+    if (use_candidate) {
+        message.AddUseCandidate();
+    }
+
+    auto request = std::make_unique<StunRequest>();
+    request->port = pair->port;
+    request->pair = pair;
+    request->to = pair->remote.address;
+    request->use_candidate = use_candidate;
+    // 保活的检查定时发送，不需要重传，超时只用于清理
+    request->rto_ms = keepalive ? config_.receive_timeout_ms : config_.initial_rto_ms;
+    request->max_retransmits = keepalive ? 0 : config_.max_retransmits;
+    message.Write(remote_parameters_.pwd, &request->packet);
+
+    if (pair->state == PairState::kWaiting) {
+        pair->state = PairState::kInProgress;
+    }
+    if (first_check_ms_ < 0) {
+        first_check_ms_ = now - start_ms_;
+    }
+    pair->last_ping_ms = now;
+    ++checks_sent_;
+    SendRequest(std::move(request), message.transaction_id());
+}
+
+void IceTransport::SendRequest(std::unique_ptr<StunRequest> request,
+    const std::string& transaction_id)
+{
+    rtc::PacketOptions options;
+    request->sent_ms = rtc::TimeMillis();
+    request->next_send_ms = request->sent_ms + request->rto_ms;
+    if (request->port->socket->SendTo(request->packet.data(), request->packet.size(),
+        request->to, options) < 0)
+    {
+        // 发送失败也按丢包处理，由重传和超时收尾
+        RTC_LOG(LS_VERBOSE) << "IceTransport send stun failed, to: " << request->to.ToString()
+            << ", error: " << request->port->socket->GetError();
+    }
+    requests_[transaction_id] = std::move(request);
+}
+
+void IceTransport::Tick() {
+    if (state_ != IceTransportState::kChecking && state_ != IceTransportState::kConnected &&
+        state_ != IceTransportState::kDisconnected)
+    {
+        return;
+    }
+
+    int64_t now = rtc::TimeMillis();
+    rtc::PacketOptions options;
+
+    if (now - last_network_poll_ms_ >= kNetworkPollIntervalMs) {
+        last_network_poll_ms_ = now;
+        CheckNetworkChange();
+    }
+
+    // 重传未收到回复的请求，超过次数的请求失败
+    CandidatePair* renominate = nullptr;
+    for (auto it = requests_.begin(); it != requests_.end();) {
+        StunRequest* request = it->second.get();
+        if (now < request->next_send_ms) {
+            ++it;
+            continue;
+        }
+
+        if (request->retransmits >= request->max_retransmits) {
+            CandidatePair* pair = request->pair;
+            if (!pair) {
+                --pending_srflx_;
+                RTC_LOG(LS_INFO) << "IceTransport srflx request timeout, server: "
+                    << request->to.ToString();
+            } else {
+                // 备用候选对的检查超时不再作为备用，选中的候选对由CheckSelectedPair按接收超时判断
+                if (pair->state == PairState::kInProgress ||
+                    (pair != selected_ && now - pair->last_response_ms >
+                    config_.backup_ping_interval_ms + config_.receive_timeout_ms))
+                {
+                    pair->state = PairState::kFailed;
+                }
+                if (request->use_candidate) {
+                    pair->nominating = false;
+                    // 常规提名：候选对已经检查成功过，只是提名的检查丢了，重新提名
+                    if (!selected_ && pair->state == PairState::kSucceeded) {
+                        renominate = pair;
+                    }
+                }
+            }
+            it = requests_.erase(it);
+            continue;
+        }
+
+        ++request->retransmits;
+        ++retransmits_;
+        request->rto_ms = std::min(request->rto_ms * 2, config_.max_rto_ms);
+        request->sent_ms = now;
+        request->next_send_ms = now + request->rto_ms;
+        request->port->socket->SendTo(request->packet.data(), request->packet.size(),
+            request->to, options);
+        ++it;
+    }
+    MaybeGatheringComplete();
+    if (renominate) {
+        renominate->nominating = true;
+        SendCheck(renominate, true);
+    }
+
+    // 每个Ta发起一个新的检查，优先级最高的先检查
+    CandidatePair* next = nullptr;
+    for (auto& pair : pairs_) {
+        if (pair->state == PairState::kWaiting && (!next || pair->priority > next->priority)) {
+            next = pair.get();
+        }
+    }
+    if (next && now - last_check_ms_ >= config_.check_interval_ms) {
+        last_check_ms_ = now;
+        SendCheck(next, config_.aggressive_nomination);
+    }
+
+    CheckSelectedPair(now);
+
+    if (state_ != IceTransportState::kConnected && now >= connect_deadline_ms_) {
+        RTC_LOG(LS_WARNING) << "IceTransport connect timeout, state: " << IceStateToString(state_)
+            << ", pairs: " << pairs_.size() << ", checks: " << checks_sent_;
+        SetState(IceTransportState::kFailed);
+        return;
+    }
+
+    bool busy = state_ != IceTransportState::kConnected;
+    for (auto& pair : pairs_) {
+        busy = busy || pair->state == PairState::kWaiting;
+    }
+    if (busy) {
+        ScheduleTick(config_.check_interval_ms);
+        return;
+    }
+
+    // 连通并且没有待检查的候选对：睡到下一次重传、保活或者接收超时
+    int64_t next_ms = now + config_.keepalive_interval_ms;
+    for (auto& request : requests_) {
+        next_ms = std::min(next_ms, request.second->next_send_ms);
+    }
+    if (selected_) {
+        next_ms = std::min(next_ms, selected_->last_ping_ms + config_.keepalive_interval_ms);
+        next_ms = std::min(next_ms, selected_->last_response_ms + config_.receive_timeout_ms + 1);
+    }
+    ScheduleTick((int)std::max<int64_t>(1, next_ms - now));
+}
+
+// 选中的候选对保活并检测中断，备用候选对定时检查，保证切换时有确认过的路径可用
+void IceTransport::CheckSelectedPair(int64_t now) {
+    if (state_ != IceTransportState::kConnected) {
+        return;
+    }
+
+    // 选中的候选对所在的网卡消失时selected_已经清空，和接收超时一样处理
+    if (!selected_ || now - selected_->last_response_ms > config_.receive_timeout_ms) {
+        CandidatePair* backup = nullptr;
+        for (auto& pair : pairs_) {
+            if (pair.get() == selected_ || pair->state != PairState::kSucceeded ||
+                now - pair->last_response_ms >
+                config_.backup_ping_interval_ms + config_.receive_timeout_ms)
+            {
+                continue;
+            }
+            if (!backup || pair->priority > backup->priority) {
+                backup = pair.get();
+            }
+        }
+
+        RTC_LOG(LS_WARNING) << "IceTransport selected pair lost, remote: "
+            << (selected_ ? selected_->remote.address.ToString() : "removed")
+            << ", no response for " << now - last_selected_response_ms_ << " ms, backup: "
+            << (backup ? backup->remote.address.ToString() : "none");
+        if (!backup) {
+            Disconnect(now);
+            return;
+        }
+
+        // 备用候选对刚确认过，直接切过去，同时提名让对端也切换
+        SelectPair(backup);
+        SendCheck(backup, true);
+        return;
+    }
+
+    if (now - selected_->last_ping_ms >= config_.keepalive_interval_ms) {
+        SendCheck(selected_, false, true);
+    }
+    for (auto& pair : pairs_) {
+        if (pair.get() != selected_ && pair->state == PairState::kSucceeded &&
+            now - pair->last_ping_ms >= config_.backup_ping_interval_ms)
+        {
+            SendCheck(pair.get(), false, true);
+        }
+    }
+}
+
+// 没有可用的路径：所有候选对重新检查，上层收到kDisconnected后发起重启
+void IceTransport::Disconnect(int64_t now) {
+    if (selected_) {
+        last_selected_response_ms_ = selected_->last_response_ms;
+        selected_ = nullptr;
+    }
+    for (auto& pair : pairs_) {
+        pair->state = PairState::kWaiting;
+        pair->nominated = false;
+        pair->nominating = false;
+    }
+    connect_deadline_ms_ = now + config_.connect_timeout_ms;
+    SetState(IceTransportState::kDisconnected);
+}
+
+void IceTransport::ScheduleTick(int delay_ms) {
+    uint64_t generation = ++tick_generation_;
+    std::weak_ptr<bool> alive = alive_;
+    network_thread_->PostDelayedTask(webrtc::ToQueuedTask([=]() {
+        if (alive.expired() || generation != tick_generation_) {
+            return;
+        }
+        Tick();
+    }), delay_ms);
+}
+
+void IceTransport::SetState(IceTransportState state) {
+    if (state_ == state) {
+        return;
+    }
+
+    RTC_LOG(LS_INFO) << "IceTransport state: " << IceStateToString(state_) << " -> "
+        << IceStateToString(state) << ", elapsed: " << rtc::TimeMillis() - start_ms_ << " ms";
+    state_ = state;
+    if (observer_) {
+        observer_->OnIceStateChanged(state);
+    }
+}
+
+void IceTransport::MaybeGatheringComplete() {
+    if (gathering_complete_ || pending_srflx_ > 0) {
+        return;
+    }
+
+    gathering_complete_ = true;
+    if (gathering_complete_ms_ < 0) {
+        gathering_complete_ms_ = rtc::TimeMillis() - start_ms_;
+    }
+    RTC_LOG(LS_INFO) << "IceTransport gathering complete, candidates: "
+        << local_candidates_.size() << ", elapsed: " << rtc::TimeMillis() - start_ms_ << " ms";
+    if (observer_) {
+        observer_->OnIceGatheringComplete();
+    }
+}
+
+void IceTransport::OnReadPacket(rtc::AsyncPacketSocket* socket, const char* data, size_t size,
+    const rtc::SocketAddress& remote_address, const int64_t& /*packet_time_us*/)
+{
+    const uint8_t* packet = (const uint8_t*)data;
+    if (!StunMessage::IsStunPacket(packet, size)) {
+        SignalReadPacket(packet, size);
+        return;
+    }
+
+    auto port = std::find_if(ports_.begin(), ports_.end(),
+        [socket](const std::unique_ptr<Port>& p) { return p->socket.get() == socket; });
+    if (port == ports_.end()) {
+        return;
+    }
+
+    uint16_t type = ((uint16_t)packet[0] << 8) | packet[1];
+    if (type == kStunBindingRequest) {
+        OnStunRequest(port->get(), packet, size, remote_address);
+    } else if (type == kStunBindingResponse || type == kStunBindingErrorResponse) {
+        OnStunResponse(packet, size, remote_address);
+    }
+}
+
+void IceTransport::OnStunRequest(Port* port, const uint8_t* data, size_t size,
+    const rtc::SocketAddress& remote_address)
+{
+    std::unique_ptr<StunMessage> request = StunMessage::Parse(data, size);
+    if (!request) {
+        return;
+    }
+
+    std::string username;
+    rtc::PacketOptions options;
+    std::vector<uint8_t> packet;
+    if (!request->GetUsername(&username) ||
+        username.compare(0, local_parameters_.ufrag.size() + 1, local_parameters_.ufrag + ":") != 0 ||
+        !StunMessage::ValidateMessageIntegrity(data, size, local_parameters_.pwd))
+    {
+        StunMessage response(kStunBindingErrorResponse);
+        response.set_transaction_id(request->transaction_id());
+        response.AddErrorCode(401, "Unauthorized");
+        response.Write("", &packet);
+        port->socket->SendTo(packet.data(), packet.size(), remote_address, options);
+        return;
+    }
+
+    StunMessage response(kStunBindingResponse);
+    response.set_transaction_id(request->transaction_id());
+    response.AddXorMappedAddress(remote_address);
+    response.Write(local_parameters_.pwd, &packet);
+    port->socket->SendTo(packet.data(), packet.size(), remote_address, options);
+
+    // 对端从未知的地址发来检查：学到prflx候选，立即触发检查
+    for (auto& pair : pairs_) {
+        if (pair->port == port && pair->remote.address == remote_address) {
+            return;
+        }
+    }
+
+    IceCandidate candidate;
+    candidate.type = kIceCandidatePeerReflexive;
+    candidate.address = remote_address;
+    candidate.foundation = std::to_string(rtc::CreateRandomId());
+    request->GetPriority(&candidate.priority);
+    RTC_LOG(LS_INFO) << "IceTransport learned " << candidate.ToString();
+
+    size_t count = pairs_.size();
+    AddPair(port, candidate);
+    if (pairs_.size() > count) {
+        SendCheck(pairs_.back().get(), config_.aggressive_nomination);
+    }
+}
+
+void IceTransport::OnStunResponse(const uint8_t* data, size_t size,
+    const rtc::SocketAddress& remote_address)
+{
+    std::unique_ptr<StunMessage> response = StunMessage::Parse(data, size);
+    if (!response) {
+        return;
+    }
+
+    auto it = requests_.find(response->transaction_id());
+    if (it == requests_.end()) {
+        return;
+    }
+
+    // 检查的回复必须来自请求的目的地址并且带正确的MESSAGE-INTEGRITY，否则丢弃，等重传
+    StunRequest* request = it->second.get();
+    if (request->pair && (remote_address != request->to ||
+        !StunMessage::ValidateMessageIntegrity(data, size, remote_parameters_.pwd)))
+    {
+        RTC_LOG(LS_WARNING) << "IceTransport drop invalid check response from "
+            << remote_address.ToString();
+        return;
+    }
+
+    std::unique_ptr<StunRequest> done = std::move(it->second);
+    requests_.erase(it);
+    int64_t rtt_ms = rtc::TimeMillis() - done->sent_ms;
+    ++responses_;
+
+    if (!done->pair) {
+        --pending_srflx_;
+        rtc::SocketAddress mapped;
+        if (response->type() == kStunBindingResponse && response->GetXorMappedAddress(&mapped) &&
+            mapped != done->port->host.address)
+        {
+            bool exists = false;
+            for (const IceCandidate& candidate : local_candidates_) {
+                exists = exists || candidate.address == mapped;
+            }
+            if (!exists) {
+                IceCandidate candidate;
+                candidate.type = kIceCandidateServerReflexive;
+                candidate.address = mapped;
+                candidate.related_address = done->port->host.address;
+                candidate.foundation = ComputeFoundation(kIceCandidateServerReflexive,
+                    done->port->host.address.ipaddr());
+                candidate.priority = IceCandidate::ComputePriority(kIceCandidateServerReflexive,
+                    (done->port->host.priority >> 8) & 0xFFFF, 1);
+                if (first_srflx_ms_ < 0) {
+                    first_srflx_ms_ = rtc::TimeMillis() - start_ms_;
+                }
+                RTC_LOG(LS_INFO) << "IceTransport gathered " << candidate.ToString()
+                    << ", rtt: " << rtt_ms << " ms";
+                local_candidates_.push_back(candidate);
+                if (observer_) {
+                    observer_->OnIceCandidate(candidate);
+                }
+            }
+        }
+        MaybeGatheringComplete();
+        return;
+    }
+
+    CandidatePair* pair = done->pair;
+    if (response->type() == kStunBindingErrorResponse) {
+        RTC_LOG(LS_WARNING) << "IceTransport check error: " << response->GetErrorCode()
+            << ", remote: " << pair->remote.address.ToString();
+        if (pair->state == PairState::kInProgress) {
+            pair->state = PairState::kFailed;
+        }
+        if (done->use_candidate) {
+            pair->nominating = false;
+        }
+        return;
+    }
+
+    OnCheckSucceeded(pair, done->use_candidate, rtt_ms);
+}
+
+void IceTransport::OnCheckSucceeded(CandidatePair* pair, bool use_candidate, int64_t rtt_ms) {
+    pair->rtt_ms = rtt_ms;
+    pair->state = PairState::kSucceeded;
+    pair->last_response_ms = rtc::TimeMillis();
+    if (pair == selected_) {
+        last_selected_response_ms_ = pair->last_response_ms;
+    }
+    if (use_candidate) {
+        pair->nominated = true;
+        pair->nominating = false;
+    }
+
+    if (pair->nominated) {
+        if (!selected_ || (pair != selected_ && pair->priority > selected_->priority)) {
+            SelectPair(pair);
+        }
+        return;
+    }
+
+    // 常规提名：第一个成功的候选对立即发起提名
+    if (config_.aggressive_nomination || selected_) {
+        return;
+    }
+    for (auto& p : pairs_) {
+        if (p->nominating) {
+            return;
+        }
+    }
+    pair->nominating = true;
+    SendCheck(pair, true);
+}
+
+void IceTransport::SelectPair(CandidatePair* pair) {
+    int64_t now = rtc::TimeMillis();
+    IceRouteChange change;
+    if (!ever_selected_) {
+        change.initial = true;
+        change.media_lost = true;
+        connected_ms_ = now - start_ms_;
+    } else {
+        // 旧路径还活着（高优先级的候选对恢复），对端收包不会中断；否则间隔从最后一次确认的回复算起
+        bool old_alive = selected_ &&
+            now - selected_->last_response_ms <= 2 * config_.keepalive_interval_ms;
+        change.media_lost = !old_alive;
+        change.gap_ms = old_alive ? 0 : now - last_selected_response_ms_;
+        ++handovers_;
+        last_handover_gap_ms_ = change.gap_ms;
+        max_handover_gap_ms_ = std::max(max_handover_gap_ms_, change.gap_ms);
+    }
+
+    ever_selected_ = true;
+    selected_ = pair;
+    last_selected_response_ms_ = now;
+    ++selected_changes_;
+    RTC_LOG(LS_INFO) << "IceTransport select pair, local: " << pair->port->host.address.ToString()
+        << ", remote: " << pair->remote.ToString() << ", rtt: " << pair->rtt_ms
+        << " ms, gap: " << change.gap_ms << " ms";
+
+    if (observer_) {
+        observer_->OnIceRouteChanged(change);
+    }
+    if (state_ != IceTransportState::kConnected) {
+        SetState(IceTransportState::kConnected);
+    }
+}
+
+void IceTransport::GetStats(JsonObject& stats) {
+    stats["state"] = IceStateToString(state_);
+    stats["local_candidates"] = (int)local_candidates_.size();
+    stats["pairs"] = (int)pairs_.size();
+    stats["first_srflx_ms"] = first_srflx_ms_;
+    stats["gathering_complete_ms"] = gathering_complete_ms_;
+    stats["first_check_ms"] = first_check_ms_;
+    stats["connected_ms"] = connected_ms_;
+    stats["checks_sent"] = checks_sent_;
+    stats["retransmits"] = retransmits_;
+    stats["responses"] = responses_;
+    stats["selected_changes"] = selected_changes_;
+    stats["handovers"] = handovers_;
+    stats["restarts"] = restarts_;
+    stats["network_changes"] = network_changes_;
+    stats["last_handover_gap_ms"] = last_handover_gap_ms_;
+    stats["max_handover_gap_ms"] = max_handover_gap_ms_;
+    stats["packets_sent"] = packets_sent_.count();
+    stats["bytes_sent"] = bytes_sent_.count();
+    stats["send_errors"] = send_errors_.count();
+    if (selected_) {
+        stats["local_address"] = selected_->port->host.address.ToString();
+        stats["remote_address"] = selected_->remote.address.ToString();
+        stats["remote_type"] = selected_->remote.type;
+        stats["rtt_ms"] = selected_->rtt_ms;
+    }
+}
+
+} // namespace xrtc
@@ -0,0 +1,220 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_ICE_TRANSPORT_H_
+#define XRTCSDK_XRTC_RTC_ICE_TRANSPORT_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <rtc_base/async_packet_socket.h>
+#include <rtc_base/socket_address.h>
+#include <rtc_base/third_party/sigslot/sigslot.h>
+#include <rtc_base/thread.h>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/rtc/ice_candidate.h"
+#include "xrtc/rtc/rtp_transport.h"
+
+namespace xrtc {
+
+enum class IceTransportState {
+    kNew,
+    kChecking,
+    kConnected,
+    kDisconnected,//选中的路径断了并且没有可用的备用候选对，继续检查，等待重启
+    kFailed,
+    kClosed,
+};
+
+struct IceParameters {
+    std::string ufrag;
+    std::string pwd;
+};
+
+struct IceConfig {
+    std::vector<rtc::SocketAddress> stun_servers;//只支持IP地址，不做DNS解析
+    // 每个检查都带USE-CANDIDATE，第一个成功的候选对直接可用；关闭时先检查再单独提名，多一个往返
+    bool aggressive_nomination = true;
+    bool include_loopback = false;//本机测试时使用回环网卡
+    int check_interval_ms = 5;//相邻两个新检查的间隔(Ta)
+    int initial_rto_ms = 100;//检查和srflx请求的首次重传超时，之后翻倍
+    int max_rto_ms = 1600;
+    int max_retransmits = 7;
+    int connect_timeout_ms = 10000;//开始检查(Start/Restart/断开)之后没有可用的候选对即失败
+    int keepalive_interval_ms = 500;//选中的候选对上的检查间隔，同时用于检测路径中断
+    int receive_timeout_ms = 1500;//选中的候选对超过这个时间没有回复即认为路径中断
+    int backup_ping_interval_ms = 2500;//备用候选对的检查间隔
+};
+
+// 选中的候选对变化：第一次连通、切到备用候选对、断开后重新连通(包括重启)
+struct IceRouteChange {
+    bool initial = false;
+    // 旧路径已经中断，中断之后发出的媒体丢失，需要关键帧；旧路径还活着时(切到更好的路径)为false
+    bool media_lost = false;
+    int64_t gap_ms = 0;//旧路径最后一次收到回复到切换的时间
+};
+
+// 以下都在network_thread上回调
+class IceTransportObserver {
+public:
+    virtual ~IceTransportObserver() {}
+    // Start之后收集到的候选(srflx)，通过信令trickle给对端
+    virtual void OnIceCandidate(const IceCandidate& candidate) = 0;
+    virtual void OnIceGatheringComplete() {}
+    virtual void OnIceStateChanged(IceTransportState state) = 0;
+    virtual void OnIceRouteChanged(const IceRouteChange& change) = 0;
+};
+
+// ICE传输(RFC 8445)，本端总是controlling(推流端对接ice-lite的服务端)，只有一个component
+// 所有网卡的socket同时创建，host候选同步得到；向所有STUN服务器的srflx请求并行发出，结果trickle出去
+// 有远端候选后立即开始检查，不等收集完成；默认aggressive nomination，第一个成功的检查就是可用的路径，
+// 之后优先级更高的候选对成功时切换过去。创建、调用和析构都只在network_thread上
+// 连通之后：选中的候选对按keepalive_interval_ms检查，其余成功过的候选对作为备用按backup_ping_interval_ms检查；
+// 选中的路径超时没有回复时直接切到最近确认过的备用候选对，没有备用时进入kDisconnected，由上层发起重启。
+// 每秒检查一次网卡变化，新网卡立即收集、trickle并检查，消失的网卡上的候选对直接删除
+class IceTransport : public RtpTransport, public sigslot::has_slots<> {
+public:
+    IceTransport(rtc::Thread* network_thread, const IceConfig& config,
+        IceTransportObserver* observer);
+    ~IceTransport() override;
+
+    // 远端候选通常来自offer，没有可用的网卡时返回false
+    bool Start(const IceParameters& remote_parameters,
+        const std::vector<IceCandidate>& remote_candidates);
+    // trickle收到的远端候选，立即触发检查
+    void AddRemoteCandidate(const IceCandidate& candidate);
+    // ICE重启分两步：先生成新的本地ufrag/pwd随answer发给对端，拿到对端新的参数后Restart，
+    // 丢弃所有候选对重新检查，本地的socket和候选保留
+    IceParameters PrepareRestart();
+    void Restart(const IceParameters& remote_parameters,
+        const std::vector<IceCandidate>& remote_candidates);
+    void Stop();
+
+    // RtpTransport，没有选中的候选对时返回false
+    bool SendBatch(RtpPacketBatch& batch) override;
+    // 在选中的候选对上发送一个非媒体的包(DTLS)
+    bool SendPacket(const uint8_t* data, size_t size);
+
+    // 选中的候选对以外的包也会收到，非STUN的包(DTLS、SRTCP)交给上层解复用
+    sigslot::signal2<const uint8_t*, size_t> SignalReadPacket;
+
+    IceTransportState state() const { return state_; }
+    // 选中的候选对上最近一次检查的往返时间，没有选中时返回-1
+    int64_t rtt_ms() const { return selected_ ? selected_->rtt_ms : -1; }
+    const IceParameters& local_parameters() const { return local_parameters_; }
+    const std::vector<IceCandidate>& local_candidates() const { return local_candidates_; }
+    void GetStats(JsonObject& stats);
+
+private:
+    struct Port {
+        std::unique_ptr<rtc::AsyncPacketSocket> socket;
+        IceCandidate host;
+    };
+
+    enum class PairState {
+        kWaiting,
+        kInProgress,
+        kSucceeded,
+        kFailed,
+    };
+
+    struct CandidatePair {
+        Port* port = nullptr;
+        IceCandidate remote;
+        uint64_t priority = 0;
+        PairState state = PairState::kWaiting;
+        bool nominated = false;
+        bool nominating = false;//常规提名时正在发送带USE-CANDIDATE的检查
+        int64_t rtt_ms = -1;
+        int64_t last_ping_ms = 0;
+        int64_t last_response_ms = 0;
+    };
+
+    // 一个STUN事务：连通性检查(pair非空)或者srflx请求，按RTO翻倍重传
+    struct StunRequest {
+        Port* port = nullptr;
+        CandidatePair* pair = nullptr;
+        rtc::SocketAddress to;
+        std::vector<uint8_t> packet;
+        bool use_candidate = false;
+        int max_retransmits = 0;//保活的检查不重传，超时即失败
+        int64_t sent_ms = 0;
+        int64_t next_send_ms = 0;
+        int rto_ms = 0;
+        int retransmits = 0;
+    };
+
+    Port* AddPort(const rtc::IPAddress& ip);
+    void RemovePort(Port* port);
+    void CheckNetworkChange();
+    void SendSrflxRequests(Port* port);
+    void AddPair(Port* port, const IceCandidate& remote);
+    void SendCheck(CandidatePair* pair, bool use_candidate, bool keepalive = false);
+    void CheckSelectedPair(int64_t now);
+    void Disconnect(int64_t now);
+    void SendRequest(std::unique_ptr<StunRequest> request, const std::string& transaction_id);
+    void Tick();
+    void ScheduleTick(int delay_ms);
+    void SetState(IceTransportState state);
+    void MaybeGatheringComplete();
+
+    void OnReadPacket(rtc::AsyncPacketSocket* socket, const char* data, size_t size,
+        const rtc::SocketAddress& remote_address, const int64_t& packet_time_us);
+    void OnStunRequest(Port* port, const uint8_t* data, size_t size,
+        const rtc::SocketAddress& remote_address);
+    void OnStunResponse(const uint8_t* data, size_t size, const rtc::SocketAddress& remote_address);
+    void OnCheckSucceeded(CandidatePair* pair, bool use_candidate, int64_t rtt_ms);
+    void SelectPair(CandidatePair* pair);
+
+private:
+    rtc::Thread* network_thread_;
+    IceConfig config_;
+    IceTransportObserver* observer_;
+    IceParameters local_parameters_;
+    IceParameters remote_parameters_;
+    IceParameters pending_local_parameters_;//PrepareRestart生成，Restart时生效
+    std::vector<IceCandidate> remote_candidates_;
+    uint64_t tie_breaker_;
+    IceTransportState state_ = IceTransportState::kNew;
+    std::shared_ptr<bool> alive_;//延时任务持有弱引用，析构之后不再执行
+    uint64_t tick_generation_ = 0;//只有最后一次调度的Tick有效
+
+    std::vector<std::unique_ptr<Port>> ports_;
+    std::vector<IceCandidate> local_candidates_;
+    std::vector<std::unique_ptr<CandidatePair>> pairs_;
+    std::map<std::string, std::unique_ptr<StunRequest>> requests_;//key: transaction id
+    int pending_srflx_ = 0;
+    bool gathering_complete_ = false;
+    CandidatePair* selected_ = nullptr;
+    bool ever_selected_ = false;
+    int64_t last_selected_response_ms_ = 0;//最后一次选中的候选对上收到回复的时间，断开之后保留
+    int64_t last_check_ms_ = 0;
+    int64_t last_network_poll_ms_ = 0;
+    int64_t connect_deadline_ms_ = 0;
+
+    // 耗时统计，都从Start开始计算，-1表示还没有发生
+    int64_t start_ms_ = 0;
+    int64_t first_srflx_ms_ = -1;
+    int64_t gathering_complete_ms_ = -1;
+    int64_t first_check_ms_ = -1;
+    int64_t connected_ms_ = -1;
+    int64_t checks_sent_ = 0;
+    int64_t retransmits_ = 0;
+    int64_t responses_ = 0;
+    int selected_changes_ = 0;
+    int handovers_ = 0;
+    int restarts_ = 0;
+    int network_changes_ = 0;
+    int64_t last_handover_gap_ms_ = 0;
+    int64_t max_handover_gap_ms_ = 0;
+    StatsCounter packets_sent_;
+    StatsCounter bytes_sent_;
+    StatsCounter send_errors_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_ICE_TRANSPORT_H_
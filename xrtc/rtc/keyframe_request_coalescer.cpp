@@ -0,0 +1,89 @@
+﻿#include "xrtc/rtc/keyframe_request_coalescer.h"
+
+#include <algorithm>
+
+namespace xrtc {
+
+void KeyFrameRequestCoalescer::SetConfig(const KeyFrameRequestConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+}
+
+bool KeyFrameRequestCoalescer::OnRequest(const RtcpKeyFrameRequest& request, int64_t rtt_ms,
+    int64_t now_ms)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (rtt_ms >= 0) {
+        rtt_ms_ = rtt_ms;
+    }
+
+    if (request.fir) {
+        ++firs_;
+        auto it = fir_seq_.find(request.sender_ssrc);
+        if (it != fir_seq_.end() && it->second == request.fir_seq) {
+            ++duplicates_;
+            return false;
+        }
+        fir_seq_[request.sender_ssrc] = request.fir_seq;
+    }
+    else {
+        ++plis_;
+    }
+
+    if (pending_) {
+        ++coalesced_;
+        return true;
+    }
+
+    if (config_.min_interval_ms > 0 && last_keyframe_ms_ >= 0 && rtt_ms_ >= 0 &&
+        now_ms - last_keyframe_ms_ < rtt_ms_)
+    {
+        ++stale_;
+        return false;
+    }
+
+    pending_ = true;
+    return true;
+}
+
+bool KeyFrameRequestCoalescer::Poll(int64_t now_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!pending_ || (last_keyframe_ms_ >= 0 && now_ms - last_keyframe_ms_ < IntervalMs())) {
+        return false;
+    }
+
+    pending_ = false;
+    ++forwarded_;
+    last_keyframe_ms_ = now_ms;
+    return true;
+}
+
+void KeyFrameRequestCoalescer::OnKeyFrame(int64_t now_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = false;
+    last_keyframe_ms_ = now_ms;
+}
+
+void KeyFrameRequestCoalescer::GetStats(JsonObject& stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats["plis"] = plis_;
+    stats["firs"] = firs_;
+    stats["forwarded"] = forwarded_;
+    stats["coalesced"] = coalesced_;
+    stats["stale"] = stale_;
+    stats["duplicates"] = duplicates_;
+    stats["interval_ms"] = IntervalMs();
+}
+
+// 调用者持有mutex_
+int64_t KeyFrameRequestCoalescer::IntervalMs() const {
+    if (config_.min_interval_ms <= 0) {
+        return 0;
+    }
+
+    int64_t interval = rtt_ms_ >= 0 ? rtt_ms_ * 2 : config_.min_interval_ms;
+    return std::min<int64_t>(std::max(config_.max_interval_ms, config_.min_interval_ms),
+        std::max<int64_t>(interval, config_.min_interval_ms));
+}
+
+} // namespace xrtc
@@ -0,0 +1,62 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_KEYFRAME_REQUEST_COALESCER_H_
+#define XRTCSDK_XRTC_RTC_KEYFRAME_REQUEST_COALESCER_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/rtc/rtcp_packet.h"
+
+namespace xrtc {
+
+struct KeyFrameRequestConfig {
+    // 两个关键帧的最小间隔为2*RTT，限制在[min_interval_ms, max_interval_ms]之间；
+    // min_interval_ms为0时不做限制，每个请求都立即生成关键帧
+    int min_interval_ms = 300;
+    int max_interval_ms = 2000;
+};
+
+// 合并接收端的关键帧请求(PLI/FIR)，弱网下连续丢包时接收端每个丢包都会请求，逐个响应会产生一串IDR，
+// 把本来就拥塞的链路打得更满：
+// - 上一个关键帧之后一个RTT内到达的请求是接收端收到它之前发出的，直接丢弃
+// - 重传的FIR(序号不变)丢弃
+// - 距离上一个关键帧不到最小间隔时，请求挂起到间隔结束，期间的请求合并为一个
+// 请求在网络线程上提交，编码线程每帧调用Poll，挂起的请求不需要定时器。可以在任意线程调用
+class KeyFrameRequestCoalescer {
+public:
+    void SetConfig(const KeyFrameRequestConfig& config);
+
+    // rtt_ms小于0表示未知，按min_interval_ms处理；返回false表示请求被丢弃
+    bool OnRequest(const RtcpKeyFrameRequest& request, int64_t rtt_ms, int64_t now_ms);
+    // 有挂起的请求并且已经过了最小间隔时返回true，调用者随后生成关键帧(IDR或者帧内刷新)
+    bool Poll(int64_t now_ms);
+    // 生成了关键帧(包括本地请求的)，挂起的请求也一并满足
+    void OnKeyFrame(int64_t now_ms);
+
+    void GetStats(JsonObject& stats);
+
+private:
+    int64_t IntervalMs() const;
+
+private:
+    std::mutex mutex_;
+    KeyFrameRequestConfig config_;
+    int64_t rtt_ms_ = -1;
+    int64_t last_keyframe_ms_ = -1;
+    bool pending_ = false;
+    std::map<uint32_t, uint8_t> fir_seq_;//key: 发送端ssrc
+
+    // 统计
+    int64_t plis_ = 0;
+    int64_t firs_ = 0;
+    int64_t forwarded_ = 0;//变成关键帧的请求
+    int64_t coalesced_ = 0;//合并到挂起的请求
+    int64_t stale_ = 0;
+    int64_t duplicates_ = 0;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_KEYFRAME_REQUEST_COALESCER_H_
@@ -0,0 +1,103 @@
+﻿#include "xrtc/rtc/loss_based_bwe.h"
+
+#include <algorithm>
+
+namespace xrtc {
+
+namespace {
+
+// 丢包率单位1/256
+const int kLowLossThreshold = 5;//2%
+const int kHighLossThreshold = 26;//10%
+const double kIncreasePerSecond = 0.08;
+const int64_t kMaxIncreaseIntervalMs = 1000;
+const int64_t kDecreaseHoldMs = 300;
+// 发送码率不超过目标码率的110%时认为降低已经生效，留出RTP头和码率控制的误差
+const double kDecreaseAppliedRatio = 1.1;
+
+} // namespace
+
+void LossBasedBwe::SetConfig(const BweConfig& config) {
+    config_ = config;
+    config_.max_bitrate_bps = std::max(config_.min_bitrate_bps, config_.max_bitrate_bps);
+    target_bitrate_bps_ = std::min(config_.max_bitrate_bps,
+        std::max(config_.min_bitrate_bps, config_.start_bitrate_bps));
+    last_update_ms_ = -1;
+    last_decrease_ms_ = -1;
+    last_fraction_lost_ = 0;
+    congested_ = false;
+    sustained_loss_ = false;
+}
+
+bool LossBasedBwe::OnReportBlock(uint8_t fraction_lost, int64_t rtt_ms, int send_bitrate_bps,
+    int64_t now_ms)
+{
+    ++reports_;
+    last_fraction_lost_ = fraction_lost;
+    int64_t elapsed_ms = last_update_ms_ >= 0 ? now_ms - last_update_ms_ : 0;
+    last_update_ms_ = now_ms;
+
+    int target = target_bitrate_bps_;
+    if (fraction_lost < kLowLossThreshold) {
+        // 按经过的时间上涨，和RR的间隔无关
+        elapsed_ms = std::min(elapsed_ms, kMaxIncreaseIntervalMs);
+        target += (int)(target * kIncreasePerSecond * elapsed_ms / 1000);
+        congested_ = false;
+    }
+    else if (fraction_lost > kHighLossThreshold) {
+        // 编码器要一段时间才能把发送码率降到新的目标码率，这期间的丢包是降低之前的过量发送；
+        // 发送码率已经降下来之后仍然高丢包才说明链路容量比目标码率还低。
+        // 拥塞开始时清除，恢复之后保留到下一次拥塞，供恢复探测判断
+        if (!congested_) {
+            sustained_loss_ = false;
+        }
+        else if (send_bitrate_bps > 0 &&
+            send_bitrate_bps <= target_bitrate_bps_ * kDecreaseAppliedRatio)
+        {
+            sustained_loss_ = true;
+        }
+        // 降低之后一个RTT内的RR反映的还是降低之前的发送
+        int64_t hold_ms = kDecreaseHoldMs + std::max<int64_t>(0, rtt_ms);
+        if (last_decrease_ms_ >= 0 && now_ms - last_decrease_ms_ < hold_ms) {
+            return false;
+        }
+        target = (int)(target * (1.0 - 0.5 * fraction_lost / 256));
+        if (!congested_ && send_bitrate_bps > 0) {
+            target = std::min(target, (int)(send_bitrate_bps * (1.0 - fraction_lost / 256.0)));
+        }
+        last_decrease_ms_ = now_ms;
+        congested_ = true;
+        ++decreases_;
+    }
+
+    target = std::min(config_.max_bitrate_bps, std::max(config_.min_bitrate_bps, target));
+    if (target == target_bitrate_bps_) {
+        return false;
+    }
+    target_bitrate_bps_ = target;
+    return true;
+}
+
+bool LossBasedBwe::OnProbeResult(int bitrate_bps, int64_t now_ms) {
+    int target = std::min(config_.max_bitrate_bps, bitrate_bps);
+    if (target <= target_bitrate_bps_) {
+        return false;
+    }
+
+    // 从探测结果开始重新计算上涨
+    target_bitrate_bps_ = target;
+    last_update_ms_ = now_ms;
+    congested_ = false;
+    ++probe_increases_;
+    return true;
+}
+
+void LossBasedBwe::GetStats(JsonObject& stats) {
+    stats["target_kbps"] = target_bitrate_bps_ / 1000;
+    stats["fraction_lost_percent"] = last_fraction_lost_ * 100 / 256;
+    stats["reports"] = reports_;
+    stats["decreases"] = decreases_;
+    stats["probe_increases"] = probe_increases_;
+}
+
+} // namespace xrtc
@@ -0,0 +1,62 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_LOSS_BASED_BWE_H_
+#define XRTCSDK_XRTC_RTC_LOSS_BASED_BWE_H_
+
+#include <stdint.h>
+
+#include "xrtc/base/xrtc_json.h"
+
+namespace xrtc {
+
+struct BweConfig {
+    int min_bitrate_bps = 100000;
+    int start_bitrate_bps = 1500000;
+    int max_bitrate_bps = 2500000;
+};
+
+// 基于丢包的带宽估计(GCC的丢包部分，draft-ietf-rmcat-gcc-02 6)，输入是接收端RR中视频流的丢包率：
+// - 丢包率 > 10%：目标码率 *= (1 - 0.5 * 丢包率)，一次拥塞的多个RR只降一次(间隔RTT+300ms)；
+//   无丢包之后的第一次降低多半是链路容量变小，瓶颈的队列已经排满，接收码率 = 发送码率 *
+//   (1 - 丢包率)接近链路容量，目标码率不超过它，一次降到位；之后的丢包可能来自关键帧等突发，
+//   发送码率也被分层丢帧压低了，不再用它
+// - 丢包率 < 2%：每秒上涨8%，不超过max_bitrate_bps
+// - 之间保持不变
+// 上涨太慢，起始码率离链路容量很远时由带宽探测(ProbeController)的结果直接抬高；
+// 降低之后发送码率已经降到目标码率附近，丢包率仍然 > 10%时为持续丢包，链路容量确实变小了，
+// 之后不做恢复探测；编码器降码率的过程中的丢包不算
+// 只在network_thread上使用
+class LossBasedBwe {
+public:
+    // 目标码率回到start_bitrate_bps
+    void SetConfig(const BweConfig& config);
+
+    // rtt_ms小于0表示未知，send_bitrate_bps为上一个RR以来的发送码率，0表示未知；
+    // 返回true表示目标码率变化
+    bool OnReportBlock(uint8_t fraction_lost, int64_t rtt_ms, int send_bitrate_bps,
+        int64_t now_ms);
+    // 探测结果高于目标码率时直接跳到探测结果，不超过max_bitrate_bps，返回true表示目标码率变化
+    bool OnProbeResult(int bitrate_bps, int64_t now_ms);
+
+    int target_bitrate_bps() const { return target_bitrate_bps_; }
+    bool congested() const { return congested_; }
+    // 当前(或最近一次)拥塞是否为持续丢包
+    bool sustained_loss() const { return sustained_loss_; }
+    void GetStats(JsonObject& stats);
+
+private:
+    BweConfig config_;
+    int target_bitrate_bps_ = 1500000;
+    int64_t last_update_ms_ = -1;
+    int64_t last_decrease_ms_ = -1;
+    uint8_t last_fraction_lost_ = 0;
+    bool congested_ = false;//降低之后还没有回到低丢包
+    bool sustained_loss_ = false;
+
+    // 统计
+    int64_t reports_ = 0;
+    int64_t decreases_ = 0;
+    int64_t probe_increases_ = 0;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_LOSS_BASED_BWE_H_
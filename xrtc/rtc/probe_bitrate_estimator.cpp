@@ -0,0 +1,160 @@
+﻿#include "xrtc/rtc/probe_bitrate_estimator.h"
+
+#include <algorithm>
+
+#include <rtc_base/logging.h>
+
+namespace xrtc {
+
+namespace {
+
+const double kMinReceivedRatio = 0.8;
+const double kMinRatioForUnsaturatedLink = 0.9;
+const double kTargetUtilizationFraction = 0.95;
+const double kMaxValidRatio = 2.0;//接收码率不可能远大于发送码率，反馈有误
+const int64_t kMaxProbeIntervalUs = 1000000;
+const int64_t kMaxClusterHistoryUs = 2000000;
+
+} // namespace
+
+void ProbeBitrateEstimator::OnPacketSent(int cluster_id, uint16_t transport_sequence, size_t size,
+    int64_t now_us)
+{
+    RemoveExpired(now_us);
+    Cluster* cluster = FindCluster(cluster_id);
+    if (!cluster) {
+        clusters_.emplace_back();
+        cluster = &clusters_.back();
+        cluster->id = cluster_id;
+        cluster->created_us = now_us;
+        cluster->first_send_us = now_us;
+    }
+
+    ++cluster->packets_sent;
+    cluster->bytes_sent += size;
+    cluster->last_send_us = now_us;
+    cluster->last_send_size = size;
+    packets_[transport_sequence] = { cluster_id, size, now_us };
+}
+
+void ProbeBitrateEstimator::OnClusterSent(int cluster_id) {
+    Cluster* cluster = FindCluster(cluster_id);
+    if (cluster) {
+        cluster->sent = true;
+    }
+}
+
+bool ProbeBitrateEstimator::OnTransportFeedback(const RtcpTransportFeedback& feedback,
+    int64_t now_us, ProbeResult* result)
+{
+    RemoveExpired(now_us);
+    bool estimated = false;
+    for (const RtcpTransportFeedback::Packet& packet : feedback.packets) {
+        if (!packet.received) {
+            continue;
+        }
+        auto it = packets_.find(packet.sequence);
+        if (it == packets_.end()) {
+            continue;
+        }
+
+        Cluster* cluster = FindCluster(it->second.cluster_id);
+        size_t size = it->second.size;
+        packets_.erase(it);
+        if (!cluster || cluster->done) {
+            continue;
+        }
+        if (cluster->packets_received == 0 || packet.arrival_time_us < cluster->first_receive_us) {
+            cluster->first_receive_us = packet.arrival_time_us;
+            cluster->first_receive_size = size;
+        }
+        cluster->last_receive_us = std::max(cluster->last_receive_us, packet.arrival_time_us);
+        ++cluster->packets_received;
+        cluster->bytes_received += size;
+    }
+
+    for (Cluster& cluster : clusters_) {
+        if (!cluster.done && cluster.sent && Estimate(&cluster, result)) {
+            estimated = true;
+        }
+    }
+    return estimated;
+}
+
+ProbeBitrateEstimator::Cluster* ProbeBitrateEstimator::FindCluster(int cluster_id) {
+    for (Cluster& cluster : clusters_) {
+        if (cluster.id == cluster_id) {
+            return &cluster;
+        }
+    }
+    return nullptr;
+}
+
+bool ProbeBitrateEstimator::Estimate(Cluster* cluster, ProbeResult* result) {
+    if (cluster->packets_received < cluster->packets_sent * kMinReceivedRatio ||
+        cluster->bytes_received < cluster->bytes_sent * kMinReceivedRatio ||
+        cluster->packets_received < 2)
+    {
+        return false;
+    }
+
+    cluster->done = true;
+    int64_t send_interval_us = cluster->last_send_us - cluster->first_send_us;
+    int64_t receive_interval_us = cluster->last_receive_us - cluster->first_receive_us;
+    if (send_interval_us <= 0 || send_interval_us > kMaxProbeIntervalUs ||
+        receive_interval_us <= 0 || receive_interval_us > kMaxProbeIntervalUs)
+    {
+        RTC_LOG(LS_INFO) << "ProbeBitrateEstimator cluster " << cluster->id
+            << " invalid, send interval: " << send_interval_us << " us, receive interval: "
+            << receive_interval_us << " us";
+        return false;
+    }
+
+    double send_bps = (double)(cluster->bytes_sent - cluster->last_send_size) * 8 * 1000000 /
+        send_interval_us;
+    double receive_bps = (double)(cluster->bytes_received - cluster->first_receive_size) * 8 *
+        1000000 / receive_interval_us;
+    if (receive_bps > send_bps * kMaxValidRatio) {
+        RTC_LOG(LS_INFO) << "ProbeBitrateEstimator cluster " << cluster->id
+            << " invalid, send: " << (int)send_bps << " bps, receive: " << (int)receive_bps;
+        return false;
+    }
+
+    double bitrate_bps = std::min(send_bps, receive_bps);
+    if (receive_bps < send_bps * kMinRatioForUnsaturatedLink) {
+        bitrate_bps = receive_bps * kTargetUtilizationFraction;
+    }
+    result->cluster_id = cluster->id;
+    result->bitrate_bps = (int)bitrate_bps;
+    last_result_bps_ = result->bitrate_bps;
+    ++results_;
+    RTC_LOG(LS_INFO) << "ProbeBitrateEstimator cluster " << cluster->id << ", send: "
+        << (int)send_bps << " bps, receive: " << (int)receive_bps << " bps, packets: "
+        << cluster->packets_received << "/" << cluster->packets_sent;
+    return true;
+}
+
+void ProbeBitrateEstimator::RemoveExpired(int64_t now_us) {
+    while (!clusters_.empty() && now_us - clusters_.front().created_us > kMaxClusterHistoryUs) {
+        if (!clusters_.front().done) {
+            ++expired_;
+        }
+        clusters_.pop_front();
+    }
+    for (auto it = packets_.begin(); it != packets_.end();) {
+        if (now_us - it->second.send_time_us > kMaxClusterHistoryUs) {
+            it = packets_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void ProbeBitrateEstimator::GetStats(JsonObject& stats) {
+    stats["probe_results"] = results_;
+    stats["probe_expired"] = expired_;
+    stats["last_probe_kbps"] = last_result_bps_ / 1000;
+}
+
+} // namespace xrtc
@@ -0,0 +1,77 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_PROBE_BITRATE_ESTIMATOR_H_
+#define XRTCSDK_XRTC_RTC_PROBE_BITRATE_ESTIMATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <unordered_map>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/rtc/rtcp_packet.h"
+
+namespace xrtc {
+
+struct ProbeResult {
+    int cluster_id = 0;
+    int bitrate_bps = 0;
+};
+
+// 按transport-wide cc反馈计算探测簇的码率：探测期间发出的包(填充和视频)按传输层序号记下发送时间，
+// 反馈给出到达时间之后分别算发送码率和接收码率：
+// - 发送码率 = (总字节 - 最后一个包) / (最后一个包 - 第一个包的发送时间)，接收码率同理去掉第一个包
+// - 收到的包数和字节数都不少于80%才有效
+// - 取两者中小的；接收码率明显低于发送码率(<90%)时链路已经饱和，取接收码率的95%
+// 只在network_thread上使用
+class ProbeBitrateEstimator {
+public:
+    void OnPacketSent(int cluster_id, uint16_t transport_sequence, size_t size, int64_t now_us);
+    // 探测簇发送完成，之后收齐反馈就可以计算
+    void OnClusterSent(int cluster_id);
+    // 有探测簇得到结果时返回true
+    bool OnTransportFeedback(const RtcpTransportFeedback& feedback, int64_t now_us,
+        ProbeResult* result);
+
+    void GetStats(JsonObject& stats);
+
+private:
+    struct SentPacket {
+        int cluster_id;
+        size_t size;
+        int64_t send_time_us;
+    };
+
+    struct Cluster {
+        int id = 0;
+        int64_t created_us = 0;
+        bool sent = false;
+        bool done = false;
+        int packets_sent = 0;
+        size_t bytes_sent = 0;
+        int64_t first_send_us = 0;
+        int64_t last_send_us = 0;
+        size_t last_send_size = 0;
+        int packets_received = 0;
+        size_t bytes_received = 0;
+        int64_t first_receive_us = 0;
+        int64_t last_receive_us = 0;
+        size_t first_receive_size = 0;
+    };
+
+    Cluster* FindCluster(int cluster_id);
+    bool Estimate(Cluster* cluster, ProbeResult* result);
+    void RemoveExpired(int64_t now_us);
+
+private:
+    std::unordered_map<uint16_t, SentPacket> packets_;
+    std::deque<Cluster> clusters_;
+
+    // 统计
+    int64_t results_ = 0;
+    int64_t expired_ = 0;//超时没有结果的簇
+    int last_result_bps_ = 0;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_PROBE_BITRATE_ESTIMATOR_H_
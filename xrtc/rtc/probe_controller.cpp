@@ -0,0 +1,139 @@
+﻿#include "xrtc/rtc/probe_controller.h"
+
+#include <algorithm>
+
+#include <rtc_base/logging.h>
+
+namespace xrtc {
+
+namespace {
+
+const double kFirstExponentialProbeScale = 3.0;
+const double kSecondExponentialProbeScale = 6.0;
+const double kFurtherExponentialProbeScale = 2.0;
+const double kFurtherProbeThreshold = 0.7;
+const double kBitrateDropThreshold = 0.66;
+const int64_t kBitrateDropTimeoutMs = 5000;
+const double kRecoveryProbeScale = 0.85;
+
+} // namespace
+
+void ProbeController::Reset(int max_bitrate_bps) {
+    max_bitrate_bps_ = max_bitrate_bps;
+    exponential_first_id_ = 0;
+    exponential_last_id_ = 0;
+    exponential_bitrate_bps_ = 0;
+    estimate_bps_ = 0;
+    congested_ = false;
+    bitrate_before_drop_bps_ = 0;
+    drop_time_ms_ = -1;
+}
+
+ProbeCluster ProbeController::CreateCluster(int bitrate_bps) {
+    ProbeCluster cluster;
+    cluster.id = next_cluster_id_++;
+    cluster.bitrate_bps = bitrate_bps;
+    ++clusters_;
+    max_probe_bps_ = std::max(max_probe_bps_, bitrate_bps);
+    return cluster;
+}
+
+std::vector<ProbeCluster> ProbeController::OnStart(int start_bitrate_bps) {
+    std::vector<ProbeCluster> clusters;
+    estimate_bps_ = start_bitrate_bps;
+    exponential_first_id_ = 0;
+    exponential_bitrate_bps_ = 0;
+    for (double scale : { kFirstExponentialProbeScale, kSecondExponentialProbeScale }) {
+        int bitrate_bps = std::min(max_bitrate_bps_, (int)(start_bitrate_bps * scale));
+        if (bitrate_bps <= exponential_bitrate_bps_ || bitrate_bps <= start_bitrate_bps) {
+            break;
+        }
+        clusters.push_back(CreateCluster(bitrate_bps));
+        if (exponential_first_id_ == 0) {
+            exponential_first_id_ = clusters.back().id;
+        }
+        exponential_last_id_ = clusters.back().id;
+        exponential_bitrate_bps_ = bitrate_bps;
+    }
+    RTC_LOG(LS_INFO) << "ProbeController start at " << start_bitrate_bps << " bps, clusters: "
+        << clusters.size();
+    return clusters;
+}
+
+std::vector<ProbeCluster> ProbeController::OnRouteChanged(int target_bitrate_bps) {
+    drop_time_ms_ = -1;
+    return OnStart(target_bitrate_bps);
+}
+
+std::vector<ProbeCluster> ProbeController::OnProbeResult(int cluster_id, int bitrate_bps) {
+    std::vector<ProbeCluster> clusters;
+    // 只看当前这一批指数探测，恢复探测和之前批次的结果只用来更新估计
+    if (exponential_first_id_ == 0 || cluster_id < exponential_first_id_ ||
+        cluster_id > exponential_last_id_)
+    {
+        return clusters;
+    }
+    if (bitrate_bps < exponential_bitrate_bps_ * kFurtherProbeThreshold) {
+        // 同一批中低码率的簇先有结果，等最后一个簇
+        if (cluster_id == exponential_last_id_) {
+            exponential_first_id_ = 0;
+        }
+        return clusters;
+    }
+
+    int next_bps = std::min(max_bitrate_bps_, (int)(bitrate_bps * kFurtherExponentialProbeScale));
+    if (next_bps <= exponential_bitrate_bps_) {
+        exponential_first_id_ = 0;
+        return clusters;
+    }
+    clusters.push_back(CreateCluster(next_bps));
+    exponential_first_id_ = clusters.back().id;
+    exponential_last_id_ = clusters.back().id;
+    exponential_bitrate_bps_ = next_bps;
+    return clusters;
+}
+
+std::vector<ProbeCluster> ProbeController::OnEstimate(int target_bitrate_bps, bool congested,
+    bool sustained_loss, int64_t now_ms)
+{
+    std::vector<ProbeCluster> clusters;
+    if (congested && !congested_) {
+        // 记下拥塞之前的码率，恢复时用
+        bitrate_before_drop_bps_ = estimate_bps_;
+        drop_time_ms_ = now_ms;
+    }
+    else if (!congested && congested_ && drop_time_ms_ >= 0 &&
+        now_ms - drop_time_ms_ < kBitrateDropTimeoutMs &&
+        target_bitrate_bps < bitrate_before_drop_bps_ * kBitrateDropThreshold)
+    {
+        if (sustained_loss) {
+            RTC_LOG(LS_INFO) << "ProbeController skip recovery probe after sustained loss, estimate: "
+                << target_bitrate_bps << " bps";
+            ++skipped_recovery_probes_;
+        }
+        else {
+            int bitrate_bps = std::min(max_bitrate_bps_,
+                (int)(bitrate_before_drop_bps_ * kRecoveryProbeScale));
+            RTC_LOG(LS_INFO) << "ProbeController recovery probe at " << bitrate_bps
+                << " bps, estimate: " << target_bitrate_bps << " bps";
+            clusters.push_back(CreateCluster(bitrate_bps));
+            ++recovery_probes_;
+        }
+        drop_time_ms_ = -1;
+    }
+
+    congested_ = congested;
+    if (!congested) {
+        estimate_bps_ = target_bitrate_bps;
+    }
+    return clusters;
+}
+
+void ProbeController::GetStats(JsonObject& stats) {
+    stats["probe_clusters"] = clusters_;
+    stats["recovery_probes"] = recovery_probes_;
+    stats["skipped_recovery_probes"] = skipped_recovery_probes_;
+    stats["max_probe_kbps"] = max_probe_bps_ / 1000;
+}
+
+} // namespace xrtc
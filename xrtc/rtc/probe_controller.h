@@ -0,0 +1,68 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_PROBE_CONTROLLER_H_
+#define XRTCSDK_XRTC_RTC_PROBE_CONTROLLER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "xrtc/base/xrtc_json.h"
+
+namespace xrtc {
+
+// 一次带宽探测：在duration_ms内按bitrate_bps发送，至少min_packets个包
+struct ProbeCluster {
+    int id = 0;
+    int bitrate_bps = 0;
+    int duration_ms = 15;
+    int min_packets = 5;
+};
+
+// 决定什么时候按多大的码率探测(GCC的probe controller)，丢包估计每秒只涨8%，
+// 起始码率离链路容量很远时要几十秒才能用满，探测的结果直接抬高目标码率：
+// - 开始推流：按起始码率的3倍和6倍各探测一次，结果不低于探测码率的70%时说明还有余量，
+//   按结果的2倍继续探测，直到结果跟不上或者到达最大码率
+// - 拥塞恢复：一次大的下降(低于下降前的66%)之后5秒内丢包恢复，按下降前码率的85%探测一次，
+//   短暂的拥塞(比如关键帧)之后不用再慢慢涨回去；持续丢包的拥塞是链路容量变小，不探测，
+//   否则探测会把码率推回已经装不下的链路，再丢一轮包
+// - 网络路径切换：和开始推流一样从当前码率重新探测
+// 只在network_thread上使用
+class ProbeController {
+public:
+    void Reset(int max_bitrate_bps);
+
+    // 返回需要发送的探测簇，下同
+    std::vector<ProbeCluster> OnStart(int start_bitrate_bps);
+    std::vector<ProbeCluster> OnRouteChanged(int target_bitrate_bps);
+    std::vector<ProbeCluster> OnProbeResult(int cluster_id, int bitrate_bps);
+    // 每个RR更新丢包估计之后调用，congested为丢包估计是否处在拥塞中，
+    // sustained_loss为这次拥塞是否为持续丢包(LossBasedBwe::sustained_loss)
+    std::vector<ProbeCluster> OnEstimate(int target_bitrate_bps, bool congested,
+        bool sustained_loss, int64_t now_ms);
+
+    void GetStats(JsonObject& stats);
+
+private:
+    ProbeCluster CreateCluster(int bitrate_bps);
+
+private:
+    int max_bitrate_bps_ = 0;
+    int next_cluster_id_ = 1;
+    // 指数探测中最近一批簇的id范围和其中最大的码率，0表示不在指数探测中
+    int exponential_first_id_ = 0;
+    int exponential_last_id_ = 0;
+    int exponential_bitrate_bps_ = 0;
+    int estimate_bps_ = 0;//最近一次没有拥塞时的目标码率
+    bool congested_ = false;
+    int bitrate_before_drop_bps_ = 0;
+    int64_t drop_time_ms_ = -1;
+
+    // 统计
+    int64_t clusters_ = 0;
+    int64_t recovery_probes_ = 0;
+    int64_t skipped_recovery_probes_ = 0;
+    int max_probe_bps_ = 0;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_PROBE_CONTROLLER_H_
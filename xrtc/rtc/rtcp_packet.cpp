@@ -0,0 +1,183 @@
+﻿#include "xrtc/rtc/rtcp_packet.h"
+
+#include <algorithm>
+
+namespace xrtc {
+
+namespace {
+
+const size_t kRtcpHeaderSize = 4;
+const size_t kPsfbCommonSize = 12;//头 + 发送端ssrc + 媒体ssrc
+const size_t kFirEntrySize = 8;
+const size_t kRrCommonSize = 8;//头 + 发送端ssrc
+const size_t kSenderInfoSize = 20;
+const size_t kReportBlockSize = 24;
+const size_t kTransportCcCommonSize = 20;//头 + 两个ssrc + 基础序号、状态数、参考时间和反馈序号
+const int64_t kTransportCcReferenceUnitUs = 64000;
+const int64_t kTransportCcDeltaUnitUs = 250;
+
+// 包状态
+enum TransportCcSymbol {
+    kSymbolNotReceived = 0,
+    kSymbolSmallDelta = 1,
+    kSymbolLargeDelta = 2,
+};
+
+uint32_t GetBE32(const uint8_t* data) {
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) |
+        data[3];
+}
+
+void ParseReportBlocks(const uint8_t* packet, size_t length, size_t offset,
+    std::vector<RtcpReportBlock>* blocks)
+{
+    uint32_t sender_ssrc = GetBE32(packet + 4);
+    size_t count = packet[0] & 0x1F;
+    for (size_t i = 0; i < count && offset + kReportBlockSize <= length; ++i) {
+        const uint8_t* p = packet + offset;
+        RtcpReportBlock block;
+        block.sender_ssrc = sender_ssrc;
+        block.media_ssrc = GetBE32(p);
+        block.fraction_lost = p[4];
+        // 24位有符号数
+        int32_t lost = (int32_t)((p[5] << 16) | (p[6] << 8) | p[7]);
+        block.cumulative_lost = (lost & 0x800000) ? lost - 0x1000000 : lost;
+        block.extended_highest_sequence = GetBE32(p + 8);
+        block.jitter = GetBE32(p + 12);
+        block.last_sr = GetBE32(p + 16);
+        block.delay_since_last_sr = GetBE32(p + 20);
+        blocks->push_back(block);
+        offset += kReportBlockSize;
+    }
+}
+
+// 先读出所有包状态块，再按状态依次读到达时间差：小的1字节无符号，大的2字节有符号，单位250us
+bool ParseTransportFeedback(const uint8_t* packet, size_t length,
+    RtcpTransportFeedback* feedback)
+{
+    feedback->sender_ssrc = GetBE32(packet + 4);
+    feedback->media_ssrc = GetBE32(packet + 8);
+    feedback->base_sequence = (uint16_t)((packet[12] << 8) | packet[13]);
+    size_t status_count = (size_t)((packet[14] << 8) | packet[15]);
+    // 24位有符号数
+    int32_t reference = (int32_t)((packet[16] << 16) | (packet[17] << 8) | packet[18]);
+    reference = (reference & 0x800000) ? reference - 0x1000000 : reference;
+    feedback->feedback_count = packet[19];
+
+    std::vector<uint8_t> symbols;
+    symbols.reserve(status_count);
+    size_t offset = kTransportCcCommonSize;
+    while (symbols.size() < status_count) {
+        if (offset + 2 > length) {
+            return false;
+        }
+        uint16_t chunk = (uint16_t)((packet[offset] << 8) | packet[offset + 1]);
+        offset += 2;
+        if (!(chunk & 0x8000)) {
+            // run length：2位状态 + 13位长度
+            uint8_t symbol = (uint8_t)((chunk >> 13) & 0x03);
+            size_t run = std::min<size_t>(chunk & 0x1FFF, status_count - symbols.size());
+            symbols.insert(symbols.end(), run, symbol);
+        }
+        else if (!(chunk & 0x4000)) {
+            for (int bit = 13; bit >= 0 && symbols.size() < status_count; --bit) {
+                symbols.push_back((uint8_t)((chunk >> bit) & 0x01));
+            }
+        }
+        else {
+            for (int shift = 12; shift >= 0 && symbols.size() < status_count; shift -= 2) {
+                symbols.push_back((uint8_t)((chunk >> shift) & 0x03));
+            }
+        }
+    }
+
+    int64_t arrival_us = (int64_t)reference * kTransportCcReferenceUnitUs;
+    feedback->packets.reserve(status_count);
+    for (size_t i = 0; i < status_count; ++i) {
+        RtcpTransportFeedback::Packet entry;
+        entry.sequence = (uint16_t)(feedback->base_sequence + i);
+        if (symbols[i] == kSymbolSmallDelta) {
+            if (offset + 1 > length) {
+                return false;
+            }
+            arrival_us += packet[offset] * kTransportCcDeltaUnitUs;
+            offset += 1;
+            entry.received = true;
+        }
+        else if (symbols[i] == kSymbolLargeDelta) {
+            if (offset + 2 > length) {
+                return false;
+            }
+            arrival_us += (int16_t)((packet[offset] << 8) | packet[offset + 1]) *
+                kTransportCcDeltaUnitUs;
+            offset += 2;
+            entry.received = true;
+        }
+        entry.arrival_time_us = entry.received ? arrival_us : 0;
+        feedback->packets.push_back(entry);
+    }
+    return true;
+}
+
+} // namespace
+
+bool IsRtcpPacket(const uint8_t* data, size_t size) {
+    return size >= kRtcpHeaderSize && (data[0] & 0xC0) == 0x80 && data[1] >= 192 && data[1] <= 223;
+}
+
+bool ParseRtcp(const uint8_t* data, size_t size, RtcpFeedback* feedback) {
+    size_t offset = 0;
+    while (offset + kRtcpHeaderSize <= size) {
+        const uint8_t* packet = data + offset;
+        size_t length = ((size_t)((packet[2] << 8) | packet[3]) + 1) * 4;
+        if ((packet[0] & 0xC0) != 0x80 || offset + length > size) {
+            return false;
+        }
+        offset += length;
+
+        if (packet[1] == kRtcpRr && length >= kRrCommonSize) {
+            ParseReportBlocks(packet, length, kRrCommonSize, &feedback->report_blocks);
+            continue;
+        }
+        if (packet[1] == kRtcpSr && length >= kRrCommonSize + kSenderInfoSize) {
+            ParseReportBlocks(packet, length, kRrCommonSize + kSenderInfoSize,
+                &feedback->report_blocks);
+            continue;
+        }
+
+        uint8_t format = packet[0] & 0x1F;
+        if (packet[1] == kRtcpRtpfb && format == kRtcpRtpfbTransportCc &&
+            length >= kTransportCcCommonSize)
+        {
+            RtcpTransportFeedback transport_feedback;
+            if (ParseTransportFeedback(packet, length, &transport_feedback)) {
+                feedback->transport_feedbacks.push_back(std::move(transport_feedback));
+            }
+            continue;
+        }
+        if (packet[1] != kRtcpPsfb || length < kPsfbCommonSize) {
+            continue;
+        }
+
+        RtcpKeyFrameRequest request;
+        request.sender_ssrc = GetBE32(packet + 4);
+        if (format == kRtcpPsfbPli) {
+            request.media_ssrc = GetBE32(packet + 8);
+            feedback->keyframe_requests.push_back(request);
+        }
+        else if (format == kRtcpPsfbFir) {
+            // FIR的媒体ssrc字段不用，每个条目请求一路流
+            request.fir = true;
+            for (size_t entry = kPsfbCommonSize; entry + kFirEntrySize <= length;
+                entry += kFirEntrySize)
+            {
+                request.media_ssrc = GetBE32(packet + entry);
+                request.fir_seq = packet[entry + 4];
+                feedback->keyframe_requests.push_back(request);
+            }
+        }
+    }
+    return offset == size;
+}
+
+} // namespace xrtc
@@ -0,0 +1,82 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_RTCP_PACKET_H_
+#define XRTCSDK_XRTC_RTC_RTCP_PACKET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace xrtc {
+
+enum RtcpPacketType : uint8_t {
+    kRtcpSr = 200,
+    kRtcpRr = 201,
+    kRtcpSdes = 202,
+    kRtcpBye = 203,
+    kRtcpRtpfb = 205,
+    kRtcpPsfb = 206,
+};
+
+// PSFB的FMT(RFC 4585/5104)
+enum RtcpPsfbFormat : uint8_t {
+    kRtcpPsfbPli = 1,
+    kRtcpPsfbFir = 4,
+};
+
+// RTPFB的FMT
+enum RtcpRtpfbFormat : uint8_t {
+    kRtcpRtpfbTransportCc = 15,//draft-holmer-rmcat-transport-wide-cc-extensions-01
+};
+
+// 接收端请求关键帧：PLI或者FIR的一个条目
+struct RtcpKeyFrameRequest {
+    uint32_t sender_ssrc = 0;
+    uint32_t media_ssrc = 0;//请求的媒体流，FIR取条目中的ssrc
+    bool fir = false;
+    uint8_t fir_seq = 0;//FIR的序号，重传的FIR序号不变(RFC 5104 4.3.1.1)
+};
+
+// SR/RR中的一个接收报告块(RFC 3550 6.4.1)
+struct RtcpReportBlock {
+    uint32_t sender_ssrc = 0;//接收端
+    uint32_t media_ssrc = 0;//被报告的媒体流
+    uint8_t fraction_lost = 0;//上一个报告以来的丢包率，单位1/256
+    int32_t cumulative_lost = 0;
+    uint32_t extended_highest_sequence = 0;
+    uint32_t jitter = 0;
+    uint32_t last_sr = 0;
+    uint32_t delay_since_last_sr = 0;//单位1/65536秒
+};
+
+// transport-wide cc反馈：从base_sequence开始连续若干个传输层序号的接收状态和到达时间
+struct RtcpTransportFeedback {
+    struct Packet {
+        uint16_t sequence = 0;
+        bool received = false;
+        int64_t arrival_time_us = 0;//接收端的时钟，只有差值有意义
+    };
+
+    uint32_t sender_ssrc = 0;
+    uint32_t media_ssrc = 0;
+    uint16_t base_sequence = 0;
+    uint8_t feedback_count = 0;
+    std::vector<Packet> packets;
+};
+
+// 一个复合RTCP包中发送端关心的反馈
+struct RtcpFeedback {
+    std::vector<RtcpKeyFrameRequest> keyframe_requests;
+    std::vector<RtcpReportBlock> report_blocks;
+    std::vector<RtcpTransportFeedback> transport_feedbacks;
+};
+
+// rtcp-mux时按第二个字节区分RTP和RTCP(RFC 5761)：RTCP的包类型为192~223
+bool IsRtcpPacket(const uint8_t* data, size_t size);
+
+// 解析复合RTCP包中的PLI、FIR、SR/RR的接收报告和transport-wide cc反馈，其它类型跳过；
+// 长度或者版本错误时返回false，已经解析出的反馈保留
+bool ParseRtcp(const uint8_t* data, size_t size, RtcpFeedback* feedback);
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_RTCP_PACKET_H_
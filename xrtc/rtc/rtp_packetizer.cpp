@@ -0,0 +1,275 @@
+﻿#include "xrtc/rtc/rtp_packetizer.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <common_video/h264/h264_common.h>
+#include <rtc_base/helpers.h>
+
+namespace xrtc {
+
+namespace {
+
+const uint8_t kStapA = 24;
+const uint8_t kFuA = 28;
+const uint8_t kNaluTypeMask = 0x1F;
+const uint8_t kNriMask = 0x60;
+const uint8_t kFBit = 0x80;
+const uint8_t kFuStart = 0x80;
+const uint8_t kFuEnd = 0x40;
+const size_t kStapALengthSize = 2;
+
+// RFC 8285 one-byte头扩展：4字节扩展头，之后每个元素1字节元素头 + 数据，末尾补0到4字节对齐
+// frame marking 3字节数据，传输层序号2字节
+const uint16_t kOneByteExtensionProfile = 0xBEDE;
+const size_t kExtensionHeaderSize = 4;
+const uint8_t kFrameMarkingDataSize = 3;
+const uint8_t kTransportSequenceDataSize = 2;
+const uint8_t kPaddingBit = 0x20;
+const uint8_t kFrameMarkingStart = 0x80;
+const uint8_t kFrameMarkingEnd = 0x40;
+const uint8_t kFrameMarkingIndependent = 0x20;
+const uint8_t kFrameMarkingDiscardable = 0x10;
+const uint8_t kFrameMarkingBaseSync = 0x08;
+const uint8_t kFrameMarkingTidMask = 0x07;
+
+void WriteFixedHeader(uint8_t* p, uint8_t payload_type, bool marker, uint16_t sequence_number,
+    uint32_t timestamp, uint32_t ssrc)
+{
+    p[0] = 0x80;//V=2
+    p[1] = (uint8_t)((marker ? 0x80 : 0) | (payload_type & 0x7F));
+    p[2] = (uint8_t)(sequence_number >> 8);
+    p[3] = (uint8_t)sequence_number;
+    p[4] = (uint8_t)(timestamp >> 24);
+    p[5] = (uint8_t)(timestamp >> 16);
+    p[6] = (uint8_t)(timestamp >> 8);
+    p[7] = (uint8_t)timestamp;
+    p[8] = (uint8_t)(ssrc >> 24);
+    p[9] = (uint8_t)(ssrc >> 16);
+    p[10] = (uint8_t)(ssrc >> 8);
+    p[11] = (uint8_t)ssrc;
+}
+
+// 返回第一个元素的地址
+uint8_t* WriteExtensionHeader(uint8_t* p, size_t extension_words) {
+    p[0] |= 0x10;//X
+    uint8_t* ext = p + RtpPacketizer::kRtpHeaderSize;
+    ext[0] = (uint8_t)(kOneByteExtensionProfile >> 8);
+    ext[1] = (uint8_t)kOneByteExtensionProfile;
+    ext[2] = (uint8_t)(extension_words >> 8);
+    ext[3] = (uint8_t)extension_words;
+    memset(ext + kExtensionHeaderSize, 0, extension_words * 4);
+    return ext + kExtensionHeaderSize;
+}
+
+} // namespace
+
+RtpPacketizer::RtpPacketizer(uint8_t payload_type, uint32_t ssrc, size_t max_packet_size) :
+    payload_type_(payload_type),
+    ssrc_(ssrc),
+    max_packet_size_(max_packet_size),
+    // 起始序号随机(RFC 3550)
+    sequence_number_((uint16_t)rtc::CreateRandomId())
+{
+}
+
+void RtpPacketizer::EnableFrameMarking(uint8_t extension_id) {
+    frame_marking_id_ = extension_id & 0x0F;
+    UpdateHeaderExtensions();
+}
+
+void RtpPacketizer::EnableTransportSequenceNumber(uint8_t extension_id) {
+    transport_sequence_id_ = extension_id & 0x0F;
+    UpdateHeaderExtensions();
+}
+
+// frame marking在前，传输层序号在后
+void RtpPacketizer::UpdateHeaderExtensions() {
+    size_t size = 0;
+    if (frame_marking_id_) {
+        size += 1 + kFrameMarkingDataSize;
+    }
+    transport_sequence_offset_ = 0;
+    if (transport_sequence_id_) {
+        transport_sequence_offset_ = kRtpHeaderSize + kExtensionHeaderSize + size + 1;
+        size += 1 + kTransportSequenceDataSize;
+    }
+    extension_words_ = (size + 3) / 4;
+    header_size_ = kRtpHeaderSize +
+        (extension_words_ ? kExtensionHeaderSize + extension_words_ * 4 : 0);
+}
+
+uint8_t* RtpPacketizer::AddPacket(RtpPacketBatch* batch, size_t payload_size, bool marker) {
+    bool first = batch->packets.size() == frame_first_packet_;
+    size_t offset = batch->buffer.size();
+    size_t size = header_size_ + payload_size;
+    batch->buffer.resize(offset + size + RtpPacketBatch::kTrailerSize);
+    batch->packets.push_back({ offset, size });
+
+    uint8_t* p = batch->buffer.data() + offset;
+    WriteFixedHeader(p, payload_type_, marker, sequence_number_, timestamp_, ssrc_);
+    ++sequence_number_;
+    if (extension_words_ == 0) {
+        return p + kRtpHeaderSize;
+    }
+
+    uint8_t* element = WriteExtensionHeader(p, extension_words_);
+    if (frame_marking_id_) {
+        element[0] = (uint8_t)((frame_marking_id_ << 4) | (kFrameMarkingDataSize - 1));
+        element[1] = (uint8_t)(frame_marking_ | (first ? kFrameMarkingStart : 0) |
+            (marker ? kFrameMarkingEnd : 0));
+        element[2] = 0;//LID，只有时域分层
+        element[3] = tl0_pic_idx_;
+        element += 1 + kFrameMarkingDataSize;
+    }
+    if (transport_sequence_id_) {
+        element[0] = (uint8_t)((transport_sequence_id_ << 4) | (kTransportSequenceDataSize - 1));
+    }
+    return p + header_size_;
+}
+
+void RtpPacketizer::PacketizeH264(const uint8_t* data, size_t size, uint32_t rtp_timestamp,
+    const RtpFrameLayer& layer, RtpPacketBatch* batch)
+{
+    timestamp_ = rtp_timestamp;
+    batch->rtp_timestamp = rtp_timestamp;
+    batch->video = true;
+    batch->layer = layer;
+    batch->transport_sequence_offset = transport_sequence_offset_;
+    frame_first_packet_ = batch->packets.size();
+    // TL0PICIDX在每个基础层帧加一，高层帧带它依赖的基础层帧的值，接收端据此发现基础层丢帧
+    if (layer.temporal_id == 0) {
+        ++tl0_pic_idx_;
+    }
+    frame_marking_ = (uint8_t)((layer.keyframe ? kFrameMarkingIndependent : 0) |
+        (layer.discardable ? kFrameMarkingDiscardable : 0) |
+        (layer.temporal_id == 1 ? kFrameMarkingBaseSync : 0) |
+        (layer.temporal_id & kFrameMarkingTidMask));
+    // 按负载大小预留，FU-A每片多2字节，加上包尾，一般不会再扩容
+    size_t max_payload = max_payload_size();
+    batch->buffer.reserve(batch->buffer.size() + size +
+        (size / max_payload + 2) * (header_size_ + 4 + RtpPacketBatch::kTrailerSize));
+
+    std::vector<webrtc::H264::NaluIndex> nalus = webrtc::H264::FindNaluIndices(data, size);
+    size_t count = nalus.size();
+    size_t i = 0;
+    while (i < count) {
+        const uint8_t* nalu = data + nalus[i].payload_start_offset;
+        size_t nalu_size = nalus[i].payload_size;
+        if (nalu_size == 0) {
+            ++i;
+            continue;
+        }
+
+        if (nalu_size > max_payload) {
+            AddFuA(batch, nalu, nalu_size, i + 1 == count);
+            ++i;
+            continue;
+        }
+
+        // 尽量把后面的小NAL一起放进一个STAP-A
+        size_t aggregated = 1;
+        size_t end = i;
+        while (end < count && nalus[end].payload_size > 0 &&
+            aggregated + kStapALengthSize + nalus[end].payload_size <= max_payload)
+        {
+            aggregated += kStapALengthSize + nalus[end].payload_size;
+            ++end;
+        }
+
+        if (end - i < 2) {
+            uint8_t* payload = AddPacket(batch, nalu_size, i + 1 == count);
+            memcpy(payload, nalu, nalu_size);
+            ++i;
+            continue;
+        }
+
+        uint8_t* payload = AddPacket(batch, aggregated, end == count);
+        uint8_t nri = 0;
+        uint8_t f = 0;
+        uint8_t* p = payload + 1;
+        for (size_t k = i; k < end; ++k) {
+            const uint8_t* src = data + nalus[k].payload_start_offset;
+            size_t len = nalus[k].payload_size;
+            nri = std::max<uint8_t>(nri, src[0] & kNriMask);
+            f |= src[0] & kFBit;
+            p[0] = (uint8_t)(len >> 8);
+            p[1] = (uint8_t)len;
+            memcpy(p + kStapALengthSize, src, len);
+            p += kStapALengthSize + len;
+        }
+        payload[0] = f | nri | kStapA;
+        i = end;
+    }
+}
+
+void RtpPacketizer::AddFuA(RtpPacketBatch* batch, const uint8_t* nalu, size_t size, bool last) {
+    uint8_t header = nalu[0];
+    const uint8_t* src = nalu + 1;
+    size_t remaining = size - 1;
+    size_t max_fragment = max_payload_size() - 2;
+    size_t fragments = (remaining + max_fragment - 1) / max_fragment;
+    size_t fragment_size = (remaining + fragments - 1) / fragments;
+
+    for (size_t n = 0; n < fragments; ++n) {
+        size_t len = std::min(fragment_size, remaining);
+        bool end = n + 1 == fragments;
+        uint8_t* payload = AddPacket(batch, 2 + len, last && end);
+        payload[0] = (header & (kFBit | kNriMask)) | kFuA;
+        payload[1] = (uint8_t)((n == 0 ? kFuStart : 0) | (end ? kFuEnd : 0) |
+            (header & kNaluTypeMask));
+        memcpy(payload + 2, src, len);
+        src += len;
+        remaining -= len;
+    }
+}
+
+void RtpPacketizer::PacketizeAudio(const uint8_t* data, size_t size, uint32_t rtp_timestamp,
+    RtpPacketBatch* batch)
+{
+    timestamp_ = rtp_timestamp;
+    batch->rtp_timestamp = rtp_timestamp;
+    batch->video = false;
+    batch->transport_sequence_offset = transport_sequence_offset_;
+    uint8_t* payload = AddPacket(batch, size, false);
+    memcpy(payload, data, size);
+}
+
+void RtpPacketizer::BuildPaddingPacket(uint8_t payload_type, uint32_t ssrc,
+    uint16_t sequence_number, uint32_t rtp_timestamp, uint8_t transport_sequence_id,
+    size_t padding_size, RtpPacketBatch* batch)
+{
+    transport_sequence_id &= 0x0F;
+    if (padding_size > kMaxPaddingSize) {
+        padding_size = kMaxPaddingSize;
+    }
+    else if (padding_size == 0) {
+        padding_size = 1;
+    }
+    size_t header_size = kRtpHeaderSize;
+    if (transport_sequence_id) {
+        header_size += kExtensionHeaderSize + 4;
+    }
+    size_t offset = batch->buffer.size();
+    size_t size = header_size + padding_size;
+    batch->buffer.resize(offset + size + RtpPacketBatch::kTrailerSize);
+    batch->packets.push_back({ offset, size });
+    batch->rtp_timestamp = rtp_timestamp;
+    batch->video = true;
+    batch->transport_sequence_offset = 0;
+
+    uint8_t* p = batch->buffer.data() + offset;
+    WriteFixedHeader(p, payload_type, false, sequence_number, rtp_timestamp, ssrc);
+    p[0] |= kPaddingBit;
+    if (transport_sequence_id) {
+        uint8_t* element = WriteExtensionHeader(p, 1);
+        element[0] = (uint8_t)((transport_sequence_id << 4) | (kTransportSequenceDataSize - 1));
+        batch->transport_sequence_offset = kRtpHeaderSize + kExtensionHeaderSize + 1;
+    }
+    // 填充的最后一个字节是填充长度，包括它自己
+    memset(p + header_size, 0, padding_size);
+    p[size - 1] = (uint8_t)padding_size;
+}
+
+} // namespace xrtc
@@ -0,0 +1,119 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_RTP_PACKETIZER_H_
+#define XRTCSDK_XRTC_RTC_RTP_PACKETIZER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace xrtc {
+
+// 视频帧的分层信息，发送端按它丢帧，开启frame marking扩展时也写进每个包
+struct RtpFrameLayer {
+    bool keyframe = false;
+    uint8_t temporal_id = 0;//0为基础层
+    bool discardable = false;//不被其它帧参考
+};
+
+// 一帧打包出的所有RTP包，放在一块连续的缓冲中，整体交给网络线程发送，不逐包分配内存
+// 每个包后面预留kTrailerSize字节，SRTP在原地加密并追加认证标签，不再拷贝
+struct RtpPacketBatch {
+    static const size_t kTrailerSize = 16;
+
+    struct Packet {
+        size_t offset;
+        size_t size;
+    };
+
+    const uint8_t* packet_data(size_t index) const {
+        return buffer.data() + packets[index].offset;
+    }
+    uint8_t* mutable_packet_data(size_t index) { return buffer.data() + packets[index].offset; }
+    size_t packet_size(size_t index) const { return packets[index].size; }
+    // 包在缓冲中可以使用的长度，包括预留的包尾
+    size_t packet_capacity(size_t index) const {
+        size_t end = index + 1 < packets.size() ? packets[index + 1].offset : buffer.size();
+        return end - packets[index].offset;
+    }
+    size_t packet_count() const { return packets.size(); }
+    size_t bytes() const {
+        size_t total = 0;
+        for (const Packet& packet : packets) {
+            total += packet.size;
+        }
+        return total;
+    }
+
+    std::vector<uint8_t> buffer;
+    std::vector<Packet> packets;
+    uint32_t rtp_timestamp = 0;
+    int64_t capture_time_ms = 0;//采集时间，用于统计采集到发出的延时
+    bool video = true;
+    RtpFrameLayer layer;
+    // 传输层序号(transport-wide cc)在包中的偏移，0表示不带；打包时留空，网络线程发送前按发送顺序填写
+    size_t transport_sequence_offset = 0;
+};
+
+// RTP打包，每路流(ssrc)一个，只在上游编码节点的线程上使用
+// H264按RFC 6184的non-interleaved模式：小的NAL(SPS/PPS等)合并为STAP-A，
+// 超过包大小的NAL拆成FU-A，分片大小尽量平均，避免最后一片特别小
+// 开启frame marking(draft-ietf-avtext-framemarking)后每个包带一个RFC 8285的one-byte头扩展：
+// 帧的开始/结束、关键帧、可丢弃、基础层同步、TID和TL0PICIDX，中间节点不解析H264也能按层转发
+// 开启transport-wide cc(draft-holmer-rmcat-transport-wide-cc-extensions-01)后每个包再带一个
+// 2字节的传输层序号，接收端按它回复每个包的到达时间，用于带宽探测
+class RtpPacketizer {
+public:
+    static const size_t kRtpHeaderSize = 12;
+    static const size_t kDefaultMaxPacketSize = 1200;//留出IP/UDP以及SRTP、TURN的余量
+    static const size_t kMaxPaddingSize = 255;//填充长度只有一个字节(RFC 3550 5.1)
+
+    RtpPacketizer(uint8_t payload_type, uint32_t ssrc,
+        size_t max_packet_size = kDefaultMaxPacketSize);
+
+    // extension_id为SDP中协商的extmap id(1-14)，0表示不带扩展，在第一次打包之前调用
+    void EnableFrameMarking(uint8_t extension_id);
+    void EnableTransportSequenceNumber(uint8_t extension_id);
+
+    // data为Annex-B格式的一帧，最后一个包设置marker
+    void PacketizeH264(const uint8_t* data, size_t size, uint32_t rtp_timestamp,
+        const RtpFrameLayer& layer, RtpPacketBatch* batch);
+    // 一帧音频一个包(Opus的包不会超过MTU)
+    void PacketizeAudio(const uint8_t* data, size_t size, uint32_t rtp_timestamp,
+        RtpPacketBatch* batch);
+    // 只有填充的包(P位)，用于带宽探测：和视频同一个ssrc，序号和时间戳由调用者按已发出的视频包给出，
+    // transport_sequence_id非0时带传输层序号扩展(留空)，padding_size为1~kMaxPaddingSize
+    static void BuildPaddingPacket(uint8_t payload_type, uint32_t ssrc, uint16_t sequence_number,
+        uint32_t rtp_timestamp, uint8_t transport_sequence_id, size_t padding_size,
+        RtpPacketBatch* batch);
+
+    uint32_t ssrc() const { return ssrc_; }
+    uint8_t payload_type() const { return payload_type_; }
+    uint16_t sequence_number() const { return sequence_number_; }
+    size_t max_payload_size() const { return max_packet_size_ - header_size_; }
+
+private:
+    // 按开启的头扩展计算头长度和各个元素的位置
+    void UpdateHeaderExtensions();
+    // 写RTP头，返回负载的起始地址
+    uint8_t* AddPacket(RtpPacketBatch* batch, size_t payload_size, bool marker);
+    void AddFuA(RtpPacketBatch* batch, const uint8_t* nalu, size_t size, bool last);
+
+private:
+    uint8_t payload_type_;
+    uint32_t ssrc_;
+    size_t max_packet_size_;
+    uint16_t sequence_number_;
+    uint32_t timestamp_ = 0;//当前帧的RTP时间戳
+    size_t header_size_ = kRtpHeaderSize;
+    uint8_t frame_marking_id_ = 0;
+    uint8_t transport_sequence_id_ = 0;
+    size_t extension_words_ = 0;//头扩展的长度，单位4字节，不含扩展头
+    size_t transport_sequence_offset_ = 0;
+    uint8_t frame_marking_ = 0;//当前帧的frame marking，不含S/E
+    uint8_t tl0_pic_idx_ = 0;
+    size_t frame_first_packet_ = 0;//当前帧第一个包在批次中的序号
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_RTP_PACKETIZER_H_
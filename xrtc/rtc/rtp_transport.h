@@ -0,0 +1,21 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_RTP_TRANSPORT_H_
+#define XRTCSDK_XRTC_RTC_RTP_TRANSPORT_H_
+
+namespace xrtc {
+
+struct RtpPacketBatch;
+
+// 媒体发送的传输，XRTCMediaSink只依赖这个接口：直连的UdpTransport、经过ICE的IceTransport，
+// 或者在ICE之上加密的DtlsSrtpTransport。只在network_thread上调用
+class RtpTransport {
+public:
+    virtual ~RtpTransport() {}
+
+    // 还没有连通或者发送失败返回false，由调用者计为丢帧
+    // SRTP在batch的缓冲中原地加密，返回之后包的内容和长度可能已经改变
+    virtual bool SendBatch(RtpPacketBatch& batch) = 0;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_RTP_TRANSPORT_H_
@@ -0,0 +1,341 @@
+﻿#include "xrtc/rtc/session_description.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include <rtc_base/helpers.h>
+
+namespace xrtc {
+
+namespace {
+
+std::vector<std::string> Split(const std::string& str, char delimiter) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (start <= str.size()) {
+        size_t end = str.find(delimiter, start);
+        if (end == std::string::npos) {
+            end = str.size();
+        }
+        if (end > start) {
+            fields.push_back(str.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return fields;
+}
+
+bool ToInt(const std::string& str, int* value) {
+    char* end = nullptr;
+    long n = strtol(str.c_str(), &end, 10);
+    if (str.empty() || *end != '\0') {
+        return false;
+    }
+    *value = (int)n;
+    return true;
+}
+
+bool EqualsIgnoreCase(const std::string& a, const std::string& b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+        [](char x, char y) { return tolower((unsigned char)x) == tolower((unsigned char)y); });
+}
+
+// c=IN IP4 1.2.3.4
+bool ParseConnection(const std::string& value, std::string* ip) {
+    std::vector<std::string> fields = Split(value, ' ');
+    if (fields.size() < 3 || fields[0] != "IN") {
+        return false;
+    }
+    *ip = fields[2];
+    return true;
+}
+
+// 解析m=段内的a=行，不认识的属性忽略
+void ParseMediaAttribute(const std::string& attr, MediaContent* content) {
+    size_t colon = attr.find(':');
+    std::string name = attr.substr(0, colon);
+    std::string value = colon == std::string::npos ? "" : attr.substr(colon + 1);
+
+    if (name == "sendonly" || name == "recvonly" || name == "sendrecv" || name == "inactive") {
+        content->direction = name;
+    }
+    else if (name == "mid") {
+        content->mid = value;
+    }
+    else if (name == "rtcp-mux") {
+        content->rtcp_mux = true;
+    }
+    else if (name == "ice-ufrag") {
+        content->ice_ufrag = value;
+    }
+    else if (name == "ice-pwd") {
+        content->ice_pwd = value;
+    }
+    else if (name == "ice-options") {
+        content->ice_options = Split(value, ' ');
+    }
+    else if (name == "fingerprint") {
+        size_t space = value.find(' ');
+        if (space != std::string::npos) {
+            content->fingerprint_algorithm = value.substr(0, space);
+            content->fingerprint = value.substr(space + 1);
+        }
+    }
+    else if (name == "setup") {
+        content->setup = value;
+    }
+    else if (name == "candidate") {
+        IceCandidate candidate;
+        if (IceCandidate::Parse(attr, &candidate)) {
+            content->candidates.push_back(candidate);
+        }
+    }
+    else if (name == "rtpmap" || name == "fmtp") {
+        size_t space = value.find(' ');
+        int pt = 0;
+        if (space == std::string::npos || !ToInt(value.substr(0, space), &pt)) {
+            return;
+        }
+        (name == "rtpmap" ? content->rtpmap : content->fmtp)[pt] = value.substr(space + 1);
+    }
+    else if (name == "extmap") {
+        // a=extmap:<id>[/direction] <uri> [attributes]
+        size_t space = value.find(' ');
+        size_t slash = value.find('/');
+        int id = 0;
+        if (space == std::string::npos || !ToInt(value.substr(0, std::min(space, slash)), &id) ||
+            id <= 0)
+        {
+            return;
+        }
+        std::string uri = value.substr(space + 1);
+        content->extmap[id] = uri.substr(0, uri.find(' '));
+    }
+    else if (name == "ssrc") {
+        size_t space = value.find(' ');
+        uint32_t ssrc = (uint32_t)strtoul(value.substr(0, space).c_str(), nullptr, 10);
+        if (std::find(content->ssrcs.begin(), content->ssrcs.end(), ssrc) == content->ssrcs.end()) {
+            content->ssrcs.push_back(ssrc);
+        }
+        if (space != std::string::npos && value.compare(space + 1, 6, "cname:") == 0) {
+            content->cname = value.substr(space + 7);
+        }
+    }
+}
+
+} // namespace
+
+int MediaContent::FindPayloadType(const std::string& codec) const {
+    for (int pt : payload_types) {
+        auto it = rtpmap.find(pt);
+        if (it == rtpmap.end()) {
+            continue;
+        }
+
+        std::string name = it->second.substr(0, it->second.find('/'));
+        if (EqualsIgnoreCase(name, codec)) {
+            return pt;
+        }
+    }
+    return -1;
+}
+
+int MediaContent::FindExtension(const std::string& uri) const {
+    for (const auto& ext : extmap) {
+        if (ext.second == uri) {
+            return ext.first;
+        }
+    }
+    return 0;
+}
+
+std::unique_ptr<SessionDescription> SessionDescription::Parse(const std::string& type,
+    const std::string& sdp, std::string* error)
+{
+    auto desc = std::make_unique<SessionDescription>();
+    desc->type = type;
+    std::string session_ip;
+    MediaContent session_attributes;//会话级的ice属性
+    MediaContent* content = nullptr;
+
+    for (std::string line : Split(sdp, '\n')) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        if (line.size() < 2 || line[1] != '=') {
+            *error = "invalid line: " + line;
+            return nullptr;
+        }
+
+        std::string value = line.substr(2);
+        switch (line[0]) {
+        case 'o': {
+            std::vector<std::string> fields = Split(value, ' ');
+            if (fields.size() > 1) {
+                desc->session_id = fields[1];
+            }
+            break;
+        }
+        case 'm': {
+            // m=video 9 UDP/TLS/RTP/SAVPF 107 108
+            std::vector<std::string> fields = Split(value, ' ');
+            desc->contents.emplace_back();
+            content = &desc->contents.back();
+            if (fields.size() < 4 || !ToInt(fields[1], &content->port)) {
+                *error = "invalid media line: " + line;
+                return nullptr;
+            }
+            content->media = fields[0];
+            content->protocol = fields[2];
+            content->connection_ip = session_ip;
+            for (size_t i = 3; i < fields.size(); ++i) {
+                int pt = 0;
+                if (ToInt(fields[i], &pt)) {
+                    content->payload_types.push_back(pt);
+                }
+            }
+            break;
+        }
+        case 'c': {
+            std::string ip;
+            if (!ParseConnection(value, &ip)) {
+                *error = "invalid connection line: " + line;
+                return nullptr;
+            }
+            (content ? content->connection_ip : session_ip) = ip;
+            break;
+        }
+        case 'a':
+            if (content) {
+                ParseMediaAttribute(value, content);
+            }
+            else if (value.compare(0, 13, "group:BUNDLE ") == 0) {
+                desc->bundle = Split(value.substr(13), ' ');
+            }
+            else if (value == "ice-lite") {
+                desc->ice_lite = true;
+            }
+            else {
+                ParseMediaAttribute(value, &session_attributes);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (desc->contents.empty()) {
+        *error = "no media";
+        return nullptr;
+    }
+    for (MediaContent& media : desc->contents) {
+        if (media.ice_ufrag.empty()) {
+            media.ice_ufrag = session_attributes.ice_ufrag;
+            media.ice_pwd = session_attributes.ice_pwd;
+        }
+        if (media.ice_options.empty()) {
+            media.ice_options = session_attributes.ice_options;
+        }
+        if (media.fingerprint.empty()) {
+            media.fingerprint_algorithm = session_attributes.fingerprint_algorithm;
+            media.fingerprint = session_attributes.fingerprint;
+        }
+        if (media.setup.empty()) {
+            media.setup = session_attributes.setup;
+        }
+    }
+    return desc;
+}
+
+std::string SessionDescription::ToString() const {
+    std::ostringstream ss;
+    std::string id = session_id.empty() ? std::to_string(rtc::CreateRandomId()) : session_id;
+    ss << "v=0\r\n"
+        << "o=- " << id << " 2 IN IP4 127.0.0.1\r\n"
+        << "s=-\r\n"
+        << "t=0 0\r\n";
+    if (ice_lite) {
+        ss << "a=ice-lite\r\n";
+    }
+    if (!bundle.empty()) {
+        ss << "a=group:BUNDLE";
+        for (const std::string& mid : bundle) {
+            ss << " " << mid;
+        }
+        ss << "\r\n";
+    }
+
+    for (const MediaContent& content : contents) {
+        ss << "m=" << content.media << " " << content.port << " " << content.protocol;
+        for (int pt : content.payload_types) {
+            ss << " " << pt;
+        }
+        ss << "\r\n";
+        ss << "c=IN " << (content.connection_ip.find(':') == std::string::npos ? "IP4 " : "IP6 ")
+            << (content.connection_ip.empty() ? "0.0.0.0" : content.connection_ip) << "\r\n";
+        if (!content.mid.empty()) {
+            ss << "a=mid:" << content.mid << "\r\n";
+        }
+        if (!content.ice_ufrag.empty()) {
+            ss << "a=ice-ufrag:" << content.ice_ufrag << "\r\n"
+                << "a=ice-pwd:" << content.ice_pwd << "\r\n";
+        }
+        if (!content.ice_options.empty()) {
+            ss << "a=ice-options:";
+            for (size_t i = 0; i < content.ice_options.size(); ++i) {
+                ss << (i ? " " : "") << content.ice_options[i];
+            }
+            ss << "\r\n";
+        }
+        for (const IceCandidate& candidate : content.candidates) {
+            ss << "a=" << candidate.ToString() << "\r\n";
+        }
+        if (!content.fingerprint.empty()) {
+            ss << "a=fingerprint:" << content.fingerprint_algorithm << " " << content.fingerprint
+                << "\r\n";
+        }
+        if (!content.setup.empty()) {
+            ss << "a=setup:" << content.setup << "\r\n";
+        }
+        if (!content.direction.empty()) {
+            ss << "a=" << content.direction << "\r\n";
+        }
+        if (content.rtcp_mux) {
+            ss << "a=rtcp-mux\r\n";
+        }
+        for (int pt : content.payload_types) {
+            auto rtpmap = content.rtpmap.find(pt);
+            if (rtpmap != content.rtpmap.end()) {
+                ss << "a=rtpmap:" << pt << " " << rtpmap->second << "\r\n";
+            }
+            auto fmtp = content.fmtp.find(pt);
+            if (fmtp != content.fmtp.end()) {
+                ss << "a=fmtp:" << pt << " " << fmtp->second << "\r\n";
+            }
+        }
+        for (const auto& ext : content.extmap) {
+            ss << "a=extmap:" << ext.first << " " << ext.second << "\r\n";
+        }
+        for (uint32_t ssrc : content.ssrcs) {
+            ss << "a=ssrc:" << ssrc << " cname:" << content.cname << "\r\n";
+        }
+    }
+    return ss.str();
+}
+
+const MediaContent* SessionDescription::FindContent(const std::string& media) const {
+    for (const MediaContent& content : contents) {
+        if (content.media == media) {
+            return &content;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace xrtc
@@ -0,0 +1,60 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_SESSION_DESCRIPTION_H_
+#define XRTCSDK_XRTC_RTC_SESSION_DESCRIPTION_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xrtc/rtc/ice_candidate.h"
+
+namespace xrtc {
+
+// SDP中的一个m=段，只保留推流用到的属性
+struct MediaContent {
+    std::string media;//audio/video
+    int port = 0;//0表示拒绝
+    std::string protocol = "UDP/TLS/RTP/SAVPF";
+    std::vector<int> payload_types;
+    std::map<int, std::string> rtpmap;//payload type -> "H264/90000"
+    std::map<int, std::string> fmtp;
+    std::map<int, std::string> extmap;//RTP头扩展id -> uri
+    std::string connection_ip;//c=行，媒体级没有时取会话级的
+    std::string mid;
+    std::string direction;//sendonly/recvonly/sendrecv/inactive
+    bool rtcp_mux = false;
+    std::vector<uint32_t> ssrcs;
+    std::string cname;
+    std::string ice_ufrag;//会话级的ice-ufrag/ice-pwd合并到每个m=段
+    std::string ice_pwd;
+    std::vector<std::string> ice_options;//trickle等
+    std::vector<IceCandidate> candidates;
+    std::string fingerprint_algorithm;//DTLS证书指纹，会话级的同样合并到每个m=段
+    std::string fingerprint;
+    std::string setup;//active/passive/actpass
+
+    // 按编码名查找payload type(不区分大小写)，没有返回-1
+    int FindPayloadType(const std::string& codec) const;
+    // 按uri查找头扩展的id，没有返回0
+    int FindExtension(const std::string& uri) const;
+};
+
+struct SessionDescription {
+    std::string type;//offer/answer
+    std::string session_id;
+    bool ice_lite = false;
+    std::vector<std::string> bundle;//a=group:BUNDLE中的mid
+    std::vector<MediaContent> contents;
+
+    // 解析失败返回nullptr，error中是出错的行
+    static std::unique_ptr<SessionDescription> Parse(const std::string& type,
+        const std::string& sdp, std::string* error);
+    std::string ToString() const;
+    const MediaContent* FindContent(const std::string& media) const;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_SESSION_DESCRIPTION_H_
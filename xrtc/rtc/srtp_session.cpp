@@ -0,0 +1,489 @@
+﻿#include "xrtc/rtc/srtp_session.h"
+
+#include <string.h>
+
+#include <openssl/evp.h>
+
+#include <rtc_base/logging.h>
+
+#include "xrtc/rtc/rtp_packetizer.h"
+
+namespace xrtc {
+
+namespace {
+
+const size_t kRtpHeaderSize = 12;
+const size_t kRtcpHeaderSize = 8;
+const size_t kSrtpKeyLength = 16;
+const size_t kCmSaltLength = 14;
+const size_t kGcmSaltLength = 12;
+const size_t kHmacKeyLength = 20;
+const size_t kHmacTagLength = 10;//HMAC-SHA1-80
+const size_t kGcmTagLength = 16;
+const size_t kSrtcpIndexLength = 4;
+const size_t kHmacBlockSize = 64;
+const uint32_t kSrtcpEncryptedFlag = 0x80000000;
+
+// RFC 3711 4.3.1中的label
+const uint8_t kLabelRtpEncryption = 0;
+const uint8_t kLabelRtpAuth = 1;
+const uint8_t kLabelRtpSalt = 2;
+const uint8_t kLabelRtcpEncryption = 3;
+const uint8_t kLabelRtcpAuth = 4;
+const uint8_t kLabelRtcpSalt = 5;
+
+uint16_t GetBE16(const uint8_t* data) {
+    return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+uint32_t GetBE32(const uint8_t* data) {
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+        ((uint32_t)data[2] << 8) | data[3];
+}
+
+void SetBE32(uint8_t* data, uint32_t value) {
+    data[0] = (uint8_t)(value >> 24);
+    data[1] = (uint8_t)(value >> 16);
+    data[2] = (uint8_t)(value >> 8);
+    data[3] = (uint8_t)value;
+}
+
+// 异或写入大端整数，用于在盐上构造IV
+void XorBE(uint8_t* data, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        data[bytes - 1 - i] ^= (uint8_t)(value >> (8 * i));
+    }
+}
+
+// RTP头的长度(包括CSRC和扩展头)，包不完整返回0
+size_t RtpHeaderSize(const uint8_t* data, size_t size) {
+    if (size < kRtpHeaderSize || (data[0] >> 6) != 2) {
+        return 0;
+    }
+
+    size_t header_size = kRtpHeaderSize + (data[0] & 0x0F) * 4;
+    if (data[0] & 0x10) {
+        if (size < header_size + 4) {
+            return 0;
+        }
+        header_size += 4 + GetBE16(data + header_size + 2) * 4;
+    }
+    return header_size <= size ? header_size : 0;
+}
+
+// RFC 3711附录A：按最高序号估计ROC
+uint32_t GuessRoc(uint32_t roc, uint16_t last_seq, uint16_t seq) {
+    if (last_seq < 0x8000) {
+        return (int)seq - (int)last_seq > 0x8000 && roc > 0 ? roc - 1 : roc;
+    }
+    return (int)last_seq - 0x8000 > (int)seq ? roc + 1 : roc;
+}
+
+} // namespace
+
+SrtpSession::SrtpSession() {
+}
+
+SrtpSession::~SrtpSession() {
+    EVP_CIPHER_CTX_free(rtp_cipher_);
+    EVP_CIPHER_CTX_free(rtcp_cipher_);
+    EVP_MD_CTX_free(rtp_hmac_inner_);
+    EVP_MD_CTX_free(rtp_hmac_outer_);
+    EVP_MD_CTX_free(rtcp_hmac_inner_);
+    EVP_MD_CTX_free(rtcp_hmac_outer_);
+    EVP_MD_CTX_free(hmac_work_);
+}
+
+const char* SrtpSession::ProfileName(SrtpProfile profile) {
+    switch (profile) {
+    case SrtpProfile::kAes128CmSha1_80:
+        return "SRTP_AES128_CM_SHA1_80";
+    case SrtpProfile::kAeadAes128Gcm:
+        return "SRTP_AEAD_AES_128_GCM";
+    default:
+        return "none";
+    }
+}
+
+SrtpProfile SrtpSession::ProfileFromName(const std::string& name) {
+    if (name == "SRTP_AES128_CM_SHA1_80") {
+        return SrtpProfile::kAes128CmSha1_80;
+    }
+    if (name == "SRTP_AEAD_AES_128_GCM") {
+        return SrtpProfile::kAeadAes128Gcm;
+    }
+    return SrtpProfile::kNone;
+}
+
+size_t SrtpSession::KeyLength(SrtpProfile profile) {
+    return profile == SrtpProfile::kNone ? 0 : kSrtpKeyLength;
+}
+
+size_t SrtpSession::SaltLength(SrtpProfile profile) {
+    switch (profile) {
+    case SrtpProfile::kAes128CmSha1_80:
+        return kCmSaltLength;
+    case SrtpProfile::kAeadAes128Gcm:
+        return kGcmSaltLength;
+    default:
+        return 0;
+    }
+}
+
+size_t SrtpSession::trailer_size() const {
+    return profile_ == SrtpProfile::kAeadAes128Gcm ? kGcmTagLength : kHmacTagLength;
+}
+
+bool SrtpSession::Init(SrtpProfile profile, const uint8_t* key, const uint8_t* salt) {
+    if (profile == SrtpProfile::kNone || profile_ != SrtpProfile::kNone) {
+        return false;
+    }
+
+    // GCM的主盐只有12字节，KDF按14字节计算，后面补0(与libsrtp一致)
+    master_key_.assign(key, key + kSrtpKeyLength);
+    master_salt_.assign(kCmSaltLength, 0);
+    memcpy(master_salt_.data(), salt, SaltLength(profile));
+    profile_ = profile;
+
+    uint8_t rtp_key[kSrtpKeyLength];
+    uint8_t rtcp_key[kSrtpKeyLength];
+    bool gcm = profile == SrtpProfile::kAeadAes128Gcm;
+    const EVP_CIPHER* cipher = gcm ? EVP_aes_128_gcm() : EVP_aes_128_ctr();
+    rtp_cipher_ = EVP_CIPHER_CTX_new();
+    rtcp_cipher_ = EVP_CIPHER_CTX_new();
+    bool ok = rtp_cipher_ && rtcp_cipher_ &&
+        DeriveKey(kLabelRtpEncryption, rtp_key, sizeof(rtp_key)) &&
+        DeriveKey(kLabelRtpSalt, rtp_salt_, sizeof(rtp_salt_)) &&
+        DeriveKey(kLabelRtcpEncryption, rtcp_key, sizeof(rtcp_key)) &&
+        DeriveKey(kLabelRtcpSalt, rtcp_salt_, sizeof(rtcp_salt_)) &&
+        EVP_CipherInit_ex(rtp_cipher_, cipher, nullptr, rtp_key, nullptr, 1) == 1 &&
+        EVP_CipherInit_ex(rtcp_cipher_, cipher, nullptr, rtcp_key, nullptr, 1) == 1;
+
+    if (ok && !gcm) {
+        uint8_t rtp_auth[kHmacKeyLength];
+        uint8_t rtcp_auth[kHmacKeyLength];
+        rtp_hmac_inner_ = EVP_MD_CTX_new();
+        rtp_hmac_outer_ = EVP_MD_CTX_new();
+        rtcp_hmac_inner_ = EVP_MD_CTX_new();
+        rtcp_hmac_outer_ = EVP_MD_CTX_new();
+        hmac_work_ = EVP_MD_CTX_new();
+        ok = hmac_work_ && DeriveKey(kLabelRtpAuth, rtp_auth, sizeof(rtp_auth)) &&
+            DeriveKey(kLabelRtcpAuth, rtcp_auth, sizeof(rtcp_auth)) &&
+            InitHmac(rtp_auth, sizeof(rtp_auth), rtp_hmac_inner_, rtp_hmac_outer_) &&
+            InitHmac(rtcp_auth, sizeof(rtcp_auth), rtcp_hmac_inner_, rtcp_hmac_outer_);
+    }
+
+    if (!ok) {
+        RTC_LOG(LS_WARNING) << "SrtpSession init failed, profile: " << ProfileName(profile);
+        profile_ = SrtpProfile::kNone;
+    }
+    return ok;
+}
+
+// 密钥流 = AES-CM(master_key, (master_salt XOR label << 48) << 16)
+bool SrtpSession::DeriveKey(uint8_t label, uint8_t* out, size_t size) {
+    uint8_t iv[16] = { 0 };
+    memcpy(iv, master_salt_.data(), kCmSaltLength);
+    iv[7] ^= label;
+    memset(out, 0, size);
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int len = 0;
+    bool ok = ctx && EVP_EncryptInit_ex(ctx, EVP_aes_128_ctr(), nullptr, master_key_.data(), iv) == 1 &&
+        EVP_EncryptUpdate(ctx, out, &len, out, (int)size) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+bool SrtpSession::InitHmac(const uint8_t* key, size_t size, EVP_MD_CTX* inner,
+    EVP_MD_CTX* outer)
+{
+    uint8_t ipad[kHmacBlockSize];
+    uint8_t opad[kHmacBlockSize];
+    for (size_t i = 0; i < kHmacBlockSize; ++i) {
+        uint8_t k = i < size ? key[i] : 0;
+        ipad[i] = k ^ 0x36;
+        opad[i] = k ^ 0x5C;
+    }
+    return inner && outer &&
+        EVP_DigestInit_ex(inner, EVP_sha1(), nullptr) == 1 &&
+        EVP_DigestUpdate(inner, ipad, sizeof(ipad)) == 1 &&
+        EVP_DigestInit_ex(outer, EVP_sha1(), nullptr) == 1 &&
+        EVP_DigestUpdate(outer, opad, sizeof(opad)) == 1;
+}
+
+bool SrtpSession::ComputeHmac(EVP_MD_CTX* inner, EVP_MD_CTX* outer, const uint8_t* data,
+    size_t size, const uint8_t* extra, size_t extra_size, uint8_t* tag)
+{
+    uint8_t digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_size = 0;
+    if (EVP_MD_CTX_copy_ex(hmac_work_, inner) != 1 ||
+        EVP_DigestUpdate(hmac_work_, data, size) != 1 ||
+        (extra_size > 0 && EVP_DigestUpdate(hmac_work_, extra, extra_size) != 1) ||
+        EVP_DigestFinal_ex(hmac_work_, digest, &digest_size) != 1 ||
+        EVP_MD_CTX_copy_ex(hmac_work_, outer) != 1 ||
+        EVP_DigestUpdate(hmac_work_, digest, digest_size) != 1 ||
+        EVP_DigestFinal_ex(hmac_work_, digest, &digest_size) != 1)
+    {
+        return false;
+    }
+
+    memcpy(tag, digest, kHmacTagLength);
+    return true;
+}
+
+bool SrtpSession::ProtectRtp(uint8_t* data, size_t* size, size_t capacity) {
+    size_t header_size = RtpHeaderSize(data, *size);
+    if (profile_ == SrtpProfile::kNone || header_size == 0 ||
+        *size + trailer_size() > capacity)
+    {
+        return false;
+    }
+
+    // 发送端的序号单调递增，重传的旧包按估计的ROC加密
+    uint16_t seq = GetBE16(data + 2);
+    uint32_t ssrc = GetBE32(data + 8);
+    StreamState& stream = streams_[ssrc];
+    uint32_t roc = stream.has_seq ? GuessRoc(stream.roc, stream.last_seq, seq) : 0;
+    if (!stream.has_seq || roc > stream.roc || (roc == stream.roc && seq > stream.last_seq)) {
+        stream.roc = roc;
+        stream.last_seq = seq;
+        stream.has_seq = true;
+    }
+
+    bool ok = profile_ == SrtpProfile::kAeadAes128Gcm ?
+        ProtectRtpGcm(data, *size, header_size, ssrc, roc, seq) :
+        ProtectRtpCm(data, *size, header_size, ssrc, ((uint64_t)roc << 16) | seq);
+    if (ok) {
+        *size += trailer_size();
+    }
+    return ok;
+}
+
+bool SrtpSession::ProtectRtp(RtpPacketBatch* batch) {
+    for (size_t i = 0; i < batch->packet_count(); ++i) {
+        size_t size = batch->packet_size(i);
+        if (!ProtectRtp(batch->mutable_packet_data(i), &size, batch->packet_capacity(i))) {
+            return false;
+        }
+        batch->packets[i].size = size;
+    }
+    return true;
+}
+
+// RFC 3711 4.1.1：IV = (salt << 16) XOR (ssrc << 64) XOR (index << 16)
+bool SrtpSession::ProtectRtpCm(uint8_t* data, size_t size, size_t header_size, uint32_t ssrc,
+    uint64_t index)
+{
+    uint8_t iv[16] = { 0 };
+    memcpy(iv, rtp_salt_, kCmSaltLength);
+    XorBE(iv + 4, ssrc, 4);
+    XorBE(iv + 8, index, 6);
+
+    int len = 0;
+    uint8_t roc[4];
+    SetBE32(roc, (uint32_t)(index >> 16));
+    return EVP_CipherInit_ex(rtp_cipher_, nullptr, nullptr, nullptr, iv, 1) == 1 &&
+        EVP_CipherUpdate(rtp_cipher_, data + header_size, &len, data + header_size,
+            (int)(size - header_size)) == 1 &&
+        ComputeHmac(rtp_hmac_inner_, rtp_hmac_outer_, data, size, roc, sizeof(roc), data + size);
+}
+
+// RFC 7714 8.1：IV = (0x0000 || ssrc || roc || seq) XOR salt，RTP头作为AAD
+bool SrtpSession::ProtectRtpGcm(uint8_t* data, size_t size, size_t header_size, uint32_t ssrc,
+    uint32_t roc, uint16_t seq)
+{
+    uint8_t iv[kGcmSaltLength];
+    memcpy(iv, rtp_salt_, kGcmSaltLength);
+    XorBE(iv + 2, ssrc, 4);
+    XorBE(iv + 6, roc, 4);
+    XorBE(iv + 10, seq, 2);
+
+    int len = 0;
+    return EVP_CipherInit_ex(rtp_cipher_, nullptr, nullptr, nullptr, iv, 1) == 1 &&
+        EVP_CipherUpdate(rtp_cipher_, nullptr, &len, data, (int)header_size) == 1 &&
+        EVP_CipherUpdate(rtp_cipher_, data + header_size, &len, data + header_size,
+            (int)(size - header_size)) == 1 &&
+        EVP_CipherFinal_ex(rtp_cipher_, data + size, &len) == 1 &&
+        EVP_CIPHER_CTX_ctrl(rtp_cipher_, EVP_CTRL_GCM_GET_TAG, kGcmTagLength, data + size) == 1;
+}
+
+// 不做重放检测：推流端只接收服务端的RTCP反馈
+bool SrtpSession::UnprotectRtp(uint8_t* data, size_t* size) {
+    size_t tag_size = trailer_size();
+    if (profile_ == SrtpProfile::kNone || *size < kRtpHeaderSize + tag_size) {
+        return false;
+    }
+    size_t rtp_size = *size - tag_size;
+    size_t header_size = RtpHeaderSize(data, rtp_size);
+    if (header_size == 0) {
+        return false;
+    }
+
+    uint16_t seq = GetBE16(data + 2);
+    uint32_t ssrc = GetBE32(data + 8);
+    StreamState& stream = streams_[ssrc];
+    uint32_t roc = stream.has_seq ? GuessRoc(stream.roc, stream.last_seq, seq) : 0;
+    int len = 0;
+    bool ok = false;
+    if (profile_ == SrtpProfile::kAeadAes128Gcm) {
+        uint8_t iv[kGcmSaltLength];
+        memcpy(iv, rtp_salt_, kGcmSaltLength);
+        XorBE(iv + 2, ssrc, 4);
+        XorBE(iv + 6, roc, 4);
+        XorBE(iv + 10, seq, 2);
+        ok = EVP_CipherInit_ex(rtp_cipher_, nullptr, nullptr, nullptr, iv, 0) == 1 &&
+            EVP_CipherUpdate(rtp_cipher_, nullptr, &len, data, (int)header_size) == 1 &&
+            EVP_CipherUpdate(rtp_cipher_, data + header_size, &len, data + header_size,
+                (int)(rtp_size - header_size)) == 1 &&
+            EVP_CIPHER_CTX_ctrl(rtp_cipher_, EVP_CTRL_GCM_SET_TAG, kGcmTagLength,
+                data + rtp_size) == 1 &&
+            EVP_CipherFinal_ex(rtp_cipher_, data + rtp_size, &len) == 1;
+    } else {
+        uint8_t roc_bytes[4];
+        uint8_t tag[kHmacTagLength];
+        SetBE32(roc_bytes, roc);
+        ok = ComputeHmac(rtp_hmac_inner_, rtp_hmac_outer_, data, rtp_size, roc_bytes,
+            sizeof(roc_bytes), tag) && memcmp(tag, data + rtp_size, kHmacTagLength) == 0;
+        if (ok) {
+            uint8_t iv[16] = { 0 };
+            memcpy(iv, rtp_salt_, kCmSaltLength);
+            XorBE(iv + 4, ssrc, 4);
+            XorBE(iv + 8, ((uint64_t)roc << 16) | seq, 6);
+            ok = EVP_CipherInit_ex(rtp_cipher_, nullptr, nullptr, nullptr, iv, 0) == 1 &&
+                EVP_CipherUpdate(rtp_cipher_, data + header_size, &len, data + header_size,
+                    (int)(rtp_size - header_size)) == 1;
+        }
+    }
+
+    if (!ok) {
+        ++auth_failures_;
+        return false;
+    }
+
+    if (!stream.has_seq || roc > stream.roc || (roc == stream.roc && seq > stream.last_seq)) {
+        stream.roc = roc;
+        stream.last_seq = seq;
+        stream.has_seq = true;
+    }
+    *size = rtp_size;
+    return true;
+}
+
+uint32_t SrtpSession::NextRtcpIndex(uint32_t ssrc) {
+    uint32_t& index = rtcp_index_[ssrc];
+    uint32_t current = index;
+    index = (index + 1) & ~kSrtcpEncryptedFlag;
+    return current;
+}
+
+// SRTCP(RFC 3711 3.4)：前8字节不加密，包尾是E标志和31位的index，CM时最后是认证标签；
+// GCM(RFC 7714 9)时认证标签在index之前
+bool SrtpSession::ProtectRtcp(uint8_t* data, size_t* size, size_t capacity) {
+    bool gcm = profile_ == SrtpProfile::kAeadAes128Gcm;
+    size_t trailer = kSrtcpIndexLength + (gcm ? kGcmTagLength : kHmacTagLength);
+    if (profile_ == SrtpProfile::kNone || *size < kRtcpHeaderSize ||
+        *size + trailer > capacity)
+    {
+        return false;
+    }
+
+    uint32_t ssrc = GetBE32(data + 4);
+    uint32_t index = NextRtcpIndex(ssrc);
+    uint8_t e_index[kSrtcpIndexLength];
+    SetBE32(e_index, kSrtcpEncryptedFlag | index);
+    int len = 0;
+    bool ok = false;
+    if (gcm) {
+        uint8_t iv[kGcmSaltLength];
+        memcpy(iv, rtcp_salt_, kGcmSaltLength);
+        XorBE(iv + 2, ssrc, 4);
+        XorBE(iv + 8, index, 4);
+        uint8_t* tag = data + *size;
+        ok = EVP_CipherInit_ex(rtcp_cipher_, nullptr, nullptr, nullptr, iv, 1) == 1 &&
+            EVP_CipherUpdate(rtcp_cipher_, nullptr, &len, data, kRtcpHeaderSize) == 1 &&
+            EVP_CipherUpdate(rtcp_cipher_, nullptr, &len, e_index, sizeof(e_index)) == 1 &&
+            EVP_CipherUpdate(rtcp_cipher_, data + kRtcpHeaderSize, &len, data + kRtcpHeaderSize,
+                (int)(*size - kRtcpHeaderSize)) == 1 &&
+            EVP_CipherFinal_ex(rtcp_cipher_, tag, &len) == 1 &&
+            EVP_CIPHER_CTX_ctrl(rtcp_cipher_, EVP_CTRL_GCM_GET_TAG, kGcmTagLength, tag) == 1;
+        memcpy(tag + kGcmTagLength, e_index, sizeof(e_index));
+    } else {
+        uint8_t iv[16] = { 0 };
+        memcpy(iv, rtcp_salt_, kCmSaltLength);
+        XorBE(iv + 4, ssrc, 4);
+        XorBE(iv + 10, index, 4);
+        memcpy(data + *size, e_index, sizeof(e_index));
+        ok = EVP_CipherInit_ex(rtcp_cipher_, nullptr, nullptr, nullptr, iv, 1) == 1 &&
+            EVP_CipherUpdate(rtcp_cipher_, data + kRtcpHeaderSize, &len, data + kRtcpHeaderSize,
+                (int)(*size - kRtcpHeaderSize)) == 1 &&
+            ComputeHmac(rtcp_hmac_inner_, rtcp_hmac_outer_, data, *size + kSrtcpIndexLength,
+                nullptr, 0, data + *size + kSrtcpIndexLength);
+    }
+
+    if (ok) {
+        *size += trailer;
+    }
+    return ok;
+}
+
+bool SrtpSession::UnprotectRtcp(uint8_t* data, size_t* size) {
+    bool gcm = profile_ == SrtpProfile::kAeadAes128Gcm;
+    size_t tag_size = gcm ? kGcmTagLength : kHmacTagLength;
+    if (profile_ == SrtpProfile::kNone ||
+        *size < kRtcpHeaderSize + kSrtcpIndexLength + tag_size)
+    {
+        return false;
+    }
+
+    size_t rtcp_size = *size - kSrtcpIndexLength - tag_size;
+    const uint8_t* e_index = gcm ? data + *size - kSrtcpIndexLength : data + rtcp_size;
+    const uint8_t* tag = gcm ? data + rtcp_size : data + rtcp_size + kSrtcpIndexLength;
+    uint32_t value = GetBE32(e_index);
+    bool encrypted = (value & kSrtcpEncryptedFlag) != 0;
+    uint32_t index = value & ~kSrtcpEncryptedFlag;
+    uint32_t ssrc = GetBE32(data + 4);
+    int len = 0;
+    bool ok = false;
+    if (gcm) {
+        uint8_t iv[kGcmSaltLength];
+        memcpy(iv, rtcp_salt_, kGcmSaltLength);
+        XorBE(iv + 2, ssrc, 4);
+        XorBE(iv + 8, index, 4);
+        // 没有加密时整个包都是AAD
+        size_t aad_size = encrypted ? kRtcpHeaderSize : rtcp_size;
+        uint8_t tag_copy[kGcmTagLength];
+        memcpy(tag_copy, tag, kGcmTagLength);
+        ok = EVP_CipherInit_ex(rtcp_cipher_, nullptr, nullptr, nullptr, iv, 0) == 1 &&
+            EVP_CipherUpdate(rtcp_cipher_, nullptr, &len, data, (int)aad_size) == 1 &&
+            EVP_CipherUpdate(rtcp_cipher_, nullptr, &len, e_index, kSrtcpIndexLength) == 1 &&
+            (!encrypted || EVP_CipherUpdate(rtcp_cipher_, data + kRtcpHeaderSize, &len,
+                data + kRtcpHeaderSize, (int)(rtcp_size - kRtcpHeaderSize)) == 1) &&
+            EVP_CIPHER_CTX_ctrl(rtcp_cipher_, EVP_CTRL_GCM_SET_TAG, kGcmTagLength,
+                tag_copy) == 1 &&
+            EVP_CipherFinal_ex(rtcp_cipher_, tag_copy, &len) == 1;
+    } else {
+        uint8_t expected[kHmacTagLength];
+        ok = ComputeHmac(rtcp_hmac_inner_, rtcp_hmac_outer_, data,
+            rtcp_size + kSrtcpIndexLength, nullptr, 0, expected) &&
+            memcmp(expected, tag, kHmacTagLength) == 0;
+        if (ok && encrypted) {
+            uint8_t iv[16] = { 0 };
+            memcpy(iv, rtcp_salt_, kCmSaltLength);
+            XorBE(iv + 4, ssrc, 4);
+            XorBE(iv + 10, index, 4);
+            ok = EVP_CipherInit_ex(rtcp_cipher_, nullptr, nullptr, nullptr, iv, 0) == 1 &&
+                EVP_CipherUpdate(rtcp_cipher_, data + kRtcpHeaderSize, &len,
+                    data + kRtcpHeaderSize, (int)(rtcp_size - kRtcpHeaderSize)) == 1;
+        }
+    }
+
+    if (!ok) {
+        ++auth_failures_;
+        return false;
+    }
+    *size = rtcp_size;
+    return true;
+}
+
+} // namespace xrtc
@@ -0,0 +1,97 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_SRTP_SESSION_H_
+#define XRTCSDK_XRTC_RTC_SRTP_SESSION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+
+namespace xrtc {
+
+struct RtpPacketBatch;
+
+enum class SrtpProfile {
+    kNone,
+    kAes128CmSha1_80,//SRTP_AES128_CM_SHA1_80(RFC 3711/5764)
+    kAeadAes128Gcm,//SRTP_AEAD_AES_128_GCM(RFC 7714)
+};
+
+// 一个方向的SRTP/SRTCP上下文(RFC 3711)，主密钥来自DTLS-SRTP导出
+// 会话密钥在Init时派生一次，AES和HMAC的密钥扩展也只做一次，之后每个包只设置IV：
+// AES-GCM和AES-CTR走OpenSSL的EVP，CPU支持时自动使用AES-NI/PCLMULQDQ；HMAC-SHA1预先吸收ipad/opad，
+// 每个包只做内外两次摘要。加解密都在原缓冲中进行，包尾需要预留trailer_size()字节
+// 不是线程安全的，发送和接收各用一个实例
+class SrtpSession {
+public:
+    static const size_t kMaxTrailerSize = 20;//SRTCP: GCM标签16字节 + E/index 4字节
+
+    SrtpSession();
+    ~SrtpSession();
+
+    static const char* ProfileName(SrtpProfile profile);
+    static SrtpProfile ProfileFromName(const std::string& name);
+    // DTLS导出的主密钥和主盐长度
+    static size_t KeyLength(SrtpProfile profile);
+    static size_t SaltLength(SrtpProfile profile);
+
+    bool Init(SrtpProfile profile, const uint8_t* key, const uint8_t* salt);
+    SrtpProfile profile() const { return profile_; }
+    // SRTP包尾增加的字节数(认证标签)
+    size_t trailer_size() const;
+
+    // 原地加密，size为RTP包的长度，capacity为缓冲中可用的长度，成功后size为SRTP包的长度
+    bool ProtectRtp(uint8_t* data, size_t* size, size_t capacity);
+    // 一帧打包出的所有包一起加密，包尾使用批次预留的空间
+    bool ProtectRtp(RtpPacketBatch* batch);
+    // 原地校验和解密，成功后size为RTP包的长度
+    bool UnprotectRtp(uint8_t* data, size_t* size);
+    bool ProtectRtcp(uint8_t* data, size_t* size, size_t capacity);
+    bool UnprotectRtcp(uint8_t* data, size_t* size);
+
+    int64_t auth_failures() const { return auth_failures_; }
+
+private:
+    struct StreamState {
+        uint32_t roc = 0;//rollover counter
+        uint16_t last_seq = 0;
+        bool has_seq = false;
+    };
+
+    // RFC 3711 4.3，kdr为0
+    bool DeriveKey(uint8_t label, uint8_t* out, size_t size);
+    bool InitHmac(const uint8_t* key, size_t size, EVP_MD_CTX* inner, EVP_MD_CTX* outer);
+    // HMAC-SHA1截断为10字节，第二段数据用于RTP的ROC
+    bool ComputeHmac(EVP_MD_CTX* inner, EVP_MD_CTX* outer, const uint8_t* data, size_t size,
+        const uint8_t* extra, size_t extra_size, uint8_t* tag);
+    bool ProtectRtpCm(uint8_t* data, size_t size, size_t header_size, uint32_t ssrc,
+        uint64_t index);
+    bool ProtectRtpGcm(uint8_t* data, size_t size, size_t header_size, uint32_t ssrc,
+        uint32_t roc, uint16_t seq);
+    uint32_t NextRtcpIndex(uint32_t ssrc);
+
+private:
+    SrtpProfile profile_ = SrtpProfile::kNone;
+    std::vector<uint8_t> master_key_;
+    std::vector<uint8_t> master_salt_;
+    uint8_t rtp_salt_[14] = { 0 };
+    uint8_t rtcp_salt_[14] = { 0 };
+    EVP_CIPHER_CTX* rtp_cipher_ = nullptr;
+    EVP_CIPHER_CTX* rtcp_cipher_ = nullptr;
+    EVP_MD_CTX* rtp_hmac_inner_ = nullptr;
+    EVP_MD_CTX* rtp_hmac_outer_ = nullptr;
+    EVP_MD_CTX* rtcp_hmac_inner_ = nullptr;
+    EVP_MD_CTX* rtcp_hmac_outer_ = nullptr;
+    EVP_MD_CTX* hmac_work_ = nullptr;
+    std::map<uint32_t, StreamState> streams_;
+    std::map<uint32_t, uint32_t> rtcp_index_;
+    int64_t auth_failures_ = 0;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_SRTP_SESSION_H_
@@ -0,0 +1,326 @@
+﻿#include "xrtc/rtc/stun_message.h"
+
+#include <string.h>
+
+#include <rtc_base/crc32.h>
+#include <rtc_base/helpers.h>
+#include <rtc_base/message_digest.h>
+
+namespace xrtc {
+
+namespace {
+
+const size_t kAttributeHeaderSize = 4;
+const size_t kMessageIntegritySize = 20;//HMAC-SHA1
+const size_t kFingerprintSize = 4;
+const uint32_t kFingerprintXor = 0x5354554E;
+const uint8_t kAddressFamilyIPv4 = 0x01;
+const uint8_t kAddressFamilyIPv6 = 0x02;
+
+uint16_t GetBE16(const uint8_t* data) {
+    return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+uint32_t GetBE32(const uint8_t* data) {
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+        ((uint32_t)data[2] << 8) | data[3];
+}
+
+void SetBE16(uint8_t* data, uint16_t value) {
+    data[0] = (uint8_t)(value >> 8);
+    data[1] = (uint8_t)value;
+}
+
+void AppendBE16(std::string* out, uint16_t value) {
+    out->push_back((char)(value >> 8));
+    out->push_back((char)value);
+}
+
+void AppendBE32(std::string* out, uint32_t value) {
+    AppendBE16(out, (uint16_t)(value >> 16));
+    AppendBE16(out, (uint16_t)value);
+}
+
+void AppendAttribute(std::vector<uint8_t>* out, uint16_t type, const uint8_t* value, size_t size) {
+    uint8_t header[kAttributeHeaderSize];
+    SetBE16(header, type);
+    SetBE16(header + 2, (uint16_t)size);
+    out->insert(out->end(), header, header + kAttributeHeaderSize);
+    out->insert(out->end(), value, value + size);
+    // 属性按4字节对齐，填充不计入属性长度
+    out->resize(out->size() + ((4 - size % 4) % 4), 0);
+}
+
+// 消息长度字段不含20字节的头
+void SetMessageLength(std::vector<uint8_t>* out, size_t length) {
+    SetBE16(out->data() + 2, (uint16_t)length);
+}
+
+// 找到MESSAGE-INTEGRITY属性的偏移，没有返回0
+size_t FindMessageIntegrity(const uint8_t* data, size_t size) {
+    size_t offset = StunMessage::kHeaderSize;
+    while (offset + kAttributeHeaderSize <= size) {
+        uint16_t type = GetBE16(data + offset);
+        uint16_t length = GetBE16(data + offset + 2);
+        if (type == kStunAttrMessageIntegrity) {
+            return length == kMessageIntegritySize &&
+                offset + kAttributeHeaderSize + length <= size ? offset : 0;
+        }
+        offset += kAttributeHeaderSize + ((length + 3) & ~3);
+    }
+    return 0;
+}
+
+} // namespace
+
+StunMessage::StunMessage(uint16_t type) :
+    type_(type),
+    transaction_id_(rtc::CreateRandomString(kTransactionIdSize))
+{
+}
+
+bool StunMessage::IsStunPacket(const uint8_t* data, size_t size) {
+    return size >= kHeaderSize && (data[0] & 0xC0) == 0 && GetBE32(data + 4) == kMagicCookie;
+}
+
+std::unique_ptr<StunMessage> StunMessage::Parse(const uint8_t* data, size_t size) {
+    if (!IsStunPacket(data, size)) {
+        return nullptr;
+    }
+
+    size_t length = GetBE16(data + 2);
+    if (length % 4 != 0 || kHeaderSize + length != size) {
+        return nullptr;
+    }
+
+    auto message = std::make_unique<StunMessage>(GetBE16(data));
+    message->transaction_id_.assign((const char*)data + 8, kTransactionIdSize);
+
+    bool after_integrity = false;
+    size_t offset = kHeaderSize;
+    while (offset + kAttributeHeaderSize <= size) {
+        uint16_t type = GetBE16(data + offset);
+        uint16_t attr_length = GetBE16(data + offset + 2);
+        size_t value_offset = offset + kAttributeHeaderSize;
+        if (value_offset + attr_length > size) {
+            return nullptr;
+        }
+
+        if (type == kStunAttrFingerprint) {
+            // FINGERPRINT必须是最后一个属性，覆盖它之前的所有字节
+            if (attr_length != kFingerprintSize || value_offset + attr_length != size) {
+                return nullptr;
+            }
+            uint32_t crc = rtc::ComputeCrc32(data, offset) ^ kFingerprintXor;
+            if (crc != GetBE32(data + value_offset)) {
+                return nullptr;
+            }
+        }
+        else if (!after_integrity) {
+            message->attributes_.emplace_back(type,
+                std::string((const char*)data + value_offset, attr_length));
+            after_integrity = type == kStunAttrMessageIntegrity;
+        }
+        offset = value_offset + ((attr_length + 3) & ~3);
+    }
+    return message;
+}
+
+bool StunMessage::ValidateMessageIntegrity(const uint8_t* data, size_t size,
+    const std::string& password)
+{
+    size_t offset = FindMessageIntegrity(data, size);
+    if (offset == 0) {
+        return false;
+    }
+
+    // HMAC覆盖MESSAGE-INTEGRITY之前的字节，长度字段按到MESSAGE-INTEGRITY为止计算
+    std::vector<uint8_t> buffer(data, data + offset);
+    SetMessageLength(&buffer, offset + kAttributeHeaderSize + kMessageIntegritySize - kHeaderSize);
+    uint8_t hmac[kMessageIntegritySize];
+    size_t hmac_size = rtc::ComputeHmac(rtc::DIGEST_SHA_1, password.data(), password.size(),
+        buffer.data(), buffer.size(), hmac, sizeof(hmac));
+    return hmac_size == kMessageIntegritySize &&
+        memcmp(hmac, data + offset + kAttributeHeaderSize, kMessageIntegritySize) == 0;
+}
+
+void StunMessage::AddUsername(const std::string& username) {
+    AddAttribute(kStunAttrUsername, username);
+}
+
+void StunMessage::AddPriority(uint32_t priority) {
+    std::string value;
+    AppendBE32(&value, priority);
+    AddAttribute(kStunAttrPriority, value);
+}
+
+void StunMessage::AddUseCandidate() {
+    AddAttribute(kStunAttrUseCandidate, std::string());
+}
+
+void StunMessage::AddIceControlling(uint64_t tie_breaker) {
+    std::string value;
+    AppendBE32(&value, (uint32_t)(tie_breaker >> 32));
+    AppendBE32(&value, (uint32_t)tie_breaker);
+    AddAttribute(kStunAttrIceControlling, value);
+}
+
+void StunMessage::AddIceControlled(uint64_t tie_breaker) {
+    std::string value;
+    AppendBE32(&value, (uint32_t)(tie_breaker >> 32));
+    AppendBE32(&value, (uint32_t)tie_breaker);
+    AddAttribute(kStunAttrIceControlled, value);
+}
+
+// 端口和IPv4地址与magic cookie异或，IPv6地址与magic cookie加transaction id异或
+void StunMessage::AddXorMappedAddress(const rtc::SocketAddress& address) {
+    std::string value;
+    bool ipv6 = address.family() == AF_INET6;
+    value.push_back(0);
+    value.push_back((char)(ipv6 ? kAddressFamilyIPv6 : kAddressFamilyIPv4));
+    AppendBE16(&value, (uint16_t)(address.port() ^ (kMagicCookie >> 16)));
+
+    uint8_t mask[16];
+    std::string cookie;
+    AppendBE32(&cookie, kMagicCookie);
+    memcpy(mask, cookie.data(), 4);
+    memcpy(mask + 4, transaction_id_.data(), kTransactionIdSize);
+    if (ipv6) {
+        in6_addr ip = address.ipaddr().ipv6_address();
+        const uint8_t* bytes = (const uint8_t*)&ip;
+        for (int i = 0; i < 16; ++i) {
+            value.push_back((char)(bytes[i] ^ mask[i]));
+        }
+    }
+    else {
+        in_addr ip = address.ipaddr().ipv4_address();
+        const uint8_t* bytes = (const uint8_t*)&ip;
+        for (int i = 0; i < 4; ++i) {
+            value.push_back((char)(bytes[i] ^ mask[i]));
+        }
+    }
+    AddAttribute(kStunAttrXorMappedAddress, value);
+}
+
+void StunMessage::AddErrorCode(int code, const std::string& reason) {
+    std::string value;
+    value.push_back(0);
+    value.push_back(0);
+    value.push_back((char)(code / 100));
+    value.push_back((char)(code % 100));
+    value += reason;
+    AddAttribute(kStunAttrErrorCode, value);
+}
+
+bool StunMessage::GetUsername(std::string* username) const {
+    const std::string* value = FindAttribute(kStunAttrUsername);
+    if (!value) {
+        return false;
+    }
+    *username = *value;
+    return true;
+}
+
+bool StunMessage::GetPriority(uint32_t* priority) const {
+    const std::string* value = FindAttribute(kStunAttrPriority);
+    if (!value || value->size() != 4) {
+        return false;
+    }
+    *priority = GetBE32((const uint8_t*)value->data());
+    return true;
+}
+
+bool StunMessage::GetXorMappedAddress(rtc::SocketAddress* address) const {
+    const std::string* value = FindAttribute(kStunAttrXorMappedAddress);
+    if (!value || value->size() < 8) {
+        return false;
+    }
+
+    const uint8_t* data = (const uint8_t*)value->data();
+    uint8_t mask[16];
+    std::string cookie;
+    AppendBE32(&cookie, kMagicCookie);
+    memcpy(mask, cookie.data(), 4);
+    memcpy(mask + 4, transaction_id_.data(), kTransactionIdSize);
+
+    int port = GetBE16(data + 2) ^ (kMagicCookie >> 16);
+    if (data[1] == kAddressFamilyIPv4) {
+        in_addr ip;
+        uint8_t* bytes = (uint8_t*)&ip;
+        for (int i = 0; i < 4; ++i) {
+            bytes[i] = data[4 + i] ^ mask[i];
+        }
+        *address = rtc::SocketAddress(rtc::IPAddress(ip), port);
+        return true;
+    }
+
+    if (data[1] == kAddressFamilyIPv6 && value->size() >= 20) {
+        in6_addr ip;
+        uint8_t* bytes = (uint8_t*)&ip;
+        for (int i = 0; i < 16; ++i) {
+            bytes[i] = data[4 + i] ^ mask[i];
+        }
+        *address = rtc::SocketAddress(rtc::IPAddress(ip), port);
+        return true;
+    }
+    return false;
+}
+
+int StunMessage::GetErrorCode() const {
+    const std::string* value = FindAttribute(kStunAttrErrorCode);
+    if (!value || value->size() < 4) {
+        return 0;
+    }
+    return ((*value)[2] & 0x7) * 100 + (uint8_t)(*value)[3];
+}
+
+void StunMessage::Write(const std::string& password, std::vector<uint8_t>* out) const {
+    out->clear();
+    out->resize(kHeaderSize);
+    SetBE16(out->data(), type_);
+    uint8_t* header = out->data();
+    header[4] = (uint8_t)(kMagicCookie >> 24);
+    header[5] = (uint8_t)(kMagicCookie >> 16);
+    header[6] = (uint8_t)(kMagicCookie >> 8);
+    header[7] = (uint8_t)kMagicCookie;
+    memcpy(header + 8, transaction_id_.data(), kTransactionIdSize);
+
+    for (const auto& attribute : attributes_) {
+        if (attribute.first == kStunAttrMessageIntegrity) {
+            continue;
+        }
+        AppendAttribute(out, attribute.first, (const uint8_t*)attribute.second.data(),
+            attribute.second.size());
+    }
+
+    if (!password.empty()) {
+        SetMessageLength(out, out->size() + kAttributeHeaderSize + kMessageIntegritySize -
+            kHeaderSize);
+        uint8_t hmac[kMessageIntegritySize] = { 0 };
+        rtc::ComputeHmac(rtc::DIGEST_SHA_1, password.data(), password.size(),
+            out->data(), out->size(), hmac, sizeof(hmac));
+        AppendAttribute(out, kStunAttrMessageIntegrity, hmac, sizeof(hmac));
+    }
+
+    SetMessageLength(out, out->size() + kAttributeHeaderSize + kFingerprintSize - kHeaderSize);
+    uint32_t crc = rtc::ComputeCrc32(out->data(), out->size()) ^ kFingerprintXor;
+    uint8_t fingerprint[kFingerprintSize] = {
+        (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc
+    };
+    AppendAttribute(out, kStunAttrFingerprint, fingerprint, sizeof(fingerprint));
+}
+
+const std::string* StunMessage::FindAttribute(uint16_t type) const {
+    for (const auto& attribute : attributes_) {
+        if (attribute.first == type) {
+            return &attribute.second;
+        }
+    }
+    return nullptr;
+}
+
+void StunMessage::AddAttribute(uint16_t type, std::string value) {
+    attributes_.emplace_back(type, std::move(value));
+}
+
+} // namespace xrtc
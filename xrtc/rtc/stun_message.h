@@ -0,0 +1,86 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_STUN_MESSAGE_H_
+#define XRTCSDK_XRTC_RTC_STUN_MESSAGE_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <rtc_base/socket_address.h>
+
+namespace xrtc {
+
+enum StunMessageType : uint16_t {
+    kStunBindingRequest = 0x0001,
+    kStunBindingIndication = 0x0011,
+    kStunBindingResponse = 0x0101,
+    kStunBindingErrorResponse = 0x0111,
+};
+
+enum StunAttributeType : uint16_t {
+    kStunAttrMappedAddress = 0x0001,
+    kStunAttrUsername = 0x0006,
+    kStunAttrMessageIntegrity = 0x0008,
+    kStunAttrErrorCode = 0x0009,
+    kStunAttrXorMappedAddress = 0x0020,
+    kStunAttrPriority = 0x0024,
+    kStunAttrUseCandidate = 0x0025,
+    kStunAttrFingerprint = 0x8028,
+    kStunAttrIceControlled = 0x8029,
+    kStunAttrIceControlling = 0x802A,
+};
+
+// STUN消息(RFC 5389)，只实现ICE连通性检查和srflx收集用到的Binding消息和属性
+class StunMessage {
+public:
+    static const size_t kHeaderSize = 20;
+    static const size_t kTransactionIdSize = 12;
+    static const uint32_t kMagicCookie = 0x2112A442;
+
+    // 新的请求生成随机的transaction id，回复用set_transaction_id拷贝请求的
+    explicit StunMessage(uint16_t type);
+
+    // 快速区分STUN和RTP/RTCP：前两位为0、magic cookie正确
+    static bool IsStunPacket(const uint8_t* data, size_t size);
+    // 解析并校验长度和FINGERPRINT，MESSAGE-INTEGRITY之后的属性(FINGERPRINT除外)忽略
+    static std::unique_ptr<StunMessage> Parse(const uint8_t* data, size_t size);
+    // 用短期凭证(ICE的pwd)校验MESSAGE-INTEGRITY，data是收到的原始消息
+    static bool ValidateMessageIntegrity(const uint8_t* data, size_t size,
+        const std::string& password);
+
+    uint16_t type() const { return type_; }
+    const std::string& transaction_id() const { return transaction_id_; }
+    void set_transaction_id(const std::string& transaction_id) { transaction_id_ = transaction_id; }
+
+    void AddUsername(const std::string& username);
+    void AddPriority(uint32_t priority);
+    void AddUseCandidate();
+    void AddIceControlling(uint64_t tie_breaker);
+    void AddIceControlled(uint64_t tie_breaker);
+    void AddXorMappedAddress(const rtc::SocketAddress& address);
+    void AddErrorCode(int code, const std::string& reason);
+
+    bool HasAttribute(uint16_t type) const { return FindAttribute(type) != nullptr; }
+    bool GetUsername(std::string* username) const;
+    bool GetPriority(uint32_t* priority) const;
+    bool GetXorMappedAddress(rtc::SocketAddress* address) const;
+    int GetErrorCode() const;//没有ERROR-CODE返回0
+
+    // password非空时加MESSAGE-INTEGRITY，最后总是加FINGERPRINT
+    void Write(const std::string& password, std::vector<uint8_t>* out) const;
+
+private:
+    const std::string* FindAttribute(uint16_t type) const;
+    void AddAttribute(uint16_t type, std::string value);
+
+private:
+    uint16_t type_;
+    std::string transaction_id_;
+    std::vector<std::pair<uint16_t, std::string>> attributes_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_STUN_MESSAGE_H_
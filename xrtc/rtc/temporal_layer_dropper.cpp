@@ -0,0 +1,60 @@
+﻿#include "xrtc/rtc/temporal_layer_dropper.h"
+
+#include <algorithm>
+
+namespace xrtc {
+
+void TemporalLayerDropper::SetTargetBitrate(int bitrate_bps) {
+    target_bitrate_bps_ = std::max(0, bitrate_bps);
+}
+
+bool TemporalLayerDropper::OnFrame(const RtpFrameLayer& layer, size_t bytes, int64_t now_ms) {
+    int tid = std::min<int>(layer.temporal_id, kMaxTemporalLayers - 1);
+    int bitrate_bps = target_bitrate_bps_.load(std::memory_order_relaxed);
+    if (bitrate_bps <= 0) {
+        sent_[tid].Add();
+        return true;
+    }
+
+    double max_budget = (double)bitrate_bps / 8 * kMaxBudgetMs / 1000;
+    if (last_frame_ms_ < 0) {
+        budget_bytes_ = max_budget;
+    }
+    else {
+        budget_bytes_ = std::min(max_budget,
+            budget_bytes_ + (double)bitrate_bps / 8 * (now_ms - last_frame_ms_) / 1000);
+    }
+    last_frame_ms_ = now_ms;
+
+    if (drop_above_ >= 0 && tid <= drop_above_) {
+        drop_above_ = -1;
+    }
+
+    bool send = tid == 0 || (drop_above_ < 0 && budget_bytes_ >= (double)bytes);
+    if (!send) {
+        if (!layer.discardable && drop_above_ < 0) {
+            drop_above_ = tid;
+        }
+        dropped_[tid].Add();
+        return false;
+    }
+
+    // TL0的欠账最多记一个桶的深度，否则一串大关键帧之后高层要饿很久才能恢复
+    budget_bytes_ = std::max(-max_budget, budget_bytes_ - (double)bytes);
+    sent_[tid].Add();
+    return true;
+}
+
+void TemporalLayerDropper::GetStats(JsonObject& stats) {
+    stats["target_kbps"] = target_bitrate_bps_.load() / 1000;
+    JsonArray jsent;
+    JsonArray jdropped;
+    for (int i = 0; i < kMaxTemporalLayers; ++i) {
+        jsent.Append(sent_[i].count());
+        jdropped.Append(dropped_[i].count());
+    }
+    stats["layer_frames_sent"] = jsent;
+    stats["layer_frames_dropped"] = jdropped;
+}
+
+} // namespace xrtc
@@ -0,0 +1,45 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_TEMPORAL_LAYER_DROPPER_H_
+#define XRTCSDK_XRTC_RTC_TEMPORAL_LAYER_DROPPER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "xrtc/base/xrtc_json.h"
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/rtc/rtp_packetizer.h"
+
+namespace xrtc {
+
+// 发送端按时域层丢帧：带宽估计降低目标码率之后，编码器的码率控制要几百毫秒到一秒才跟上，
+// 这段时间按目标码率的令牌桶发送，超出预算时立即丢高层的帧，基础层的帧率和画面不中断：
+// - 预算按目标码率累积，最多累积kMaxBudgetMs，允许关键帧这样的短时突发
+// - TL0的帧总是发送，预算可以为负(最低到-kMaxBudgetMs的量)，之后由高层的帧让出
+// - TLk(k>0)的帧只在预算足够时发送
+// - 丢掉被参考的TLk帧之后，更高层的帧也丢掉，直到下一个层号<=k的帧
+// 没有设置目标码率时不丢帧。只在network_thread上使用，统计可以在任意线程读取
+class TemporalLayerDropper {
+public:
+    static const int kMaxTemporalLayers = 3;
+    static const int64_t kMaxBudgetMs = 100;
+
+    void SetTargetBitrate(int bitrate_bps);
+    // 返回false表示丢弃这一帧
+    bool OnFrame(const RtpFrameLayer& layer, size_t bytes, int64_t now_ms);
+
+    void GetStats(JsonObject& stats);
+
+private:
+    std::atomic<int> target_bitrate_bps_{ 0 };
+    double budget_bytes_ = 0;
+    int64_t last_frame_ms_ = -1;
+    int drop_above_ = -1;//大于这一层的帧依赖已经丢掉的帧，-1表示没有
+
+    StatsCounter sent_[kMaxTemporalLayers];
+    StatsCounter dropped_[kMaxTemporalLayers];
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_TEMPORAL_LAYER_DROPPER_H_
@@ -0,0 +1,87 @@
+﻿#include "xrtc/rtc/udp_transport.h"
+
+#include <rtc_base/async_udp_socket.h>
+#include <rtc_base/ip_address.h>
+#include <rtc_base/logging.h>
+
+#include "xrtc/rtc/rtp_packetizer.h"
+
+namespace xrtc {
+
+namespace {
+
+// 关键帧一次发出几十个包，系统默认的发送缓冲容易溢出
+const int kSendBufferSize = 1024 * 1024;
+
+} // namespace
+
+UdpTransport::UdpTransport(rtc::Thread* network_thread) :
+    network_thread_(network_thread)
+{
+}
+
+UdpTransport::~UdpTransport() {
+    Close();
+}
+
+bool UdpTransport::Open(const rtc::SocketAddress& remote_address) {
+    if (socket_) {
+        return true;
+    }
+
+    rtc::SocketAddress local_address(rtc::GetAnyIP(remote_address.family()), 0);
+    socket_.reset(rtc::AsyncUDPSocket::Create(network_thread_->socketserver(), local_address));
+    if (!socket_) {
+        RTC_LOG(LS_WARNING) << "UdpTransport create socket failed, remote: "
+            << remote_address.ToString();
+        return false;
+    }
+
+    if (socket_->SetOption(rtc::Socket::OPT_SNDBUF, kSendBufferSize) < 0) {
+        RTC_LOG(LS_WARNING) << "UdpTransport set send buffer failed, error: "
+            << socket_->GetError();
+    }
+
+    remote_address_ = remote_address;
+    RTC_LOG(LS_INFO) << "UdpTransport open, local: " << socket_->GetLocalAddress().ToString()
+        << ", remote: " << remote_address_.ToString();
+    return true;
+}
+
+rtc::SocketAddress UdpTransport::local_address() const {
+    return socket_ ? socket_->GetLocalAddress() : rtc::SocketAddress();
+}
+
+void UdpTransport::Close() {
+    if (!socket_) {
+        return;
+    }
+
+    RTC_LOG(LS_INFO) << "UdpTransport close, packets: " << packets_sent_.count()
+        << ", bytes: " << bytes_sent_.count() << ", errors: " << send_errors_.count();
+    socket_.reset();
+}
+
+bool UdpTransport::SendBatch(RtpPacketBatch& batch) {
+    if (!socket_) {
+        return false;
+    }
+
+    rtc::PacketOptions options;
+    bool ok = true;
+    for (size_t i = 0; i < batch.packet_count(); ++i) {
+        int sent = socket_->SendTo(batch.packet_data(i), batch.packet_size(i),
+            remote_address_, options);
+        if (sent < 0) {
+            send_errors_.Add();
+            ok = false;
+            continue;
+        }
+
+        packets_sent_.Add();
+        bytes_sent_.Add(sent);
+    }
+    return ok;
+}
+
+} // namespace xrtc
@@ -0,0 +1,45 @@
+﻿#ifndef XRTCSDK_XRTC_RTC_UDP_TRANSPORT_H_
+#define XRTCSDK_XRTC_RTC_UDP_TRANSPORT_H_
+
+#include <memory>
+
+#include <rtc_base/async_packet_socket.h>
+#include <rtc_base/socket_address.h>
+#include <rtc_base/thread.h>
+
+#include "xrtc/base/xrtc_stats.h"
+#include "xrtc/rtc/rtp_transport.h"
+
+namespace xrtc {
+
+// 直连的UDP传输：RTP直接发到固定的远端地址，不经过信令和ICE，用于本机回环和内网压测
+// 创建、发送、关闭都只在network_thread上进行，统计可以在任意线程读取
+class UdpTransport : public RtpTransport {
+public:
+    explicit UdpTransport(rtc::Thread* network_thread);
+    ~UdpTransport() override;
+
+    bool Open(const rtc::SocketAddress& remote_address);
+    void Close();
+    // 逐包发送，发送缓冲满时丢包并计数，不阻塞网络线程
+    bool SendBatch(RtpPacketBatch& batch) override;
+
+    const rtc::SocketAddress& remote_address() const { return remote_address_; }
+    rtc::SocketAddress local_address() const;
+    int64_t packets_sent() const { return packets_sent_.count(); }
+    int64_t bytes_sent() const { return bytes_sent_.count(); }
+    double send_rate(int64_t now_ms) { return bytes_sent_.Rate(now_ms); }//字节/秒
+    int64_t send_errors() const { return send_errors_.count(); }
+
+private:
+    rtc::Thread* network_thread_;
+    std::unique_ptr<rtc::AsyncPacketSocket> socket_;
+    rtc::SocketAddress remote_address_;
+    StatsCounter packets_sent_;
+    StatsCounter bytes_sent_;
+    StatsCounter send_errors_;
+};
+
+} // namespace xrtc
+
+#endif // XRTCSDK_XRTC_RTC_UDP_TRANSPORT_H_
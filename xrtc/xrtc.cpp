@@ -2,13 +2,26 @@
 
 #include <rtc_base/logging.h>
 #include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/time_utils.h>
+#include "xrtc/base/http_manager.h"
 #include "xrtc/base/xrtc_global.h"
+#include "xrtc/base/xrtc_json.h"
 #include "xrtc/device/cam_impl.h"
+#include "xrtc/device/file_audio_source.h"
+#include "xrtc/device/mic_impl.h"
+#include "xrtc/device/tone_audio_source.h"
 #include "xrtc/device/xrtc_render.h"
+#include "xrtc/media/chain/xrtc_gallery.h"
 #include "xrtc/media/chain/xrtc_preview.h"
+#include "xrtc/media/chain/xrtc_pusher.h"
 
 
 namespace xrtc {
+	bool XRTCEngine::SetThreadConfig(const std::string& json_config)
+	{
+		return XRTCGlobal::SetThreadConfig(json_config);
+	}
+
 	void xrtc::XRTCEngine::Init(XRTCEngineObserver* observer)
 		
 	{
@@ -47,6 +60,53 @@ namespace xrtc {
 
 	}
 
+	int16_t XRTCEngine::GetMicCount() {
+		return XRTCGlobal::Instance()->audio_thread()->Invoke<int16_t>(RTC_FROM_HERE, [=]() {
+			webrtc::AudioDeviceModule* audio_device = XRTCGlobal::Instance()->audio_device();
+			return audio_device ? audio_device->RecordingDevices() : (int16_t)0;
+			});
+	}
+
+	int32_t XRTCEngine::GetMicInfo(int index, std::string& mic_name, std::string& mic_guid) {
+		return XRTCGlobal::Instance()->audio_thread()->Invoke<int32_t>(RTC_FROM_HERE, [&]() {
+			webrtc::AudioDeviceModule* audio_device = XRTCGlobal::Instance()->audio_device();
+			if (!audio_device) {
+				return -1;
+			}
+
+			char name[webrtc::kAdmMaxDeviceNameSize] = { 0 };
+			char guid[webrtc::kAdmMaxGuidSize] = { 0 };
+			int32_t res = audio_device->RecordingDeviceName(index, name, guid);
+			mic_name = name;
+			mic_guid = guid;
+			return res;
+			});
+	}
+
+	IAudioSource* XRTCEngine::CreateMicSource(const std::string& mic_id) {
+		return XRTCGlobal::Instance()->api_thread()->Invoke<IAudioSource*>(RTC_FROM_HERE, [=]() {
+			return new MicImpl(mic_id);
+			});
+	}
+
+	IAudioSource* XRTCEngine::CreateFileAudioSource(const std::string& path) {
+		return XRTCGlobal::Instance()->api_thread()->Invoke<IAudioSource*>(RTC_FROM_HERE, [=]() {
+			return new FileAudioSource(path);
+			});
+	}
+
+	IAudioSource* XRTCEngine::CreateToneAudioSource() {
+		return XRTCGlobal::Instance()->api_thread()->Invoke<IAudioSource*>(RTC_FROM_HERE, [=]() {
+			return new ToneAudioSource();
+			});
+	}
+
+	XRTCPusher* XRTCEngine::CreatePusher(IAudioSource* audio_source, IVideoSource* video_source) {
+		return XRTCGlobal::Instance()->api_thread()->Invoke<XRTCPusher*>(RTC_FROM_HERE, [=]() {
+			return new XRTCPusher(audio_source, video_source);
+			});
+	}
+
 	XRTCRender* XRTCEngine::CreateRender(void* canvas) {
 		return XRTCGlobal::Instance()->api_thread()->Invoke<XRTCRender*>(RTC_FROM_HERE, [=]() {
 			return new XRTCRender(canvas);
@@ -54,10 +114,56 @@ namespace xrtc {
 
 	}
 
+	std::string XRTCEngine::GetStats() {
+		return XRTCGlobal::Instance()->api_thread()->Invoke<std::string>(RTC_FROM_HERE, [=]() {
+			JsonArray jsources;
+			for (auto video_source : XRTCGlobal::Instance()->video_sources()) {
+				JsonValue jsource;
+				if (jsource.FromJson(video_source->GetStats())) {
+					jsources.Append(jsource);
+				}
+			}
+
+			JsonArray jaudio_sources;
+			for (auto audio_source : XRTCGlobal::Instance()->audio_sources()) {
+				JsonValue jsource;
+				if (jsource.FromJson(audio_source->GetStats())) {
+					jaudio_sources.Append(jsource);
+				}
+			}
+
+			JsonArray jthreads;
+			for (auto thread_stats : XRTCGlobal::Instance()->thread_stats()) {
+				JsonObject jthread;
+				thread_stats->GetStats(jthread);
+				jthreads.Append(jthread);
+			}
+
+			JsonObject jstats;
+			jstats["timestamp_ms"] = rtc::TimeMillis();
+			jstats["video_sources"] = jsources;
+			jstats["audio_sources"] = jaudio_sources;
+			jstats["threads"] = jthreads;
+
+			JsonObject jhttp;
+			XRTCGlobal::Instance()->http_manager()->GetStats(jhttp);
+			jstats["http"] = jhttp;
+			return JsonValue(jstats).ToJson();
+			});
+	}
+
 	XRTCPreview* XRTCEngine::CreatePreview(IVideoSource* video_source, XRTCRender* render) {
 		return XRTCGlobal::Instance()->api_thread()->Invoke<XRTCPreview*>(RTC_FROM_HERE, [=]() {
 			return new XRTCPreview(video_source, render);
 			});
 	}
+
+	XRTCGallery* XRTCEngine::CreateGallery(const std::vector<IVideoSource*>& video_sources,
+		XRTCRender* render)
+	{
+		return XRTCGlobal::Instance()->api_thread()->Invoke<XRTCGallery*>(RTC_FROM_HERE, [=]() {
+			return new XRTCGallery(video_sources, render);
+			});
+	}
 	
 }
\ No newline at end of file
@@ -23,6 +23,7 @@
 #include "xrtc/base/xrtc_global.h"
 #include <string>
 #include <memory>
+#include <vector>
 
 
 namespace xrtc
@@ -30,7 +31,9 @@ namespace xrtc
 	class MediaFrame;
 	class XRTCRender;
 	class XRTCPreview;
+	class XRTCGallery;
 	class XRTCPusher;
+	class IAudioSource;
 
 	enum class XRTCError {
 		kNoErr = 0,
@@ -50,9 +53,10 @@ namespace xrtc
 		kAudioSetRecordingDeviceErr,
 		kAudioInitRecordingErr,
 		kAudioStartRecordingErr,
+		kPushDtlsErr,
 	};
 	
-	//֡
+	//֡OnFrameƵԴĲɼ߳ϵãҪʱ
 	class IXRTCConsumer {
 	public:
 		virtual ~IXRTCConsumer() {}
@@ -69,23 +73,53 @@ namespace xrtc
 		virtual void Destroy() = 0;
 
 		virtual void AddConsumer(IXRTCConsumer* consumer) = 0;
-		virtual void RemoveConsumer(IXRTCConsumer* consumer) = 0;
+		virtual void RemoveConsumer(IXRTCConsumer* consumer) = 0;//غ󲻻ٻصconsumer
+
+		virtual std::string GetStats() { return ""; }//ɼͳ(json)ÿȡ
 
 
 	};
 
+	//ƵԴÿ10msһ֡16bitPCM֡ԴڲĻ
+	//OnFrameƵĲɼ߳ϵ(ȼ)Ҫʱ
+	class IAudioSource {
+	public:
+		virtual ~IAudioSource() {}
+		virtual void Start() = 0;
+		virtual void Setup(const std::string& json_config) = 0;//òʡȣǰ
+		virtual void Stop() = 0;
+		virtual void Destroy() = 0;
+
+		virtual void AddConsumer(IXRTCConsumer* consumer) = 0;
+		virtual void RemoveConsumer(IXRTCConsumer* consumer) = 0;//غ󲻻ٻصconsumer
+
+		virtual std::string GetStats() { return ""; }//ɼͳ(json)ÿȡ
+	};
+
 	class XRTC_API XRTCEngineObserver {
 	public:
 		virtual void OnVideoSourceSuccess(IVideoSource*) {}
 		virtual void OnVideoSourceFailed(IVideoSource*,XRTCError) {}
 		virtual void OnPreviewSuccess(XRTCPreview*) {}
 		virtual void OnPreviewFailed(XRTCPreview*, XRTCError) {}
+		virtual void OnGallerySuccess(XRTCGallery*) {}
+		virtual void OnGalleryFailed(XRTCGallery*, XRTCError) {}
+		virtual void OnAudioSourceSuccess(IAudioSource*) {}
+		virtual void OnAudioSourceFailed(IAudioSource*, XRTCError) {}
+		virtual void OnPushSuccess(XRTCPusher*) {}
+		virtual void OnPushFailed(XRTCPusher*, XRTCError) {}
+		virtual void OnPushStopped(XRTCPusher*) {}
 	};
 
 
 
 	class XRTC_API XRTCEngine {
 	public:
+		// ߳(json)InitԼӿ֮ǰã֮òЧ
+		// {"network_thread":{"priority":"realtime","policy":"fifo","rt_priority":50,"cpus":[2],"numa_node":0},
+		//  "api_thread":{...},"worker_thread":{...},"media_pool":{"threads":8,"cpus":[4,5,6,7],...}}
+		// priority: normal/high/highest/realtimepolicy(Linux): default/fifo/rrûȨʱ˻صniceֵ
+		static bool SetThreadConfig(const std::string& json_config);
 		static void Init(XRTCEngineObserver* observer);
 		// Ƶ豸
 		static uint32_t GetGameraCount();
@@ -94,12 +128,24 @@ namespace xrtc
 		static IVideoSource* CreateCamSource(const std::string& cam_id);
 		static XRTCRender* CreateRender(void* canvan);
 		static XRTCPreview* CreatePreview(IVideoSource* video_source,XRTCRender* render);//ΪʵȾʵd3d9ȡʱXRTCRender* render
+		// ·ϳɵһԤĬϰƵԴų
+		static XRTCGallery* CreateGallery(const std::vector<IVideoSource*>& video_sources, XRTCRender* render);
+
+		// ͳϢ(json)Ƶ/ƵԴĲɼ֡ʡֱʡ֡ȣ·ͳͨMediaChain::GetStatsȡ
+		// threadsΪÿSDK̵߳CPUʱ䡢CPUռúͻʱ
+		static std::string GetStats();
 
 		// Ƶ豸
-		//static int16_t GetMicCount();
-		//static int32_t GetMicInfo(int index, std::string& mic_name, std::string& mic_guid);
-		//static IAudioSource* CreateMicSource(const std::string& mic_id);
-		//static XRTCPusher* CreatePusher(IAudioSource* audio_source, IVideoSource* video_source);
+		static int16_t GetMicCount();
+		static int32_t GetMicInfo(int index, std::string& mic_name, std::string& mic_guid);
+		static IAudioSource* CreateMicSource(const std::string& mic_id);
+		// ޲ɼ豸ʱ(/)ʹõƵԴʵʱٶ
+		// ļԴ֧16bit PCMWAVԼPCM(ʺͨSetupָ)
+		static IAudioSource* CreateFileAudioSource(const std::string& path);
+		// ҲƵ//ͨSetupָ
+		static IAudioSource* CreateToneAudioSource();
+		// audio_sourceΪnullptr(ֻƵ)ͨXRTCPusher::StartPushʼ
+		static XRTCPusher* CreatePusher(IAudioSource* audio_source, IVideoSource* video_source);
 
 	};
 }